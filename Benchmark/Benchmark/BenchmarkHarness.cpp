@@ -0,0 +1,223 @@
+//***************************************************************************************
+// BenchmarkHarness.cpp
+//***************************************************************************************
+
+#include "BenchmarkHarness.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+	double gChecksum = 0.0;
+
+	void WriteJsonString(std::ostream& outs, const std::string& s)
+	{
+		outs << '"';
+		for(size_t i = 0; i < s.size(); ++i)
+		{
+			if( s[i] == '"' || s[i] == '\\' )
+				outs << '\\' << s[i];
+			else if( (unsigned char)s[i] >= 0x20 )
+				outs << s[i];
+		}
+		outs << '"';
+	}
+}
+
+double BenchmarkHarness::Result::ItemsPerSecond()const
+{
+	return MedianMs > 0.0 ? ItemsPerRun / (MedianMs*1.0e-3) : 0.0;
+}
+
+BenchmarkHarness::BenchmarkHarness()
+: mRuns(15)
+{
+}
+
+void BenchmarkHarness::SetRuns(unsigned runs)
+{
+	mRuns = std::max(runs, 1u);
+}
+
+unsigned BenchmarkHarness::Runs()const
+{
+	return mRuns;
+}
+
+void BenchmarkHarness::SetFilter(const std::string& filter)
+{
+	mFilter = filter;
+}
+
+bool BenchmarkHarness::Selected(const std::string& name)const
+{
+	return mFilter.empty() || name.find(mFilter) != std::string::npos;
+}
+
+bool BenchmarkHarness::Run(const std::string& name, const std::string& itemName, double itemsPerRun,
+	const std::function<void()>& fn)
+{
+	if( !Selected(name) )
+		return false;
+
+	typedef std::chrono::steady_clock Clock;
+
+	// Warm up caches and any lazily built state.
+	fn();
+
+	std::vector<double> times(mRuns);
+	for(unsigned i = 0; i < mRuns; ++i)
+	{
+		Clock::time_point begin = Clock::now();
+		fn();
+		Clock::time_point end = Clock::now();
+
+		times[i] = std::chrono::duration<double, std::milli>(end - begin).count();
+	}
+
+	std::sort(times.begin(), times.end());
+
+	Result r;
+	r.Name        = name;
+	r.Runs        = mRuns;
+	r.MedianMs    = (mRuns % 2) ? times[mRuns/2] : 0.5*(times[mRuns/2 - 1] + times[mRuns/2]);
+	r.MinMs       = times.front();
+	r.MaxMs       = times.back();
+	r.ItemName    = itemName;
+	r.ItemsPerRun = itemsPerRun;
+	mResults.push_back(r);
+
+	std::cout << std::fixed << std::setprecision(3)
+		<< std::left << std::setw(36) << name << std::right
+		<< std::setw(12) << r.MedianMs << " ms" << std::endl;
+
+	return true;
+}
+
+void BenchmarkHarness::Skip(const std::string& name, const std::string& reason)
+{
+	if( !Selected(name) )
+		return;
+
+	Result r;
+	r.Name        = name;
+	r.SkipReason  = reason;
+	r.Runs        = 0;
+	r.MedianMs    = 0.0;
+	r.MinMs       = 0.0;
+	r.MaxMs       = 0.0;
+	r.ItemsPerRun = 0.0;
+	mResults.push_back(r);
+
+	std::cout << std::left << std::setw(36) << name << std::right
+		<< "     skipped (" << reason << ")" << std::endl;
+}
+
+void BenchmarkHarness::Annotate(const std::string& name, const std::string& note)
+{
+	for(size_t i = mResults.size(); i-- > 0; )
+	{
+		if( mResults[i].Name == name )
+		{
+			mResults[i].Note = note;
+			std::cout << std::left << std::setw(36) << "" << std::right
+				<< "     " << note << std::endl;
+			return;
+		}
+	}
+}
+
+const std::vector<BenchmarkHarness::Result>& BenchmarkHarness::Results()const
+{
+	return mResults;
+}
+
+void BenchmarkHarness::Print(std::ostream& outs)const
+{
+	outs << "\n" << std::left << std::setw(36) << "benchmark" << std::right
+		<< std::setw(12) << "median ms"
+		<< std::setw(12) << "min ms"
+		<< std::setw(12) << "max ms"
+		<< std::setw(16) << "items/s" << "  items\n";
+
+	for(size_t i = 0; i < mResults.size(); ++i)
+	{
+		const Result& r = mResults[i];
+
+		outs << std::left << std::setw(36) << r.Name << std::right;
+		if( !r.SkipReason.empty() )
+		{
+			outs << "  skipped: " << r.SkipReason << "\n";
+			continue;
+		}
+
+		outs << std::fixed << std::setprecision(3)
+			<< std::setw(12) << r.MedianMs
+			<< std::setw(12) << r.MinMs
+			<< std::setw(12) << r.MaxMs
+			<< std::setprecision(0) << std::setw(16) << r.ItemsPerSecond()
+			<< "  " << r.ItemName << "\n";
+
+		if( !r.Note.empty() )
+			outs << std::setw(36) << "" << "  " << r.Note << "\n";
+	}
+
+	outs << "\nchecksum " << std::setprecision(6) << gChecksum << "\n";
+}
+
+bool BenchmarkHarness::WriteJson(const std::string& filename, const std::string& buildInfo)const
+{
+	std::ofstream fout(filename.c_str());
+	if( !fout )
+		return false;
+
+	fout << std::fixed << std::setprecision(6) << "{\n  \"build\": ";
+	WriteJsonString(fout, buildInfo);
+	fout << ",\n  \"runs\": " << mRuns << ",\n  \"benchmarks\": [";
+
+	for(size_t i = 0; i < mResults.size(); ++i)
+	{
+		const Result& r = mResults[i];
+
+		fout << (i > 0 ? "," : "") << "\n    {\"name\": ";
+		WriteJsonString(fout, r.Name);
+		if( !r.SkipReason.empty() )
+		{
+			fout << ", \"skipped\": ";
+			WriteJsonString(fout, r.SkipReason);
+			fout << "}";
+			continue;
+		}
+
+		fout << ", \"runs\": " << r.Runs
+			<< ", \"median_ms\": " << r.MedianMs
+			<< ", \"min_ms\": " << r.MinMs
+			<< ", \"max_ms\": " << r.MaxMs
+			<< ", \"items\": ";
+		WriteJsonString(fout, r.ItemName);
+		fout << ", \"items_per_run\": " << r.ItemsPerRun
+			<< ", \"items_per_second\": " << r.ItemsPerSecond();
+		if( !r.Note.empty() )
+		{
+			fout << ", \"note\": ";
+			WriteJsonString(fout, r.Note);
+		}
+		fout << "}";
+	}
+
+	fout << "\n  ]\n}\n";
+	return (bool)fout;
+}
+
+void BenchmarkHarness::Consume(double value)
+{
+	gChecksum += value;
+}
+
+double BenchmarkHarness::Checksum()
+{
+	return gChecksum;
+}
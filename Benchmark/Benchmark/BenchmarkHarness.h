@@ -0,0 +1,90 @@
+//***************************************************************************************
+// BenchmarkHarness.h
+//
+// Times a piece of CPU work over a number of runs and keeps the median, min and max
+// of the run times.  Results can be printed as a table or written as JSON so runs
+// of different builds can be compared by a script.
+//***************************************************************************************
+
+#ifndef BENCHMARKHARNESS_H
+#define BENCHMARKHARNESS_H
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class BenchmarkHarness
+{
+public:
+	struct Result
+	{
+		std::string Name;
+
+		// Empty unless the benchmark did not run.
+		std::string SkipReason;
+
+		unsigned Runs;
+		double MedianMs;
+		double MinMs;
+		double MaxMs;
+
+		// Units of work one run does ("vertices", "queries", ...) and how many.
+		std::string ItemName;
+		double ItemsPerRun;
+
+		// What the run found besides its time (an error, a chosen count, a
+		// target), or empty.
+		std::string Note;
+
+		// ItemsPerRun over the median run time.
+		double ItemsPerSecond()const;
+	};
+
+	BenchmarkHarness();
+
+	// Timed runs per benchmark, after one untimed warm up run.
+	void SetRuns(unsigned runs);
+	unsigned Runs()const;
+
+	// Only benchmarks whose name contains filter run; empty runs all.
+	void SetFilter(const std::string& filter);
+
+	///<summary>
+	/// Times fn and records the result.  Returns false if the filter excluded it.
+	///</summary>
+	bool Run(const std::string& name, const std::string& itemName, double itemsPerRun,
+		const std::function<void()>& fn);
+
+	///<summary>
+	/// Records a benchmark that cannot run in this build or environment.
+	///</summary>
+	void Skip(const std::string& name, const std::string& reason);
+
+	///<summary>
+	/// Attaches a note to the last result recorded under name, if it ran.
+	///</summary>
+	void Annotate(const std::string& name, const std::string& note);
+
+	const std::vector<Result>& Results()const;
+
+	void Print(std::ostream& outs)const;
+	bool WriteJson(const std::string& filename, const std::string& buildInfo)const;
+
+	///<summary>
+	/// Folds a value into a checksum that is printed at the end, so the optimizer
+	/// cannot drop work whose result is otherwise unused.
+	///</summary>
+	static void Consume(double value);
+	static double Checksum();
+
+private:
+	bool Selected(const std::string& name)const;
+
+private:
+	unsigned mRuns;
+	std::string mFilter;
+	std::vector<Result> mResults;
+};
+
+#endif // BENCHMARKHARNESS_H
@@ -0,0 +1,2826 @@
+//***************************************************************************************
+// BenchmarkMain.cpp
+//
+// Headless benchmarks of the CPU side of the samples: the SSE2 and plain C++ paths
+// of XnaMathPortable.h against each other, the cost of a Parallel::For loop, the wave
+// simulation, terrain smoothing, height queries and chunked LOD build, octree build
+// and ray queries, skinned animation, the procedural shapes, model loading, frustum
+// culling, the PN-AEN index buffer build on the skull and the sdkmesh models, the
+// tessellation factor and patch culling pre-pass, the SubD11 patch build, Bezier
+// patch evaluation, DDS texture streaming, CPU particles and their depth sort, the
+// CPU reference SSAO with its sample count search, the reduced resolution SSAO
+// modes against it, the CPU blur filters with the linear tap kernels of
+// LinearSamplingBlur, the render queue's key sort, the shader cache with a stub
+// compiler, and the frame resource ring over a mock upload context.  Nothing here
+// creates a device, so it also builds outside Windows, with ../CMakeLists.txt or by
+// hand:
+//
+//   g++ -std=c++14 -O2 -pthread -I. -I../../Common
+//       -I"../../Chapter 22 Ambient Occlusion/AmbientOcclusion"
+//       -I"../../Chapter 25 Character Animation/SkinnedMesh"
+//       -I../../TessellationOnAnyBudget/PNTriangleAES/nvtesslib/src
+//       BenchmarkMain.cpp BenchmarkHarness.cpp XnaMathCheck.cpp XnaMathCheckScalar.cpp
+//       ../../Common/{BezierPatchEvaluator,BlurKernel,ChunkedLodGrid,CpuParticleSystem,DDSTexture}.cpp
+//       ../../Common/{FrameResourceRing,GeometryGenerator}.cpp
+//       ../../Common/{DepthSorter,Heightmap,ImageFilter,MathHelper,PatchCuller,Profiler}.cpp
+//       ../../Common/{RenderQueue,ShaderCache}.cpp
+//       ../../Common/{SsaoKernel,SsaoPipeline,SsaoReference}.cpp
+//       ../../Common/{SubDPatchBuilder,TextureStreamer,Waves,xnacollision}.cpp
+//       "../../Chapter 22 Ambient Occlusion/AmbientOcclusion/Octree.cpp"
+//       "../../Chapter 25 Character Animation/SkinnedMesh/SkinnedData.cpp"
+//       ../../TessellationOnAnyBudget/PNTriangleAES/nvtesslib/src/{nvtess,nvtesscache}.cpp
+//       -o Benchmark
+//
+// M3D loading goes through the sample's loader, which fills Direct3D vertex types,
+// so it only runs in the Windows build.
+//
+// Usage: Benchmark [-runs n] [-filter name] [-json file] [-root dir]
+//   -root is the repository root the sample media is loaded from (default ../..).
+//   Inputs missing from it are replaced by generated data of similar size.
+//
+// Every input is generated from a fixed seed so runs are comparable.
+//***************************************************************************************
+
+#include "BenchmarkHarness.h"
+#include "BezierPatchEvaluator.h"
+#include "BlurKernel.h"
+#include "ChunkedLodGrid.h"
+#include "CpuParticleSystem.h"
+#include "DepthSorter.h"
+#include "FrameResourceRing.h"
+#include "GeometryGenerator.h"
+#include "Heightmap.h"
+#include "ImageFilter.h"
+#include "MathHelper.h"
+#include "Octree.h"
+#include "ParallelFor.h"
+#include "PatchCuller.h"
+#include "Profiler.h"
+#include "RenderQueue.h"
+#include "ShaderCache.h"
+#include "SkinnedData.h"
+#include "SsaoPipeline.h"
+#include "SsaoReference.h"
+#include "SubDPatchBuilder.h"
+#include "TextureStreamer.h"
+#include "Waves.h"
+#include "XnaMathCheck.h"
+#include "nvtess.h"
+#include "nvtesscache.h"
+#include "xnacollision.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+
+#ifdef _WIN32
+#include "LoadM3d.h"
+#endif
+
+namespace
+{
+	const unsigned Seed = 2011;
+
+	struct Mesh
+	{
+		std::vector<XMFLOAT3> Positions;
+		std::vector<XMFLOAT3> Normals;
+		std::vector<UINT> Indices;
+	};
+
+	// Same parse as the demos' BuildSkullGeometryBuffers.
+	void ParseSkull(std::istream& fin, Mesh& mesh)
+	{
+		UINT vcount = 0;
+		UINT tcount = 0;
+		std::string ignore;
+
+		fin >> ignore >> vcount;
+		fin >> ignore >> tcount;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		mesh.Positions.resize(vcount);
+		mesh.Normals.resize(vcount);
+		for(UINT i = 0; i < vcount; ++i)
+		{
+			fin >> mesh.Positions[i].x >> mesh.Positions[i].y >> mesh.Positions[i].z;
+			fin >> mesh.Normals[i].x >> mesh.Normals[i].y >> mesh.Normals[i].z;
+		}
+
+		fin >> ignore;
+		fin >> ignore;
+		fin >> ignore;
+
+		mesh.Indices.resize(3*tcount);
+		for(UINT i = 0; i < tcount; ++i)
+		{
+			fin >> mesh.Indices[i*3+0] >> mesh.Indices[i*3+1] >> mesh.Indices[i*3+2];
+		}
+	}
+
+	// A sphere written out in the skull.txt format, for when the model is missing.
+	std::string MakeSkullText()
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData sphere;
+		geoGen.CreateSphere(5.0f, 200, 160, sphere);
+
+		std::ostringstream outs;
+		outs << "VertexCount: " << sphere.Vertices.size() << "\n";
+		outs << "TriangleCount: " << sphere.Indices.size()/3 << "\n";
+		outs << "VertexList (pos, normal)\n{\n";
+		for(size_t i = 0; i < sphere.Vertices.size(); ++i)
+		{
+			const GeometryGenerator::Vertex& v = sphere.Vertices[i];
+			outs << "\t" << v.Position.x << " " << v.Position.y << " " << v.Position.z << " "
+				<< v.Normal.x << " " << v.Normal.y << " " << v.Normal.z << "\n";
+		}
+		outs << "}\nTriangleList\n{\n";
+		for(size_t i = 0; i < sphere.Indices.size(); i += 3)
+		{
+			outs << "\t" << sphere.Indices[i] << " " << sphere.Indices[i+1] << " " << sphere.Indices[i+2] << "\n";
+		}
+		outs << "}\n";
+
+		return outs.str();
+	}
+
+	std::string LoadSkullText(const std::string& root)
+	{
+		std::ifstream fin((root + "/Chapter 14 Building a First Person Camera/Camera/Models/skull.txt").c_str());
+		if( !fin )
+			return MakeSkullText();
+
+		std::ostringstream outs;
+		outs << fin.rdbuf();
+		return outs.str();
+	}
+
+	// Feeds a position-only mesh to nvtess, like FStaticMeshNvRenderBuffer does for
+	// the sdkmesh models.
+	class MeshRenderBuffer : public nv::RenderBuffer
+	{
+	public:
+		explicit MeshRenderBuffer(const Mesh& mesh)
+		: mMesh(mesh)
+		{
+			mIb = new nv::IndexBuffer((void*)&mMesh.Indices[0], nv::IBT_U32, (unsigned)mMesh.Indices.size(), false);
+		}
+
+		virtual nv::Vertex getVertex(unsigned int index)const
+		{
+			nv::Vertex v;
+			v.pos.x = mMesh.Positions[index].x;
+			v.pos.y = mMesh.Positions[index].y;
+			v.pos.z = mMesh.Positions[index].z;
+			v.uv.x  = 0.0f;
+			v.uv.y  = 0.0f;
+			return v;
+		}
+
+	private:
+		MeshRenderBuffer(const MeshRenderBuffer& rhs);
+		MeshRenderBuffer& operator=(const MeshRenderBuffer& rhs);
+
+		const Mesh& mMesh;
+	};
+
+	template<typename T>
+	T ReadAt(const std::vector<char>& bytes, size_t offset)
+	{
+		T value = T();
+		if( offset + sizeof(T) <= bytes.size() )
+			memcpy(&value, &bytes[offset], sizeof(T));
+		return value;
+	}
+
+	// One mesh of an sdkmesh file, read at the SDKMESH_* header offsets and fed to nvtess
+	// like FStaticMeshNvRenderBuffer does: position and last texture coordinate.
+	class SdkMeshRenderBuffer : public nv::RenderBuffer
+	{
+	public:
+		SdkMeshRenderBuffer(const std::vector<char>& file, UINT mesh)
+		: mFile(file), mVertices(0), mPosOffset(0), mTexOffset(-1), mStride(0)
+		{
+			const UINT64 vbHeaders   = ReadAt<UINT64>(file, 56);
+			const UINT64 ibHeaders   = ReadAt<UINT64>(file, 64);
+			const UINT64 meshHeaders = ReadAt<UINT64>(file, 72);
+
+			const UINT64 meshHeader = meshHeaders + 224*mesh;
+			const UINT64 vbHeader   = vbHeaders + 288*ReadAt<UINT>(file, (size_t)meshHeader + 104);
+			const UINT64 ibHeader   = ibHeaders + 32*ReadAt<UINT>(file, (size_t)meshHeader + 168);
+
+			// D3DVERTEXELEMENT9 list, ended by stream 255.
+			for(UINT i = 0; i < 32; ++i)
+			{
+				const size_t element = (size_t)vbHeader + 24 + 8*i;
+				if( ReadAt<USHORT>(file, element) == 255 )
+					break;
+
+				const BYTE usage = ReadAt<BYTE>(file, element + 6);
+				if( usage == 5 )
+					mTexOffset = ReadAt<USHORT>(file, element + 2);
+				else if( usage == 0 )
+					mPosOffset = ReadAt<USHORT>(file, element + 2);
+			}
+			mStride   = (UINT)ReadAt<UINT64>(file, (size_t)vbHeader + 16);
+			mVertices = &file[(size_t)ReadAt<UINT64>(file, (size_t)vbHeader + 280)];
+
+			const UINT indexCount = (UINT)ReadAt<UINT64>(file, (size_t)ibHeader);
+			const UINT indexType  = ReadAt<UINT>(file, (size_t)ibHeader + 16);
+			const char* indices   = &file[(size_t)ReadAt<UINT64>(file, (size_t)ibHeader + 24)];
+			mIb = new nv::IndexBuffer((void*)indices, indexType == 0 ? nv::IBT_U16 : nv::IBT_U32, indexCount, false);
+		}
+
+		static bool Load(const std::string& filename, std::vector<char>& file, UINT& meshCount)
+		{
+			std::ifstream fin(filename.c_str(), std::ios::binary);
+			if( !fin )
+				return false;
+
+			file.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+			meshCount = ReadAt<UINT>(file, 40);
+			return file.size() >= 80;
+		}
+
+		virtual nv::Vertex getVertex(unsigned int index)const
+		{
+			const char* vertex = mVertices + (size_t)mStride*index;
+
+			nv::Vertex v;
+			memcpy(&v.pos, vertex + mPosOffset, sizeof(v.pos));
+			if( mTexOffset >= 0 )
+				memcpy(&v.uv, vertex + mTexOffset, sizeof(v.uv));
+			else
+				v.uv.x = v.uv.y = 0.0f;
+			return v;
+		}
+
+	private:
+		SdkMeshRenderBuffer(const SdkMeshRenderBuffer& rhs);
+		SdkMeshRenderBuffer& operator=(const SdkMeshRenderBuffer& rhs);
+
+		const std::vector<char>& mFile;
+		const char* mVertices;
+		int mPosOffset;
+		int mTexOffset;
+		UINT mStride;
+	};
+
+	// Results more than a small relative error apart.  The two paths round
+	// differently (fused vs separate multiply-adds, different sin/cos and acos
+	// polynomials), so they are not expected to match bit for bit.
+	UINT CountXnaMathMismatches(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		if( a.size() != b.size() )
+			return (UINT)MathHelper::Max(a.size(), b.size());
+
+		UINT mismatches = 0;
+		for(size_t i = 0; i < a.size(); ++i)
+		{
+			float tolerance = 1e-4f*MathHelper::Max(1.0f, MathHelper::Max(fabsf(a[i]), fabsf(b[i])));
+			mismatches += !(a[i] == b[i] || fabsf(a[i] - b[i]) <= tolerance);
+		}
+
+		return mismatches;
+	}
+
+	void BenchXnaMath(BenchmarkHarness& bench)
+	{
+		// The same vector, quaternion and matrix calls through the SSE2 path and the
+		// plain C++ one, on 4096 random inputs.
+		const unsigned caseCount = 4096;
+		std::mt19937 rng(Seed);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		std::vector<float> inputs(caseCount*XnaMathNative::CaseInputCount);
+		for(size_t i = 0; i < inputs.size(); ++i)
+			inputs[i] = unit(rng);
+
+		std::vector<float> nativeResults, scalarResults;
+		XnaMathNative::RunCases(&inputs[0], caseCount, nativeResults);
+		XnaMathScalar::RunCases(&inputs[0], caseCount, scalarResults);
+
+		UINT mismatches = CountXnaMathMismatches(nativeResults, scalarResults);
+		if( mismatches > 0 )
+		{
+			std::ostringstream reason;
+			reason << mismatches << " of " << scalarResults.size() << " results differ between paths";
+			bench.Skip("XnaMath SSE2 vs scalar", reason.str());
+			return;
+		}
+
+		// 1M points through a world-view-projection matrix, and a chain of 1M
+		// matrix products, on each path.
+		const unsigned pointCount = 1 << 20;
+		std::vector<float> points(3*pointCount);
+		for(size_t i = 0; i < points.size(); ++i)
+			points[i] = 100.0f*unit(rng);
+
+		XMMATRIX world = XMMatrixAffineTransformation(XMVectorSet(2.0f, 2.0f, 2.0f, 0.0f), XMVectorZero(),
+			XMQuaternionRotationAxis(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), 0.3f), XMVectorSet(5.0f, 0.0f, 20.0f, 1.0f));
+		XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 50.0f, -200.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, 1.333f, 1.0f, 1000.0f);
+		XMFLOAT4X4 worldViewProj;
+		XMStoreFloat4x4(&worldViewProj, XMMatrixMultiply(XMMatrixMultiply(world, view), proj));
+
+		bench.Run("XMVector3TransformCoord SSE2", "points", pointCount, [&]()
+		{
+			BenchmarkHarness::Consume(XnaMathNative::TransformCoords(&points[0], pointCount, &worldViewProj._11));
+		});
+		bench.Run("XMVector3TransformCoord scalar", "points", pointCount, [&]()
+		{
+			BenchmarkHarness::Consume(XnaMathScalar::TransformCoords(&points[0], pointCount, &worldViewProj._11));
+		});
+
+		// Rotations, so the product neither blows up nor vanishes.
+		const unsigned matrixCount = 1 << 20;
+		std::vector<float> matrices(16*matrixCount);
+		for(unsigned i = 0; i < matrixCount; ++i)
+		{
+			XMVECTOR axis = XMVector3Normalize(XMVectorSet(unit(rng), unit(rng), unit(rng) + 2.0f, 0.0f));
+			XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(&matrices[16*i]), XMMatrixRotationAxis(axis, unit(rng)));
+		}
+
+		bench.Run("XMMatrixMultiply SSE2", "matrices", matrixCount, [&]()
+		{
+			BenchmarkHarness::Consume(XnaMathNative::MultiplyMatrices(&matrices[0], matrixCount));
+		});
+		bench.Run("XMMatrixMultiply scalar", "matrices", matrixCount, [&]()
+		{
+			BenchmarkHarness::Consume(XnaMathScalar::MultiplyMatrices(&matrices[0], matrixCount));
+		});
+	}
+
+	void BenchParallelFor(BenchmarkHarness& bench)
+	{
+		// Every item of loops of every size and thread count runs exactly once.
+		const UINT maxCount = 4096;
+		std::vector<UINT> hits(maxCount);
+		UINT mismatches = 0;
+		for(UINT loop = 0; loop < 256; ++loop)
+		{
+			const UINT count = 1 + (loop*97) % maxCount;
+			std::fill(hits.begin(), hits.begin() + count, 0);
+			Parallel::For(count, 1 + loop % 8, [&](UINT i) { ++hits[i]; });
+			for(UINT i = 0; i < count; ++i)
+				mismatches += hits[i] != 1;
+		}
+
+		if( mismatches > 0 )
+		{
+			std::ostringstream reason;
+			reason << mismatches << " items did not run exactly once";
+			bench.Skip("Parallel::For 4 threads", reason.str());
+			return;
+		}
+
+		// What a loop costs on top of its work: the systems above run several small
+		// loops a frame.
+		const UINT loopCount = 1000;
+		bench.Run("Parallel::For 4 threads", "loops", loopCount, [&]()
+		{
+			UINT sum = 0;
+			for(UINT loop = 0; loop < loopCount; ++loop)
+				Parallel::For(4, 4, [&](UINT i) { hits[i] = i; });
+			for(UINT i = 0; i < 4; ++i)
+				sum += hits[i];
+			BenchmarkHarness::Consume(sum);
+		});
+	}
+
+	void BenchWaves(BenchmarkHarness& bench)
+	{
+		Waves waves;
+		waves.Init(200, 200, 0.8f, 0.03f, 3.25f, 0.4f);
+
+		std::mt19937 rng(Seed);
+		std::uniform_int_distribution<UINT> index(5, 194);
+		for(int i = 0; i < 50; ++i)
+			waves.Disturb(index(rng), index(rng), 0.5f);
+
+		const int steps = 10;
+		bench.Run("Waves::Update", "vertices", (double)steps*waves.VertexCount(), [&]()
+		{
+			for(int i = 0; i < steps; ++i)
+				waves.Update(0.03f);
+			BenchmarkHarness::Consume(waves[0].y);
+		});
+	}
+
+	void BenchTerrain(BenchmarkHarness& bench, const std::string& root)
+	{
+		// Dimensions of the chapter 19 terrain.
+		const UINT size = 2049;
+		const float heightScale = 50.0f;
+		const float cellSpacing = 0.5f;
+
+		Heightmap source;
+		if( !source.LoadRaw(root + "/Chapter 19 Terrain Rendering/Terrain/Textures/terrain.raw",
+			size, size, heightScale, cellSpacing) )
+		{
+			// Sum of a few seeded sine waves in place of the missing RAW file.
+			std::mt19937 rng(Seed);
+			std::uniform_real_distribution<float> phase(0.0f, 2.0f*MathHelper::Pi);
+			float p[4] = { phase(rng), phase(rng), phase(rng), phase(rng) };
+
+			for(UINT i = 0; i < size; ++i)
+			{
+				for(UINT j = 0; j < size; ++j)
+				{
+					float h = sinf(0.011f*i + p[0]) + sinf(0.017f*j + p[1]) +
+						0.5f*sinf(0.053f*(i + j) + p[2]) + 0.25f*sinf(0.131f*i + p[3]);
+					source.At(i, j) = heightScale*(0.5f + 0.15f*h);
+				}
+			}
+		}
+
+		Heightmap terrain;
+		bench.Run("Terrain::Smooth", "texels", (double)size*size, [&]()
+		{
+			terrain = source;
+			terrain.Smooth();
+			BenchmarkHarness::Consume(terrain.At(size/2, size/2));
+		});
+
+		std::vector<XMFLOAT2> patchBoundsY;
+		bench.Run("Terrain::CalcPatchBoundsY", "texels", (double)size*size, [&]()
+		{
+			terrain.CalcPatchBoundsY(64, patchBoundsY);
+			BenchmarkHarness::Consume(patchBoundsY[0].y);
+		});
+
+		const UINT queryCount = 1000000;
+		std::vector<XMFLOAT2> queries(queryCount);
+		std::mt19937 rng(Seed);
+		std::uniform_real_distribution<float> x(-0.49f*terrain.GetWidth(), 0.49f*terrain.GetWidth());
+		std::uniform_real_distribution<float> z(-0.49f*terrain.GetDepth(), 0.49f*terrain.GetDepth());
+		for(UINT i = 0; i < queryCount; ++i)
+			queries[i] = XMFLOAT2(x(rng), z(rng));
+
+		bench.Run("Terrain::GetHeight", "queries", queryCount, [&]()
+		{
+			float sum = 0.0f;
+			for(UINT i = 0; i < queryCount; ++i)
+				sum += terrain.GetHeight(queries[i].x, queries[i].y);
+			BenchmarkHarness::Consume(sum);
+		});
+
+		// The smoothed terrain, even when the runs above were filtered out.
+		if( terrain.Heights().empty() )
+		{
+			terrain = source;
+			terrain.Smooth();
+		}
+
+		ChunkedLodGrid lodGrid;
+		bench.Run("ChunkedLodGrid::Build", "texels", (double)size*size, [&]()
+		{
+			lodGrid.Build(terrain, 64, 5);
+			BenchmarkHarness::Consume((double)lodGrid.GetMesh().Indices.size());
+		});
+
+		// A camera flying across the terrain, a little above it.
+		const UINT eyeCount = 1000;
+		std::vector<ChunkedLodGrid::DrawItem> items;
+		bench.Run("ChunkedLodGrid::Select", "chunks", (double)eyeCount*lodGrid.GetChunks().size(), [&]()
+		{
+			UINT vertexCount = 0;
+			for(UINT i = 0; i < eyeCount; ++i)
+			{
+				float t = (float)i/eyeCount - 0.5f;
+				XMFLOAT3 eye(t*terrain.GetWidth(), heightScale + 20.0f, 0.25f*t*terrain.GetDepth());
+				vertexCount += lodGrid.Select(eye, items);
+			}
+			BenchmarkHarness::Consume(vertexCount);
+		});
+	}
+
+	void BenchOctree(BenchmarkHarness& bench, const Mesh& mesh)
+	{
+		bench.Run("Octree::Build", "triangles", mesh.Indices.size()/3.0, [&]()
+		{
+			Octree octree;
+			octree.Build(mesh.Positions, mesh.Indices);
+		});
+
+		Octree octree;
+		octree.Build(mesh.Positions, mesh.Indices);
+
+		// Rays from a shell around the mesh toward points near its center, so that
+		// both hits and misses are measured.
+		const UINT rayCount = 20000;
+		std::vector<XMFLOAT3> origins(rayCount);
+		std::vector<XMFLOAT3> dirs(rayCount);
+
+		std::mt19937 rng(Seed);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		for(UINT i = 0; i < rayCount; ++i)
+		{
+			XMVECTOR o = XMVectorScale(XMVector3Normalize(XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f)), 20.0f);
+			XMVECTOR target = XMVectorSet(4.0f*unit(rng), 4.0f*unit(rng), 4.0f*unit(rng), 0.0f);
+			XMStoreFloat3(&origins[i], o);
+			XMStoreFloat3(&dirs[i], XMVector3Normalize(target - o));
+		}
+
+		bench.Run("Octree::RayOctreeIntersect", "rays", rayCount, [&]()
+		{
+			UINT hits = 0;
+			for(UINT i = 0; i < rayCount; ++i)
+			{
+				if( octree.RayOctreeIntersect(XMLoadFloat3(&origins[i]), XMLoadFloat3(&dirs[i])) )
+					++hits;
+			}
+			BenchmarkHarness::Consume(hits);
+		});
+	}
+
+	void BenchSkinning(BenchmarkHarness& bench)
+	{
+		// Roughly the soldier model: 58 bones, one clip sampled at 30 keys.
+		const UINT boneCount = 58;
+		const UINT keyCount = 30;
+		const float clipLength = 3.0f;
+
+		std::mt19937 rng(Seed);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		std::vector<int> hierarchy(boneCount);
+		std::vector<XMFLOAT4X4> offsets(boneCount);
+		AnimationClip clip;
+		clip.BoneAnimations.resize(boneCount);
+		for(UINT i = 0; i < boneCount; ++i)
+		{
+			// Parents always come before their children.
+			hierarchy[i] = (i == 0) ? -1 : (int)(i - 1)/2;
+
+			XMStoreFloat4x4(&offsets[i], XMMatrixTranslation(unit(rng), unit(rng), unit(rng)));
+
+			std::vector<Keyframe>& keys = clip.BoneAnimations[i].Keyframes;
+			keys.resize(keyCount);
+			for(UINT k = 0; k < keyCount; ++k)
+			{
+				keys[k].TimePos = clipLength*k/(keyCount - 1);
+				keys[k].Translation = XMFLOAT3(unit(rng), unit(rng), unit(rng));
+				XMVECTOR axis = XMVector3Normalize(XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f));
+				XMVECTOR q = XMQuaternionRotationAxis(axis, MathHelper::Pi*unit(rng));
+				XMStoreFloat4(&keys[k].RotationQuat, q);
+			}
+		}
+
+		std::map<std::string, AnimationClip> animations;
+		animations["Take1"] = clip;
+
+		SkinnedData skinnedData;
+		skinnedData.Set(hierarchy, offsets, animations);
+
+		// One pose per character of a crowd, each at its own point in the clip.
+		const UINT instanceCount = 100;
+		std::vector<XMFLOAT4X4> finalTransforms(boneCount);
+		const std::string clipName = "Take1";
+		bench.Run("SkinnedData::GetFinalTransforms", "bones", (double)instanceCount*boneCount, [&]()
+		{
+			for(UINT i = 0; i < instanceCount; ++i)
+			{
+				skinnedData.GetFinalTransforms(clipName, clipLength*i/instanceCount, finalTransforms);
+			}
+			BenchmarkHarness::Consume(finalTransforms[boneCount-1](3, 0));
+		});
+	}
+
+	void BenchGeometryGenerator(BenchmarkHarness& bench)
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData mesh;
+
+		geoGen.CreateGrid(160.0f, 160.0f, 512, 512, mesh);
+		bench.Run("GeometryGenerator::CreateGrid", "vertices", (double)mesh.Vertices.size(), [&]()
+		{
+			geoGen.CreateGrid(160.0f, 160.0f, 512, 512, mesh);
+		});
+
+		geoGen.CreateSphere(1.0f, 256, 256, mesh);
+		bench.Run("GeometryGenerator::CreateSphere", "vertices", (double)mesh.Vertices.size(), [&]()
+		{
+			geoGen.CreateSphere(1.0f, 256, 256, mesh);
+		});
+
+		geoGen.CreateGeosphere(1.0f, 5, mesh);
+		bench.Run("GeometryGenerator::CreateGeosphere", "triangles", mesh.Indices.size()/3.0, [&]()
+		{
+			geoGen.CreateGeosphere(1.0f, 5, mesh);
+		});
+
+		geoGen.CreateGeosphere(1.0f, 8, mesh);
+		bench.Run("GeometryGenerator::CreateGeosphere8", "triangles", mesh.Indices.size()/3.0, [&]()
+		{
+			geoGen.CreateGeosphere(1.0f, 8, mesh);
+		});
+
+		geoGen.CreateCylinder(1.0f, 0.5f, 3.0f, 256, 256, mesh);
+		bench.Run("GeometryGenerator::CreateCylinder", "vertices", (double)mesh.Vertices.size(), [&]()
+		{
+			geoGen.CreateCylinder(1.0f, 0.5f, 3.0f, 256, 256, mesh);
+		});
+
+		// Large tessellations, which are split across threads, written into arrays
+		// sized once up front the way a mapped buffer would be.
+		GeometryGenerator::MeshSize gridSize = GeometryGenerator::GetGridSize(2049, 2049);
+		std::vector<GeometryGenerator::Vertex> vertices(gridSize.VertexCount);
+		std::vector<UINT> indices(gridSize.IndexCount);
+		bench.Run("GeometryGenerator::CreateGrid2049", "vertices", gridSize.VertexCount, [&]()
+		{
+			geoGen.CreateGrid(160.0f, 160.0f, 2049, 2049, &vertices[0], &indices[0]);
+			BenchmarkHarness::Consume(vertices[gridSize.VertexCount/2].TexC.x);
+		});
+
+		GeometryGenerator::MeshSize sphereSize = GeometryGenerator::GetSphereSize(2048, 1024);
+		vertices.resize(sphereSize.VertexCount);
+		indices.resize(sphereSize.IndexCount);
+		bench.Run("GeometryGenerator::CreateSphere2048", "vertices", sphereSize.VertexCount, [&]()
+		{
+			geoGen.CreateSphere(1.0f, 2048, 1024, &vertices[0], &indices[0]);
+			BenchmarkHarness::Consume(vertices[sphereSize.VertexCount/2].Position.x);
+		});
+	}
+
+	void BenchSkullLoad(BenchmarkHarness& bench, const std::string& skullText, const Mesh& skull)
+	{
+		bench.Run("LoadSkull", "vertices", (double)skull.Positions.size(), [&]()
+		{
+			std::istringstream fin(skullText);
+			Mesh mesh;
+			ParseSkull(fin, mesh);
+			BenchmarkHarness::Consume(mesh.Positions.back().x);
+		});
+	}
+
+	void BenchM3dLoad(BenchmarkHarness& bench, const std::string& root)
+	{
+#ifdef _WIN32
+		std::string filename = root + "/Chapter 25 Character Animation/SkinnedMesh/Models/soldier.m3d";
+		if( !std::ifstream(filename.c_str()) )
+		{
+			bench.Skip("M3DLoader::LoadM3d", filename + " not found");
+			return;
+		}
+
+		M3DLoader loader;
+		std::vector<Vertex::PosNormalTexTanSkinned> vertices;
+		std::vector<USHORT> indices;
+		std::vector<MeshGeometry::Subset> subsets;
+		std::vector<M3dMaterial> mats;
+		SkinnedData skinInfo;
+		loader.LoadM3d(filename, vertices, indices, subsets, mats, skinInfo);
+
+		bench.Run("M3DLoader::LoadM3d", "vertices", (double)vertices.size(), [&]()
+		{
+			loader.LoadM3d(filename, vertices, indices, subsets, mats, skinInfo);
+			BenchmarkHarness::Consume(vertices.size());
+		});
+#else
+		(void)root;
+		bench.Skip("M3DLoader::LoadM3d", "needs the Direct3D vertex types; Windows build only");
+#endif
+	}
+
+	void BenchFrustumCulling(BenchmarkHarness& bench, const Mesh& skull)
+	{
+		XNA::AxisAlignedBox box;
+		XNA::ComputeBoundingAxisAlignedBoxFromPoints(&box, (UINT)skull.Positions.size(), &skull.Positions[0], sizeof(XMFLOAT3));
+
+		XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, 800.0f/600.0f, 1.0f, 1000.0f);
+		XNA::Frustum camFrustum;
+		XNA::ComputeFrustumFromProjection(&camFrustum, &P);
+
+		XMMATRIX V = XMMatrixLookAtLH(XMVectorSet(0.0f, 2.0f, -15.0f, 1.0f),
+			XMVectorSet(0.0f, 0.0f, 100.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMVECTOR detView = XMMatrixDeterminant(V);
+		XMMATRIX invView = XMMatrixInverse(&detView, V);
+
+		// A 20x20x20 block of skulls like the chapter 15 demo, with seeded jitter.
+		const int n = 20;
+		std::vector<XMFLOAT4X4> worlds(n*n*n);
+		std::mt19937 rng(Seed);
+		std::uniform_real_distribution<float> jitter(-2.0f, 2.0f);
+		for(int k = 0; k < n; ++k)
+		{
+			for(int i = 0; i < n; ++i)
+			{
+				for(int j = 0; j < n; ++j)
+				{
+					XMMATRIX W = XMMatrixTranslation(
+						-200.0f + j*20.0f + jitter(rng),
+						-200.0f + i*20.0f + jitter(rng),
+						-200.0f + k*20.0f + jitter(rng));
+					XMStoreFloat4x4(&worlds[k*n*n + i*n + j], W);
+				}
+			}
+		}
+
+		bench.Run("FrustumCulling", "instances", (double)worlds.size(), [&]()
+		{
+			UINT visible = 0;
+			for(size_t i = 0; i < worlds.size(); ++i)
+			{
+				XMMATRIX W = XMLoadFloat4x4(&worlds[i]);
+				XMVECTOR detWorld = XMMatrixDeterminant(W);
+				XMMATRIX invWorld = XMMatrixInverse(&detWorld, W);
+
+				// View space to the object's local space.
+				XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+
+				XMVECTOR scale;
+				XMVECTOR rotQuat;
+				XMVECTOR translation;
+				XMMatrixDecompose(&scale, &rotQuat, &translation, toLocal);
+
+				XNA::Frustum localspaceFrustum;
+				XNA::TransformFrustum(&localspaceFrustum, &camFrustum, XMVectorGetX(scale), rotQuat, translation);
+
+				if( XNA::IntersectAxisAlignedBoxFrustum(&box, &localspaceFrustum) != 0 )
+					++visible;
+			}
+			BenchmarkHarness::Consume(visible);
+		});
+	}
+
+	// Stands in for TextureMgr's sink: counts what would be uploaded.
+	class CountingSink : public TextureStreamer::UploadSink
+	{
+	public:
+		CountingSink() : Bytes(0) {}
+
+		virtual void SetResidentMips(TextureStreamer::Handle /*handle*/, const DDSInfo& /*info*/, UINT /*oldFirstMip*/,
+			UINT /*newFirstMip*/, const TextureStreamer::MipData* data, UINT dataCount)
+		{
+			for(UINT i = 0; i < dataCount; ++i)
+				Bytes += data[i].SlicePitch;
+		}
+
+		UINT64 Bytes;
+	};
+
+	// 512x512 RGBA8 files with full mip chains, for when the MeshView media is missing.
+	std::vector<std::string> MakeTextures(UINT count)
+	{
+		const UINT size = 512;
+		const UINT mipLevels = 10;
+
+		UINT header[32] = { 0 };
+		header[0]  = 0x20534444;	// "DDS "
+		header[1]  = 124;
+		header[2]  = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;	// CAPS, HEIGHT, WIDTH, PIXELFORMAT, MIPMAPCOUNT
+		header[3]  = size;
+		header[4]  = size;
+		header[5]  = size*4;
+		header[7]  = mipLevels;
+		header[19] = 32;
+		header[20] = 0x40 | 0x1;	// RGB | ALPHAPIXELS
+		header[22] = 32;
+		header[23] = 0x000000ff;
+		header[24] = 0x0000ff00;
+		header[25] = 0x00ff0000;
+		header[26] = 0xff000000;
+		header[27] = 0x1000 | 0x400000 | 0x8;	// TEXTURE | MIPMAP | COMPLEX
+
+		std::mt19937 rng(Seed);
+		std::vector<std::string> filenames;
+		for(UINT i = 0; i < count; ++i)
+		{
+			std::ostringstream name;
+			name << "benchmark_texture" << i << ".dds";
+			filenames.push_back(name.str());
+
+			std::ofstream fout(name.str().c_str(), std::ios::binary);
+			fout.write((const char*)header, sizeof(header));
+			for(UINT mip = 0; mip < mipLevels; ++mip)
+			{
+				UINT dim = size >> mip;
+				std::vector<UINT> texels(dim*dim);
+				for(size_t t = 0; t < texels.size(); ++t)
+					texels[t] = rng();
+				fout.write((const char*)&texels[0], texels.size()*sizeof(UINT));
+			}
+		}
+
+		return filenames;
+	}
+
+	void BenchTextureStreaming(BenchmarkHarness& bench, const std::string& root)
+	{
+		const char* names[] =
+		{
+			"bricks", "bricks_nmap", "floor", "floor_nmap", "stones", "stones_nmap",
+			"pillar01_diffuse", "pillar01_normal", "pillar02_diffuse", "pillar02_normal",
+			"pillar03_diffuse", "pillar03_normal", "pillar05_diffuse", "pillar05_normal",
+			"pillar06_diffuse", "pillar06_normal", "rock01_diffuse", "rock01_normal",
+			"templeBase01_diffuse", "templeBase01_normal", "templeBase02_diffuse", "templeBase02_normal",
+			"templeBase03_diffuse", "templeBase03_normal", "templeStairs_diffuse", "templeStairs_normal",
+			"tree01-bark_diffuse", "tree01-bark_normal", "tree01-leaves_diffuse", "tree01-leaves_normal",
+		};
+		const UINT nameCount = sizeof(names)/sizeof(names[0]);
+
+		std::vector<std::string> filenames;
+		for(UINT i = 0; i < nameCount; ++i)
+		{
+			std::string filename = root + "/Chapter 23 Meshes/MeshView/Textures/" + names[i] + ".dds";
+			if( !std::ifstream(filename.c_str()) )
+			{
+				filenames.clear();
+				break;
+			}
+			filenames.push_back(filename);
+		}
+
+		bool generated = filenames.empty();
+		if( generated )
+			filenames = MakeTextures(nameCount);
+
+		// Everything from cold: header and mip reads on the workers, uploads to the sink.
+		bench.Run("TextureStreamer::LoadAll", "textures", (double)filenames.size(), [&]()
+		{
+			TextureStreamer streamer;
+			CountingSink sink;
+			for(size_t i = 0; i < filenames.size(); ++i)
+				streamer.Request(filenames[i]);
+
+			// Reads queue the next mips up as the previous ones are uploaded.
+			for(int frame = 0; frame < 64; ++frame)
+			{
+				streamer.WaitIdle();
+				streamer.Update(sink);
+			}
+			BenchmarkHarness::Consume((double)sink.Bytes);
+		});
+
+		// Half the textures in view at a time with a budget that holds about half of
+		// them, so every switch evicts the top mips of one half and streams the other's in.
+		TextureStreamer streamer;
+		CountingSink sink;
+		std::vector<TextureStreamer::Handle> handles;
+		for(size_t i = 0; i < filenames.size(); ++i)
+			handles.push_back(streamer.Request(filenames[i]));
+		for(int frame = 0; frame < 64; ++frame)
+		{
+			streamer.WaitIdle();
+			streamer.Update(sink);
+		}
+		streamer.SetBudget(streamer.GetStats().ResidentBytes*6/10);
+
+		const int switches = 8;
+		bench.Run("TextureStreamer::Evict", "switches", switches, [&]()
+		{
+			for(int s = 0; s < switches; ++s)
+			{
+				for(int frame = 0; frame < 16; ++frame)
+				{
+					for(size_t i = s % 2; i < handles.size(); i += 2)
+						streamer.Touch(handles[i]);
+					streamer.WaitIdle();
+					streamer.Update(sink, 8ull << 20);
+				}
+			}
+			BenchmarkHarness::Consume((double)sink.Bytes);
+		});
+
+		if( generated )
+		{
+			// The streamer may still have a file open.
+			streamer.WaitIdle();
+			for(size_t i = 0; i < filenames.size(); ++i)
+				remove(filenames[i].c_str());
+		}
+	}
+
+	void BenchTessellationBuffer(BenchmarkHarness& bench, const Mesh& mesh, const std::string& root)
+	{
+		MeshRenderBuffer renderBuffer(mesh);
+
+		bench.Run("nv::tess::buildTessellationBuffer", "triangles", mesh.Indices.size()/3.0, [&]()
+		{
+			nv::IndexBuffer* ib = nv::tess::buildTessellationBuffer(&renderBuffer, nv::DBM_PnAenDominantCorner, true);
+			BenchmarkHarness::Consume(ib->getLength());
+			delete ib;
+		});
+
+		// The PN-AEN demo's models and the larger scenes in Media.
+		const char* models[][2] =
+		{
+			{ "Tiny",     "/TessellationOnAnyBudget/PNTriangleAES/Media/Tiny/tiny.sdkmesh" },
+			{ "Sibenik",  "/Media/Sibenik.sdkmesh" },
+			{ "Knight",   "/Media/goof_knight.sdkmesh" },
+			{ "Leaves",   "/Media/leaves.sdkmesh" },
+		};
+
+		for(size_t i = 0; i < sizeof(models)/sizeof(models[0]); ++i)
+		{
+			const std::string name = std::string("buildTessellationBuffer ") + models[i][0];
+			const std::string filename = root + models[i][1];
+
+			std::vector<char> file;
+			UINT meshCount = 0;
+			if( !SdkMeshRenderBuffer::Load(filename, file, meshCount) )
+			{
+				bench.Skip(name, filename + " not found");
+				continue;
+			}
+
+			std::vector<SdkMeshRenderBuffer*> meshes;
+			double triangles = 0.0;
+			for(UINT m = 0; m < meshCount; ++m)
+			{
+				meshes.push_back(new SdkMeshRenderBuffer(file, m));
+				triangles += meshes.back()->getIb()->getLength()/3;
+			}
+
+			bench.Run(name, "triangles", triangles, [&]()
+			{
+				for(size_t m = 0; m < meshes.size(); ++m)
+				{
+					nv::IndexBuffer* ib = nv::tess::buildTessellationBuffer(meshes[m], nv::DBM_PnAenDominantCorner, true);
+					BenchmarkHarness::Consume(ib->getLength());
+					delete ib;
+				}
+			});
+
+			// What CDXUTSDKMesh does on later loads: key the mesh and read the cache file.
+			const char* cacheFilename = "benchmark_tess.tmp";
+			nv::tess::CacheWriter writer;
+			for(size_t m = 0; m < meshes.size(); ++m)
+			{
+				nv::IndexBuffer* ib = nv::tess::buildTessellationBuffer(meshes[m], nv::DBM_PnAenDominantCorner, true);
+				writer.add(nv::tess::computeCacheKey(meshes[m], nv::DBM_PnAenDominantCorner, true), ib);
+				delete ib;
+			}
+
+			nv::tess::CacheFile cache;
+			if( writer.write(cacheFilename) && cache.open(cacheFilename) )
+			{
+				bench.Run(std::string("tess::CacheFile::find ") + models[i][0], "triangles", triangles, [&]()
+				{
+					for(size_t m = 0; m < meshes.size(); ++m)
+					{
+						nv::IndexBuffer* ib = cache.find(nv::tess::computeCacheKey(meshes[m], nv::DBM_PnAenDominantCorner, true));
+						BenchmarkHarness::Consume(ib ? ib->getLength() : 0);
+						delete ib;
+					}
+				});
+			}
+			cache.close();
+			remove(cacheFilename);
+
+			for(size_t m = 0; m < meshes.size(); ++m)
+				delete meshes[m];
+		}
+	}
+
+	// Live particles whose positions are not bit for bit the same in both systems.
+	UINT CountParticleMismatches(const CpuParticleSystem& a, const CpuParticleSystem& b)
+	{
+		if( a.GetParticleCount() != b.GetParticleCount() )
+			return MathHelper::Max(a.GetParticleCount(), b.GetParticleCount());
+
+		UINT mismatches = 0;
+		for(UINT i = 0; i < a.GetParticleCount(); ++i)
+		{
+			XMFLOAT3 pa = a.GetPosition(i);
+			XMFLOAT3 pb = b.GetPosition(i);
+			mismatches += pa.x != pb.x || pa.y != pb.y || pa.z != pb.z;
+		}
+
+		return mismatches;
+	}
+
+	// Launches a burst of particles at one velocity, steps it and counts the ones
+	// that end up away from the closed form: p0 + v0 t + a t^2/2 for Verlet, and
+	// p0 + v0 t + a t (t + dt)/2, what the semi-implicit Euler steps add up to.  The
+	// two differ by a t dt/2, far more than the tolerance, so neither integrator
+	// can pass for the other.
+	UINT CountIntegratorMismatches(CpuParticleSystem::Integrator integrator, const XMFLOAT3& accel, float dt)
+	{
+		const UINT count = 1024;
+		const UINT steps = 60;
+		const float tolerance = 1e-3f;
+
+		CpuParticleSystem::EmitterDesc burst;
+		burst.OffsetSpread = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		burst.Velocity     = XMFLOAT3(1.0f, -2.0f, 0.5f);
+		burst.Lifetime     = 2.0f*steps*dt;
+		burst.Rate         = 2.0f*count/dt;
+		burst.Seed         = Seed;
+
+		// The first update only emits, and fills the system so no more are born.
+		CpuParticleSystem particles;
+		particles.Init(count);
+		particles.SetAcceleration(accel);
+		particles.SetIntegrator(integrator);
+		particles.AddEmitter(burst, XMFLOAT3(0.0f, 0.0f, 0.0f));
+		particles.Update(dt);
+
+		if( particles.GetParticleCount() != count )
+			return count;
+
+		std::vector<XMFLOAT3> start(count);
+		for(UINT i = 0; i < count; ++i)
+			start[i] = particles.GetPosition(i);
+
+		for(UINT k = 0; k < steps; ++k)
+			particles.Update(dt);
+
+		if( particles.GetParticleCount() != count )
+			return count;
+
+		float t = steps*dt;
+		float h = integrator == CpuParticleSystem::VelocityVerlet ? 0.5f*t*t : 0.5f*t*(t + dt);
+		const XMFLOAT3& v0 = burst.Velocity;
+
+		UINT mismatches = 0;
+		for(UINT i = 0; i < count; ++i)
+		{
+			XMFLOAT3 p = particles.GetPosition(i);
+			float ex = start[i].x + v0.x*t + accel.x*h;
+			float ey = start[i].y + v0.y*t + accel.y*h;
+			float ez = start[i].z + v0.z*t + accel.z*h;
+			mismatches += fabsf(p.x - ex) > tolerance || fabsf(p.y - ey) > tolerance || fabsf(p.z - ez) > tolerance;
+		}
+
+		return mismatches;
+	}
+
+	void BenchParticles(BenchmarkHarness& bench)
+	{
+		// Chapter 20's fire emitter at a rate that keeps about 100000 alive.
+		CpuParticleSystem::EmitterDesc fire;
+		fire.VelocitySpread = XMFLOAT3(2.0f, 4.0f, 2.0f);
+		fire.Size     = XMFLOAT2(3.0f, 3.0f);
+		fire.Lifetime = 1.0f;
+		fire.Rate     = 100000.0f;
+		fire.Seed     = Seed;
+
+		const XMFLOAT3 accel(0.0f, 7.8f, 0.0f);
+		const float dt = 1.0f/60.0f;
+
+		// The same seed has to give the same particles on one thread and on four,
+		// and each integrator has to follow its closed form.
+		UINT threadMismatches = 0;
+		{
+			CpuParticleSystem serial, threaded;
+			serial.Init(110000);
+			threaded.Init(110000);
+			serial.SetThreadCount(1);
+			threaded.SetThreadCount(4);
+			serial.SetAcceleration(accel);
+			threaded.SetAcceleration(accel);
+			serial.AddEmitter(fire, XMFLOAT3(0.0f, 1.0f, 120.0f));
+			threaded.AddEmitter(fire, XMFLOAT3(0.0f, 1.0f, 120.0f));
+
+			for(UINT i = 0; i < 90; ++i)
+			{
+				serial.Update(dt);
+				threaded.Update(dt);
+			}
+
+			threadMismatches = CountParticleMismatches(serial, threaded);
+		}
+
+		UINT integratorMismatches =
+			CountIntegratorMismatches(CpuParticleSystem::SemiImplicitEuler, XMFLOAT3(0.5f, 7.8f, -1.0f), dt) +
+			CountIntegratorMismatches(CpuParticleSystem::VelocityVerlet, XMFLOAT3(0.5f, 7.8f, -1.0f), dt);
+
+		if( threadMismatches > 0 || integratorMismatches > 0 )
+		{
+			std::ostringstream reason;
+			if( threadMismatches > 0 )
+				reason << threadMismatches << " particles differ between 1 and 4 threads";
+			else
+				reason << integratorMismatches << " particles differ from the closed form";
+			bench.Skip("CpuParticleSystem::Update", reason.str());
+			bench.Skip("CpuParticleSystem::WriteVertices", reason.str());
+			return;
+		}
+
+		CpuParticleSystem particles;
+		particles.Init(110000);
+		particles.SetAcceleration(accel);
+		particles.AddEmitter(fire, XMFLOAT3(0.0f, 1.0f, 120.0f));
+
+		// Run past the first lifetime so births and deaths balance.
+		for(UINT i = 0; i < 90; ++i)
+			particles.Update(dt);
+
+		bench.Run("CpuParticleSystem::Update", "particles", particles.GetParticleCount(), [&]()
+		{
+			particles.Update(dt);
+			BenchmarkHarness::Consume(particles.GetParticleCount());
+		});
+
+		std::vector<CpuParticleSystem::Vertex> vertices(particles.GetMaxParticles());
+		bench.Run("CpuParticleSystem::WriteVertices", "particles", particles.GetParticleCount(), [&]()
+		{
+			UINT count = particles.WriteVertices(&vertices[0], accel);
+			BenchmarkHarness::Consume(vertices[count/2].Age);
+		});
+	}
+
+	// Checks the batched pass against PatchCuller::EvaluatePatch, the scalar port of
+	// the hull shader formulas.  Returns the number of patches that differ.
+	UINT CountPatchCullerMismatches(const PatchCuller& culler, const Mesh& mesh, const PatchCuller::Settings& settings)
+	{
+		UINT mismatches = 0;
+		UINT patch = 0;
+		UINT flat  = 0;
+		UINT culled = 0;
+		for(size_t i = 0; i < mesh.Indices.size(); i += 3)
+		{
+			XMFLOAT3 positions[3];
+			XMFLOAT3 normals[3];
+			for(int k = 0; k < 3; ++k)
+			{
+				positions[k] = mesh.Positions[mesh.Indices[i + k]];
+				normals[k]   = mesh.Normals[mesh.Indices[i + k]];
+			}
+
+			XMFLOAT4 expected;
+			PatchCuller::PatchResult result = PatchCuller::EvaluatePatch(positions, normals, settings, &expected);
+			if( result == PatchCuller::PatchCulled )
+			{
+				++culled;
+			}
+			else if( result == PatchCuller::PatchFlat )
+			{
+				if( flat >= culler.GetFlatCount() || memcmp(&culler.GetFlatIndices()[3*flat], &mesh.Indices[i], 3*sizeof(UINT)) != 0 )
+					++mismatches;
+				++flat;
+			}
+			else
+			{
+				if( patch >= culler.GetPatchCount() || memcmp(&culler.GetPatchIndices()[3*patch], &mesh.Indices[i], 3*sizeof(UINT)) != 0 )
+				{
+					++mismatches;
+				}
+				else
+				{
+					const float* a = &culler.GetPatchFactors()[patch].x;
+					const float* b = &expected.x;
+					for(int k = 0; k < 4; ++k)
+					{
+						if( fabsf(a[k] - b[k]) > 1e-5f*MathHelper::Max(1.0f, fabsf(b[k])) )
+						{
+							++mismatches;
+							break;
+						}
+					}
+				}
+				++patch;
+			}
+		}
+
+		if( patch != culler.GetPatchCount() || flat != culler.GetFlatCount() || culled != culler.GetCulledCount() )
+			++mismatches;
+
+		return mismatches;
+	}
+
+	void BenchPatchCulling(BenchmarkHarness& bench, const Mesh& skull)
+	{
+		// A 4x4 block of skulls seen from inside the block, so some patches are off
+		// screen, some face away and the far ones come out at factor 1.
+		Mesh mesh;
+		const UINT skullVertices = (UINT)skull.Positions.size();
+		for(UINT k = 0; k < 16; ++k)
+		{
+			XMFLOAT3 offset(-30.0f + 20.0f*(k % 4), 0.0f, -30.0f + 20.0f*(k/4));
+			for(UINT i = 0; i < skullVertices; ++i)
+			{
+				const XMFLOAT3& p = skull.Positions[i];
+				mesh.Positions.push_back(XMFLOAT3(p.x + offset.x, p.y + offset.y, p.z + offset.z));
+				mesh.Normals.push_back(skull.Normals[i]);
+			}
+			for(size_t i = 0; i < skull.Indices.size(); ++i)
+				mesh.Indices.push_back(skull.Indices[i] + k*skullVertices);
+		}
+
+		PatchCuller::Vertices vertices;
+		vertices.Positions = &mesh.Positions[0].x;
+		vertices.Normals   = &mesh.Normals[0].x;
+		vertices.Stride    = sizeof(XMFLOAT3);
+		vertices.Count     = (UINT)mesh.Positions.size();
+		UINT triangles = (UINT)mesh.Indices.size()/3;
+
+		XMVECTOR eye    = XMVectorSet(-35.0f, 15.0f, -45.0f, 1.0f);
+		XMVECTOR target = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		XMMATRIX view = XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, 16.0f/9.0f, 1.0f, 1000.0f);
+
+		PatchCuller::Settings settings;
+		XMStoreFloat4x4(&settings.World, XMMatrixRotationY(0.3f));
+		XMStoreFloat4x4(&settings.ViewProj, view*proj);
+		XMStoreFloat3(&settings.ViewVector, XMVector3Normalize(eye - target));
+		settings.ScreenWidth  = 1920.0f;
+		settings.ScreenHeight = 1080.0f;
+		settings.EdgeSize     = 16.0f;
+		settings.ScreenSpaceAdaptive = true;
+		settings.FrustumCull  = true;
+		settings.BackFaceCull = true;
+
+		const PatchCuller::PatchType types[] = { PatchCuller::PNPatches, PatchCuller::FlatPatches };
+		const char* names[] = { "PatchCuller::Process PN", "PatchCuller::Process Flat" };
+		for(int t = 0; t < 2; ++t)
+		{
+			settings.Type = types[t];
+
+			PatchCuller culler;
+			culler.Process(vertices, &mesh.Indices[0], triangles, settings);
+			UINT mismatches = CountPatchCullerMismatches(culler, mesh, settings);
+			if( mismatches > 0 )
+			{
+				std::ostringstream reason;
+				reason << mismatches << " patches differ from EvaluatePatch";
+				bench.Skip(names[t], reason.str());
+				continue;
+			}
+
+			bench.Run(names[t], "patches", triangles, [&]()
+			{
+				culler.Process(vertices, &mesh.Indices[0], triangles, settings);
+				BenchmarkHarness::Consume(culler.GetPatchCount() + culler.GetFlatCount());
+			});
+		}
+
+		// The same PN patches one at a time, as the hull shader sees them.
+		settings.Type = PatchCuller::PNPatches;
+		bench.Run("PatchCuller::EvaluatePatch PN", "patches", triangles, [&]()
+		{
+			UINT kept = 0;
+			for(UINT i = 0; i < triangles; ++i)
+			{
+				XMFLOAT3 positions[3];
+				XMFLOAT3 normals[3];
+				for(int k = 0; k < 3; ++k)
+				{
+					positions[k] = mesh.Positions[mesh.Indices[3*i + k]];
+					normals[k]   = mesh.Normals[mesh.Indices[3*i + k]];
+				}
+
+				XMFLOAT4 factors;
+				kept += PatchCuller::EvaluatePatch(positions, normals, settings, &factors) != PatchCuller::PatchCulled;
+			}
+			BenchmarkHarness::Consume(kept);
+		});
+	}
+
+	// Checks the patches against those the SubD11 exporter wrote.  Returns the number
+	// of patches that differ, or that the exporter has and the builder left out.
+	UINT CountSubDPatchMismatches(const SubDPatchBuilder& builder, const UINT* indices, const BYTE* data, UINT patchCount)
+	{
+		const SubDPatchBuilder::PatchList* lists[2] = { &builder.GetRegularPatches(), &builder.GetExtraordinaryPatches() };
+		const UINT points = builder.GetMaxPoints();
+
+		UINT mismatches = patchCount - lists[0]->Count() - lists[1]->Count();
+		for(int l = 0; l < 2; ++l)
+		{
+			for(UINT i = 0; i < lists[l]->Count(); ++i)
+			{
+				UINT face = lists[l]->Faces[i];
+				if( memcmp(&lists[l]->Indices[points*i], &indices[points*face], points*sizeof(UINT)) != 0 ||
+					memcmp(&lists[l]->Data[i], &data[sizeof(SubDPatchBuilder::PatchData)*face], sizeof(SubDPatchBuilder::PatchData)) != 0 )
+				{
+					++mismatches;
+				}
+			}
+		}
+
+		return mismatches;
+	}
+
+	void BenchSubDPatches(BenchmarkHarness& bench, const std::string& root)
+	{
+		// SubD11's head, read back as plain quads: the first four indices of each of
+		// the exporter's patches are the corners of its face.
+		const std::string filename = root + "/Chapter 13 The Tessellation Stages/SubD11/Media/SubD10/AnimatedHead.sdkmesh";
+		std::vector<char> file;
+		UINT meshCount = 0;
+		if( !SdkMeshRenderBuffer::Load(filename, file, meshCount) )
+		{
+			bench.Skip("SubDPatchBuilder::Build head", filename + " not found");
+		}
+		else
+		{
+			const UINT64 vbHeaders   = ReadAt<UINT64>(file, 56);
+			const UINT64 ibHeaders   = ReadAt<UINT64>(file, 64);
+			const UINT64 meshHeaders = ReadAt<UINT64>(file, 72);
+
+			// MAX_EXTRAORDINARY_POINTS in SubDMesh.h.
+			const UINT maxPoints = 32;
+
+			std::vector<SubDPatchBuilder::Polygons> meshes(meshCount);
+			std::vector<std::vector<UINT> > quads(meshCount);
+			UINT faces = 0;
+			UINT mismatches = 0;
+			for(UINT m = 0; m < meshCount; ++m)
+			{
+				// The control points are the first vertex buffer, the valences and
+				// prefixes the second.
+				const UINT64 meshHeader  = meshHeaders + 224*m;
+				const UINT64 pointHeader = vbHeaders + 288*ReadAt<UINT>(file, (size_t)meshHeader + 104);
+				const UINT64 dataHeader  = vbHeaders + 288*ReadAt<UINT>(file, (size_t)meshHeader + 108);
+				const UINT64 indexHeader = ibHeaders + 32*ReadAt<UINT>(file, (size_t)meshHeader + 168);
+
+				const UINT patchCount = (UINT)ReadAt<UINT64>(file, (size_t)dataHeader);
+				const UINT* indices = (const UINT*)&file[(size_t)ReadAt<UINT64>(file, (size_t)indexHeader + 24)];
+				const BYTE* data    = (const BYTE*)&file[(size_t)ReadAt<UINT64>(file, (size_t)dataHeader + 280)];
+
+				quads[m].resize(4*patchCount);
+				for(UINT i = 0; i < patchCount; ++i)
+					memcpy(&quads[m][4*i], &indices[maxPoints*i], 4*sizeof(UINT));
+
+				meshes[m].Positions   = (const float*)&file[(size_t)ReadAt<UINT64>(file, (size_t)pointHeader + 280)];
+				meshes[m].Stride      = (UINT)ReadAt<UINT64>(file, (size_t)pointHeader + 16);
+				meshes[m].VertexCount = (UINT)ReadAt<UINT64>(file, (size_t)pointHeader);
+				meshes[m].Indices     = quads[m].empty() ? 0 : &quads[m][0];
+				meshes[m].FaceSizes   = 0;
+				meshes[m].FaceCount   = patchCount;
+				faces += patchCount;
+
+				SubDPatchBuilder builder;
+				builder.Build(meshes[m]);
+				mismatches += CountSubDPatchMismatches(builder, indices, data, patchCount);
+			}
+
+			if( mismatches > 0 )
+			{
+				std::ostringstream reason;
+				reason << mismatches << " patches differ from the exporter's";
+				bench.Skip("SubDPatchBuilder::Build head", reason.str());
+			}
+			else
+			{
+				SubDPatchBuilder builder;
+				bench.Run("SubDPatchBuilder::Build head", "faces", faces, [&]()
+				{
+					for(UINT m = 0; m < meshCount; ++m)
+					{
+						builder.Build(meshes[m]);
+						BenchmarkHarness::Consume(builder.GetExtraordinaryPatches().Count());
+					}
+				});
+			}
+		}
+
+		// A cube with 256x256 quads a side pushed out to a sphere.  Each side has its
+		// own vertices, so the edges are welded like texture seams, and the cube's
+		// corners are valence 3.
+		const UINT n = 256;
+		std::vector<XMFLOAT3> positions;
+		std::vector<UINT> indices;
+		for(UINT side = 0; side < 6; ++side)
+		{
+			// Axes u and v span the side and u x v points out of it.
+			const int axis = side/2;
+			const int sign = side % 2 ? -1 : 1;
+			const int u = sign > 0 ? (axis + 1) % 3 : (axis + 2) % 3;
+			const int v = sign > 0 ? (axis + 2) % 3 : (axis + 1) % 3;
+
+			const UINT first = (UINT)positions.size();
+			for(UINT j = 0; j <= n; ++j)
+			{
+				for(UINT i = 0; i <= n; ++i)
+				{
+					// Integer coordinates, so vertices shared by two sides come out the same.
+					float p[3];
+					p[axis] = (float)(sign*(int)n);
+					p[u] = (float)(2*(int)i - (int)n);
+					p[v] = (float)(2*(int)j - (int)n);
+
+					XMFLOAT3 position;
+					XMStoreFloat3(&position, XMVector3Normalize(XMVectorSet(p[0], p[1], p[2], 0.0f)));
+					positions.push_back(position);
+				}
+			}
+
+			for(UINT j = 0; j < n; ++j)
+			{
+				for(UINT i = 0; i < n; ++i)
+				{
+					indices.push_back(first + j*(n + 1) + i);
+					indices.push_back(first + j*(n + 1) + i + 1);
+					indices.push_back(first + (j + 1)*(n + 1) + i + 1);
+					indices.push_back(first + (j + 1)*(n + 1) + i);
+				}
+			}
+		}
+
+		SubDPatchBuilder::Polygons sphere;
+		sphere.Positions   = &positions[0].x;
+		sphere.Stride      = sizeof(XMFLOAT3);
+		sphere.VertexCount = (UINT)positions.size();
+		sphere.Indices     = &indices[0];
+		sphere.FaceSizes   = 0;
+		sphere.FaceCount   = (UINT)indices.size()/4;
+
+		SubDPatchBuilder builder;
+		builder.Build(sphere);
+		if( !builder.GetTriangles().Faces.empty() || builder.GetExtraordinaryPatches().Count() != 24 )
+		{
+			bench.Skip("SubDPatchBuilder::Build sphere", "the sides did not weld into a closed surface");
+			return;
+		}
+
+		bench.Run("SubDPatchBuilder::Build sphere", "faces", sphere.FaceCount, [&]()
+		{
+			builder.Build(sphere);
+			BenchmarkHarness::Consume(builder.GetRegularPatches().Count());
+		});
+	}
+
+	struct BezierVertex
+	{
+		XMFLOAT3 Pos;
+		XMFLOAT3 Normal;
+		XMFLOAT2 Tex;
+	};
+
+	// Checks evaluated patches against BezierPatchEvaluator::EvaluatePoint, the scalar
+	// port of the domain shader.  Returns the number of vertices that differ.
+	UINT CountBezierMismatches(const std::vector<XMFLOAT3>& controlPoints, const UINT* tess,
+		const UINT* firstVertex, const std::vector<BezierVertex>& vertices)
+	{
+		UINT mismatches = 0;
+		for(UINT p = 0; p < controlPoints.size()/16; ++p)
+		{
+			const UINT n = tess[p];
+			for(UINT r = 0; r <= n; ++r)
+			{
+				for(UINT c = 0; c <= n; ++c)
+				{
+					const BezierVertex& v = vertices[firstVertex[p] + r*(n + 1) + c];
+
+					XMFLOAT3 position, normal;
+					BezierPatchEvaluator::EvaluatePoint(&controlPoints[16*p], (float)c/n, (float)r/n, &position, &normal);
+
+					// Forward differencing drifts a little over the row.
+					const float* a[2] = { &v.Pos.x, &v.Normal.x };
+					const float* b[2] = { &position.x, &normal.x };
+					bool same = v.Tex.x == (float)c/n && v.Tex.y == (float)r/n;
+					for(int k = 0; k < 3; ++k)
+					{
+						same = same && fabsf(a[0][k] - b[0][k]) <= 1e-3f*MathHelper::Max(1.0f, fabsf(b[0][k]));
+						same = same && fabsf(a[1][k] - b[1][k]) <= 1e-3f;
+					}
+					mismatches += !same;
+				}
+			}
+		}
+
+		return mismatches;
+	}
+
+	void BenchBezierPatches(BenchmarkHarness& bench)
+	{
+		// 2048 patches like the BezierPatch demo's, laid out on a 64x32 grid with
+		// their heights jittered.
+		const UINT patchCount = 2048;
+		std::mt19937 rng(Seed);
+		std::uniform_real_distribution<float> jitter(-5.0f, 5.0f);
+
+		std::vector<XMFLOAT3> controlPoints(16*patchCount);
+		for(UINT p = 0; p < patchCount; ++p)
+		{
+			const float x0 = 30.0f*(p % 64) - 960.0f;
+			const float z0 = 30.0f*(p/64) - 480.0f;
+			for(UINT j = 0; j < 4; ++j)
+				for(UINT i = 0; i < 4; ++i)
+					controlPoints[16*p + 4*j + i] = XMFLOAT3(x0 - 15.0f + 10.0f*i, jitter(rng), z0 + 15.0f - 10.0f*j);
+		}
+
+		BezierPatchEvaluator evaluator;
+		BezierPatchEvaluator::Output output;
+		output.Stride = sizeof(BezierVertex);
+
+		std::vector<BezierVertex> vertices;
+		std::vector<UINT> tess(patchCount);
+		std::vector<UINT> firstVertex(patchCount);
+
+		const UINT factors[] = { 8, 16, 64 };
+		for(int f = 0; f < 3; ++f)
+		{
+			std::fill(tess.begin(), tess.end(), factors[f]);
+			UINT vertexCount = BezierPatchEvaluator::ComputeVertexOffsets(&tess[0], patchCount, &firstVertex[0]);
+			vertices.assign(vertexCount, BezierVertex());
+			output.Positions = &vertices[0].Pos.x;
+			output.Normals   = &vertices[0].Normal.x;
+			output.TexC      = &vertices[0].Tex.x;
+
+			std::ostringstream uniformName, adaptiveName;
+			uniformName << "BezierPatchEvaluator::Uniform " << factors[f];
+			adaptiveName << "BezierPatchEvaluator::Adaptive " << factors[f];
+
+			evaluator.EvaluateUniform(&controlPoints[0], patchCount, factors[f], output);
+			UINT mismatches = CountBezierMismatches(controlPoints, &tess[0], &firstVertex[0], vertices);
+			if( mismatches > 0 )
+			{
+				std::ostringstream reason;
+				reason << mismatches << " vertices differ from EvaluatePoint";
+				bench.Skip(uniformName.str(), reason.str());
+			}
+			else
+			{
+				bench.Run(uniformName.str(), "vertices", vertexCount, [&]()
+				{
+					evaluator.EvaluateUniform(&controlPoints[0], patchCount, factors[f], output);
+					BenchmarkHarness::Consume(vertices[vertexCount/2].Pos.y);
+				});
+			}
+
+			// The Bernstein path on the same grids, for comparison.
+			vertices.assign(vertexCount, BezierVertex());
+			evaluator.EvaluateAdaptive(&controlPoints[0], patchCount, &tess[0], &firstVertex[0], output);
+			mismatches = CountBezierMismatches(controlPoints, &tess[0], &firstVertex[0], vertices);
+			if( mismatches > 0 )
+			{
+				std::ostringstream reason;
+				reason << mismatches << " vertices differ from EvaluatePoint";
+				bench.Skip(adaptiveName.str(), reason.str());
+			}
+			else
+			{
+				bench.Run(adaptiveName.str(), "vertices", vertexCount, [&]()
+				{
+					evaluator.EvaluateAdaptive(&controlPoints[0], patchCount, &tess[0], &firstVertex[0], output);
+					BenchmarkHarness::Consume(vertices[vertexCount/2].Pos.y);
+				});
+			}
+		}
+
+		// Factors from the distance to a camera at the near edge of the grid, as
+		// BasicTessellation's hull shader picks them.
+		XMFLOAT3 eye(0.0f, 40.0f, -520.0f);
+		BezierPatchEvaluator::ComputeDistanceFactors(&controlPoints[0], patchCount, eye, 20.0f, 400.0f, &tess[0]);
+		UINT vertexCount = BezierPatchEvaluator::ComputeVertexOffsets(&tess[0], patchCount, &firstVertex[0]);
+		vertices.assign(vertexCount, BezierVertex());
+		output.Positions = &vertices[0].Pos.x;
+		output.Normals   = &vertices[0].Normal.x;
+		output.TexC      = &vertices[0].Tex.x;
+
+		bench.Run("BezierPatchEvaluator::Adaptive LOD", "vertices", vertexCount, [&]()
+		{
+			evaluator.EvaluateAdaptive(&controlPoints[0], patchCount, &tess[0], &firstVertex[0], output);
+			BenchmarkHarness::Consume(vertices[vertexCount/2].Pos.y);
+		});
+
+		// The domain shader one vertex at a time, at factor 16.
+		bench.Run("BezierPatchEvaluator::EvaluatePoint", "vertices", patchCount*BezierPatchEvaluator::GetVertexCount(16), [&]()
+		{
+			XMFLOAT3 position, normal;
+			float sum = 0.0f;
+			for(UINT p = 0; p < patchCount; ++p)
+			{
+				for(UINT r = 0; r <= 16; ++r)
+				{
+					for(UINT c = 0; c <= 16; ++c)
+					{
+						BezierPatchEvaluator::EvaluatePoint(&controlPoints[16*p], c/16.0f, r/16.0f, &position, &normal);
+						sum += position.y;
+					}
+				}
+			}
+			BenchmarkHarness::Consume(sum);
+		});
+	}
+
+	float PointDepth(const XMFLOAT3& p, const XMFLOAT3& eye, const XMFLOAT3& look)
+	{
+		return (p.x - eye.x)*look.x + (p.y - eye.y)*look.y + (p.z - eye.z)*look.z;
+	}
+
+	// DepthSorter orders by depth quantized to 22 bits over the frame's depth range,
+	// so points closer than one key apart may come in either order.  Twice that
+	// leaves room for the rounding of the depths themselves.
+	float DepthSortTolerance(const std::vector<XMFLOAT3>& positions, const XMFLOAT3& eye, const XMFLOAT3& look)
+	{
+		float minDepth = +MathHelper::Infinity;
+		float maxDepth = -MathHelper::Infinity;
+		for(size_t i = 0; i < positions.size(); ++i)
+		{
+			float d = PointDepth(positions[i], eye, look);
+			minDepth = MathHelper::Min(minDepth, d);
+			maxDepth = MathHelper::Max(maxDepth, d);
+		}
+
+		return 2.0f*(maxDepth - minDepth)/(float)((1u << 22) - 1);
+	}
+
+	// Points missing from or repeated in the order, places where the depth grows
+	// along it, and, given a reference order, places where the two hold points of
+	// different depths.
+	UINT CountDepthSortMismatches(const DepthSorter& sorter, const std::vector<XMFLOAT3>& positions,
+		const XMFLOAT3& eye, const XMFLOAT3& look, const UINT* reference)
+	{
+		UINT count = (UINT)positions.size();
+		if( sorter.GetCount() != count )
+			return count;
+
+		const UINT* order = sorter.GetOrder();
+		float tolerance = DepthSortTolerance(positions, eye, look);
+
+		UINT mismatches = 0;
+		std::vector<bool> seen(count, false);
+		for(UINT k = 0; k < count; ++k)
+		{
+			if( order[k] >= count || seen[order[k]] )
+			{
+				++mismatches;
+				continue;
+			}
+			seen[order[k]] = true;
+
+			float d = PointDepth(positions[order[k]], eye, look);
+			if( k > 0 && order[k-1] < count && d > PointDepth(positions[order[k-1]], eye, look) + tolerance )
+				++mismatches;
+
+			if( reference && reference[k] != order[k] &&
+				(reference[k] >= count || fabsf(d - PointDepth(positions[reference[k]], eye, look)) > tolerance) )
+				++mismatches;
+		}
+
+		return mismatches;
+	}
+
+	// Tiles whose ranges do not add up to the points on screen, and points in a tile
+	// they do not project into or out of back to front order within it.
+	UINT CountTileMismatches(const DepthSorter& sorter, const std::vector<XMFLOAT3>& positions,
+		const XMFLOAT4X4& viewProj, UINT tilesX, UINT tilesY, const XMFLOAT3& eye, const XMFLOAT3& look)
+	{
+		UINT count = (UINT)positions.size();
+		const XMFLOAT4X4& m = viewProj;
+
+		// Each point's tile, or tilesX*tilesY off screen, as BinTiles finds it.
+		std::vector<UINT> tileOf(count);
+		UINT onScreen = 0;
+		for(UINT i = 0; i < count; ++i)
+		{
+			const XMFLOAT3& p = positions[i];
+			float cx = p.x*m._11 + p.y*m._21 + p.z*m._31 + m._41;
+			float cy = p.x*m._12 + p.y*m._22 + p.z*m._32 + m._42;
+			float cw = p.x*m._14 + p.y*m._24 + p.z*m._34 + m._44;
+
+			tileOf[i] = tilesX*tilesY;
+			if( cw <= 0.0f || fabsf(cx) > cw || fabsf(cy) > cw )
+				continue;
+
+			float u = 0.5f + 0.5f*cx/cw;
+			float v = 0.5f - 0.5f*cy/cw;
+			UINT tx = MathHelper::Min((UINT)(u*tilesX), tilesX-1);
+			UINT ty = MathHelper::Min((UINT)(v*tilesY), tilesY-1);
+			tileOf[i] = ty*tilesX + tx;
+			++onScreen;
+		}
+
+		UINT tiled = sorter.GetTiledCount();
+		UINT mismatches = tiled != onScreen ? 1 : 0;
+
+		float tolerance = DepthSortTolerance(positions, eye, look);
+		const UINT* order = sorter.GetTileOrder();
+		UINT covered = 0;
+		for(UINT t = 0; t < tilesX*tilesY; ++t)
+		{
+			UINT start = sorter.GetTileStart(t);
+			UINT n = sorter.GetTileCount(t);
+			if( start != covered || start + n > tiled )
+				return mismatches + 1;
+			covered += n;
+
+			for(UINT k = start; k < start + n; ++k)
+			{
+				if( order[k] >= count || tileOf[order[k]] != t )
+				{
+					++mismatches;
+					continue;
+				}
+
+				if( k > start && order[k-1] < count &&
+					PointDepth(positions[order[k]], eye, look) > PointDepth(positions[order[k-1]], eye, look) + tolerance )
+					++mismatches;
+			}
+		}
+
+		return mismatches + (covered != tiled ? 1 : 0);
+	}
+
+	void BenchDepthSort(BenchmarkHarness& bench)
+	{
+		// A million particles in a box in front of the camera.
+		const UINT count = 1000000;
+		std::mt19937 rng(Seed);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		std::vector<XMFLOAT3> positions(count);
+		for(UINT i = 0; i < count; ++i)
+			positions[i] = XMFLOAT3(100.0f*unit(rng), 50.0f*unit(rng), 200.0f + 100.0f*unit(rng));
+
+		DepthSorter::Points points = DepthSorter::Points::FromStructs(&positions[0], sizeof(XMFLOAT3), count);
+		XMFLOAT3 eye(0.0f, 0.0f, 0.0f);
+		XMFLOAT3 look(0.0f, 0.0f, 1.0f);
+
+		DepthSorter sorter;
+		sorter.SetIncremental(false);
+		sorter.Sort(points, eye, look);
+
+		UINT mismatches = CountDepthSortMismatches(sorter, positions, eye, look, nullptr);
+		if( mismatches > 0 )
+		{
+			std::ostringstream reason;
+			reason << mismatches << " places in the order differ from a back to front permutation";
+			bench.Skip("DepthSorter::Sort", reason.str());
+			return;
+		}
+
+		bench.Run("DepthSorter::Sort", "particles", count, [&]()
+		{
+			sorter.Sort(points, eye, look);
+			BenchmarkHarness::Consume(sorter.GetOrder()[count/2]);
+		});
+
+		// The camera strafing slowly, so each frame can reuse the last order.  A few
+		// frames of it must match a fresh sort of the same frame.
+		DepthSorter coherent;
+		coherent.Sort(points, eye, look);
+		UINT reused = 0;
+		for(int frame = 0; frame < 4; ++frame)
+		{
+			eye.x += 0.01f;
+			coherent.Sort(points, eye, look);
+			sorter.Sort(points, eye, look);
+			reused += coherent.WasIncremental();
+			mismatches += CountDepthSortMismatches(coherent, positions, eye, look, sorter.GetOrder());
+		}
+
+		if( mismatches > 0 || reused == 0 )
+		{
+			std::ostringstream reason;
+			if( mismatches > 0 )
+				reason << mismatches << " places in the reused order differ from a fresh sort";
+			else
+				reason << "the coherent sort did not reuse the last order";
+			bench.Skip("DepthSorter::SortCoherent", reason.str());
+			return;
+		}
+
+		bench.Run("DepthSorter::SortCoherent", "particles", count, [&]()
+		{
+			eye.x += 0.01f;
+			coherent.Sort(points, eye, look);
+			BenchmarkHarness::Consume(coherent.GetOrder()[count/2]);
+		});
+
+		XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(eye.x, eye.y, eye.z, 1.0f),
+			XMVectorSet(eye.x, eye.y, 1.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, 16.0f/9.0f, 1.0f, 1000.0f);
+		XMFLOAT4X4 viewProj;
+		XMStoreFloat4x4(&viewProj, view*proj);
+
+		coherent.Sort(points, eye, look);
+		coherent.BinTiles(points, viewProj, 16, 9);
+		mismatches = CountTileMismatches(coherent, positions, viewProj, 16, 9, eye, look);
+		if( mismatches > 0 )
+		{
+			std::ostringstream reason;
+			reason << mismatches << " tiles or tiled points differ from the projected points";
+			bench.Skip("DepthSorter::BinTiles", reason.str());
+			return;
+		}
+
+		bench.Run("DepthSorter::BinTiles", "particles", count, [&]()
+		{
+			coherent.BinTiles(points, viewProj, 16, 9);
+			BenchmarkHarness::Consume(coherent.GetTiledCount());
+		});
+	}
+
+	// A floor, a back wall and a row of spheres resting on the floor, ray cast in
+	// view space the way SsaoNormalDepth.fx writes them: the creases and contact
+	// areas are where sample sets and reduced modes differ.
+	void MakeNormalDepthMap(UINT width, UINT height, SsaoReference::NormalDepthMap& map)
+	{
+		map.Width  = width;
+		map.Height = height;
+		map.FovY   = 0.25f*MathHelper::Pi;
+		map.FarZ   = 1000.0f;
+		map.Texels.resize(width*height);
+
+		const float floorY = -1.0f;
+		const float wallZ  = 12.0f;
+		const XMFLOAT4 spheres[] =
+		{
+			XMFLOAT4(-2.5f, -0.2f, 7.0f, 0.8f),
+			XMFLOAT4( 0.0f, -0.4f, 6.0f, 0.6f),
+			XMFLOAT4( 2.2f,  0.0f, 8.0f, 1.0f),
+			XMFLOAT4( 1.0f, -0.7f, 4.5f, 0.3f)
+		};
+
+		const float tanHalfFovY = tanf(0.5f*map.FovY);
+		const float aspect = (float)width / (float)height;
+
+		for(UINT y = 0; y < height; ++y)
+		{
+			for(UINT x = 0; x < width; ++x)
+			{
+				// With dir.z = 1 the ray parameter is the view space depth.
+				float u = ((float)x + 0.5f) / (float)width;
+				float v = ((float)y + 0.5f) / (float)height;
+				XMFLOAT3 dir((2.0f*u - 1.0f)*aspect*tanHalfFovY, (1.0f - 2.0f*v)*tanHalfFovY, 1.0f);
+
+				float depth = wallZ;
+				XMFLOAT3 normal(0.0f, 0.0f, -1.0f);
+
+				if( dir.y < 0.0f && floorY/dir.y < depth )
+				{
+					depth  = floorY/dir.y;
+					normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+				}
+
+				float a = dir.x*dir.x + dir.y*dir.y + dir.z*dir.z;
+				for(int s = 0; s < 4; ++s)
+				{
+					const XMFLOAT4& c = spheres[s];
+					float b = dir.x*c.x + dir.y*c.y + dir.z*c.z;
+					float disc = b*b - a*(c.x*c.x + c.y*c.y + c.z*c.z - c.w*c.w);
+					if( disc < 0.0f )
+						continue;
+
+					float t = (b - sqrtf(disc))/a;
+					if( t > 0.0f && t < depth )
+					{
+						depth  = t;
+						normal = XMFLOAT3((t*dir.x - c.x)/c.w, (t*dir.y - c.y)/c.w, (t*dir.z - c.z)/c.w);
+					}
+				}
+
+				map.Texels[y*width + x] = XMFLOAT4(normal.x, normal.y, normal.z, depth);
+			}
+		}
+	}
+
+	void BenchSsaoReference(BenchmarkHarness& bench)
+	{
+		// A 320x240 normal/depth map and a half size ambient map, as the demos
+		// run the occlusion pass.
+		SsaoReference::NormalDepthMap normalDepth;
+		MakeNormalDepthMap(320, 240, normalDepth);
+		const UINT width  = normalDepth.Width/2;
+		const UINT height = normalDepth.Height/2;
+
+		// The Ssao class's 14 cube offsets and white noise rotations.
+		SsaoReference reference;
+		std::vector<float> ambient;
+		reference.ComputeSsao(normalDepth, width, height, ambient);
+
+		// The open wall must be unoccluded and the contacts occluded.
+		float lo = 1.0f;
+		float hi = 0.0f;
+		for(size_t i = 0; i < ambient.size(); ++i)
+		{
+			lo = MathHelper::Min(lo, ambient[i]);
+			hi = MathHelper::Max(hi, ambient[i]);
+		}
+
+		if( !(lo >= 0.0f && lo < 0.5f && hi > 0.99f && hi <= 1.0f) )
+		{
+			std::ostringstream reason;
+			reason << "ambient map spans [" << lo << ", " << hi << "]";
+			bench.Skip("SsaoReference::ComputeSsao", reason.str());
+			return;
+		}
+
+		bench.Run("SsaoReference::ComputeSsao", "pixels", width*height, [&]()
+		{
+			reference.ComputeSsao(normalDepth, width, height, ambient);
+			BenchmarkHarness::Consume(ambient[ambient.size()/2]);
+		});
+
+		std::vector<float> blurred;
+		bench.Run("SsaoReference::BlurAmbientMap 4", "pixels", width*height, [&]()
+		{
+			blurred = ambient;
+			reference.BlurAmbientMap(normalDepth, width, height, blurred, 4);
+			BenchmarkHarness::Consume(blurred[blurred.size()/2]);
+		});
+
+		// The offline search for the fewest samples of each set whose blurred map
+		// is within an RMS of 0.01 of 64 blue noise samples.
+		const SsaoKernel::Distribution dists[] = { SsaoKernel::Cube, SsaoKernel::Stratified, SsaoKernel::BlueNoise };
+		const char* distNames[] = { "Cube", "Stratified", "BlueNoise" };
+		const float maxError = 0.01f;
+		for(int d = 0; d < 3; ++d)
+		{
+			std::string name = std::string("SsaoReference::Cheapest ") + distNames[d];
+
+			UINT count = 0;
+			if( !bench.Run(name, "searches", 1, [&]()
+			{
+				count = reference.FindCheapestSampleCount(normalDepth, width, height, dists[d], 1, 32, 64, 4, maxError, Seed);
+				BenchmarkHarness::Consume(count);
+			}) )
+				continue;
+
+			std::ostringstream note;
+			if( count > 0 )
+				note << count << " samples within RMS " << maxError;
+			else
+				note << "no count up to 32 within RMS " << maxError;
+			bench.Annotate(name, note.str());
+		}
+	}
+
+	void BenchSsaoPipeline(BenchmarkHarness& bench, const std::string& root)
+	{
+		// The first scene dump of the ScreenSpaceAO sample, else the ray cast scene
+		// of BenchSsaoReference.
+		SsaoReference::NormalDepthMap normalDepth;
+		if( !SsaoPipeline::LoadSceneBinFile(root + "/Media/SSAO11/Medusa_Warrior.bin", normalDepth) )
+			MakeNormalDepthMap(320, 240, normalDepth);
+
+		const UINT pixelCount = normalDepth.Width*normalDepth.Height;
+
+		SsaoReference reference;
+
+		// Full resolution with every sample and no history is the reference itself.
+		SsaoPipeline::Desc desc;
+		desc.Res = SsaoPipeline::FullRes;
+		SsaoPipeline::Comparison full = SsaoPipeline::Compare(normalDepth, reference, desc, 1);
+		if( full.RootMeanSquareError > 1e-4f )
+		{
+			std::ostringstream reason;
+			reason << "full resolution differs from the reference by RMS " << full.RootMeanSquareError;
+			bench.Skip("SsaoPipeline Full AllSamples", reason.str());
+			return;
+		}
+
+		// Every mode run for 8 frames of a static view, so the history has settled,
+		// then timed a frame at a time and annotated with its error against the
+		// full resolution, all samples map.
+		const SsaoPipeline::Resolution resolutions[] = { SsaoPipeline::FullRes, SsaoPipeline::HalfRes, SsaoPipeline::QuarterRes };
+		const char* resolutionNames[] = { "Full", "Half", "Quarter" };
+		const SsaoPipeline::SamplingMode modes[] = { SsaoPipeline::AllSamples, SsaoPipeline::Interleaved2x2, SsaoPipeline::Checkerboard };
+		const char* modeNames[] = { "AllSamples", "Interleaved2x2", "Checkerboard" };
+
+		std::vector<float> ambient;
+		for(int r = 0; r < 3; ++r)
+		{
+			for(int m = 0; m < 3; ++m)
+			{
+				std::string name = std::string("SsaoPipeline ") + resolutionNames[r] + " " + modeNames[m];
+
+				desc.Res = resolutions[r];
+				desc.Sampling = modes[m];
+				desc.HistoryWeight = modes[m] == SsaoPipeline::AllSamples ? 0.0f : 0.75f;
+
+				SsaoPipeline pipeline;
+				pipeline.SetDesc(desc);
+				for(int frame = 0; frame < 8; ++frame)
+					pipeline.Execute(normalDepth, XMMatrixIdentity(), ambient);
+
+				if( !bench.Run(name, "pixels", pixelCount, [&]()
+				{
+					pipeline.Execute(normalDepth, XMMatrixIdentity(), ambient);
+					BenchmarkHarness::Consume(ambient[pixelCount/2]);
+				}) )
+					continue;
+
+				SsaoPipeline::Comparison c = SsaoPipeline::Compare(normalDepth, reference, desc, 8);
+
+				std::ostringstream note;
+				note << std::fixed << std::setprecision(4) << "RMS " << c.RootMeanSquareError
+					<< ", max " << c.MaxError << " against the reference ("
+					<< std::setprecision(1) << c.ReferenceMs << " ms)";
+				bench.Annotate(name, note.str());
+			}
+		}
+	}
+
+	// One texel of the 2D convolution with the outer product of kernel, CLAMP
+	// addressing, summed term by term with no separable passes.
+	XMFLOAT4 ConvolveTexel(const ImageFilter::Image& src, const std::vector<float>& kernel, int x, int y)
+	{
+		const int radius = (int)kernel.size()/2;
+		XMFLOAT4 sum(0.0f, 0.0f, 0.0f, 0.0f);
+		for(int j = -radius; j <= radius; ++j)
+		{
+			int sy = MathHelper::Clamp(y + j, 0, (int)src.Height - 1);
+			for(int i = -radius; i <= radius; ++i)
+			{
+				int sx = MathHelper::Clamp(x + i, 0, (int)src.Width - 1);
+				float w = kernel[i + radius]*kernel[j + radius];
+				const XMFLOAT4& c = src.Texels[sy*src.Width + sx];
+				sum.x += w*c.x;
+				sum.y += w*c.y;
+				sum.z += w*c.z;
+				sum.w += w*c.w;
+			}
+		}
+
+		return sum;
+	}
+
+	// Texels of one pass of filtered that differ from the direct convolution of src.
+	UINT CountConvolutionMismatches(const ImageFilter::Image& src, const ImageFilter::Image& filtered,
+		const std::vector<float>& kernel, float tolerance)
+	{
+		UINT mismatches = 0;
+		for(UINT y = 0; y < src.Height; ++y)
+		{
+			for(UINT x = 0; x < src.Width; ++x)
+			{
+				XMFLOAT4 a = ConvolveTexel(src, kernel, x, y);
+				const XMFLOAT4& b = filtered.Texels[y*src.Width + x];
+				mismatches += !(fabsf(a.x - b.x) <= tolerance && fabsf(a.y - b.y) <= tolerance &&
+					fabsf(a.z - b.z) <= tolerance && fabsf(a.w - b.w) <= tolerance);
+			}
+		}
+
+		return mismatches;
+	}
+
+	void BenchImageFilter(BenchmarkHarness& bench)
+	{
+		// An 800x600 RGBA8 image, the Blur demos' back buffer size: gradients,
+		// hard edged squares and noise.
+		const UINT width  = 800;
+		const UINT height = 600;
+		std::mt19937 rng(Seed);
+		std::uniform_int_distribution<int> noise(-24, 24);
+
+		std::vector<BYTE> rgba(4*width*height);
+		for(UINT y = 0; y < height; ++y)
+		{
+			for(UINT x = 0; x < width; ++x)
+			{
+				bool square = ((x/40) + (y/40)) % 2 == 0;
+				int c[4] = { (int)(255*x/width), (int)(255*y/height), square ? 220 : 30, 255 };
+				for(int k = 0; k < 3; ++k)
+					rgba[4*(y*width + x) + k] = (BYTE)MathHelper::Clamp(c[k] + noise(rng), 0, 255);
+				rgba[4*(y*width + x) + 3] = (BYTE)c[3];
+			}
+		}
+
+		ImageFilter::Image src;
+		src.FromRGBA8(&rgba[0], width, height, 4*width);
+		ImageFilter::Image dst;
+
+		const float tolerance = 1e-5f;
+		struct KernelCase
+		{
+			const char* Name;
+			std::vector<float> Kernel;
+		};
+		KernelCase kernels[] =
+		{
+			{ "ImageFilter::BlurSeparable Gauss 5", ImageFilter::BuildGaussianKernel(2.5f, 5) },
+			{ "ImageFilter::BlurSeparable Blur.fx", ImageFilter::BuildComputeShaderKernel() }
+		};
+
+		for(int k = 0; k < 2; ++k)
+		{
+			ImageFilter::BlurSeparable(src, dst, kernels[k].Kernel, 1);
+			UINT mismatches = CountConvolutionMismatches(src, dst, kernels[k].Kernel, tolerance);
+			if( mismatches > 0 )
+			{
+				std::ostringstream reason;
+				reason << mismatches << " texels differ from a direct convolution";
+				bench.Skip(kernels[k].Name, reason.str());
+				continue;
+			}
+
+			bench.Run(kernels[k].Name, "pixels", width*height, [&]()
+			{
+				ImageFilter::BlurSeparable(src, dst, kernels[k].Kernel, 1);
+				BenchmarkHarness::Consume(dst.Texels[width*height/2].x);
+			});
+		}
+
+		// BlurEven.fx's five linear taps against the 9 tap binomial kernel they
+		// stand for.
+		ImageFilter::LinearTap blurEven[5] =
+		{
+			{ -3.2307692308f, 0.0702702703f }, { -1.3846153846f, 0.3162162162f }, { 0.0f, 0.2270270270f },
+			{  1.3846153846f, 0.3162162162f }, {  3.2307692308f, 0.0702702703f }
+		};
+		std::vector<ImageFilter::LinearTap> taps(blurEven, blurEven + 5);
+
+		ImageFilter::BlurLinearTaps(src, dst, taps, 1);
+		UINT mismatches = CountConvolutionMismatches(src, dst, ImageFilter::BuildBinomialKernel(4), tolerance);
+		if( mismatches > 0 )
+		{
+			std::ostringstream reason;
+			reason << mismatches << " texels differ from the binomial kernel";
+			bench.Skip("ImageFilter::BlurLinearTaps BlurEven", reason.str());
+		}
+		else
+		{
+			bench.Run("ImageFilter::BlurLinearTaps BlurEven", "pixels", width*height, [&]()
+			{
+				ImageFilter::BlurLinearTaps(src, dst, taps, 1);
+				BenchmarkHarness::Consume(dst.Texels[width*height/2].x);
+			});
+		}
+
+		const int boxRadius = 5;
+		ImageFilter::BoxBlur(src, dst, boxRadius);
+		mismatches = CountConvolutionMismatches(src, dst, std::vector<float>(2*boxRadius + 1, 1.0f/(2*boxRadius + 1)), tolerance);
+		if( mismatches > 0 )
+		{
+			std::ostringstream reason;
+			reason << mismatches << " texels differ from a direct convolution";
+			bench.Skip("ImageFilter::BoxBlur 5", reason.str());
+		}
+		else
+		{
+			bench.Run("ImageFilter::BoxBlur 5", "pixels", width*height, [&]()
+			{
+				ImageFilter::BoxBlur(src, dst, boxRadius);
+				BenchmarkHarness::Consume(dst.Texels[width*height/2].x);
+			});
+		}
+
+		// Three boxes stand in for a Gaussian; how close they get is part of the
+		// result rather than a pass/fail check.
+		ImageFilter::Image gaussian;
+		ImageFilter::BlurSeparable(src, gaussian, ImageFilter::BuildGaussianKernel(2.5f, 8), 1);
+		if( bench.Run("ImageFilter::BlurGaussianBoxes 2.5", "pixels", width*height, [&]()
+		{
+			ImageFilter::BlurGaussianBoxes(src, dst, 2.5f);
+			BenchmarkHarness::Consume(dst.Texels[width*height/2].x);
+		}) )
+		{
+			std::ostringstream note;
+			note << "max " << ImageFilter::MaxDifference(dst, gaussian) << " from a radius 8 Gaussian";
+			bench.Annotate("ImageFilter::BlurGaussianBoxes 2.5", note.str());
+		}
+	}
+
+	// The values of the first "name[n] = { ... }" in an effect file's text.
+	std::vector<float> ReadHlslArray(const std::string& text, const std::string& name)
+	{
+		std::vector<float> values;
+
+		size_t at = text.find(name + "[");
+		size_t begin = at == std::string::npos ? at : text.find('{', at);
+		size_t end = begin == std::string::npos ? begin : text.find('}', begin);
+		if( end == std::string::npos )
+			return values;
+
+		std::istringstream ins(text.substr(begin + 1, end - begin - 1));
+		float value;
+		char comma;
+		while( ins >> value )
+		{
+			values.push_back(value);
+			ins >> comma;
+		}
+
+		return values;
+	}
+
+	// Kernels that MergeTaps and ExpandTaps do not carry through unchanged, and
+	// taps of BlurEven.fx that differ from BuildBinomialTaps(4).
+	UINT CountBlurKernelMismatches(const std::string& blurEvenText)
+	{
+		UINT mismatches = 0;
+		for(int radius = 1; radius <= 8; ++radius)
+		{
+			std::vector<float> kernels[2] =
+			{
+				ImageFilter::BuildGaussianKernel(0.5f*radius, radius),
+				ImageFilter::BuildBinomialKernel(radius)
+			};
+
+			for(int k = 0; k < 2; ++k)
+			{
+				std::vector<ImageFilter::LinearTap> taps = BlurKernel::MergeTaps(kernels[k]);
+				std::vector<float> expanded = BlurKernel::ExpandTaps(taps, radius);
+
+				bool same = taps.size() == (size_t)(2*((radius + 1)/2) + 1);
+				for(int i = 0; i <= 2*radius; ++i)
+					same = same && fabsf(expanded[i] - kernels[k][i]) <= 1e-6f;
+				mismatches += !same;
+			}
+		}
+
+		// The shader holds the center and the right half.
+		std::vector<float> offsets = ReadHlslArray(blurEvenText, "offset");
+		std::vector<float> weights = ReadHlslArray(blurEvenText, "weight");
+		std::vector<ImageFilter::LinearTap> taps = BlurKernel::BuildBinomialTaps(4);
+		if( offsets.size() != 3 || weights.size() != 3 )
+			return mismatches + 1;
+
+		for(int i = 0; i < 3; ++i)
+		{
+			mismatches += !(fabsf(offsets[i] - taps[2 + i].Offset) <= 1e-5f &&
+				fabsf(weights[i] - taps[2 + i].Weight) <= 1e-5f);
+		}
+
+		return mismatches;
+	}
+
+	void BenchBlurKernel(BenchmarkHarness& bench, const std::string& root)
+	{
+		std::ifstream fin((root + "/Blur/LinearSamplingBlur/FX/BlurEven.fx").c_str());
+		if( !fin )
+		{
+			bench.Skip("BlurKernel::BuildGaussianTaps", "BlurEven.fx not found under -root");
+			return;
+		}
+
+		std::ostringstream blurEven;
+		blurEven << fin.rdbuf();
+
+		UINT mismatches = CountBlurKernelMismatches(blurEven.str());
+		if( mismatches > 0 )
+		{
+			std::ostringstream reason;
+			reason << mismatches << " kernels or BlurEven.fx taps differ from their merged taps";
+			bench.Skip("BlurKernel::BuildGaussianTaps", reason.str());
+			return;
+		}
+
+		// Kernels for sigma 0.5 to 8 within 1e-3 of the untruncated Gaussian, as
+		// BlurFilter builds them on a resize.
+		const UINT kernelCount = 16;
+		BlurKernel::Report report;
+		if( bench.Run("BlurKernel::BuildGaussianTaps", "kernels", kernelCount, [&]()
+		{
+			size_t taps = 0;
+			for(UINT i = 1; i <= kernelCount; ++i)
+				taps += BlurKernel::BuildGaussianTaps(0.5f*i, 1e-3f, &report).size();
+			BenchmarkHarness::Consume((double)taps);
+		}) )
+		{
+			bench.Annotate("BlurKernel::BuildGaussianTaps", "sigma 8: " + BlurKernel::FormatReport(report));
+		}
+	}
+
+	// Entries that are not in key order, or whose equal keys lost their submission
+	// order, against a stable comparison sort of the same entries.
+	UINT CountRenderQueueMismatches(const RenderQueue& queue, const std::vector<RenderQueue::Entry>& submitted)
+	{
+		std::vector<RenderQueue::Entry> expected(submitted);
+		std::stable_sort(expected.begin(), expected.end(), [](const RenderQueue::Entry& a, const RenderQueue::Entry& b)
+		{
+			return a.Key < b.Key;
+		});
+
+		if( queue.Size() != expected.size() )
+			return (UINT)expected.size();
+
+		UINT mismatches = 0;
+		for(UINT i = 0; i < queue.Size(); ++i)
+			mismatches += queue[i].Key != expected[i].Key || queue[i].Item != expected[i].Item;
+
+		// Every layer's range must start at its first key.
+		for(UINT l = 0; l < RenderQueue::MaxLayers; ++l)
+		{
+			UINT64 layerKey = (UINT64)l << (64 - RenderQueue::LayerBits);
+			UINT expectedFirst = (UINT)(std::lower_bound(expected.begin(), expected.end(), layerKey,
+				[](const RenderQueue::Entry& e, UINT64 key) { return e.Key < key; }) - expected.begin());
+
+			UINT first, count;
+			queue.GetLayerRange(l, first, count);
+			mismatches += first != expectedFirst;
+		}
+
+		return mismatches;
+	}
+
+	void BenchRenderQueue(BenchmarkHarness& bench)
+	{
+		// 10k draws submitted a layer at a time like StencilDemo's: 8000 opaque ones
+		// sorted by state and 2000 transparent ones sorted back to front, over 256
+		// materials and 512 meshes.  The camera moves between frames, so every draw's
+		// depth drifts a little each frame and the frames cycle through 64 of them.
+		const UINT drawCount = 10000;
+		const UINT opaqueCount = 8000;
+		const UINT frameCount = 64;
+		const double targetUs = 50.0;
+		std::mt19937 rng(Seed);
+		std::uniform_int_distribution<UINT> material(0, 255);
+		std::uniform_int_distribution<UINT> geometry(0, 511);
+		std::uniform_real_distribution<float> depth(1.0f, 1000.0f);
+		std::uniform_real_distribution<float> drift(-0.05f, 0.05f);
+
+		std::vector<std::vector<RenderQueue::Entry>> frames(frameCount, std::vector<RenderQueue::Entry>(drawCount));
+		for(UINT i = 0; i < drawCount; ++i)
+		{
+			UINT layer = i < opaqueCount ? 0 : 3;
+			RenderQueue::SortOrder order = layer == 3 ? RenderQueue::BackToFront : RenderQueue::StateFirst;
+			UINT m = material(rng);
+			UINT g = geometry(rng);
+			float z = depth(rng);
+			float dz = drift(rng);
+
+			for(UINT f = 0; f < frameCount; ++f)
+			{
+				frames[f][i].Key  = RenderQueue::BuildKey(layer, layer, m, g, z + f*dz, 1.0f, 1000.0f, order);
+				frames[f][i].Item = i < opaqueCount ? i : i - opaqueCount;
+			}
+		}
+
+		// Every frame in turn must come out as a stable sort would order it, both
+		// when the queue reuses the last frame's order and when it sorts afresh.
+		RenderQueue queue;
+		RenderQueue coldQueue;
+		coldQueue.SetIncremental(false);
+
+		UINT mismatches = 0;
+		UINT reused = 0;
+		for(UINT f = 0; f <= frameCount; ++f)
+		{
+			const std::vector<RenderQueue::Entry>& submitted = frames[f % frameCount];
+
+			queue.Clear();
+			coldQueue.Clear();
+			for(UINT i = 0; i < drawCount; ++i)
+			{
+				queue.Submit(submitted[i].Key, submitted[i].Item);
+				coldQueue.Submit(submitted[i].Key, submitted[i].Item);
+			}
+			queue.Sort();
+			coldQueue.Sort();
+
+			mismatches += CountRenderQueueMismatches(queue, submitted);
+			mismatches += CountRenderQueueMismatches(coldQueue, submitted);
+			reused += queue.WasIncremental();
+		}
+
+		if( mismatches > 0 || reused == 0 )
+		{
+			std::ostringstream reason;
+			if( mismatches > 0 )
+				reason << mismatches << " entries differ from a stable sort";
+			else
+				reason << "the last frame's order was never reused";
+			bench.Skip("RenderQueue::Sort 10k", reason.str());
+			bench.Skip("RenderQueue::Sort 10k cold", reason.str());
+			return;
+		}
+
+		// A frame's submit and sort; the sort alone is read back from the queue.
+		struct Case
+		{
+			const char* Name;
+			RenderQueue* Queue;
+		};
+		Case cases[] =
+		{
+			{ "RenderQueue::Sort 10k",      &queue },
+			{ "RenderQueue::Sort 10k cold", &coldQueue }
+		};
+
+		for(UINT c = 0; c < 2; ++c)
+		{
+			RenderQueue& q = *cases[c].Queue;
+			std::vector<double> sortMs;
+			UINT frame = 0;
+			if( !bench.Run(cases[c].Name, "draws", drawCount, [&]()
+			{
+				const std::vector<RenderQueue::Entry>& submitted = frames[frame++ % frameCount];
+
+				q.Clear();
+				for(UINT i = 0; i < drawCount; ++i)
+					q.Submit(submitted[i].Key, submitted[i].Item);
+				q.Sort();
+
+				sortMs.push_back(q.LastSortMs());
+				BenchmarkHarness::Consume((double)q[drawCount/2].Item);
+			}) )
+				continue;
+
+			std::sort(sortMs.begin(), sortMs.end());
+			std::ostringstream note;
+			note << std::fixed << std::setprecision(1) << "Sort alone " << sortMs[sortMs.size()/2]*1000.0 << " us median";
+			if( cases[c].Queue == &queue )
+				note << ", target " << targetUs << " us";
+			bench.Annotate(cases[c].Name, note.str());
+		}
+	}
+
+	// Writes the shader and the header it includes for the ShaderCache checks;
+	// editing changes the header only.
+	void WriteShaderSources(const char* shaderFilename, const char* includeFilename, bool edited)
+	{
+		const char* tint = edited ? "0.5f, 0.5f, 0.5f" : "1.0f, 1.0f, 1.0f";
+		std::ofstream(includeFilename) << "float4 Tint() { return float4(" << tint << ", 1.0f); }\n";
+		std::ofstream(shaderFilename) << "#include \"" << includeFilename << "\"\n"
+			"// #include \"commented_out.hlsli\"\n"
+			"float4 VS(float3 p : POSITION) : SV_POSITION { return float4(p, 1.0f); }\n"
+			"float4 PS() : SV_Target { return Tint()*SCALE; }\n";
+	}
+
+	// Properties of ShaderCache with a stub compiler that does not match: duplicate
+	// requests in one GetAll compiled once and sharing their bytecode, a second
+	// cache on the same directory loading every shader from disk, and an edit to an
+	// included header giving the shader a new key and a recompile.
+	UINT CountShaderCacheMismatches(const std::vector<ShaderCache::Request>& requests,
+		const ShaderCache::CompileFn& compile, std::atomic<UINT>& compileCount, const char* includeFilename)
+	{
+		UINT mismatches = 0;
+
+		std::vector<ShaderCache::BytecodePtr> first;
+		std::vector<ShaderCache::BytecodePtr> second;
+		{
+			// requests holds every request twice, the copies in the second half.
+			ShaderCache cache(".", compile);
+			cache.GetAll(requests, first);
+
+			UINT unique = (UINT)requests.size()/2;
+			ShaderCache::Stats stats = cache.GetStats();
+			mismatches += stats.Compiles != unique || compileCount != unique || stats.Failures != 0;
+			for(UINT i = 0; i < unique; ++i)
+				mismatches += !first[i] || first[i] != first[i + unique];
+		}
+
+		{
+			ShaderCache cache(".", compile);
+			cache.GetAll(requests, second);
+
+			ShaderCache::Stats stats = cache.GetStats();
+			mismatches += stats.DiskHits != requests.size()/2 || stats.Compiles != 0;
+			for(size_t i = 0; i < requests.size(); ++i)
+				mismatches += !second[i] || !first[i] || *second[i] != *first[i];
+		}
+
+		std::vector<std::string> includes;
+		UINT64 before = ShaderCache::ComputeKey(requests[0], &includes);
+		mismatches += includes.size() != 1;
+
+		WriteShaderSources(requests[0].Filename.c_str(), includeFilename, true);
+		UINT64 after = ShaderCache::ComputeKey(requests[0]);
+		mismatches += after == before;
+
+		{
+			ShaderCache cache(".", compile);
+			UINT compilesBefore = compileCount;
+			mismatches += !cache.Get(requests[0]) || compileCount != compilesBefore + 1;
+		}
+
+		remove((ShaderCache::KeyToString(after) + ".cso").c_str());
+		WriteShaderSources(requests[0].Filename.c_str(), includeFilename, false);
+		mismatches += ShaderCache::ComputeKey(requests[0]) != before;
+
+		return mismatches;
+	}
+
+	void BenchShaderCache(BenchmarkHarness& bench)
+	{
+		const char* shaderFilename  = "benchmark_shader.fx";
+		const char* includeFilename = "benchmark_shader_common.hlsli";
+		WriteShaderSources(shaderFilename, includeFilename, false);
+
+		// The bytecode stands in for the compiler output: a function of the request.
+		std::atomic<UINT> compileCount(0);
+		ShaderCache::CompileFn compile = [&](const ShaderCache::Request& request, ShaderCache::Bytecode& bytecode, std::string&)
+		{
+			++compileCount;
+			std::string text = request.EntryPoint + " " + request.Target;
+			for(size_t d = 0; d < request.Defines.size(); ++d)
+				text += " " + request.Defines[d].Name + "=" + request.Defines[d].Definition;
+			bytecode.assign(text.begin(), text.end());
+			return true;
+		};
+
+		// Both stages at 16 SCALE variants, then the same 32 requests again.
+		std::vector<ShaderCache::Request> requests;
+		for(int copy = 0; copy < 2; ++copy)
+		{
+			for(int variant = 0; variant < 16; ++variant)
+			{
+				for(int stage = 0; stage < 2; ++stage)
+				{
+					ShaderCache::Request request;
+					request.Filename   = shaderFilename;
+					request.EntryPoint = stage == 0 ? "VS" : "PS";
+					request.Target     = stage == 0 ? "vs_5_0" : "ps_5_0";
+
+					std::ostringstream scale;
+					scale << variant + 1;
+					ShaderCache::Define define = { "SCALE", scale.str() };
+					request.Defines.push_back(define);
+					requests.push_back(request);
+				}
+			}
+		}
+
+		// Files left by an interrupted run would turn the first compiles into disk hits.
+		std::vector<UINT64> keys(requests.size());
+		for(size_t i = 0; i < requests.size(); ++i)
+		{
+			keys[i] = ShaderCache::ComputeKey(requests[i]);
+			remove((ShaderCache::KeyToString(keys[i]) + ".cso").c_str());
+		}
+
+		UINT mismatches = CountShaderCacheMismatches(requests, compile, compileCount, includeFilename);
+		if( mismatches > 0 )
+		{
+			std::ostringstream reason;
+			reason << mismatches << " cache checks failed";
+			bench.Skip("ShaderCache::GetAll", reason.str());
+		}
+		else
+		{
+			// The key of every request: reading the shader and its include and hashing them.
+			bench.Run("ShaderCache::ComputeKey", "requests", (double)requests.size(), [&]()
+			{
+				for(size_t i = 0; i < requests.size(); ++i)
+					BenchmarkHarness::Consume((double)(ShaderCache::ComputeKey(requests[i]) & 0xffff));
+			});
+
+			// A second run of a demo: every shader comes from the files of the first.
+			bench.Run("ShaderCache::GetAll from disk", "requests", (double)requests.size(), [&]()
+			{
+				ShaderCache cache(".", compile);
+				std::vector<ShaderCache::BytecodePtr> results;
+				cache.GetAll(requests, results);
+				BenchmarkHarness::Consume((double)cache.GetStats().DiskHits);
+			});
+		}
+
+		for(size_t i = 0; i < requests.size(); ++i)
+			remove((ShaderCache::KeyToString(keys[i]) + ".cso").c_str());
+		remove(shaderFilename);
+		remove(includeFilename);
+	}
+
+	// FrameResourceRing::UploadContext that keeps its buffers in memory: an arena
+	// per frame and, without range binding, a copy of each committed range per
+	// offset, as D3D11UploadContext keeps them on the GPU.  Bind records the bytes
+	// a shader would see.
+	class MockUploadContext : public FrameResourceRing::UploadContext
+	{
+	public:
+		explicit MockUploadContext(bool rangeBinding) : MapCount(0), mRangeBinding(rangeBinding) {}
+
+		bool SupportsRangeBinding()const
+		{
+			return mRangeBinding;
+		}
+
+		void* MapFrame(UINT frame, UINT frameByteSize)
+		{
+			if( frame >= mArenas.size() )
+				mArenas.resize(frame + 1);
+			mArenas[frame].resize(frameByteSize);
+
+			++MapCount;
+			return mArenas[frame].data();
+		}
+
+		void UnmapFrame(UINT /*frame*/)
+		{
+		}
+
+		void CommitRange(UINT frame, UINT offset, UINT byteSize)
+		{
+			const BYTE* data = &mArenas[frame][offset];
+			mRanges[offset].assign(data, data + byteSize);
+		}
+
+		void Bind(UINT /*slot*/, UINT frame, UINT offset, UINT byteSize)
+		{
+			Bound.clear();
+			if( mRangeBinding )
+			{
+				const BYTE* data = &mArenas[frame][offset];
+				Bound.assign(data, data + byteSize);
+			}
+			else if( mRanges.count(offset) )
+			{
+				Bound = mRanges[offset];
+			}
+		}
+
+		UINT MapCount;
+		std::vector<BYTE> Bound;
+
+	private:
+		bool mRangeBinding;
+		std::vector<std::vector<BYTE>> mArenas;
+		std::map<UINT, std::vector<BYTE>> mRanges;
+	};
+
+	// Frames of a ring over a mock context whose uploads do not match: more than
+	// one map a frame, a commit count other than the elements written since the
+	// frame was last uploaded plus the transient allocations, or a bind that does
+	// not see the latest contents of its element.
+	UINT CountFrameRingMismatches(bool rangeBinding)
+	{
+		const UINT frameCount = 3;
+		const UINT elementCount = 64;
+		const UINT passCount = 2;
+		std::mt19937 rng(Seed);
+
+		FrameResourceRing ring(frameCount, passCount*FrameResourceRing::AlignConstantSize(80));
+		MockUploadContext context(rangeBinding);
+
+		std::vector<UINT> handles(elementCount);
+		std::vector<std::vector<BYTE>> latest(elementCount);
+		std::vector<int> lastWrite(elementCount, -1);
+		for(UINT i = 0; i < elementCount; ++i)
+		{
+			handles[i] = ring.AddPersistent(64 + 16*(i % 8));
+			latest[i].assign(ring.GetPersistent(handles[i]).ByteSize, 0);
+		}
+
+		UINT mismatches = 0;
+		int lastUpload[frameCount] = { -1, -1, -1 };
+		for(int frame = 0; frame < 12; ++frame)
+		{
+			ring.BeginFrame();
+
+			// Everything in the first frame, then a changing subset.
+			UINT expectedCommits = 0;
+			for(UINT i = 0; i < elementCount; ++i)
+			{
+				if( frame == 0 || rng() % 4 == 0 )
+				{
+					for(size_t b = 0; b < latest[i].size(); ++b)
+						latest[i][b] = (BYTE)rng();
+					ring.WritePersistent(handles[i], latest[i].data(), (UINT)latest[i].size());
+					lastWrite[i] = frame;
+				}
+				expectedCommits += lastWrite[i] > lastUpload[ring.CurrentFrame()];
+			}
+
+			std::vector<FrameResourceRing::Allocation> passes(passCount);
+			std::vector<std::vector<BYTE>> passData(passCount, std::vector<BYTE>(80));
+			for(UINT p = 0; p < passCount; ++p)
+			{
+				for(size_t b = 0; b < passData[p].size(); ++b)
+					passData[p][b] = (BYTE)rng();
+				passes[p] = ring.AllocateTransient(80);
+				memcpy(ring.TransientData(passes[p]), passData[p].data(), 80);
+			}
+
+			UINT mapsBefore = context.MapCount;
+			ring.Upload(context);
+			lastUpload[ring.CurrentFrame()] = frame;
+
+			mismatches += context.MapCount != mapsBefore + 1 || ring.LastMapCount() != 1;
+			mismatches += ring.LastCommitCount() != (rangeBinding ? 0 : expectedCommits + passCount);
+
+			for(UINT i = 0; i < elementCount; ++i)
+			{
+				ring.Bind(context, 0, ring.GetPersistent(handles[i]));
+				mismatches += context.Bound != latest[i];
+			}
+			for(UINT p = 0; p < passCount; ++p)
+			{
+				ring.Bind(context, 0, passes[p]);
+				mismatches += context.Bound != passData[p];
+			}
+		}
+
+		return mismatches;
+	}
+
+	void BenchFrameResourceRing(BenchmarkHarness& bench)
+	{
+		UINT mismatches = CountFrameRingMismatches(true) + CountFrameRingMismatches(false);
+		if( mismatches > 0 )
+		{
+			std::ostringstream reason;
+			reason << mismatches << " uploads or binds differ from the mock's expectations";
+			bench.Skip("FrameResourceRing::Upload", reason.str());
+			return;
+		}
+
+		// StencilDemo's layout at scale: 1000 objects, a tenth of them moving each
+		// frame, and two passes, through the copying path.
+		const UINT objectCount = 1000;
+		const int frames = 64;
+		FrameResourceRing ring(3, 2*FrameResourceRing::AlignConstantSize(sizeof(XMFLOAT4X4)*4));
+		MockUploadContext context(false);
+
+		std::vector<UINT> handles(objectCount);
+		for(UINT i = 0; i < objectCount; ++i)
+			handles[i] = ring.AddPersistent(sizeof(XMFLOAT4X4)*2);
+
+		XMFLOAT4X4 world[2];
+		XMStoreFloat4x4(&world[0], XMMatrixIdentity());
+		XMStoreFloat4x4(&world[1], XMMatrixIdentity());
+
+		bench.Run("FrameResourceRing::Upload", "frames", frames, [&]()
+		{
+			for(int frame = 0; frame < frames; ++frame)
+			{
+				ring.BeginFrame();
+				for(UINT i = frame % 10; i < objectCount; i += 10)
+					ring.WritePersistent(handles[i], world);
+				ring.AllocateTransient(sizeof(XMFLOAT4X4)*4);
+				ring.AllocateTransient(sizeof(XMFLOAT4X4)*4);
+
+				ring.Upload(context);
+				BenchmarkHarness::Consume(ring.LastCommitCount());
+			}
+		});
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned runs = 15;
+	std::string filter;
+	std::string jsonFilename = "benchmark.json";
+	std::string root = "../..";
+
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if( arg == "-runs" && hasValue )
+			runs = (unsigned)atoi(argv[++i]);
+		else if( arg == "-filter" && hasValue )
+			filter = argv[++i];
+		else if( arg == "-json" && hasValue )
+			jsonFilename = argv[++i];
+		else if( arg == "-root" && hasValue )
+			root = argv[++i];
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [-runs n] [-filter name] [-json file] [-root dir]" << std::endl;
+			return 1;
+		}
+	}
+
+	// The hot paths carry profiler zones; keep their cost out of the numbers.
+#if PROFILER_ENABLED
+	Profiler::Get().SetEnabled(false);
+#endif
+
+	srand(Seed);
+
+	BenchmarkHarness bench;
+	bench.SetRuns(runs);
+	bench.SetFilter(filter);
+
+	std::string skullText = LoadSkullText(root);
+	Mesh skull;
+	{
+		std::istringstream fin(skullText);
+		ParseSkull(fin, skull);
+	}
+
+	BenchXnaMath(bench);
+	BenchParallelFor(bench);
+	BenchWaves(bench);
+	BenchTerrain(bench, root);
+	BenchOctree(bench, skull);
+	BenchSkinning(bench);
+	BenchGeometryGenerator(bench);
+	BenchSkullLoad(bench, skullText, skull);
+	BenchM3dLoad(bench, root);
+	BenchFrustumCulling(bench, skull);
+	BenchTessellationBuffer(bench, skull, root);
+	BenchPatchCulling(bench, skull);
+	BenchSubDPatches(bench, root);
+	BenchBezierPatches(bench);
+	BenchTextureStreaming(bench, root);
+	BenchParticles(bench);
+	BenchDepthSort(bench);
+	BenchSsaoReference(bench);
+	BenchSsaoPipeline(bench, root);
+	BenchImageFilter(bench);
+	BenchBlurKernel(bench, root);
+	BenchRenderQueue(bench);
+	BenchShaderCache(bench);
+	BenchFrameResourceRing(bench);
+
+	bench.Print(std::cout);
+
+	std::ostringstream build;
+#if defined(_MSC_VER)
+	build << "msvc " << _MSC_VER;
+#elif defined(__clang__)
+	build << "clang " << __clang_major__ << "." << __clang_minor__;
+#elif defined(__GNUC__)
+	build << "gcc " << __GNUC__ << "." << __GNUC_MINOR__;
+#endif
+#ifdef _DEBUG
+	build << " debug";
+#endif
+
+	if( !bench.WriteJson(jsonFilename, build.str()) )
+	{
+		std::cerr << "could not write " << jsonFilename << std::endl;
+		return 1;
+	}
+
+	std::cout << "wrote " << jsonFilename << std::endl;
+	return 0;
+}
@@ -0,0 +1,28 @@
+//***************************************************************************************
+// DXUT.h
+//
+// The nvtesslib sources include DXUT.h as their precompiled header and take
+// std::vector, the min/max macros and, for the cache file, the file functions of
+// Windows.h from it.  The benchmark does not link DXUT, so this header stands in for
+// it and supplies the same names on other compilers.
+//***************************************************************************************
+
+#ifndef DXUT_H
+#define DXUT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#ifdef _WIN32
+
+#include <Windows.h>
+
+#else
+
+using std::min;
+using std::max;
+
+#endif // _WIN32
+
+#endif // DXUT_H
@@ -0,0 +1,13 @@
+//***************************************************************************************
+// XnaMathCheck.cpp
+//
+// XnaMathCheck.inl against the xnamath path the rest of the benchmark uses.
+//***************************************************************************************
+
+#include "XnaMathCheck.h"
+#include "XnaMathPortable.h"
+
+namespace XnaMathNative
+{
+#include "XnaMathCheck.inl"
+}
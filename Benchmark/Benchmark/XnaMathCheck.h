@@ -0,0 +1,42 @@
+//***************************************************************************************
+// XnaMathCheck.h
+//
+// The same xnamath calls compiled twice: once against the path the rest of the
+// benchmark uses (SSE2, or xnamath.h itself on Windows) and once against the plain
+// C++ fallback of XnaMathPortable.h.  Everything goes in and out as floats, since the
+// two builds of XMVECTOR are different types.
+//***************************************************************************************
+
+#ifndef XNAMATHCHECK_H
+#define XNAMATHCHECK_H
+
+#include <vector>
+
+namespace XnaMathNative
+{
+	// Floats of input each case reads.
+	const unsigned CaseInputCount = 24;
+
+	///<summary>
+	/// Runs caseCount cases of vector, quaternion and matrix calls on inputs in
+	/// [-1, 1] and appends every result to results.
+	///</summary>
+	void RunCases(const float* inputs, unsigned caseCount, std::vector<float>& results);
+
+	// XMVector3TransformCoord of count xyz points by m; returns the sum of the y's.
+	float TransformCoords(const float* points, unsigned count, const float m[16]);
+
+	// XMMatrixMultiply of count row-major matrices in turn; returns one element.
+	float MultiplyMatrices(const float* matrices, unsigned count);
+}
+
+namespace XnaMathScalar
+{
+	const unsigned CaseInputCount = 24;
+
+	void RunCases(const float* inputs, unsigned caseCount, std::vector<float>& results);
+	float TransformCoords(const float* points, unsigned count, const float m[16]);
+	float MultiplyMatrices(const float* matrices, unsigned count);
+}
+
+#endif // XNAMATHCHECK_H
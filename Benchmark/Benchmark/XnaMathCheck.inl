@@ -0,0 +1,168 @@
+//***************************************************************************************
+// XnaMathCheck.inl
+//
+// Body of XnaMathCheck.h, included by XnaMathCheck.cpp and XnaMathCheckScalar.cpp
+// inside their own namespace after the xnamath header they test.
+//***************************************************************************************
+
+namespace
+{
+	XMVECTOR Load4(const float* p)
+	{
+		return XMVectorSet(p[0], p[1], p[2], p[3]);
+	}
+
+	XMMATRIX LoadMatrix(const float* m)
+	{
+		XMFLOAT4X4 f(m);
+		return XMLoadFloat4x4(&f);
+	}
+
+	void Append(FXMVECTOR v, std::vector<float>& results)
+	{
+		XMFLOAT4 f;
+		XMStoreFloat4(&f, v);
+		results.push_back(f.x);
+		results.push_back(f.y);
+		results.push_back(f.z);
+		results.push_back(f.w);
+	}
+
+	void Append(CXMMATRIX m, std::vector<float>& results)
+	{
+		XMFLOAT4X4 f;
+		XMStoreFloat4x4(&f, m);
+		results.insert(results.end(), &f._11, &f._11 + 16);
+	}
+
+	// q and -q are the same rotation; pick the one with w >= 0 so paths that take
+	// different branches still compare equal.
+	XMVECTOR CanonicalQuaternion(FXMVECTOR q)
+	{
+		return XMVectorGetW(q) < 0.0f ? XMVectorNegate(q) : q;
+	}
+}
+
+void RunCases(const float* inputs, unsigned caseCount, std::vector<float>& results)
+{
+	for(unsigned i = 0; i < caseCount; ++i)
+	{
+		const float* in = inputs + i*CaseInputCount;
+
+		XMVECTOR a = Load4(in + 0);
+		XMVECTOR b = Load4(in + 4);
+		XMVECTOR c = Load4(in + 8);
+		XMVECTOR d = Load4(in + 12);
+		float angle = XM_PI*in[16];
+		float t = 0.5f*(in[17] + 1.0f);
+
+		// Keep every input away from the degenerate cases (zero length, zero
+		// scale) where the two paths are allowed to differ.
+		XMVECTOR offset = XMVectorSet(2.0f, 0.0f, 0.0f, 1.0f);
+		XMVECTOR axis = XMVector3Normalize(XMVectorAdd(c, offset));
+		XMVECTOR q0 = XMQuaternionNormalize(XMVectorAdd(a, offset));
+		XMVECTOR q1 = XMQuaternionNormalize(XMVectorAdd(b, offset));
+		XMVECTOR scale = XMVectorSet(1.5f + in[18], 1.5f + in[19], 1.5f + in[20], 0.0f);
+		XMVECTOR translation = XMVectorScale(d, 10.0f);
+
+		// Vectors.
+		Append(XMVector3Dot(a, b), results);
+		Append(XMVector4Dot(a, b), results);
+		Append(XMVector3Cross(a, b), results);
+		Append(XMVector3Length(a), results);
+		Append(XMVector3Normalize(XMVectorAdd(a, offset)), results);
+		Append(XMVector4Normalize(XMVectorAdd(b, offset)), results);
+		Append(XMVectorLerp(a, b, t), results);
+		Append(XMVectorMin(a, b), results);
+		Append(XMVectorMax(a, b), results);
+		Append(XMVectorSqrt(XMVectorAbs(c)), results);
+		Append(XMVectorReciprocal(XMVectorSetW(scale, 1.0f)), results);
+		Append(XMVectorSaturate(d), results);
+		Append(XMVectorPermute(a, b, XMVectorPermuteControl(2, 5, 0, 7)), results);
+		Append(XMVectorSelect(a, b, XMVectorSelectControl(1, 0, 1, 0)), results);
+
+		XMVECTOR sinAngle, cosAngle;
+		XMVectorSinCos(&sinAngle, &cosAngle, XMVectorScale(c, XM_PI));
+		Append(sinAngle, results);
+		Append(cosAngle, results);
+
+		XMVECTOR parallel, perpendicular;
+		XMVector3ComponentsFromNormal(&parallel, &perpendicular, a, axis);
+		Append(parallel, results);
+		Append(perpendicular, results);
+		Append(XMVector3AngleBetweenVectors(XMVectorAdd(a, offset), XMVectorAdd(b, offset)), results);
+
+		XMVECTOR plane = XMPlaneNormalize(XMVectorSetW(axis, in[21]));
+		Append(plane, results);
+		Append(XMPlaneDotCoord(plane, b), results);
+		Append(XMPlaneFromPointNormal(a, axis), results);
+
+		// Quaternions.
+		Append(XMQuaternionMultiply(q0, q1), results);
+		Append(XMQuaternionConjugate(q0), results);
+		Append(XMQuaternionSlerp(q0, q1, t), results);
+		Append(CanonicalQuaternion(XMQuaternionRotationAxis(axis, angle)), results);
+		Append(CanonicalQuaternion(XMQuaternionRotationMatrix(XMMatrixRotationQuaternion(q0))), results);
+		Append(XMVector3Rotate(b, q0), results);
+		Append(XMVector3InverseRotate(b, q0), results);
+
+		// Matrices.
+		XMMATRIX M = XMMatrixAffineTransformation(scale, XMVectorZero(), q0, translation);
+		XMMATRIX R = XMMatrixRotationAxis(axis, angle);
+		Append(M, results);
+		Append(R, results);
+		Append(XMMatrixRotationX(angle), results);
+		Append(XMMatrixRotationY(angle), results);
+		Append(XMMatrixRotationZ(angle), results);
+		Append(XMMatrixRotationQuaternion(q1), results);
+		Append(XMMatrixMultiply(M, R), results);
+		Append(XMMatrixTranspose(M), results);
+		Append(XMMatrixDeterminant(M), results);
+
+		XMVECTOR det;
+		Append(XMMatrixInverse(&det, M), results);
+		Append(det, results);
+
+		XMVECTOR outScale, outRotation, outTranslation;
+		XMMatrixDecompose(&outScale, &outRotation, &outTranslation, M);
+		Append(outScale, results);
+		Append(CanonicalQuaternion(outRotation), results);
+		Append(outTranslation, results);
+
+		XMVECTOR eye = XMVectorSetW(XMVectorScale(a, 10.0f), 1.0f);
+		XMVECTOR target = XMVectorAdd(eye, XMVectorScale(axis, 5.0f));
+		Append(XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)), results);
+		Append(XMMatrixPerspectiveFovLH(0.25f*XM_PI*(1.5f + in[22]), 1.0f + t, 1.0f, 1000.0f), results);
+		Append(XMMatrixOrthographicLH(10.0f + in[22], 10.0f + in[23], 0.5f, 100.0f), results);
+		Append(XMMatrixReflect(plane), results);
+		Append(XMMatrixShadow(plane, XMVectorSetW(XMVectorScale(b, 20.0f), 1.0f)), results);
+
+		Append(XMVector3Transform(b, M), results);
+		Append(XMVector3TransformCoord(b, XMMatrixMultiply(M, R)), results);
+		Append(XMVector3TransformNormal(b, M), results);
+		Append(XMVector4Transform(b, R), results);
+	}
+}
+
+float TransformCoords(const float* points, unsigned count, const float m[16])
+{
+	XMMATRIX M = LoadMatrix(m);
+	XMVECTOR sum = XMVectorZero();
+	for(unsigned i = 0; i < count; ++i)
+	{
+		XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(points + 3*i));
+		sum = XMVectorAdd(sum, XMVector3TransformCoord(p, M));
+	}
+	return XMVectorGetY(sum);
+}
+
+float MultiplyMatrices(const float* matrices, unsigned count)
+{
+	XMMATRIX P = XMMatrixIdentity();
+	for(unsigned i = 0; i < count; ++i)
+		P = XMMatrixMultiply(P, LoadMatrix(matrices + 16*i));
+
+	XMFLOAT4X4 f;
+	XMStoreFloat4x4(&f, P);
+	return f._11;
+}
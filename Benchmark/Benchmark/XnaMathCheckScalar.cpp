@@ -0,0 +1,29 @@
+//***************************************************************************************
+// XnaMathCheckScalar.cpp
+//
+// XnaMathCheck.inl against the plain C++ path of XnaMathPortable.h, whatever the
+// compiler targets.  The header is included inside XnaMathScalar so its types and
+// functions do not clash with the SSE2 ones of the other translation units.  The
+// standard headers it pulls in are included first, outside the namespace, so the
+// ones inside it are skipped by their include guards.
+//***************************************************************************************
+
+#include "XnaMathCheck.h"
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#define XM_PORTABLE
+#define _XM_NO_INTRINSICS_
+
+namespace XnaMathScalar
+{
+#include "XnaMathPortable.h"
+#include "XnaMathCheck.inl"
+}
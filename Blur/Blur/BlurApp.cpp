@@ -162,7 +162,7 @@ private:
 	std::vector<std::pair<int, std::string>> mRenderLayerConstantBuffer[Count];
 	std::unique_ptr<PipelineStateObject> mPSOs[Count];
 
-	std::unordered_map<std::string, ComPtr<ID3D11Buffer>> mConstantBuffers;
+	std::unordered_map<std::string, FrameResourceRing::Allocation> mPassAllocations;
 
 	ComPtr<ID3D11ShaderResourceView> mOffscreenSRV;
 	ComPtr<ID3D11UnorderedAccessView> mOffscreenUAV;
@@ -424,10 +424,14 @@ void BlurApp::BuildMaterials()
 
 void BlurApp::UpdateScene(float dt)
 {
+	mFrameResource->Ring.BeginFrame();
+
 	OnKeyBoardInput(dt);
 	UpdateCamera(dt);
 	UpdateMainPassCB(dt);
 	UploadObjects();
+
+	mFrameResource->Ring.Upload(mFrameResource->Upload);
 }
 
 void BlurApp::OnKeyBoardInput(float dt)
@@ -465,11 +469,11 @@ void BlurApp::DrawRenderItems(RenderLayer layer)
 		pPSO->depthStencil.StencilRef);
 	md3dImmediateContext->RSSetState(pPSO->pResterizer);
 
-	std::array<ID3D11Buffer*, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT> ConstantBuffers;
-	ConstantBuffers.assign(nullptr);
+	auto& ring = mFrameResource->Ring;
+	auto& upload = mFrameResource->Upload;
 	auto& cbuffers = mRenderLayerConstantBuffer[(int)layer];
 	for (auto cb : cbuffers) {
-		ConstantBuffers[cb.first] = mConstantBuffers[cb.second].Get();
+		ring.Bind(upload, cb.first, mPassAllocations[cb.second]);
 	}
 
 	const std::vector<RenderItem*>& ritems = mRitemLayer[(int)layer];
@@ -485,11 +489,8 @@ void BlurApp::DrawRenderItems(RenderLayer layer)
 		UINT vstride = geo->VertexByteStride, offset = 0;
 		md3dImmediateContext->IASetVertexBuffers(0, 1, &pvb, &vstride, &offset);
 
-		ConstantBuffers[0] = mFrameResource->ObjectCB->Resource(ri->ObjCBIndex);
-		ConstantBuffers[1] = mFrameResource->MaterialCB->Resource(ri->Mat->MatCBIndex);
-		md3dImmediateContext->VSSetConstantBuffers(0, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, ConstantBuffers.data());
-		md3dImmediateContext->PSSetConstantBuffers(0, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, ConstantBuffers.data());
-		md3dImmediateContext->GSSetConstantBuffers(0, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, ConstantBuffers.data());
+		ring.Bind(upload, 0, ring.GetPersistent(mFrameResource->ObjectCB[ri->ObjCBIndex]));
+		ring.Bind(upload, 1, ring.GetPersistent(mFrameResource->MaterialCB[ri->Mat->MatCBIndex]));
 
 		std::array<ID3D11ShaderResourceView*, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT> SRV;
 		auto textureName = ri->Mat->DiffuseSrv;
@@ -1007,9 +1008,8 @@ void BlurApp::AddRenderItems(
  
 void BlurApp::BuildFrameResources()
 {
-	mFrameResource = std::make_unique<FrameResource>(md3dDevice, 1, (UINT)mAllRitems.size(), (UINT)mMaterials.size());
+	mFrameResource = std::make_unique<FrameResource>(md3dDevice, md3dImmediateContext, 1, (UINT)mAllRitems.size(), (UINT)mMaterials.size());
 
-	mConstantBuffers["MainPass"] = mFrameResource->PassCB->Resource(0);
 	for (int i = 0; i < (int)RenderLayer::Count; i++)
 		mRenderLayerConstantBuffer[i].push_back({ 2, "MainPass" });
 
@@ -1021,7 +1021,7 @@ void BlurApp::BuildFrameResources()
 		obj.World = world;
 		obj.WorldInvTranspose = worldInvTranspose;
 		obj.TexTransform = XMLoadFloat4x4(&mAllRitems[i]->TexTransform);
-		mFrameResource->ObjectCB->UploadData(md3dImmediateContext, mAllRitems[i]->ObjCBIndex, obj);
+		mFrameResource->Ring.WritePersistent(mFrameResource->ObjectCB[mAllRitems[i]->ObjCBIndex], obj);
 	}
 
 	for (auto& m : mMaterials) {
@@ -1030,7 +1030,7 @@ void BlurApp::BuildFrameResources()
 		matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
 		matConstants.FresnelR0 = mat->FresnelR0;
 		matConstants.Roughness = mat->Roughness;
-		mFrameResource->MaterialCB->UploadData(md3dImmediateContext, mat->MatCBIndex, matConstants);
+		mFrameResource->Ring.WritePersistent(mFrameResource->MaterialCB[mat->MatCBIndex], matConstants);
 	}
 }
 
@@ -1063,7 +1063,7 @@ void BlurApp::UpdateMainPassCB(float dt)
 	MainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
 	MainPassCB.Lights[2].Strength = { 0.2f, 0.2f, 0.2f };
 
-	mFrameResource->PassCB->UploadData(md3dImmediateContext, 0, MainPassCB);
+	mPassAllocations["MainPass"] = mFrameResource->Ring.PushTransient(MainPassCB);
 }
  
 void BlurApp::UploadMaterials()
@@ -1074,7 +1074,7 @@ void BlurApp::UploadMaterials()
 		matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
 		matConstants.FresnelR0 = mat->FresnelR0;
 		matConstants.Roughness = mat->Roughness;
-		mFrameResource->MaterialCB->UploadData(md3dImmediateContext, mat->MatCBIndex, matConstants);
+		mFrameResource->Ring.WritePersistent(mFrameResource->MaterialCB[mat->MatCBIndex], matConstants);
 	}
 }
 
@@ -1089,7 +1089,7 @@ void BlurApp::UploadObjects()
 		obj.World = world;
 		obj.WorldInvTranspose = worldInvTranspose;
 		obj.TexTransform = XMLoadFloat4x4(&mAllRitems[i]->TexTransform);
-		mFrameResource->ObjectCB->UploadData(md3dImmediateContext, mAllRitems[i]->ObjCBIndex, obj);
+		mFrameResource->Ring.WritePersistent(mFrameResource->ObjectCB[mAllRitems[i]->ObjCBIndex], obj);
 		mAllRitems[i]->bDirty = false;
 	}
 }
@@ -1,10 +1,15 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D11Device * device, UINT passCount, UINT objectCount, UINT materialCount)
+// The geometry shader reads the same constants as the vertex and pixel shaders,
+// so the upload context binds them to all three stages.
+FrameResource::FrameResource(ID3D11Device * device, ID3D11DeviceContext * dc, UINT passCount, UINT objectCount, UINT materialCount)
+    : Ring(gNumFrameResources, passCount*FrameResourceRing::AlignConstantSize(sizeof(PassConstants))),
+      Upload(device, dc, true)
 {
-    PassCB = std::make_unique<ConstantBuffer<PassConstants>>(device, passCount);
-    MaterialCB = std::make_unique<ConstantBuffer<MaterialConstants>>(device, materialCount);
-    ObjectCB = std::make_unique<ConstantBuffer<ObjectConstants>>(device, objectCount);
+    for (UINT i = 0; i < materialCount; i++)
+        MaterialCB.push_back(Ring.AddPersistent(sizeof(MaterialConstants)));
+    for (UINT i = 0; i < objectCount; i++)
+        ObjectCB.push_back(Ring.AddPersistent(sizeof(ObjectConstants)));
 }
 
 FrameResource::~FrameResource()
@@ -4,10 +4,6 @@
 
 #include "BlurFilter.h"
 #include "Effects.h"
-#include <algorithm>
-#include <iterator>
-#include <string.h>
-#include <numeric>
 
 BlurFilter::BlurFilter()
   : mBlurredOutputTexSRV(0), mBlurredOutputTexUAV(0), mBlurredOutputTexRTV(0)
@@ -28,23 +24,11 @@ ID3D11ShaderResourceView* BlurFilter::GetBlurredOutput()
 
 void BlurFilter::SetGaussianWeights(float sigma)
 {
-	float d = 2.0f*sigma*sigma;
+	// Cut the Gaussian where the error per texel drops below 1e-3.
+	BlurKernel::Report report;
+	mTaps = BlurKernel::BuildGaussianTaps(sigma, 1e-3f, &report);
 
-	float weights[9];
-	float sum = 0.0f;
-	for(int i = 0; i < 8; ++i)
-	{
-		float x = (float)i;
-		weights[i] = expf(-x*x/d);
-
-		sum += weights[i];
-	}
-
-	// Divide by the sum so all the weights add up to 1.0.
-	for(int i = 0; i < 8; ++i)
-	{
-		weights[i] /= sum;
-	}
+	ReportTaps(report);
 }
 
 void BlurFilter::SetWeights(const float weights[9])
@@ -106,61 +90,27 @@ void BlurFilter::Init(ID3D11Device* device, UINT width, UINT height, DXGI_FORMAT
 
 void BlurFilter::BuildWeight(int radius)
 {
-	const int max_coeff = 50;
-	int kernel_n = (radius)*2+1;
-	// 좌우 2개씩 뺀다. 좀더 가중치 높은 것들만 남기기 위해
-	int selected_row = kernel_n + 3; 
-	assert(max_coeff > kernel_n);
-	int coeff[max_coeff][max_coeff];
-	memset(coeff, 0, sizeof(coeff));
-	auto fill_coeff = [&](int n) {
-		coeff[n][0] = coeff[n][n] = 1;
-		for (int i = 1; i < n; i++)
-			coeff[n][i] = coeff[n-1][i-1] + coeff[n-1][i];
-	};
-	for (int i = 0; i <= selected_row; i++)
-		fill_coeff(i);
-
-	std::vector<int> coeffients;
-	int* st = coeff[selected_row] + 2;
-	int* en = st + kernel_n;
-	std::copy(st, en, std::back_inserter(coeffients));
-	int sum = std::accumulate(coeffients.begin(), coeffients.end(), 0);
-	assert(sum != 0);
-
-	// Half sized kernel
-	int half_size = 1 + radius;
-	std::vector<float> offset(half_size), weight(half_size);
-	for (int i = 0; i < half_size; i++) {
-		offset[i] = static_cast<float>(i);
-		weight[i] = static_cast<float>(coeffients[i+radius])/sum;
-	}
-	weight = { 0.2f, 0.1f, 0.1f, 0.1f, 0.05f, 0.05f };
-
-	// Quarter sized kernel
-	// even number 는 0 번을 빼고 나머지를 따로 하면 된다
-	// odd number 는 (-3,-2), (-1, 0),... (3) 으로 묶으면 된다
-	if (radius % 2 == 1) {
-		std::vector<float> qoffset, qweight;
-		for (int i = -radius; i < radius; i+=2) {
-			auto l = abs(i), r = abs(i+1);
-			qweight.push_back(weight[l] + weight[r]);
-			qoffset.push_back(i*weight[l] + (i+1)*weight[r]);
-			qoffset.back() /= qweight.back();
-		}
-		qoffset.push_back(radius);
-		qweight.push_back(weight[radius]);
-	} else {
-		int quarter_size = radius/2 + 1;
-		std::vector<float> qoffset(quarter_size), qweight(quarter_size);
-		qoffset[0] = 0.f;
-		qweight[0] = weight[0];
-		for (int i = 0; i < quarter_size-1; i++) {
-			qweight[1+i] = weight[1+2*i] + weight[1+2*i+1];
-			qoffset[1+i] = offset[1+2*i]*weight[1+2*i] + offset[1+2*i+1]*weight[1+2*i+1];
-			qoffset[1+i] /= qweight[1+i];
-		}
-	}
+	// Binomial weights paired into linear taps; radius 4 gives the 5 taps of
+	// BlurEven.fx.
+	BlurKernel::Report report;
+	mTaps = BlurKernel::BuildBinomialTaps(radius, &report);
+
+	ReportTaps(report);
+}
+
+const std::vector<ImageFilter::LinearTap>& BlurFilter::GetTaps()const
+{
+	return mTaps;
+}
+
+void BlurFilter::ReportTaps(const BlurKernel::Report& report)
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	// The shaders declare their taps as constants; print the declarations so a
+	// new kernel can be pasted into the .fx file.
+	std::string text = BlurKernel::FormatReport(report) + "\n" + BlurKernel::ToHlsl(mTaps, "gTap");
+	OutputDebugStringA(text.c_str());
+#endif
 }
 
 void BlurFilter::BlurInPlace(ID3D11DeviceContext* dc, 
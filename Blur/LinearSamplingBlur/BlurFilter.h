@@ -10,6 +10,7 @@
 #include <Windows.h>
 #include <xnamath.h>
 #include "d3dUtil.h"
+#include "BlurKernel.h"
 
 class BlurFilter
 {
@@ -33,12 +34,20 @@ public:
 	///</summary>
 	void Init(ID3D11Device* device, UINT width, UINT height, DXGI_FORMAT format);
 
+	///<summary>
+	/// Builds the linear taps of a binomial kernel of the given radius.
+	///</summary>
 	void BuildWeight(int radius);
 
+	const std::vector<ImageFilter::LinearTap>& GetTaps()const;
+
 	void BlurInPlace(ID3D11DeviceContext * dc, ID3D11ShaderResourceView * inputSRV, ID3D11RenderTargetView* inputRTV, ID3D11DepthStencilView * depthSten, int blurCount);
 
 	void SetShader(std::vector<ID3D11DeviceChild*> shader);
 
+private:
+	void ReportTaps(const BlurKernel::Report& report);
+
 private:
 
 	UINT mWidth;
@@ -50,6 +59,8 @@ private:
 	ID3D11RenderTargetView* mBlurredOutputTexRTV;
 
 	std::vector<ID3D11DeviceChild*> mShader;
+
+	std::vector<ImageFilter::LinearTap> mTaps;
 };
 
 #endif // BLURFILTER_H
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "../../Common/d3dUtil.h"
-#include "../../Common/ConstantBuffer.h"
+#include "../../Common/D3D11UploadContext.h"
+
+// Frames of constants kept in flight.
+static const UINT gNumFrameResources = 3;
 
 struct Vertex
 {
@@ -63,14 +66,20 @@ static_assert(sizeof(PassConstants) == 1216, "buffer size dismatch");
 struct FrameResource
 {
 public:
-    FrameResource(ID3D11Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+    FrameResource(ID3D11Device* device, ID3D11DeviceContext* dc, UINT passCount, UINT objectCount, UINT materialCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
 
     // We cannot update a cbuffer until the GPU is done processing the commands
-    // that reference it.  So each frame needs their own cbuffers.
-    std::unique_ptr<ConstantBuffer<PassConstants>> PassCB = nullptr;
-    std::unique_ptr<ConstantBuffer<MaterialConstants>> MaterialCB = nullptr;
-    std::unique_ptr<ConstantBuffer<ObjectConstants>> ObjectCB = nullptr;
+    // that reference it.  So each frame needs their own cbuffers: the ring keeps
+    // gNumFrameResources frames of pass constants (transient, rewritten every
+    // frame) and of object and material constants (persistent, rewritten only
+    // when dirty).
+    FrameResourceRing Ring;
+    D3D11UploadContext Upload;
+
+    // Ring handles, indexed by RenderItem::ObjCBIndex and MatCBIndex.
+    std::vector<UINT> ObjectCB;
+    std::vector<UINT> MaterialCB;
 };
\ No newline at end of file
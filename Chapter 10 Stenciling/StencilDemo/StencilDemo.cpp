@@ -16,6 +16,7 @@
 #include "PipelineStateObject.h"
 #include "ShaderFactoryDX11.h"
 #include "MeshGeometry.h"
+#include "RenderQueue.h"
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "D3DCompiler.lib")
@@ -51,6 +52,9 @@ struct RenderItem
 	MaterialFresnel* Mat = nullptr;
 	MeshGeometry* Geo = nullptr;
 
+	// Small id of Geo for the render queue sort key.
+	UINT GeoSortIndex = 0;
+
     // Primitive topology.
     D3D11_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
@@ -110,6 +114,7 @@ private:
 	void UploadMaterials();
 	void UploadObjects();
 	void UpdateCamera(float dt);
+	void BuildRenderQueue();
 	void DrawRenderItems(RenderLayer layer);
 	void UpdateMainPassCB(float dt);
 
@@ -144,7 +149,12 @@ private:
 	std::vector<std::pair<int, std::string>> mRenderLayerCounstBuffer[(int)RenderLayer::Count];
 	std::unique_ptr<PipelineStateObject> mPSOs[(int)RenderLayer::Count];
 
-	std::unordered_map<std::string, ComPtr<ID3D11Buffer>> mConstantBuffers;
+	// Items of all layers sorted by state, rebuilt every frame.
+	RenderQueue mRenderQueue;
+	float mLastQueueReport = 0.0f;
+
+	std::unordered_map<std::string, FrameResourceRing::Allocation> mPassAllocations;
+	PassConstants mMainPassCB;
 
 	XMFLOAT3 mSkullTranslation = { 0.0f, 1.0f, -5.0f };
 
@@ -219,6 +229,15 @@ void StencilDemo::OnResize()
 void StencilDemo::BuildFX()
 {
 	D3D_SHADER_MACRO textureMacros[] = { "TEXTURE", "1", NULL, NULL };
+
+	// Compile whatever is not in the shader cache yet in parallel; the calls below
+	// then only create the shader objects.
+	ShaderFactoryDX11::PrecompileShaders({
+		{ L"FX/Basic.fx", textureMacros, "VS", "vs_5_0" },
+		{ L"FX/Basic.fx", textureMacros, "PS", "ps_5_0" },
+		{ L"FX/Basic.fx", nullptr, "VS", "vs_5_0" },
+		{ L"FX/Basic.fx", nullptr, "PS", "ps_5_0" } });
+
 	CompileShaderVS("texture", textureMacros, L"FX/Basic.fx", "VS", "vs_5_0");
 	CompileShaderPS("texture", textureMacros, L"FX/Basic.fx", "PS", "ps_5_0");
 	CompileShaderVS("standard", nullptr, L"FX/Basic.fx", "VS", "vs_5_0");
@@ -338,10 +357,14 @@ void StencilDemo::BuildMaterials()
 
 void StencilDemo::UpdateScene(float dt)
 {
+	mFrameResource->Ring.BeginFrame();
+
 	OnKeyBoardInput(dt);
 	UpdateCamera(dt);
 	UpdateMainPassCB(dt);
 	UploadObjects();
+
+	mFrameResource->Ring.Upload(mFrameResource->Upload);
 }
 
 void StencilDemo::OnKeyBoardInput(float dt)
@@ -378,8 +401,7 @@ void StencilDemo::OnKeyBoardInput(float dt)
 
 	// Update shadow world matrix.
 	XMVECTOR shadowPlane = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f); // xz plane
-	auto MainPassCB = mFrameResource->PassCB->backup(0);
-	XMVECTOR toMainLight = -XMLoadFloat3(&MainPassCB.Lights[0].Direction);
+	XMVECTOR toMainLight = -XMLoadFloat3(&mMainPassCB.Lights[0].Direction);
 	XMMATRIX S = XMMatrixShadow(shadowPlane, toMainLight);
 	XMMATRIX shadowOffsetY = XMMatrixTranslation(0.0f, 0.001f, 0.0f);
 	XMStoreFloat4x4(&mShadowedSkullRitem->World, skullWorld * S * shadowOffsetY);
@@ -401,6 +423,30 @@ void StencilDemo::UpdateCamera(float dt)
 	mView = XMMatrixLookAtLH(pos, target, up);
 }
 
+void StencilDemo::BuildRenderQueue()
+{
+	const float nearZ = 1.0f, farZ = 1000.0f;
+
+	mRenderQueue.Clear();
+	for (int layer = 0; layer < (int)RenderLayer::Count; ++layer) {
+		// Blended layers are drawn back to front, the others grouped by state.
+		auto order = layer == (int)RenderLayer::Transparent ? RenderQueue::BackToFront : RenderQueue::StateFirst;
+
+		const std::vector<RenderItem*>& ritems = mRitemLayer[layer];
+		for (size_t i = 0; i < ritems.size(); ++i) {
+			auto& ri = ritems[i];
+			XMVECTOR pos = XMVectorSet(ri->World._41, ri->World._42, ri->World._43, 1.0f);
+			float depth = XMVectorGetZ(XMVector3TransformCoord(pos, mView));
+
+			// Each layer has its own PSO.
+			UINT64 key = RenderQueue::BuildKey(layer, layer, ri->Mat->MatCBIndex, ri->GeoSortIndex,
+				depth, nearZ, farZ, order);
+			mRenderQueue.Submit(key, (UINT)i);
+		}
+	}
+	mRenderQueue.Sort();
+}
+
 void StencilDemo::DrawRenderItems(RenderLayer layer)
 {
 	auto pPSO = mPSOs[(int)layer].get();
@@ -416,34 +462,44 @@ void StencilDemo::DrawRenderItems(RenderLayer layer)
 		pPSO->depthStencil.StencilRef);
 	md3dImmediateContext->RSSetState(pPSO->pResterizer);
 
-	std::array<ID3D11Buffer*, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT> ConstantBuffers;
-	ConstantBuffers.assign(nullptr);
+	auto& ring = mFrameResource->Ring;
+	auto& upload = mFrameResource->Upload;
 	auto& cbuffers = mRenderLayerCounstBuffer[(int)layer];
 	for (auto cb : cbuffers) {
-		ConstantBuffers[cb.first] = mConstantBuffers[cb.second].Get();
+		ring.Bind(upload, cb.first, mPassAllocations[cb.second]);
 	}
 
 	const std::vector<RenderItem*>& ritems = mRitemLayer[(int)layer];
 
-	for (size_t i = 0; i < ritems.size(); ++i) {
-		auto& ri = ritems[i];
-		md3dImmediateContext->IASetPrimitiveTopology(ri->PrimitiveType);
+	// Walk the layer in sort key order and skip the binds of state that is
+	// already set.
+	UINT first = 0, count = 0;
+	mRenderQueue.GetLayerRange((UINT)layer, first, count);
+
+	for (UINT i = first; i < first + count; ++i) {
+		auto& ri = ritems[mRenderQueue[i].Item];
+		if (mRenderQueue.NeedsBind(RenderQueue::Topology, ri->PrimitiveType))
+			md3dImmediateContext->IASetPrimitiveTopology(ri->PrimitiveType);
 		auto geo = ri->Geo;
 		auto pib = static_cast<ID3D11Buffer*>(geo->IndexBufferGPU.Get());
+		if (mRenderQueue.NeedsBind(RenderQueue::IndexBuffer, (UINT64)pib))
 			md3dImmediateContext->IASetIndexBuffer(pib, geo->IndexFormat, 0);
 
 		auto pvb = static_cast<ID3D11Buffer*>(geo->VertexBufferGPU.Get());
 		UINT vstride = geo->VertexByteStride, offset = 0;
-		md3dImmediateContext->IASetVertexBuffers(0, 1, &pvb, &vstride, &offset);
+		if (mRenderQueue.NeedsBind(RenderQueue::VertexBuffer, (UINT64)pvb))
+			md3dImmediateContext->IASetVertexBuffers(0, 1, &pvb, &vstride, &offset);
 
-		ConstantBuffers[0] = mFrameResource->ObjectCB->Resource(ri->ObjCBIndex);
-		ConstantBuffers[1] = mFrameResource->MaterialCB->Resource(ri->Mat->MatCBIndex);
-		md3dImmediateContext->VSSetConstantBuffers(0, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, ConstantBuffers.data());
-		md3dImmediateContext->PSSetConstantBuffers(0, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, ConstantBuffers.data());
+		auto objCB = ring.GetPersistent(mFrameResource->ObjectCB[ri->ObjCBIndex]);
+		if (mRenderQueue.NeedsBind(RenderQueue::ObjectConstants, objCB.Offset))
+			ring.Bind(upload, 0, objCB);
+		auto matCB = ring.GetPersistent(mFrameResource->MaterialCB[ri->Mat->MatCBIndex]);
+		if (mRenderQueue.NeedsBind(RenderQueue::MaterialConstants, matCB.Offset))
+			ring.Bind(upload, 1, matCB);
 
 		std::array<ID3D11ShaderResourceView*, D3D10_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT> SRV;
 		auto& rTex = mTextures[ri->Mat->DiffuseSrv];
-		if (rTex) {
+		if (rTex && mRenderQueue.NeedsBind(RenderQueue::ShaderResource, (UINT64)rTex->Resource.Get())) {
 			SRV[0] = rTex->Resource.Get();
 			md3dImmediateContext->PSSetShaderResources(0, 1, SRV.data());
 		}
@@ -461,6 +517,8 @@ void StencilDemo::DrawScene()
 	Sampler[0] = mSamplerState[4].Get();
 	md3dImmediateContext->PSSetSamplers(0, 1, Sampler.data());
 
+	BuildRenderQueue();
+
 	DrawRenderItems(RenderLayer::Opaque);
 	DrawRenderItems(RenderLayer::Texture);
 	DrawRenderItems(RenderLayer::Mirrors);
@@ -470,6 +528,13 @@ void StencilDemo::DrawScene()
 	DrawRenderItems(RenderLayer::Shadow);
 
 	HR(mSwapChain->Present(0, 0));
+
+#if defined(DEBUG) | defined(_DEBUG)
+	if (mTimer.TotalTime() - mLastQueueReport >= 1.0f) {
+		mLastQueueReport = mTimer.TotalTime();
+		OutputDebugStringA((mRenderQueue.FormatStats() + "\n").c_str());
+	}
+#endif
 }
 
 void StencilDemo::OnMouseDown(WPARAM btnState, int x, int y)
@@ -808,6 +873,12 @@ void StencilDemo::BuildRenderItems()
 	mAllRitems.push_back(std::move(shadowedSkullRitem));
 	mAllRitems.push_back(std::move(mirrorRitem));
 
+	std::unordered_map<MeshGeometry*, UINT> geoSortIndices;
+	for (auto& e : mAllRitems) {
+		UINT index = (UINT)geoSortIndices.size();
+		e->GeoSortIndex = geoSortIndices.insert({ e->Geo, index }).first->second;
+	}
+
 	for (int i = 0; i < (int)RenderLayer::Count; i++)
 		mRenderLayerCounstBuffer[i].push_back({ 2, "MainPass" });
 	mRenderLayerCounstBuffer[(int)RenderLayer::Reflected].assign(1, { 2, "ReflectedPass" });
@@ -816,7 +887,7 @@ void StencilDemo::BuildRenderItems()
  
 void StencilDemo::BuildFrameResources()
 {
-	mFrameResource = std::make_unique<FrameResource>(md3dDevice, 2, (UINT)mAllRitems.size(), (UINT)mMaterials.size());
+	mFrameResource = std::make_unique<FrameResource>(md3dDevice, md3dImmediateContext, 2, (UINT)mAllRitems.size(), (UINT)mMaterials.size());
 }
 
 void StencilDemo::UploadMaterials()
@@ -827,7 +898,7 @@ void StencilDemo::UploadMaterials()
 		matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
 		matConstants.FresnelR0 = mat->FresnelR0;
 		matConstants.Roughness = mat->Roughness;
-		mFrameResource->MaterialCB->UploadData(md3dImmediateContext, mat->MatCBIndex, matConstants);
+		mFrameResource->Ring.WritePersistent(mFrameResource->MaterialCB[mat->MatCBIndex], matConstants);
 	}
 }
 
@@ -842,7 +913,7 @@ void StencilDemo::UploadObjects()
 		obj.World = world;
 		obj.WorldInvTranspose = worldInvTranspose;
 		obj.TexTransform = XMLoadFloat4x4(&mAllRitems[i]->TexTransform);
-		mFrameResource->ObjectCB->UploadData(md3dImmediateContext, mAllRitems[i]->ObjCBIndex, obj);
+		mFrameResource->Ring.WritePersistent(mFrameResource->ObjectCB[mAllRitems[i]->ObjCBIndex], obj);
 		mAllRitems[i]->bDirty = false;
 	}
 }
@@ -875,8 +946,8 @@ void StencilDemo::UpdateMainPassCB(float dt)
 	MainPassCB.Lights[1].Strength = { 0.4f, 0.4f, 0.4f };
 	MainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
 	MainPassCB.Lights[2].Strength = { 0.2f, 0.2f, 0.2f };
-	mFrameResource->PassCB->UploadData(md3dImmediateContext, 0, MainPassCB);
-	mConstantBuffers["MainPass"] = mFrameResource->PassCB->Resource(0);
+	mMainPassCB = MainPassCB;
+	mPassAllocations["MainPass"] = mFrameResource->Ring.PushTransient(MainPassCB);
 
 	XMVECTOR mirrorPlane = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f); // xy plane
 	XMMATRIX R = XMMatrixReflect(mirrorPlane);
@@ -890,8 +961,7 @@ void StencilDemo::UpdateMainPassCB(float dt)
 		XMStoreFloat3(&reflectedPassCB.Lights[i].Direction, reflectedLightDir);
 	}
 	// Reflected pass stored in index 1
-	mFrameResource->PassCB->UploadData(md3dImmediateContext, 1, reflectedPassCB);
-	mConstantBuffers["ReflectedPass"] = mFrameResource->PassCB->Resource(1);
+	mPassAllocations["ReflectedPass"] = mFrameResource->Ring.PushTransient(reflectedPassCB);
 }
 
 std::array<const CD3D11_SAMPLER_DESC, 6> StencilDemo::GetStaticSamplers()
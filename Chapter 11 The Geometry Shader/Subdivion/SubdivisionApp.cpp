@@ -139,7 +139,7 @@ private:
 	std::vector<std::pair<int, std::string>> mRenderLayerCounstBuffer[(int)RenderLayer::Count];
 	std::unique_ptr<PipelineStateObject> mPSOs[(int)RenderLayer::Count];
 
-	std::unordered_map<std::string, ComPtr<ID3D11Buffer>> mConstantBuffers;
+	std::unordered_map<std::string, FrameResourceRing::Allocation> mPassAllocations;
 
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
 	XMMATRIX mView = XMMatrixIdentity();
@@ -287,10 +287,14 @@ void TreeBillboardsApp::BuildMaterials()
 
 void TreeBillboardsApp::UpdateScene(float dt)
 {
+	mFrameResource->Ring.BeginFrame();
+
 	OnKeyBoardInput(dt);
 	UpdateCamera(dt);
 	UpdateMainPassCB(dt);
 	UploadObjects();
+
+	mFrameResource->Ring.Upload(mFrameResource->Upload);
 }
 
 void TreeBillboardsApp::OnKeyBoardInput(float dt)
@@ -328,11 +332,11 @@ void TreeBillboardsApp::DrawRenderItems(RenderLayer layer)
 		pPSO->depthStencil.StencilRef);
 	md3dImmediateContext->RSSetState(pPSO->pResterizer);
 
-	std::array<ID3D11Buffer*, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT> ConstantBuffers;
-	ConstantBuffers.assign(nullptr);
+	auto& ring = mFrameResource->Ring;
+	auto& upload = mFrameResource->Upload;
 	auto& cbuffers = mRenderLayerCounstBuffer[(int)layer];
 	for (auto cb : cbuffers) {
-		ConstantBuffers[cb.first] = mConstantBuffers[cb.second].Get();
+		ring.Bind(upload, cb.first, mPassAllocations[cb.second]);
 	}
 
 	const std::vector<RenderItem*>& ritems = mRitemLayer[(int)layer];
@@ -348,11 +352,8 @@ void TreeBillboardsApp::DrawRenderItems(RenderLayer layer)
 		UINT vstride = geo->VertexByteStride, offset = 0;
 		md3dImmediateContext->IASetVertexBuffers(0, 1, &pvb, &vstride, &offset);
 
-		ConstantBuffers[0] = mFrameResource->ObjectCB->Resource(ri->ObjCBIndex);
-		ConstantBuffers[1] = mFrameResource->MaterialCB->Resource(ri->Mat->MatCBIndex);
-		md3dImmediateContext->VSSetConstantBuffers(0, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, ConstantBuffers.data());
-		md3dImmediateContext->PSSetConstantBuffers(0, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, ConstantBuffers.data());
-		md3dImmediateContext->GSSetConstantBuffers(0, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, ConstantBuffers.data());
+		ring.Bind(upload, 0, ring.GetPersistent(mFrameResource->ObjectCB[ri->ObjCBIndex]));
+		ring.Bind(upload, 1, ring.GetPersistent(mFrameResource->MaterialCB[ri->Mat->MatCBIndex]));
 
 		std::array<ID3D11ShaderResourceView*, D3D10_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT> SRV;
 		auto textureName = ri->Mat->DiffuseSrv;
@@ -492,7 +493,7 @@ void TreeBillboardsApp::BuildRenderItems()
  
 void TreeBillboardsApp::BuildFrameResources()
 {
-	mFrameResource = std::make_unique<FrameResource>(md3dDevice, 2, (UINT)mAllRitems.size(), (UINT)mMaterials.size());
+	mFrameResource = std::make_unique<FrameResource>(md3dDevice, md3dImmediateContext, 2, (UINT)mAllRitems.size(), (UINT)mMaterials.size());
 }
 
 void TreeBillboardsApp::UploadMaterials()
@@ -503,7 +504,7 @@ void TreeBillboardsApp::UploadMaterials()
 		matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
 		matConstants.FresnelR0 = mat->FresnelR0;
 		matConstants.Roughness = mat->Roughness;
-		mFrameResource->MaterialCB->UploadData(md3dImmediateContext, mat->MatCBIndex, matConstants);
+		mFrameResource->Ring.WritePersistent(mFrameResource->MaterialCB[mat->MatCBIndex], matConstants);
 	}
 }
 
@@ -518,7 +519,7 @@ void TreeBillboardsApp::UploadObjects()
 		obj.World = world;
 		obj.WorldInvTranspose = worldInvTranspose;
 		obj.TexTransform = XMLoadFloat4x4(&mAllRitems[i]->TexTransform);
-		mFrameResource->ObjectCB->UploadData(md3dImmediateContext, mAllRitems[i]->ObjCBIndex, obj);
+		mFrameResource->Ring.WritePersistent(mFrameResource->ObjectCB[mAllRitems[i]->ObjCBIndex], obj);
 		mAllRitems[i]->bDirty = false;
 	}
 }
@@ -551,8 +552,7 @@ void TreeBillboardsApp::UpdateMainPassCB(float dt)
 	MainPassCB.Lights[1].Strength = { 0.4f, 0.4f, 0.4f };
 	MainPassCB.Lights[2].Direction = { 0.0f, -0.707f, -0.707f };
 	MainPassCB.Lights[2].Strength = { 0.2f, 0.2f, 0.2f };
-	mFrameResource->PassCB->UploadData(md3dImmediateContext, 0, MainPassCB);
-	mConstantBuffers["MainPass"] = mFrameResource->PassCB->Resource(0);
+	mPassAllocations["MainPass"] = mFrameResource->Ring.PushTransient(MainPassCB);
 }
 
 std::array<const CD3D11_SAMPLER_DESC, 6> TreeBillboardsApp::GetStaticSamplers()
@@ -24,6 +24,7 @@
 #include "Vertex.h"
 #include "RenderStates.h"
 #include "Waves.h"
+#include "DepthSorter.h"
 
 enum RenderOptions
 {
@@ -68,6 +69,10 @@ private:
 
 	ID3D11Buffer* mTreeSpritesVB;
 
+	// Rewritten back to front every frame.
+	std::vector<Vertex::TreePointSprite> mTreeSprites;
+	DepthSorter mTreeSorter;
+
 	ID3D11ShaderResourceView* mGrassMapSRV;
 	ID3D11ShaderResourceView* mWavesMapSRV;
 	ID3D11ShaderResourceView* mBoxMapSRV;
@@ -699,7 +704,8 @@ void TreeBillboardApp::BuildCrateGeometryBuffers()
 
 void TreeBillboardApp::BuildTreeSpritesBuffer()
 {
-	Vertex::TreePointSprite v[TreeCount];
+	mTreeSprites.resize(TreeCount);
+	Vertex::TreePointSprite* v = &mTreeSprites[0];
 
 	for(UINT i = 0; i < TreeCount; ++i)
 	{
@@ -715,10 +721,10 @@ void TreeBillboardApp::BuildTreeSpritesBuffer()
 	}
      
 	D3D11_BUFFER_DESC vbd;
-    vbd.Usage = D3D11_USAGE_IMMUTABLE;
+    vbd.Usage = D3D11_USAGE_DYNAMIC;
 	vbd.ByteWidth = sizeof(Vertex::TreePointSprite) * TreeCount;
     vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    vbd.CPUAccessFlags = 0;
+    vbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
     vbd.MiscFlags = 0;
     D3D11_SUBRESOURCE_DATA vinitData;
     vinitData.pSysMem = v;
@@ -736,6 +742,23 @@ void TreeBillboardApp::DrawTreeSprites(CXMMATRIX viewProj)
 	Effects::TreeSpriteFX->SetMaterial(mTreeMat);
 	Effects::TreeSpriteFX->SetTreeTextureMapArray(mTreeTextureMapArraySRV);
 
+	//
+	// Sort the sprites back to front so their edges blend over what is behind them.
+	// The camera orbits the origin, so it looks along -eye.
+	//
+	mTreeSorter.Sort(DepthSorter::Points::FromStructs(&mTreeSprites[0].Pos, sizeof(Vertex::TreePointSprite), TreeCount),
+		mEyePosW, XMFLOAT3(-mEyePosW.x, -mEyePosW.y, -mEyePosW.z));
+	const UINT* order = mTreeSorter.GetOrder();
+
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	HR(md3dImmediateContext->Map(mTreeSpritesVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+
+	Vertex::TreePointSprite* v = reinterpret_cast<Vertex::TreePointSprite*>(mappedData.pData);
+	for(UINT i = 0; i < TreeCount; ++i)
+		v[i] = mTreeSprites[order[i]];
+
+	md3dImmediateContext->Unmap(mTreeSpritesVB, 0);
+
 	md3dImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
 	md3dImmediateContext->IASetInputLayout(InputLayouts::TreePointSprite);
 	UINT stride = sizeof(Vertex::TreePointSprite);
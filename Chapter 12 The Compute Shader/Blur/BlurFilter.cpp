@@ -4,6 +4,7 @@
 
 #include "BlurFilter.h"
 #include "Effects.h"
+#include "ImageFilter.h"
 
 BlurFilter::BlurFilter()
   : mBlurredOutputTexSRV(0), mBlurredOutputTexUAV(0)
@@ -23,28 +24,13 @@ ID3D11ShaderResourceView* BlurFilter::GetBlurredOutput()
 
 void BlurFilter::SetGaussianWeights(float sigma)
 {
-	float d = 2.0f*sigma*sigma;
+	// Blur.fx takes gBlurRadius = 5 texels on each side of the center.
+	std::vector<float> weights = ImageFilter::BuildGaussianKernel(sigma, 5);
 
-	float weights[9];
-	float sum = 0.0f;
-	for(int i = 0; i < 8; ++i)
-	{
-		float x = (float)i;
-		weights[i] = expf(-x*x/d);
-
-		sum += weights[i];
-	}
-
-	// Divide by the sum so all the weights add up to 1.0.
-	for(int i = 0; i < 8; ++i)
-	{
-		weights[i] /= sum;
-	}
-
-	Effects::BlurFX->SetWeights(weights);
+	Effects::BlurFX->SetWeights(&weights[0]);
 }
 
-void BlurFilter::SetWeights(const float weights[9])
+void BlurFilter::SetWeights(const float weights[11])
 {
 	Effects::BlurFX->SetWeights(weights);
 }
@@ -24,7 +24,7 @@ public:
 	void SetGaussianWeights(float sigma);
 
 	// Manually specify blur weights.
-	void SetWeights(const float weights[9]);
+	void SetWeights(const float weights[11]);
 
 	///<summary>
 	/// The width and height should match the dimensions of the input texture to blur.
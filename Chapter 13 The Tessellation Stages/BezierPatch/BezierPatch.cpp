@@ -6,6 +6,8 @@
 // Controls:
 //		Hold the left mouse button down and move the mouse to rotate.
 //      Hold the right mouse button down to zoom in and out.
+//      Press '1' to draw the patch tessellated by the hardware, '2' to draw it
+//      evaluated on the CPU by BezierPatchEvaluator, lit with its normals.
 //
 //***************************************************************************************
 
@@ -18,6 +20,7 @@
 #include "Vertex.h"
 #include "RenderStates.h"
 #include "Waves.h"
+#include "BezierPatchEvaluator.h"
 
  
 class BasicTessellation : public D3DApp
@@ -37,10 +40,20 @@ public:
 
 private:
 	void BuildQuadPatchBuffer();
+	void BuildCpuPatchBuffers(const XMFLOAT3 controlPoints[16]);
 
 private:
 	ID3D11Buffer* mQuadPatchVB;
 
+	// The patch evaluated on the CPU at the hull shader's factor.
+	ID3D11Buffer* mCpuPatchVB;
+	ID3D11Buffer* mCpuPatchIB;
+	UINT mCpuPatchIndexCount;
+	bool mDrawCpuPatch;
+
+	DirectionalLight mDirLights[3];
+	Material mPatchMat;
+
 	XMFLOAT4X4 mView;
 	XMFLOAT4X4 mProj;
 
@@ -70,7 +83,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 }
 
 BasicTessellation::BasicTessellation(HINSTANCE hInstance)
-: D3DApp(hInstance), mQuadPatchVB(0),  
+: D3DApp(hInstance), mQuadPatchVB(0), mCpuPatchVB(0), mCpuPatchIB(0), mCpuPatchIndexCount(0), mDrawCpuPatch(false),
   mEyePosW(0.0f, 0.0f, 0.0f), mTheta(1.3f*MathHelper::Pi), mPhi(0.4f*MathHelper::Pi), mRadius(80.0f)
 {
 	mMainWndCaption = L"Bezier Surface Demo";
@@ -82,12 +95,33 @@ BasicTessellation::BasicTessellation(HINSTANCE hInstance)
 	XMMATRIX I = XMMatrixIdentity();
 	XMStoreFloat4x4(&mView, I);
 	XMStoreFloat4x4(&mProj, I);
+
+	mDirLights[0].Ambient  = XMFLOAT4(0.3f, 0.3f, 0.3f, 1.0f);
+	mDirLights[0].Diffuse  = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
+	mDirLights[0].Specular = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
+	mDirLights[0].Direction = XMFLOAT3(0.57735f, -0.57735f, 0.57735f);
+
+	mDirLights[1].Ambient  = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+	mDirLights[1].Diffuse  = XMFLOAT4(0.20f, 0.20f, 0.20f, 1.0f);
+	mDirLights[1].Specular = XMFLOAT4(0.25f, 0.25f, 0.25f, 1.0f);
+	mDirLights[1].Direction = XMFLOAT3(-0.57735f, -0.57735f, 0.57735f);
+
+	mDirLights[2].Ambient  = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+	mDirLights[2].Diffuse  = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+	mDirLights[2].Specular = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+	mDirLights[2].Direction = XMFLOAT3(0.0f, -0.707f, -0.707f);
+
+	mPatchMat.Ambient  = XMFLOAT4(0.8f, 0.8f, 0.8f, 1.0f);
+	mPatchMat.Diffuse  = XMFLOAT4(0.8f, 0.8f, 0.8f, 1.0f);
+	mPatchMat.Specular = XMFLOAT4(0.8f, 0.8f, 0.8f, 16.0f);
 }
 
 BasicTessellation::~BasicTessellation()
 {
 	md3dImmediateContext->ClearState();
 	ReleaseCOM(mQuadPatchVB);
+	ReleaseCOM(mCpuPatchVB);
+	ReleaseCOM(mCpuPatchIB);
 
 	Effects::DestroyAll();
 	InputLayouts::DestroyAll();
@@ -133,6 +167,15 @@ void BasicTessellation::UpdateScene(float dt)
 
 	XMMATRIX V = XMMatrixLookAtLH(pos, target, up);
 	XMStoreFloat4x4(&mView, V);
+
+	//
+	// Switch between the hardware and the CPU evaluated patch.
+	//
+	if( GetAsyncKeyState('1') & 0x8000 )
+		mDrawCpuPatch = false;
+
+	if( GetAsyncKeyState('2') & 0x8000 )
+		mDrawCpuPatch = true;
 }
 
 void BasicTessellation::DrawScene()
@@ -149,6 +192,41 @@ void BasicTessellation::DrawScene()
 	XMMATRIX proj  = XMLoadFloat4x4(&mProj);
 	XMMATRIX viewProj = view*proj;
 
+	if( mDrawCpuPatch )
+	{
+		UINT stride = sizeof(Vertex::Basic32);
+		UINT offset = 0;
+
+		Effects::BasicFX->SetDirLights(mDirLights);
+		Effects::BasicFX->SetEyePosW(mEyePosW);
+
+		D3DX11_TECHNIQUE_DESC techDesc;
+		Effects::BasicFX->Light3Tech->GetDesc( &techDesc );
+		for(UINT p = 0; p < techDesc.Passes; ++p)
+		{
+			md3dImmediateContext->IASetVertexBuffers(0, 1, &mCpuPatchVB, &stride, &offset);
+			md3dImmediateContext->IASetIndexBuffer(mCpuPatchIB, DXGI_FORMAT_R32_UINT, 0);
+
+			XMMATRIX world = XMMatrixIdentity();
+			XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
+			XMMATRIX worldViewProj = world*view*proj;
+
+			Effects::BasicFX->SetWorld(world);
+			Effects::BasicFX->SetWorldInvTranspose(worldInvTranspose);
+			Effects::BasicFX->SetWorldViewProj(worldViewProj);
+			Effects::BasicFX->SetTexTransform(XMMatrixIdentity());
+			Effects::BasicFX->SetMaterial(mPatchMat);
+
+			Effects::BasicFX->Light3Tech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+
+			md3dImmediateContext->RSSetState(0);
+			md3dImmediateContext->DrawIndexed(mCpuPatchIndexCount, 0, 0);
+		}
+
+		HR(mSwapChain->Present(0, 0));
+		return;
+	}
+
 	md3dImmediateContext->IASetInputLayout(InputLayouts::Pos);
     md3dImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_16_CONTROL_POINT_PATCHLIST);
  
@@ -272,5 +350,48 @@ void BasicTessellation::BuildQuadPatchBuffer()
     D3D11_SUBRESOURCE_DATA vinitData;
     vinitData.pSysMem = vertices;
     HR(md3dDevice->CreateBuffer(&vbd, &vinitData, &mQuadPatchVB));
+
+	BuildCpuPatchBuffers(vertices);
+}
+
+void BasicTessellation::BuildCpuPatchBuffers(const XMFLOAT3 controlPoints[16])
+{
+	// The same factor as ConstantHS in BezierTessellation.fx.
+	const UINT tess = 25;
+
+	std::vector<Vertex::Basic32> vertices(BezierPatchEvaluator::GetVertexCount(tess));
+	std::vector<UINT> indices(BezierPatchEvaluator::GetIndexCount(tess));
+
+	BezierPatchEvaluator::Output output;
+	output.Positions = &vertices[0].Pos.x;
+	output.Normals   = &vertices[0].Normal.x;
+	output.TexC      = &vertices[0].Tex.x;
+	output.Stride    = sizeof(Vertex::Basic32);
+
+	BezierPatchEvaluator evaluator;
+	evaluator.EvaluateUniform(controlPoints, 1, tess, output);
+	BezierPatchEvaluator::BuildIndices(tess, 0, &indices[0]);
+
+	D3D11_BUFFER_DESC vbd;
+    vbd.Usage = D3D11_USAGE_IMMUTABLE;
+	vbd.ByteWidth = sizeof(Vertex::Basic32) * vertices.size();
+    vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    vbd.CPUAccessFlags = 0;
+    vbd.MiscFlags = 0;
+    D3D11_SUBRESOURCE_DATA vinitData;
+    vinitData.pSysMem = &vertices[0];
+    HR(md3dDevice->CreateBuffer(&vbd, &vinitData, &mCpuPatchVB));
+
+	mCpuPatchIndexCount = (UINT)indices.size();
+
+	D3D11_BUFFER_DESC ibd;
+    ibd.Usage = D3D11_USAGE_IMMUTABLE;
+	ibd.ByteWidth = sizeof(UINT) * mCpuPatchIndexCount;
+    ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    ibd.CPUAccessFlags = 0;
+    ibd.MiscFlags = 0;
+    D3D11_SUBRESOURCE_DATA iinitData;
+    iinitData.pSysMem = &indices[0];
+    HR(md3dDevice->CreateBuffer(&ibd, &iinitData, &mCpuPatchIB));
 }
 
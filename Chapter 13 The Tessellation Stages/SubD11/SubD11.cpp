@@ -942,6 +942,41 @@ void RenderSubDMesh( ID3D11DeviceContext* pd3dDeviceContext, CSubDMesh* pMesh, I
 
         pMesh->RenderPolyMeshPiece( pd3dDeviceContext, i );
     }
+
+    // And the faces of the patch pieces that could not be made into patches
+    PieceCount = pMesh->GetNumPatchPieces();
+    for( INT i = 0; i < PieceCount; ++i )
+    {
+        // Per frame cb update
+        D3D11_MAPPED_SUBRESOURCE MappedResource;
+        pd3dDeviceContext->Map( g_pcbPerMesh, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource );
+        CB_PER_MESH_CONSTANTS* pData = ( CB_PER_MESH_CONSTANTS* )MappedResource.pData;
+
+        int MeshIndex = pMesh->GetPatchMeshIndex( i );
+        int NumTransforms = pMesh->GetNumInfluences( MeshIndex );
+        assert( NumTransforms <= MAX_BONE_MATRICES );
+        for( int j = 0; j < NumTransforms; ++j )
+        {
+            if( !s_bEnableAnimation )
+            {
+                D3DXMatrixIdentity( &pData->mConstBoneWorld[j] );
+            }
+            else
+            {
+                D3DXMatrixTranspose( &pData->mConstBoneWorld[j], pMesh->GetInfluenceMatrix( MeshIndex, j ) );
+            }
+        }
+        if( NumTransforms == 0 )
+        {
+            D3DXMATRIX matTransform;
+            pMesh->GetPatchPieceTransform( i, &matTransform );
+            D3DXMatrixTranspose( &pData->mConstBoneWorld[0], &matTransform );
+        }
+        pd3dDeviceContext->Unmap( g_pcbPerMesh, 0 );
+        pd3dDeviceContext->VSSetConstantBuffers( g_iBindPerMesh, 1, &g_pcbPerMesh );
+
+        pMesh->RenderPatchPiece_OnlyPolygons( pd3dDeviceContext, i );
+    }
 }
 
 //--------------------------------------------------------------------------------------
@@ -3,6 +3,7 @@
 //
 // This class encapsulates the mesh loading and housekeeping functions for a SubDMesh.
 // The mesh loads preprocessed SDKMESH files from disk and stages them for rendering.
+// Meshes that hold plain quads instead are turned into patches at load time.
 //
 // Copyright (c) Microsoft Corporation. All rights reserved.
 //--------------------------------------------------------------------------------------
@@ -10,6 +11,9 @@
 #include "SubDMesh.h"
 #include "sdkmisc.h"
 #include "DXUTRes.h"
+#include "SubDPatchBuilder.h"
+#include <algorithm>
+#include <vector>
 
 ID3D11Texture2D* g_pDefaultDiffuseTexture = NULL;
 ID3D11Texture2D* g_pDefaultNormalTexture = NULL;
@@ -200,7 +204,39 @@ HRESULT CSubDMesh::LoadSubDFromSDKMesh( ID3D11Device* pd3dDevice, const WCHAR* s
 
         nSubsets += pMesh->NumSubsets;
 
-        if( pMesh->NumVertexBuffers == 1 )
+        if( pMesh->NumVertexBuffers == 1 && m_pMeshFile->GetNumSubsets( i ) > 0 &&
+            m_pMeshFile->GetSubset( i, 0 )->PrimitiveType == PT_QUAD_PATCH_LIST )
+        {
+            // A plain quad mesh: one control point VB and four indices per face, made into
+            // patches here instead of by the exporter
+            assert( m_pMeshFile->GetVertexStride( i, 0 ) == sizeof( SUBD_CONTROL_POINT ) );
+
+            PatchPiece* pPatchPiece = new PatchPiece;
+            ZeroMemory( pPatchPiece, sizeof( PatchPiece ) );
+            pPatchPiece->m_pMesh = pMesh;
+            pPatchPiece->m_MeshIndex = i;
+            pPatchPiece->m_pControlPointVB = m_pMeshFile->GetVB11( i, 0 );
+
+            V_RETURN( BuildPatchPiece( pd3dDevice, pPatchPiece ) );
+            nPatches += pPatchPiece->m_iPatchCount;
+
+            pPatchPiece->m_vCenter = pMesh->BoundingBoxCenter;
+            pPatchPiece->m_vExtents = pMesh->BoundingBoxExtents;
+
+            // Find frame that corresponds to this mesh
+            pPatchPiece->m_iFrameIndex = -1;
+            for( UINT j = 0; j < FrameCount; ++j )
+            {
+                SDKMESH_FRAME* pFrame = m_pMeshFile->GetFrame( j );
+                if( pFrame->Mesh == pPatchPiece->m_MeshIndex )
+                {
+                    pPatchPiece->m_iFrameIndex = (INT)j;
+                }
+            }
+
+            m_PatchPieces.Add( pPatchPiece );
+        }
+        else if( pMesh->NumVertexBuffers == 1 )
         {
             PolyMeshPiece* pPolyMeshPiece = new PolyMeshPiece;
             ZeroMemory( pPolyMeshPiece, sizeof( PolyMeshPiece ) );
@@ -340,37 +376,10 @@ HRESULT CSubDMesh::LoadSubDFromSDKMesh( ID3D11Device* pd3dDevice, const WCHAR* s
                     vExtraordinaryPatchData.GetSize() - pPatchPiece->ExtraordinaryPatchStart[pPatchPiece->ExtraordinaryPatchStart.GetSize()-1] );
             }
 
-            // Create index buffer for the regular patches
-            D3D11_SUBRESOURCE_DATA initdata;
-            initdata.pSysMem = &vRegularIdxBuf[0];
-            D3D11_BUFFER_DESC desc;
-            desc.ByteWidth = vRegularIdxBuf.GetSize() * sizeof(UINT);
-            desc.Usage = D3D11_USAGE_DEFAULT;
-            desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-            desc.CPUAccessFlags = 0;
-            desc.MiscFlags = 0;            
-            DXUTGetD3D11Device()->CreateBuffer( &desc, &initdata, &pPatchPiece->m_pMyRegularPatchIB );
-            DXUT_SetDebugName( pPatchPiece->m_pMyRegularPatchIB, "CSubDMesh IB" );
-
-            // Create index buffer for the extraordinary patches
-            desc.ByteWidth = vExtraordinaryIdxBuf.GetSize() * sizeof(UINT);
-            initdata.pSysMem = &vExtraordinaryIdxBuf[0];
-            DXUTGetD3D11Device()->CreateBuffer( &desc, &initdata, &pPatchPiece->m_pMyExtraordinaryPatchIB );
-            DXUT_SetDebugName( pPatchPiece->m_pMyExtraordinaryPatchIB, "CSubDMesh Xord IB" );
-
-            // Create per-patch data buffer for regular patches
-            desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-            desc.ByteWidth = vRegularPatchData.GetSize() * sizeof(PatchData);
-            initdata.pSysMem = &vRegularPatchData[0];
-            DXUTGetD3D11Device()->CreateBuffer( &desc, &initdata, &pPatchPiece->m_pMyRegularPatchData );
-            DXUT_SetDebugName( pPatchPiece->m_pMyRegularPatchData, "CSubDMesh PerPatch" );
-
-            // Create per-patch data buffer for extraordinary patches
-            desc.ByteWidth = vExtraordinaryPatchData.GetSize() * sizeof(PatchData);
-            initdata.pSysMem = &vExtraordinaryPatchData[0];
-            DXUTGetD3D11Device()->CreateBuffer( &desc, &initdata, &pPatchPiece->m_pMyExtraordinaryPatchData );
-            DXUT_SetDebugName( pPatchPiece->m_pMyExtraordinaryPatchData, "CSubDMesh Xord PerPatch" );
-            
+            V_RETURN( CreatePatchBuffers( pd3dDevice, pPatchPiece,
+                                          vRegularIdxBuf.GetData(), vRegularPatchData.GetData(), vRegularPatchData.GetSize(),
+                                          vExtraordinaryIdxBuf.GetData(), vExtraordinaryPatchData.GetData(), vExtraordinaryPatchData.GetSize() ) );
+
             // Create a SRV for the per-patch data            
             D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc;
             SRVDesc.Format = DXGI_FORMAT_R8G8B8A8_UINT;
@@ -380,17 +389,6 @@ HRESULT CSubDMesh::LoadSubDFromSDKMesh( ID3D11Device* pd3dDevice, const WCHAR* s
             V_RETURN( pd3dDevice->CreateShaderResourceView( pPatchPiece->m_pPerPatchDataVB, &SRVDesc, &pPatchPiece->m_pPerPatchDataSRV ) );
             DXUT_SetDebugName( pPatchPiece->m_pPerPatchDataSRV, "CSubDMesh PatchVB SRV" );
 
-            // Create SRV for regular per-patch data
-            SRVDesc.Buffer.FirstElement = 0;
-            SRVDesc.Buffer.NumElements = vRegularPatchData.GetSize() * 2;
-            V_RETURN( pd3dDevice->CreateShaderResourceView( pPatchPiece->m_pMyRegularPatchData, &SRVDesc, &pPatchPiece->m_pMyRegularPatchDataSRV ) );
-            DXUT_SetDebugName( pPatchPiece->m_pMyRegularPatchDataSRV, "CSubDMesh PerPatch SRV" );
-
-            // Create SRV for extraordinary per-patch data
-            SRVDesc.Buffer.NumElements = vExtraordinaryPatchData.GetSize() * 2;
-            V_RETURN( pd3dDevice->CreateShaderResourceView( pPatchPiece->m_pMyExtraordinaryPatchData, &SRVDesc, &pPatchPiece->m_pMyExtraordinaryPatchDataSRV ) );
-            DXUT_SetDebugName( pPatchPiece->m_pMyExtraordinaryPatchDataSRV, "CSubDMesh Xord PerPatch SRV" );
-
             pPatchPiece->m_vCenter = pMesh->BoundingBoxCenter;
             pPatchPiece->m_vExtents = pMesh->BoundingBoxExtents;
 
@@ -431,6 +429,177 @@ HRESULT CSubDMesh::LoadSubDFromSDKMesh( ID3D11Device* pd3dDevice, const WCHAR* s
     return S_OK;
 }
 
+//--------------------------------------------------------------------------------------
+// Makes patches out of a mesh piece that holds plain quads.  The quad subsets are taken
+// together, so the 1-ring around a patch can reach into the neighbouring subsets, and
+// their patches are then split back up per subset like the exporter's are.  Faces that
+// cannot be made into patches (non-manifold or boundary corners, or more points or a
+// higher valence than the hull shader takes) are kept as triangles.
+//--------------------------------------------------------------------------------------
+HRESULT CSubDMesh::BuildPatchPiece( ID3D11Device* pd3dDevice, PatchPiece* pPatchPiece )
+{
+    HRESULT hr;
+
+    const UINT iMesh = pPatchPiece->m_MeshIndex;
+    SDKMESH_MESH* pMesh = pPatchPiece->m_pMesh;
+    const BYTE* pIndices = m_pMeshFile->GetRawIndicesAt( pMesh->IndexBuffer );
+    const bool b16BitIndices = ( m_pMeshFile->GetIndexType( iMesh ) == IT_16BIT );
+
+    // Gather the faces of the quad subsets
+    const UINT nNumSub = m_pMeshFile->GetNumSubsets( iMesh );
+    std::vector<UINT> vFaces;
+    std::vector<UINT> vSubsetFirstFace( nNumSub + 1 );
+    for( UINT i = 0; i < nNumSub; ++i )
+    {
+        SDKMESH_SUBSET* pSubset = m_pMeshFile->GetSubset( iMesh, i );
+        vSubsetFirstFace[i] = (UINT)vFaces.size() / 4;
+        if( pSubset->PrimitiveType != PT_QUAD_PATCH_LIST )
+            continue;
+
+        for( UINT64 j = pSubset->IndexStart; j < pSubset->IndexStart + pSubset->IndexCount / 4 * 4; ++j )
+        {
+            vFaces.push_back( b16BitIndices ? ( (const USHORT*)pIndices )[j] : ( (const UINT*)pIndices )[j] );
+        }
+    }
+    vSubsetFirstFace[nNumSub] = (UINT)vFaces.size() / 4;
+
+    if( vFaces.empty() )
+        return E_FAIL;
+
+    SubDPatchBuilder Builder;
+    Builder.SetLimits( MAX_EXTRAORDINARY_POINTS, MAX_VALENCE - 1 );
+
+    // The position is the first member of the control point
+    SubDPatchBuilder::Polygons Polygons;
+    Polygons.Positions = (const float*)m_pMeshFile->GetRawVerticesAt( pMesh->VertexBuffers[0] );
+    Polygons.Stride = sizeof( SUBD_CONTROL_POINT );
+    Polygons.VertexCount = (UINT)m_pMeshFile->GetNumVertices( iMesh, 0 );
+    Polygons.Indices = &vFaces[0];
+    Polygons.FaceSizes = NULL;
+    Polygons.FaceCount = (UINT)vFaces.size() / 4;
+    Builder.Build( Polygons );
+
+    const SubDPatchBuilder::PatchList& Regular = Builder.GetRegularPatches();
+    const SubDPatchBuilder::PatchList& Extraordinary = Builder.GetExtraordinaryPatches();
+    const SubDPatchBuilder::TriangleList& Triangles = Builder.GetTriangles();
+
+    // The lists keep the face order, so each subset's patches are a contiguous run
+    for( UINT i = 0; i < nNumSub; ++i )
+    {
+        UINT uFirst = vSubsetFirstFace[i];
+        UINT uEnd = vSubsetFirstFace[i + 1];
+
+        UINT uStart = (UINT)( std::lower_bound( Regular.Faces.begin(), Regular.Faces.end(), uFirst ) - Regular.Faces.begin() );
+        pPatchPiece->RegularPatchStart.Add( uStart );
+        pPatchPiece->RegularPatchCount.Add( (UINT)( std::lower_bound( Regular.Faces.begin(), Regular.Faces.end(), uEnd ) - Regular.Faces.begin() ) - uStart );
+
+        uStart = (UINT)( std::lower_bound( Extraordinary.Faces.begin(), Extraordinary.Faces.end(), uFirst ) - Extraordinary.Faces.begin() );
+        pPatchPiece->ExtraordinaryPatchStart.Add( uStart );
+        pPatchPiece->ExtraordinaryPatchCount.Add( (UINT)( std::lower_bound( Extraordinary.Faces.begin(), Extraordinary.Faces.end(), uEnd ) - Extraordinary.Faces.begin() ) - uStart );
+
+        uStart = (UINT)( std::lower_bound( Triangles.Faces.begin(), Triangles.Faces.end(), uFirst ) - Triangles.Faces.begin() );
+        pPatchPiece->PolygonStart.Add( uStart );
+        pPatchPiece->PolygonCount.Add( (UINT)( std::lower_bound( Triangles.Faces.begin(), Triangles.Faces.end(), uEnd ) - Triangles.Faces.begin() ) - uStart );
+    }
+
+    pPatchPiece->m_iPatchCount = (INT)( Regular.Count() + Extraordinary.Count() );
+    pPatchPiece->m_iRegularExtraodinarySplitPoint = Extraordinary.Count() > 0 ? (INT)Regular.Count() : -1;
+
+    V_RETURN( CreatePatchBuffers( pd3dDevice, pPatchPiece,
+                                  Regular.Count() > 0 ? &Regular.Indices[0] : NULL, Regular.Count() > 0 ? &Regular.Data[0] : NULL, Regular.Count(),
+                                  Extraordinary.Count() > 0 ? &Extraordinary.Indices[0] : NULL, Extraordinary.Count() > 0 ? &Extraordinary.Data[0] : NULL, Extraordinary.Count() ) );
+
+    // The leftover faces are drawn as plain triangles
+    if( !Triangles.Indices.empty() )
+    {
+        D3D11_SUBRESOURCE_DATA initdata;
+        initdata.pSysMem = &Triangles.Indices[0];
+        D3D11_BUFFER_DESC desc;
+        desc.ByteWidth = (UINT)Triangles.Indices.size() * sizeof(UINT);
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+        desc.CPUAccessFlags = 0;
+        desc.MiscFlags = 0;
+        desc.StructureByteStride = 0;
+        V_RETURN( pd3dDevice->CreateBuffer( &desc, &initdata, &pPatchPiece->m_pMyPolygonIB ) );
+        DXUT_SetDebugName( pPatchPiece->m_pMyPolygonIB, "CSubDMesh Polygon IB" );
+    }
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Creates the index and per-patch data buffers of the regular and the extraordinary
+// patches of a mesh piece.  Each patch has MAX_EXTRAORDINARY_POINTS indices and one
+// valence/prefix pair.
+//--------------------------------------------------------------------------------------
+HRESULT CSubDMesh::CreatePatchBuffers( ID3D11Device* pd3dDevice, PatchPiece* pPatchPiece,
+                                       const UINT* pRegularIdx, const void* pRegularData, UINT nRegular,
+                                       const UINT* pExtraordinaryIdx, const void* pExtraordinaryData, UINT nExtraordinary )
+{
+    HRESULT hr;
+
+    const UINT PatchDataSize = sizeof( SubDPatchBuilder::PatchData );
+
+    D3D11_SUBRESOURCE_DATA initdata;
+    D3D11_BUFFER_DESC desc;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.CPUAccessFlags = 0;
+    desc.MiscFlags = 0;
+    desc.StructureByteStride = 0;
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc;
+    SRVDesc.Format = DXGI_FORMAT_R8G8B8A8_UINT;
+    SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    SRVDesc.Buffer.FirstElement = 0;
+
+    if( nRegular > 0 )
+    {
+        // Create index buffer for the regular patches
+        desc.ByteWidth = nRegular * MAX_EXTRAORDINARY_POINTS * sizeof(UINT);
+        desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+        initdata.pSysMem = pRegularIdx;
+        V_RETURN( pd3dDevice->CreateBuffer( &desc, &initdata, &pPatchPiece->m_pMyRegularPatchIB ) );
+        DXUT_SetDebugName( pPatchPiece->m_pMyRegularPatchIB, "CSubDMesh IB" );
+
+        // Create per-patch data buffer for regular patches
+        desc.ByteWidth = nRegular * PatchDataSize;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        initdata.pSysMem = pRegularData;
+        V_RETURN( pd3dDevice->CreateBuffer( &desc, &initdata, &pPatchPiece->m_pMyRegularPatchData ) );
+        DXUT_SetDebugName( pPatchPiece->m_pMyRegularPatchData, "CSubDMesh PerPatch" );
+
+        // Create SRV for regular per-patch data
+        SRVDesc.Buffer.NumElements = nRegular * 2;
+        V_RETURN( pd3dDevice->CreateShaderResourceView( pPatchPiece->m_pMyRegularPatchData, &SRVDesc, &pPatchPiece->m_pMyRegularPatchDataSRV ) );
+        DXUT_SetDebugName( pPatchPiece->m_pMyRegularPatchDataSRV, "CSubDMesh PerPatch SRV" );
+    }
+
+    if( nExtraordinary > 0 )
+    {
+        // Create index buffer for the extraordinary patches
+        desc.ByteWidth = nExtraordinary * MAX_EXTRAORDINARY_POINTS * sizeof(UINT);
+        desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+        initdata.pSysMem = pExtraordinaryIdx;
+        V_RETURN( pd3dDevice->CreateBuffer( &desc, &initdata, &pPatchPiece->m_pMyExtraordinaryPatchIB ) );
+        DXUT_SetDebugName( pPatchPiece->m_pMyExtraordinaryPatchIB, "CSubDMesh Xord IB" );
+
+        // Create per-patch data buffer for extraordinary patches
+        desc.ByteWidth = nExtraordinary * PatchDataSize;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        initdata.pSysMem = pExtraordinaryData;
+        V_RETURN( pd3dDevice->CreateBuffer( &desc, &initdata, &pPatchPiece->m_pMyExtraordinaryPatchData ) );
+        DXUT_SetDebugName( pPatchPiece->m_pMyExtraordinaryPatchData, "CSubDMesh Xord PerPatch" );
+
+        // Create SRV for extraordinary per-patch data
+        SRVDesc.Buffer.NumElements = nExtraordinary * 2;
+        V_RETURN( pd3dDevice->CreateShaderResourceView( pPatchPiece->m_pMyExtraordinaryPatchData, &SRVDesc, &pPatchPiece->m_pMyExtraordinaryPatchDataSRV ) );
+        DXUT_SetDebugName( pPatchPiece->m_pMyExtraordinaryPatchDataSRV, "CSubDMesh Xord PerPatch SRV" );
+    }
+
+    return S_OK;
+}
+
 //--------------------------------------------------------------------------------------
 CSubDMesh::~CSubDMesh()
 {
@@ -630,6 +799,34 @@ void CSubDMesh::RenderPatchPiece_OnlyExtraordinary( ID3D11DeviceContext* pd3dDev
     }
 }
 
+// This only renders the faces of the mesh piece that could not be made into patches
+void CSubDMesh::RenderPatchPiece_OnlyPolygons( ID3D11DeviceContext* pd3dDeviceContext, int PieceIndex )
+{
+    PatchPiece* pPiece = m_PatchPieces[PieceIndex];
+    assert( pPiece != NULL );
+
+    if( pPiece->m_pMyPolygonIB == NULL )
+        return;
+
+    pd3dDeviceContext->IASetIndexBuffer( pPiece->m_pMyPolygonIB, DXGI_FORMAT_R32_UINT, 0 );
+    UINT Stride = sizeof( SUBD_CONTROL_POINT );
+    UINT Offset = 0;
+    pd3dDeviceContext->IASetVertexBuffers( 0, 1, &pPiece->m_pControlPointVB, &Stride, &Offset );
+    pd3dDeviceContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+
+    int SubsetCount = m_pMeshFile->GetNumSubsets( pPiece->m_MeshIndex );
+    for( int i = 0; i < SubsetCount; ++i )
+    {
+        if( pPiece->PolygonCount[i] == 0 )
+            continue;
+
+        SDKMESH_SUBSET* pSubset = m_pMeshFile->GetSubset( pPiece->m_MeshIndex, i );
+        SetupMaterial( pd3dDeviceContext, pSubset->MaterialID );
+
+        pd3dDeviceContext->DrawIndexed( pPiece->PolygonCount[i] * 3, pPiece->PolygonStart[i] * 3, 0 );
+    }
+}
+
 void CSubDMesh::RenderPolyMeshPiece( ID3D11DeviceContext* pd3dDeviceContext, int PieceIndex )
 {
     PolyMeshPiece* pPiece = m_PolyMeshPieces[PieceIndex];
@@ -699,6 +896,7 @@ void CSubDMesh::Destroy()
         SAFE_RELEASE( pPiece->m_pMyRegularPatchDataSRV );
         SAFE_RELEASE( pPiece->m_pMyRegularPatchIB );
         SAFE_RELEASE( pPiece->m_pMyExtraordinaryPatchIB );
+        SAFE_RELEASE( pPiece->m_pMyPolygonIB );
 
         delete pPiece;
     }
@@ -3,6 +3,8 @@
 //
 // This class encapsulates the mesh loading and housekeeping functions for a SubDMesh.
 // The mesh loads preprocessed SDKMESH files from disk and stages them for rendering.
+// Meshes that hold plain quads instead are turned into patches at load time by
+// SubDPatchBuilder.
 //
 // To view the mesh preprocessing code, please find the ExportSubDMesh.cpp file in the 
 // samples content exporter.
@@ -57,10 +59,14 @@ private:
         ID3D11ShaderResourceView* m_pMyRegularPatchDataSRV;
         ID3D11ShaderResourceView* m_pMyExtraordinaryPatchDataSRV;
 
+        ID3D11Buffer* m_pMyPolygonIB;                   // Faces of a plain quad mesh that could not be made into patches
+
         CGrowableArray<UINT> RegularPatchStart;
         CGrowableArray<UINT> ExtraordinaryPatchStart;
         CGrowableArray<UINT> RegularPatchCount;
         CGrowableArray<UINT> ExtraordinaryPatchCount;
+        CGrowableArray<UINT> PolygonStart;              // In triangles
+        CGrowableArray<UINT> PolygonCount;
 
         D3DXVECTOR3     m_vCenter;
         D3DXVECTOR3     m_vExtents;
@@ -97,6 +103,7 @@ public:
 
     void        RenderPatchPiece_OnlyRegular( ID3D11DeviceContext* pd3dDeviceContext, int PieceIndex );
     void        RenderPatchPiece_OnlyExtraordinary( ID3D11DeviceContext* pd3dDeviceContext, int PieceIndex );
+    void        RenderPatchPiece_OnlyPolygons( ID3D11DeviceContext* pd3dDeviceContext, int PieceIndex );
     void        RenderPolyMeshPiece( ID3D11DeviceContext* pd3dDeviceContext, int PieceIndex );
 
     // Per-frame update
@@ -164,4 +171,9 @@ public:
 
 protected:
     void SetupMaterial( ID3D11DeviceContext* pd3dDeviceContext, int MaterialID );
+
+    HRESULT BuildPatchPiece( ID3D11Device* pd3dDevice, PatchPiece* pPatchPiece );
+    HRESULT CreatePatchBuffers( ID3D11Device* pd3dDevice, PatchPiece* pPatchPiece,
+                                const UINT* pRegularIdx, const void* pRegularData, UINT nRegular,
+                                const UINT* pExtraordinaryIdx, const void* pExtraordinaryData, UINT nExtraordinary );
 };
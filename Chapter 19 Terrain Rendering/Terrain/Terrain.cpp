@@ -7,6 +7,7 @@
 #include "LightHelper.h"
 #include "Effects.h"
 #include "Vertex.h"
+#include "Profiler.h"
 #include <fstream>
 #include <sstream>
 
@@ -52,41 +53,7 @@ float Terrain::GetDepth()const
 
 float Terrain::GetHeight(float x, float z)const
 {
-	// Transform from terrain local space to "cell" space.
-	float c = (x + 0.5f*GetWidth()) /  mInfo.CellSpacing;
-	float d = (z - 0.5f*GetDepth()) / -mInfo.CellSpacing;
-
-	// Get the row and column we are in.
-	int row = (int)floorf(d);
-	int col = (int)floorf(c);
-
-	// Grab the heights of the cell we are in.
-	// A*--*B
-	//  | /|
-	//  |/ |
-	// C*--*D
-	float A = mHeightmap[row*mInfo.HeightmapWidth + col];
-	float B = mHeightmap[row*mInfo.HeightmapWidth + col + 1];
-	float C = mHeightmap[(row+1)*mInfo.HeightmapWidth + col];
-	float D = mHeightmap[(row+1)*mInfo.HeightmapWidth + col + 1];
-
-	// Where we are relative to the cell.
-	float s = c - (float)col;
-	float t = d - (float)row;
-
-	// If upper triangle ABC.
-	if( s + t <= 1.0f)
-	{
-		float uy = B - A;
-		float vy = C - A;
-		return A + s*uy + t*vy;
-	}
-	else // lower triangle DCB.
-	{
-		float uy = C - D;
-		float vy = B - D;
-		return D + (1.0f-s)*uy + (1.0f-t)*vy;
-	}
+	return mHeightmap.GetHeight(x, z);
 }
 
 XMMATRIX Terrain::GetWorld()const
@@ -101,6 +68,8 @@ void Terrain::SetWorld(CXMMATRIX M)
 
 void Terrain::Init(ID3D11Device* device, ID3D11DeviceContext* dc, const InitInfo& initInfo)
 {
+	PROFILE_FUNCTION();
+
 	mInfo = initInfo;
 
 	// Divide heightmap into patches such that each patch has CellsPerPatch.
@@ -110,9 +79,10 @@ void Terrain::Init(ID3D11Device* device, ID3D11DeviceContext* dc, const InitInfo
 	mNumPatchVertices  = mNumPatchVertRows*mNumPatchVertCols;
 	mNumPatchQuadFaces = (mNumPatchVertRows-1)*(mNumPatchVertCols-1);
 
-	LoadHeightmap();
-	Smooth();
-	CalcAllPatchBoundsY();
+	mHeightmap.LoadRaw(mInfo.HeightMapFilename, mInfo.HeightmapWidth, mInfo.HeightmapHeight,
+		mInfo.HeightScale, mInfo.CellSpacing);
+	mHeightmap.Smooth();
+	mHeightmap.CalcPatchBoundsY(CellsPerPatch, mPatchBoundsY);
 
 	BuildQuadPatchVB(device);
 	BuildQuadPatchIB(device);
@@ -132,6 +102,8 @@ void Terrain::Init(ID3D11Device* device, ID3D11DeviceContext* dc, const InitInfo
 
 void Terrain::Draw(ID3D11DeviceContext* dc, const Camera& cam, DirectionalLight lights[3])
 {
+	PROFILE_FUNCTION();
+
 	dc->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
 	dc->IASetInputLayout(InputLayouts::Terrain);
 
@@ -188,131 +160,6 @@ void Terrain::Draw(ID3D11DeviceContext* dc, const Camera& cam, DirectionalLight
 	dc->DSSetShader(0, 0, 0);
 }
 
-void Terrain::LoadHeightmap()
-{
-	// A height for each vertex
-	std::vector<unsigned char> in( mInfo.HeightmapWidth * mInfo.HeightmapHeight );
-
-	// Open the file.
-	std::ifstream inFile;
-	inFile.open(mInfo.HeightMapFilename.c_str(), std::ios_base::binary);
-
-	if(inFile)
-	{
-		// Read the RAW bytes.
-		inFile.read((char*)&in[0], (std::streamsize)in.size());
-
-		// Done with file.
-		inFile.close();
-	}
-
-	// Copy the array data into a float array and scale it.
-	mHeightmap.resize(mInfo.HeightmapHeight * mInfo.HeightmapWidth, 0);
-	for(UINT i = 0; i < mInfo.HeightmapHeight * mInfo.HeightmapWidth; ++i)
-	{
-		mHeightmap[i] = (in[i] / 255.0f)*mInfo.HeightScale;
-	}
-}
-
-void Terrain::Smooth()
-{
-	std::vector<float> dest( mHeightmap.size() );
-
-	for(UINT i = 0; i < mInfo.HeightmapHeight; ++i)
-	{
-		for(UINT j = 0; j < mInfo.HeightmapWidth; ++j)
-		{
-			dest[i*mInfo.HeightmapWidth+j] = Average(i,j);
-		}
-	}
-
-	// Replace the old heightmap with the filtered one.
-	mHeightmap = dest;
-}
-
-bool Terrain::InBounds(int i, int j)
-{
-	// True if ij are valid indices; false otherwise.
-	return 
-		i >= 0 && i < (int)mInfo.HeightmapHeight && 
-		j >= 0 && j < (int)mInfo.HeightmapWidth;
-}
-
-float Terrain::Average(int i, int j)
-{
-	// Function computes the average height of the ij element.
-	// It averages itself with its eight neighbor pixels.  Note
-	// that if a pixel is missing neighbor, we just don't include it
-	// in the average--that is, edge pixels don't have a neighbor pixel.
-	//
-	// ----------
-	// | 1| 2| 3|
-	// ----------
-	// |4 |ij| 6|
-	// ----------
-	// | 7| 8| 9|
-	// ----------
-
-	float avg = 0.0f;
-	float num = 0.0f;
-
-	// Use int to allow negatives.  If we use UINT, @ i=0, m=i-1=UINT_MAX
-	// and no iterations of the outer for loop occur.
-	for(int m = i-1; m <= i+1; ++m)
-	{
-		for(int n = j-1; n <= j+1; ++n)
-		{
-			if( InBounds(m,n) )
-			{
-				avg += mHeightmap[m*mInfo.HeightmapWidth + n];
-				num += 1.0f;
-			}
-		}
-	}
-
-	return avg / num;
-}
-
-void Terrain::CalcAllPatchBoundsY()
-{
-	mPatchBoundsY.resize(mNumPatchQuadFaces);
-
-	// For each patch
-	for(UINT i = 0; i < mNumPatchVertRows-1; ++i)
-	{
-		for(UINT j = 0; j < mNumPatchVertCols-1; ++j)
-		{
-			CalcPatchBoundsY(i, j);
-		}
-	}
-}
-
-void Terrain::CalcPatchBoundsY(UINT i, UINT j)
-{
-	// Scan the heightmap values this patch covers and compute the min/max height.
-
-	UINT x0 = j*CellsPerPatch;
-	UINT x1 = (j+1)*CellsPerPatch;
-
-	UINT y0 = i*CellsPerPatch;
-	UINT y1 = (i+1)*CellsPerPatch;
-
-	float minY = +MathHelper::Infinity;
-	float maxY = -MathHelper::Infinity;
-	for(UINT y = y0; y <= y1; ++y)
-	{
-		for(UINT x = x0; x <= x1; ++x)
-		{
-			UINT k = y*mInfo.HeightmapWidth + x;
-			minY = MathHelper::Min(minY, mHeightmap[k]);
-			maxY = MathHelper::Max(maxY, mHeightmap[k]);
-		}
-	}
-
-	UINT patchID = i*(mNumPatchVertCols-1)+j;
-	mPatchBoundsY[patchID] = XMFLOAT2(minY, maxY);
-}
-
 void Terrain::BuildQuadPatchVB(ID3D11Device* device)
 {
 	std::vector<Vertex::Terrain> patchVertices(mNumPatchVertRows*mNumPatchVertCols);
@@ -400,6 +247,8 @@ void Terrain::BuildQuadPatchIB(ID3D11Device* device)
 
 void Terrain::BuildHeightmapSRV(ID3D11Device* device)
 {
+	PROFILE_FUNCTION();
+
 	D3D11_TEXTURE2D_DESC texDesc;
 	texDesc.Width = mInfo.HeightmapWidth;
 	texDesc.Height = mInfo.HeightmapHeight;
@@ -414,8 +263,9 @@ void Terrain::BuildHeightmapSRV(ID3D11Device* device)
 	texDesc.MiscFlags = 0;
 
 	// HALF is defined in xnamath.h, for storing 16-bit float.
-	std::vector<HALF> hmap(mHeightmap.size());
-	std::transform(mHeightmap.begin(), mHeightmap.end(), hmap.begin(), XMConvertFloatToHalf);
+	const std::vector<float>& heights = mHeightmap.Heights();
+	std::vector<HALF> hmap(heights.size());
+	std::transform(heights.begin(), heights.end(), hmap.begin(), XMConvertFloatToHalf);
 	
 	D3D11_SUBRESOURCE_DATA data;
 	data.pSysMem = &hmap[0];
@@ -8,6 +8,7 @@
 #define TERRAIN_H
 
 #include "d3dUtil.h"
+#include "Heightmap.h"
 
 class Camera;
 struct DirectionalLight;
@@ -46,12 +47,6 @@ public:
 	void Draw(ID3D11DeviceContext* dc, const Camera& cam, DirectionalLight lights[3]);
 
 private:
-	void LoadHeightmap();
-	void Smooth();
-	bool InBounds(int i, int j);
-	float Average(int i, int j);
-	void CalcAllPatchBoundsY();
-	void CalcPatchBoundsY(UINT i, UINT j);
 	void BuildQuadPatchVB(ID3D11Device* device);
 	void BuildQuadPatchIB(ID3D11Device* device);
 	void BuildHeightmapSRV(ID3D11Device* device);
@@ -83,7 +78,7 @@ private:
 	Material mMat;
 
 	std::vector<XMFLOAT2> mPatchBoundsY;
-	std::vector<float> mHeightmap;
+	Heightmap mHeightmap;
 };
 
 #endif // TERRAIN_H
\ No newline at end of file
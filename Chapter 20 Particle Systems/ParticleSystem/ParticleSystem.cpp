@@ -7,9 +7,12 @@
 #include "Vertex.h"
 #include "Effects.h"
 #include "Camera.h"
+
+static_assert(sizeof(CpuParticleSystem::Vertex) == sizeof(Vertex::Particle), "particle vertex size mismatch");
  
 ParticleSystem::ParticleSystem()
-: mInitVB(0), mDrawVB(0), mStreamOutVB(0), mTexArraySRV(0), mRandomTexSRV(0)
+: mInitVB(0), mDrawVB(0), mStreamOutVB(0), mTexArraySRV(0), mRandomTexSRV(0),
+  mHasCpu(false), mSimulateOnCpu(false), mSortByDepth(false), mCpuVB(0)
 {
 	mFirstRun = true;
 	mGameTime = 0.0f;
@@ -19,6 +22,8 @@ ParticleSystem::ParticleSystem()
 	mEyePosW  = XMFLOAT3(0.0f, 0.0f, 0.0f);
 	mEmitPosW = XMFLOAT3(0.0f, 0.0f, 0.0f);
 	mEmitDirW = XMFLOAT3(0.0f, 1.0f, 0.0f);
+
+	mCpuAccelW = XMFLOAT3(0.0f, 0.0f, 0.0f);
 }
 
 ParticleSystem::~ParticleSystem()
@@ -26,6 +31,7 @@ ParticleSystem::~ParticleSystem()
 	ReleaseCOM(mInitVB);
 	ReleaseCOM(mDrawVB);
 	ReleaseCOM(mStreamOutVB);
+	ReleaseCOM(mCpuVB);
 }
 
 float ParticleSystem::GetAge()const
@@ -61,10 +67,43 @@ void ParticleSystem::Init(ID3D11Device* device, ParticleEffect* fx, ID3D11Shader
 	BuildVB(device);
 }
 
+void ParticleSystem::InitCpu(const CpuParticleSystem::EmitterDesc& emitter, const XMFLOAT3& accelW)
+{
+	mCpu.Init(mMaxParticles);
+	mCpu.AddEmitter(emitter, mEmitPosW);
+	mCpu.SetAcceleration(accelW);
+
+	mCpuAccelW = accelW;
+	mHasCpu    = true;
+}
+
+void ParticleSystem::SetSimulateOnCpu(bool cpu)
+{
+	cpu = cpu && mHasCpu;
+	if( cpu != mSimulateOnCpu )
+	{
+		mSimulateOnCpu = cpu;
+		Reset();
+	}
+}
+
+bool ParticleSystem::GetSimulateOnCpu()const
+{
+	return mSimulateOnCpu;
+}
+
+void ParticleSystem::SetSortByDepth(bool sort)
+{
+	mSortByDepth = sort;
+}
+
 void ParticleSystem::Reset()
 {
 	mFirstRun = true;
 	mAge      = 0.0f;
+
+	if( mHasCpu )
+		mCpu.Reset();
 }
 
 void ParticleSystem::Update(float dt, float gameTime)
@@ -73,6 +112,12 @@ void ParticleSystem::Update(float dt, float gameTime)
 	mTimeStep = dt;
 
 	mAge += dt;
+
+	if( mSimulateOnCpu )
+	{
+		mCpu.SetEmitterPosition(0, mEmitPosW);
+		mCpu.Update(dt);
+	}
 }
 
 void ParticleSystem::Draw(ID3D11DeviceContext* dc, const Camera& cam)
@@ -91,6 +136,12 @@ void ParticleSystem::Draw(ID3D11DeviceContext* dc, const Camera& cam)
 	mFX->SetTexArray(mTexArraySRV);
 	mFX->SetRandomTex(mRandomTexSRV);
 
+	if( mSimulateOnCpu )
+	{
+		DrawCpu(dc, cam);
+		return;
+	}
+
 	//
 	// Set IA stage.
 	//
@@ -185,4 +236,53 @@ void ParticleSystem::BuildVB(ID3D11Device* device)
 
     HR(device->CreateBuffer(&vbd, 0, &mDrawVB));
 	HR(device->CreateBuffer(&vbd, 0, &mStreamOutVB));
-}
\ No newline at end of file
+
+	//
+	// Create the buffer the CPU simulation writes each frame.
+	//
+	vbd.Usage = D3D11_USAGE_DYNAMIC;
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+	HR(device->CreateBuffer(&vbd, 0, &mCpuVB));
+}
+
+void ParticleSystem::DrawCpu(ID3D11DeviceContext* dc, const Camera& cam)
+{
+	UINT count = mCpu.GetParticleCount();
+	if( count == 0 )
+		return;
+
+	const UINT* order = 0;
+	if( mSortByDepth )
+	{
+		const float* x;
+		const float* y;
+		const float* z;
+		mCpu.GetPositions(&x, &y, &z);
+
+		mSorter.Sort(DepthSorter::Points::FromArrays(x, y, z, count), cam.GetPosition(), cam.GetLook());
+		order = mSorter.GetOrder();
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	HR(dc->Map(mCpuVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+	mCpu.WriteVertices(reinterpret_cast<CpuParticleSystem::Vertex*>(mappedData.pData), mCpuAccelW, 1, order);
+	dc->Unmap(mCpuVB, 0);
+
+	dc->IASetInputLayout(InputLayouts::Particle);
+	dc->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
+
+	UINT stride = sizeof(Vertex::Particle);
+	UINT offset = 0;
+	dc->IASetVertexBuffers(0, 1, &mCpuVB, &stride, &offset);
+
+	D3DX11_TECHNIQUE_DESC techDesc;
+	mFX->DrawTech->GetDesc( &techDesc );
+	for(UINT p = 0; p < techDesc.Passes; ++p)
+	{
+		mFX->DrawTech->GetPassByIndex( p )->Apply(0, dc);
+
+		dc->Draw(count, 0);
+	}
+}
@@ -6,6 +6,8 @@
 #define PARTICLE_SYSTEM_H
 
 #include "d3dUtil.h"
+#include "CpuParticleSystem.h"
+#include "DepthSorter.h"
 #include <string>
 #include <vector>
 
@@ -31,12 +33,27 @@ public:
 		ID3D11ShaderResourceView* randomTexSRV, 
 		UINT maxParticles);
 
+	///<summary>
+	/// Gives the system an emitter to run on the CPU instead of the stream-out
+	/// technique.  accelW must match the effect's gAccelW, which the draw technique
+	/// applies to each particle's age.
+	///</summary>
+	void InitCpu(const CpuParticleSystem::EmitterDesc& emitter, const XMFLOAT3& accelW);
+
+	// Switches between the stream-out and the CPU simulation; each starts over.
+	void SetSimulateOnCpu(bool cpu);
+	bool GetSimulateOnCpu()const;
+
+	// Draws CPU particles back to front, for effects that alpha blend.
+	void SetSortByDepth(bool sort);
+
 	void Reset();
 	void Update(float dt, float gameTime);
 	void Draw(ID3D11DeviceContext* dc, const Camera& cam);
 
 private:
 	void BuildVB(ID3D11Device* device);
+	void DrawCpu(ID3D11DeviceContext* dc, const Camera& cam);
 
 	ParticleSystem(const ParticleSystem& rhs);
 	ParticleSystem& operator=(const ParticleSystem& rhs);
@@ -59,6 +76,14 @@ private:
 	ID3D11Buffer* mInitVB;	
 	ID3D11Buffer* mDrawVB;
 	ID3D11Buffer* mStreamOutVB;
+
+	CpuParticleSystem mCpu;
+	XMFLOAT3 mCpuAccelW;
+	bool mHasCpu;
+	bool mSimulateOnCpu;
+	bool mSortByDepth;
+	DepthSorter mSorter;
+	ID3D11Buffer* mCpuVB;
  
 	ID3D11ShaderResourceView* mTexArraySRV;
 	ID3D11ShaderResourceView* mRandomTexSRV;
@@ -6,6 +6,7 @@
 // Controls:
 //		Hold the left mouse button down and move the mouse to rotate.
 //      Hold the right mouse button down to zoom in and out.
+//      Press 'C' to simulate the particles on the CPU, 'G' to go back to the GPU.
 //
 //***************************************************************************************
 
@@ -151,12 +152,30 @@ bool ParticlesApp::Init()
 	mFire.Init(md3dDevice, Effects::FireFX, mFlareTexSRV, mRandomTexSRV, 500); 
 	mFire.SetEmitPos(XMFLOAT3(0.0f, 1.0f, 120.0f));
 
+	// The same emitters as the stream-out shaders of Fire.fx and Rain.fx.
+	CpuParticleSystem::EmitterDesc fire;
+	fire.VelocitySpread = XMFLOAT3(2.0f, 4.0f, 2.0f);
+	fire.Size     = XMFLOAT2(3.0f, 3.0f);
+	fire.Lifetime = 1.0f;
+	fire.Rate     = 200.0f;
+	fire.Seed     = 1;
+	mFire.InitCpu(fire, XMFLOAT3(0.0f, 7.8f, 0.0f));
+
 	std::vector<std::wstring> raindrops;
 	raindrops.push_back(L"Textures\\raindrop.dds");
 	mRainTexSRV = d3dHelper::CreateTexture2DArraySRV(md3dDevice, md3dImmediateContext, raindrops);
 
 	mRain.Init(md3dDevice, Effects::RainFX, mRainTexSRV, mRandomTexSRV, 10000); 
 
+	CpuParticleSystem::EmitterDesc rain;
+	rain.Offset       = XMFLOAT3(0.0f, 20.0f, 0.0f);
+	rain.OffsetSpread = XMFLOAT3(35.0f, 0.0f, 35.0f);
+	rain.Size     = XMFLOAT2(1.0f, 1.0f);
+	rain.Lifetime = 3.0f;
+	rain.Rate     = 2500.0f;
+	rain.Seed     = 2;
+	mRain.InitCpu(rain, XMFLOAT3(-1.0f, -9.8f, 0.0f));
+
 	return true;
 }
 
@@ -202,6 +221,20 @@ void ParticlesApp::UpdateScene(float dt)
 		mCam.SetPosition(camPos.x, y + 2.0f, camPos.z);
 	}
 
+	//
+	// CPU/GPU simulation
+	//
+	if( GetAsyncKeyState('C') & 0x8000 )
+	{
+		mFire.SetSimulateOnCpu(true);
+		mRain.SetSimulateOnCpu(true);
+	}
+	if( GetAsyncKeyState('G') & 0x8000 )
+	{
+		mFire.SetSimulateOnCpu(false);
+		mRain.SetSimulateOnCpu(false);
+	}
+
 	//
 	// Reset particle systems.
 	//
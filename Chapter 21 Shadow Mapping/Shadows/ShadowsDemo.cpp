@@ -24,6 +24,7 @@
 #include "Sky.h"
 #include "RenderStates.h"
 #include "ShadowMap.h"
+#include "ShadowCascades.h"
 
 enum RenderOptions
 {
@@ -32,13 +33,6 @@ enum RenderOptions
 	RenderOptionsDisplacementMap = 2
 };
 
-struct BoundingSphere
-{
-	BoundingSphere() : Center(0.0f, 0.0f, 0.0f), Radius(0.0f) {}
-	XMFLOAT3 Center;
-	float Radius;
-};
-
 class ShadowsApp : public D3DApp 
 {
 public:
@@ -84,7 +78,15 @@ private:
 	ID3D11ShaderResourceView* mStoneNormalTexSRV;
 	ID3D11ShaderResourceView* mBrickNormalTexSRV;
 
-	BoundingSphere mSceneBounds;
+	// World space bounds of every object drawn into the shadow map, in the order
+	// the constructor adds them: the grid, the box, each column's cylinder and
+	// sphere, then the skull.
+	enum { GridCaster = 0, BoxCaster = 1, FirstColumnCaster = 2, SkullCaster = 22 };
+	std::vector<XNA::AxisAlignedBox> mCasterBounds;
+	ShadowCascades mCascades;
+
+	// Whether each caster survived the cull of the cascade the shadow map holds.
+	std::vector<bool> mCasterVisible;
 
 	static const int SMapSize = 2048;
 	ShadowMap* mSmap;
@@ -164,13 +166,6 @@ ShadowsApp::ShadowsApp(HINSTANCE hInstance)
 
 	mCam.SetPosition(0.0f, 2.0f, -15.0f);
 
-	// Estimate the scene bounding sphere manually since we know how the scene was constructed.
-	// The grid is the "widest object" with a width of 20 and depth of 30.0f, and centered at
-	// the world space origin.  In general, you need to loop over every world space vertex
-	// position and compute the bounding sphere.
-	mSceneBounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
-	mSceneBounds.Radius = sqrtf(10.0f*10.0f + 15.0f*15.0f);
-
 	XMMATRIX I = XMMatrixIdentity();
 	XMStoreFloat4x4(&mGridWorld, I);
 
@@ -191,6 +186,32 @@ ShadowsApp::ShadowsApp(HINSTANCE hInstance)
 		XMStoreFloat4x4(&mSphereWorld[i*2+1], XMMatrixTranslation(+5.0f, 3.5f, -10.0f + i*5.0f));
 	}
 
+	// Caster bounds are known from how the scene was constructed.  The skull is
+	// added once its vertices have been loaded in BuildSkullGeometryBuffers().
+	XNA::AxisAlignedBox bounds;
+	bounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	bounds.Extents = XMFLOAT3(10.0f, 0.0f, 15.0f);
+	mCasterBounds.push_back(bounds);
+
+	bounds.Center = XMFLOAT3(0.0f, 0.5f, 0.0f);
+	bounds.Extents = XMFLOAT3(1.5f, 0.5f, 1.5f);
+	mCasterBounds.push_back(bounds);
+
+	for(int i = 0; i < 10; ++i)
+	{
+		bounds.Center = XMFLOAT3(mCylWorld[i]._41, mCylWorld[i]._42, mCylWorld[i]._43);
+		bounds.Extents = XMFLOAT3(0.5f, 1.5f, 0.5f);
+		mCasterBounds.push_back(bounds);
+
+		bounds.Center = XMFLOAT3(mSphereWorld[i]._41, mSphereWorld[i]._42, mSphereWorld[i]._43);
+		bounds.Extents = XMFLOAT3(0.5f, 0.5f, 0.5f);
+		mCasterBounds.push_back(bounds);
+	}
+
+	// The shadow effect samples a single shadow map, so use one cascade fit
+	// tightly to the view frustum and the casters.
+	mCascades.Init(1, SMapSize, 0.5f, false);
+
 	mDirLights[0].Ambient  = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
 	mDirLights[0].Diffuse  = XMFLOAT4(0.7f, 0.7f, 0.6f, 1.0f);
 	mDirLights[0].Specular = XMFLOAT4(0.8f, 0.8f, 0.7f, 1.0f);
@@ -346,9 +367,14 @@ void ShadowsApp::UpdateScene(float dt)
 		XMStoreFloat3(&mDirLights[i].Direction, lightDir);
 	}
 	
+	mCam.UpdateViewMatrix();
+
 	BuildShadowTransform();
 
-	mCam.UpdateViewMatrix();
+	std::wostringstream outs;
+	outs << L"Shadows Demo"
+		<< L"    Casters culled: " << mCascades.CulledCasterCount();
+	mMainWndCaption = outs.str();
 }
 
 void ShadowsApp::DrawScene()
@@ -753,34 +779,43 @@ void ShadowsApp::DrawSceneToShadowMap()
     for(UINT p = 0; p < techDesc.Passes; ++p)
     {
 		// Draw the grid.
-		world = XMLoadFloat4x4(&mGridWorld);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
+		if( mCasterVisible[GridCaster] )
+		{
+			world = XMLoadFloat4x4(&mGridWorld);
+			worldInvTranspose = MathHelper::InverseTranspose(world);
+			worldViewProj = world*view*proj;
 
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(8.0f, 10.0f, 1.0f));
+			Effects::BuildShadowMapFX->SetWorld(world);
+			Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+			Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+			Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(8.0f, 10.0f, 1.0f));
 
-		tessSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mGridIndexCount, mGridIndexOffset, mGridVertexOffset);
+			tessSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+			md3dImmediateContext->DrawIndexed(mGridIndexCount, mGridIndexOffset, mGridVertexOffset);
+		}
 
 		// Draw the box.
-		world = XMLoadFloat4x4(&mBoxWorld);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
+		if( mCasterVisible[BoxCaster] )
+		{
+			world = XMLoadFloat4x4(&mBoxWorld);
+			worldInvTranspose = MathHelper::InverseTranspose(world);
+			worldViewProj = world*view*proj;
 
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(2.0f, 1.0f, 1.0f));
+			Effects::BuildShadowMapFX->SetWorld(world);
+			Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+			Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+			Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(2.0f, 1.0f, 1.0f));
 
-		tessSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mBoxIndexCount, mBoxIndexOffset, mBoxVertexOffset);
+			tessSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+			md3dImmediateContext->DrawIndexed(mBoxIndexCount, mBoxIndexOffset, mBoxVertexOffset);
+		}
 
 		// Draw the cylinders.
 		for(int i = 0; i < 10; ++i)
 		{
+			if( !mCasterVisible[FirstColumnCaster + 2*i] )
+				continue;
+
 			world = XMLoadFloat4x4(&mCylWorld[i]);
 			worldInvTranspose = MathHelper::InverseTranspose(world);
 			worldViewProj = world*view*proj;
@@ -812,6 +847,9 @@ void ShadowsApp::DrawSceneToShadowMap()
 		// Draw the spheres.
 		for(int i = 0; i < 10; ++i)
 		{
+			if( !mCasterVisible[FirstColumnCaster + 2*i + 1] )
+				continue;
+
 			world = XMLoadFloat4x4(&mSphereWorld[i]);
 			worldInvTranspose = MathHelper::InverseTranspose(world);
 			worldViewProj = world*view*proj;
@@ -840,17 +878,20 @@ void ShadowsApp::DrawSceneToShadowMap()
 	for(UINT p = 0; p < techDesc.Passes; ++p)
     {
 		// Draw the skull.
-		world = XMLoadFloat4x4(&mSkullWorld);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
+		if( mCasterVisible[SkullCaster] )
+		{
+			world = XMLoadFloat4x4(&mSkullWorld);
+			worldInvTranspose = MathHelper::InverseTranspose(world);
+			worldViewProj = world*view*proj;
 
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
+			Effects::BuildShadowMapFX->SetWorld(world);
+			Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+			Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+			Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
 
-		smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mSkullIndexCount, 0, 0);
+			smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+			md3dImmediateContext->DrawIndexed(mSkullIndexCount, 0, 0);
+		}
 	}
 }
 
@@ -888,38 +929,17 @@ void ShadowsApp::DrawScreenQuad()
 void ShadowsApp::BuildShadowTransform()
 {
 	// Only the first "main" light casts a shadow.
-	XMVECTOR lightDir = XMLoadFloat3(&mDirLights[0].Direction);
-	XMVECTOR lightPos = -2.0f*mSceneBounds.Radius*lightDir;
-	XMVECTOR targetPos = XMLoadFloat3(&mSceneBounds.Center);
-	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-
-	XMMATRIX V = XMMatrixLookAtLH(lightPos, targetPos, up);
-
-	// Transform bounding sphere to light space.
-	XMFLOAT3 sphereCenterLS;
-	XMStoreFloat3(&sphereCenterLS, XMVector3TransformCoord(targetPos, V));
-
-	// Ortho frustum in light space encloses scene.
-	float l = sphereCenterLS.x - mSceneBounds.Radius;
-	float b = sphereCenterLS.y - mSceneBounds.Radius;
-	float n = sphereCenterLS.z - mSceneBounds.Radius;
-	float r = sphereCenterLS.x + mSceneBounds.Radius;
-	float t = sphereCenterLS.y + mSceneBounds.Radius;
-	float f = sphereCenterLS.z + mSceneBounds.Radius;
-	XMMATRIX P = XMMatrixOrthographicOffCenterLH(l, r, b, t, n, f);
-
-	// Transform NDC space [-1,+1]^2 to texture space [0,1]^2
-	XMMATRIX T(
-		0.5f, 0.0f, 0.0f, 0.0f,
-		0.0f, -0.5f, 0.0f, 0.0f,
-		0.0f, 0.0f, 1.0f, 0.0f,
-		0.5f, 0.5f, 0.0f, 1.0f);
+	mCascades.Update(mCam, mDirLights[0].Direction, mCasterBounds);
+
+	XMStoreFloat4x4(&mLightView, mCascades.LightView());
+	XMStoreFloat4x4(&mLightProj, mCascades.LightProj(0));
+	XMStoreFloat4x4(&mShadowTransform, mCascades.ShadowTransform(0));
 
-	XMMATRIX S = V*P*T;
+	const std::vector<UINT>& casters = mCascades.GetCascade(0).Casters;
 
-	XMStoreFloat4x4(&mLightView, V);
-	XMStoreFloat4x4(&mLightProj, P);
-	XMStoreFloat4x4(&mShadowTransform, S);
+	mCasterVisible.assign(mCasterBounds.size(), false);
+	for(size_t i = 0; i < casters.size(); ++i)
+		mCasterVisible[casters[i]] = true;
 }
 
 void ShadowsApp::BuildShapeGeometryBuffers()
@@ -1061,6 +1081,21 @@ void ShadowsApp::BuildSkullGeometryBuffers()
 		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
 	}
 
+	XMMATRIX skullWorld = XMLoadFloat4x4(&mSkullWorld);
+	XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+	for(UINT i = 0; i < vcount; ++i)
+	{
+		XMVECTOR P = XMVector3TransformCoord(XMLoadFloat3(&vertices[i].Pos), skullWorld);
+		vMin = XMVectorMin(vMin, P);
+		vMax = XMVectorMax(vMax, P);
+	}
+
+	XNA::AxisAlignedBox skullBounds;
+	XMStoreFloat3(&skullBounds.Center, 0.5f*(vMin + vMax));
+	XMStoreFloat3(&skullBounds.Extents, 0.5f*(vMax - vMin));
+	mCasterBounds.push_back(skullBounds);
+
 	fin >> ignore;
 	fin >> ignore;
 	fin >> ignore;
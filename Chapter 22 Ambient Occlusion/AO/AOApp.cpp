@@ -17,6 +17,7 @@
 #include "ShaderFactoryDX11.h"
 #include "MeshGeometry.h"
 #include "Octree.h"
+#include "Profiler.h"
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "D3DCompiler.lib")
@@ -83,6 +84,8 @@ void BuildVertexAmbientOcclusion(
 	std::vector<T>& vertices,
 	const std::vector<UINT>& indices)
 {
+	PROFILE_FUNCTION();
+
 	UINT vcount = vertices.size();
 	UINT tcount = indices.size()/3;
 
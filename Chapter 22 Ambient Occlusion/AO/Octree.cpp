@@ -3,6 +3,7 @@
 //***************************************************************************************
 
 #include "Octree.h"
+#include "Profiler.h"
 
 
 Octree::Octree()
@@ -17,6 +18,8 @@ Octree::~Octree()
 
 void Octree::Build(const std::vector<XMFLOAT3>& vertices, const std::vector<UINT>& indices)
 {
+	PROFILE_FUNCTION();
+
 	// Cache a copy of the vertices.
 	mVertices = vertices;
 
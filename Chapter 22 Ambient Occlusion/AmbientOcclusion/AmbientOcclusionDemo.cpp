@@ -18,6 +18,7 @@
 #include "Vertex.h"
 #include "Camera.h"
 #include "Octree.h"
+#include "Profiler.h"
 
 class AmbientOcclusionApp : public D3DApp 
 {
@@ -214,6 +215,8 @@ void AmbientOcclusionApp::BuildVertexAmbientOcclusion(
 	std::vector<Vertex::AmbientOcclusion>& vertices,
 	const std::vector<UINT>& indices)
 {
+	PROFILE_FUNCTION();
+
 	UINT vcount = vertices.size();
 	UINT tcount = indices.size()/3;
 
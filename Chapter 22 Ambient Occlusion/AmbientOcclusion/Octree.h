@@ -7,8 +7,13 @@
 #ifndef OCTREE_H
 #define OCTREE_H
 
-#include "d3dUtil.h"
-#include "XnaCollision.h"
+#include "MathHelper.h"
+#include "xnacollision.h"
+#include <vector>
+
+#ifndef SafeDelete
+#define SafeDelete(x) { delete x; x = 0; }
+#endif
 
 struct OctreeNode;
 
@@ -24,6 +24,7 @@ namespace
 #include "LightHelper.h"
 #include "FrameResource.h"
 #include "PipelineStateObject.h"
+#include "PipelineStateManager.h"
 #include "MeshGeometry.h"
 #include "RenderTarget.h"
 #include "TextureResource.h"
@@ -194,7 +195,6 @@ public:
 private:
 	void BuildViewDependentResource();
 	void CompileShader(ShaderType Type, std::string Name, D3D_SHADER_MACRO * Defines, const std::wstring & Filename, const std::string & Function, const std::string & Model);
-	void CreatePSO(const std::string & tag, const PipelineStateDesc & desc);
 	RenderTargetPtr CreateRenderTarget(std::string name);
 	ColorBufferPtr CreateColorBuffer(std::string name, uint32_t Width, uint32_t Height, uint32_t NumMips, DXGI_FORMAT Format, D3D11_SUBRESOURCE_DATA* Data = nullptr);
 	DepthBufferPtr CreateDepthBuffer(std::string name, uint32_t Width, uint32_t Height, DXGI_FORMAT Format);
@@ -208,7 +208,7 @@ private:
 	void UpdateCamera(float dt);
 	void BuildScreenQuad();
 	void BuildStaticSamplers();
-	void ApplyPipelineState(const std::string& tag);
+	void ApplyPipelineState(PipelineStateManager::Handle handle);
 	void FrameRender(double fTime, float fElapsedTime, void * pUserContext);
 
 	void ComputeRenderTimes(ID3D11DeviceContext * pDeviceContext, UINT64 Frequency, NVSDK_D3D11_RenderTimesForAO * pRenderTimes);
@@ -221,29 +221,26 @@ private:
 	void BuildVertexLayout();
 
 private:
-	std::unordered_map<std::string, ShaderPtr> m_Shaders[NumShader];
-	std::unordered_map<std::string, ComPtr<ID3D11BlendState>> mBlendState;
-	std::unordered_map<std::string, ComPtr<ID3D11DepthStencilState>> mDepthStencilState;
-	std::unordered_map<std::string, ComPtr<ID3D11InputLayout>> mInputLayout;
-	std::unordered_map<std::string, ComPtr<ID3D11RasterizerState>> mRasterizerState;
+	PipelineStateManager mPipelineStates;
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
 	std::unordered_map<std::string, std::unique_ptr<MaterialFresnel>> mMaterials;
 	std::unordered_map<std::string, TextureResourcePtr> mTextures;
 	std::unordered_map<std::string, ColorBufferPtr> mColors;
 	std::unordered_map<std::string, DepthBufferPtr> mDepths;
-	std::unordered_map<std::string, RenderTargetPtr> mRenderTargets;
     std::unique_ptr<FrameResource> mFrameResource;
-	std::unordered_map<std::string, ComPtr<ID3D11SamplerState>> m_SamplerState;
 
 	ColorBufferPtr m_RenderTargetBuffer;
 
 	ComPtr<ID3D11Buffer> m_ScreenVertex, m_ScreenIndex;
 
-	std::unordered_map<std::string, std::unique_ptr<PipelineStateObject>> mPSOs;
 	std::unordered_map<std::string, ComPtr<ID3D11Buffer>> mConstantBuffers;
 
 	D3D11_VIEWPORT m_HalfViewport;
-	PipelineStateObject* m_pCurrentPSO = nullptr;
+	PipelineStateManager::Handle mNormalDepthPSO = PipelineStateManager::InvalidHandle;
+	PipelineStateManager::Handle mComputeSSAOPSO = PipelineStateManager::InvalidHandle;
+	PipelineStateManager::Handle mBlurPSO = PipelineStateManager::InvalidHandle;
+	PipelineStateManager::Handle mCompositePSO = PipelineStateManager::InvalidHandle;
+	PipelineStateManager::Handle mCompositeNoBlendPSO = PipelineStateManager::InvalidHandle;
 
 	XMMATRIX mView = XMMatrixIdentity();
 	XMMATRIX mProj = XMMatrixIdentity();
@@ -305,6 +302,7 @@ bool SSAOApp::Init()
 	if (!D3DApp::Init())
 		return false;
 
+	mPipelineStates.Initialize(md3dDevice);
 	InitDXUT();
 	LoadTextures();
 	BuildStaticSamplers();
@@ -469,13 +467,12 @@ void SSAOApp::CompileShader(
 	const std::string& Model)
 {
 	auto Shader = std::make_shared<ShaderDX11>(Type, Name, Defines, Filename, Function, Model);
-	m_Shaders[Type].insert_or_assign(Name, Shader);
+	mPipelineStates.AddShader(Shader);
 }
 
 ID3DBlob* SSAOApp::GetShaderBlob(ShaderType Type, std::string Name)
 {
-	assert(m_Shaders[Type].count( Name ));
-	return m_Shaders[Type][Name]->m_CompiledShader.Get();
+	return mPipelineStates.GetShader(Type, Name)->m_CompiledShader.Get();
 }
 
 void SSAOApp::BuildVertexLayout()
@@ -493,7 +490,7 @@ void SSAOApp::BuildVertexLayout()
 		GetShaderBlob(VertexShader, "ssao")->GetBufferPointer(),
 		GetShaderBlob(VertexShader, "ssao")->GetBufferSize(),
 		pLayoutTex.GetAddressOf()));
-	mInputLayout["tex"] = pLayoutTex;
+	mPipelineStates.AddInputLayout("tex", pLayoutTex);
 }
 
 void SSAOApp::UpdateScene(float dt)
@@ -595,7 +592,7 @@ void SSAOApp::UpdateCamera(float dt)
 	mProj = mCam.Proj();
 }
 
-void SSAOApp::ApplyPipelineState(const std::string& tag)
+void SSAOApp::ApplyPipelineState(PipelineStateManager::Handle handle)
 {
 	ID3D11ShaderResourceView* pSRVs[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = { 0 };
     md3dImmediateContext->VSSetShaderResources(0, ARRAYSIZE(pSRVs), pSRVs);
@@ -603,50 +600,12 @@ void SSAOApp::ApplyPipelineState(const std::string& tag)
     md3dImmediateContext->PSSetShaderResources(0, ARRAYSIZE(pSRVs), pSRVs);
     md3dImmediateContext->CSSetShaderResources(0, ARRAYSIZE(pSRVs), pSRVs);
 
-	assert(mPSOs.count(tag));
-	auto pPSO = mPSOs[tag].get();
-
-	for (int i = 0; i < NumShader; i++)
-	{
-		if (!pPSO->m_Shaders[i]) 
-			continue;
-
-		auto Type = static_cast<ShaderType>(i);
-		switch (Type) {
-		case VertexShader:
-			{
-				auto pVS = reinterpret_cast<ID3D11VertexShader*>(pPSO->m_Shaders[VertexShader]->m_Shader.Get());
-				md3dImmediateContext->VSSetShader(pVS, nullptr, 0);
-				break;
-			}
-		case PixelShader:
-			{
-				auto pPS = reinterpret_cast<ID3D11PixelShader*>(pPSO->m_Shaders[PixelShader]->m_Shader.Get());
-				md3dImmediateContext->PSSetShader(pPS, nullptr, 0);
-				break;
-			}
-		}
-	}
-
-	md3dImmediateContext->IASetInputLayout(pPSO->pIL);
-	md3dImmediateContext->OMSetBlendState(
-		pPSO->blend.pBlendState,
-		pPSO->blend.BlendFactor.data(),
-		pPSO->blend.SampleMask);
-	md3dImmediateContext->OMSetDepthStencilState(
-		pPSO->depthStencil.pDepthStencilState,
-		pPSO->depthStencil.StencilRef);
-	md3dImmediateContext->RSSetState(pPSO->pResterizer);
-	if (pPSO->pRenderTarget)
-		pPSO->pRenderTarget->Bind();
-
-	m_pCurrentPSO = pPSO;
+	mPipelineStates.Apply(md3dImmediateContext, handle);
 }
 
 ID3D11SamplerState* SSAOApp::GetSampler(const std::string& name)
 {
-	 assert(m_SamplerState.count(name));
-	 return m_SamplerState[name].Get();
+	 return mPipelineStates.GetSamplerState(name);
 }
 
 void SSAOApp::FrameRender(double fTime, float fElapsedTime, void* pUserContext)
@@ -811,16 +770,17 @@ void SSAOApp::DrawSceneWithSSAO(ID3D11DeviceContext* pDeviceContext, NVSDK_D3D11
 		pDeviceContext->End(m_TimestampQueries.pTimestampQueryBegin);
 	}
 
-	ApplyPipelineState("NormalDepth");
-	pDeviceContext->RSSetState(mRasterizerState["nowireframe"].Get());
+	ApplyPipelineState(mNormalDepthPSO);
 	FrameRender(0, 0, nullptr);
+	// The scene renderer sets its own shaders and states.
+	mPipelineStates.Invalidate();
 
 	if (pRenderTimes)
 	{
 		pDeviceContext->End(m_TimestampQueries.pTimestampQueryZ);
 	}
 
-	ApplyPipelineState("ComputeSSAO");
+	ApplyPipelineState(mComputeSSAOPSO);
 	ComputeSSAO();
 
 	if (pRenderTimes)
@@ -828,7 +788,7 @@ void SSAOApp::DrawSceneWithSSAO(ID3D11DeviceContext* pDeviceContext, NVSDK_D3D11
 		pDeviceContext->End(m_TimestampQueries.pTimestampQueryAO);
 	}
 
-	ApplyPipelineState("BlurSSAO");
+	ApplyPipelineState(mBlurPSO);
 	BlurAmbientMap(1);
 
 	if (pRenderTimes)
@@ -837,13 +797,7 @@ void SSAOApp::DrawSceneWithSSAO(ID3D11DeviceContext* pDeviceContext, NVSDK_D3D11
 		pDeviceContext->End(m_TimestampQueries.pTimestampQueryBlurY);
 	}
 
-	ApplyPipelineState("Composite");
-	std::array<FLOAT, 4> BlendFactor = { 1.f, 1.f, 1.f, 1.f };
-	UINT SampleMask = 0xFFFFFFFF;
-	if (mState == 1) 
-	{
-		pDeviceContext->OMSetBlendState(mBlendState["composite"].Get(), BlendFactor.data(), SampleMask);
-	}
+	ApplyPipelineState(mState == 1 ? mCompositePSO : mCompositeNoBlendPSO);
 	Composite();
 
 	if (pRenderTimes)
@@ -868,6 +822,9 @@ void SSAOApp::DrawScene()
 
 	md3dImmediateContext->RSSetViewports(1, &mScreenViewport);
 
+	// The sky and the text of the last frame changed state behind the manager.
+	mPipelineStates.Invalidate();
+
 	if (mState == 1 || mState == 0)
 	{
 		DrawSceneWithSSAO(md3dImmediateContext, &RenderTimes);
@@ -877,13 +834,13 @@ void SSAOApp::DrawScene()
 		m_RenderTargetBuffer->Clear();
 		mDepths["depthBuffer"]->Clear();
 		ID3D11RenderTargetView* ColorRTV = { m_RenderTargetBuffer->GetRTV() };
-		md3dImmediateContext->RSSetState(mRasterizerState["wireframe"].Get());
+		md3dImmediateContext->RSSetState(mPipelineStates.GetRasterizerState("wireframe"));
 		// Render color and depth with the Scene3D class
 		md3dImmediateContext->OMSetRenderTargets(1, &ColorRTV, mDepths["depthBuffer"]->GetDSV());
 		FrameRender(0, 0, nullptr);
 	}
 
-	mRenderTargets["sky"]->Bind();
+	mPipelineStates.GetRenderTarget("sky")->Bind();
 	m_pSky->Draw(md3dImmediateContext, mCam);
 
 	RenderText(RenderTimes, NumBytes);
@@ -940,8 +897,9 @@ void SSAOApp::BlurAmbientMap(UINT nCount)
 
 void SSAOApp::ShaderCheckResource(ShaderType Type, D3D_SHADER_INPUT_TYPE InputType, UINT Slot, std::string Name)
 {
-	assert(m_pCurrentPSO->m_Shaders[Type]);
-	assert(m_pCurrentPSO->m_Shaders[Type]->ShaderCheckResource(Type, InputType, Slot, Name));
+	const auto& PSO = mPipelineStates.GetPSO(mPipelineStates.GetCurrent());
+	assert(PSO.m_Shaders[Type]);
+	assert(PSO.m_Shaders[Type]->ShaderCheckResource(Type, InputType, Slot, Name));
 }
 
 void SSAOApp::Composite()
@@ -1188,36 +1146,28 @@ void SSAOApp::BuildStaticSamplers()
 
 void SSAOApp::CreateBlendState(const std::string& tag, const D3D11_BLEND_DESC & desc)
 {
-	ComPtr<ID3D11BlendState> BS;
-	HR(md3dDevice->CreateBlendState(&desc, BS.GetAddressOf()));
-	mBlendState[tag] = BS;
+	mPipelineStates.CreateBlendState(tag, desc);
 }
 
 void SSAOApp::CreateDepthStencilState(const std::string& tag, const D3D11_DEPTH_STENCIL_DESC& desc)
 {
-	ComPtr<ID3D11DepthStencilState> DDS;
-	HR(md3dDevice->CreateDepthStencilState(&desc, DDS.GetAddressOf()));
-	mDepthStencilState[tag] = DDS;
+	mPipelineStates.CreateDepthStencilState(tag, desc);
 }
 
 void SSAOApp::CreateResterizerState(const std::string& tag, const D3D11_RASTERIZER_DESC& desc)
 {
-	ComPtr<ID3D11RasterizerState> RS;
-	HR(md3dDevice->CreateRasterizerState(&desc, RS.GetAddressOf()));
-	mRasterizerState[tag] = RS;
+	mPipelineStates.CreateRasterizerState(tag, desc);
 }
 
 void SSAOApp::CreateSampler(std::string name, const CD3D11_SAMPLER_DESC& desc)
 {
-	ComPtr<ID3D11SamplerState> SS;
-	HR(md3dDevice->CreateSamplerState(&desc, SS.GetAddressOf()));
-	m_SamplerState[name] = SS;
+	mPipelineStates.CreateSamplerState(name, desc);
 }
 
 RenderTargetPtr SSAOApp::CreateRenderTarget(std::string name)
 {
     auto renderTarget = std::make_shared<RenderTarget>();
-    mRenderTargets[name] = renderTarget;
+    mPipelineStates.AddRenderTarget(name, renderTarget);
     return renderTarget;
 }
 
@@ -1237,53 +1187,6 @@ DepthBufferPtr SSAOApp::CreateDepthBuffer(std::string name, uint32_t Width, uint
 	return Buffer;
 }
 
-void SSAOApp::CreatePSO(const std::string& tag, const PipelineStateDesc& desc)
-{
-	auto pPSO = std::make_unique<PipelineStateObject>();
-	if (mInputLayout.count(desc.IL)) {
-		pPSO->pIL = mInputLayout[desc.IL].Get();
-		assert(pPSO->pIL != nullptr);
-	}
-
-	for (int i = 0; i < NumShader; i++)
-	{
-		auto Type = static_cast<ShaderType>(i);
-		if (desc.m_ShaderName[Type].empty()) 
-			continue;
-		pPSO->m_Shaders[Type] = m_Shaders[Type][desc.m_ShaderName[Type]];
-		assert(Type == pPSO->m_Shaders[Type]->m_ShaderType);
-	}
-
-	if (!desc.BS.empty()) {
-		assert(mBlendState.count(desc.BS));
-		pPSO->blend.pBlendState = mBlendState[desc.BS].Get();
-	}
-	pPSO->blend.BlendFactor = desc.BlendFactor;
-	pPSO->blend.SampleMask = desc.SampleMask;
-
-	if (!desc.DSS.empty()) {
-		assert(mDepthStencilState.count(desc.DSS));
-		pPSO->depthStencil.pDepthStencilState = mDepthStencilState[desc.DSS].Get();
-	}
-	pPSO->depthStencil.StencilRef = desc.StencilRef;
-
-	if (!desc.RS.empty()) {
-		assert(mRasterizerState.count(desc.RS));
-		pPSO->pResterizer = mRasterizerState[desc.RS].Get();
-	}
-
-	if (!desc.RT.empty()) {
-		assert(mRenderTargets.count(desc.RT));
-		pPSO->pRenderTarget = mRenderTargets[desc.RT].get();
-	}
-
-	for (int i = 0; i < NumShader; i++) {
-		// Sampler state
-	}
-
-	mPSOs[tag].swap(pPSO);
-}
-
 void SSAOApp::BuildViewDependentResource()
 {
 	auto HalfWidth = static_cast<uint32_t>(mClientWidth * 1.0);
@@ -1350,8 +1253,9 @@ void SSAOApp::BuildPSO()
 	NormalDepthRenderTarget->SetColor(Slot::Color0, Normal);
 	NormalDepthRenderTarget->SetColor(Slot::Color1, m_RenderTargetBuffer);
 	NormalDepthRenderTarget->SetDepth(DepthBuffer);
+	NormalDepthState.RS = "nowireframe";
 	NormalDepthState.RT = "normalDepth";
-	CreatePSO("NormalDepth", NormalDepthState);
+	mNormalDepthPSO = mPipelineStates.CreatePSO(NormalDepthState);
 
 	std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // random floats between 0.0 - 1.0
 	std::default_random_engine generator;
@@ -1377,10 +1281,10 @@ void SSAOApp::BuildPSO()
 	ComputeSSAOTarget->SetColor(Slot::Color0, mColors["AmbientBuffer0"]);
 	ComputeSSAOState.RT = "ssao";
 	ComputeSSAOState.BindSampler(VertexShader | PixelShader, { "normal", "depth", "randomeVec" });
-	CreatePSO("ComputeSSAO", ComputeSSAOState);
+	mComputeSSAOPSO = mPipelineStates.CreatePSO(ComputeSSAOState);
 
 	PipelineStateDesc BlurState { "", "blur", "blur" };
-	CreatePSO("BlurSSAO", BlurState);
+	mBlurPSO = mPipelineStates.CreatePSO(BlurState);
 
 	auto DrawRenderTarget = CreateRenderTarget("draw");
 	DrawRenderTarget->SetColor(Slot::Color0, m_RenderTargetBuffer);
@@ -1390,7 +1294,9 @@ void SSAOApp::BuildPSO()
 
 	PipelineStateDesc CompositeState { "", "composite", "composite" };
 	CompositeState.RT = "draw";
-	CreatePSO("Composite", CompositeState);
+	mCompositeNoBlendPSO = mPipelineStates.CreatePSO(CompositeState);
+	CompositeState.BS = "composite";
+	mCompositePSO = mPipelineStates.CreatePSO(CompositeState);
 
 	auto SkyRenderTarget = CreateRenderTarget("sky");
 	SkyRenderTarget->SetColor(Slot::Color0, m_RenderTargetBuffer);
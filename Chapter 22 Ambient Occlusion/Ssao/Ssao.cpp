@@ -6,10 +6,12 @@
 #include "Camera.h"
 #include "Effects.h"
 #include "Vertex.h"
+#include "SsaoReference.h"
 
 Ssao::Ssao(ID3D11Device* device, ID3D11DeviceContext* dc, int width, int height, float fovy, float farZ)
 	: md3dDevice(device), mDC(dc), mScreenQuadVB(0), mScreenQuadIB(0), mRandomVectorSRV(0),
-	  mNormalDepthRTV(0), mNormalDepthSRV(0), mAmbientRTV0(0), mAmbientSRV0(0), mAmbientRTV1(0), mAmbientSRV1(0)
+	  mNormalDepthRTV(0), mNormalDepthSRV(0), mAmbientRTV0(0), mAmbientSRV0(0), mAmbientRTV1(0), mAmbientSRV1(0),
+	  mAmbientMapDivisor(2)
 
 {
 	OnSize(width, height, fovy, farZ);
@@ -43,17 +45,36 @@ void Ssao::OnSize(int width, int height, float fovy, float farZ)
 	mRenderTargetWidth = width;
 	mRenderTargetHeight = height;
 
-	// We render to ambient map at half the resolution.
+	// We render to ambient map at a fraction of the resolution.
 	mAmbientMapViewport.TopLeftX = 0.0f;
 	mAmbientMapViewport.TopLeftY = 0.0f;
-	mAmbientMapViewport.Width = width / 2.0f;
-	mAmbientMapViewport.Height = height / 2.0f;
+	mAmbientMapViewport.Width = (float)(width / mAmbientMapDivisor);
+	mAmbientMapViewport.Height = (float)(height / mAmbientMapDivisor);
 	mAmbientMapViewport.MinDepth = 0.0f;
 	mAmbientMapViewport.MaxDepth = 1.0f;
 	
 	BuildFrustumFarCorners(fovy, farZ);
     BuildTextureViews();
 }
+
+void Ssao::SetAmbientMapDivisor(UINT divisor)
+{
+	divisor = divisor >= 4 ? 4 : 2;
+	if( divisor == mAmbientMapDivisor )
+		return;
+
+	mAmbientMapDivisor = divisor;
+
+	mAmbientMapViewport.Width = (float)(mRenderTargetWidth / mAmbientMapDivisor);
+	mAmbientMapViewport.Height = (float)(mRenderTargetHeight / mAmbientMapDivisor);
+
+	BuildTextureViews();
+}
+
+UINT Ssao::AmbientMapDivisor()const
+{
+	return mAmbientMapDivisor;
+}
  
 void Ssao::SetNormalDepthRenderTarget(ID3D11DepthStencilView* dsv)
 {
@@ -121,6 +142,55 @@ void Ssao::BlurAmbientMap(int blurCount)
 	}
 }
 
+bool Ssao::DumpNormalDepthMap(const std::string& filename, const Camera& camera)
+{
+	ID3D11Resource* normalDepthTex = 0;
+	mNormalDepthSRV->GetResource(&normalDepthTex);
+
+	D3D11_TEXTURE2D_DESC texDesc;
+	static_cast<ID3D11Texture2D*>(normalDepthTex)->GetDesc(&texDesc);
+	texDesc.Usage = D3D11_USAGE_STAGING;
+	texDesc.BindFlags = 0;
+	texDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+	ID3D11Texture2D* stagingTex = 0;
+	HR(md3dDevice->CreateTexture2D(&texDesc, 0, &stagingTex));
+
+	mDC->CopyResource(stagingTex, normalDepthTex);
+	ReleaseCOM(normalDepthTex);
+
+	SsaoReference::NormalDepthMap map;
+	map.Width  = texDesc.Width;
+	map.Height = texDesc.Height;
+	map.FovY   = camera.GetFovY();
+	map.FarZ   = camera.GetFarZ();
+	map.Texels.resize(map.Width*map.Height);
+
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	HR(mDC->Map(stagingTex, 0, D3D11_MAP_READ, 0, &mappedData));
+
+	// The normal/depth map is R16G16B16A16_FLOAT.
+	for(UINT y = 0; y < map.Height; ++y)
+	{
+		const HALF* row = reinterpret_cast<const HALF*>(
+			static_cast<const BYTE*>(mappedData.pData) + y*mappedData.RowPitch);
+
+		for(UINT x = 0; x < map.Width; ++x)
+		{
+			map.Texels[y*map.Width + x] = XMFLOAT4(
+				XMConvertHalfToFloat(row[4*x+0]),
+				XMConvertHalfToFloat(row[4*x+1]),
+				XMConvertHalfToFloat(row[4*x+2]),
+				XMConvertHalfToFloat(row[4*x+3]));
+		}
+	}
+
+	mDC->Unmap(stagingTex, 0);
+	ReleaseCOM(stagingTex);
+
+	return map.Save(filename);
+}
+
 void Ssao::BlurAmbientMap(ID3D11ShaderResourceView* inputSRV, ID3D11RenderTargetView* outputRTV, bool horzBlur)
 {
 	ID3D11RenderTargetView* renderTargets[1] = {outputRTV};
@@ -256,9 +326,9 @@ void Ssao::BuildTextureViews()
 	// view saves a reference.
 	ReleaseCOM(normalDepthTex);
 	
-	// Render ambient map at half resolution.
-	texDesc.Width = mRenderTargetWidth / 2;
-	texDesc.Height = mRenderTargetHeight / 2;
+	// Render ambient map at reduced resolution.
+	texDesc.Width = mRenderTargetWidth / mAmbientMapDivisor;
+	texDesc.Height = mRenderTargetHeight / mAmbientMapDivisor;
 	texDesc.Format = DXGI_FORMAT_R16_FLOAT;
 	ID3D11Texture2D* ambientTex0 = 0;
 	HR(md3dDevice->CreateTexture2D(&texDesc, 0, &ambientTex0));
@@ -8,8 +8,9 @@
 #define SSAO_H
 
 #include "d3dUtil.h"
+#include <string>
  
- // Should we render AO at half resolution?
+ // The ambient map is rendered at 1/2 (default) or 1/4 of the back buffer size.
  
 class Camera;
 
@@ -26,6 +27,15 @@ public:
 	/// Call when the backbuffer is resized.  
 	///</summary>
 	void OnSize(int width, int height, float fovy, float farZ);
+
+	///<summary>
+	/// Sets the ambient map size to the back buffer size divided by divisor (2 or
+	/// 4) and rebuilds the ambient maps if it changed.  The lit passes sample
+	/// the ambient map with a linear filter, so quarter resolution costs a softer
+	/// result at edges for a quarter of the occlusion pass cost.
+	///</summary>
+	void SetAmbientMapDivisor(UINT divisor);
+	UINT AmbientMapDivisor()const;
  
 	///<summary>
 	/// Changes the render target to the NormalDepth render target.  Pass the 
@@ -50,6 +60,13 @@ public:
 	///</summary>
 	void BlurAmbientMap(int blurCount);
 
+	///<summary>
+	/// Reads the normal/depth map back to the CPU and writes it in the format
+	/// SsaoReference::NormalDepthMap loads, so the SSAO pass can be reproduced
+	/// and compared offline.
+	///</summary>
+	bool DumpNormalDepthMap(const std::string& filename, const Camera& camera);
+
 private:
 	Ssao(const Ssao& rhs);
 	Ssao& operator=(const Ssao& rhs);
@@ -91,6 +108,7 @@ private:
 
 	UINT mRenderTargetWidth;
 	UINT mRenderTargetHeight;
+	UINT mAmbientMapDivisor;
 
 	XMFLOAT4 mFrustumFarCorner[4];
 
@@ -10,6 +10,8 @@
 //      Press '2' for BasicFX
 //      Press '3' for Normal mapping
 //      Press '4' for Displacement mapping
+//      Press 'P' to save the normal/depth map for the CPU reference SSAO
+//      Press 'H' / 'Q' to compute the ambient map at half / quarter resolution
 //
 //***************************************************************************************
 
@@ -24,6 +26,7 @@
 #include "Sky.h"
 #include "RenderStates.h"
 #include "ShadowMap.h"
+#include "ShadowCasterCache.h"
 #include "Ssao.h"
 
 enum RenderOptions
@@ -94,6 +97,15 @@ private:
 	XMFLOAT4X4 mLightProj;
 	XMFLOAT4X4 mShadowTransform;
 
+	// The light turns every frame, so the static depth could never be reused; the
+	// cache is only used to cull the casters outside the light frustum.
+	ShadowCasterCache mCasterCache;
+	UINT mGridCaster;
+	UINT mBoxCaster;
+	UINT mCylCaster[10];
+	UINT mSphereCaster[10];
+	UINT mSkullCaster;
+
 	Ssao* mSsao;
 
 	float mLightRotationAngle;
@@ -133,6 +145,9 @@ private:
 
 	Camera mCam;
 
+	// P was down last frame; the dump is written once per press.
+	bool mDumpKeyDown;
+
 	POINT mLastMousePos;
 };
 
@@ -159,7 +174,7 @@ SsaoApp::SsaoApp(HINSTANCE hInstance)
   mStoneTexSRV(0), mBrickTexSRV(0),
   mStoneNormalTexSRV(0), mBrickNormalTexSRV(0), 
   mSkullIndexCount(0),  mRenderOptions(RenderOptionsNormalMap), mSmap(0), mSsao(0),
-  mLightRotationAngle(0.0f)
+  mLightRotationAngle(0.0f), mDumpKeyDown(false)
 {
 	mMainWndCaption = L"SSAO Demo";
 	
@@ -195,6 +210,32 @@ SsaoApp::SsaoApp(HINSTANCE hInstance)
 		XMStoreFloat4x4(&mSphereWorld[i*2+1], XMMatrixTranslation(+5.0f, 3.5f, -10.0f + i*5.0f));
 	}
 
+	// Caster bounds are known from how the scene was constructed, except for the
+	// skull's, which BuildSkullGeometryBuffers() fills in from its vertices.
+	XNA::AxisAlignedBox bounds;
+	bounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	bounds.Extents = XMFLOAT3(10.0f, 0.0f, 15.0f);
+	mGridCaster = mCasterCache.AddCaster(bounds, true);
+
+	bounds.Center = XMFLOAT3(0.0f, 0.5f, 0.0f);
+	bounds.Extents = XMFLOAT3(1.5f, 0.5f, 1.5f);
+	mBoxCaster = mCasterCache.AddCaster(bounds, true);
+
+	for(int i = 0; i < 10; ++i)
+	{
+		bounds.Center = XMFLOAT3(mCylWorld[i]._41, mCylWorld[i]._42, mCylWorld[i]._43);
+		bounds.Extents = XMFLOAT3(0.5f, 1.5f, 0.5f);
+		mCylCaster[i] = mCasterCache.AddCaster(bounds, true);
+
+		bounds.Center = XMFLOAT3(mSphereWorld[i]._41, mSphereWorld[i]._42, mSphereWorld[i]._43);
+		bounds.Extents = XMFLOAT3(0.5f, 0.5f, 0.5f);
+		mSphereCaster[i] = mCasterCache.AddCaster(bounds, true);
+	}
+
+	bounds.Center = XMFLOAT3(mSkullWorld._41, mSkullWorld._42, mSkullWorld._43);
+	bounds.Extents = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	mSkullCaster = mCasterCache.AddCaster(bounds, true);
+
 	mDirLights[0].Ambient  = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	mDirLights[0].Diffuse  = XMFLOAT4(0.5f, 0.5f, 0.4f, 1.0f);
 	mDirLights[0].Specular = XMFLOAT4(0.8f, 0.8f, 0.7f, 1.0f);
@@ -345,6 +386,12 @@ void SsaoApp::UpdateScene(float dt)
 	if( GetAsyncKeyState('4') & 0x8000 )
 		mRenderOptions = RenderOptionsDisplacementMap; 
 
+	if( GetAsyncKeyState('H') & 0x8000 )
+		mSsao->SetAmbientMapDivisor(2);
+
+	if( GetAsyncKeyState('Q') & 0x8000 )
+		mSsao->SetAmbientMapDivisor(4);
+
 	//
 	// Animate the lights (and hence shadows).
 	//
@@ -361,6 +408,13 @@ void SsaoApp::UpdateScene(float dt)
 	
 	BuildShadowTransform();
 
+	mCasterCache.Update(XMLoadFloat4x4(&mLightView), XMLoadFloat4x4(&mLightProj));
+
+	std::wostringstream outs;
+	outs << L"SSAO Demo"
+		<< L"    Casters culled: " << mCasterCache.CulledCasterCount();
+	mMainWndCaption = outs.str();
+
 	mCam.UpdateViewMatrix();
 }
 
@@ -389,6 +443,12 @@ void SsaoApp::DrawScene()
 	
 	DrawSceneToSsaoNormalDepthMap();
 
+	// Save the normal/depth map for the CPU reference SSAO.
+	bool dumpKeyDown = (GetAsyncKeyState('P') & 0x8000) != 0;
+	if( dumpKeyDown && !mDumpKeyDown )
+		mSsao->DumpNormalDepthMap("ssao_normaldepth.bin", mCam);
+	mDumpKeyDown = dumpKeyDown;
+
 	//
 	// Now compute the ambient occlusion.
 	//
@@ -935,34 +995,43 @@ void SsaoApp::DrawSceneToShadowMap()
     for(UINT p = 0; p < techDesc.Passes; ++p)
     {
 		// Draw the grid.
-		world = XMLoadFloat4x4(&mGridWorld);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
+		if( mCasterCache.IsCasterVisible(mGridCaster) )
+		{
+			world = XMLoadFloat4x4(&mGridWorld);
+			worldInvTranspose = MathHelper::InverseTranspose(world);
+			worldViewProj = world*view*proj;
 
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(8.0f, 10.0f, 1.0f));
+			Effects::BuildShadowMapFX->SetWorld(world);
+			Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+			Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+			Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(8.0f, 10.0f, 1.0f));
 
-		tessSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mGridIndexCount, mGridIndexOffset, mGridVertexOffset);
+			tessSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+			md3dImmediateContext->DrawIndexed(mGridIndexCount, mGridIndexOffset, mGridVertexOffset);
+		}
 
 		// Draw the box.
-		world = XMLoadFloat4x4(&mBoxWorld);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
+		if( mCasterCache.IsCasterVisible(mBoxCaster) )
+		{
+			world = XMLoadFloat4x4(&mBoxWorld);
+			worldInvTranspose = MathHelper::InverseTranspose(world);
+			worldViewProj = world*view*proj;
 
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(2.0f, 1.0f, 1.0f));
+			Effects::BuildShadowMapFX->SetWorld(world);
+			Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+			Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+			Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(2.0f, 1.0f, 1.0f));
 
-		tessSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mBoxIndexCount, mBoxIndexOffset, mBoxVertexOffset);
+			tessSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+			md3dImmediateContext->DrawIndexed(mBoxIndexCount, mBoxIndexOffset, mBoxVertexOffset);
+		}
 
 		// Draw the cylinders.
 		for(int i = 0; i < 10; ++i)
 		{
+			if( !mCasterCache.IsCasterVisible(mCylCaster[i]) )
+				continue;
+
 			world = XMLoadFloat4x4(&mCylWorld[i]);
 			worldInvTranspose = MathHelper::InverseTranspose(world);
 			worldViewProj = world*view*proj;
@@ -994,6 +1063,9 @@ void SsaoApp::DrawSceneToShadowMap()
 		// Draw the spheres.
 		for(int i = 0; i < 10; ++i)
 		{
+			if( !mCasterCache.IsCasterVisible(mSphereCaster[i]) )
+				continue;
+
 			world = XMLoadFloat4x4(&mSphereWorld[i]);
 			worldInvTranspose = MathHelper::InverseTranspose(world);
 			worldViewProj = world*view*proj;
@@ -1022,17 +1094,20 @@ void SsaoApp::DrawSceneToShadowMap()
 	for(UINT p = 0; p < techDesc.Passes; ++p)
     {
 		// Draw the skull.
-		world = XMLoadFloat4x4(&mSkullWorld);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
+		if( mCasterCache.IsCasterVisible(mSkullCaster) )
+		{
+			world = XMLoadFloat4x4(&mSkullWorld);
+			worldInvTranspose = MathHelper::InverseTranspose(world);
+			worldViewProj = world*view*proj;
 
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
+			Effects::BuildShadowMapFX->SetWorld(world);
+			Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+			Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+			Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
 
-		smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mSkullIndexCount, 0, 0);
+			smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+			md3dImmediateContext->DrawIndexed(mSkullIndexCount, 0, 0);
+		}
 	}
 }
 
@@ -1243,6 +1318,21 @@ void SsaoApp::BuildSkullGeometryBuffers()
 		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
 	}
 
+	XMMATRIX skullWorld = XMLoadFloat4x4(&mSkullWorld);
+	XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+	for(UINT i = 0; i < vcount; ++i)
+	{
+		XMVECTOR P = XMVector3TransformCoord(XMLoadFloat3(&vertices[i].Pos), skullWorld);
+		vMin = XMVectorMin(vMin, P);
+		vMax = XMVectorMax(vMax, P);
+	}
+
+	XNA::AxisAlignedBox skullBounds;
+	XMStoreFloat3(&skullBounds.Center, 0.5f*(vMin + vMax));
+	XMStoreFloat3(&skullBounds.Extents, 0.5f*(vMax - vMin));
+	mCasterCache.SetCasterBounds(mSkullCaster, skullBounds);
+
 	fin >> ignore;
 	fin >> ignore;
 	fin >> ignore;
@@ -17,11 +17,8 @@ BasicModel::BasicModel(ID3D11Device* device, TextureMgr& texMgr, const std::stri
 	{
 		Mat.push_back(mats[i].Mat);
 
-		ID3D11ShaderResourceView* diffuseMapSRV = texMgr.CreateTexture(texturePath + mats[i].DiffuseMapName);
-		DiffuseMapSRV.push_back(diffuseMapSRV);
-
-		ID3D11ShaderResourceView* normalMapSRV = texMgr.CreateTexture(texturePath + mats[i].NormalMapName);
-		NormalMapSRV.push_back(normalMapSRV);
+		DiffuseMap.push_back(texMgr.RequestTexture(texturePath + mats[i].DiffuseMapName));
+		NormalMap.push_back(texMgr.RequestTexture(texturePath + mats[i].NormalMapName));
 	}
 }
 
@@ -14,8 +14,11 @@ public:
 	UINT SubsetCount;
 
 	std::vector<Material> Mat;
-	std::vector<ID3D11ShaderResourceView*> DiffuseMapSRV;
-	std::vector<ID3D11ShaderResourceView*> NormalMapSRV;
+
+	// Streamed by the TextureMgr; look the views up with TextureMgr::GetTexture
+	// every frame.
+	std::vector<TextureStreamer::Handle> DiffuseMap;
+	std::vector<TextureStreamer::Handle> NormalMap;
 
 	// Keep CPU copies of the mesh data to read from.  
 	std::vector<Vertex::PosNormalTexTan> Vertices;
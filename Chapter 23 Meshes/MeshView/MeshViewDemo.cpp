@@ -21,6 +21,7 @@
 #include "Sky.h"
 #include "RenderStates.h"
 #include "ShadowMap.h"
+#include "ShadowCasterCache.h"
 #include "Ssao.h"
 #include "TextureMgr.h"
 #include "BasicModel.h"
@@ -54,6 +55,8 @@ private:
 	void BuildShadowTransform();
 	void BuildScreenQuadGeometryBuffers();
 
+	static XNA::AxisAlignedBox ComputeInstanceBounds(const BasicModelInstance& instance);
+
 private:
 
 	TextureMgr mTexMgr;
@@ -86,6 +89,12 @@ private:
 	XMFLOAT4X4 mLightProj;
 	XMFLOAT4X4 mShadowTransform;
 
+	// Neither the light nor any model moves, so the shadow map is drawn once and
+	// kept; the cache says when it has to be drawn again.
+	ShadowCasterCache mCasterCache;
+	std::vector<UINT> mModelCasters;
+	std::vector<UINT> mAlphaClippedModelCasters;
+
 	Ssao* mSsao;
 
 	float mLightRotationAngle;
@@ -272,6 +281,16 @@ bool MeshViewApp::Init()
 	mModelInstances.push_back(rockInstance2);
 	mModelInstances.push_back(rockInstance3);
 
+	//
+	// Register every instance as a static shadow caster.
+	//
+
+	for(UINT i = 0; i < mModelInstances.size(); ++i)
+		mModelCasters.push_back(mCasterCache.AddCaster(ComputeInstanceBounds(mModelInstances[i]), true));
+
+	for(UINT i = 0; i < mAlphaClippedModelInstances.size(); ++i)
+		mAlphaClippedModelCasters.push_back(mCasterCache.AddCaster(ComputeInstanceBounds(mAlphaClippedModelInstances[i]), true));
+
 	//
 	// Compute scene bounding box.
 	//
@@ -347,20 +366,39 @@ void MeshViewApp::UpdateScene(float dt)
 
 	BuildShadowTransform();
 
+	mCasterCache.Update(XMLoadFloat4x4(&mLightView), XMLoadFloat4x4(&mLightProj));
+
+	std::wostringstream outs;
+	outs << L"MeshView Demo"
+		<< L"    Casters culled: " << mCasterCache.CulledCasterCount()
+		<< L"    Shadow redraws skipped: " << mCasterCache.SkippedRedrawCount()
+		<< L"    Shadow rebuilds: " << mCasterCache.StaticRebuildCount();
+	mMainWndCaption = outs.str();
+
 	mCam.UpdateViewMatrix();
+
+	//
+	// Upload the texture mips the streamer has read since last frame.
+	//
+
+	mTexMgr.Update(md3dImmediateContext);
 }
 
 void MeshViewApp::DrawScene()
 {
 	//
-	// Render the scene to the shadow map.
+	// Render the scene to the shadow map.  Every caster is static, so the shadow
+	// map still holds last frame's depth unless the cache says otherwise.
 	//
 
-	mSmap->BindDsvAndSetNullRenderTarget(md3dImmediateContext);
+	if( mCasterCache.StaticDepthDirty() )
+	{
+		mSmap->BindDsvAndSetNullRenderTarget(md3dImmediateContext);
 
-	DrawSceneToShadowMap();
+		DrawSceneToShadowMap();
 
-	md3dImmediateContext->RSSetState(0);
+		md3dImmediateContext->RSSetState(0);
+	}
 
 	//
 	// Render the view space normals and depths.  This render target has the
@@ -462,8 +500,8 @@ void MeshViewApp::DrawScene()
 			for(UINT subset = 0; subset < mModelInstances[modelIndex].Model->SubsetCount; ++subset)
 			{
 				Effects::NormalMapFX->SetMaterial(mModelInstances[modelIndex].Model->Mat[subset]);
-				Effects::NormalMapFX->SetDiffuseMap(mModelInstances[modelIndex].Model->DiffuseMapSRV[subset]);
-				Effects::NormalMapFX->SetNormalMap(mModelInstances[modelIndex].Model->NormalMapSRV[subset]);
+				Effects::NormalMapFX->SetDiffuseMap(mTexMgr.GetTexture(mModelInstances[modelIndex].Model->DiffuseMap[subset]));
+				Effects::NormalMapFX->SetNormalMap(mTexMgr.GetTexture(mModelInstances[modelIndex].Model->NormalMap[subset]));
 
 				tech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
 				mModelInstances[modelIndex].Model->ModelMesh.Draw(md3dImmediateContext, subset);
@@ -492,8 +530,8 @@ void MeshViewApp::DrawScene()
 			for(UINT subset = 0; subset < mAlphaClippedModelInstances[modelIndex].Model->SubsetCount; ++subset)
 			{
 				Effects::NormalMapFX->SetMaterial(mAlphaClippedModelInstances[modelIndex].Model->Mat[subset]);
-				Effects::NormalMapFX->SetDiffuseMap(mAlphaClippedModelInstances[modelIndex].Model->DiffuseMapSRV[subset]);
-				Effects::NormalMapFX->SetNormalMap(mAlphaClippedModelInstances[modelIndex].Model->NormalMapSRV[subset]);
+				Effects::NormalMapFX->SetDiffuseMap(mTexMgr.GetTexture(mAlphaClippedModelInstances[modelIndex].Model->DiffuseMap[subset]));
+				Effects::NormalMapFX->SetNormalMap(mTexMgr.GetTexture(mAlphaClippedModelInstances[modelIndex].Model->NormalMap[subset]));
 
 				alphaClippedTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
 				mAlphaClippedModelInstances[modelIndex].Model->ModelMesh.Draw(md3dImmediateContext, subset);
@@ -620,7 +658,7 @@ void MeshViewApp::DrawSceneToSsaoNormalDepthMap()
 			
 			for(UINT subset = 0; subset < mAlphaClippedModelInstances[modelIndex].Model->SubsetCount; ++subset)
 			{
-				Effects::SsaoNormalDepthFX->SetDiffuseMap(mAlphaClippedModelInstances[modelIndex].Model->DiffuseMapSRV[subset]);
+				Effects::SsaoNormalDepthFX->SetDiffuseMap(mTexMgr.GetTexture(mAlphaClippedModelInstances[modelIndex].Model->DiffuseMap[subset]));
 				alphaClippedTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
 				mAlphaClippedModelInstances[modelIndex].Model->ModelMesh.Draw(md3dImmediateContext, subset);
 			}
@@ -659,6 +697,9 @@ void MeshViewApp::DrawSceneToShadowMap()
     {
 		for(UINT modelIndex = 0; modelIndex < mModelInstances.size(); ++modelIndex)
 		{
+			if( !mCasterCache.IsCasterVisible(mModelCasters[modelIndex]) )
+				continue;
+
 			world = XMLoadFloat4x4(&mModelInstances[modelIndex].World);
 			worldInvTranspose = MathHelper::InverseTranspose(world);
 			worldViewProj = world*view*proj;
@@ -682,6 +723,9 @@ void MeshViewApp::DrawSceneToShadowMap()
     {
 		for(UINT modelIndex = 0; modelIndex < mAlphaClippedModelInstances.size(); ++modelIndex)
 		{
+			if( !mCasterCache.IsCasterVisible(mAlphaClippedModelCasters[modelIndex]) )
+				continue;
+
 			world = XMLoadFloat4x4(&mAlphaClippedModelInstances[modelIndex].World);
 			worldInvTranspose = MathHelper::InverseTranspose(world);
 			worldViewProj = world*view*proj;
@@ -693,7 +737,7 @@ void MeshViewApp::DrawSceneToShadowMap()
 
 			for(UINT subset = 0; subset < mAlphaClippedModelInstances[modelIndex].Model->SubsetCount; ++subset)
 			{
-				Effects::BuildShadowMapFX->SetDiffuseMap(mAlphaClippedModelInstances[modelIndex].Model->DiffuseMapSRV[subset]);
+				Effects::BuildShadowMapFX->SetDiffuseMap(mTexMgr.GetTexture(mAlphaClippedModelInstances[modelIndex].Model->DiffuseMap[subset]));
 				alphaClippedTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
 				mAlphaClippedModelInstances[modelIndex].Model->ModelMesh.Draw(md3dImmediateContext, subset);
 			}
@@ -771,6 +815,24 @@ void MeshViewApp::BuildShadowTransform()
 	XMStoreFloat4x4(&mShadowTransform, S);
 }
 
+XNA::AxisAlignedBox MeshViewApp::ComputeInstanceBounds(const BasicModelInstance& instance)
+{
+	XMMATRIX world = XMLoadFloat4x4(&instance.World);
+	XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+	for(UINT i = 0; i < instance.Model->Vertices.size(); ++i)
+	{
+		XMVECTOR P = XMVector3TransformCoord(XMLoadFloat3(&instance.Model->Vertices[i].Pos), world);
+		vMin = XMVectorMin(vMin, P);
+		vMax = XMVectorMax(vMax, P);
+	}
+
+	XNA::AxisAlignedBox bounds;
+	XMStoreFloat3(&bounds.Center, 0.5f*(vMin + vMax));
+	XMStoreFloat3(&bounds.Extents, 0.5f*(vMax - vMin));
+	return bounds;
+}
+
 void MeshViewApp::BuildScreenQuadGeometryBuffers()
 {
 	GeometryGenerator::MeshData quad;
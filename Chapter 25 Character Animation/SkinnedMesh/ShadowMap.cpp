@@ -5,7 +5,8 @@
 #include "ShadowMap.h"
 
 ShadowMap::ShadowMap(ID3D11Device* device, UINT width, UINT height)
-: mWidth(width), mHeight(height), mDepthMapSRV(0), mDepthMapDSV(0)
+: mWidth(width), mHeight(height), mDepthMap(0), mDepthMapSRV(0), mDepthMapDSV(0),
+  mStaticDepthMap(0), mStaticDepthMapDSV(0)
 {
     mViewport.TopLeftX = 0.0f;
     mViewport.TopLeftY = 0.0f;
@@ -30,31 +31,36 @@ ShadowMap::ShadowMap(ID3D11Device* device, UINT width, UINT height)
     texDesc.CPUAccessFlags = 0; 
     texDesc.MiscFlags      = 0;
 
-    ID3D11Texture2D* depthMap = 0;
-    HR(device->CreateTexture2D(&texDesc, 0, &depthMap));
+    HR(device->CreateTexture2D(&texDesc, 0, &mDepthMap));
 
     D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc;
 	dsvDesc.Flags = 0;
     dsvDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
     dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
     dsvDesc.Texture2D.MipSlice = 0;
-    HR(device->CreateDepthStencilView(depthMap, &dsvDesc, &mDepthMapDSV));
+    HR(device->CreateDepthStencilView(mDepthMap, &dsvDesc, &mDepthMapDSV));
 
     D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
     srvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
     srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
     srvDesc.Texture2D.MipLevels = texDesc.MipLevels;
     srvDesc.Texture2D.MostDetailedMip = 0;
-    HR(device->CreateShaderResourceView(depthMap, &srvDesc, &mDepthMapSRV));
+    HR(device->CreateShaderResourceView(mDepthMap, &srvDesc, &mDepthMapSRV));
 
-    // View saves a reference to the texture so we can release our reference.
-    ReleaseCOM(depthMap);
+	// Depth of the static casters is kept in a second texture of the same format
+	// so it can be copied into the shadow map with CopyResource.
+	texDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+	HR(device->CreateTexture2D(&texDesc, 0, &mStaticDepthMap));
+	HR(device->CreateDepthStencilView(mStaticDepthMap, &dsvDesc, &mStaticDepthMapDSV));
 }
 
 ShadowMap::~ShadowMap()
 {
     ReleaseCOM(mDepthMapSRV);
 	ReleaseCOM(mDepthMapDSV);
+	ReleaseCOM(mDepthMap);
+	ReleaseCOM(mStaticDepthMapDSV);
+	ReleaseCOM(mStaticDepthMap);
 }
 
 ID3D11ShaderResourceView* ShadowMap::DepthMapSRV()
@@ -74,3 +80,24 @@ void ShadowMap::BindDsvAndSetNullRenderTarget(ID3D11DeviceContext* dc)
     dc->ClearDepthStencilView(mDepthMapDSV, D3D11_CLEAR_DEPTH, 1.0f, 0);
 }
 
+void ShadowMap::BindStaticDsvAndSetNullRenderTarget(ID3D11DeviceContext* dc)
+{
+    dc->RSSetViewports(1, &mViewport);
+
+    ID3D11RenderTargetView* renderTargets[1] = {0};
+    dc->OMSetRenderTargets(1, renderTargets, mStaticDepthMapDSV);
+    
+    dc->ClearDepthStencilView(mStaticDepthMapDSV, D3D11_CLEAR_DEPTH, 1.0f, 0);
+}
+
+void ShadowMap::RestoreStaticDepthAndSetNullRenderTarget(ID3D11DeviceContext* dc)
+{
+	// Unbind first; a resource bound as output cannot be a copy destination.
+	ID3D11RenderTargetView* renderTargets[1] = {0};
+	dc->OMSetRenderTargets(1, renderTargets, 0);
+
+	dc->CopyResource(mDepthMap, mStaticDepthMap);
+
+    dc->RSSetViewports(1, &mViewport);
+    dc->OMSetRenderTargets(1, renderTargets, mDepthMapDSV);
+}
@@ -20,6 +20,13 @@ public:
 
 	void BindDsvAndSetNullRenderTarget(ID3D11DeviceContext* dc);
 
+	// Clears and binds the depth map that caches the static casters.
+	void BindStaticDsvAndSetNullRenderTarget(ID3D11DeviceContext* dc);
+
+	// Copies the cached static depth into the shadow map and binds the shadow map
+	// without clearing it, so the dynamic casters can be drawn on top.
+	void RestoreStaticDepthAndSetNullRenderTarget(ID3D11DeviceContext* dc);
+
 private:
 	ShadowMap(const ShadowMap& rhs);
 	ShadowMap& operator=(const ShadowMap& rhs);
@@ -28,9 +35,13 @@ private:
 	UINT mWidth;
 	UINT mHeight;
 
+	ID3D11Texture2D* mDepthMap;
 	ID3D11ShaderResourceView* mDepthMapSRV;
 	ID3D11DepthStencilView* mDepthMapDSV;
 
+	ID3D11Texture2D* mStaticDepthMap;
+	ID3D11DepthStencilView* mStaticDepthMapDSV;
+
 	D3D11_VIEWPORT mViewport;
 };
 
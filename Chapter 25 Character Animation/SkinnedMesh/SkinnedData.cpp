@@ -1,7 +1,7 @@
 
 
 #include "SkinnedData.h"
-#include "MeshGeometry.h"
+#include "Profiler.h"
 
 Keyframe::Keyframe()
 	: TimePos(0.0f),
@@ -139,6 +139,8 @@ void SkinnedData::Set(std::vector<int>& boneHierarchy,
  
 void SkinnedData::GetFinalTransforms(const std::string& clipName, float timePos,  std::vector<XMFLOAT4X4>& finalTransforms)const
 {
+	PROFILE_FUNCTION();
+
 	UINT numBones = mBoneOffsets.size();
 
 	std::vector<XMFLOAT4X4> toParentTransforms(numBones);
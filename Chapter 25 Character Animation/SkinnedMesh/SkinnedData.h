@@ -1,8 +1,10 @@
 #ifndef SKINNEDDATA_H
 #define SKINNEDDATA_H
 
-#include "d3dUtil.h"
+#include "MathHelper.h"
 #include <map>
+#include <string>
+#include <vector>
 
 ///<summary>
 /// A Keyframe defines the bone transformation at an instant in time.
@@ -21,6 +21,7 @@
 #include "Sky.h"
 #include "RenderStates.h"
 #include "ShadowMap.h"
+#include "ShadowCasterCache.h"
 #include "Ssao.h"
 #include "TextureMgr.h"
 #include "BasicModel.h"
@@ -50,7 +51,7 @@ public:
 
 private:
 	void DrawSceneToSsaoNormalDepthMap();
-	void DrawSceneToShadowMap();
+	void DrawSceneToShadowMap(bool staticCasters);
 	void DrawScreenQuad(ID3D11ShaderResourceView* srv);
 	void BuildShadowTransform();
 	void BuildShapeGeometryBuffers();
@@ -93,6 +94,16 @@ private:
 	XMFLOAT4X4 mLightProj;
 	XMFLOAT4X4 mShadowTransform;
 
+	// The light does not move, so the depth of the static casters is rendered once
+	// and reused; only the animated characters are drawn every frame.
+	ShadowCasterCache mCasterCache;
+	UINT mGridCaster;
+	UINT mBoxCaster;
+	UINT mCylCaster[10];
+	UINT mSphereCaster[10];
+	UINT mSkullCaster;
+	UINT mCharacterCaster[2];
+
 	Ssao* mSsao;
 
 	float mLightRotationAngle;
@@ -192,6 +203,26 @@ SkinnedMeshApp::SkinnedMeshApp(HINSTANCE hInstance)
 		XMStoreFloat4x4(&mSphereWorld[i*2+1], XMMatrixTranslation(+5.0f, 3.5f, -10.0f + i*5.0f));
 	}
 
+	XNA::AxisAlignedBox bounds;
+	bounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	bounds.Extents = XMFLOAT3(10.0f, 0.0f, 15.0f);
+	mGridCaster = mCasterCache.AddCaster(bounds, true);
+
+	bounds.Center = XMFLOAT3(0.0f, 0.5f, 0.0f);
+	bounds.Extents = XMFLOAT3(1.5f, 0.5f, 1.5f);
+	mBoxCaster = mCasterCache.AddCaster(bounds, true);
+
+	for(int i = 0; i < 10; ++i)
+	{
+		bounds.Center = XMFLOAT3(mCylWorld[i]._41, mCylWorld[i]._42, mCylWorld[i]._43);
+		bounds.Extents = XMFLOAT3(0.5f, 1.5f, 0.5f);
+		mCylCaster[i] = mCasterCache.AddCaster(bounds, true);
+
+		bounds.Center = XMFLOAT3(mSphereWorld[i]._41, mSphereWorld[i]._42, mSphereWorld[i]._43);
+		bounds.Extents = XMFLOAT3(0.5f, 0.5f, 0.5f);
+		mSphereCaster[i] = mCasterCache.AddCaster(bounds, true);
+	}
+
 	mDirLights[0].Ambient  = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
 	mDirLights[0].Diffuse  = XMFLOAT4(1.0f, 0.9f, 0.9f, 1.0f);
 	mDirLights[0].Specular = XMFLOAT4(0.8f, 0.8f, 0.7f, 1.0f);
@@ -309,6 +340,27 @@ bool SkinnedMeshApp::Init()
 
 	modelOffset = XMMatrixTranslation(2.0f, 0.0f, -7.0f);
 	XMStoreFloat4x4(&mCharacterInstance2.World, modelScale*modelRot*modelOffset);
+
+	// The characters animate in place.  Bound them by their bind pose, padded so
+	// the limbs stay inside while the clip plays.
+	SkinnedModelInstance* instances[2] = { &mCharacterInstance1, &mCharacterInstance2 };
+	for(int i = 0; i < 2; ++i)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&instances[i]->World);
+		XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+		XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+		for(size_t v = 0; v < mCharacterModel->Vertices.size(); ++v)
+		{
+			XMVECTOR P = XMVector3TransformCoord(XMLoadFloat3(&mCharacterModel->Vertices[v].Pos), world);
+			vMin = XMVectorMin(vMin, P);
+			vMax = XMVectorMax(vMax, P);
+		}
+
+		XNA::AxisAlignedBox bounds;
+		XMStoreFloat3(&bounds.Center, 0.5f*(vMin + vMax));
+		XMStoreFloat3(&bounds.Extents, 0.75f*(vMax - vMin));
+		mCharacterCaster[i] = mCasterCache.AddCaster(bounds, false);
+	}
 	
 	return true;
 }
@@ -355,6 +407,15 @@ void SkinnedMeshApp::UpdateScene(float dt)
 
 	BuildShadowTransform();
 
+	mCasterCache.Update(XMLoadFloat4x4(&mLightView), XMLoadFloat4x4(&mLightProj));
+
+	std::wostringstream outs;
+	outs << L"Skinned Mesh Demo"
+		<< L"    Casters culled: " << mCasterCache.CulledCasterCount()
+		<< L"    Shadow redraws skipped: " << mCasterCache.SkippedRedrawCount()
+		<< L"    Shadow rebuilds: " << mCasterCache.StaticRebuildCount();
+	mMainWndCaption = outs.str();
+
 	mCam.UpdateViewMatrix();
 }
 
@@ -364,9 +425,16 @@ void SkinnedMeshApp::DrawScene()
 	// Render the scene to the shadow map.
 	//
 
-	mSmap->BindDsvAndSetNullRenderTarget(md3dImmediateContext);
+	if( mCasterCache.StaticDepthDirty() )
+	{
+		mSmap->BindStaticDsvAndSetNullRenderTarget(md3dImmediateContext);
 
-	DrawSceneToShadowMap();
+		DrawSceneToShadowMap(true);
+	}
+
+	mSmap->RestoreStaticDepthAndSetNullRenderTarget(md3dImmediateContext);
+
+	DrawSceneToShadowMap(false);
 
 	md3dImmediateContext->RSSetState(0);
 
@@ -881,7 +949,7 @@ void SkinnedMeshApp::DrawSceneToSsaoNormalDepthMap()
 	md3dImmediateContext->RSSetState(0);
 }
 
-void SkinnedMeshApp::DrawSceneToShadowMap()
+void SkinnedMeshApp::DrawSceneToShadowMap(bool staticCasters)
 {
 	XMMATRIX view     = XMLoadFloat4x4(&mLightView);
 	XMMATRIX proj     = XMLoadFloat4x4(&mLightProj);
@@ -906,70 +974,111 @@ void SkinnedMeshApp::DrawSceneToShadowMap()
 	XMMATRIX worldInvTranspose;
 	XMMATRIX worldViewProj;
 
-	//
-	// Draw the grid, cylinders, spheres, and box.
-	// 
-
-	UINT stride = sizeof(Vertex::PosNormalTexTan);
-    UINT offset = 0;
-
-	md3dImmediateContext->IASetInputLayout(InputLayouts::PosNormalTexTan);
-	md3dImmediateContext->IASetVertexBuffers(0, 1, &mShapesVB, &stride, &offset);
-	md3dImmediateContext->IASetIndexBuffer(mShapesIB, DXGI_FORMAT_R32_UINT, 0);
-     
 	if( GetAsyncKeyState('1') & 0x8000 )
 		md3dImmediateContext->RSSetState(RenderStates::WireframeRS);
-	
-    D3DX11_TECHNIQUE_DESC techDesc;
-    smapTech->GetDesc( &techDesc );
-    for(UINT p = 0; p < techDesc.Passes; ++p)
-    {
-		// Draw the grid.
-		world = XMLoadFloat4x4(&mGridWorld);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
-
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(8.0f, 10.0f, 1.0f));
 
-		smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mGridIndexCount, mGridIndexOffset, mGridVertexOffset);
-
-		// Draw the box.
-		world = XMLoadFloat4x4(&mBoxWorld);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
+	D3DX11_TECHNIQUE_DESC techDesc;
 
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(2.0f, 1.0f, 1.0f));
+	if( staticCasters )
+	{
+		//
+		// Draw the grid, cylinders, spheres, and box.
+		// 
 
-		smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mBoxIndexCount, mBoxIndexOffset, mBoxVertexOffset);
+		UINT stride = sizeof(Vertex::PosNormalTexTan);
+	    UINT offset = 0;
 
-		// Draw the cylinders.
-		for(int i = 0; i < 10; ++i)
-		{
-			world = XMLoadFloat4x4(&mCylWorld[i]);
-			worldInvTranspose = MathHelper::InverseTranspose(world);
-			worldViewProj = world*view*proj;
-
-			Effects::BuildShadowMapFX->SetWorld(world);
-			Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-			Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-			Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(1.0f, 2.0f, 1.0f));
+		md3dImmediateContext->IASetInputLayout(InputLayouts::PosNormalTexTan);
+		md3dImmediateContext->IASetVertexBuffers(0, 1, &mShapesVB, &stride, &offset);
+		md3dImmediateContext->IASetIndexBuffer(mShapesIB, DXGI_FORMAT_R32_UINT, 0);
+		
+	    smapTech->GetDesc( &techDesc );
+	    for(UINT p = 0; p < techDesc.Passes; ++p)
+	    {
+			// Draw the grid.
+			if( mCasterCache.IsCasterVisible(mGridCaster) )
+			{
+				world = XMLoadFloat4x4(&mGridWorld);
+				worldInvTranspose = MathHelper::InverseTranspose(world);
+				worldViewProj = world*view*proj;
+
+				Effects::BuildShadowMapFX->SetWorld(world);
+				Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+				Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+				Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(8.0f, 10.0f, 1.0f));
+
+				smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+				md3dImmediateContext->DrawIndexed(mGridIndexCount, mGridIndexOffset, mGridVertexOffset);
+			}
+
+			// Draw the box.
+			if( mCasterCache.IsCasterVisible(mBoxCaster) )
+			{
+				world = XMLoadFloat4x4(&mBoxWorld);
+				worldInvTranspose = MathHelper::InverseTranspose(world);
+				worldViewProj = world*view*proj;
+
+				Effects::BuildShadowMapFX->SetWorld(world);
+				Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+				Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+				Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(2.0f, 1.0f, 1.0f));
+
+				smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+				md3dImmediateContext->DrawIndexed(mBoxIndexCount, mBoxIndexOffset, mBoxVertexOffset);
+			}
+
+			// Draw the cylinders.
+			for(int i = 0; i < 10; ++i)
+			{
+				if( !mCasterCache.IsCasterVisible(mCylCaster[i]) )
+					continue;
+
+				world = XMLoadFloat4x4(&mCylWorld[i]);
+				worldInvTranspose = MathHelper::InverseTranspose(world);
+				worldViewProj = world*view*proj;
+
+				Effects::BuildShadowMapFX->SetWorld(world);
+				Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+				Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+				Effects::BuildShadowMapFX->SetTexTransform(XMMatrixScaling(1.0f, 2.0f, 1.0f));
+
+				smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+				md3dImmediateContext->DrawIndexed(mCylinderIndexCount, mCylinderIndexOffset, mCylinderVertexOffset);
+			}
+
+			// Draw the spheres.
+			for(int i = 0; i < 10; ++i)
+			{
+				if( !mCasterCache.IsCasterVisible(mSphereCaster[i]) )
+					continue;
+
+				world = XMLoadFloat4x4(&mSphereWorld[i]);
+				worldInvTranspose = MathHelper::InverseTranspose(world);
+				worldViewProj = world*view*proj;
+
+				Effects::BuildShadowMapFX->SetWorld(world);
+				Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+				Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+				Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
+
+				smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+				md3dImmediateContext->DrawIndexed(mSphereIndexCount, mSphereIndexOffset, mSphereVertexOffset);
+			}
+	    }
+
+		//
+		// Draw the skull.
+		//
+		stride = sizeof(Vertex::Basic32);
+	    offset = 0;
 
-			smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-			md3dImmediateContext->DrawIndexed(mCylinderIndexCount, mCylinderIndexOffset, mCylinderVertexOffset);
-		}
+		md3dImmediateContext->IASetInputLayout(InputLayouts::Basic32);
+		md3dImmediateContext->IASetVertexBuffers(0, 1, &mSkullVB, &stride, &offset);
+		md3dImmediateContext->IASetIndexBuffer(mSkullIB, DXGI_FORMAT_R32_UINT, 0);
 
-		// Draw the spheres.
-		for(int i = 0; i < 10; ++i)
-		{
-			world = XMLoadFloat4x4(&mSphereWorld[i]);
+		for(UINT p = 0; p < techDesc.Passes && mCasterCache.IsCasterVisible(mSkullCaster); ++p)
+	    {
+			world = XMLoadFloat4x4(&mSkullWorld);
 			worldInvTranspose = MathHelper::InverseTranspose(world);
 			worldViewProj = world*view*proj;
 
@@ -979,85 +1088,66 @@ void SkinnedMeshApp::DrawSceneToShadowMap()
 			Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
 
 			smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-			md3dImmediateContext->DrawIndexed(mSphereIndexCount, mSphereIndexOffset, mSphereVertexOffset);
+			md3dImmediateContext->DrawIndexed(mSkullIndexCount, 0, 0);
 		}
-    }
-
-	//
-	// Draw the skull.
-	//
-	stride = sizeof(Vertex::Basic32);
-    offset = 0;
-
-	md3dImmediateContext->IASetInputLayout(InputLayouts::Basic32);
-	md3dImmediateContext->IASetVertexBuffers(0, 1, &mSkullVB, &stride, &offset);
-	md3dImmediateContext->IASetIndexBuffer(mSkullIB, DXGI_FORMAT_R32_UINT, 0);
-
-	for(UINT p = 0; p < techDesc.Passes; ++p)
-    {
-		world = XMLoadFloat4x4(&mSkullWorld);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
-
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
-
-		smapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mSkullIndexCount, 0, 0);
 	}
-
-	//
-	// Draw the animated characters.
-	//
-
-	md3dImmediateContext->IASetInputLayout(InputLayouts::PosNormalTexTanSkinned);
-
-	animatedSmapTech->GetDesc( &techDesc );
-	for(UINT p = 0; p < techDesc.Passes; ++p)
-    {
-		// Instance 1
-
-		world = XMLoadFloat4x4(&mCharacterInstance1.World);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
-
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
-		Effects::BuildShadowMapFX->SetBoneTransforms(
-			&mCharacterInstance1.FinalTransforms[0], 
-			mCharacterInstance1.FinalTransforms.size());
-
-
-		animatedSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-
-		for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
-		{
-			mCharacterInstance1.Model->ModelMesh.Draw(md3dImmediateContext, subset);
-		}
-
-		// Instance 2
-
-		world = XMLoadFloat4x4(&mCharacterInstance2.World);
-		worldInvTranspose = MathHelper::InverseTranspose(world);
-		worldViewProj = world*view*proj;
-
-		Effects::BuildShadowMapFX->SetWorld(world);
-		Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
-		Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
-		Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
-		Effects::BuildShadowMapFX->SetBoneTransforms(
-			&mCharacterInstance2.FinalTransforms[0], 
-			mCharacterInstance2.FinalTransforms.size());
-
-		animatedSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-
-		for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
-		{
-			mCharacterInstance2.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+	else
+	{
+		//
+		// Draw the animated characters.
+		//
+
+		md3dImmediateContext->IASetInputLayout(InputLayouts::PosNormalTexTanSkinned);
+
+		animatedSmapTech->GetDesc( &techDesc );
+		for(UINT p = 0; p < techDesc.Passes; ++p)
+	    {
+			// Instance 1
+			if( mCasterCache.IsCasterVisible(mCharacterCaster[0]) )
+			{
+				world = XMLoadFloat4x4(&mCharacterInstance1.World);
+				worldInvTranspose = MathHelper::InverseTranspose(world);
+				worldViewProj = world*view*proj;
+
+				Effects::BuildShadowMapFX->SetWorld(world);
+				Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+				Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+				Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
+				Effects::BuildShadowMapFX->SetBoneTransforms(
+					&mCharacterInstance1.FinalTransforms[0], 
+					mCharacterInstance1.FinalTransforms.size());
+
+
+				animatedSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+
+				for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
+				{
+					mCharacterInstance1.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+				}
+			}
+
+			// Instance 2
+			if( mCasterCache.IsCasterVisible(mCharacterCaster[1]) )
+			{
+				world = XMLoadFloat4x4(&mCharacterInstance2.World);
+				worldInvTranspose = MathHelper::InverseTranspose(world);
+				worldViewProj = world*view*proj;
+
+				Effects::BuildShadowMapFX->SetWorld(world);
+				Effects::BuildShadowMapFX->SetWorldInvTranspose(worldInvTranspose);
+				Effects::BuildShadowMapFX->SetWorldViewProj(worldViewProj);
+				Effects::BuildShadowMapFX->SetTexTransform(XMMatrixIdentity());
+				Effects::BuildShadowMapFX->SetBoneTransforms(
+					&mCharacterInstance2.FinalTransforms[0], 
+					mCharacterInstance2.FinalTransforms.size());
+
+				animatedSmapTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
+
+				for(UINT subset = 0; subset < mCharacterInstance1.Model->SubsetCount; ++subset)
+				{
+					mCharacterInstance2.Model->ModelMesh.Draw(md3dImmediateContext, subset);
+				}
+			}
 		}
 	}
 
@@ -1287,6 +1377,21 @@ void SkinnedMeshApp::BuildSkullGeometryBuffers()
 		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
 	}
 
+	XMMATRIX skullWorld = XMLoadFloat4x4(&mSkullWorld);
+	XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+	for(UINT i = 0; i < vcount; ++i)
+	{
+		XMVECTOR P = XMVector3TransformCoord(XMLoadFloat3(&vertices[i].Pos), skullWorld);
+		vMin = XMVectorMin(vMin, P);
+		vMax = XMVectorMax(vMax, P);
+	}
+
+	XNA::AxisAlignedBox skullBounds;
+	XMStoreFloat3(&skullBounds.Center, 0.5f*(vMin + vMax));
+	XMStoreFloat3(&skullBounds.Extents, 0.5f*(vMax - vMin));
+	mSkullCaster = mCasterCache.AddCaster(skullBounds, true);
+
 	fin >> ignore;
 	fin >> ignore;
 	fin >> ignore;
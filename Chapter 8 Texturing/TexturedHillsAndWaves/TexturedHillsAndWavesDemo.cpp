@@ -11,6 +11,7 @@
 
 #include "d3dApp.h"
 #include "d3dx11Effect.h"
+#include "ChunkedLodGrid.h"
 #include "GeometryGenerator.h"
 #include "MathHelper.h"
 #include "LightHelper.h"
@@ -63,7 +64,10 @@ private:
 	XMFLOAT4X4 mView;
 	XMFLOAT4X4 mProj;
 
-	UINT mLandIndexCount;
+	// The hills in chunks, each drawn at a level of detail picked from its distance
+	// to the eye.
+	ChunkedLodGrid mLand;
+	std::vector<ChunkedLodGrid::DrawItem> mLandDraws;
 	XMFLOAT2 mWaterTexOffset;
 
 	XMFLOAT3 mEyePosW;
@@ -93,7 +97,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
 TexturedHillsAndWavesApp::TexturedHillsAndWavesApp(HINSTANCE hInstance)
 : D3DApp(hInstance), mLandVB(0), mLandIB(0), mWavesVB(0), mWavesIB(0), mGrassMapSRV(0), mWavesMapSRV(0), mWaterTexOffset(0.0f, 0.0f),
-  mEyePosW(0.0f, 0.0f, 0.0f), mLandIndexCount(0), mTheta(1.3f*MathHelper::Pi), mPhi(0.4f*MathHelper::Pi), mRadius(80.0f)
+  mEyePosW(0.0f, 0.0f, 0.0f), mTheta(1.3f*MathHelper::Pi), mPhi(0.4f*MathHelper::Pi), mRadius(80.0f)
 {
 	mMainWndCaption = L"TexturedHillsAndWaves Demo";
 	
@@ -194,6 +198,9 @@ void TexturedHillsAndWavesApp::UpdateScene(float dt)
 	XMMATRIX V = XMMatrixLookAtLH(pos, target, up);
 	XMStoreFloat4x4(&mView, V);
 
+	// The land world matrix is the identity, so the eye is already in grid space.
+	mLand.Select(mEyePosW, mLandDraws);
+
 	//
 	// Every quarter second, generate a random wave.
 	//
@@ -292,7 +299,8 @@ void TexturedHillsAndWavesApp::DrawScene()
 		Effects::BasicFX->SetDiffuseMap(mGrassMapSRV);
 
 		activeTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-		md3dImmediateContext->DrawIndexed(mLandIndexCount, 0, 0);
+		for(size_t i = 0; i < mLandDraws.size(); ++i)
+			md3dImmediateContext->DrawIndexed(mLandDraws[i].IndexCount, mLandDraws[i].IndexStart, 0);
 
 		//
 		// Draw the waves.
@@ -385,17 +393,21 @@ XMFLOAT3 TexturedHillsAndWavesApp::GetHillNormal(float x, float z)const
 
 void TexturedHillsAndWavesApp::BuildLandGeometryBuffers()
 {
-	GeometryGenerator::MeshData grid;
- 
-	GeometryGenerator geoGen;
+	//
+	// Sample the height function on a 129x129 grid, in 8x8 chunks of 16x16 quads
+	// with three coarser levels each.
+	//
 
-	geoGen.CreateGrid(160.0f, 160.0f, 50, 50, grid);
+	mLand.Build(160.0f, 160.0f, 129, 129, 16, 4, [this](float x, float z)
+	{
+		return GetHillHeight(x, z);
+	});
 
-	mLandIndexCount = grid.Indices.size();
+	const GeometryGenerator::MeshData& grid = mLand.GetMesh();
 
 	//
-	// Extract the vertex elements we are interested and apply the height function to
-	// each vertex.  
+	// Extract the vertex elements we are interested in.  The analytic normal is
+	// used over the one the grid estimates from its samples.
 	//
 
 	std::vector<Vertex::Basic32> vertices(grid.Vertices.size());
@@ -403,8 +415,6 @@ void TexturedHillsAndWavesApp::BuildLandGeometryBuffers()
 	{
 		XMFLOAT3 p = grid.Vertices[i].Position;
 
-		p.y = GetHillHeight(p.x, p.z);
-		
 		vertices[i].Pos    = p;
 		vertices[i].Normal = GetHillNormal(p.x, p.z);
 		vertices[i].Tex    = grid.Vertices[i].TexC;
@@ -426,7 +436,7 @@ void TexturedHillsAndWavesApp::BuildLandGeometryBuffers()
 
 	D3D11_BUFFER_DESC ibd;
     ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) * mLandIndexCount;
+	ibd.ByteWidth = sizeof(UINT) * grid.Indices.size();
     ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
     ibd.CPUAccessFlags = 0;
     ibd.MiscFlags = 0;
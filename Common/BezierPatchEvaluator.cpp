@@ -0,0 +1,469 @@
+//***************************************************************************************
+// BezierPatchEvaluator.cpp
+//***************************************************************************************
+
+#include "BezierPatchEvaluator.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Vertices evaluated by one task, give or take a patch.
+	const UINT ChunkVertexCount = 16384;
+
+	// Below this many vertices the evaluation stays on the calling thread.
+	const UINT ParallelVertexCount = 4*ChunkVertexCount;
+
+	// Patches evaluated by one task on the adaptive path.
+	const UINT AdaptiveChunkSize = 64;
+
+	// Column groups of four in a row of the largest grid.
+	const UINT MaxColumnGroups = (BezierPatchEvaluator::MaxTessFactor + 4)/4;
+
+	inline UINT ClampTessFactor(UINT tess)
+	{
+		if( tess == 0 )
+			return 1;
+		return tess < BezierPatchEvaluator::MaxTessFactor ? tess : BezierPatchEvaluator::MaxTessFactor;
+	}
+
+	inline float* At(float* p, UINT stride, UINT i)
+	{
+		return reinterpret_cast<float*>(reinterpret_cast<char*>(p) + (size_t)stride*i);
+	}
+
+	inline void WriteVertex(const BezierPatchEvaluator::Output& output, UINT i,
+		FXMVECTOR position, FXMVECTOR normal, float u, float v)
+	{
+		XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(At(output.Positions, output.Stride, i)), position);
+		if( output.Normals )
+			XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(At(output.Normals, output.Stride, i)), normal);
+		if( output.TexC )
+		{
+			float* t = At(output.TexC, output.Stride, i);
+			t[0] = u;
+			t[1] = v;
+		}
+	}
+
+	// The cubic weights of BernsteinBasis and their derivatives of dBernsteinBasis.
+	inline void BernsteinBasis(float t, float basis[4], float dBasis[4])
+	{
+		float invT = 1.0f - t;
+
+		basis[0] = invT*invT*invT;
+		basis[1] = 3.0f*t*invT*invT;
+		basis[2] = 3.0f*t*t*invT;
+		basis[3] = t*t*t;
+
+		dBasis[0] = -3.0f*invT*invT;
+		dBasis[1] = 3.0f*invT*invT - 6.0f*t*invT;
+		dBasis[2] = 6.0f*t*invT - 3.0f*t*t;
+		dBasis[3] = 3.0f*t*t;
+	}
+
+	// The same for four values of t, one per lane.
+	inline void BernsteinBasis(FXMVECTOR t, XMVECTOR basis[4], XMVECTOR dBasis[4])
+	{
+		const XMVECTOR three = XMVectorReplicate(3.0f);
+		const XMVECTOR six   = XMVectorReplicate(6.0f);
+
+		XMVECTOR invT   = XMVectorSubtract(XMVectorSplatOne(), t);
+		XMVECTOR invT2  = XMVectorMultiply(invT, invT);
+		XMVECTOR t2     = XMVectorMultiply(t, t);
+		XMVECTOR tInvT  = XMVectorMultiply(t, invT);
+
+		basis[0] = XMVectorMultiply(invT2, invT);
+		basis[1] = XMVectorMultiply(three, XMVectorMultiply(t, invT2));
+		basis[2] = XMVectorMultiply(three, XMVectorMultiply(t2, invT));
+		basis[3] = XMVectorMultiply(t2, t);
+
+		dBasis[0] = XMVectorNegate(XMVectorMultiply(three, invT2));
+		dBasis[1] = XMVectorSubtract(XMVectorMultiply(three, invT2), XMVectorMultiply(six, tInvT));
+		dBasis[2] = XMVectorSubtract(XMVectorMultiply(six, tInvT), XMVectorMultiply(three, t2));
+		dBasis[3] = XMVectorMultiply(three, t2);
+	}
+
+	// The power basis a t^3 + b t^2 + c t + p[0] of the cubic Bezier curve p.
+	inline void PowerBasis(const XMVECTOR p[4], XMVECTOR& a, XMVECTOR& b, XMVECTOR& c)
+	{
+		const XMVECTOR three = XMVectorReplicate(3.0f);
+
+		a = XMVectorAdd(XMVectorSubtract(p[3], p[0]), XMVectorMultiply(three, XMVectorSubtract(p[1], p[2])));
+		b = XMVectorMultiply(three, XMVectorAdd(XMVectorSubtract(p[0], XMVectorAdd(p[1], p[1])), p[2]));
+		c = XMVectorMultiply(three, XMVectorSubtract(p[1], p[0]));
+	}
+
+	//
+	// A cubic Bezier curve and its derivative stepped along t in steps of h by forward
+	// differencing: the value and its differences, each added into the one before.
+	//
+
+	struct CubicSteps
+	{
+		XMVECTOR F, D1, D2, D3;
+
+		void Init(const XMVECTOR p[4], float h)
+		{
+			XMVECTOR a, b, c;
+			PowerBasis(p, a, b, c);
+
+			XMVECTOR ah3 = XMVectorScale(a, h*h*h);
+			XMVECTOR bh2 = XMVectorScale(b, h*h);
+
+			F  = p[0];
+			D1 = XMVectorAdd(XMVectorAdd(ah3, bh2), XMVectorScale(c, h));
+			D2 = XMVectorAdd(XMVectorScale(ah3, 6.0f), XMVectorScale(bh2, 2.0f));
+			D3 = XMVectorScale(ah3, 6.0f);
+		}
+
+		void Step()
+		{
+			F  = XMVectorAdd(F, D1);
+			D1 = XMVectorAdd(D1, D2);
+			D2 = XMVectorAdd(D2, D3);
+		}
+	};
+
+	struct DerivativeSteps
+	{
+		XMVECTOR F, D1, D2;
+
+		// 3a t^2 + 2b t + c.
+		void Init(const XMVECTOR p[4], float h)
+		{
+			XMVECTOR a, b, c;
+			PowerBasis(p, a, b, c);
+
+			XMVECTOR ah2 = XMVectorScale(a, 3.0f*h*h);
+
+			F  = c;
+			D1 = XMVectorAdd(ah2, XMVectorScale(b, 2.0f*h));
+			D2 = XMVectorScale(ah2, 2.0f);
+		}
+
+		void Step()
+		{
+			F  = XMVectorAdd(F, D1);
+			D1 = XMVectorAdd(D1, D2);
+		}
+	};
+
+	// One patch by forward differencing.  The four columns are stepped down the rows;
+	// at each row their points are the control points of the row curve, and their
+	// derivatives those of the row's v partial, which are then stepped along the row.
+	void EvaluateForwardDifferences(const XMFLOAT3* controlPoints, UINT tess,
+		const BezierPatchEvaluator::Output& output, UINT firstVertex)
+	{
+		const float h = 1.0f/tess;
+
+		CubicSteps columns[4];
+		DerivativeSteps columnPartials[4];
+		for(int i = 0; i < 4; ++i)
+		{
+			XMVECTOR p[4];
+			for(int j = 0; j < 4; ++j)
+				p[j] = XMLoadFloat3(&controlPoints[4*j + i]);
+
+			columns[i].Init(p, h);
+			columnPartials[i].Init(p, h);
+		}
+
+		UINT vertex = firstVertex;
+		for(UINT r = 0; r <= tess; ++r)
+		{
+			XMVECTOR rowPoints[4];
+			XMVECTOR rowPartials[4];
+			for(int i = 0; i < 4; ++i)
+			{
+				rowPoints[i]   = columns[i].F;
+				rowPartials[i] = columnPartials[i].F;
+			}
+
+			CubicSteps position;
+			DerivativeSteps dPdu;
+			CubicSteps dPdv;
+			position.Init(rowPoints, h);
+			dPdu.Init(rowPoints, h);
+			dPdv.Init(rowPartials, h);
+
+			const float v = r*h;
+			for(UINT c = 0; c <= tess; ++c)
+			{
+				XMVECTOR normal = XMVector3Normalize(XMVector3Cross(dPdu.F, dPdv.F));
+				WriteVertex(output, vertex++, position.F, normal, c*h, v);
+
+				position.Step();
+				dPdu.Step();
+				dPdv.Step();
+			}
+
+			for(int i = 0; i < 4; ++i)
+			{
+				columns[i].Step();
+				columnPartials[i].Step();
+			}
+		}
+	}
+
+	// One patch straight from the Bernstein basis, four vertices of a row at a time.
+	// The row's v weights first fold the control points into the four points of the
+	// row curve; the u weights of each group of four columns then finish the sum with
+	// one lane per vertex.
+	void EvaluateBernstein(const XMFLOAT3* controlPoints, UINT tess,
+		const BezierPatchEvaluator::Output& output, UINT firstVertex)
+	{
+		const float h = 1.0f/tess;
+		const UINT columnCount = tess + 1;
+		const UINT groups = (columnCount + 3)/4;
+
+		XMVECTOR p[16];
+		for(int i = 0; i < 16; ++i)
+			p[i] = XMLoadFloat3(&controlPoints[i]);
+
+		// The u weights are the same on every row.  Lanes past the last column repeat it.
+		XMVECTOR basisU[MaxColumnGroups][4];
+		XMVECTOR dBasisU[MaxColumnGroups][4];
+		XMVECTOR texU[MaxColumnGroups];
+		for(UINT g = 0; g < groups; ++g)
+		{
+			float u[4];
+			for(UINT k = 0; k < 4; ++k)
+				u[k] = std::min(4*g + k, tess)*h;
+
+			texU[g] = XMVectorSet(u[0], u[1], u[2], u[3]);
+			BernsteinBasis(texU[g], basisU[g], dBasisU[g]);
+		}
+
+		for(UINT r = 0; r <= tess; ++r)
+		{
+			const float v = r*h;
+			float basisV[4];
+			float dBasisV[4];
+			BernsteinBasis(v, basisV, dBasisV);
+
+			// The row curve and its v partial, each component replicated across the lanes.
+			XMVECTOR rowPoint[4][3];
+			XMVECTOR rowPartial[4][3];
+			for(int i = 0; i < 4; ++i)
+			{
+				XMVECTOR point   = XMVectorZero();
+				XMVECTOR partial = XMVectorZero();
+				for(int j = 0; j < 4; ++j)
+				{
+					point   = XMVectorMultiplyAdd(XMVectorReplicate(basisV[j]), p[4*j + i], point);
+					partial = XMVectorMultiplyAdd(XMVectorReplicate(dBasisV[j]), p[4*j + i], partial);
+				}
+
+				rowPoint[i][0] = XMVectorSplatX(point);
+				rowPoint[i][1] = XMVectorSplatY(point);
+				rowPoint[i][2] = XMVectorSplatZ(point);
+				rowPartial[i][0] = XMVectorSplatX(partial);
+				rowPartial[i][1] = XMVectorSplatY(partial);
+				rowPartial[i][2] = XMVectorSplatZ(partial);
+			}
+
+			for(UINT g = 0; g < groups; ++g)
+			{
+				XMVECTOR position[3];
+				XMVECTOR dPdu[3];
+				XMVECTOR dPdv[3];
+				for(int k = 0; k < 3; ++k)
+				{
+					position[k] = XMVectorZero();
+					dPdu[k] = XMVectorZero();
+					dPdv[k] = XMVectorZero();
+					for(int i = 0; i < 4; ++i)
+					{
+						position[k] = XMVectorMultiplyAdd(basisU[g][i], rowPoint[i][k], position[k]);
+						dPdu[k] = XMVectorMultiplyAdd(dBasisU[g][i], rowPoint[i][k], dPdu[k]);
+						dPdv[k] = XMVectorMultiplyAdd(basisU[g][i], rowPartial[i][k], dPdv[k]);
+					}
+				}
+
+				XMVECTOR normal[3] =
+				{
+					XMVectorSubtract(XMVectorMultiply(dPdu[1], dPdv[2]), XMVectorMultiply(dPdu[2], dPdv[1])),
+					XMVectorSubtract(XMVectorMultiply(dPdu[2], dPdv[0]), XMVectorMultiply(dPdu[0], dPdv[2])),
+					XMVectorSubtract(XMVectorMultiply(dPdu[0], dPdv[1]), XMVectorMultiply(dPdu[1], dPdv[0]))
+				};
+				XMVECTOR length = XMVectorSqrt(XMVectorAdd(XMVectorAdd(XMVectorMultiply(normal[0], normal[0]),
+					XMVectorMultiply(normal[1], normal[1])), XMVectorMultiply(normal[2], normal[2])));
+				for(int k = 0; k < 3; ++k)
+					normal[k] = XMVectorDivide(normal[k], length);
+
+				XMFLOAT4 px, py, pz, nx, ny, nz, tu;
+				XMStoreFloat4(&px, position[0]);
+				XMStoreFloat4(&py, position[1]);
+				XMStoreFloat4(&pz, position[2]);
+				XMStoreFloat4(&nx, normal[0]);
+				XMStoreFloat4(&ny, normal[1]);
+				XMStoreFloat4(&nz, normal[2]);
+				XMStoreFloat4(&tu, texU[g]);
+
+				const UINT lanes = std::min(4u, columnCount - 4*g);
+				for(UINT k = 0; k < lanes; ++k)
+				{
+					XMVECTOR lanePosition = XMVectorSet((&px.x)[k], (&py.x)[k], (&pz.x)[k], 0.0f);
+					XMVECTOR laneNormal   = XMVectorSet((&nx.x)[k], (&ny.x)[k], (&nz.x)[k], 0.0f);
+					WriteVertex(output, firstVertex + r*columnCount + 4*g + k, lanePosition, laneNormal, (&tu.x)[k], v);
+				}
+			}
+		}
+	}
+}
+
+BezierPatchEvaluator::BezierPatchEvaluator()
+: mThreadCount(0)
+{
+}
+
+BezierPatchEvaluator::~BezierPatchEvaluator()
+{
+}
+
+void BezierPatchEvaluator::SetThreadCount(UINT threadCount)
+{
+	mThreadCount = threadCount;
+}
+
+UINT BezierPatchEvaluator::GetVertexCount(UINT tess)
+{
+	tess = ClampTessFactor(tess);
+	return (tess + 1)*(tess + 1);
+}
+
+UINT BezierPatchEvaluator::GetIndexCount(UINT tess)
+{
+	tess = ClampTessFactor(tess);
+	return 6*tess*tess;
+}
+
+void BezierPatchEvaluator::EvaluateUniform(const XMFLOAT3* controlPoints, UINT patchCount, UINT tess, const Output& output)
+{
+	tess = ClampTessFactor(tess);
+	const UINT patchVertices = GetVertexCount(tess);
+	const UINT chunkSize = std::max(ChunkVertexCount/patchVertices, 1u);
+	const UINT chunks = (patchCount + chunkSize - 1)/chunkSize;
+
+	Parallel::For(chunks, GetThreadCount(patchCount*patchVertices), [&](UINT chunk)
+	{
+		UINT first = chunk*chunkSize;
+		UINT end   = std::min(first + chunkSize, patchCount);
+		for(UINT p = first; p < end; ++p)
+			EvaluateForwardDifferences(&controlPoints[16*p], tess, output, p*patchVertices);
+	});
+}
+
+void BezierPatchEvaluator::EvaluateAdaptive(const XMFLOAT3* controlPoints, UINT patchCount, const UINT* tess,
+	const UINT* firstVertex, const Output& output)
+{
+	if( patchCount == 0 )
+		return;
+
+	const UINT vertexCount = firstVertex[patchCount - 1] + GetVertexCount(tess[patchCount - 1]);
+	const UINT chunks = (patchCount + AdaptiveChunkSize - 1)/AdaptiveChunkSize;
+
+	Parallel::For(chunks, GetThreadCount(vertexCount), [&](UINT chunk)
+	{
+		UINT first = chunk*AdaptiveChunkSize;
+		UINT end   = std::min(first + AdaptiveChunkSize, patchCount);
+		for(UINT p = first; p < end; ++p)
+			EvaluateBernstein(&controlPoints[16*p], ClampTessFactor(tess[p]), output, firstVertex[p]);
+	});
+}
+
+UINT BezierPatchEvaluator::ComputeVertexOffsets(const UINT* tess, UINT patchCount, UINT* firstVertex)
+{
+	UINT vertexCount = 0;
+	for(UINT p = 0; p < patchCount; ++p)
+	{
+		firstVertex[p] = vertexCount;
+		vertexCount += GetVertexCount(tess[p]);
+	}
+
+	return vertexCount;
+}
+
+void BezierPatchEvaluator::ComputeDistanceFactors(const XMFLOAT3* controlPoints, UINT patchCount,
+	const XMFLOAT3& eyePos, float d0, float d1, UINT* tess)
+{
+	XMVECTOR eye = XMLoadFloat3(&eyePos);
+	for(UINT p = 0; p < patchCount; ++p)
+	{
+		const XMFLOAT3* cp = &controlPoints[16*p];
+		XMVECTOR center = XMVectorScale(XMVectorAdd(XMVectorAdd(XMLoadFloat3(&cp[0]), XMLoadFloat3(&cp[3])),
+			XMVectorAdd(XMLoadFloat3(&cp[12]), XMLoadFloat3(&cp[15]))), 0.25f);
+
+		float d = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, eye)));
+		float t = std::min(std::max((d1 - d)/(d1 - d0), 0.0f), 1.0f);
+
+		tess[p] = ClampTessFactor((UINT)ceilf(MaxTessFactor*t));
+	}
+}
+
+void BezierPatchEvaluator::BuildIndices(UINT tess, UINT baseVertex, UINT* indices)
+{
+	tess = ClampTessFactor(tess);
+	const UINT n = tess + 1;
+
+	UINT k = 0;
+	for(UINT r = 0; r < tess; ++r)
+	{
+		for(UINT c = 0; c < tess; ++c)
+		{
+			UINT i = baseVertex + r*n + c;
+
+			indices[k++] = i;
+			indices[k++] = i + 1;
+			indices[k++] = i + n;
+
+			indices[k++] = i + n;
+			indices[k++] = i + 1;
+			indices[k++] = i + n + 1;
+		}
+	}
+}
+
+void BezierPatchEvaluator::EvaluatePoint(const XMFLOAT3 controlPoints[16], float u, float v,
+	XMFLOAT3* position, XMFLOAT3* normal)
+{
+	float basisU[4], dBasisU[4];
+	float basisV[4], dBasisV[4];
+	BernsteinBasis(u, basisU, dBasisU);
+	BernsteinBasis(v, basisV, dBasisV);
+
+	float p[3]    = { 0.0f, 0.0f, 0.0f };
+	float dPdu[3] = { 0.0f, 0.0f, 0.0f };
+	float dPdv[3] = { 0.0f, 0.0f, 0.0f };
+	for(int j = 0; j < 4; ++j)
+	{
+		for(int i = 0; i < 4; ++i)
+		{
+			const float* cp = &controlPoints[4*j + i].x;
+			for(int k = 0; k < 3; ++k)
+			{
+				p[k]    += basisV[j]*basisU[i]*cp[k];
+				dPdu[k] += basisV[j]*dBasisU[i]*cp[k];
+				dPdv[k] += dBasisV[j]*basisU[i]*cp[k];
+			}
+		}
+	}
+
+	float n[3] =
+	{
+		dPdu[1]*dPdv[2] - dPdu[2]*dPdv[1],
+		dPdu[2]*dPdv[0] - dPdu[0]*dPdv[2],
+		dPdu[0]*dPdv[1] - dPdu[1]*dPdv[0]
+	};
+	float length = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+
+	*position = XMFLOAT3(p[0], p[1], p[2]);
+	*normal   = XMFLOAT3(n[0]/length, n[1]/length, n[2]/length);
+}
+
+UINT BezierPatchEvaluator::GetThreadCount(UINT vertexCount)const
+{
+	return vertexCount >= ParallelVertexCount ? mThreadCount : 1;
+}
@@ -0,0 +1,106 @@
+//***************************************************************************************
+// BezierPatchEvaluator.h
+//
+// CPU evaluation of the bicubic Bezier patches of the BezierPatch demo, so collision
+// and LOD code can get at the surface the domain shader draws.  A patch is 16 control
+// points in rows of four, as the demo's vertex buffer holds them; u runs along a row
+// and v down the rows, as SV_DomainLocation does in BezierTessellation.fx.  A patch
+// tessellated into tess x tess quads gives a (tess+1) x (tess+1) grid of vertices, row
+// by row, each with its position, unit normal and (u, v) as texture coordinates.
+//
+// Patches that all share one factor are evaluated with forward differencing: a row
+// costs a few vector adds per vertex after a per-row setup.  Patches with a factor each
+// are evaluated straight from the Bernstein basis, four vertices of a row at a time,
+// one per XMVECTOR lane.  Patches are spread over threads in chunks; every patch goes
+// to its own place in the output, so the result does not depend on the thread count.
+// EvaluatePoint is a scalar port of the domain shader, kept to check both paths
+// against.  Nothing here needs Direct3D.
+//***************************************************************************************
+
+#ifndef BEZIERPATCHEVALUATOR_H
+#define BEZIERPATCHEVALUATOR_H
+
+#include "XnaMathPortable.h"
+
+class BezierPatchEvaluator
+{
+public:
+	// The largest factor, the hull shader's maxtessfactor.  Larger factors are clamped
+	// to it and 0 is taken as 1.
+	static const UINT MaxTessFactor = 64;
+
+	// Where the vertices go: the position, normal and texture coordinates of vertex i
+	// are written Stride*i bytes past Positions, Normals and TexC, so interleaved
+	// vertices such as Vertex::Basic32 can be filled in place.  Normals and TexC may be
+	// null.
+	struct Output
+	{
+		float* Positions;
+		float* Normals;
+		float* TexC;
+		UINT Stride;
+	};
+
+	BezierPatchEvaluator();
+	~BezierPatchEvaluator();
+
+	///<summary>
+	/// threadCount 0 uses every hardware thread for large batches; 1 keeps the
+	/// evaluation on the calling thread.
+	///</summary>
+	void SetThreadCount(UINT threadCount);
+
+	// Vertices and triangle list indices of one patch at the given factor.
+	static UINT GetVertexCount(UINT tess);
+	static UINT GetIndexCount(UINT tess);
+
+	///<summary>
+	/// Evaluates patchCount patches of 16 control points each at the same factor.
+	/// Patch p fills vertices p*GetVertexCount(tess) onwards.
+	///</summary>
+	void EvaluateUniform(const XMFLOAT3* controlPoints, UINT patchCount, UINT tess, const Output& output);
+
+	///<summary>
+	/// Evaluates patch p at tess[p], filling vertices firstVertex[p] onwards.
+	///</summary>
+	void EvaluateAdaptive(const XMFLOAT3* controlPoints, UINT patchCount, const UINT* tess,
+		const UINT* firstVertex, const Output& output);
+
+	///<summary>
+	/// Fills firstVertex with where each patch starts in the output of
+	/// EvaluateAdaptive and returns the number of vertices the output needs.
+	///</summary>
+	static UINT ComputeVertexOffsets(const UINT* tess, UINT patchCount, UINT* firstVertex);
+
+	///<summary>
+	/// The distance falloff of the BasicTessellation demo's ConstantHS: MaxTessFactor
+	/// up to d0 from the eye, 1 from d1 on, measured to the middle of the patch
+	/// corners and rounded up as integer partitioning does.
+	///</summary>
+	static void ComputeDistanceFactors(const XMFLOAT3* controlPoints, UINT patchCount,
+		const XMFLOAT3& eyePos, float d0, float d1, UINT* tess);
+
+	///<summary>
+	/// The triangle list of a patch grid, wound clockwise like the hull shader's
+	/// triangle_cw output.  Writes GetIndexCount(tess) indices.
+	///</summary>
+	static void BuildIndices(UINT tess, UINT baseVertex, UINT* indices);
+
+	///<summary>
+	/// BernsteinBasis and CubicBezierSum of the domain shader at one (u, v), one
+	/// scalar at a time, with the normal from the dBernsteinBasis partials.
+	///</summary>
+	static void EvaluatePoint(const XMFLOAT3 controlPoints[16], float u, float v,
+		XMFLOAT3* position, XMFLOAT3* normal);
+
+private:
+	BezierPatchEvaluator(const BezierPatchEvaluator& rhs);
+	BezierPatchEvaluator& operator=(const BezierPatchEvaluator& rhs);
+
+	UINT GetThreadCount(UINT vertexCount)const;
+
+private:
+	UINT mThreadCount;
+};
+
+#endif // BEZIERPATCHEVALUATOR_H
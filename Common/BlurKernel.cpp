@@ -0,0 +1,173 @@
+//***************************************************************************************
+// BlurKernel.cpp
+//***************************************************************************************
+
+#include "BlurKernel.h"
+#include <cmath>
+#include <sstream>
+
+namespace
+{
+	// Past this radius the tail of a Gaussian is below float precision.
+	const float MaxSigmaMultiple = 6.0f;
+}
+
+BlurKernel::Report::Report()
+: Radius(0), DiscreteTaps(0), LinearTaps(0), MaxError(0.0f)
+{
+}
+
+std::vector<ImageFilter::LinearTap> BlurKernel::MergeTaps(const std::vector<float>& kernel)
+{
+	int radius = (int)kernel.size() / 2;
+
+	// Right half: center, then pairs (1,2), (3,4), ...
+	std::vector<ImageFilter::LinearTap> half;
+
+	ImageFilter::LinearTap center = { 0.0f, kernel[radius] };
+	half.push_back(center);
+
+	for(int i = 1; i <= radius; i += 2)
+	{
+		float w0 = kernel[radius + i];
+		float w1 = i + 1 <= radius ? kernel[radius + i + 1] : 0.0f;
+
+		ImageFilter::LinearTap tap;
+		tap.Weight = w0 + w1;
+		tap.Offset = tap.Weight > 0.0f ? (i*w0 + (i + 1)*w1)/tap.Weight : (float)i;
+		half.push_back(tap);
+	}
+
+	std::vector<ImageFilter::LinearTap> taps;
+	for(size_t i = half.size() - 1; i > 0; --i)
+	{
+		ImageFilter::LinearTap mirrored = { -half[i].Offset, half[i].Weight };
+		taps.push_back(mirrored);
+	}
+	taps.insert(taps.end(), half.begin(), half.end());
+
+	return taps;
+}
+
+std::vector<float> BlurKernel::ExpandTaps(const std::vector<ImageFilter::LinearTap>& taps, int radius)
+{
+	std::vector<float> kernel(2*radius + 1, 0.0f);
+
+	for(size_t t = 0; t < taps.size(); ++t)
+	{
+		float x0 = floorf(taps[t].Offset);
+		float f  = taps[t].Offset - x0;
+
+		int i = (int)x0 + radius;
+		if( i >= 0 && i <= 2*radius )
+			kernel[i] += taps[t].Weight*(1.0f - f);
+		if( i + 1 >= 0 && i + 1 <= 2*radius )
+			kernel[i + 1] += taps[t].Weight*f;
+	}
+
+	return kernel;
+}
+
+float BlurKernel::MaxDifference(const std::vector<float>& a, const std::vector<float>& b)
+{
+	// a is the wider kernel; b is centered in it.
+	int offset = ((int)a.size() - (int)b.size()) / 2;
+
+	float maxDiff = 0.0f;
+	for(int i = 0; i < (int)a.size(); ++i)
+	{
+		int j = i - offset;
+		float bi = j >= 0 && j < (int)b.size() ? b[j] : 0.0f;
+		maxDiff = MathHelper::Max(maxDiff, fabsf(a[i] - bi));
+	}
+
+	return maxDiff;
+}
+
+std::vector<ImageFilter::LinearTap> BlurKernel::BuildGaussianTaps(float sigma, float maxError, Report* report)
+{
+	int maxRadius = MathHelper::Max((int)ceilf(MaxSigmaMultiple*sigma), 1);
+	std::vector<float> reference = ImageFilter::BuildGaussianKernel(sigma, maxRadius);
+
+	// The error only shrinks as the radius grows, so take the first one that fits.
+	std::vector<ImageFilter::LinearTap> taps;
+	int radius = 0;
+	float error = 0.0f;
+	for(radius = 0; radius <= maxRadius; ++radius)
+	{
+		taps  = MergeTaps(ImageFilter::BuildGaussianKernel(sigma, radius));
+		error = MaxDifference(reference, ExpandTaps(taps, radius));
+
+		if( error <= maxError )
+			break;
+	}
+	radius = MathHelper::Min(radius, maxRadius);
+
+	// An odd radius leaves the outermost texel unpaired; one more texel on each
+	// side costs no extra fetch and only lowers the error.
+	if( radius % 2 == 1 && radius < maxRadius )
+	{
+		++radius;
+		taps  = MergeTaps(ImageFilter::BuildGaussianKernel(sigma, radius));
+		error = MaxDifference(reference, ExpandTaps(taps, radius));
+	}
+
+	if( report )
+	{
+		report->Radius       = radius;
+		report->DiscreteTaps = 2*radius + 1;
+		report->LinearTaps   = (UINT)taps.size();
+		report->MaxError     = error;
+	}
+
+	return taps;
+}
+
+std::vector<ImageFilter::LinearTap> BlurKernel::BuildBinomialTaps(int radius, Report* report)
+{
+	radius = MathHelper::Max(radius, 0);
+
+	std::vector<float> kernel = ImageFilter::BuildBinomialKernel(radius);
+	std::vector<ImageFilter::LinearTap> taps = MergeTaps(kernel);
+
+	if( report )
+	{
+		report->Radius       = radius;
+		report->DiscreteTaps = 2*radius + 1;
+		report->LinearTaps   = (UINT)taps.size();
+		report->MaxError     = MaxDifference(kernel, ExpandTaps(taps, radius));
+	}
+
+	return taps;
+}
+
+std::string BlurKernel::ToHlsl(const std::vector<ImageFilter::LinearTap>& taps, const std::string& prefix)
+{
+	std::ostringstream outs;
+	outs.precision(8);
+
+	outs << "static const int " << prefix << "Count = " << taps.size() << ";\n";
+
+	outs << "static const float " << prefix << "Offset[" << taps.size() << "] = { ";
+	for(size_t i = 0; i < taps.size(); ++i)
+		outs << (i > 0 ? ", " : "") << taps[i].Offset;
+	outs << " };\n";
+
+	outs << "static const float " << prefix << "Weight[" << taps.size() << "] = { ";
+	for(size_t i = 0; i < taps.size(); ++i)
+		outs << (i > 0 ? ", " : "") << taps[i].Weight;
+	outs << " };\n";
+
+	return outs.str();
+}
+
+std::string BlurKernel::FormatReport(const Report& report)
+{
+	std::ostringstream outs;
+	outs << "radius " << report.Radius
+		<< ": " << report.LinearTaps << " linear taps instead of " << report.DiscreteTaps
+		<< " (" << (report.DiscreteTaps - report.LinearTaps) << " saved per pass), max error "
+		<< report.MaxError;
+
+	return outs.str();
+}
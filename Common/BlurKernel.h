@@ -0,0 +1,75 @@
+//***************************************************************************************
+// BlurKernel.h
+//
+// Builds blur kernels for shaders that read the input with a linear filter.  Two
+// adjacent texels with weights w0 and w1 can be read by one bilinear fetch placed
+// between them at offset (x0*w0 + x1*w1)/(w0 + w1) with weight w0 + w1, so a
+// 2*radius+1 kernel needs only radius+1 fetches (the 9 tap binomial kernel of
+// BlurEven.fx becomes 5).
+//
+// The generator also picks the radius: the Gaussian is cut at the smallest
+// radius whose expanded, renormalized kernel stays within a given error of the
+// untruncated Gaussian, so blur width can be traded for cost explicitly.
+//***************************************************************************************
+
+#ifndef BLURKERNEL_H
+#define BLURKERNEL_H
+
+#include "ImageFilter.h"
+#include <string>
+
+class BlurKernel
+{
+public:
+	struct Report
+	{
+		Report();
+
+		int Radius;
+
+		// Fetches per pass with point sampling (2*Radius+1) and with linear taps.
+		UINT DiscreteTaps;
+		UINT LinearTaps;
+
+		// Largest difference between the weights the taps apply to each texel
+		// and the reference kernel.
+		float MaxError;
+	};
+
+	///<summary>
+	/// Merges a symmetric 2*radius+1 kernel into linear taps: the center alone
+	/// and the pairs (1,2), (3,4), ... on each side; an unpaired outermost texel
+	/// becomes a tap at its exact position.  Taps are ordered by offset.
+	///</summary>
+	static std::vector<ImageFilter::LinearTap> MergeTaps(const std::vector<float>& kernel);
+
+	///<summary>
+	/// The 2*radius+1 point sampled kernel that taps apply, i.e. how much each
+	/// texel contributes once the linear filter is taken into account.
+	///</summary>
+	static std::vector<float> ExpandTaps(const std::vector<ImageFilter::LinearTap>& taps, int radius);
+
+	///<summary>
+	/// Smallest set of linear taps approximating a Gaussian of the given sigma
+	/// with a per texel error of at most maxError.
+	///</summary>
+	static std::vector<ImageFilter::LinearTap> BuildGaussianTaps(float sigma, float maxError, Report* report = 0);
+
+	///<summary>
+	/// Linear taps of ImageFilter::BuildBinomialKernel(radius).
+	///</summary>
+	static std::vector<ImageFilter::LinearTap> BuildBinomialTaps(int radius, Report* report = 0);
+
+	///<summary>
+	/// HLSL declarations of the taps, in the form the LinearSamplingBlur shaders
+	/// use: static const arrays prefix##Offset and prefix##Weight and a count.
+	///</summary>
+	static std::string ToHlsl(const std::vector<ImageFilter::LinearTap>& taps, const std::string& prefix);
+
+	static std::string FormatReport(const Report& report);
+
+private:
+	static float MaxDifference(const std::vector<float>& a, const std::vector<float>& b);
+};
+
+#endif // BLURKERNEL_H
@@ -0,0 +1,350 @@
+//***************************************************************************************
+// ChunkedLodGrid.cpp
+//***************************************************************************************
+
+#include "ChunkedLodGrid.h"
+#include "Heightmap.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include <cmath>
+
+namespace
+{
+	// Below this many grid vertices the chunks are built on the calling thread.
+	const UINT ParallelVertexCount = 64*1024;
+}
+
+ChunkedLodGrid::ChunkedLodGrid()
+: mRows(0), mCols(0), mWidth(0.0f), mDepth(0.0f), mLodCount(0), mLodDistance(0.0f)
+{
+}
+
+ChunkedLodGrid::~ChunkedLodGrid()
+{
+}
+
+void ChunkedLodGrid::Build(float width, float depth, UINT m, UINT n, UINT chunkQuads, UINT lodCount, const HeightFunction& height)
+{
+	PROFILE_FUNCTION();
+
+	mRows  = m;
+	mCols  = n;
+	mWidth = width;
+	mDepth = depth;
+
+	float dx = width / (n-1);
+	float dz = depth / (m-1);
+
+	mHeights.resize(m*n);
+	Parallel::For(m, m*n >= ParallelVertexCount ? 0 : 1, [&](UINT i)
+	{
+		float z = 0.5f*depth - i*dz;
+		for(UINT j = 0; j < n; ++j)
+			mHeights[i*n+j] = height(-0.5f*width + j*dx, z);
+	});
+
+	BuildChunks(chunkQuads, lodCount);
+}
+
+void ChunkedLodGrid::Build(const Heightmap& heightmap, UINT chunkQuads, UINT lodCount)
+{
+	PROFILE_FUNCTION();
+
+	mRows    = heightmap.Height();
+	mCols    = heightmap.Width();
+	mWidth   = heightmap.GetWidth();
+	mDepth   = heightmap.GetDepth();
+	mHeights = heightmap.Heights();
+
+	BuildChunks(chunkQuads, lodCount);
+}
+
+void ChunkedLodGrid::SetLodDistance(float distance)
+{
+	mLodDistance = distance;
+}
+
+UINT ChunkedLodGrid::SelectLod(UINT chunk, const XMFLOAT3& eye)const
+{
+	const Chunk& c = mChunks[chunk];
+
+	// Distance from the eye to the box; zero inside it.
+	float dx = MathHelper::Max(fabsf(eye.x - c.Center.x) - c.Extents.x, 0.0f);
+	float dy = MathHelper::Max(fabsf(eye.y - c.Center.y) - c.Extents.y, 0.0f);
+	float dz = MathHelper::Max(fabsf(eye.z - c.Center.z) - c.Extents.z, 0.0f);
+	float distance = sqrtf(dx*dx + dy*dy + dz*dz);
+
+	UINT lod = 0;
+	float lodDistance = mLodDistance;
+	while( lod+1 < mLodCount && distance >= lodDistance )
+	{
+		++lod;
+		lodDistance *= 2.0f;
+	}
+
+	return lod;
+}
+
+UINT ChunkedLodGrid::Select(const XMFLOAT3& eye, std::vector<DrawItem>& items)const
+{
+	items.resize(mChunks.size());
+
+	UINT vertexCount = 0;
+	for(UINT i = 0; i < (UINT)mChunks.size(); ++i)
+	{
+		UINT lod = SelectLod(i, eye);
+		const Lod& l = mChunks[i].Lods[lod];
+
+		items[i].Chunk      = i;
+		items[i].Lod        = lod;
+		items[i].IndexStart = l.IndexStart;
+		items[i].IndexCount = l.IndexCount;
+
+		vertexCount += l.VertexCount;
+	}
+
+	return vertexCount;
+}
+
+const GeometryGenerator::MeshData& ChunkedLodGrid::GetMesh()const
+{
+	return mMesh;
+}
+
+GeometryGenerator::MeshData& ChunkedLodGrid::GetMesh()
+{
+	return mMesh;
+}
+
+const std::vector<ChunkedLodGrid::Chunk>& ChunkedLodGrid::GetChunks()const
+{
+	return mChunks;
+}
+
+UINT ChunkedLodGrid::GetLodCount()const
+{
+	return mLodCount;
+}
+
+UINT ChunkedLodGrid::GetGridVertexCount()const
+{
+	return mRows*mCols;
+}
+
+UINT ChunkedLodGrid::SampleCount(UINT quads, UINT lod)
+{
+	UINT step = 1u << lod;
+	return (quads + step-1)/step + 1;
+}
+
+UINT ChunkedLodGrid::Sample(UINT k, UINT quads, UINT lod)
+{
+	// The last sample always lands on the chunk border.
+	return MathHelper::Min(k << lod, quads);
+}
+
+void ChunkedLodGrid::BuildChunks(UINT chunkQuads, UINT lodCount)
+{
+	// No level coarser than one quad per chunk side.
+	mLodCount = 1;
+	while( mLodCount < MathHelper::Min(lodCount, MaxLods) && (1u << mLodCount) <= chunkQuads )
+		++mLodCount;
+
+	mLodDistance = 2.0f*chunkQuads*mWidth/(mCols-1);
+
+	UINT chunkRows = (mRows-1 + chunkQuads-1)/chunkQuads;
+	UINT chunkCols = (mCols-1 + chunkQuads-1)/chunkQuads;
+
+	//
+	// Size every level of every chunk first, so the mesh is allocated once and the
+	// chunks can then be filled in independently.
+	//
+
+	mChunks.resize(chunkRows*chunkCols);
+
+	UINT vertexCount = 0;
+	UINT indexCount  = 0;
+	std::vector<UINT> baseVertices(mChunks.size()*mLodCount);
+
+	for(UINT i = 0; i < chunkRows; ++i)
+	{
+		for(UINT j = 0; j < chunkCols; ++j)
+		{
+			Chunk& chunk = mChunks[i*chunkCols+j];
+
+			UINT rowQuads = MathHelper::Min(chunkQuads, mRows-1 - i*chunkQuads);
+			UINT colQuads = MathHelper::Min(chunkQuads, mCols-1 - j*chunkQuads);
+
+			for(UINT lod = 0; lod < mLodCount; ++lod)
+			{
+				UINT r = SampleCount(rowQuads, lod);
+				UINT c = SampleCount(colQuads, lod);
+
+				// The grid, then a skirt vertex under every border vertex; two
+				// triangles per grid quad and per skirt segment.
+				Lod& l = chunk.Lods[lod];
+				l.VertexCount = r*c + 2*(r + c);
+				l.IndexStart  = indexCount;
+				l.IndexCount  = 6*(r-1)*(c-1) + 6*2*((r-1) + (c-1));
+
+				baseVertices[(i*chunkCols+j)*mLodCount + lod] = vertexCount;
+				vertexCount += l.VertexCount;
+				indexCount  += l.IndexCount;
+			}
+		}
+	}
+
+	mMesh.Vertices.resize(vertexCount);
+	mMesh.Indices.resize(indexCount);
+
+	Parallel::For((UINT)mChunks.size(), mRows*mCols >= ParallelVertexCount ? 0 : 1, [&](UINT index)
+	{
+		UINT i = index / chunkCols;
+		UINT j = index % chunkCols;
+
+		UINT row0 = i*chunkQuads;
+		UINT col0 = j*chunkQuads;
+		UINT rowQuads = MathHelper::Min(chunkQuads, mRows-1 - row0);
+		UINT colQuads = MathHelper::Min(chunkQuads, mCols-1 - col0);
+
+		float minY = +MathHelper::Infinity;
+		float maxY = -MathHelper::Infinity;
+		for(UINT r = row0; r <= row0 + rowQuads; ++r)
+		{
+			for(UINT c = col0; c <= col0 + colQuads; ++c)
+			{
+				minY = MathHelper::Min(minY, mHeights[r*mCols+c]);
+				maxY = MathHelper::Max(maxY, mHeights[r*mCols+c]);
+			}
+		}
+
+		float dx = mWidth / (mCols-1);
+		float dz = mDepth / (mRows-1);
+
+		Chunk& chunk = mChunks[index];
+		chunk.Center  = XMFLOAT3(-0.5f*mWidth + (col0 + 0.5f*colQuads)*dx, 0.5f*(minY + maxY), 0.5f*mDepth - (row0 + 0.5f*rowQuads)*dz);
+		chunk.Extents = XMFLOAT3(0.5f*colQuads*dx, 0.5f*(maxY - minY), 0.5f*rowQuads*dz);
+
+		// A coarser neighbour can be off by at most the height range of the chunk.
+		float skirtDepth = MathHelper::Max(maxY - minY, 0.01f*MathHelper::Max(dx, dz));
+
+		for(UINT lod = 0; lod < mLodCount; ++lod)
+		{
+			BuildChunkLod(row0, col0, rowQuads, colQuads, lod, skirtDepth,
+				baseVertices[index*mLodCount + lod], chunk.Lods[lod].IndexStart);
+		}
+	});
+}
+
+void ChunkedLodGrid::BuildChunkLod(UINT row0, UINT col0, UINT rowQuads, UINT colQuads, UINT lod,
+								   float skirtDepth, UINT baseVertex, UINT baseIndex)
+{
+	UINT r = SampleCount(rowQuads, lod);
+	UINT c = SampleCount(colQuads, lod);
+
+	GeometryGenerator::Vertex* vertices = &mMesh.Vertices[baseVertex];
+	UINT* k = &mMesh.Indices[baseIndex];
+
+	for(UINT i = 0; i < r; ++i)
+	{
+		for(UINT j = 0; j < c; ++j)
+			vertices[i*c+j] = GetVertex(row0 + Sample(i, rowQuads, lod), col0 + Sample(j, colQuads, lod));
+	}
+
+	// Same winding as GeometryGenerator::CreateGrid.
+	for(UINT i = 0; i < r-1; ++i)
+	{
+		for(UINT j = 0; j < c-1; ++j)
+		{
+			k[0] = baseVertex + i*c+j;
+			k[1] = baseVertex + i*c+j+1;
+			k[2] = baseVertex + (i+1)*c+j;
+
+			k[3] = baseVertex + (i+1)*c+j;
+			k[4] = baseVertex + i*c+j+1;
+			k[5] = baseVertex + (i+1)*c+j+1;
+
+			k += 6;
+		}
+	}
+
+	//
+	// Skirts.  The border is walked clockwise seen from above, starting at the +z,
+	// -x corner: along row 0, down the last column, back along the last row and up
+	// column 0.  Each border vertex gets a copy skirtDepth below it.
+	//
+
+	auto border = [r, c](UINT edge, UINT s) -> UINT
+	{
+		switch( edge )
+		{
+		case 0:  return s;
+		case 1:  return s*c + c-1;
+		case 2:  return (r-1)*c + c-1-s;
+		default: return (r-1-s)*c;
+		}
+	};
+
+	UINT skirtVertex = r*c;
+	for(UINT edge = 0; edge < 4; ++edge)
+	{
+		UINT length = edge % 2 == 0 ? c : r;
+		for(UINT s = 0; s < length; ++s)
+		{
+			UINT top    = border(edge, s);
+			UINT bottom = skirtVertex + s;
+
+			vertices[bottom] = vertices[top];
+			vertices[bottom].Position.y -= skirtDepth;
+
+			if( s > 0 )
+			{
+				// Walking clockwise the outside is on the left; wound this
+				// way the segment's quad faces outward.
+				UINT ta = baseVertex + border(edge, s-1);
+				UINT tb = baseVertex + top;
+				UINT ba = baseVertex + bottom-1;
+				UINT bb = baseVertex + bottom;
+
+				k[0] = tb;
+				k[1] = ta;
+				k[2] = ba;
+
+				k[3] = tb;
+				k[4] = ba;
+				k[5] = bb;
+
+				k += 6;
+			}
+		}
+
+		skirtVertex += length;
+	}
+}
+
+GeometryGenerator::Vertex ChunkedLodGrid::GetVertex(UINT row, UINT col)const
+{
+	float dx = mWidth / (mCols-1);
+	float dz = mDepth / (mRows-1);
+
+	// Central differences, one sided on the border.
+	UINT left  = col > 0 ? col-1 : col;
+	UINT right = col+1 < mCols ? col+1 : col;
+	UINT up    = row > 0 ? row-1 : row;
+	UINT down  = row+1 < mRows ? row+1 : row;
+
+	// Rows run toward -z.
+	float dhdx = (mHeights[row*mCols+right] - mHeights[row*mCols+left]) / ((right-left)*dx);
+	float dhdz = (mHeights[up*mCols+col] - mHeights[down*mCols+col]) / ((down-up)*dz);
+
+	GeometryGenerator::Vertex v;
+	v.Position = XMFLOAT3(-0.5f*mWidth + col*dx, mHeights[row*mCols+col], 0.5f*mDepth - row*dz);
+
+	XMStoreFloat3(&v.Normal, XMVector3Normalize(XMVectorSet(-dhdx, 1.0f, -dhdz, 0.0f)));
+	XMStoreFloat3(&v.TangentU, XMVector3Normalize(XMVectorSet(1.0f, dhdx, 0.0f, 0.0f)));
+
+	v.TexC.x = (float)col/(mCols-1);
+	v.TexC.y = (float)row/(mRows-1);
+
+	return v;
+}
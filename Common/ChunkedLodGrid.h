@@ -0,0 +1,128 @@
+//***************************************************************************************
+// ChunkedLodGrid.h
+//
+// Splits a height field into square chunks and builds each chunk at several levels of
+// detail: level l keeps every 2^l-th row and column of the full grid.  Every level of
+// every chunk gets its own vertices and indices in one shared mesh, so a far chunk
+// drawn at a coarse level only fetches the vertices of that level.
+//
+// Neighbouring chunks drawn at different levels do not meet exactly.  Each level
+// hangs a skirt, a strip of triangles going straight down from its border, as deep
+// as the chunk's height range, which hides the cracks.
+//
+// The height field is either a function of world x, z or a Heightmap.  The grid is
+// laid out like GeometryGenerator::CreateGrid: centered on the origin, row 0 at +z.
+// Nothing here needs Direct3D.
+//***************************************************************************************
+
+#ifndef CHUNKEDLODGRID_H
+#define CHUNKEDLODGRID_H
+
+#include "GeometryGenerator.h"
+#include <functional>
+
+class Heightmap;
+
+class ChunkedLodGrid
+{
+public:
+	static const UINT MaxLods = 8;
+
+	typedef std::function<float(float x, float z)> HeightFunction;
+
+	struct Lod
+	{
+		UINT IndexStart;
+		UINT IndexCount;
+		UINT VertexCount;	// skirt included
+	};
+
+	struct Chunk
+	{
+		// Bounding box of the surface, skirts left out.
+		XMFLOAT3 Center;
+		XMFLOAT3 Extents;
+		Lod Lods[MaxLods];
+	};
+
+	struct DrawItem
+	{
+		UINT Chunk;
+		UINT Lod;
+		UINT IndexStart;
+		UINT IndexCount;
+	};
+
+	ChunkedLodGrid();
+	~ChunkedLodGrid();
+
+	///<summary>
+	/// Builds an m x n vertex grid of the given extent with heights from height.
+	/// chunkQuads is the number of quads along a chunk side at level 0; the last
+	/// chunk of a row or column takes what is left.  lodCount is at most MaxLods,
+	/// and levels coarser than one quad per chunk side are not made.
+	///</summary>
+	void Build(float width, float depth, UINT m, UINT n, UINT chunkQuads, UINT lodCount, const HeightFunction& height);
+
+	///<summary>
+	/// Builds the grid from every height of heightmap.
+	///</summary>
+	void Build(const Heightmap& heightmap, UINT chunkQuads, UINT lodCount);
+
+	///<summary>
+	/// Level 1 is used from this distance to a chunk's box on, and every further
+	/// level from twice the distance of the one before.  Build sets it to twice
+	/// the width of a chunk.
+	///</summary>
+	void SetLodDistance(float distance);
+
+	///<summary>
+	/// Level of detail for chunk as seen from eye.
+	///</summary>
+	UINT SelectLod(UINT chunk, const XMFLOAT3& eye)const;
+
+	///<summary>
+	/// One draw per chunk at the level SelectLod picks.  Returns the number of
+	/// vertices those levels hold.
+	///</summary>
+	UINT Select(const XMFLOAT3& eye, std::vector<DrawItem>& items)const;
+
+	const GeometryGenerator::MeshData& GetMesh()const;
+	GeometryGenerator::MeshData& GetMesh();
+
+	const std::vector<Chunk>& GetChunks()const;
+	UINT GetLodCount()const;
+
+	// Vertices of the full grid, which is what a single mesh at level 0 would hold.
+	UINT GetGridVertexCount()const;
+
+private:
+	ChunkedLodGrid(const ChunkedLodGrid& rhs);
+	ChunkedLodGrid& operator=(const ChunkedLodGrid& rhs);
+
+	void BuildChunks(UINT chunkQuads, UINT lodCount);
+	void BuildChunkLod(UINT row0, UINT col0, UINT rowQuads, UINT colQuads, UINT lod,
+		float skirtDepth, UINT baseVertex, UINT baseIndex);
+
+	GeometryGenerator::Vertex GetVertex(UINT row, UINT col)const;
+
+	// Row or column samples of a side of quads quads at level lod.
+	static UINT SampleCount(UINT quads, UINT lod);
+	static UINT Sample(UINT k, UINT quads, UINT lod);
+
+private:
+	// Full resolution heights, row by row.
+	std::vector<float> mHeights;
+	UINT mRows;
+	UINT mCols;
+	float mWidth;
+	float mDepth;
+
+	UINT mLodCount;
+	float mLodDistance;
+
+	GeometryGenerator::MeshData mMesh;
+	std::vector<Chunk> mChunks;
+};
+
+#endif // CHUNKEDLODGRID_H
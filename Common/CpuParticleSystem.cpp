@@ -0,0 +1,341 @@
+//***************************************************************************************
+// CpuParticleSystem.cpp
+//***************************************************************************************
+
+#include "CpuParticleSystem.h"
+#include "MathHelper.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include <cmath>
+
+namespace
+{
+	// Particles integrated by one task; a multiple of four.
+	const UINT ChunkSize = 4096;
+
+	// Below this many live particles the update stays on the calling thread.
+	const UINT ParallelParticleCount = 4*ChunkSize;
+
+	inline XMVECTOR Load4(const float* p)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+	}
+
+	inline void Store4(float* p, FXMVECTOR v)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+	}
+}
+
+CpuParticleSystem::EmitterDesc::EmitterDesc()
+: Offset(0.0f, 0.0f, 0.0f), OffsetSpread(0.0f, 0.0f, 0.0f),
+  Velocity(0.0f, 0.0f, 0.0f), VelocitySpread(0.0f, 0.0f, 0.0f),
+  Size(1.0f, 1.0f), Lifetime(1.0f), Rate(100.0f), Seed(0)
+{
+}
+
+void CpuParticleSystem::Random::Seed(UINT64 seed, UINT64 stream)
+{
+	mState     = 0;
+	mIncrement = (stream << 1) | 1;
+	Next();
+	mState += seed;
+	Next();
+}
+
+UINT CpuParticleSystem::Random::Next()
+{
+	UINT64 old = mState;
+	mState = old*6364136223846793005ull + mIncrement;
+
+	UINT xorShifted = (UINT)(((old >> 18) ^ old) >> 27);
+	UINT rotation   = (UINT)(old >> 59);
+	return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+}
+
+float CpuParticleSystem::Random::NextSigned()
+{
+	// 24 random bits fill a float mantissa exactly.
+	return (float)(Next() >> 8)*(2.0f/16777216.0f) - 1.0f;
+}
+
+CpuParticleSystem::CpuParticleSystem()
+: mMaxParticles(0), mCount(0), mAccel(0.0f, 0.0f, 0.0f), mIntegrator(VelocityVerlet), mThreadCount(0)
+{
+}
+
+CpuParticleSystem::~CpuParticleSystem()
+{
+}
+
+void CpuParticleSystem::Init(UINT maxParticles)
+{
+	mMaxParticles = maxParticles;
+	mCount = 0;
+	mEmitters.clear();
+
+	// Padded so the last group of four never reads past the end.
+	UINT padded = (maxParticles + 3) & ~3u;
+
+	std::vector<float>* arrays[] = { &mPosX, &mPosY, &mPosZ, &mVelX, &mVelY, &mVelZ, &mSizeX, &mSizeY, &mAge, &mLifetime };
+	for(UINT i = 0; i < sizeof(arrays)/sizeof(arrays[0]); ++i)
+		arrays[i]->assign(padded, 0.0f);
+}
+
+void CpuParticleSystem::Reset()
+{
+	mCount = 0;
+
+	for(UINT i = 0; i < (UINT)mEmitters.size(); ++i)
+	{
+		mEmitters[i].Rng.Seed(mEmitters[i].Desc.Seed, i);
+		mEmitters[i].Pending = 0.0f;
+	}
+}
+
+UINT CpuParticleSystem::AddEmitter(const EmitterDesc& desc, const XMFLOAT3& position)
+{
+	Emitter emitter;
+	emitter.Desc     = desc;
+	emitter.Position = position;
+	emitter.Rng.Seed(desc.Seed, mEmitters.size());
+	emitter.Pending  = 0.0f;
+
+	mEmitters.push_back(emitter);
+	return (UINT)mEmitters.size() - 1;
+}
+
+void CpuParticleSystem::SetEmitterPosition(UINT emitter, const XMFLOAT3& position)
+{
+	mEmitters[emitter].Position = position;
+}
+
+void CpuParticleSystem::SetAcceleration(const XMFLOAT3& accel)
+{
+	mAccel = accel;
+}
+
+void CpuParticleSystem::SetIntegrator(Integrator integrator)
+{
+	mIntegrator = integrator;
+}
+
+void CpuParticleSystem::SetThreadCount(UINT threadCount)
+{
+	mThreadCount = threadCount;
+}
+
+void CpuParticleSystem::Update(float dt)
+{
+	PROFILE_FUNCTION();
+
+	UINT count = mCount;
+	UINT chunks = (count + ChunkSize-1) / ChunkSize;
+	Parallel::For(chunks, GetUpdateThreads(), [=](UINT chunk)
+	{
+		UINT first = chunk*ChunkSize;
+		Integrate(first, MathHelper::Min(ChunkSize, count - first), dt);
+	});
+
+	RemoveDead();
+
+	for(size_t i = 0; i < mEmitters.size(); ++i)
+		Emit(mEmitters[i], dt);
+}
+
+UINT CpuParticleSystem::WriteVertices(Vertex* vertices, const XMFLOAT3& drawAccel, UINT type, const UINT* order)const
+{
+	PROFILE_FUNCTION();
+
+	UINT count = mCount;
+	UINT chunks = (count + ChunkSize-1) / ChunkSize;
+	Parallel::For(chunks, GetUpdateThreads(), [=](UINT chunk)
+	{
+		const float* posX  = &mPosX[0];
+		const float* posY  = &mPosY[0];
+		const float* posZ  = &mPosZ[0];
+		const float* sizeX = &mSizeX[0];
+		const float* sizeY = &mSizeY[0];
+		const float* age   = &mAge[0];
+
+		UINT first = chunk*ChunkSize;
+		UINT last  = MathHelper::Min(first + ChunkSize, count);
+		for(UINT k = first; k < last; ++k)
+		{
+			UINT i = order ? order[k] : k;
+
+			// The draw shader computes 0.5*t*t*gAccelW + t*InitialVelW + InitialPosW;
+			// with no initial velocity that is the simulated position.
+			float h = 0.5f*age[i]*age[i];
+
+			Vertex& v = vertices[k];
+			v.InitialPos = XMFLOAT3(posX[i] - h*drawAccel.x, posY[i] - h*drawAccel.y, posZ[i] - h*drawAccel.z);
+			v.InitialVel = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			v.Size       = XMFLOAT2(sizeX[i], sizeY[i]);
+			v.Age        = age[i];
+			v.Type       = type;
+		}
+	});
+
+	return count;
+}
+
+UINT CpuParticleSystem::GetParticleCount()const
+{
+	return mCount;
+}
+
+UINT CpuParticleSystem::GetMaxParticles()const
+{
+	return mMaxParticles;
+}
+
+XMFLOAT3 CpuParticleSystem::GetPosition(UINT particle)const
+{
+	return XMFLOAT3(mPosX[particle], mPosY[particle], mPosZ[particle]);
+}
+
+void CpuParticleSystem::GetPositions(const float** x, const float** y, const float** z)const
+{
+	*x = &mPosX[0];
+	*y = &mPosY[0];
+	*z = &mPosZ[0];
+}
+
+void CpuParticleSystem::Integrate(UINT first, UINT count, float dt)
+{
+	float* posX = &mPosX[0];
+	float* posY = &mPosY[0];
+	float* posZ = &mPosZ[0];
+	float* velX = &mVelX[0];
+	float* velY = &mVelY[0];
+	float* velZ = &mVelZ[0];
+	float* age  = &mAge[0];
+
+	XMVECTOR dtV = XMVectorReplicate(dt);
+
+	// Velocity change over the step, and the extra position change Verlet adds.
+	XMVECTOR dvX = XMVectorReplicate(mAccel.x*dt);
+	XMVECTOR dvY = XMVectorReplicate(mAccel.y*dt);
+	XMVECTOR dvZ = XMVectorReplicate(mAccel.z*dt);
+
+	float h = mIntegrator == VelocityVerlet ? 0.5f*dt*dt : 0.0f;
+	XMVECTOR dpX = XMVectorReplicate(mAccel.x*h);
+	XMVECTOR dpY = XMVectorReplicate(mAccel.y*h);
+	XMVECTOR dpZ = XMVectorReplicate(mAccel.z*h);
+
+	// first is a multiple of four and the arrays are padded, so the lanes past
+	// the live particles are only ever stale copies.
+	UINT last = first + count;
+	if( mIntegrator == VelocityVerlet )
+	{
+		for(UINT i = first; i < last; i += 4)
+		{
+			XMVECTOR vx = Load4(velX + i);
+			XMVECTOR vy = Load4(velY + i);
+			XMVECTOR vz = Load4(velZ + i);
+
+			Store4(posX + i, XMVectorAdd(XMVectorMultiplyAdd(vx, dtV, Load4(posX + i)), dpX));
+			Store4(posY + i, XMVectorAdd(XMVectorMultiplyAdd(vy, dtV, Load4(posY + i)), dpY));
+			Store4(posZ + i, XMVectorAdd(XMVectorMultiplyAdd(vz, dtV, Load4(posZ + i)), dpZ));
+
+			Store4(velX + i, XMVectorAdd(vx, dvX));
+			Store4(velY + i, XMVectorAdd(vy, dvY));
+			Store4(velZ + i, XMVectorAdd(vz, dvZ));
+
+			Store4(age + i, XMVectorAdd(Load4(age + i), dtV));
+		}
+	}
+	else
+	{
+		for(UINT i = first; i < last; i += 4)
+		{
+			XMVECTOR vx = XMVectorAdd(Load4(velX + i), dvX);
+			XMVECTOR vy = XMVectorAdd(Load4(velY + i), dvY);
+			XMVECTOR vz = XMVectorAdd(Load4(velZ + i), dvZ);
+
+			Store4(posX + i, XMVectorMultiplyAdd(vx, dtV, Load4(posX + i)));
+			Store4(posY + i, XMVectorMultiplyAdd(vy, dtV, Load4(posY + i)));
+			Store4(posZ + i, XMVectorMultiplyAdd(vz, dtV, Load4(posZ + i)));
+
+			Store4(velX + i, vx);
+			Store4(velY + i, vy);
+			Store4(velZ + i, vz);
+
+			Store4(age + i, XMVectorAdd(Load4(age + i), dtV));
+		}
+	}
+}
+
+void CpuParticleSystem::RemoveDead()
+{
+	std::vector<float>* arrays[] = { &mPosX, &mPosY, &mPosZ, &mVelX, &mVelY, &mVelZ, &mSizeX, &mSizeY, &mAge, &mLifetime };
+	const UINT arrayCount = sizeof(arrays)/sizeof(arrays[0]);
+
+	UINT i = 0;
+	while( i < mCount )
+	{
+		if( mAge[i] < mLifetime[i] )
+		{
+			++i;
+			continue;
+		}
+
+		// Move the last particle into the hole and look at slot i again.
+		--mCount;
+		for(UINT a = 0; a < arrayCount; ++a)
+			(*arrays[a])[i] = (*arrays[a])[mCount];
+	}
+}
+
+void CpuParticleSystem::Emit(Emitter& emitter, float dt)
+{
+	const EmitterDesc& desc = emitter.Desc;
+
+	emitter.Pending += desc.Rate*dt;
+	UINT wanted = (UINT)emitter.Pending;
+	emitter.Pending -= (float)wanted;
+
+	UINT count = MathHelper::Min(wanted, mMaxParticles - mCount);
+	for(UINT k = 0; k < count; ++k)
+	{
+		Random& rng = emitter.Rng;
+
+		float ox = rng.NextSigned();
+		float oy = rng.NextSigned();
+		float oz = rng.NextSigned();
+
+		// Rejection sampling keeps the directions uniform over the sphere.
+		float dx, dy, dz, lengthSq;
+		do
+		{
+			dx = rng.NextSigned();
+			dy = rng.NextSigned();
+			dz = rng.NextSigned();
+			lengthSq = dx*dx + dy*dy + dz*dz;
+		}
+		while( lengthSq > 1.0f || lengthSq < 1e-6f );
+
+		float invLength = 1.0f/sqrtf(lengthSq);
+
+		UINT i = mCount++;
+		mPosX[i] = emitter.Position.x + desc.Offset.x + ox*desc.OffsetSpread.x;
+		mPosY[i] = emitter.Position.y + desc.Offset.y + oy*desc.OffsetSpread.y;
+		mPosZ[i] = emitter.Position.z + desc.Offset.z + oz*desc.OffsetSpread.z;
+		mVelX[i] = desc.Velocity.x + dx*invLength*desc.VelocitySpread.x;
+		mVelY[i] = desc.Velocity.y + dy*invLength*desc.VelocitySpread.y;
+		mVelZ[i] = desc.Velocity.z + dz*invLength*desc.VelocitySpread.z;
+		mSizeX[i]    = desc.Size.x;
+		mSizeY[i]    = desc.Size.y;
+		mAge[i]      = 0.0f;
+		mLifetime[i] = desc.Lifetime;
+	}
+}
+
+UINT CpuParticleSystem::GetUpdateThreads()const
+{
+	if( mThreadCount != 0 )
+		return mThreadCount;
+
+	return mCount >= ParallelParticleCount ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+//***************************************************************************************
+// CpuParticleSystem.h
+//
+// Particle simulation on the CPU, for machines without stream-out and for runs that
+// have to come out the same every time.
+//
+// Particles are kept as structure of arrays (one array per component of position,
+// velocity, size, plus age and lifetime), padded to a multiple of four so the
+// integration runs four particles per SSE instruction with no scalar tail.  Large
+// systems are integrated in chunks spread over every hardware thread.  Dead particles
+// are removed by moving the last live particle into their slot, so the live ones stay
+// packed at the front and their order is not kept.
+//
+// Each emitter draws from its own random stream, seeded from its description, and
+// emission always runs on the calling thread: the same seeds and time steps give the
+// same particles whatever the thread count.
+//
+// WriteVertices fills vertices laid out like the Chapter 20 Vertex::Particle, with the
+// initial position set so that the draw technique's constant acceleration equation
+// lands on the simulated position.  Nothing here needs Direct3D.
+//***************************************************************************************
+
+#ifndef CPUPARTICLESYSTEM_H
+#define CPUPARTICLESYSTEM_H
+
+#include "XnaMathPortable.h"
+#include <vector>
+
+class CpuParticleSystem
+{
+public:
+	// Same layout as the POSITION, VELOCITY, SIZE, AGE, TYPE particle input layout.
+	struct Vertex
+	{
+		XMFLOAT3 InitialPos;
+		XMFLOAT3 InitialVel;
+		XMFLOAT2 Size;
+		float Age;
+		UINT Type;
+	};
+
+	enum Integrator
+	{
+		// v += a dt, then p += v dt.
+		SemiImplicitEuler,
+		// p += v dt + a dt^2/2, then v += a dt; exact for constant acceleration.
+		VelocityVerlet
+	};
+
+	struct EmitterDesc
+	{
+		EmitterDesc();
+
+		// New particles start at the emitter position plus Offset plus a random
+		// point of the box with half extents OffsetSpread.
+		XMFLOAT3 Offset;
+		XMFLOAT3 OffsetSpread;
+
+		// Velocity plus a random unit vector scaled by VelocitySpread per axis.
+		XMFLOAT3 Velocity;
+		XMFLOAT3 VelocitySpread;
+
+		XMFLOAT2 Size;
+		float Lifetime;
+
+		// Particles per second.
+		float Rate;
+
+		UINT Seed;
+	};
+
+	CpuParticleSystem();
+	~CpuParticleSystem();
+
+	///<summary>
+	/// Drops every particle and emitter and makes room for maxParticles.  Emitters
+	/// stop emitting while the system is full.
+	///</summary>
+	void Init(UINT maxParticles);
+
+	///<summary>
+	/// Kills every particle and restarts every emitter's random stream from its seed.
+	///</summary>
+	void Reset();
+
+	UINT AddEmitter(const EmitterDesc& desc, const XMFLOAT3& position);
+	void SetEmitterPosition(UINT emitter, const XMFLOAT3& position);
+
+	void SetAcceleration(const XMFLOAT3& accel);
+	void SetIntegrator(Integrator integrator);
+
+	///<summary>
+	/// threadCount 0 uses every hardware thread for large systems; 1 keeps the
+	/// update on the calling thread.
+	///</summary>
+	void SetThreadCount(UINT threadCount);
+
+	///<summary>
+	/// Ages, moves and removes the dead, then emits.
+	///</summary>
+	void Update(float dt);
+
+	///<summary>
+	/// Writes the live particles to vertices, which must hold GetParticleCount()
+	/// of them, and returns how many were written.  drawAccel is the acceleration
+	/// the draw shader applies to age (gAccelW); type is written to every vertex.
+	/// With order, vertex k is particle order[k], such as a DepthSorter order.
+	///</summary>
+	UINT WriteVertices(Vertex* vertices, const XMFLOAT3& drawAccel, UINT type = 1, const UINT* order = 0)const;
+
+	UINT GetParticleCount()const;
+	UINT GetMaxParticles()const;
+
+	// Position of a live particle; for tests and debugging.
+	XMFLOAT3 GetPosition(UINT particle)const;
+
+	// The position arrays, valid until the next Update.
+	void GetPositions(const float** x, const float** y, const float** z)const;
+
+private:
+	CpuParticleSystem(const CpuParticleSystem& rhs);
+	CpuParticleSystem& operator=(const CpuParticleSystem& rhs);
+
+	// PCG32; each emitter gets its own stream.
+	class Random
+	{
+	public:
+		void Seed(UINT64 seed, UINT64 stream);
+		UINT Next();
+		// [-1, 1)
+		float NextSigned();
+	private:
+		UINT64 mState;
+		UINT64 mIncrement;
+	};
+
+	struct Emitter
+	{
+		EmitterDesc Desc;
+		XMFLOAT3 Position;
+		Random Rng;
+		float Pending;	// fraction of a particle owed from earlier updates
+	};
+
+	void Integrate(UINT first, UINT count, float dt);
+	void RemoveDead();
+	void Emit(Emitter& emitter, float dt);
+	UINT GetUpdateThreads()const;
+
+private:
+	UINT mMaxParticles;
+	UINT mCount;
+
+	std::vector<float> mPosX, mPosY, mPosZ;
+	std::vector<float> mVelX, mVelY, mVelZ;
+	std::vector<float> mSizeX, mSizeY;
+	std::vector<float> mAge;
+	std::vector<float> mLifetime;
+
+	std::vector<Emitter> mEmitters;
+
+	XMFLOAT3 mAccel;
+	Integrator mIntegrator;
+	UINT mThreadCount;
+};
+
+#endif // CPUPARTICLESYSTEM_H
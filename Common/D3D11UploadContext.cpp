@@ -0,0 +1,108 @@
+//***************************************************************************************
+// D3D11UploadContext.cpp
+//***************************************************************************************
+
+#include "D3D11UploadContext.h"
+
+D3D11UploadContext::D3D11UploadContext(ID3D11Device* device, ID3D11DeviceContext* dc, bool bindGeometryShader)
+: md3dDevice(device), mDC(dc), mBindGeometryShader(bindGeometryShader)
+{
+}
+
+D3D11UploadContext::~D3D11UploadContext()
+{
+}
+
+bool D3D11UploadContext::SupportsRangeBinding()const
+{
+	return false;
+}
+
+void* D3D11UploadContext::MapFrame(UINT frame, UINT frameByteSize)
+{
+	if( frame >= mArenas.size() )
+		mArenas.resize(frame + 1);
+
+	SizedBuffer& arena = mArenas[frame];
+	if( arena.ByteSize < frameByteSize )
+	{
+		D3D11_BUFFER_DESC desc;
+		desc.ByteWidth           = frameByteSize;
+		desc.Usage               = D3D11_USAGE_STAGING;
+		desc.BindFlags           = 0;
+		desc.CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags           = 0;
+		desc.StructureByteStride = 0;
+
+		arena.Buffer.Reset();
+		ThrowIfFailed(md3dDevice->CreateBuffer(&desc, nullptr, arena.Buffer.GetAddressOf()));
+		arena.ByteSize = frameByteSize;
+	}
+
+	// A staging buffer cannot be discarded; the map waits only if the GPU has not
+	// yet run the copies out of this arena, FrameCount frames ago.
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	ThrowIfFailed(mDC->Map(arena.Buffer.Get(), 0, D3D11_MAP_WRITE, 0, &mapped));
+	return mapped.pData;
+}
+
+void D3D11UploadContext::UnmapFrame(UINT frame)
+{
+	mDC->Unmap(mArenas[frame].Buffer.Get(), 0);
+}
+
+void D3D11UploadContext::CommitRange(UINT frame, UINT offset, UINT byteSize)
+{
+	// Constant buffer sizes must be a multiple of 16 bytes; ring ranges are
+	// 256 byte aligned, so the rounded up copy stays inside the arena.
+	UINT alignedSize = (byteSize + 15) & ~15;
+
+	UINT index = offset/FrameResourceRing::ConstantAlignment;
+	if( index >= mRangeBuffers.size() )
+		mRangeBuffers.resize(index + 1);
+
+	// The copy has to fill the whole destination: D3D11.0 only guarantees copies
+	// into part of a constant buffer with ConstantBufferPartialUpdate, which this
+	// SDK cannot query.  A range that changes size gets a buffer of its new size.
+	SizedBuffer& range = mRangeBuffers[index];
+	if( range.ByteSize != alignedSize )
+	{
+		D3D11_BUFFER_DESC desc;
+		desc.ByteWidth           = alignedSize;
+		desc.Usage               = D3D11_USAGE_DEFAULT;
+		desc.BindFlags           = D3D11_BIND_CONSTANT_BUFFER;
+		desc.CPUAccessFlags      = 0;
+		desc.MiscFlags           = 0;
+		desc.StructureByteStride = 0;
+
+		range.Buffer.Reset();
+		ThrowIfFailed(md3dDevice->CreateBuffer(&desc, nullptr, range.Buffer.GetAddressOf()));
+		range.ByteSize = alignedSize;
+	}
+
+	D3D11_BOX box;
+	box.left   = offset;
+	box.right  = offset + alignedSize;
+	box.top    = 0;
+	box.bottom = 1;
+	box.front  = 0;
+	box.back   = 1;
+
+	mDC->CopySubresourceRegion(range.Buffer.Get(), 0, 0, 0, 0, mArenas[frame].Buffer.Get(), 0, &box);
+}
+
+void D3D11UploadContext::Bind(UINT slot, UINT /*frame*/, UINT offset, UINT /*byteSize*/)
+{
+	ID3D11Buffer* buffer = GetBuffer(offset);
+
+	mDC->VSSetConstantBuffers(slot, 1, &buffer);
+	mDC->PSSetConstantBuffers(slot, 1, &buffer);
+	if( mBindGeometryShader )
+		mDC->GSSetConstantBuffers(slot, 1, &buffer);
+}
+
+ID3D11Buffer* D3D11UploadContext::GetBuffer(UINT offset)const
+{
+	UINT index = offset/FrameResourceRing::ConstantAlignment;
+	return index < mRangeBuffers.size() ? mRangeBuffers[index].Buffer.Get() : nullptr;
+}
@@ -0,0 +1,66 @@
+//***************************************************************************************
+// D3D11UploadContext.h
+//
+// FrameResourceRing::UploadContext on top of an ID3D11DeviceContext.  Binding a
+// range of a constant buffer needs ID3D11DeviceContext1, which the D3D11.h shipped
+// with this SDK does not declare.  Instead each frame of the ring has a staging
+// arena that its slice is written to with one map, and the ranges the ring reports
+// as changed are copied on the GPU into a default usage constant buffer per offset,
+// exactly the size of the range, which is what Bind binds.  The copies are queued with the draws, so one buffer
+// per offset serves every frame; the arenas are what the ring N-buffers, so the map
+// of a frame's arena does not wait for the copies of the frame before it.
+//
+// Bind sets the vertex and pixel stages, and the geometry stage as well for
+// demos whose geometry shader reads the same constants.
+//***************************************************************************************
+
+#ifndef D3D11UPLOADCONTEXT_H
+#define D3D11UPLOADCONTEXT_H
+
+#include "d3dUtil.h"
+#include "FrameResourceRing.h"
+
+class D3D11UploadContext : public FrameResourceRing::UploadContext
+{
+public:
+	D3D11UploadContext(ID3D11Device* device, ID3D11DeviceContext* dc, bool bindGeometryShader = false);
+	~D3D11UploadContext();
+
+	bool SupportsRangeBinding()const;
+
+	void* MapFrame(UINT frame, UINT frameByteSize);
+	void UnmapFrame(UINT frame);
+
+	void CommitRange(UINT frame, UINT offset, UINT byteSize);
+	void Bind(UINT slot, UINT frame, UINT offset, UINT byteSize);
+
+	// The constant buffer holding the range at offset, or null if none was
+	// committed there.
+	ID3D11Buffer* GetBuffer(UINT offset)const;
+
+private:
+	D3D11UploadContext(const D3D11UploadContext& rhs);
+	D3D11UploadContext& operator=(const D3D11UploadContext& rhs);
+
+	struct SizedBuffer
+	{
+		SizedBuffer() : ByteSize(0) {}
+
+		Microsoft::WRL::ComPtr<ID3D11Buffer> Buffer;
+		UINT ByteSize;
+	};
+
+private:
+	ID3D11Device* md3dDevice;
+	ID3D11DeviceContext* mDC;
+	bool mBindGeometryShader;
+
+	// Indexed by frame.
+	std::vector<SizedBuffer> mArenas;
+
+	// Indexed by offset/FrameResourceRing::ConstantAlignment, so a bind is an
+	// array lookup.
+	std::vector<SizedBuffer> mRangeBuffers;
+};
+
+#endif // D3D11UPLOADCONTEXT_H
@@ -0,0 +1,380 @@
+//***************************************************************************************
+// DDSTexture.cpp
+//***************************************************************************************
+
+#include "DDSTexture.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	const UINT DDSMagic = 0x20534444; // "DDS "
+
+	// DDS_PIXELFORMAT.dwFlags
+	const UINT DDPF_ALPHAPIXELS = 0x1;
+	const UINT DDPF_FOURCC      = 0x4;
+	const UINT DDPF_RGB         = 0x40;
+	const UINT DDPF_LUMINANCE   = 0x20000;
+
+	// DDS_HEADER.dwFlags / dwCaps2
+	const UINT DDSD_DEPTH            = 0x800000;
+	const UINT DDSCAPS2_CUBEMAP      = 0x200;
+	const UINT DDSCAPS2_CUBEMAP_ALL  = 0xFC00;
+	const UINT DDSCAPS2_VOLUME       = 0x200000;
+
+	// DDS_HEADER_DXT10
+	const UINT DDS_DIMENSION_TEXTURE2D  = 3;
+	const UINT DDS_RESOURCE_MISC_CUBE   = 0x4;
+
+	// The DXGI_FORMAT values used below.
+	enum
+	{
+		FORMAT_R32G32B32A32_FLOAT = 2,
+		FORMAT_R16G16B16A16_FLOAT = 10,
+		FORMAT_R16G16B16A16_UNORM = 11,
+		FORMAT_R32G32_FLOAT       = 16,
+		FORMAT_R10G10B10A2_UNORM  = 24,
+		FORMAT_R8G8B8A8_TYPELESS  = 27,
+		FORMAT_R8G8B8A8_UNORM     = 28,
+		FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+		FORMAT_R16G16_FLOAT       = 34,
+		FORMAT_R16G16_UNORM       = 35,
+		FORMAT_R32_FLOAT          = 41,
+		FORMAT_R8G8_UNORM         = 49,
+		FORMAT_R16_FLOAT          = 54,
+		FORMAT_R16_UNORM          = 56,
+		FORMAT_R8_UNORM           = 61,
+		FORMAT_A8_UNORM           = 65,
+		FORMAT_BC1_TYPELESS       = 70,
+		FORMAT_BC1_UNORM          = 71,
+		FORMAT_BC1_UNORM_SRGB     = 72,
+		FORMAT_BC2_UNORM          = 74,
+		FORMAT_BC3_UNORM          = 77,
+		FORMAT_BC4_UNORM          = 80,
+		FORMAT_BC4_SNORM          = 81,
+		FORMAT_BC5_UNORM          = 83,
+		FORMAT_BC5_SNORM          = 84,
+		FORMAT_B5G6R5_UNORM       = 85,
+		FORMAT_B5G5R5A1_UNORM     = 86,
+		FORMAT_B8G8R8A8_UNORM     = 87,
+		FORMAT_B8G8R8X8_UNORM     = 88,
+		FORMAT_B8G8R8A8_TYPELESS  = 90,
+		FORMAT_B8G8R8X8_UNORM_SRGB = 93,
+		FORMAT_BC6H_TYPELESS      = 94,
+		FORMAT_BC7_UNORM_SRGB     = 99,
+	};
+
+	UINT MakeFourCC(char a, char b, char c, char d)
+	{
+		return (UINT)(unsigned char)a | ((UINT)(unsigned char)b << 8) |
+			((UINT)(unsigned char)c << 16) | ((UINT)(unsigned char)d << 24);
+	}
+
+	UINT ReadUint(const unsigned char* p)
+	{
+		return (UINT)p[0] | ((UINT)p[1] << 8) | ((UINT)p[2] << 16) | ((UINT)p[3] << 24);
+	}
+
+	// Bytes per 4x4 block of a block compressed format, or 0.
+	UINT BlockSize(UINT format)
+	{
+		if( format >= FORMAT_BC1_TYPELESS && format <= FORMAT_BC1_UNORM_SRGB ) return 8;
+		if( format >= 79 && format <= FORMAT_BC4_SNORM ) return 8;
+		if( format >= 73 && format <= 78 ) return 16;
+		if( format >= 82 && format <= FORMAT_BC5_SNORM ) return 16;
+		if( format >= FORMAT_BC6H_TYPELESS && format <= FORMAT_BC7_UNORM_SRGB ) return 16;
+		return 0;
+	}
+
+	// Bits per pixel of an uncompressed format, or 0 for one not handled.
+	UINT BitsPerPixel(UINT format)
+	{
+		if( format >= 1 && format <= 4 ) return 128;
+		if( format >= 9 && format <= 22 ) return 64;
+		if( format >= 23 && format <= 47 ) return 32;
+		if( format >= 48 && format <= 59 ) return 16;
+		if( format >= 60 && format <= 65 ) return 8;
+		if( format == FORMAT_B5G6R5_UNORM || format == FORMAT_B5G5R5A1_UNORM ) return 16;
+		if( format >= FORMAT_B8G8R8A8_UNORM && format <= FORMAT_B8G8R8X8_UNORM_SRGB && format != 89 ) return 32;
+		return 0;
+	}
+
+	bool Fail(std::string* error, const char* reason)
+	{
+		if( error )
+			*error = reason;
+		return false;
+	}
+
+	// The legacy DDS_PIXELFORMAT to a DXGI format, or 0 if it has no exact match.
+	UINT FormatFromPixelFormat(const unsigned char* pf)
+	{
+		UINT flags    = ReadUint(pf + 4);
+		UINT fourCC   = ReadUint(pf + 8);
+		UINT bitCount = ReadUint(pf + 12);
+		UINT rMask    = ReadUint(pf + 16);
+		UINT gMask    = ReadUint(pf + 20);
+		UINT bMask    = ReadUint(pf + 24);
+		UINT aMask    = ReadUint(pf + 28);
+
+		if( flags & DDPF_FOURCC )
+		{
+			if( fourCC == MakeFourCC('D','X','T','1') ) return FORMAT_BC1_UNORM;
+			if( fourCC == MakeFourCC('D','X','T','2') ) return FORMAT_BC2_UNORM;
+			if( fourCC == MakeFourCC('D','X','T','3') ) return FORMAT_BC2_UNORM;
+			if( fourCC == MakeFourCC('D','X','T','4') ) return FORMAT_BC3_UNORM;
+			if( fourCC == MakeFourCC('D','X','T','5') ) return FORMAT_BC3_UNORM;
+			if( fourCC == MakeFourCC('A','T','I','1') ) return FORMAT_BC4_UNORM;
+			if( fourCC == MakeFourCC('B','C','4','U') ) return FORMAT_BC4_UNORM;
+			if( fourCC == MakeFourCC('B','C','4','S') ) return FORMAT_BC4_SNORM;
+			if( fourCC == MakeFourCC('A','T','I','2') ) return FORMAT_BC5_UNORM;
+			if( fourCC == MakeFourCC('B','C','5','U') ) return FORMAT_BC5_UNORM;
+			if( fourCC == MakeFourCC('B','C','5','S') ) return FORMAT_BC5_SNORM;
+
+			// D3DFMT values stored as a FourCC.
+			if( fourCC == 36 ) return FORMAT_R16G16B16A16_UNORM;
+			if( fourCC == 111 ) return FORMAT_R16_FLOAT;
+			if( fourCC == 112 ) return FORMAT_R16G16_FLOAT;
+			if( fourCC == 113 ) return FORMAT_R16G16B16A16_FLOAT;
+			if( fourCC == 114 ) return FORMAT_R32_FLOAT;
+			if( fourCC == 115 ) return FORMAT_R32G32_FLOAT;
+			if( fourCC == 116 ) return FORMAT_R32G32B32A32_FLOAT;
+			return 0;
+		}
+
+		bool hasAlpha = (flags & DDPF_ALPHAPIXELS) != 0;
+
+		if( flags & DDPF_RGB )
+		{
+			if( bitCount == 32 )
+			{
+				if( rMask == 0x000000ff && gMask == 0x0000ff00 && bMask == 0x00ff0000 && hasAlpha && aMask == 0xff000000 )
+					return FORMAT_R8G8B8A8_UNORM;
+				if( rMask == 0x00ff0000 && gMask == 0x0000ff00 && bMask == 0x000000ff )
+					return hasAlpha && aMask == 0xff000000 ? FORMAT_B8G8R8A8_UNORM : FORMAT_B8G8R8X8_UNORM;
+				if( rMask == 0x3ff00000 && gMask == 0x000ffc00 && bMask == 0x000003ff && hasAlpha )
+					return 0; // A2R10G10B10 has no DXGI equivalent
+				if( rMask == 0x000003ff && gMask == 0x000ffc00 && bMask == 0x3ff00000 && hasAlpha )
+					return FORMAT_R10G10B10A2_UNORM;
+				if( rMask == 0x0000ffff && gMask == 0xffff0000 && bMask == 0 )
+					return FORMAT_R16G16_UNORM;
+				if( rMask == 0xffffffff && gMask == 0 && bMask == 0 )
+					return FORMAT_R32_FLOAT;
+			}
+			else if( bitCount == 16 )
+			{
+				if( rMask == 0xf800 && gMask == 0x07e0 && bMask == 0x001f )
+					return FORMAT_B5G6R5_UNORM;
+				if( rMask == 0x7c00 && gMask == 0x03e0 && bMask == 0x001f && hasAlpha && aMask == 0x8000 )
+					return FORMAT_B5G5R5A1_UNORM;
+			}
+			return 0;
+		}
+
+		if( flags & DDPF_LUMINANCE )
+		{
+			if( bitCount == 8 && rMask == 0xff )
+				return FORMAT_R8_UNORM;
+			if( bitCount == 16 && rMask == 0xffff )
+				return FORMAT_R16_UNORM;
+			if( bitCount == 16 && rMask == 0x00ff && hasAlpha && aMask == 0xff00 )
+				return FORMAT_R8G8_UNORM;
+			return 0;
+		}
+
+		if( hasAlpha && bitCount == 8 && aMask == 0xff )
+			return FORMAT_A8_UNORM;
+
+		return 0;
+	}
+}
+
+UINT64 DDSInfo::MipSize(UINT mip)const
+{
+	return (UINT64)Get(mip, 0).SlicePitch * ArraySize;
+}
+
+bool DDS::GetSurfaceInfo(UINT format, UINT width, UINT height, UINT& rowPitch, UINT& slicePitch)
+{
+	UINT blockSize = BlockSize(format);
+	if( blockSize > 0 )
+	{
+		UINT blocksWide = width > 0 ? (width + 3) / 4 : 0;
+		UINT blocksHigh = height > 0 ? (height + 3) / 4 : 0;
+		rowPitch   = blocksWide * blockSize;
+		slicePitch = rowPitch * blocksHigh;
+		return true;
+	}
+
+	UINT bpp = BitsPerPixel(format);
+	if( bpp == 0 )
+		return false;
+
+	rowPitch   = (width * bpp + 7) / 8;
+	slicePitch = rowPitch * height;
+	return true;
+}
+
+bool DDS::IsBlockCompressed(UINT format)
+{
+	return BlockSize(format) > 0;
+}
+
+bool DDS::CanGenerateMips(UINT format)
+{
+	return (format >= FORMAT_R8G8B8A8_TYPELESS && format <= FORMAT_R8G8B8A8_UNORM_SRGB) ||
+		(format >= FORMAT_B8G8R8A8_UNORM && format <= FORMAT_B8G8R8X8_UNORM) ||
+		(format >= FORMAT_B8G8R8A8_TYPELESS && format <= FORMAT_B8G8R8X8_UNORM_SRGB);
+}
+
+void DDS::GenerateMip(const void* src, UINT srcWidth, UINT srcHeight, UINT srcRowPitch,
+	void* dst, UINT dstRowPitch)
+{
+	UINT dstWidth  = srcWidth > 1 ? srcWidth/2 : 1;
+	UINT dstHeight = srcHeight > 1 ? srcHeight/2 : 1;
+
+	const unsigned char* in = static_cast<const unsigned char*>(src);
+	unsigned char* out = static_cast<unsigned char*>(dst);
+
+	for(UINT y = 0; y < dstHeight; ++y)
+	{
+		// Rows and columns of the source feeding this texel; the last one of an odd
+		// size takes three.
+		UINT y0 = std::min(2*y, srcHeight - 1);
+		UINT y1 = (y == dstHeight - 1) ? srcHeight - 1 : 2*y + 1;
+
+		for(UINT x = 0; x < dstWidth; ++x)
+		{
+			UINT x0 = std::min(2*x, srcWidth - 1);
+			UINT x1 = (x == dstWidth - 1) ? srcWidth - 1 : 2*x + 1;
+
+			for(UINT c = 0; c < 4; ++c)
+			{
+				UINT sum = 0;
+				UINT count = 0;
+				for(UINT sy = y0; sy <= y1; ++sy)
+				{
+					for(UINT sx = x0; sx <= x1; ++sx)
+					{
+						sum += in[sy*srcRowPitch + sx*4 + c];
+						++count;
+					}
+				}
+				out[y*dstRowPitch + x*4 + c] = (unsigned char)((sum + count/2) / count);
+			}
+		}
+	}
+}
+
+bool DDS::ParseHeader(const void* data, UINT size, UINT64 fileSize, DDSInfo& info, std::string* error)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+	if( size < 4 + 124 || ReadUint(bytes) != DDSMagic )
+		return Fail(error, "not a DDS file");
+
+	const unsigned char* header = bytes + 4;
+	if( ReadUint(header) != 124 || ReadUint(header + 72) != 32 )
+		return Fail(error, "bad DDS header size");
+
+	UINT flags     = ReadUint(header + 4);
+	UINT height    = ReadUint(header + 8);
+	UINT width     = ReadUint(header + 12);
+	UINT mipCount  = ReadUint(header + 24);
+	UINT caps2     = ReadUint(header + 108);
+	const unsigned char* pixelFormat = header + 72;
+
+	if( (flags & DDSD_DEPTH) || (caps2 & DDSCAPS2_VOLUME) )
+		return Fail(error, "volume textures are not handled");
+
+	UINT format = 0;
+	UINT arraySize = 1;
+	bool isCubeMap = false;
+	UINT dataOffset = 4 + 124;
+
+	if( (ReadUint(pixelFormat + 4) & DDPF_FOURCC) && ReadUint(pixelFormat + 8) == MakeFourCC('D','X','1','0') )
+	{
+		if( size < MaxHeaderSize )
+			return Fail(error, "truncated DX10 header");
+
+		const unsigned char* dx10 = header + 124;
+		format    = ReadUint(dx10);
+		UINT dim  = ReadUint(dx10 + 4);
+		UINT misc = ReadUint(dx10 + 8);
+		arraySize = ReadUint(dx10 + 12);
+		dataOffset = MaxHeaderSize;
+
+		if( dim != DDS_DIMENSION_TEXTURE2D )
+			return Fail(error, "only 2D textures are handled");
+		if( arraySize == 0 )
+			return Fail(error, "empty texture array");
+		if( misc & DDS_RESOURCE_MISC_CUBE )
+		{
+			isCubeMap = true;
+			arraySize *= 6;
+		}
+	}
+	else
+	{
+		format = FormatFromPixelFormat(pixelFormat);
+
+		if( caps2 & DDSCAPS2_CUBEMAP )
+		{
+			if( (caps2 & DDSCAPS2_CUBEMAP_ALL) != DDSCAPS2_CUBEMAP_ALL )
+				return Fail(error, "partial cube maps are not handled");
+			isCubeMap = true;
+			arraySize = 6;
+		}
+	}
+
+	UINT rowPitch = 0;
+	UINT slicePitch = 0;
+	if( format == 0 || !GetSurfaceInfo(format, 1, 1, rowPitch, slicePitch) )
+		return Fail(error, "pixel format has no direct DXGI equivalent");
+
+	if( width == 0 || height == 0 )
+		return Fail(error, "empty texture");
+
+	UINT fullChain = 1;
+	for(UINT w = width, h = height; w > 1 || h > 1; w = w > 1 ? w/2 : 1, h = h > 1 ? h/2 : 1)
+		++fullChain;
+
+	if( mipCount == 0 )
+		mipCount = 1;
+	if( mipCount > fullChain )
+		return Fail(error, "more mips than the size allows");
+
+	info.Width     = width;
+	info.Height    = height;
+	info.MipLevels = mipCount;
+	info.ArraySize = arraySize;
+	info.Format    = format;
+	info.IsCubeMap = isCubeMap;
+	info.FileSize  = fileSize;
+	info.Subresources.resize(mipCount * arraySize);
+
+	// Slices are stored one after another, each with its whole mip chain.
+	UINT64 offset = dataOffset;
+	for(UINT slice = 0; slice < arraySize; ++slice)
+	{
+		UINT w = width;
+		UINT h = height;
+		for(UINT mip = 0; mip < mipCount; ++mip)
+		{
+			DDSSubresource& sub = info.Subresources[mip + slice*mipCount];
+			GetSurfaceInfo(format, w, h, sub.RowPitch, sub.SlicePitch);
+			sub.Offset = offset;
+			sub.Width  = w;
+			sub.Height = h;
+
+			offset += sub.SlicePitch;
+			w = w > 1 ? w/2 : 1;
+			h = h > 1 ? h/2 : 1;
+		}
+	}
+
+	if( offset > fileSize )
+		return Fail(error, "file is shorter than its mips");
+
+	return true;
+}
@@ -0,0 +1,86 @@
+//***************************************************************************************
+// DDSTexture.h
+//
+// Parses the header of a DDS file and works out where each mip of each array slice
+// lives in the file.  Only layouts that can be copied straight into a texture are
+// accepted: block compressed and plain formats with a DXGI equivalent, 2D textures
+// and arrays (cube maps are arrays of six).  Anything else, such as 24-bit RGB or
+// volume textures, is left to D3DX.
+//
+// Nothing here needs Direct3D; formats are carried as DXGI_FORMAT values in a UINT.
+//***************************************************************************************
+
+#ifndef DDSTEXTURE_H
+#define DDSTEXTURE_H
+
+#include "XnaMathPortable.h"
+#include <string>
+#include <vector>
+
+struct DDSSubresource
+{
+	UINT64 Offset;		// from the start of the file
+	UINT Width;
+	UINT Height;
+	UINT RowPitch;		// bytes per row of pixels, or of 4x4 blocks
+	UINT SlicePitch;	// bytes of the whole mip
+};
+
+struct DDSInfo
+{
+	DDSInfo() : Width(0), Height(0), MipLevels(0), ArraySize(0), Format(0), IsCubeMap(false), FileSize(0) {}
+
+	UINT Width;
+	UINT Height;
+	UINT MipLevels;
+	UINT ArraySize;
+	UINT Format;		// DXGI_FORMAT
+	bool IsCubeMap;
+	UINT64 FileSize;
+
+	// Indexed like D3D11CalcSubresource: mip + slice*MipLevels.
+	std::vector<DDSSubresource> Subresources;
+
+	const DDSSubresource& Get(UINT mip, UINT slice)const { return Subresources[mip + slice*MipLevels]; }
+
+	// Bytes of one mip over every array slice.
+	UINT64 MipSize(UINT mip)const;
+};
+
+namespace DDS
+{
+	// Magic, DDS_HEADER and DDS_HEADER_DXT10: the most a header can take.
+	const UINT MaxHeaderSize = 4 + 124 + 20;
+
+	///<summary>
+	/// Fills info from the first bytes of a DDS file.  size is how many header bytes
+	/// are in data (at most MaxHeaderSize are looked at) and fileSize the size of the
+	/// whole file, used to check that every mip is present.  Returns false with a
+	/// reason in error for files this parser does not handle.
+	///</summary>
+	bool ParseHeader(const void* data, UINT size, UINT64 fileSize, DDSInfo& info, std::string* error = 0);
+
+	///<summary>
+	/// Bytes per row and per mip of a width x height mip of format, or false for a
+	/// format this parser does not know.
+	///</summary>
+	bool GetSurfaceInfo(UINT format, UINT width, UINT height, UINT& rowPitch, UINT& slicePitch);
+
+	// True for the BC formats, whose mip 0 must be a multiple of 4 texels wide and high.
+	bool IsBlockCompressed(UINT format);
+
+	///<summary>
+	/// True for the 8 bits per channel RGBA and BGRA formats, whose missing mips
+	/// GenerateMip can build on the CPU.
+	///</summary>
+	bool CanGenerateMips(UINT format);
+
+	///<summary>
+	/// Box filters a srcWidth x srcHeight mip into the next smaller one.  An odd
+	/// last row or column is folded into its neighbour.
+	///</summary>
+	void GenerateMip(const void* src, UINT srcWidth, UINT srcHeight, UINT srcRowPitch,
+		void* dst, UINT dstRowPitch);
+}
+
+#endif // DDSTEXTURE_H
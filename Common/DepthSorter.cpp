@@ -0,0 +1,395 @@
+//***************************************************************************************
+// DepthSorter.cpp
+//***************************************************************************************
+
+#include "DepthSorter.h"
+#include "MathHelper.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const UINT KeyBits    = 22;
+	const UINT DigitBits  = 11;
+	const UINT DigitCount = 1u << DigitBits;
+	const UINT MaxKey     = (1u << KeyBits) - 1;
+
+	// Below this many points the sort stays on the calling thread, and no block
+	// gets fewer than MinBlockPoints.
+	const UINT ParallelPointCount = 64*1024;
+	const UINT MinBlockPoints     = 16*1024;
+
+	// The old order is only repaired when at most one point in this many is out of
+	// place, and at most this many moves per point are spent on it.
+	const UINT MaxDescentFraction = 32;
+	const UINT MaxMovesPerPoint   = 2;
+
+	inline float Read(const float* p, UINT stride, UINT i)
+	{
+		return *reinterpret_cast<const float*>(reinterpret_cast<const char*>(p) + (size_t)stride*i);
+	}
+
+	inline UINT BlockBegin(UINT block, UINT blockCount, UINT count)
+	{
+		return (UINT)((UINT64)count*block/blockCount);
+	}
+
+	// The farthest point gets key 0, so ascending keys run back to front.
+	inline UINT Quantize(float depth, float maxDepth, float scale)
+	{
+		return MathHelper::Min((UINT)((maxDepth - depth)*scale), MaxKey);
+	}
+}
+
+DepthSorter::Points DepthSorter::Points::FromArrays(const float* x, const float* y, const float* z, UINT count)
+{
+	Points p;
+	p.X      = x;
+	p.Y      = y;
+	p.Z      = z;
+	p.Stride = sizeof(float);
+	p.Count  = count;
+	return p;
+}
+
+DepthSorter::Points DepthSorter::Points::FromStructs(const XMFLOAT3* first, UINT stride, UINT count)
+{
+	Points p;
+	p.X      = &first->x;
+	p.Y      = &first->y;
+	p.Z      = &first->z;
+	p.Stride = stride;
+	p.Count  = count;
+	return p;
+}
+
+DepthSorter::DepthSorter()
+: mThreadCount(0), mIncremental(true), mWasIncremental(false), mHasOrder(false), mCount(0)
+{
+}
+
+DepthSorter::~DepthSorter()
+{
+}
+
+void DepthSorter::SetThreadCount(UINT threadCount)
+{
+	mThreadCount = threadCount;
+}
+
+void DepthSorter::SetIncremental(bool incremental)
+{
+	mIncremental = incremental;
+}
+
+void DepthSorter::Sort(const Points& points, const XMFLOAT3& eyePos, const XMFLOAT3& look)
+{
+	PROFILE_FUNCTION();
+
+	bool reuse = mIncremental && mHasOrder && points.Count == mCount;
+
+	mCount = points.Count;
+	mDepths.resize(mCount);
+	mOrder.resize(mCount);
+
+	mHasOrder = true;
+	mWasIncremental = false;
+	if( mCount == 0 )
+		return;
+
+	// Depths, and their range over the frame.
+	UINT blocks = GetBlockCount();
+	UINT count  = mCount;
+	std::vector<float> minDepths(blocks);
+	std::vector<float> maxDepths(blocks);
+	float* depths   = &mDepths[0];
+	float* blockMin = &minDepths[0];
+	float* blockMax = &maxDepths[0];
+	Parallel::For(blocks, blocks, [=](UINT block)
+	{
+		float lo = +MathHelper::Infinity;
+		float hi = -MathHelper::Infinity;
+
+		UINT end = BlockBegin(block+1, blocks, count);
+		for(UINT i = BlockBegin(block, blocks, count); i < end; ++i)
+		{
+			float d = (Read(points.X, points.Stride, i) - eyePos.x)*look.x +
+			          (Read(points.Y, points.Stride, i) - eyePos.y)*look.y +
+			          (Read(points.Z, points.Stride, i) - eyePos.z)*look.z;
+			depths[i] = d;
+			lo = MathHelper::Min(lo, d);
+			hi = MathHelper::Max(hi, d);
+		}
+
+		blockMin[block] = lo;
+		blockMax[block] = hi;
+	});
+
+	float minDepth = minDepths[0];
+	float maxDepth = maxDepths[0];
+	for(UINT b = 1; b < blocks; ++b)
+	{
+		minDepth = MathHelper::Min(minDepth, minDepths[b]);
+		maxDepth = MathHelper::Max(maxDepth, maxDepths[b]);
+	}
+
+	// Both paths order by the quantized keys, so points closer than one key apart
+	// count as tied and do not break a reused order.
+	float scale = maxDepth > minDepth ? MaxKey/(maxDepth - minDepth) : 0.0f;
+
+	mWasIncremental = reuse && SortIncremental(maxDepth, scale);
+	if( !mWasIncremental )
+		SortRadix(maxDepth, scale);
+}
+
+const UINT* DepthSorter::GetOrder()const
+{
+	return mCount > 0 ? &mOrder[0] : 0;
+}
+
+UINT DepthSorter::GetCount()const
+{
+	return mCount;
+}
+
+bool DepthSorter::WasIncremental()const
+{
+	return mWasIncremental;
+}
+
+void DepthSorter::BinTiles(const Points& points, const XMFLOAT4X4& viewProj, UINT tilesX, UINT tilesY)
+{
+	PROFILE_FUNCTION();
+
+	UINT tiles = tilesX*tilesY;
+	mTileStarts.resize(tiles+2);
+	mTileOrder.resize(mCount);
+	mKeys.resize(mCount);
+	mKeysTemp.resize(mCount);
+
+	if( mCount == 0 )
+	{
+		std::fill(mTileStarts.begin(), mTileStarts.end(), 0);
+		return;
+	}
+
+	// Key each point by its tile, the culled ones by tiles.  Done in point order,
+	// so the positions are read front to back.
+	UINT blocks = GetBlockCount();
+	UINT count  = mCount;
+	UINT* tileKeys = &mKeys[0];
+	XMFLOAT4X4 m = viewProj;
+	Parallel::For(blocks, blocks, [=](UINT block)
+	{
+		UINT end = BlockBegin(block+1, blocks, count);
+		for(UINT i = BlockBegin(block, blocks, count); i < end; ++i)
+		{
+			float x = Read(points.X, points.Stride, i);
+			float y = Read(points.Y, points.Stride, i);
+			float z = Read(points.Z, points.Stride, i);
+
+			float cx = x*m._11 + y*m._21 + z*m._31 + m._41;
+			float cy = x*m._12 + y*m._22 + z*m._32 + m._42;
+			float cw = x*m._14 + y*m._24 + z*m._34 + m._44;
+
+			tileKeys[i] = tiles;
+			if( cw <= 0.0f || fabsf(cx) > cw || fabsf(cy) > cw )
+				continue;
+
+			float u = 0.5f + 0.5f*cx/cw;
+			float v = 0.5f - 0.5f*cy/cw;
+			UINT tx = MathHelper::Min((UINT)(u*tilesX), tilesX-1);
+			UINT ty = MathHelper::Min((UINT)(v*tilesY), tilesY-1);
+			tileKeys[i] = ty*tilesX + tx;
+		}
+	});
+
+	// The same keys in sorted order.
+	const UINT* order = &mOrder[0];
+	UINT* keys = &mKeysTemp[0];
+	Parallel::For(blocks, blocks, [=](UINT block)
+	{
+		UINT end = BlockBegin(block+1, blocks, count);
+		for(UINT k = BlockBegin(block, blocks, count); k < end; ++k)
+			keys[k] = tileKeys[order[k]];
+	});
+
+	// Stable, so back to front order carries over into each tile.
+	RadixPass(keys, order, 0, &mTileOrder[0], ~0u, tiles+1, &mTileStarts[0]);
+}
+
+const UINT* DepthSorter::GetTileOrder()const
+{
+	return mTileOrder.empty() ? 0 : &mTileOrder[0];
+}
+
+UINT DepthSorter::GetTileStart(UINT tile)const
+{
+	return mTileStarts[tile];
+}
+
+UINT DepthSorter::GetTileCount(UINT tile)const
+{
+	return mTileStarts[tile+1] - mTileStarts[tile];
+}
+
+UINT DepthSorter::GetTiledCount()const
+{
+	return mTileStarts.size() < 2 ? 0 : mTileStarts[mTileStarts.size()-2];
+}
+
+bool DepthSorter::SortIncremental(float maxDepth, float scale)
+{
+	mKeysTemp.resize(mCount);
+
+	// Keys in the old order, and the places where that order is broken.
+	UINT blocks = GetBlockCount();
+	UINT count  = mCount;
+	std::vector<UINT> descents(blocks);
+	const float* depths = &mDepths[0];
+	const UINT* order   = &mOrder[0];
+	UINT* sorted        = &mKeysTemp[0];
+	UINT* blockDescents = &descents[0];
+	Parallel::For(blocks, blocks, [=](UINT block)
+	{
+		UINT begin = BlockBegin(block, blocks, count);
+		UINT end   = BlockBegin(block+1, blocks, count);
+
+		UINT previous = begin > 0 ? Quantize(depths[order[begin-1]], maxDepth, scale) : 0;
+		UINT n = 0;
+		for(UINT k = begin; k < end; ++k)
+		{
+			UINT key = Quantize(depths[order[k]], maxDepth, scale);
+			sorted[k] = key;
+			n += key < previous ? 1 : 0;
+			previous = key;
+		}
+		blockDescents[block] = n;
+	});
+
+	UINT total = 0;
+	for(UINT b = 0; b < blocks; ++b)
+		total += descents[b];
+
+	if( total == 0 )
+		return true;
+	if( total > count/MaxDescentFraction )
+		return false;
+
+	UINT* orderOut = &mOrder[0];
+	UINT64 budget = (UINT64)count*MaxMovesPerPoint;
+	UINT64 moves  = 0;
+	for(UINT k = 1; k < count; ++k)
+	{
+		UINT key = sorted[k];
+		if( key >= sorted[k-1] )
+			continue;
+
+		UINT index = orderOut[k];
+		UINT j = k;
+		while( j > 0 && sorted[j-1] > key )
+		{
+			sorted[j]   = sorted[j-1];
+			orderOut[j] = orderOut[j-1];
+			--j;
+		}
+		sorted[j]   = key;
+		orderOut[j] = index;
+
+		moves += k - j;
+		if( moves > budget )
+			return false;
+	}
+
+	return true;
+}
+
+void DepthSorter::SortRadix(float maxDepth, float scale)
+{
+	UINT blocks = GetBlockCount();
+	UINT count  = mCount;
+
+	mKeys.resize(count);
+	mKeysTemp.resize(count);
+	mOrderTemp.resize(count);
+
+	const float* depths = &mDepths[0];
+	UINT* keys = &mKeys[0];
+	Parallel::For(blocks, blocks, [=](UINT block)
+	{
+		UINT end = BlockBegin(block+1, blocks, count);
+		for(UINT i = BlockBegin(block, blocks, count); i < end; ++i)
+			keys[i] = Quantize(depths[i], maxDepth, scale);
+	});
+
+	RadixPass(&mKeys[0], 0, &mKeysTemp[0], &mOrderTemp[0], 0, DigitCount, 0);
+	RadixPass(&mKeysTemp[0], &mOrderTemp[0], 0, &mOrder[0], DigitBits, DigitCount, 0);
+}
+
+void DepthSorter::RadixPass(const UINT* keysIn, const UINT* valuesIn, UINT* keysOut, UINT* valuesOut,
+							UINT shift, UINT bucketCount, UINT* bucketStarts)
+{
+	UINT blocks = GetBlockCount();
+	UINT count  = mCount;
+
+	mHistograms.assign((size_t)blocks*bucketCount, 0);
+	UINT* histograms = &mHistograms[0];
+
+	UINT mask = bucketCount-1;
+	Parallel::For(blocks, blocks, [=](UINT block)
+	{
+		UINT* histogram = histograms + (size_t)block*bucketCount;
+
+		UINT end = BlockBegin(block+1, blocks, count);
+		for(UINT i = BlockBegin(block, blocks, count); i < end; ++i)
+		{
+			UINT bucket = shift == ~0u ? keysIn[i] : (keysIn[i] >> shift) & mask;
+			++histogram[bucket];
+		}
+	});
+
+	// Bucket by bucket, block by block: where each block starts writing each bucket.
+	UINT offset = 0;
+	for(UINT d = 0; d < bucketCount; ++d)
+	{
+		if( bucketStarts )
+			bucketStarts[d] = offset;
+
+		for(UINT b = 0; b < blocks; ++b)
+		{
+			UINT n = histograms[(size_t)b*bucketCount + d];
+			histograms[(size_t)b*bucketCount + d] = offset;
+			offset += n;
+		}
+	}
+	if( bucketStarts )
+		bucketStarts[bucketCount] = offset;
+
+	Parallel::For(blocks, blocks, [=](UINT block)
+	{
+		UINT* offsets = histograms + (size_t)block*bucketCount;
+
+		UINT end = BlockBegin(block+1, blocks, count);
+		for(UINT i = BlockBegin(block, blocks, count); i < end; ++i)
+		{
+			UINT key = keysIn[i];
+			UINT bucket = shift == ~0u ? key : (key >> shift) & mask;
+			UINT pos = offsets[bucket]++;
+
+			if( keysOut )
+				keysOut[pos] = key;
+			valuesOut[pos] = valuesIn ? valuesIn[i] : i;
+		}
+	});
+}
+
+UINT DepthSorter::GetBlockCount()const
+{
+	UINT threads = mThreadCount;
+	if( threads == 0 )
+		threads = mCount >= ParallelPointCount ? Parallel::HardwareThreadCount() : 1;
+
+	return MathHelper::Max(1u, MathHelper::Min(threads, mCount/MinBlockPoints));
+}
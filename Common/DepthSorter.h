@@ -0,0 +1,122 @@
+//***************************************************************************************
+// DepthSorter.h
+//
+// Orders points (particles, billboard centers) back to front for alpha blending.
+//
+// Each point's view depth is quantized to a 22 bit key over the depth range of the
+// frame, and the keys are sorted by a stable LSD radix sort in two passes of 11 bits.
+// The passes work on fixed blocks of the points, one per thread: every block builds
+// its own histogram and scatters into its own slice of each bucket, so the result
+// does not depend on the thread count.
+//
+// Between frames the order barely changes.  When the point count is the same as in
+// the last sort, the old order is tried first: if it is still sorted it is kept, and
+// if it is out of order in only a few places it is repaired by insertion sort, which
+// gives up and falls back to the radix sort once it has moved too many points.
+//
+// BinTiles optionally splits a sorted order into screen tiles by the projected
+// center of each point, keeping back to front order within each tile and dropping
+// points outside the view.  Nothing here needs Direct3D.
+//***************************************************************************************
+
+#ifndef DEPTHSORTER_H
+#define DEPTHSORTER_H
+
+#include "XnaMathPortable.h"
+#include <vector>
+
+class DepthSorter
+{
+public:
+	// Where the positions are: x, y and z of point i are Stride*i bytes past X, Y
+	// and Z, so one type covers separate arrays and arrays of vertices.
+	struct Points
+	{
+		const float* X;
+		const float* Y;
+		const float* Z;
+		UINT Stride;
+		UINT Count;
+
+		static Points FromArrays(const float* x, const float* y, const float* z, UINT count);
+		static Points FromStructs(const XMFLOAT3* first, UINT stride, UINT count);
+	};
+
+	DepthSorter();
+	~DepthSorter();
+
+	///<summary>
+	/// threadCount 0 uses every hardware thread for large inputs; 1 keeps the sort
+	/// on the calling thread.
+	///</summary>
+	void SetThreadCount(UINT threadCount);
+
+	///<summary>
+	/// Turns the reuse of the last order on or off; on by default.
+	///</summary>
+	void SetIncremental(bool incremental);
+
+	///<summary>
+	/// Sorts points by decreasing depth along look (which need not be normalized)
+	/// as seen from eyePos.  Points at equal depth keep no particular order.
+	///</summary>
+	void Sort(const Points& points, const XMFLOAT3& eyePos, const XMFLOAT3& look);
+
+	// Point indices, farthest first.
+	const UINT* GetOrder()const;
+	UINT GetCount()const;
+
+	// Whether the last sort kept or repaired the order before it.
+	bool WasIncremental()const;
+
+	///<summary>
+	/// Bins the sorted points into tilesX x tilesY screen tiles by where viewProj
+	/// puts their centers; tile 0 is the top left one, rows first.  Points behind
+	/// the eye or off screen go in no tile.
+	///</summary>
+	void BinTiles(const Points& points, const XMFLOAT4X4& viewProj, UINT tilesX, UINT tilesY);
+
+	// Point indices tile by tile, farthest first within each tile.
+	const UINT* GetTileOrder()const;
+	UINT GetTileStart(UINT tile)const;
+	UINT GetTileCount(UINT tile)const;
+
+	// Points that landed in some tile.
+	UINT GetTiledCount()const;
+
+private:
+	DepthSorter(const DepthSorter& rhs);
+	DepthSorter& operator=(const DepthSorter& rhs);
+
+	bool SortIncremental(float maxDepth, float scale);
+	void SortRadix(float maxDepth, float scale);
+
+	// Stable counting sort by bucket = (key >> shift) & (bucketCount-1), or by key
+	// itself when shift is ~0u.  Fills bucketStarts with bucketCount+1 entries when
+	// given.
+	void RadixPass(const UINT* keysIn, const UINT* valuesIn, UINT* keysOut, UINT* valuesOut,
+		UINT shift, UINT bucketCount, UINT* bucketStarts);
+
+	UINT GetBlockCount()const;
+
+private:
+	UINT mThreadCount;
+	bool mIncremental;
+	bool mWasIncremental;
+	bool mHasOrder;
+	UINT mCount;
+
+	std::vector<float> mDepths;
+	std::vector<UINT> mKeys;
+	std::vector<UINT> mKeysTemp;
+	std::vector<UINT> mOrder;
+	std::vector<UINT> mOrderTemp;
+
+	// Per block histograms, then per block offsets.
+	std::vector<UINT> mHistograms;
+
+	std::vector<UINT> mTileOrder;
+	std::vector<UINT> mTileStarts;
+};
+
+#endif // DEPTHSORTER_H
@@ -0,0 +1,180 @@
+//***************************************************************************************
+// FrameResourceRing.cpp
+//***************************************************************************************
+
+#include "FrameResourceRing.h"
+#include "Profiler.h"
+#include <cassert>
+#include <cstring>
+
+FrameResourceRing::FrameResourceRing(UINT frameCount, UINT transientByteSize)
+: mFrameCount(MathHelper::Clamp(frameCount, 1u, (UINT)MaxFrameCount)), mCurrentFrame(0), mStarted(false),
+  mPersistentByteSize(0), mTransientByteSize(AlignConstantSize(transientByteSize)), mTransientUsed(0),
+  mLastMapCount(0), mLastUploadByteCount(0), mLastCommitCount(0)
+{
+}
+
+FrameResourceRing::~FrameResourceRing()
+{
+}
+
+UINT FrameResourceRing::FrameCount()const
+{
+	return mFrameCount;
+}
+
+UINT FrameResourceRing::CurrentFrame()const
+{
+	return mCurrentFrame;
+}
+
+UINT FrameResourceRing::FrameByteSize()const
+{
+	return mPersistentByteSize + mTransientByteSize;
+}
+
+UINT FrameResourceRing::AlignConstantSize(UINT byteSize)
+{
+	return (byteSize + ConstantAlignment - 1) & ~(ConstantAlignment - 1);
+}
+
+BYTE* FrameResourceRing::FrameSlice(UINT frame)
+{
+	return &mArena[frame*FrameByteSize()];
+}
+
+UINT FrameResourceRing::AddPersistent(UINT byteSize)
+{
+	assert(!mStarted && "persistent elements must be added before the first frame");
+
+	PersistentElement e;
+	e.Range = Allocation(mPersistentByteSize, byteSize);
+	e.PendingFrames = 0;
+
+	mPersistentByteSize += AlignConstantSize(byteSize);
+	mPersistentData.resize(mPersistentByteSize, 0);
+
+	mPersistent.push_back(e);
+	return (UINT)mPersistent.size() - 1;
+}
+
+void FrameResourceRing::WritePersistent(UINT handle, const void* data, UINT byteSize)
+{
+	PersistentElement& e = mPersistent[handle];
+	memcpy(&mPersistentData[e.Range.Offset], data, MathHelper::Min(byteSize, e.Range.ByteSize));
+
+	e.PendingFrames = mFrameCount == 32 ? ~0u : (1u << mFrameCount) - 1;
+}
+
+FrameResourceRing::Allocation FrameResourceRing::GetPersistent(UINT handle)const
+{
+	return mPersistent[handle].Range;
+}
+
+void FrameResourceRing::BeginFrame()
+{
+	if( !mStarted )
+	{
+		mArena.assign(mFrameCount*FrameByteSize(), 0);
+		mCurrentFrame = 0;
+		mStarted = true;
+	}
+	else
+	{
+		mCurrentFrame = (mCurrentFrame + 1) % mFrameCount;
+	}
+
+	mTransientUsed = 0;
+	mTransientAllocations.clear();
+}
+
+FrameResourceRing::Allocation FrameResourceRing::AllocateTransient(UINT byteSize)
+{
+	assert(mStarted && "BeginFrame must be called before allocating");
+
+	UINT alignedSize = AlignConstantSize(byteSize);
+	if( mTransientUsed + alignedSize > mTransientByteSize )
+		return Allocation();
+
+	Allocation a(mPersistentByteSize + mTransientUsed, byteSize);
+	mTransientUsed += alignedSize;
+
+	mTransientAllocations.push_back(a);
+	return a;
+}
+
+void* FrameResourceRing::TransientData(const Allocation& allocation)
+{
+	return FrameSlice(mCurrentFrame) + allocation.Offset;
+}
+
+void FrameResourceRing::Upload(UploadContext& context)
+{
+	PROFILE_FUNCTION();
+
+	mLastMapCount = 0;
+	mLastUploadByteCount = 0;
+	mLastCommitCount = 0;
+
+	if( !mStarted )
+		return;
+
+	BYTE* slice = FrameSlice(mCurrentFrame);
+	UINT frameBit = 1u << mCurrentFrame;
+
+	// Bring the persistent elements written since this frame was last uploaded
+	// up to date.
+	mCommits.clear();
+	for(size_t i = 0; i < mPersistent.size(); ++i)
+	{
+		PersistentElement& e = mPersistent[i];
+		if( (e.PendingFrames & frameBit) == 0 )
+			continue;
+
+		memcpy(slice + e.Range.Offset, &mPersistentData[e.Range.Offset], e.Range.ByteSize);
+		e.PendingFrames &= ~frameBit;
+		mCommits.push_back(e.Range);
+	}
+	mCommits.insert(mCommits.end(), mTransientAllocations.begin(), mTransientAllocations.end());
+
+	// The map may discard the previous contents, so the whole used part of the
+	// slice goes up in one copy.
+	UINT usedByteSize = mPersistentByteSize + mTransientUsed;
+	void* mapped = context.MapFrame(mCurrentFrame, FrameByteSize());
+	if( !mapped )
+		return;
+
+	memcpy(mapped, slice, usedByteSize);
+	context.UnmapFrame(mCurrentFrame);
+
+	mLastMapCount = 1;
+	mLastUploadByteCount = usedByteSize;
+
+	if( !context.SupportsRangeBinding() )
+	{
+		for(size_t i = 0; i < mCommits.size(); ++i)
+			context.CommitRange(mCurrentFrame, mCommits[i].Offset, mCommits[i].ByteSize);
+
+		mLastCommitCount = (UINT)mCommits.size();
+	}
+}
+
+void FrameResourceRing::Bind(UploadContext& context, UINT slot, const Allocation& allocation)const
+{
+	context.Bind(slot, mCurrentFrame, allocation.Offset, allocation.ByteSize);
+}
+
+UINT FrameResourceRing::LastMapCount()const
+{
+	return mLastMapCount;
+}
+
+UINT FrameResourceRing::LastUploadByteCount()const
+{
+	return mLastUploadByteCount;
+}
+
+UINT FrameResourceRing::LastCommitCount()const
+{
+	return mLastCommitCount;
+}
@@ -0,0 +1,171 @@
+//***************************************************************************************
+// FrameResourceRing.h
+//
+// N-buffered storage for per frame constant data.  Every frame owns one slice of a
+// single staging arena; the slice starts with the persistent elements (object and
+// material constants, kept at fixed offsets and rewritten only when dirty)
+// followed by transient data that is suballocated linearly each frame (pass
+// constants).  Offsets are aligned to 256 bytes, the granularity at which a range
+// of a constant buffer can be bound.
+//
+// The ring talks to the GPU through UploadContext, so it can be driven by a mock
+// in tests.  Every context receives each frame's slice with a single map of that
+// frame's buffer.  A context that can bind buffer ranges binds straight out of it;
+// otherwise the ring commits the ranges that changed, and the context copies each
+// of them on the GPU into a constant buffer of its own for the offset.
+//***************************************************************************************
+
+#ifndef FRAMERESOURCERING_H
+#define FRAMERESOURCERING_H
+
+#include "MathHelper.h"
+#include <cstring>
+#include <vector>
+
+class FrameResourceRing
+{
+public:
+	static const UINT ConstantAlignment = 256;
+	static const UINT MaxFrameCount = 32;
+
+	struct Allocation
+	{
+		Allocation() : Offset(0), ByteSize(0) {}
+		Allocation(UINT offset, UINT byteSize) : Offset(offset), ByteSize(byteSize) {}
+
+		// From the start of a frame slice.
+		UINT Offset;
+		UINT ByteSize;
+	};
+
+	class UploadContext
+	{
+	public:
+		virtual ~UploadContext() {}
+
+		///<summary>
+		/// True if the context can bind a range of a buffer (VSSetConstantBuffers1).
+		/// Otherwise the ring calls CommitRange for each range that changed after
+		/// unmapping the frame.
+		///</summary>
+		virtual bool SupportsRangeBinding()const = 0;
+
+		// Maps the buffer of the frame for writing frameByteSize bytes.
+		virtual void* MapFrame(UINT frame, UINT frameByteSize) = 0;
+		virtual void UnmapFrame(UINT frame) = 0;
+
+		// Makes the range [offset, offset + byteSize) of the frame's buffer, as
+		// last unmapped, what Bind binds for offset.
+		virtual void CommitRange(UINT frame, UINT offset, UINT byteSize) = 0;
+
+		// Binds the range to constant buffer slot of the stages the context draws with.
+		virtual void Bind(UINT slot, UINT frame, UINT offset, UINT byteSize) = 0;
+	};
+
+	FrameResourceRing(UINT frameCount, UINT transientByteSize);
+	~FrameResourceRing();
+
+	UINT FrameCount()const;
+	UINT CurrentFrame()const;
+
+	// Bytes of one frame slice; fixed once the first frame begins.
+	UINT FrameByteSize()const;
+
+	///<summary>
+	/// Reserves an element of byteSize bytes at the same offset in every frame.
+	/// Must be called before the first BeginFrame.  Returns its handle.
+	///</summary>
+	UINT AddPersistent(UINT byteSize);
+
+	///<summary>
+	/// Stores new contents for a persistent element.  Each frame slice picks it up
+	/// the next time that frame is uploaded; call only for dirty elements.
+	///</summary>
+	void WritePersistent(UINT handle, const void* data, UINT byteSize);
+
+	template<typename T>
+	void WritePersistent(UINT handle, const T& data)
+	{
+		WritePersistent(handle, &data, sizeof(T));
+	}
+
+	Allocation GetPersistent(UINT handle)const;
+
+	///<summary>
+	/// Moves to the next frame of the ring and frees its transient data.
+	///</summary>
+	void BeginFrame();
+
+	///<summary>
+	/// Suballocates transient data in the current frame; the returned allocation
+	/// has ByteSize 0 if the transient space is used up.
+	///</summary>
+	Allocation AllocateTransient(UINT byteSize);
+	void* TransientData(const Allocation& allocation);
+
+	template<typename T>
+	Allocation PushTransient(const T& data)
+	{
+		Allocation a = AllocateTransient(sizeof(T));
+		if( a.ByteSize > 0 )
+			memcpy(TransientData(a), &data, sizeof(T));
+		return a;
+	}
+
+	///<summary>
+	/// Sends the current frame to the GPU.
+	///</summary>
+	void Upload(UploadContext& context);
+
+	void Bind(UploadContext& context, UINT slot, const Allocation& allocation)const;
+
+	// Statistics of the last Upload.
+	UINT LastMapCount()const;
+	UINT LastUploadByteCount()const;
+	UINT LastCommitCount()const;
+
+	static UINT AlignConstantSize(UINT byteSize);
+
+private:
+	FrameResourceRing(const FrameResourceRing& rhs);
+	FrameResourceRing& operator=(const FrameResourceRing& rhs);
+
+	BYTE* FrameSlice(UINT frame);
+
+	struct PersistentElement
+	{
+		Allocation Range;
+
+		// Bit f is set while frame f has not received the latest contents.
+		UINT PendingFrames;
+	};
+
+private:
+	UINT mFrameCount;
+	UINT mCurrentFrame;
+	bool mStarted;
+
+	UINT mPersistentByteSize;
+	UINT mTransientByteSize;
+	UINT mTransientUsed;
+
+	std::vector<PersistentElement> mPersistent;
+
+	// Latest contents of the persistent elements.
+	std::vector<BYTE> mPersistentData;
+
+	// mFrameCount slices of FrameByteSize() bytes.
+	std::vector<BYTE> mArena;
+
+	// Transient allocations of the current frame, for range commits.
+	std::vector<Allocation> mTransientAllocations;
+
+	// Ranges that changed in the frame being uploaded.
+	std::vector<Allocation> mCommits;
+
+	UINT mLastMapCount;
+	UINT mLastUploadByteCount;
+	UINT mLastCommitCount;
+};
+
+#endif // FRAMERESOURCERING_H
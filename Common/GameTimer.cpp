@@ -2,16 +2,40 @@
 // GameTimer.cpp by Frank Luna (C) 2011 All Rights Reserved.
 //***************************************************************************************
 
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <chrono>
+#endif
 #include "GameTimer.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 
 GameTimer::GameTimer()
 : mSecondsPerCount(0.0), mDeltaTime(-1.0), mBaseTime(0), 
-  mPausedTime(0), mPrevTime(0), mCurrTime(0), mStopped(false)
+  mPausedTime(0), mPrevTime(0), mCurrTime(0), mStopped(false),
+  mFrameTimes(1024, 0.0f), mFrameTimeNext(0), mFrameTimeCount(0), mStutterBudget(1.0f/30.0f)
 {
+#ifdef _WIN32
 	__int64 countsPerSec;
 	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
 	mSecondsPerCount = 1.0 / (double)countsPerSec;
+#else
+	mSecondsPerCount = 1.0e-9;
+#endif
+}
+
+__int64 GameTimer::QueryCounter()
+{
+#ifdef _WIN32
+	__int64 count;
+	QueryPerformanceCounter((LARGE_INTEGER*)&count);
+	return count;
+#else
+	return (__int64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
 }
 
 // Returns the total time elapsed since Reset() was called, NOT counting any
@@ -55,8 +79,7 @@ float GameTimer::DeltaTime()const
 
 void GameTimer::Reset()
 {
-	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+	__int64 currTime = QueryCounter();
 
 	mBaseTime = currTime;
 	mPrevTime = currTime;
@@ -66,8 +89,7 @@ void GameTimer::Reset()
 
 void GameTimer::Start()
 {
-	__int64 startTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&startTime);
+	__int64 startTime = QueryCounter();
 
 
 	// Accumulate the time elapsed between stop and start pairs.
@@ -90,8 +112,7 @@ void GameTimer::Stop()
 {
 	if( !mStopped )
 	{
-		__int64 currTime;
-		QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+		__int64 currTime = QueryCounter();
 
 		mStopTime = currTime;
 		mStopped  = true;
@@ -106,8 +127,7 @@ void GameTimer::Tick()
 		return;
 	}
 
-	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+	__int64 currTime = QueryCounter();
 	mCurrTime = currTime;
 
 	// Time difference between this frame and the previous.
@@ -123,5 +143,114 @@ void GameTimer::Tick()
 	{
 		mDeltaTime = 0.0;
 	}
+
+	mFrameTimes[mFrameTimeNext] = (float)mDeltaTime;
+	mFrameTimeNext = (mFrameTimeNext + 1) % (int)mFrameTimes.size();
+	mFrameTimeCount = std::min(mFrameTimeCount + 1, (int)mFrameTimes.size());
+}
+
+void GameTimer::SetFrameHistorySize(int frameCount)
+{
+	mFrameTimes.assign(std::max(frameCount, 1), 0.0f);
+	ClearFrameHistory();
+}
+
+void GameTimer::ClearFrameHistory()
+{
+	mFrameTimeNext  = 0;
+	mFrameTimeCount = 0;
+}
+
+void GameTimer::SetStutterBudget(float seconds)
+{
+	mStutterBudget = seconds;
+}
+
+float GameTimer::StutterBudget()const
+{
+	return mStutterBudget;
+}
+
+bool GameTimer::FrameStuttered()const
+{
+	return !mStopped && mDeltaTime > mStutterBudget;
+}
+
+void GameTimer::GetFrameTimes(std::vector<float>& frameTimes)const
+{
+	int size  = (int)mFrameTimes.size();
+	int first = (mFrameTimeNext - mFrameTimeCount + size) % size;
+
+	frameTimes.resize(mFrameTimeCount);
+	for(int i = 0; i < mFrameTimeCount; ++i)
+		frameTimes[i] = mFrameTimes[(first + i) % size];
+}
+
+GameTimer::FrameTimeStats GameTimer::GetFrameTimeStats()const
+{
+	FrameTimeStats stats = { 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0 };
+
+	std::vector<float> frameTimes;
+	GetFrameTimes(frameTimes);
+	if( frameTimes.empty() )
+		return stats;
+
+	double sum = 0.0;
+	for(size_t i = 0; i < frameTimes.size(); ++i)
+	{
+		sum += frameTimes[i];
+		if( frameTimes[i] > mStutterBudget )
+			++stats.StutterCount;
+	}
+
+	std::sort(frameTimes.begin(), frameTimes.end());
+
+	// Nearest rank: the smallest frame time at least p of the frames do not exceed.
+	int n = (int)frameTimes.size();
+	auto percentile = [&](float p)
+	{
+		int rank = (int)ceil(p*n);
+		return 1000.0f*frameTimes[std::min(std::max(rank, 1), n) - 1];
+	};
+
+	stats.FrameCount = n;
+	stats.MeanMs = (float)(1000.0*sum/n);
+	stats.P50Ms  = percentile(0.50f);
+	stats.P95Ms  = percentile(0.95f);
+	stats.P99Ms  = percentile(0.99f);
+	stats.MaxMs  = 1000.0f*frameTimes.back();
+
+	return stats;
+}
+
+std::vector<int> GameTimer::BuildFrameTimeHistogram(float bucketMs, int bucketCount)const
+{
+	std::vector<int> counts(std::max(bucketCount, 1), 0);
+
+	std::vector<float> frameTimes;
+	GetFrameTimes(frameTimes);
+	for(size_t i = 0; i < frameTimes.size(); ++i)
+	{
+		int bucket = (int)(1000.0f*frameTimes[i]/bucketMs);
+		++counts[std::min(bucket, (int)counts.size() - 1)];
+	}
+
+	return counts;
+}
+
+bool GameTimer::WriteFrameTimesCsv(const std::string& filename)const
+{
+	std::ofstream fout(filename.c_str());
+	if( !fout )
+		return false;
+
+	std::vector<float> frameTimes;
+	GetFrameTimes(frameTimes);
+
+	fout << "frame,ms,stutter\n";
+	for(size_t i = 0; i < frameTimes.size(); ++i)
+		fout << i << "," << 1000.0f*frameTimes[i] << "," << (frameTimes[i] > mStutterBudget ? 1 : 0) << "\n";
+
+	return (bool)fout;
 }
 
@@ -5,9 +5,31 @@
 #ifndef GAMETIMER_H
 #define GAMETIMER_H
 
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <cstdint>
+typedef int64_t __int64;
+#endif
+
 class GameTimer
 {
 public:
+	// Frame time percentiles over the recorded history, in milliseconds.
+	struct FrameTimeStats
+	{
+		int FrameCount;
+		float MeanMs;
+		float P50Ms;
+		float P95Ms;
+		float P99Ms;
+		float MaxMs;
+
+		// Frames of the history that went over the stutter budget.
+		int StutterCount;
+	};
+
 	GameTimer();
 
 	float TotalTime()const;  // in seconds
@@ -18,6 +40,31 @@ public:
 	void Stop();  // Call when paused.
 	void Tick();  // Call every frame.
 
+	// Every Tick that is not paused records the frame time in a ring of the last
+	// frameCount frames (1024 by default).  Resizing clears the history.
+	void SetFrameHistorySize(int frameCount);
+	void ClearFrameHistory();
+
+	// A frame longer than the budget (in seconds, 1/30 by default) is a stutter.
+	void SetStutterBudget(float seconds);
+	float StutterBudget()const;
+	bool FrameStuttered()const; // true if the last frame went over the budget
+
+	FrameTimeStats GetFrameTimeStats()const;
+
+	// Counts of recorded frames per bucketMs wide bucket; the last bucket also
+	// holds every longer frame.
+	std::vector<int> BuildFrameTimeHistogram(float bucketMs, int bucketCount)const;
+
+	// Writes the history, oldest frame first, as "frame,ms,stutter" rows.
+	bool WriteFrameTimesCsv(const std::string& filename)const;
+
+private:
+	static __int64 QueryCounter();
+
+	// The frame times of the history, oldest first, in seconds.
+	void GetFrameTimes(std::vector<float>& frameTimes)const;
+
 private:
 	double mSecondsPerCount;
 	double mDeltaTime;
@@ -29,6 +76,11 @@ private:
 	__int64 mCurrTime;
 
 	bool mStopped;
+
+	std::vector<float> mFrameTimes;
+	int mFrameTimeNext;
+	int mFrameTimeCount;
+	float mStutterBudget;
 };
 
 #endif // GAMETIMER_H
\ No newline at end of file
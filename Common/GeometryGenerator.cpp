@@ -4,6 +4,8 @@
 
 #include "GeometryGenerator.h"
 #include "MathHelper.h"
+#include "Profiler.h"
+#include "ParallelFor.h"
 
 void GeometryGenerator::CreateBox(float width, float height, float depth, MeshData& meshData)
 {
@@ -90,8 +92,16 @@ void GeometryGenerator::CreateBox(float width, float height, float depth, MeshDa
 
 void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData)
 {
-	meshData.Vertices.clear();
-	meshData.Indices.clear();
+	MeshSize size = GetSphereSize(sliceCount, stackCount);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices.resize(size.IndexCount);
+
+	CreateSphere(radius, sliceCount, stackCount, &meshData.Vertices[0], &meshData.Indices[0]);
+}
+
+void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, Vertex* vertices, UINT* indices)
+{
+	PROFILE_FUNCTION();
 
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
@@ -103,58 +113,58 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	meshData.Vertices.push_back( topVertex );
+	UINT ringVertexCount = sliceCount+1;
+	UINT southPoleIndex  = GetSphereSize(sliceCount, stackCount).VertexCount-1;
 
-	float phiStep   = XM_PI/stackCount;
-	float thetaStep = 2.0f*XM_PI/sliceCount;
+	vertices[0] = topVertex;
+	vertices[southPoleIndex] = bottomVertex;
+
+	float phiStep = XM_PI/stackCount;
+
+	std::vector<XMFLOAT2> ring;
+	BuildRing(sliceCount, ring);
+	const XMFLOAT2* cosSin = &ring[0];
 
 	// Compute vertices for each stack ring (do not count the poles as rings).
-	for(UINT i = 1; i <= stackCount-1; ++i)
+	UINT threadCount = GetThreadCount(southPoleIndex+1);
+	Parallel::For(stackCount-1, threadCount, [=](UINT ringIndex)
 	{
+		UINT i = ringIndex+1;
 		float phi = i*phiStep;
+		float sinPhi = sinf(phi);
+		float cosPhi = cosf(phi);
+
+		Vertex* v = &vertices[1 + ringIndex*ringVertexCount];
 
 		// Vertices of ring.
-		for(UINT j = 0; j <= sliceCount; ++j)
+		for(UINT j = 0; j <= sliceCount; ++j, ++v)
 		{
-			float theta = j*thetaStep;
-
-			Vertex v;
+			float c = cosSin[j].x;
+			float s = cosSin[j].y;
 
 			// spherical to cartesian
-			v.Position.x = radius*sinf(phi)*cosf(theta);
-			v.Position.y = radius*cosf(phi);
-			v.Position.z = radius*sinf(phi)*sinf(theta);
-
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
-
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+			v->Normal   = XMFLOAT3(sinPhi*c, cosPhi, sinPhi*s);
+			v->Position = XMFLOAT3(radius*v->Normal.x, radius*v->Normal.y, radius*v->Normal.z);
 
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+			// Partial derivative of P with respect to theta, normalized.
+			v->TangentU = XMFLOAT3(-s, 0.0f, c);
 
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
-
-			meshData.Vertices.push_back( v );
+			v->TexC.x = (float)j/sliceCount;
+			v->TexC.y = phi / XM_PI;
 		}
-	}
-
-	meshData.Vertices.push_back( bottomVertex );
+	});
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
 	// and connects the top pole to the first ring.
 	//
 
-	for(UINT i = 1; i <= sliceCount; ++i)
+	UINT* k = indices;
+	for(UINT i = 1; i <= sliceCount; ++i, k += 3)
 	{
-		meshData.Indices.push_back(0);
-		meshData.Indices.push_back(i+1);
-		meshData.Indices.push_back(i);
+		k[0] = 0;
+		k[1] = i+1;
+		k[2] = i;
 	}
 	
 	//
@@ -164,49 +174,106 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 	// Offset the indices to the index of the first vertex in the first ring.
 	// This is just skipping the top pole vertex.
 	UINT baseIndex = 1;
-	UINT ringVertexCount = sliceCount+1;
-	for(UINT i = 0; i < stackCount-2; ++i)
+	UINT* innerIndices = k;
+	Parallel::For(stackCount-2, threadCount, [=](UINT i)
 	{
-		for(UINT j = 0; j < sliceCount; ++j)
+		UINT* quad = innerIndices + i*sliceCount*6;
+		for(UINT j = 0; j < sliceCount; ++j, quad += 6)
 		{
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices.push_back(baseIndex + (i+1)*ringVertexCount + j);
+			quad[0] = baseIndex + i*ringVertexCount + j;
+			quad[1] = baseIndex + i*ringVertexCount + j+1;
+			quad[2] = baseIndex + (i+1)*ringVertexCount + j;
 
-			meshData.Indices.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
+			quad[3] = baseIndex + (i+1)*ringVertexCount + j;
+			quad[4] = baseIndex + i*ringVertexCount + j+1;
+			quad[5] = baseIndex + (i+1)*ringVertexCount + j+1;
 		}
-	}
+	});
+	k += (stackCount-2)*sliceCount*6;
 
 	//
 	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
 	// and connects the bottom pole to the bottom ring.
 	//
 
-	// South pole vertex was added last.
-	UINT southPoleIndex = (UINT)meshData.Vertices.size()-1;
-
 	// Offset the indices to the index of the first vertex in the last ring.
 	baseIndex = southPoleIndex - ringVertexCount;
 	
-	for(UINT i = 0; i < sliceCount; ++i)
+	for(UINT i = 0; i < sliceCount; ++i, k += 3)
 	{
-		meshData.Indices.push_back(southPoleIndex);
-		meshData.Indices.push_back(baseIndex+i);
-		meshData.Indices.push_back(baseIndex+i+1);
+		k[0] = southPoleIndex;
+		k[1] = baseIndex+i;
+		k[2] = baseIndex+i+1;
 	}
 }
  
-void GeometryGenerator::Subdivide(MeshData& meshData)
+namespace
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
+	//
+	// Maps an edge, given by its two end vertices in either order, to the vertex at
+	// its midpoint.  Open addressing with linear probing over a power of two table.
+	//
+	class EdgeMidpointCache
+	{
+	public:
+		explicit EdgeMidpointCache(size_t maxEdges)
+		{
+			// At least twice the edges of a closed mesh, and never full for any mesh.
+			size_t tableSize = 1;
+			mShift = 64;
+			while( tableSize < 2*maxEdges )
+			{
+				tableSize <<= 1;
+				--mShift;
+			}
+
+			mKeys.assign(tableSize, 0);
+			mMidpoints.resize(tableSize);
+			mMask = tableSize - 1;
+		}
 
+		UINT GetMidpoint(UINT a, UINT b, std::vector<GeometryGenerator::Vertex>& vertices)
+		{
+			// a != b, so no key is 0, which marks an empty slot.
+			UINT64 key = a < b ? ((UINT64)a << 32) | b : ((UINT64)b << 32) | a;
+
+			size_t slot = mShift < 64 ? (size_t)((key*0x9E3779B97F4A7C15ull) >> mShift) : 0;
+			while( mKeys[slot] != 0 )
+			{
+				if( mKeys[slot] == key )
+					return mMidpoints[slot];
+				slot = (slot + 1) & mMask;
+			}
+
+			// For subdivision, we just care about the position component.  We derive the other
+			// vertex components in CreateGeosphere.
+			const XMFLOAT3& p0 = vertices[a].Position;
+			const XMFLOAT3& p1 = vertices[b].Position;
+
+			GeometryGenerator::Vertex m;
+			m.Position = XMFLOAT3(
+				0.5f*(p0.x + p1.x),
+				0.5f*(p0.y + p1.y),
+				0.5f*(p0.z + p1.z));
+
+			UINT index = (UINT)vertices.size();
+			vertices.push_back(m);
+
+			mKeys[slot] = key;
+			mMidpoints[slot] = index;
+			return index;
+		}
 
-	meshData.Vertices.resize(0);
-	meshData.Indices.resize(0);
+	private:
+		std::vector<UINT64> mKeys;
+		std::vector<UINT> mMidpoints;
+		size_t mMask;
+		UINT mShift;
+	};
+}
 
+void GeometryGenerator::Subdivide(MeshData& meshData)
+{
 	//       v1
 	//       *
 	//      / \
@@ -216,71 +283,60 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	//  /   \ /   \
 	// *-----*-----*
 	// v0    m2     v2
+	//
+	// Each edge's midpoint is made once and shared by the triangles on both sides, so
+	// the result stays watertight: a closed mesh of V vertices and F triangles becomes
+	// V + 3F/2 vertices and 4F triangles.
+	//
+	// The index buffer is rewritten in place, last triangle first: triangle i's four
+	// children go to triangles 4i..4i+3, which only overwrites input already consumed.
 
-	UINT numTris = inputCopy.Indices.size()/3;
-	for(UINT i = 0; i < numTris; ++i)
+	size_t numTris = meshData.Indices.size()/3;
+	size_t numEdges = numTris*3/2;
+
+	meshData.Vertices.reserve(meshData.Vertices.size() + numEdges);
+	meshData.Indices.resize(numTris*12);
+
+	EdgeMidpointCache midpoints(numEdges);
+
+	UINT* indices = &meshData.Indices[0];
+	for(size_t i = numTris; i-- > 0; )
 	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices[i*3+2] ];
-
-		//
-		// Generate the midpoints.
-		//
-
-		Vertex m0, m1, m2;
-
-		// For subdivision, we just care about the position component.  We derive the other
-		// vertex components in CreateGeosphere.
-
-		m0.Position = XMFLOAT3(
-			0.5f*(v0.Position.x + v1.Position.x),
-			0.5f*(v0.Position.y + v1.Position.y),
-			0.5f*(v0.Position.z + v1.Position.z));
-
-		m1.Position = XMFLOAT3(
-			0.5f*(v1.Position.x + v2.Position.x),
-			0.5f*(v1.Position.y + v2.Position.y),
-			0.5f*(v1.Position.z + v2.Position.z));
-
-		m2.Position = XMFLOAT3(
-			0.5f*(v0.Position.x + v2.Position.x),
-			0.5f*(v0.Position.y + v2.Position.y),
-			0.5f*(v0.Position.z + v2.Position.z));
-
-		//
-		// Add new geometry.
-		//
-
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices.push_back(i*6+0);
-		meshData.Indices.push_back(i*6+3);
-		meshData.Indices.push_back(i*6+5);
+		UINT v0 = indices[i*3+0];
+		UINT v1 = indices[i*3+1];
+		UINT v2 = indices[i*3+2];
+
+		UINT m0 = midpoints.GetMidpoint(v0, v1, meshData.Vertices);
+		UINT m1 = midpoints.GetMidpoint(v1, v2, meshData.Vertices);
+		UINT m2 = midpoints.GetMidpoint(v0, v2, meshData.Vertices);
+
+		UINT* tri = &indices[i*12];
 
-		meshData.Indices.push_back(i*6+3);
-		meshData.Indices.push_back(i*6+4);
-		meshData.Indices.push_back(i*6+5);
+		tri[0]  = v0;
+		tri[1]  = m0;
+		tri[2]  = m2;
 
-		meshData.Indices.push_back(i*6+5);
-		meshData.Indices.push_back(i*6+4);
-		meshData.Indices.push_back(i*6+2);
+		tri[3]  = m0;
+		tri[4]  = m1;
+		tri[5]  = m2;
 
-		meshData.Indices.push_back(i*6+3);
-		meshData.Indices.push_back(i*6+1);
-		meshData.Indices.push_back(i*6+4);
+		tri[6]  = m2;
+		tri[7]  = m1;
+		tri[8]  = v2;
+
+		tri[9]  = m0;
+		tri[10] = v1;
+		tri[11] = m1;
 	}
 }
 
 void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData)
 {
-	// Put a cap on the number of subdivisions.
-	numSubdivisions = MathHelper::Min(numSubdivisions, 5u);
+	PROFILE_FUNCTION();
+
+	// Put a cap on the number of subdivisions.  n subdivisions give 10*4^n + 2
+	// vertices, which past 14 no longer fit 32-bit indices.
+	numSubdivisions = MathHelper::Min(numSubdivisions, 14u);
 
 	// Approximate a sphere by tessellating an icosahedron.
 
@@ -305,6 +361,12 @@ void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, Mesh
 		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7 
 	};
 
+	// Room for the final mesh up front, so no level reallocates.
+	meshData.Vertices.clear();
+	meshData.Indices.clear();
+	meshData.Vertices.reserve(10*((size_t)1 << 2*numSubdivisions) + 2);
+	meshData.Indices.reserve(60*((size_t)1 << 2*numSubdivisions));
+
 	meshData.Vertices.resize(12);
 	meshData.Indices.resize(60);
 
@@ -351,8 +413,17 @@ void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, Mesh
 
 void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData)
 {
-	meshData.Vertices.clear();
-	meshData.Indices.clear();
+	MeshSize size = GetCylinderSize(sliceCount, stackCount);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices.resize(size.IndexCount);
+
+	CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, &meshData.Vertices[0], &meshData.Indices[0]);
+}
+
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+									   Vertex* vertices, UINT* indices)
+{
+	PROFILE_FUNCTION();
 
 	//
 	// Build Stacks.
@@ -365,162 +436,166 @@ void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, floa
 
 	UINT ringCount = stackCount+1;
 
+	// Add one because we duplicate the first and last vertex per ring
+	// since the texture coordinates are different.
+	UINT ringVertexCount = sliceCount+1;
+
+	std::vector<XMFLOAT2> ring;
+	BuildRing(sliceCount, ring);
+	const XMFLOAT2* cosSin = &ring[0];
+
+	// Cylinder can be parameterized as follows, where we introduce v
+	// parameter that goes in the same direction as the v tex-coord
+	// so that the bitangent goes in the same direction as the v tex-coord.
+	//   Let r0 be the bottom radius and let r1 be the top radius.
+	//   y(v) = h - hv for v in [0,1].
+	//   r(v) = r1 + (r0-r1)v
+	//
+	//   x(t, v) = r(v)*cos(t)
+	//   y(t, v) = h - hv
+	//   z(t, v) = r(v)*sin(t)
+	// 
+	//  dx/dt = -r(v)*sin(t)
+	//  dy/dt = 0
+	//  dz/dt = +r(v)*cos(t)
+	//
+	//  dx/dv = (r0-r1)*cos(t)
+	//  dy/dv = -h
+	//  dz/dv = (r0-r1)*sin(t)
+	//
+	// The normal is T x B = (h*cos(t), r0-r1, h*sin(t)), whose length does
+	// not depend on t.
+	float dr = bottomRadius-topRadius;
+	float invLength = 1.0f/sqrtf(height*height + dr*dr);
+	float nh = height*invLength;
+	float ny = dr*invLength;
+
 	// Compute vertices for each stack ring starting at the bottom and moving up.
-	for(UINT i = 0; i < ringCount; ++i)
+	UINT threadCount = GetThreadCount(GetCylinderSize(sliceCount, stackCount).VertexCount);
+	Parallel::For(ringCount, threadCount, [=](UINT i)
 	{
 		float y = -0.5f*height + i*stackHeight;
 		float r = bottomRadius + i*radiusStep;
 
 		// vertices of ring
-		float dTheta = 2.0f*XM_PI/sliceCount;
-		for(UINT j = 0; j <= sliceCount; ++j)
+		Vertex* vertex = &vertices[i*ringVertexCount];
+		for(UINT j = 0; j <= sliceCount; ++j, ++vertex)
 		{
-			Vertex vertex;
-
-			float c = cosf(j*dTheta);
-			float s = sinf(j*dTheta);
-
-			vertex.Position = XMFLOAT3(r*c, y, r*s);
-
-			vertex.TexC.x = (float)j/sliceCount;
-			vertex.TexC.y = 1.0f - (float)i/stackCount;
-
-			// Cylinder can be parameterized as follows, where we introduce v
-			// parameter that goes in the same direction as the v tex-coord
-			// so that the bitangent goes in the same direction as the v tex-coord.
-			//   Let r0 be the bottom radius and let r1 be the top radius.
-			//   y(v) = h - hv for v in [0,1].
-			//   r(v) = r1 + (r0-r1)v
-			//
-			//   x(t, v) = r(v)*cos(t)
-			//   y(t, v) = h - hv
-			//   z(t, v) = r(v)*sin(t)
-			// 
-			//  dx/dt = -r(v)*sin(t)
-			//  dy/dt = 0
-			//  dz/dt = +r(v)*cos(t)
-			//
-			//  dx/dv = (r0-r1)*cos(t)
-			//  dy/dv = -h
-			//  dz/dv = (r0-r1)*sin(t)
-
-			// This is unit length.
-			vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
+			float c = cosSin[j].x;
+			float s = cosSin[j].y;
 
-			float dr = bottomRadius-topRadius;
-			XMFLOAT3 bitangent(dr*c, -height, dr*s);
+			vertex->Position = XMFLOAT3(r*c, y, r*s);
+			vertex->Normal   = XMFLOAT3(nh*c, ny, nh*s);
 
-			XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-			XMVECTOR B = XMLoadFloat3(&bitangent);
-			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-			XMStoreFloat3(&vertex.Normal, N);
+			// This is unit length.
+			vertex->TangentU = XMFLOAT3(-s, 0.0f, c);
 
-			meshData.Vertices.push_back(vertex);
+			vertex->TexC.x = (float)j/sliceCount;
+			vertex->TexC.y = 1.0f - (float)i/stackCount;
 		}
-	}
-
-	// Add one because we duplicate the first and last vertex per ring
-	// since the texture coordinates are different.
-	UINT ringVertexCount = sliceCount+1;
+	});
 
 	// Compute indices for each stack.
-	for(UINT i = 0; i < stackCount; ++i)
+	Parallel::For(stackCount, threadCount, [=](UINT i)
 	{
-		for(UINT j = 0; j < sliceCount; ++j)
+		UINT* k = &indices[i*sliceCount*6];
+		for(UINT j = 0; j < sliceCount; ++j, k += 6)
 		{
-			meshData.Indices.push_back(i*ringVertexCount + j);
-			meshData.Indices.push_back((i+1)*ringVertexCount + j);
-			meshData.Indices.push_back((i+1)*ringVertexCount + j+1);
+			k[0] = i*ringVertexCount + j;
+			k[1] = (i+1)*ringVertexCount + j;
+			k[2] = (i+1)*ringVertexCount + j+1;
 
-			meshData.Indices.push_back(i*ringVertexCount + j);
-			meshData.Indices.push_back((i+1)*ringVertexCount + j+1);
-			meshData.Indices.push_back(i*ringVertexCount + j+1);
+			k[3] = i*ringVertexCount + j;
+			k[4] = (i+1)*ringVertexCount + j+1;
+			k[5] = i*ringVertexCount + j+1;
 		}
-	}
+	});
+
+	UINT baseIndex = ringCount*ringVertexCount;
+	UINT* capIndices = &indices[stackCount*sliceCount*6];
 
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+	BuildCylinderTopCap(topRadius, height, sliceCount, &ring[0], baseIndex, vertices, capIndices);
+	BuildCylinderBottomCap(bottomRadius, height, sliceCount, &ring[0], baseIndex + sliceCount+2, vertices, capIndices + sliceCount*3);
 }
 
-void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height, 
-											UINT sliceCount, UINT stackCount, MeshData& meshData)
+void GeometryGenerator::BuildCylinderTopCap(float topRadius, float height, UINT sliceCount, const XMFLOAT2* ring,
+											UINT baseIndex, Vertex* vertices, UINT* indices)
 {
-	UINT baseIndex = (UINT)meshData.Vertices.size();
-
 	float y = 0.5f*height;
-	float dTheta = 2.0f*XM_PI/sliceCount;
 
 	// Duplicate cap ring vertices because the texture coordinates and normals differ.
 	for(UINT i = 0; i <= sliceCount; ++i)
 	{
-		float x = topRadius*cosf(i*dTheta);
-		float z = topRadius*sinf(i*dTheta);
+		float x = topRadius*ring[i].x;
+		float z = topRadius*ring[i].y;
 
 		// Scale down by the height to try and make top cap texture coord area
 		// proportional to base.
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		vertices[baseIndex + i] = Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
-
-	// Index of center vertex.
-	UINT centerIndex = (UINT)meshData.Vertices.size()-1;
+	UINT centerIndex = baseIndex + sliceCount+1;
+	vertices[centerIndex] = Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
 
-	for(UINT i = 0; i < sliceCount; ++i)
+	for(UINT i = 0; i < sliceCount; ++i, indices += 3)
 	{
-		meshData.Indices.push_back(centerIndex);
-		meshData.Indices.push_back(baseIndex + i+1);
-		meshData.Indices.push_back(baseIndex + i);
+		indices[0] = centerIndex;
+		indices[1] = baseIndex + i+1;
+		indices[2] = baseIndex + i;
 	}
 }
 
-void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, 
-											   UINT sliceCount, UINT stackCount, MeshData& meshData)
+void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float height, UINT sliceCount, const XMFLOAT2* ring,
+											   UINT baseIndex, Vertex* vertices, UINT* indices)
 {
 	// 
 	// Build bottom cap.
 	//
 
-	UINT baseIndex = (UINT)meshData.Vertices.size();
 	float y = -0.5f*height;
 
 	// vertices of ring
-	float dTheta = 2.0f*XM_PI/sliceCount;
 	for(UINT i = 0; i <= sliceCount; ++i)
 	{
-		float x = bottomRadius*cosf(i*dTheta);
-		float z = bottomRadius*sinf(i*dTheta);
+		float x = bottomRadius*ring[i].x;
+		float z = bottomRadius*ring[i].y;
 
 		// Scale down by the height to try and make top cap texture coord area
 		// proportional to base.
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		vertices[baseIndex + i] = Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
-
-	// Cache the index of center vertex.
-	UINT centerIndex = (UINT)meshData.Vertices.size()-1;
+	UINT centerIndex = baseIndex + sliceCount+1;
+	vertices[centerIndex] = Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
 
-	for(UINT i = 0; i < sliceCount; ++i)
+	for(UINT i = 0; i < sliceCount; ++i, indices += 3)
 	{
-		meshData.Indices.push_back(centerIndex);
-		meshData.Indices.push_back(baseIndex + i);
-		meshData.Indices.push_back(baseIndex + i+1);
+		indices[0] = centerIndex;
+		indices[1] = baseIndex + i;
+		indices[2] = baseIndex + i+1;
 	}
 }
 
 void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, MeshData& meshData)
 {
-	UINT vertexCount = m*n;
-	UINT faceCount   = (m-1)*(n-1)*2;
+	MeshSize size = GetGridSize(m, n);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices.resize(size.IndexCount);
+
+	CreateGrid(width, depth, m, n, &meshData.Vertices[0], &meshData.Indices[0]);
+}
+
+void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, Vertex* vertices, UINT* indices)
+{
+	PROFILE_FUNCTION();
 
 	//
 	// Create the vertices.
@@ -535,47 +610,47 @@ void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, Mes
 	float du = 1.0f / (n-1);
 	float dv = 1.0f / (m-1);
 
-	meshData.Vertices.resize(vertexCount);
-	for(UINT i = 0; i < m; ++i)
+	UINT threadCount = GetThreadCount(m*n);
+	Parallel::For(m, threadCount, [=](UINT i)
 	{
 		float z = halfDepth - i*dz;
-		for(UINT j = 0; j < n; ++j)
+
+		Vertex* v = &vertices[i*n];
+		for(UINT j = 0; j < n; ++j, ++v)
 		{
 			float x = -halfWidth + j*dx;
 
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			v->Position = XMFLOAT3(x, 0.0f, z);
+			v->Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			v->TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
 
 			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
+			v->TexC.x = j*du;
+			v->TexC.y = i*dv;
 		}
-	}
+	});
  
     //
 	// Create the indices.
 	//
 
-	meshData.Indices.resize(faceCount*3); // 3 indices per face
-
 	// Iterate over each quad and compute indices.
-	UINT k = 0;
-	for(UINT i = 0; i < m-1; ++i)
+	Parallel::For(m-1, threadCount, [=](UINT i)
 	{
+		UINT* k = &indices[i*(n-1)*6];
 		for(UINT j = 0; j < n-1; ++j)
 		{
-			meshData.Indices[k]   = i*n+j;
-			meshData.Indices[k+1] = i*n+j+1;
-			meshData.Indices[k+2] = (i+1)*n+j;
+			k[0] = i*n+j;
+			k[1] = i*n+j+1;
+			k[2] = (i+1)*n+j;
 
-			meshData.Indices[k+3] = (i+1)*n+j;
-			meshData.Indices[k+4] = i*n+j+1;
-			meshData.Indices[k+5] = (i+1)*n+j+1;
+			k[3] = (i+1)*n+j;
+			k[4] = i*n+j+1;
+			k[5] = (i+1)*n+j+1;
 
 			k += 6; // next quad
 		}
-	}
+	});
 }
 
 void GeometryGenerator::CreateFullscreenQuad(MeshData& meshData)
@@ -616,3 +691,62 @@ void GeometryGenerator::CreateFullscreenQuad(MeshData& meshData)
 	meshData.Indices[4] = 2;
 	meshData.Indices[5] = 3;
 }
+
+GeometryGenerator::MeshSize GeometryGenerator::GetSphereSize(UINT sliceCount, UINT stackCount)
+{
+	// Two poles and stackCount-1 rings; a triangle fan at each pole and two
+	// triangles per slice for the stacks in between.
+	MeshSize size;
+	size.VertexCount = 2 + (stackCount-1)*(sliceCount+1);
+	size.IndexCount  = 6*sliceCount*(stackCount-1);
+	return size;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GetCylinderSize(UINT sliceCount, UINT stackCount)
+{
+	// stackCount+1 rings, then each cap's ring and center.
+	MeshSize size;
+	size.VertexCount = (stackCount+1)*(sliceCount+1) + 2*(sliceCount+2);
+	size.IndexCount  = 6*sliceCount*stackCount + 6*sliceCount;
+	return size;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GetGridSize(UINT m, UINT n)
+{
+	MeshSize size;
+	size.VertexCount = m*n;
+	size.IndexCount  = 6*(m-1)*(n-1);
+	return size;
+}
+
+void GeometryGenerator::BuildRing(UINT sliceCount, std::vector<XMFLOAT2>& ring)
+{
+	// Step around the circle by repeatedly rotating (cos, sin) by the slice
+	// angle.  Doubles keep the accumulated error far below float precision.
+	double step = 2.0*XM_PI/sliceCount;
+	double cosStep = cos(step);
+	double sinStep = sin(step);
+	double c = 1.0;
+	double s = 0.0;
+
+	ring.resize(sliceCount+1);
+	for(UINT j = 0; j < sliceCount; ++j)
+	{
+		ring[j] = XMFLOAT2((float)c, (float)s);
+
+		double next = c*cosStep - s*sinStep;
+		s = s*cosStep + c*sinStep;
+		c = next;
+	}
+
+	// The seam vertex lands exactly on the first.
+	ring[sliceCount] = ring[0];
+}
+
+UINT GeometryGenerator::GetThreadCount(UINT vertexCount)
+{
+	// Below this, starting threads costs more than it saves.
+	const UINT ParallelVertexCount = 64*1024;
+
+	return vertexCount >= ParallelVertexCount ? 0 : 1;
+}
@@ -15,7 +15,8 @@
 #ifndef GEOMETRYGENERATOR_H
 #define GEOMETRYGENERATOR_H
 
-#include "d3dUtil.h"
+#include "MathHelper.h"
+#include <vector>
 
 class GeometryGenerator
 {
@@ -45,6 +46,23 @@ public:
 		std::vector<UINT> Indices;
 	};
 
+	struct MeshSize
+	{
+		UINT VertexCount;
+		UINT IndexCount;
+	};
+
+	//
+	// The sphere, cylinder and grid also come in versions that write into arrays
+	// the caller sized with the matching Get*Size, such as a mapped dynamic buffer
+	// laid out like Vertex; they only write to the arrays, never read them back.
+	// Large meshes are built on several threads, a band of rows each.
+	//
+
+	static MeshSize GetSphereSize(UINT sliceCount, UINT stackCount);
+	static MeshSize GetCylinderSize(UINT sliceCount, UINT stackCount);
+	static MeshSize GetGridSize(UINT m, UINT n);
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions.
 	///</summary>
@@ -55,10 +73,12 @@ public:
 	/// slices and stacks parameters control the degree of tessellation.
 	///</summary>
 	void CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData);
+	void CreateSphere(float radius, UINT sliceCount, UINT stackCount, Vertex* vertices, UINT* indices);
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
-	/// depth controls the level of tessellation.
+	/// depth controls the level of tessellation: each subdivision quadruples the
+	/// triangles, and neighbouring triangles share their vertices.
 	///</summary>
 	void CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData);
 
@@ -68,12 +88,15 @@ public:
 	// cylinders.  The slices and stacks parameters control the degree of tessellation.
 	///</summary>
 	void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
+	void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+		Vertex* vertices, UINT* indices);
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
 	/// at the origin with the specified width and depth.
 	///</summary>
 	void CreateGrid(float width, float depth, UINT m, UINT n, MeshData& meshData);
+	void CreateGrid(float width, float depth, UINT m, UINT n, Vertex* vertices, UINT* indices);
 
 	///<summary>
 	/// Creates a quad covering the screen in NDC coordinates.  This is useful for
@@ -83,8 +106,16 @@ public:
 
 private:
 	void Subdivide(MeshData& meshData);
-	void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
-	void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
+	void BuildCylinderTopCap(float topRadius, float height, UINT sliceCount, const XMFLOAT2* ring,
+		UINT baseIndex, Vertex* vertices, UINT* indices);
+	void BuildCylinderBottomCap(float bottomRadius, float height, UINT sliceCount, const XMFLOAT2* ring,
+		UINT baseIndex, Vertex* vertices, UINT* indices);
+
+	// (cos, sin) of the sliceCount+1 angles around a ring.
+	static void BuildRing(UINT sliceCount, std::vector<XMFLOAT2>& ring);
+
+	// Parallel::For thread count for a mesh of vertexCount vertices.
+	static UINT GetThreadCount(UINT vertexCount);
 };
 
 #endif // GEOMETRYGENERATOR_H
\ No newline at end of file
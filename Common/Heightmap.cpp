@@ -0,0 +1,242 @@
+//***************************************************************************************
+// Heightmap.cpp
+//***************************************************************************************
+
+#include "Heightmap.h"
+#include "Profiler.h"
+#include <cmath>
+#include <fstream>
+
+Heightmap::Heightmap()
+: mWidth(0), mHeight(0), mCellSpacing(1.0f)
+{
+}
+
+Heightmap::~Heightmap()
+{
+}
+
+void Heightmap::Init(UINT width, UINT height, float cellSpacing)
+{
+	mWidth = width;
+	mHeight = height;
+	mCellSpacing = cellSpacing;
+
+	mHeights.assign(width*height, 0.0f);
+}
+
+void Heightmap::ReadRaw(std::istream& in, float heightScale)
+{
+	// A height for each vertex
+	std::vector<unsigned char> raw(mWidth*mHeight, 0);
+	if( !raw.empty() )
+		in.read((char*)&raw[0], (std::streamsize)raw.size());
+
+	// Copy the array data into a float array and scale it.
+	for(size_t i = 0; i < raw.size(); ++i)
+	{
+		mHeights[i] = (raw[i] / 255.0f)*heightScale;
+	}
+}
+
+bool Heightmap::LoadRaw(const std::string& filename, UINT width, UINT height, float heightScale, float cellSpacing)
+{
+	PROFILE_FUNCTION();
+
+	Init(width, height, cellSpacing);
+
+	std::ifstream inFile(filename.c_str(), std::ios_base::binary);
+	if( !inFile )
+		return false;
+
+	ReadRaw(inFile, heightScale);
+	return true;
+}
+
+#ifdef _WIN32
+bool Heightmap::LoadRaw(const std::wstring& filename, UINT width, UINT height, float heightScale, float cellSpacing)
+{
+	PROFILE_FUNCTION();
+
+	Init(width, height, cellSpacing);
+
+	std::ifstream inFile(filename.c_str(), std::ios_base::binary);
+	if( !inFile )
+		return false;
+
+	ReadRaw(inFile, heightScale);
+	return true;
+}
+#endif
+
+void Heightmap::Smooth()
+{
+	PROFILE_FUNCTION();
+
+	std::vector<float> dest( mHeights.size() );
+
+	for(UINT i = 0; i < mHeight; ++i)
+	{
+		for(UINT j = 0; j < mWidth; ++j)
+		{
+			dest[i*mWidth+j] = Average(i,j);
+		}
+	}
+
+	// Replace the old heightmap with the filtered one.
+	mHeights.swap(dest);
+}
+
+float Heightmap::Average(int i, int j)const
+{
+	// Function computes the average height of the ij element.
+	// It averages itself with its eight neighbor pixels.  Note
+	// that if a pixel is missing neighbor, we just don't include it
+	// in the average--that is, edge pixels don't have a neighbor pixel.
+	//
+	// ----------
+	// | 1| 2| 3|
+	// ----------
+	// |4 |ij| 6|
+	// ----------
+	// | 7| 8| 9|
+	// ----------
+
+	float avg = 0.0f;
+	float num = 0.0f;
+
+	// Use int to allow negatives.  If we use UINT, @ i=0, m=i-1=UINT_MAX
+	// and no iterations of the outer for loop occur.
+	for(int m = i-1; m <= i+1; ++m)
+	{
+		for(int n = j-1; n <= j+1; ++n)
+		{
+			if( m >= 0 && m < (int)mHeight && n >= 0 && n < (int)mWidth )
+			{
+				avg += mHeights[m*mWidth + n];
+				num += 1.0f;
+			}
+		}
+	}
+
+	return avg / num;
+}
+
+UINT Heightmap::Width()const
+{
+	return mWidth;
+}
+
+UINT Heightmap::Height()const
+{
+	return mHeight;
+}
+
+float Heightmap::CellSpacing()const
+{
+	return mCellSpacing;
+}
+
+float Heightmap::GetWidth()const
+{
+	// Total terrain width.
+	return (mWidth-1)*mCellSpacing;
+}
+
+float Heightmap::GetDepth()const
+{
+	// Total terrain depth.
+	return (mHeight-1)*mCellSpacing;
+}
+
+float Heightmap::GetHeight(float x, float z)const
+{
+	// Transform from terrain local space to "cell" space.
+	float c = (x + 0.5f*GetWidth()) /  mCellSpacing;
+	float d = (z - 0.5f*GetDepth()) / -mCellSpacing;
+
+	// Get the row and column we are in.
+	int row = (int)floorf(d);
+	int col = (int)floorf(c);
+
+	// Grab the heights of the cell we are in.
+	// A*--*B
+	//  | /|
+	//  |/ |
+	// C*--*D
+	float A = mHeights[row*mWidth + col];
+	float B = mHeights[row*mWidth + col + 1];
+	float C = mHeights[(row+1)*mWidth + col];
+	float D = mHeights[(row+1)*mWidth + col + 1];
+
+	// Where we are relative to the cell.
+	float s = c - (float)col;
+	float t = d - (float)row;
+
+	// If upper triangle ABC.
+	if( s + t <= 1.0f)
+	{
+		float uy = B - A;
+		float vy = C - A;
+		return A + s*uy + t*vy;
+	}
+	else // lower triangle DCB.
+	{
+		float uy = C - D;
+		float vy = B - D;
+		return D + (1.0f-s)*uy + (1.0f-t)*vy;
+	}
+}
+
+float& Heightmap::At(UINT row, UINT col)
+{
+	return mHeights[row*mWidth + col];
+}
+
+float Heightmap::At(UINT row, UINT col)const
+{
+	return mHeights[row*mWidth + col];
+}
+
+const std::vector<float>& Heightmap::Heights()const
+{
+	return mHeights;
+}
+
+void Heightmap::CalcPatchBoundsY(UINT cellsPerPatch, std::vector<XMFLOAT2>& boundsY)const
+{
+	PROFILE_FUNCTION();
+
+	UINT patchRows = (mHeight-1) / cellsPerPatch;
+	UINT patchCols = (mWidth-1) / cellsPerPatch;
+
+	boundsY.resize(patchRows*patchCols);
+
+	// For each patch, scan the heightmap values it covers and compute the
+	// min/max height.
+	for(UINT i = 0; i < patchRows; ++i)
+	{
+		for(UINT j = 0; j < patchCols; ++j)
+		{
+			UINT x0 = j*cellsPerPatch;
+			UINT x1 = (j+1)*cellsPerPatch;
+
+			UINT y0 = i*cellsPerPatch;
+			UINT y1 = (i+1)*cellsPerPatch;
+
+			float minY = +MathHelper::Infinity;
+			float maxY = -MathHelper::Infinity;
+			for(UINT y = y0; y <= y1; ++y)
+			{
+				for(UINT x = x0; x <= x1; ++x)
+				{
+					UINT k = y*mWidth + x;
+					minY = MathHelper::Min(minY, mHeights[k]);
+					maxY = MathHelper::Max(maxY, mHeights[k]);
+				}
+			}
+
+			boundsY[i*patchCols + j] = XMFLOAT2(minY, maxY);
+		}
+	}
+}
@@ -0,0 +1,81 @@
+//***************************************************************************************
+// Heightmap.h
+//
+// CPU side of the terrain: a grid of heights loaded from an 8-bit RAW file, the
+// 3x3 smoothing filter, height queries and per patch y-bounds.  Kept apart from the
+// Direct3D resources of Terrain so the same code can run headless.
+//
+// Row 0 is the far (+z) edge of the terrain and the grid is centered on the origin,
+// matching the layout Terrain builds its patch vertices with.
+//***************************************************************************************
+
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+#include "MathHelper.h"
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class Heightmap
+{
+public:
+	Heightmap();
+	~Heightmap();
+
+	///<summary>
+	/// Sets the grid size and spacing; all heights become zero.
+	///</summary>
+	void Init(UINT width, UINT height, float cellSpacing);
+
+	///<summary>
+	/// Reads width*height bytes, each scaled from [0, 255] to [0, heightScale].  A
+	/// missing file leaves every height at zero and returns false.
+	///</summary>
+	bool LoadRaw(const std::string& filename, UINT width, UINT height, float heightScale, float cellSpacing);
+#ifdef _WIN32
+	bool LoadRaw(const std::wstring& filename, UINT width, UINT height, float heightScale, float cellSpacing);
+#endif
+
+	///<summary>
+	/// Replaces every height by the average of itself and its neighbors.
+	///</summary>
+	void Smooth();
+
+	UINT Width()const;
+	UINT Height()const;
+	float CellSpacing()const;
+
+	// Extent of the terrain in x and z.
+	float GetWidth()const;
+	float GetDepth()const;
+
+	///<summary>
+	/// Height of the terrain surface at local x, z, interpolated on the triangle
+	/// of the cell that contains the point.
+	///</summary>
+	float GetHeight(float x, float z)const;
+
+	float& At(UINT row, UINT col);
+	float At(UINT row, UINT col)const;
+	const std::vector<float>& Heights()const;
+
+	///<summary>
+	/// Min and max height of each patch of cellsPerPatch x cellsPerPatch cells,
+	/// row by row.
+	///</summary>
+	void CalcPatchBoundsY(UINT cellsPerPatch, std::vector<XMFLOAT2>& boundsY)const;
+
+private:
+	void ReadRaw(std::istream& in, float heightScale);
+	float Average(int i, int j)const;
+
+private:
+	UINT mWidth;
+	UINT mHeight;
+	float mCellSpacing;
+
+	std::vector<float> mHeights;
+};
+
+#endif // HEIGHTMAP_H
@@ -0,0 +1,416 @@
+//***************************************************************************************
+// ImageFilter.cpp
+//***************************************************************************************
+
+#include "ImageFilter.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include <cmath>
+
+namespace
+{
+	const UINT RowStrip    = 8;
+	const UINT ColumnBlock = 32;
+
+	inline int ClampIndex(int i, int size)
+	{
+		return i < 0 ? 0 : (i >= size ? size - 1 : i);
+	}
+
+	inline XMVECTOR LoadTexel(const ImageFilter::Image& image, int x, int y)
+	{
+		return XMLoadFloat4(&image.Texels[y*image.Width + x]);
+	}
+
+	inline void StoreTexel(ImageFilter::Image& image, int x, int y, FXMVECTOR v)
+	{
+		XMStoreFloat4(&image.Texels[y*image.Width + x], v);
+	}
+
+	void Resize(ImageFilter::Image& image, UINT width, UINT height)
+	{
+		image.Width  = width;
+		image.Height = height;
+		image.Texels.resize(width*height);
+	}
+
+	// Runs fn(y) for every row, handing out strips of RowStrip rows.
+	template<typename Fn>
+	void ForEachRow(UINT height, UINT threadCount, Fn fn)
+	{
+		UINT strips = (height + RowStrip - 1) / RowStrip;
+		Parallel::For(strips, threadCount, [&](UINT strip)
+		{
+			UINT y1 = MathHelper::Min(strip*RowStrip + RowStrip, height);
+			for(UINT y = strip*RowStrip; y < y1; ++y)
+				fn(y);
+		});
+	}
+
+	// Runs fn(x0, x1) for every block of ColumnBlock columns, so the vertical
+	// passes walk down the image reading whole cache lines.
+	template<typename Fn>
+	void ForEachColumnBlock(UINT width, UINT threadCount, Fn fn)
+	{
+		UINT blocks = (width + ColumnBlock - 1) / ColumnBlock;
+		Parallel::For(blocks, threadCount, [&](UINT block)
+		{
+			fn(block*ColumnBlock, MathHelper::Min(block*ColumnBlock + ColumnBlock, width));
+		});
+	}
+}
+
+ImageFilter::Image::Image()
+: Width(0), Height(0)
+{
+}
+
+ImageFilter::Image::Image(UINT width, UINT height)
+: Width(width), Height(height), Texels(width*height, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f))
+{
+}
+
+void ImageFilter::Image::FromRGBA8(const BYTE* data, UINT width, UINT height, UINT rowPitch)
+{
+	Resize(*this, width, height);
+
+	const float inv255 = 1.0f / 255.0f;
+	for(UINT y = 0; y < height; ++y)
+	{
+		const BYTE* row = data + y*rowPitch;
+		for(UINT x = 0; x < width; ++x)
+		{
+			const BYTE* c = row + 4*x;
+			Texels[y*width + x] = XMFLOAT4(c[0]*inv255, c[1]*inv255, c[2]*inv255, c[3]*inv255);
+		}
+	}
+}
+
+void ImageFilter::Image::ToRGBA8(std::vector<BYTE>& data)const
+{
+	data.resize(4*Texels.size());
+
+	XMVECTOR scale = XMVectorReplicate(255.0f);
+	XMVECTOR half  = XMVectorReplicate(0.5f);
+	for(size_t i = 0; i < Texels.size(); ++i)
+	{
+		XMFLOAT4 c;
+		XMStoreFloat4(&c, XMVectorSaturate(XMLoadFloat4(&Texels[i]))*scale + half);
+
+		data[4*i + 0] = (BYTE)c.x;
+		data[4*i + 1] = (BYTE)c.y;
+		data[4*i + 2] = (BYTE)c.z;
+		data[4*i + 3] = (BYTE)c.w;
+	}
+}
+
+std::vector<float> ImageFilter::BuildGaussianKernel(float sigma, int radius)
+{
+	radius = MathHelper::Max(radius, 0);
+	std::vector<float> weights(2*radius + 1);
+
+	float d = 2.0f*sigma*sigma;
+	float sum = 0.0f;
+	for(int i = -radius; i <= radius; ++i)
+	{
+		float x = (float)i;
+		weights[i + radius] = d > 0.0f ? expf(-x*x/d) : (i == 0 ? 1.0f : 0.0f);
+
+		sum += weights[i + radius];
+	}
+
+	// Divide by the sum so all the weights add up to 1.0.
+	for(size_t i = 0; i < weights.size(); ++i)
+		weights[i] /= sum;
+
+	return weights;
+}
+
+std::vector<float> ImageFilter::BuildBinomialKernel(int radius)
+{
+	radius = MathHelper::Max(radius, 0);
+	int row = 2*radius + 4;
+
+	// C(row, k) for k = 2 .. row-2; doubles hold the large rows exactly enough.
+	std::vector<double> coeff(row + 1);
+	coeff[0] = 1.0;
+	for(int k = 1; k <= row; ++k)
+		coeff[k] = coeff[k-1]*(double)(row - k + 1)/(double)k;
+
+	double sum = 0.0;
+	for(int k = 2; k <= row - 2; ++k)
+		sum += coeff[k];
+
+	std::vector<float> weights(2*radius + 1);
+	for(int i = 0; i < 2*radius + 1; ++i)
+		weights[i] = (float)(coeff[i + 2]/sum);
+
+	return weights;
+}
+
+std::vector<float> ImageFilter::BuildComputeShaderKernel()
+{
+	static const float weights[11] =
+	{
+		0.05f, 0.05f, 0.1f, 0.1f, 0.1f, 0.2f, 0.1f, 0.1f, 0.1f, 0.05f, 0.05f
+	};
+
+	return std::vector<float>(weights, weights + 11);
+}
+
+void ImageFilter::ConvolveRows(const Image& src, Image& dst, const std::vector<float>& kernel, UINT threadCount)
+{
+	int width  = (int)src.Width;
+	int radius = (int)kernel.size() / 2;
+
+	ForEachRow(src.Height, threadCount, [&](UINT y)
+	{
+		for(int x = 0; x < width; ++x)
+		{
+			XMVECTOR sum = XMVectorZero();
+			for(int i = -radius; i <= radius; ++i)
+				sum += kernel[i + radius]*LoadTexel(src, ClampIndex(x + i, width), y);
+
+			StoreTexel(dst, x, y, sum);
+		}
+	});
+}
+
+void ImageFilter::ConvolveColumns(const Image& src, Image& dst, const std::vector<float>& kernel, UINT threadCount)
+{
+	int height = (int)src.Height;
+	int radius = (int)kernel.size() / 2;
+
+	ForEachColumnBlock(src.Width, threadCount, [&](UINT x0, UINT x1)
+	{
+		XMFLOAT4 sums[ColumnBlock];
+		for(int y = 0; y < height; ++y)
+		{
+			for(UINT x = x0; x < x1; ++x)
+				sums[x - x0] = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+			for(int i = -radius; i <= radius; ++i)
+			{
+				int sy = ClampIndex(y + i, height);
+				for(UINT x = x0; x < x1; ++x)
+					XMStoreFloat4(&sums[x - x0], XMLoadFloat4(&sums[x - x0]) + kernel[i + radius]*LoadTexel(src, x, sy));
+			}
+
+			for(UINT x = x0; x < x1; ++x)
+				dst.Texels[y*dst.Width + x] = sums[x - x0];
+		}
+	});
+}
+
+void ImageFilter::BoxRows(const Image& src, Image& dst, int radius, UINT threadCount)
+{
+	int width = (int)src.Width;
+	float scale = 1.0f / (float)(2*radius + 1);
+
+	ForEachRow(src.Height, threadCount, [&](UINT y)
+	{
+		XMVECTOR sum = XMVectorZero();
+		for(int i = -radius; i <= radius; ++i)
+			sum += LoadTexel(src, ClampIndex(i, width), y);
+
+		for(int x = 0; x < width; ++x)
+		{
+			StoreTexel(dst, x, y, scale*sum);
+
+			// Slide the window one texel to the right.
+			sum += LoadTexel(src, ClampIndex(x + radius + 1, width), y);
+			sum -= LoadTexel(src, ClampIndex(x - radius, width), y);
+		}
+	});
+}
+
+void ImageFilter::BoxColumns(const Image& src, Image& dst, int radius, UINT threadCount)
+{
+	int height = (int)src.Height;
+	float scale = 1.0f / (float)(2*radius + 1);
+
+	ForEachColumnBlock(src.Width, threadCount, [&](UINT x0, UINT x1)
+	{
+		XMFLOAT4 sums[ColumnBlock];
+		for(UINT x = x0; x < x1; ++x)
+		{
+			XMVECTOR sum = XMVectorZero();
+			for(int i = -radius; i <= radius; ++i)
+				sum += LoadTexel(src, x, ClampIndex(i, height));
+
+			XMStoreFloat4(&sums[x - x0], sum);
+		}
+
+		for(int y = 0; y < height; ++y)
+		{
+			int addY = ClampIndex(y + radius + 1, height);
+			int subY = ClampIndex(y - radius, height);
+
+			for(UINT x = x0; x < x1; ++x)
+			{
+				XMVECTOR sum = XMLoadFloat4(&sums[x - x0]);
+				StoreTexel(dst, x, y, scale*sum);
+
+				sum += LoadTexel(src, x, addY) - LoadTexel(src, x, subY);
+				XMStoreFloat4(&sums[x - x0], sum);
+			}
+		}
+	});
+}
+
+void ImageFilter::LinearTapRows(const Image& src, Image& dst, const std::vector<LinearTap>& taps, UINT threadCount)
+{
+	int width = (int)src.Width;
+
+	ForEachRow(src.Height, threadCount, [&](UINT y)
+	{
+		for(int x = 0; x < width; ++x)
+		{
+			XMVECTOR sum = XMVectorZero();
+			for(size_t t = 0; t < taps.size(); ++t)
+			{
+				// Texel centers sit at integer positions, so a tap at offset o
+				// blends texels floor(x+o) and floor(x+o)+1.
+				float pos = (float)x + taps[t].Offset;
+				float x0 = floorf(pos);
+				float f  = pos - x0;
+
+				XMVECTOR a = LoadTexel(src, ClampIndex((int)x0, width), y);
+				XMVECTOR b = LoadTexel(src, ClampIndex((int)x0 + 1, width), y);
+				sum += taps[t].Weight*XMVectorLerp(a, b, f);
+			}
+
+			StoreTexel(dst, x, y, sum);
+		}
+	});
+}
+
+void ImageFilter::LinearTapColumns(const Image& src, Image& dst, const std::vector<LinearTap>& taps, UINT threadCount)
+{
+	int height = (int)src.Height;
+
+	ForEachColumnBlock(src.Width, threadCount, [&](UINT x0, UINT x1)
+	{
+		XMFLOAT4 sums[ColumnBlock];
+		for(int y = 0; y < height; ++y)
+		{
+			for(UINT x = x0; x < x1; ++x)
+				sums[x - x0] = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+			for(size_t t = 0; t < taps.size(); ++t)
+			{
+				float pos = (float)y + taps[t].Offset;
+				float y0 = floorf(pos);
+				float f  = pos - y0;
+
+				int ya = ClampIndex((int)y0, height);
+				int yb = ClampIndex((int)y0 + 1, height);
+
+				for(UINT x = x0; x < x1; ++x)
+				{
+					XMVECTOR v = XMVectorLerp(LoadTexel(src, x, ya), LoadTexel(src, x, yb), f);
+					XMStoreFloat4(&sums[x - x0], XMLoadFloat4(&sums[x - x0]) + taps[t].Weight*v);
+				}
+			}
+
+			for(UINT x = x0; x < x1; ++x)
+				dst.Texels[y*dst.Width + x] = sums[x - x0];
+		}
+	});
+}
+
+void ImageFilter::BlurSeparable(const Image& src, Image& dst, const std::vector<float>& kernel,
+	int blurCount, UINT threadCount)
+{
+	PROFILE_FUNCTION();
+
+	if( &src != &dst )
+		dst = src;
+
+	Image temp(src.Width, src.Height);
+	for(int i = 0; i < blurCount; ++i)
+	{
+		ConvolveRows(dst, temp, kernel, threadCount);
+		ConvolveColumns(temp, dst, kernel, threadCount);
+	}
+}
+
+void ImageFilter::BlurLinearTaps(const Image& src, Image& dst, const std::vector<LinearTap>& taps,
+	int blurCount, UINT threadCount)
+{
+	PROFILE_FUNCTION();
+
+	if( &src != &dst )
+		dst = src;
+
+	Image temp(src.Width, src.Height);
+	for(int i = 0; i < blurCount; ++i)
+	{
+		LinearTapRows(dst, temp, taps, threadCount);
+		LinearTapColumns(temp, dst, taps, threadCount);
+	}
+}
+
+void ImageFilter::BoxBlur(const Image& src, Image& dst, int radius, UINT threadCount)
+{
+	PROFILE_FUNCTION();
+
+	if( &src != &dst )
+		dst = src;
+
+	if( radius <= 0 )
+		return;
+
+	Image temp(src.Width, src.Height);
+	BoxRows(dst, temp, radius, threadCount);
+	BoxColumns(temp, dst, radius, threadCount);
+}
+
+std::vector<int> ImageFilter::GaussianBoxRadii(float sigma, int boxCount)
+{
+	boxCount = MathHelper::Max(boxCount, 1);
+	float n = (float)boxCount;
+
+	// Widths wl and wl+2 (both odd) bracket the ideal width; m boxes of width wl
+	// and the rest of width wl+2 give the variance closest to sigma^2.
+	float idealWidth = sqrtf(12.0f*sigma*sigma/n + 1.0f);
+	int wl = (int)floorf(idealWidth);
+	if( wl % 2 == 0 )
+		--wl;
+	wl = MathHelper::Max(wl, 1);
+	int wu = wl + 2;
+
+	float idealM = (12.0f*sigma*sigma - n*wl*wl - 4.0f*n*wl - 3.0f*n)/(-4.0f*wl - 4.0f);
+	int m = MathHelper::Clamp((int)floorf(idealM + 0.5f), 0, boxCount);
+
+	std::vector<int> radii(boxCount);
+	for(int i = 0; i < boxCount; ++i)
+		radii[i] = ((i < m ? wl : wu) - 1) / 2;
+
+	return radii;
+}
+
+void ImageFilter::BlurGaussianBoxes(const Image& src, Image& dst, float sigma, int boxCount, UINT threadCount)
+{
+	if( &src != &dst )
+		dst = src;
+
+	std::vector<int> radii = GaussianBoxRadii(sigma, boxCount);
+	for(size_t i = 0; i < radii.size(); ++i)
+		BoxBlur(dst, dst, radii[i], threadCount);
+}
+
+float ImageFilter::MaxDifference(const Image& a, const Image& b)
+{
+	float maxDiff = 0.0f;
+	size_t n = MathHelper::Min(a.Texels.size(), b.Texels.size());
+	for(size_t i = 0; i < n; ++i)
+	{
+		XMFLOAT4 d;
+		XMStoreFloat4(&d, XMVectorAbs(XMLoadFloat4(&a.Texels[i]) - XMLoadFloat4(&b.Texels[i])));
+
+		maxDiff = MathHelper::Max(maxDiff, MathHelper::Max(MathHelper::Max(d.x, d.y), MathHelper::Max(d.z, d.w)));
+	}
+
+	return maxDiff;
+}
@@ -0,0 +1,109 @@
+//***************************************************************************************
+// ImageFilter.h
+//
+// CPU implementation of the blur filters used by the Blur samples.  It reproduces
+// the kernels of the compute shader blur (Blur.fx), the Gaussian and binomial
+// weights of BlurFilter and the bilinear tap kernels of LinearSamplingBlur, so an
+// image can be preprocessed offline or used as a reference for the shaders.
+//
+// Images are stored as float RGBA; one pixel is one XNA math vector, so every
+// channel is filtered at once.  Passes are split into row strips (horizontal) and
+// column blocks (vertical) that run on a pool of threads.
+//***************************************************************************************
+
+#ifndef IMAGEFILTER_H
+#define IMAGEFILTER_H
+
+#include "MathHelper.h"
+#include <vector>
+
+class ImageFilter
+{
+public:
+	struct Image
+	{
+		Image();
+		Image(UINT width, UINT height);
+
+		UINT Width;
+		UINT Height;
+		std::vector<XMFLOAT4> Texels;
+
+		///<summary>
+		/// Converts to and from R8G8B8A8_UNORM texels; rowPitch is in bytes.
+		///</summary>
+		void FromRGBA8(const BYTE* data, UINT width, UINT height, UINT rowPitch);
+		void ToRGBA8(std::vector<BYTE>& data)const;
+	};
+
+	// A tap at a fractional texel offset, read with a linear filter.
+	struct LinearTap
+	{
+		float Offset;
+		float Weight;
+	};
+
+	///<summary>
+	/// Normalized 2*radius+1 Gaussian weights.
+	///</summary>
+	static std::vector<float> BuildGaussianKernel(float sigma, int radius);
+
+	///<summary>
+	/// Normalized 2*radius+1 binomial weights, taken from row 2*radius+4 of
+	/// Pascal's triangle with the two smallest coefficients dropped at each end,
+	/// as in LinearSamplingBlur's BlurFilter::BuildWeight.
+	///</summary>
+	static std::vector<float> BuildBinomialKernel(int radius);
+
+	///<summary>
+	/// The default gWeights of Blur.fx (radius 5).
+	///</summary>
+	static std::vector<float> BuildComputeShaderKernel();
+
+	///<summary>
+	/// blurCount horizontal+vertical passes of a symmetric 2*radius+1 kernel with
+	/// CLAMP addressing, like BlurFilter::BlurInPlace.  src and dst may be the same.
+	///</summary>
+	static void BlurSeparable(const Image& src, Image& dst, const std::vector<float>& kernel,
+		int blurCount, UINT threadCount = 0);
+
+	///<summary>
+	/// blurCount passes of a kernel given as linear filtered taps, like the pixel
+	/// shaders of LinearSamplingBlur.
+	///</summary>
+	static void BlurLinearTaps(const Image& src, Image& dst, const std::vector<LinearTap>& taps,
+		int blurCount, UINT threadCount = 0);
+
+	///<summary>
+	/// Box filter of width 2*radius+1 computed with a sliding window, so the cost
+	/// per pixel does not depend on the radius.
+	///</summary>
+	static void BoxBlur(const Image& src, Image& dst, int radius, UINT threadCount = 0);
+
+	///<summary>
+	/// Approximates a Gaussian of the given sigma with boxCount successive box
+	/// filters whose widths are chosen to match its variance.
+	///</summary>
+	static void BlurGaussianBoxes(const Image& src, Image& dst, float sigma, int boxCount = 3, UINT threadCount = 0);
+
+	///<summary>
+	/// Radii of the boxes used by BlurGaussianBoxes.
+	///</summary>
+	static std::vector<int> GaussianBoxRadii(float sigma, int boxCount);
+
+	///<summary>
+	/// Largest per channel difference between two images of the same size.
+	///</summary>
+	static float MaxDifference(const Image& a, const Image& b);
+
+private:
+	// Single horizontal or vertical passes.
+	static void ConvolveRows(const Image& src, Image& dst, const std::vector<float>& kernel, UINT threadCount);
+	static void ConvolveColumns(const Image& src, Image& dst, const std::vector<float>& kernel, UINT threadCount);
+	static void BoxRows(const Image& src, Image& dst, int radius, UINT threadCount);
+	static void BoxColumns(const Image& src, Image& dst, int radius, UINT threadCount);
+	static void LinearTapRows(const Image& src, Image& dst, const std::vector<LinearTap>& taps, UINT threadCount);
+	static void LinearTapColumns(const Image& src, Image& dst, const std::vector<LinearTap>& taps, UINT threadCount);
+};
+
+#endif // IMAGEFILTER_H
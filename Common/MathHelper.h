@@ -7,8 +7,8 @@
 #ifndef MATHHELPER_H
 #define MATHHELPER_H
 
-#include <Windows.h>
-#include <xnamath.h>
+#include <cstdlib>
+#include "XnaMathPortable.h"
 
 class MathHelper
 {
@@ -0,0 +1,179 @@
+//***************************************************************************************
+// ParallelFor.h
+//
+// Minimal fork/join helper for CPU side work such as reference image passes and
+// geometry builds.  Work items are handed out through an atomic counter so uneven
+// items balance themselves; the calling thread takes part in the work.
+//
+// The helper threads belong to a pool that is started on the first parallel loop and
+// kept for the life of the process, so a loop costs a wake up and a wait rather than
+// creating and joining threads every frame.  One loop uses the pool at a time: a loop
+// started from inside another one, or from a second thread while the pool is busy,
+// runs on its calling thread alone.
+//***************************************************************************************
+
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Parallel
+{
+	inline unsigned int HardwareThreadCount()
+	{
+		unsigned int n = std::thread::hardware_concurrency();
+		return n > 0 ? n : 1;
+	}
+
+	class WorkerPool
+	{
+	public:
+		typedef void (*Job)(void* context);
+
+		static WorkerPool& Instance()
+		{
+			static WorkerPool pool;
+			return pool;
+		}
+
+		~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mStop = true;
+			}
+			mWake.notify_all();
+
+			for(size_t t = 0; t < mThreads.size(); ++t)
+				mThreads[t].join();
+		}
+
+		///<summary>
+		/// Calls job(context) on helperCount pool threads and on the calling thread,
+		/// and returns once all of them have returned.  Returns false without calling
+		/// job when the pool is already running a job.
+		///</summary>
+		bool Run(unsigned int helperCount, Job job, void* context)
+		{
+			std::unique_lock<std::mutex> busy(mBusy, std::try_to_lock);
+			if( !busy.owns_lock() )
+				return false;
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				while( mThreads.size() < helperCount )
+					mThreads.push_back(std::thread(&WorkerPool::WorkerMain, this, (unsigned int)mThreads.size()));
+
+				mJob        = job;
+				mContext    = context;
+				mHelpers    = helperCount;
+				mRunning    = helperCount;
+				++mGeneration;
+			}
+			mWake.notify_all();
+
+			job(context);
+
+			std::unique_lock<std::mutex> lock(mMutex);
+			mDone.wait(lock, [this]() { return mRunning == 0; });
+			return true;
+		}
+
+	private:
+		WorkerPool() : mJob(0), mContext(0), mHelpers(0), mRunning(0), mGeneration(0), mStop(false) {}
+		WorkerPool(const WorkerPool& rhs);
+		WorkerPool& operator=(const WorkerPool& rhs);
+
+		void WorkerMain(unsigned int index)
+		{
+			unsigned int seen = 0;
+			std::unique_lock<std::mutex> lock(mMutex);
+			for(;;)
+			{
+				mWake.wait(lock, [&]() { return mStop || mGeneration != seen; });
+				if( mStop )
+					return;
+
+				// Run waits for every helper of a job before starting the next one, so
+				// a helper cannot miss a job it is counted in.
+				seen = mGeneration;
+				if( index >= mHelpers )
+					continue;
+
+				Job job = mJob;
+				void* context = mContext;
+				lock.unlock();
+				job(context);
+				lock.lock();
+
+				if( --mRunning == 0 )
+					mDone.notify_one();
+			}
+		}
+
+	private:
+		std::mutex mBusy;
+		std::mutex mMutex;
+		std::condition_variable mWake;
+		std::condition_variable mDone;
+		std::vector<std::thread> mThreads;
+
+		Job mJob;
+		void* mContext;
+		unsigned int mHelpers;
+		unsigned int mRunning;
+		unsigned int mGeneration;
+		bool mStop;
+	};
+
+	///<summary>
+	/// Calls fn(i) for every i in [0, count).  threadCount 0 uses every hardware
+	/// thread; 1 runs the loop on the calling thread.  fn must be safe to call
+	/// concurrently for different i.
+	///</summary>
+	template<typename Fn>
+	void For(unsigned int count, unsigned int threadCount, Fn fn)
+	{
+		if( threadCount == 0 )
+			threadCount = HardwareThreadCount();
+		if( threadCount > count )
+			threadCount = count;
+
+		if( threadCount <= 1 )
+		{
+			for(unsigned int i = 0; i < count; ++i)
+				fn(i);
+			return;
+		}
+
+		struct Loop
+		{
+			std::atomic<unsigned int> Next;
+			unsigned int Count;
+			Fn* Body;
+
+			static void Run(void* context)
+			{
+				Loop* loop = static_cast<Loop*>(context);
+				for(unsigned int i = loop->Next++; i < loop->Count; i = loop->Next++)
+					(*loop->Body)(i);
+			}
+		};
+
+		Loop loop;
+		loop.Next  = 0;
+		loop.Count = count;
+		loop.Body  = &fn;
+
+		// The pool is busy with an outer loop; items are handed out the same way,
+		// so running them all here gives the same result.
+		if( !WorkerPool::Instance().Run(threadCount - 1, &Loop::Run, &loop) )
+			Loop::Run(&loop);
+	}
+}
+
+#endif // PARALLELFOR_H
@@ -0,0 +1,656 @@
+//***************************************************************************************
+// PatchCuller.cpp
+//***************************************************************************************
+
+#include "PatchCuller.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Patches evaluated by one task; a multiple of four.
+	const UINT ChunkSize = 2048;
+
+	// Below this many patches the pass stays on the calling thread.
+	const UINT ParallelPatchCount = 4*ChunkSize;
+
+	// Vertices taken to world space by one task; a multiple of four.
+	const UINT VertexChunkSize = 8192;
+
+	enum WorldComponent { PosX, PosY, PosZ, NormalX, NormalY, NormalZ };
+
+	inline const float* Read(const float* p, UINT stride, UINT i)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(p) + (size_t)stride*i);
+	}
+
+	inline void Store4(float* p, FXMVECTOR v)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+	}
+
+	//
+	// Four points or vectors, one per lane.  The operations keep the order of the
+	// scalar formulas in EvaluatePatch so both paths round alike.
+	//
+
+	struct Vector3x4
+	{
+		XMVECTOR X, Y, Z;
+	};
+
+	inline Vector3x4 Add(const Vector3x4& a, const Vector3x4& b)
+	{
+		Vector3x4 r = { XMVectorAdd(a.X, b.X), XMVectorAdd(a.Y, b.Y), XMVectorAdd(a.Z, b.Z) };
+		return r;
+	}
+
+	inline Vector3x4 Subtract(const Vector3x4& a, const Vector3x4& b)
+	{
+		Vector3x4 r = { XMVectorSubtract(a.X, b.X), XMVectorSubtract(a.Y, b.Y), XMVectorSubtract(a.Z, b.Z) };
+		return r;
+	}
+
+	inline Vector3x4 Multiply(const Vector3x4& a, FXMVECTOR s)
+	{
+		Vector3x4 r = { XMVectorMultiply(a.X, s), XMVectorMultiply(a.Y, s), XMVectorMultiply(a.Z, s) };
+		return r;
+	}
+
+	inline Vector3x4 Divide(const Vector3x4& a, FXMVECTOR s)
+	{
+		Vector3x4 r = { XMVectorDivide(a.X, s), XMVectorDivide(a.Y, s), XMVectorDivide(a.Z, s) };
+		return r;
+	}
+
+	inline XMVECTOR Dot(const Vector3x4& a, const Vector3x4& b)
+	{
+		return XMVectorAdd(XMVectorAdd(XMVectorMultiply(a.X, b.X), XMVectorMultiply(a.Y, b.Y)), XMVectorMultiply(a.Z, b.Z));
+	}
+
+	inline Vector3x4 Normalize(const Vector3x4& a)
+	{
+		return Divide(a, XMVectorSqrt(Dot(a, a)));
+	}
+
+	inline Vector3x4 Gather(const float* const* components, UINT i0, UINT i1, UINT i2, UINT i3)
+	{
+		const float* x = components[0];
+		const float* y = components[1];
+		const float* z = components[2];
+
+		Vector3x4 r =
+		{
+			XMVectorSet(x[i0], x[i1], x[i2], x[i3]),
+			XMVectorSet(y[i0], y[i1], y[i2], y[i3]),
+			XMVectorSet(z[i0], z[i1], z[i2], z[i3])
+		};
+		return r;
+	}
+
+	// A matrix with every element replicated across a vector.
+	struct Matrix4x4
+	{
+		XMVECTOR M[4][4];
+
+		explicit Matrix4x4(const XMFLOAT4X4& m)
+		{
+			for(int r = 0; r < 4; ++r)
+				for(int c = 0; c < 4; ++c)
+					M[r][c] = XMVectorReplicate(m.m[r][c]);
+		}
+
+		// Column c of mul(float4(p, w), m), with w = 1 when point is set and 0 otherwise.
+		XMVECTOR Column(const Vector3x4& p, int c, bool point)const
+		{
+			XMVECTOR v = XMVectorAdd(XMVectorAdd(XMVectorMultiply(p.X, M[0][c]), XMVectorMultiply(p.Y, M[1][c])),
+				XMVectorMultiply(p.Z, M[2][c]));
+			return point ? XMVectorAdd(v, M[3][c]) : v;
+		}
+	};
+
+	// ComputeCP of the shaders: the control point a third of the way from a to b,
+	// projected onto the tangent plane at a.
+	inline Vector3x4 ComputeCP(const Vector3x4& a, const Vector3x4& b, const Vector3x4& normalA)
+	{
+		Vector3x4 r = Subtract(Add(Multiply(a, XMVectorReplicate(2.0f)), b), Multiply(normalA, Dot(Subtract(b, a), normalA)));
+		return Divide(r, XMVectorReplicate(3.0f));
+	}
+
+	// A point taken to clip space, and ProjectAndScale of it.
+	struct Projected
+	{
+		XMVECTOR X, Y;
+		XMVECTOR Clipped;
+	};
+
+	inline Projected Project(const Matrix4x4& viewProj, const Vector3x4& p, FXMVECTOR scaleX, FXMVECTOR scaleY, FXMVECTOR edgeSize)
+	{
+		XMVECTOR x = viewProj.Column(p, 0, true);
+		XMVECTOR y = viewProj.Column(p, 1, true);
+		XMVECTOR z = viewProj.Column(p, 2, true);
+		XMVECTOR w = viewProj.Column(p, 3, true);
+
+		Projected r;
+		r.X = XMVectorDivide(XMVectorMultiply(XMVectorDivide(x, w), scaleX), edgeSize);
+		r.Y = XMVectorDivide(XMVectorMultiply(XMVectorDivide(y, w), scaleY), edgeSize);
+
+		// IsClipped: not entirely inside -w <= x, y, z <= w.
+		XMVECTOR negW = XMVectorNegate(w);
+		XMVECTOR inside = XMVectorAndInt(XMVectorLessOrEqual(negW, x), XMVectorLessOrEqual(x, w));
+		inside = XMVectorAndInt(inside, XMVectorAndInt(XMVectorLessOrEqual(negW, y), XMVectorLessOrEqual(y, w)));
+		inside = XMVectorAndInt(inside, XMVectorAndInt(XMVectorLessOrEqual(negW, z), XMVectorLessOrEqual(z, w)));
+		r.Clipped = XMVectorAndCInt(XMVectorTrueInt(), inside);
+		return r;
+	}
+
+	inline XMVECTOR Distance(const Projected& a, const Projected& b)
+	{
+		XMVECTOR dx = XMVectorSubtract(b.X, a.X);
+		XMVECTOR dy = XMVectorSubtract(b.Y, a.Y);
+		return XMVectorSqrt(XMVectorAdd(XMVectorMultiply(dx, dx), XMVectorMultiply(dy, dy)));
+	}
+
+	//
+	// Scalar versions of the same steps for EvaluatePatch, written after the HLSL.
+	//
+
+	inline XMFLOAT3 Float3(float x, float y, float z)
+	{
+		return XMFLOAT3(x, y, z);
+	}
+
+	inline XMFLOAT3 Add(const XMFLOAT3& a, const XMFLOAT3& b)      { return Float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+	inline XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b) { return Float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	inline XMFLOAT3 Multiply(const XMFLOAT3& a, float s)          { return Float3(a.x*s, a.y*s, a.z*s); }
+	inline XMFLOAT3 Divide(const XMFLOAT3& a, float s)            { return Float3(a.x/s, a.y/s, a.z/s); }
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b)        { return a.x*b.x + a.y*b.y + a.z*b.z; }
+	inline XMFLOAT3 Normalize(const XMFLOAT3& a)                  { return Divide(a, sqrtf(Dot(a, a))); }
+
+	inline float Column(const XMFLOAT4X4& m, const XMFLOAT3& p, int c, bool point)
+	{
+		float v = p.x*m.m[0][c] + p.y*m.m[1][c] + p.z*m.m[2][c];
+		return point ? v + m.m[3][c] : v;
+	}
+
+	inline XMFLOAT3 ComputeCP(const XMFLOAT3& posA, const XMFLOAT3& posB, const XMFLOAT3& normA)
+	{
+		return Divide(Subtract(Add(Multiply(posA, 2.0f), posB), Multiply(normA, Dot(Subtract(posB, posA), normA))), 3.0f);
+	}
+
+	inline XMFLOAT2 ProjectAndScale(const PatchCuller::Settings& s, const XMFLOAT3& p, float edgeSize)
+	{
+		float w = Column(s.ViewProj, p, 3, true);
+		return XMFLOAT2(Column(s.ViewProj, p, 0, true)/w*s.ScreenWidth/edgeSize,
+			Column(s.ViewProj, p, 1, true)/w*s.ScreenHeight/edgeSize);
+	}
+
+	inline bool IsClipped(const PatchCuller::Settings& s, const XMFLOAT3& p)
+	{
+		float x = Column(s.ViewProj, p, 0, true);
+		float y = Column(s.ViewProj, p, 1, true);
+		float z = Column(s.ViewProj, p, 2, true);
+		float w = Column(s.ViewProj, p, 3, true);
+
+		return !(-w <= x && x <= w && -w <= y && y <= w && -w <= z && z <= w);
+	}
+
+	inline float Distance(const XMFLOAT2& a, const XMFLOAT2& b)
+	{
+		float dx = b.x - a.x;
+		float dy = b.y - a.y;
+		return sqrtf(dx*dx + dy*dy);
+	}
+}
+
+PatchCuller::Settings::Settings()
+: Type(PNPatches), ScreenWidth(1.0f), ScreenHeight(1.0f), EdgeSize(16.0f), TessFactor(1.0f),
+  ScreenSpaceAdaptive(false), FrustumCull(false), BackFaceCull(false),
+  ViewVector(0.0f, 0.0f, -1.0f), BackFaceEpsilon(0.5f)
+{
+	XMStoreFloat4x4(&World, XMMatrixIdentity());
+	XMStoreFloat4x4(&ViewProj, XMMatrixIdentity());
+}
+
+PatchCuller::PatchCuller()
+: mThreadCount(0), mPatchCount(0), mFlatCount(0), mCulledCount(0)
+{
+}
+
+PatchCuller::~PatchCuller()
+{
+}
+
+void PatchCuller::SetThreadCount(UINT threadCount)
+{
+	mThreadCount = threadCount;
+}
+
+void PatchCuller::Process(const Vertices& vertices, const UINT* indices, UINT triangleCount, const Settings& settings)
+{
+	ProcessIndexed(vertices, indices, triangleCount, settings);
+}
+
+void PatchCuller::Process(const Vertices& vertices, const USHORT* indices, UINT triangleCount, const Settings& settings)
+{
+	ProcessIndexed(vertices, indices, triangleCount, settings);
+}
+
+const UINT* PatchCuller::GetPatchIndices()const
+{
+	return mPatchIndices.empty() ? 0 : &mPatchIndices[0];
+}
+
+const XMFLOAT4* PatchCuller::GetPatchFactors()const
+{
+	return mPatchFactors.empty() ? 0 : &mPatchFactors[0];
+}
+
+UINT PatchCuller::GetPatchCount()const
+{
+	return mPatchCount;
+}
+
+const UINT* PatchCuller::GetFlatIndices()const
+{
+	return mFlatIndices.empty() ? 0 : &mFlatIndices[0];
+}
+
+UINT PatchCuller::GetFlatCount()const
+{
+	return mFlatCount;
+}
+
+UINT PatchCuller::GetCulledCount()const
+{
+	return mCulledCount;
+}
+
+UINT PatchCuller::GetThreadCount(UINT workCount)const
+{
+	return workCount >= ParallelPatchCount ? mThreadCount : 1;
+}
+
+void PatchCuller::TransformVertices(const Vertices& vertices, const Settings& settings)
+{
+	UINT padded = (vertices.Count + 3) & ~3u;
+	for(int c = 0; c < 6; ++c)
+		mWorld[c].resize(padded);
+
+	if( vertices.Count == 0 )
+		return;
+
+	float* world[6];
+	for(int c = 0; c < 6; ++c)
+		world[c] = &mWorld[c][0];
+
+	const Matrix4x4 m(settings.World);
+	const UINT last = vertices.Count - 1;
+	const UINT chunks = (padded + VertexChunkSize - 1)/VertexChunkSize;
+
+	Parallel::For(chunks, GetThreadCount(vertices.Count), [&](UINT chunk)
+	{
+		UINT begin = chunk*VertexChunkSize;
+		UINT end   = std::min(begin + VertexChunkSize, padded);
+
+		for(UINT i = begin; i < end; i += 4)
+		{
+			// The padding repeats the last vertex.
+			UINT v[4];
+			for(UINT k = 0; k < 4; ++k)
+				v[k] = std::min(i + k, last);
+
+			const float* p[4];
+			const float* n[4];
+			for(UINT k = 0; k < 4; ++k)
+			{
+				p[k] = Read(vertices.Positions, vertices.Stride, v[k]);
+				n[k] = Read(vertices.Normals, vertices.Stride, v[k]);
+			}
+
+			Vector3x4 pos =
+			{
+				XMVectorSet(p[0][0], p[1][0], p[2][0], p[3][0]),
+				XMVectorSet(p[0][1], p[1][1], p[2][1], p[3][1]),
+				XMVectorSet(p[0][2], p[1][2], p[2][2], p[3][2])
+			};
+			Vector3x4 normal =
+			{
+				XMVectorSet(n[0][0], n[1][0], n[2][0], n[3][0]),
+				XMVectorSet(n[0][1], n[1][1], n[2][1], n[3][1]),
+				XMVectorSet(n[0][2], n[1][2], n[2][2], n[3][2])
+			};
+
+			// VS_RenderSceneWithTessellation: the position by the world matrix, the
+			// normal by its upper 3x3, then normalized.
+			Vector3x4 worldNormal = { m.Column(normal, 0, false), m.Column(normal, 1, false), m.Column(normal, 2, false) };
+			worldNormal = Normalize(worldNormal);
+
+			Store4(world[PosX] + i, m.Column(pos, 0, true));
+			Store4(world[PosY] + i, m.Column(pos, 1, true));
+			Store4(world[PosZ] + i, m.Column(pos, 2, true));
+			Store4(world[NormalX] + i, worldNormal.X);
+			Store4(world[NormalY] + i, worldNormal.Y);
+			Store4(world[NormalZ] + i, worldNormal.Z);
+		}
+	});
+}
+
+template<typename Index>
+void PatchCuller::ProcessIndexed(const Vertices& vertices, const Index* indices, UINT triangleCount, const Settings& settings)
+{
+	TransformVertices(vertices, settings);
+
+	mResults.resize(triangleCount);
+	mFactors.resize(triangleCount);
+
+	const UINT chunks = (triangleCount + ChunkSize - 1)/ChunkSize;
+	mChunkCounts.assign(2*chunks, 0);
+
+	Parallel::For(chunks, GetThreadCount(triangleCount), [&](UINT chunk)
+	{
+		UINT first = chunk*ChunkSize;
+		EvaluateChunk(indices, first, std::min(ChunkSize, triangleCount - first), settings);
+
+		UINT patches = 0;
+		UINT flat = 0;
+		for(UINT i = first; i < std::min(first + ChunkSize, triangleCount); ++i)
+		{
+			patches += mResults[i] == PatchTessellated;
+			flat    += mResults[i] == PatchFlat;
+		}
+		mChunkCounts[2*chunk]     = patches;
+		mChunkCounts[2*chunk + 1] = flat;
+	});
+
+	// Turn the counts into where each chunk writes, in input order.
+	mPatchCount = 0;
+	mFlatCount  = 0;
+	for(UINT chunk = 0; chunk < chunks; ++chunk)
+	{
+		UINT patches = mChunkCounts[2*chunk];
+		UINT flat    = mChunkCounts[2*chunk + 1];
+		mChunkCounts[2*chunk]     = mPatchCount;
+		mChunkCounts[2*chunk + 1] = mFlatCount;
+		mPatchCount += patches;
+		mFlatCount  += flat;
+	}
+	mCulledCount = triangleCount - mPatchCount - mFlatCount;
+
+	mPatchIndices.resize(3*mPatchCount);
+	mPatchFactors.resize(mPatchCount);
+	mFlatIndices.resize(3*mFlatCount);
+
+	Parallel::For(chunks, GetThreadCount(triangleCount), [&](UINT chunk)
+	{
+		UINT patch = mChunkCounts[2*chunk];
+		UINT flat  = mChunkCounts[2*chunk + 1];
+
+		UINT first = chunk*ChunkSize;
+		UINT end   = std::min(first + ChunkSize, triangleCount);
+		for(UINT i = first; i < end; ++i)
+		{
+			const Index* tri = indices + 3*(size_t)i;
+			if( mResults[i] == PatchTessellated )
+			{
+				UINT* out = &mPatchIndices[3*(size_t)patch];
+				out[0] = tri[0];
+				out[1] = tri[1];
+				out[2] = tri[2];
+				mPatchFactors[patch++] = mFactors[i];
+			}
+			else if( mResults[i] == PatchFlat )
+			{
+				UINT* out = &mFlatIndices[3*(size_t)flat++];
+				out[0] = tri[0];
+				out[1] = tri[1];
+				out[2] = tri[2];
+			}
+		}
+	});
+}
+
+template<typename Index>
+void PatchCuller::EvaluateChunk(const Index* indices, UINT first, UINT count, const Settings& settings)
+{
+	const float* positions[3] = { &mWorld[PosX][0], &mWorld[PosY][0], &mWorld[PosZ][0] };
+	const float* normals[3]   = { &mWorld[NormalX][0], &mWorld[NormalY][0], &mWorld[NormalZ][0] };
+
+	const Matrix4x4 viewProj(settings.ViewProj);
+	const XMVECTOR scaleX    = XMVectorReplicate(settings.ScreenWidth);
+	const XMVECTOR scaleY    = XMVectorReplicate(settings.ScreenHeight);
+	const XMVECTOR edgeSize  = XMVectorReplicate(std::max(1.0f, settings.EdgeSize));
+	const XMVECTOR one       = XMVectorSplatOne();
+	const XMVECTOR half      = XMVectorReplicate(0.5f);
+	const XMVECTOR two       = XMVectorReplicate(2.0f);
+	const XMVECTOR three     = XMVectorReplicate(3.0f);
+	const XMVECTOR six       = XMVectorReplicate(6.0f);
+	const XMVECTOR backFace  = XMVectorReplicate(-settings.BackFaceEpsilon);
+	const XMVECTOR constant  = XMVectorReplicate(settings.TessFactor);
+	const XMVECTOR culledResult = XMVectorReplicate((float)PatchCulled);
+	const XMVECTOR flatResult   = XMVectorReplicate((float)PatchFlat);
+	const XMVECTOR tessellated  = XMVectorReplicate((float)PatchTessellated);
+	const Vector3x4 view     =
+	{
+		XMVectorReplicate(settings.ViewVector.x),
+		XMVectorReplicate(settings.ViewVector.y),
+		XMVectorReplicate(settings.ViewVector.z)
+	};
+	const bool pn = settings.Type == PNPatches;
+
+	for(UINT i = 0; i < count; i += 4)
+	{
+		// The lanes past the end of the chunk repeat its last patch.
+		UINT patch[4];
+		for(UINT k = 0; k < 4; ++k)
+			patch[k] = first + std::min(i + k, count - 1);
+
+		UINT corner[3][4];
+		for(UINT k = 0; k < 4; ++k)
+		{
+			const Index* tri = indices + 3*(size_t)patch[k];
+			corner[0][k] = tri[0];
+			corner[1][k] = tri[1];
+			corner[2][k] = tri[2];
+		}
+
+		Vector3x4 p[3];
+		Vector3x4 n[3];
+		for(int c = 0; c < 3; ++c)
+		{
+			p[c] = Gather(positions, corner[c][0], corner[c][1], corner[c][2], corner[c][3]);
+			n[c] = Gather(normals, corner[c][0], corner[c][1], corner[c][2], corner[c][3]);
+		}
+
+		// Edge e runs from corner e to corner e+1 through two cubic control points on
+		// PN patches: cp[e][0] = ComputeCP(p[e], p[e+1]) and cp[e][1] the other way.
+		Vector3x4 cp[3][2];
+		if( pn )
+		{
+			for(int e = 0; e < 3; ++e)
+			{
+				int next = e < 2 ? e + 1 : 0;
+				cp[e][0] = ComputeCP(p[e], p[next], n[e]);
+				cp[e][1] = ComputeCP(p[next], p[e], n[next]);
+			}
+		}
+
+		XMVECTOR lod[3];
+		XMVECTOR culled = XMVectorFalseInt();
+
+		if( settings.ScreenSpaceAdaptive || settings.FrustumCull )
+		{
+			Projected corners[3];
+			for(int c = 0; c < 3; ++c)
+				corners[c] = Project(viewProj, p[c], scaleX, scaleY, edgeSize);
+
+			XMVECTOR clipped = XMVectorAndInt(XMVectorAndInt(corners[0].Clipped, corners[1].Clipped), corners[2].Clipped);
+
+			for(int e = 0; e < 3; ++e)
+			{
+				int next = e < 2 ? e + 1 : 0;
+				if( pn )
+				{
+					Projected b = Project(viewProj, cp[e][0], scaleX, scaleY, edgeSize);
+					Projected c = Project(viewProj, cp[e][1], scaleX, scaleY, edgeSize);
+					lod[e] = XMVectorAdd(XMVectorAdd(Distance(corners[e], b), Distance(b, c)), Distance(c, corners[next]));
+					clipped = XMVectorAndInt(clipped, XMVectorAndInt(b.Clipped, c.Clipped));
+				}
+				else if( settings.ScreenSpaceAdaptive )
+				{
+					lod[e] = Distance(corners[e], corners[next]);
+				}
+				if( settings.ScreenSpaceAdaptive )
+					lod[e] = XMVectorMax(lod[e], one);
+			}
+
+			if( settings.FrustumCull )
+			{
+				if( pn )
+				{
+					// HS_ConstantPN: the center control point must be clipped as well.
+					Vector3x4 e = Add(Add(Add(Add(Add(cp[0][0], cp[0][1]), cp[1][0]), cp[1][1]), cp[2][0]), cp[2][1]);
+					e = Divide(e, six);
+					Vector3x4 v = Divide(Add(Add(p[2], p[1]), p[0]), three);
+					Vector3x4 b111 = Add(e, Divide(Subtract(e, v), two));
+
+					XMVECTOR zero = XMVectorZero();
+					clipped = XMVectorAndInt(clipped, Project(viewProj, b111, zero, zero, one).Clipped);
+				}
+				culled = clipped;
+			}
+		}
+
+		if( !settings.ScreenSpaceAdaptive )
+			lod[0] = lod[1] = lod[2] = constant;
+
+		if( settings.BackFaceCull )
+		{
+			// BackFaceCull of AdaptiveTessellation.hlsl over the three edge normals.
+			XMVECTOR back = XMVectorTrueInt();
+			for(int e = 0; e < 3; ++e)
+			{
+				int next = e < 2 ? e + 1 : 0;
+				XMVECTOR edgeDot = Dot(Normalize(Multiply(Add(n[e], n[next]), half)), view);
+				back = XMVectorAndCInt(back, XMVectorGreater(edgeDot, backFace));
+			}
+			culled = XMVectorOrInt(culled, back);
+		}
+
+		// SV_TessFactor[0] is the edge opposite corner 0, which starts at corner 1.
+		XMVECTOR inside = XMVectorMax(XMVectorMax(lod[1], lod[2]), lod[0]);
+		XMVECTOR flat   = XMVectorLessOrEqual(inside, one);
+
+		XMVECTOR result = XMVectorSelect(tessellated, flatResult, flat);
+		result = XMVectorSelect(result, culledResult, culled);
+
+		float factors[4][4];
+		float results[4];
+		Store4(factors[0], lod[1]);
+		Store4(factors[1], lod[2]);
+		Store4(factors[2], lod[0]);
+		Store4(factors[3], inside);
+		Store4(results, result);
+
+		for(UINT k = 0; k < 4 && i + k < count; ++k)
+		{
+			UINT index = first + i + k;
+			mResults[index] = (BYTE)results[k];
+			mFactors[index] = XMFLOAT4(factors[0][k], factors[1][k], factors[2][k], factors[3][k]);
+		}
+	}
+}
+
+PatchCuller::PatchResult PatchCuller::EvaluatePatch(const XMFLOAT3 positions[3], const XMFLOAT3 normals[3],
+	const Settings& settings, XMFLOAT4* factors)
+{
+	// VS_RenderSceneWithTessellation
+	XMFLOAT3 p[3];
+	XMFLOAT3 n[3];
+	for(int i = 0; i < 3; ++i)
+	{
+		p[i] = Float3(Column(settings.World, positions[i], 0, true), Column(settings.World, positions[i], 1, true),
+			Column(settings.World, positions[i], 2, true));
+		n[i] = Normalize(Float3(Column(settings.World, normals[i], 0, false), Column(settings.World, normals[i], 1, false),
+			Column(settings.World, normals[i], 2, false)));
+	}
+
+	const bool pn = settings.Type == PNPatches;
+	const float edgeSize = std::max(1.0f, settings.EdgeSize);
+
+	// HS_PNTriangles / HS_FlatTriangles, one control point (and the edge after it) at a time.
+	float oppositeEdgeLOD[3];
+	bool clipped[3];
+	XMFLOAT3 cp[3][2];
+	for(int id = 0; id < 3; ++id)
+	{
+		int next = id < 2 ? id + 1 : 0;
+		if( pn )
+		{
+			cp[id][0] = ComputeCP(p[id], p[next], n[id]);
+			cp[id][1] = ComputeCP(p[next], p[id], n[next]);
+		}
+
+		if( settings.ScreenSpaceAdaptive )
+		{
+			XMFLOAT2 a = ProjectAndScale(settings, p[id], edgeSize);
+			XMFLOAT2 d = ProjectAndScale(settings, p[next], edgeSize);
+			float edgeLOD;
+			if( pn )
+			{
+				XMFLOAT2 b = ProjectAndScale(settings, cp[id][0], edgeSize);
+				XMFLOAT2 c = ProjectAndScale(settings, cp[id][1], edgeSize);
+				edgeLOD = Distance(a, b) + Distance(b, c) + Distance(c, d);
+			}
+			else
+			{
+				edgeLOD = Distance(a, d);
+			}
+			oppositeEdgeLOD[id] = std::max(edgeLOD, 1.0f);
+		}
+		else
+		{
+			oppositeEdgeLOD[id] = settings.TessFactor;
+		}
+
+		clipped[id] = settings.FrustumCull && IsClipped(settings, p[id]);
+		if( pn )
+			clipped[id] = clipped[id] && IsClipped(settings, cp[id][0]) && IsClipped(settings, cp[id][1]);
+	}
+
+	// HS_ConstantPN / HS_ConstantFlat
+	XMFLOAT4 f;
+	f.x = oppositeEdgeLOD[1];
+	f.y = oppositeEdgeLOD[2];
+	f.z = oppositeEdgeLOD[0];
+	f.w = std::max(std::max(f.x, f.y), f.z);
+
+	bool culled = clipped[0] && clipped[1] && clipped[2];
+	if( culled && pn )
+	{
+		XMFLOAT3 e = Divide(Add(Add(Add(Add(Add(cp[0][0], cp[0][1]), cp[1][0]), cp[1][1]), cp[2][0]), cp[2][1]), 6.0f);
+		XMFLOAT3 v = Divide(Add(Add(p[2], p[1]), p[0]), 3.0f);
+		XMFLOAT3 b111 = Add(e, Divide(Subtract(e, v), 2.0f));
+		culled = IsClipped(settings, b111);
+	}
+
+	if( settings.BackFaceCull )
+	{
+		XMFLOAT3 view = settings.ViewVector;
+		bool back = true;
+		for(int i = 0; i < 3; ++i)
+		{
+			int next = i < 2 ? i + 1 : 0;
+			float edgeDot = Dot(Normalize(Multiply(Add(n[i], n[next]), 0.5f)), view);
+			back = back && !(edgeDot > -settings.BackFaceEpsilon);
+		}
+		culled = culled || back;
+	}
+
+	if( culled )
+		return PatchCulled;
+
+	*factors = f;
+	return f.w <= 1.0f ? PatchFlat : PatchTessellated;
+}
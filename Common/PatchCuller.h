@@ -0,0 +1,156 @@
+//***************************************************************************************
+// PatchCuller.h
+//
+// CPU pre-pass for the triangle patches of the TessellationOnAnyBudget demos.  It does
+// the per-patch work of their hull shaders ahead of the draw: the screen space edge
+// tessellation factors of ComputeEdgeLOD, the view frustum test of IsClipped and the
+// back face test of AdaptiveTessellation.hlsl.  Patches the hull shader would cull are
+// dropped, patches whose factors all come out at 1 go to a plain triangle list (the
+// tessellator would emit them unchanged), and the rest go to a compacted patch list
+// with their four factors, in SV_TessFactor order, for the hull shader to read.
+//
+// The vertices are first taken to world space four at a time, as the tessellation
+// vertex shader does.  The patches are then evaluated four at a time, one per XMVECTOR
+// lane, in chunks spread over threads; the compaction keeps the input order, so the
+// result does not depend on the thread count.  EvaluatePatch is a scalar line-by-line
+// port of the shader formulas, kept to check the batched path against.  Nothing here
+// needs Direct3D.
+//***************************************************************************************
+
+#ifndef PATCHCULLER_H
+#define PATCHCULLER_H
+
+#include "XnaMathPortable.h"
+#include <vector>
+
+class PatchCuller
+{
+public:
+	enum PatchType
+	{
+		// Flat triangles (FlatDicing): an edge spans its two corners.
+		FlatPatches,
+
+		// PN triangles (PNTriangle): an edge spans its four cubic control points,
+		// and the center control point takes part in the frustum test.
+		PNPatches
+	};
+
+	enum PatchResult
+	{
+		PatchCulled,
+		PatchFlat,
+		PatchTessellated
+	};
+
+	// The hull shader constants the pass stands in for.
+	struct Settings
+	{
+		PatchType Type;
+
+		// Object to world space, as the tessellation vertex shader applies it, and
+		// world to clip space.
+		XMFLOAT4X4 World;
+		XMFLOAT4X4 ViewProj;
+
+		// g_f4ScreenParams.xy and g_f4GUIParams1.w: pixels per tessellated edge.
+		float ScreenWidth;
+		float ScreenHeight;
+		float EdgeSize;
+
+		// g_f4TessFactors.x, the factor of every edge without ScreenSpaceAdaptive.
+		float TessFactor;
+
+		bool ScreenSpaceAdaptive;
+		bool FrustumCull;
+		bool BackFaceCull;
+
+		// g_f4ViewVector and g_f4GUIParams1.x for the back face test.
+		XMFLOAT3 ViewVector;
+		float BackFaceEpsilon;
+
+		Settings();
+	};
+
+	// Where the vertices are: the position and normal of vertex i are Stride*i bytes
+	// past Positions and Normals, so interleaved sdkmesh vertices can be used as they are.
+	struct Vertices
+	{
+		const float* Positions;
+		const float* Normals;
+		UINT Stride;
+		UINT Count;
+	};
+
+	PatchCuller();
+	~PatchCuller();
+
+	///<summary>
+	/// threadCount 0 uses every hardware thread for large meshes; 1 keeps the pass
+	/// on the calling thread.
+	///</summary>
+	void SetThreadCount(UINT threadCount);
+
+	///<summary>
+	/// Evaluates the triangleCount patches of a triangle list.  The index lists it
+	/// writes refer to the same vertices.
+	///</summary>
+	void Process(const Vertices& vertices, const UINT* indices, UINT triangleCount, const Settings& settings);
+	void Process(const Vertices& vertices, const USHORT* indices, UINT triangleCount, const Settings& settings);
+
+	// Patches to tessellate, three indices each, with their factors.
+	const UINT* GetPatchIndices()const;
+	const XMFLOAT4* GetPatchFactors()const;
+	UINT GetPatchCount()const;
+
+	// Patches to draw as plain triangles, three indices each.
+	const UINT* GetFlatIndices()const;
+	UINT GetFlatCount()const;
+
+	UINT GetCulledCount()const;
+
+	///<summary>
+	/// The hull shader formulas for one patch, one scalar at a time: positions and
+	/// normals are in object space, factors receives (edge 0, edge 1, edge 2, inside)
+	/// unless the patch is culled.
+	///</summary>
+	static PatchResult EvaluatePatch(const XMFLOAT3 positions[3], const XMFLOAT3 normals[3],
+		const Settings& settings, XMFLOAT4* factors);
+
+private:
+	PatchCuller(const PatchCuller& rhs);
+	PatchCuller& operator=(const PatchCuller& rhs);
+
+	void TransformVertices(const Vertices& vertices, const Settings& settings);
+
+	template<typename Index>
+	void ProcessIndexed(const Vertices& vertices, const Index* indices, UINT triangleCount, const Settings& settings);
+
+	template<typename Index>
+	void EvaluateChunk(const Index* indices, UINT first, UINT count, const Settings& settings);
+
+	UINT GetThreadCount(UINT workCount)const;
+
+private:
+	UINT mThreadCount;
+
+	// World space vertices, one array per component, padded to a multiple of four.
+	std::vector<float> mWorld[6];
+
+	// Per input patch: its PatchResult and factors.
+	std::vector<BYTE> mResults;
+	std::vector<XMFLOAT4> mFactors;
+
+	// Per chunk: patches to tessellate and flat patches, then where each chunk's
+	// patches start in the output lists.
+	std::vector<UINT> mChunkCounts;
+
+	std::vector<UINT> mPatchIndices;
+	std::vector<XMFLOAT4> mPatchFactors;
+	std::vector<UINT> mFlatIndices;
+	UINT mPatchCount;
+	UINT mFlatCount;
+	UINT mCulledCount;
+};
+
+#endif // PATCHCULLER_H
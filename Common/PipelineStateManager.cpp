@@ -0,0 +1,407 @@
+#include "PipelineStateManager.h"
+
+namespace
+{
+	const UINT64 FnvOffset = 14695981039346656037ULL;
+	const UINT64 FnvPrime = 1099511628211ULL;
+
+	UINT64 HashBytes(UINT64 hash, const void* data, size_t size)
+	{
+		auto bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= FnvPrime;
+		}
+		return hash;
+	}
+
+	UINT64 HashString(UINT64 hash, const std::string& s)
+	{
+		UINT length = static_cast<UINT>(s.size());
+		hash = HashBytes(hash, &length, sizeof(length));
+		return HashBytes(hash, s.data(), s.size());
+	}
+
+	// The blend and depth-stencil descs hold UINT8 fields followed by padding, so
+	// they are copied field by field into zeroed storage before their bytes are
+	// hashed or compared.
+	D3D11_BLEND_DESC Normalize(const D3D11_BLEND_DESC& desc)
+	{
+		D3D11_BLEND_DESC out;
+		ZeroMemory(&out, sizeof(out));
+		out.AlphaToCoverageEnable = desc.AlphaToCoverageEnable;
+		out.IndependentBlendEnable = desc.IndependentBlendEnable;
+		for (int i = 0; i < 8; i++)
+		{
+			const auto& src = desc.RenderTarget[i];
+			auto& dst = out.RenderTarget[i];
+			dst.BlendEnable = src.BlendEnable;
+			dst.SrcBlend = src.SrcBlend;
+			dst.DestBlend = src.DestBlend;
+			dst.BlendOp = src.BlendOp;
+			dst.SrcBlendAlpha = src.SrcBlendAlpha;
+			dst.DestBlendAlpha = src.DestBlendAlpha;
+			dst.BlendOpAlpha = src.BlendOpAlpha;
+			dst.RenderTargetWriteMask = src.RenderTargetWriteMask;
+		}
+		return out;
+	}
+
+	D3D11_DEPTH_STENCIL_DESC Normalize(const D3D11_DEPTH_STENCIL_DESC& desc)
+	{
+		D3D11_DEPTH_STENCIL_DESC out;
+		ZeroMemory(&out, sizeof(out));
+		out.DepthEnable = desc.DepthEnable;
+		out.DepthWriteMask = desc.DepthWriteMask;
+		out.DepthFunc = desc.DepthFunc;
+		out.StencilEnable = desc.StencilEnable;
+		out.StencilReadMask = desc.StencilReadMask;
+		out.StencilWriteMask = desc.StencilWriteMask;
+		out.FrontFace = desc.FrontFace;
+		out.BackFace = desc.BackFace;
+		return out;
+	}
+
+	// No padding in these two.
+	D3D11_RASTERIZER_DESC Normalize(const D3D11_RASTERIZER_DESC& desc) { return desc; }
+	D3D11_SAMPLER_DESC Normalize(const D3D11_SAMPLER_DESC& desc) { return desc; }
+
+	UINT64 MixKey(UINT64 key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		return key;
+	}
+}
+
+void PipelineStateManager::Initialize(ID3D11Device* pDevice)
+{
+	m_pDevice = pDevice;
+}
+
+template <typename Desc, typename State, typename CreateFn>
+State* PipelineStateManager::Deduplicate(std::vector<StateEntry<Desc, State>>& entries,
+	std::unordered_map<std::string, State*>& names,
+	const std::string& name, const Desc& desc, CreateFn create)
+{
+	assert(m_pDevice != nullptr);
+
+	Desc normalized = Normalize(desc);
+	UINT64 key = HashBytes(FnvOffset, &normalized, sizeof(normalized));
+
+	State* pState = nullptr;
+	for (auto& entry : entries)
+	{
+		if (entry.Key == key && memcmp(&entry.Description, &normalized, sizeof(normalized)) == 0)
+		{
+			pState = entry.pState.Get();
+			break;
+		}
+	}
+
+	if (pState == nullptr)
+	{
+		StateEntry<Desc, State> entry;
+		entry.Key = key;
+		entry.Description = normalized;
+		HR(create(&normalized, entry.pState.GetAddressOf()));
+		pState = entry.pState.Get();
+		entries.push_back(entry);
+	}
+
+	names[name] = pState;
+	return pState;
+}
+
+ID3D11BlendState* PipelineStateManager::CreateBlendState(const std::string& name, const D3D11_BLEND_DESC& desc)
+{
+	return Deduplicate(m_BlendStates, m_BlendNames, name, desc,
+		[this](const D3D11_BLEND_DESC* pDesc, ID3D11BlendState** ppState) {
+			return m_pDevice->CreateBlendState(pDesc, ppState);
+		});
+}
+
+ID3D11DepthStencilState* PipelineStateManager::CreateDepthStencilState(const std::string& name, const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+	return Deduplicate(m_DepthStencilStates, m_DepthStencilNames, name, desc,
+		[this](const D3D11_DEPTH_STENCIL_DESC* pDesc, ID3D11DepthStencilState** ppState) {
+			return m_pDevice->CreateDepthStencilState(pDesc, ppState);
+		});
+}
+
+ID3D11RasterizerState* PipelineStateManager::CreateRasterizerState(const std::string& name, const D3D11_RASTERIZER_DESC& desc)
+{
+	return Deduplicate(m_RasterizerStates, m_RasterizerNames, name, desc,
+		[this](const D3D11_RASTERIZER_DESC* pDesc, ID3D11RasterizerState** ppState) {
+			return m_pDevice->CreateRasterizerState(pDesc, ppState);
+		});
+}
+
+ID3D11SamplerState* PipelineStateManager::CreateSamplerState(const std::string& name, const D3D11_SAMPLER_DESC& desc)
+{
+	return Deduplicate(m_SamplerStates, m_SamplerNames, name, desc,
+		[this](const D3D11_SAMPLER_DESC* pDesc, ID3D11SamplerState** ppState) {
+			return m_pDevice->CreateSamplerState(pDesc, ppState);
+		});
+}
+
+void PipelineStateManager::AddInputLayout(const std::string& name, Microsoft::WRL::ComPtr<ID3D11InputLayout> pLayout)
+{
+	m_InputLayouts[name] = pLayout;
+}
+
+void PipelineStateManager::AddShader(ShaderPtr shader)
+{
+	assert(shader);
+	m_Shaders[shader->m_ShaderType][shader->m_Name] = shader;
+}
+
+void PipelineStateManager::AddRenderTarget(const std::string& name, RenderTargetPtr target)
+{
+	m_RenderTargets[name] = target;
+}
+
+template <typename State>
+State* PipelineStateManager::Find(const std::unordered_map<std::string, State*>& names, const std::string& name)
+{
+	auto it = names.find(name);
+	assert(it != names.end());
+	return it != names.end() ? it->second : nullptr;
+}
+
+ID3D11BlendState* PipelineStateManager::GetBlendState(const std::string& name) const
+{
+	return Find(m_BlendNames, name);
+}
+
+ID3D11DepthStencilState* PipelineStateManager::GetDepthStencilState(const std::string& name) const
+{
+	return Find(m_DepthStencilNames, name);
+}
+
+ID3D11RasterizerState* PipelineStateManager::GetRasterizerState(const std::string& name) const
+{
+	return Find(m_RasterizerNames, name);
+}
+
+ID3D11SamplerState* PipelineStateManager::GetSamplerState(const std::string& name) const
+{
+	return Find(m_SamplerNames, name);
+}
+
+ID3D11InputLayout* PipelineStateManager::GetInputLayout(const std::string& name) const
+{
+	auto it = m_InputLayouts.find(name);
+	assert(it != m_InputLayouts.end());
+	return it != m_InputLayouts.end() ? it->second.Get() : nullptr;
+}
+
+ShaderPtr PipelineStateManager::GetShader(ShaderType type, const std::string& name) const
+{
+	auto it = m_Shaders[type].find(name);
+	assert(it != m_Shaders[type].end());
+	return it != m_Shaders[type].end() ? it->second : nullptr;
+}
+
+RenderTarget* PipelineStateManager::GetRenderTarget(const std::string& name) const
+{
+	auto it = m_RenderTargets.find(name);
+	assert(it != m_RenderTargets.end());
+	return it != m_RenderTargets.end() ? it->second.get() : nullptr;
+}
+
+UINT64 PipelineStateManager::HashDesc(const PipelineStateDesc& desc)
+{
+	UINT64 hash = HashString(FnvOffset, desc.IL);
+	for (int i = 0; i < NumShader; i++)
+		hash = HashString(hash, desc.m_ShaderName[i]);
+	hash = HashString(hash, desc.BS);
+	hash = HashBytes(hash, desc.BlendFactor.data(), sizeof(FLOAT) * desc.BlendFactor.size());
+	hash = HashBytes(hash, &desc.SampleMask, sizeof(desc.SampleMask));
+	hash = HashString(hash, desc.DSS);
+	hash = HashBytes(hash, &desc.StencilRef, sizeof(desc.StencilRef));
+	hash = HashString(hash, desc.RS);
+	hash = HashString(hash, desc.RT);
+	for (int i = 0; i < NumShader; i++)
+		for (const auto& sampler : desc.bindings[i].Sampler)
+			hash = HashString(hash, sampler);
+	return hash;
+}
+
+bool PipelineStateManager::SameDesc(const PipelineStateDesc& a, const PipelineStateDesc& b)
+{
+	for (int i = 0; i < NumShader; i++)
+	{
+		if (a.m_ShaderName[i] != b.m_ShaderName[i] || a.bindings[i].Sampler != b.bindings[i].Sampler)
+			return false;
+	}
+
+	return a.IL == b.IL && a.BS == b.BS && a.BlendFactor == b.BlendFactor && a.SampleMask == b.SampleMask
+		&& a.DSS == b.DSS && a.StencilRef == b.StencilRef && a.RS == b.RS && a.RT == b.RT;
+}
+
+void PipelineStateManager::BuildPSO(const PipelineStateDesc& desc, PipelineStateObject& pso) const
+{
+	if (!desc.IL.empty())
+		pso.pIL = GetInputLayout(desc.IL);
+
+	for (int i = 0; i < NumShader; i++)
+	{
+		auto Type = static_cast<ShaderType>(i);
+		if (desc.m_ShaderName[Type].empty())
+			continue;
+		pso.m_Shaders[Type] = GetShader(Type, desc.m_ShaderName[Type]);
+	}
+
+	if (!desc.BS.empty())
+		pso.blend.pBlendState = GetBlendState(desc.BS);
+	pso.blend.BlendFactor = desc.BlendFactor;
+	pso.blend.SampleMask = desc.SampleMask;
+
+	if (!desc.DSS.empty())
+		pso.depthStencil.pDepthStencilState = GetDepthStencilState(desc.DSS);
+	pso.depthStencil.StencilRef = desc.StencilRef;
+
+	if (!desc.RS.empty())
+		pso.pResterizer = GetRasterizerState(desc.RS);
+
+	if (!desc.RT.empty())
+		pso.pRenderTarget = GetRenderTarget(desc.RT);
+}
+
+void PipelineStateManager::GrowTable()
+{
+	std::vector<Slot> table(m_Table.empty() ? 64 : m_Table.size() * 2);
+	const size_t mask = table.size() - 1;
+
+	for (const auto& slot : m_Table)
+	{
+		if (slot.Index == InvalidHandle)
+			continue;
+		size_t i = MixKey(slot.Key) & mask;
+		while (table[i].Index != InvalidHandle)
+			i = (i + 1) & mask;
+		table[i] = slot;
+	}
+
+	m_Table.swap(table);
+}
+
+PipelineStateManager::Handle PipelineStateManager::CreatePSO(const PipelineStateDesc& desc)
+{
+	if ((m_PSOs.size() + 1) * 2 > m_Table.size())
+		GrowTable();
+
+	const UINT64 key = HashDesc(desc);
+	const size_t mask = m_Table.size() - 1;
+	size_t i = MixKey(key) & mask;
+	for (; m_Table[i].Index != InvalidHandle; i = (i + 1) & mask)
+	{
+		const Slot& slot = m_Table[i];
+		if (slot.Key == key && SameDesc(m_Descs[slot.Index], desc))
+			return slot.Index;
+	}
+
+	PipelineStateObject pso;
+	BuildPSO(desc, pso);
+
+	Handle handle = static_cast<Handle>(m_PSOs.size());
+	m_PSOs.push_back(pso);
+	m_Descs.push_back(desc);
+	m_Table[i].Key = key;
+	m_Table[i].Index = handle;
+	return handle;
+}
+
+const PipelineStateObject& PipelineStateManager::GetPSO(Handle handle) const
+{
+	assert(handle < m_PSOs.size());
+	return m_PSOs[handle];
+}
+
+void PipelineStateManager::Invalidate()
+{
+	m_Bound = Bound();
+	m_Current = InvalidHandle;
+}
+
+void PipelineStateManager::Apply(ID3D11DeviceContext* pContext, Handle handle)
+{
+	const PipelineStateObject& pso = GetPSO(handle);
+
+	m_Stats.Applies++;
+	if (handle == m_Current && m_Bound.Valid)
+		m_Stats.Redundant++;
+
+	auto changed = [this](bool differs) {
+		if (differs)
+			m_Stats.StateSets++;
+		else
+			m_Stats.StateSkips++;
+		return differs;
+	};
+	const bool force = !m_Bound.Valid;
+
+	// Stages the PSO has no shader for are left as they are.
+	for (int i = 0; i < NumShader; i++)
+	{
+		if (!pso.m_Shaders[i] || i == ComputeShader)
+			continue;
+
+		ID3D11DeviceChild* pShader = pso.m_Shaders[i]->m_Shader.Get();
+		if (!changed(force || m_Bound.pShaders[i] != pShader))
+			continue;
+
+		switch (static_cast<ShaderType>(i)) {
+		case VertexShader:
+			pContext->VSSetShader(static_cast<ID3D11VertexShader*>(pShader), nullptr, 0);
+			break;
+		case GeometryShader:
+			pContext->GSSetShader(static_cast<ID3D11GeometryShader*>(pShader), nullptr, 0);
+			break;
+		case PixelShader:
+			pContext->PSSetShader(static_cast<ID3D11PixelShader*>(pShader), nullptr, 0);
+			break;
+		default:
+			break;
+		}
+		m_Bound.pShaders[i] = pShader;
+	}
+
+	if (changed(force || m_Bound.pIL != pso.pIL))
+	{
+		pContext->IASetInputLayout(pso.pIL);
+		m_Bound.pIL = pso.pIL;
+	}
+
+	if (changed(force
+		|| m_Bound.blend.pBlendState != pso.blend.pBlendState
+		|| m_Bound.blend.BlendFactor != pso.blend.BlendFactor
+		|| m_Bound.blend.SampleMask != pso.blend.SampleMask))
+	{
+		pContext->OMSetBlendState(pso.blend.pBlendState, pso.blend.BlendFactor.data(), pso.blend.SampleMask);
+		m_Bound.blend = pso.blend;
+	}
+
+	if (changed(force
+		|| m_Bound.depthStencil.pDepthStencilState != pso.depthStencil.pDepthStencilState
+		|| m_Bound.depthStencil.StencilRef != pso.depthStencil.StencilRef))
+	{
+		pContext->OMSetDepthStencilState(pso.depthStencil.pDepthStencilState, pso.depthStencil.StencilRef);
+		m_Bound.depthStencil = pso.depthStencil;
+	}
+
+	if (changed(force || m_Bound.pRasterizer != pso.pResterizer))
+	{
+		pContext->RSSetState(pso.pResterizer);
+		m_Bound.pRasterizer = pso.pResterizer;
+	}
+
+	if (pso.pRenderTarget)
+		pso.pRenderTarget->Bind();
+
+	m_Bound.Valid = true;
+	m_Current = handle;
+}
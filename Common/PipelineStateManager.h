@@ -1,9 +1,142 @@
 #pragma once
 
+#include "PipelineStateObject.h"
+
+//
+// Owns the named objects a PipelineStateDesc refers to and the pipeline state
+// objects built from them.
+//
+// Blend, depth-stencil, rasterizer and sampler states are deduplicated by their
+// D3D11 description, so two names for the same description share one object.
+// A PipelineStateDesc is hashed into a 64-bit key and its PSO is kept in a flat
+// open addressing table; creating the same desc twice returns the same handle.
+// Draw code keeps the handles and Apply compares them, and the state objects
+// inside them, with what it bound last so redundant state sets are skipped.
+//
 class PipelineStateManager
 {
 public:
+	using Handle = UINT;
+	static const Handle InvalidHandle = ~0u;
+
+	struct Stats
+	{
+		UINT Applies = 0;
+		UINT Redundant = 0;		// Applies of the PSO that was already current
+		UINT StateSets = 0;
+		UINT StateSkips = 0;
+	};
+
 	PipelineStateManager() = default;
 	PipelineStateManager(const PipelineStateManager&) = delete;
 	const PipelineStateManager& operator=(PipelineStateManager&) = delete;
-};
\ No newline at end of file
+
+	void Initialize(ID3D11Device* pDevice);
+
+	ID3D11BlendState* CreateBlendState(const std::string& name, const D3D11_BLEND_DESC& desc);
+	ID3D11DepthStencilState* CreateDepthStencilState(const std::string& name, const D3D11_DEPTH_STENCIL_DESC& desc);
+	ID3D11RasterizerState* CreateRasterizerState(const std::string& name, const D3D11_RASTERIZER_DESC& desc);
+	ID3D11SamplerState* CreateSamplerState(const std::string& name, const D3D11_SAMPLER_DESC& desc);
+
+	void AddInputLayout(const std::string& name, Microsoft::WRL::ComPtr<ID3D11InputLayout> pLayout);
+	void AddShader(ShaderPtr shader);
+	void AddRenderTarget(const std::string& name, RenderTargetPtr target);
+
+	ID3D11BlendState* GetBlendState(const std::string& name) const;
+	ID3D11DepthStencilState* GetDepthStencilState(const std::string& name) const;
+	ID3D11RasterizerState* GetRasterizerState(const std::string& name) const;
+	ID3D11SamplerState* GetSamplerState(const std::string& name) const;
+	ID3D11InputLayout* GetInputLayout(const std::string& name) const;
+	ShaderPtr GetShader(ShaderType type, const std::string& name) const;
+	RenderTarget* GetRenderTarget(const std::string& name) const;
+
+	///<summary>
+	/// Returns the handle of the PSO for desc, building it the first time a desc
+	/// with these contents is seen.  Every name in desc must already be registered.
+	///</summary>
+	Handle CreatePSO(const PipelineStateDesc& desc);
+
+	const PipelineStateObject& GetPSO(Handle handle) const;
+	Handle GetCurrent() const { return m_Current; }
+
+	///<summary>
+	/// Binds the PSO, skipping every state that is already bound.  The render target
+	/// is bound on each call because binding it also clears it.
+	///</summary>
+	void Apply(ID3D11DeviceContext* pContext, Handle handle);
+
+	///<summary>
+	/// Forgets what is bound.  Call after state has been set behind the manager's
+	/// back, e.g. by an effect or a third party renderer.
+	///</summary>
+	void Invalidate();
+
+	const Stats& GetStats() const { return m_Stats; }
+	void ResetStats() { m_Stats = Stats(); }
+
+	static UINT64 HashDesc(const PipelineStateDesc& desc);
+
+private:
+	template <typename Desc, typename State>
+	struct StateEntry
+	{
+		UINT64 Key;
+		Desc Description;
+		Microsoft::WRL::ComPtr<State> pState;
+	};
+
+	template <typename Desc, typename State, typename CreateFn>
+	State* Deduplicate(std::vector<StateEntry<Desc, State>>& entries,
+		std::unordered_map<std::string, State*>& names,
+		const std::string& name, const Desc& desc, CreateFn create);
+
+	template <typename State>
+	static State* Find(const std::unordered_map<std::string, State*>& names, const std::string& name);
+
+	static bool SameDesc(const PipelineStateDesc& a, const PipelineStateDesc& b);
+	void BuildPSO(const PipelineStateDesc& desc, PipelineStateObject& pso) const;
+	void GrowTable();
+
+	struct Slot
+	{
+		UINT64 Key = 0;
+		Handle Index = InvalidHandle;
+	};
+
+	struct Bound
+	{
+		bool Valid = false;
+		ID3D11InputLayout* pIL = nullptr;
+		ID3D11DeviceChild* pShaders[NumShader] = {};
+		BlendState blend;
+		DepthStencilState depthStencil;
+		ID3D11RasterizerState* pRasterizer = nullptr;
+	};
+
+	ID3D11Device* m_pDevice = nullptr;
+
+	std::vector<StateEntry<D3D11_BLEND_DESC, ID3D11BlendState>> m_BlendStates;
+	std::vector<StateEntry<D3D11_DEPTH_STENCIL_DESC, ID3D11DepthStencilState>> m_DepthStencilStates;
+	std::vector<StateEntry<D3D11_RASTERIZER_DESC, ID3D11RasterizerState>> m_RasterizerStates;
+	std::vector<StateEntry<D3D11_SAMPLER_DESC, ID3D11SamplerState>> m_SamplerStates;
+
+	std::unordered_map<std::string, ID3D11BlendState*> m_BlendNames;
+	std::unordered_map<std::string, ID3D11DepthStencilState*> m_DepthStencilNames;
+	std::unordered_map<std::string, ID3D11RasterizerState*> m_RasterizerNames;
+	std::unordered_map<std::string, ID3D11SamplerState*> m_SamplerNames;
+	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11InputLayout>> m_InputLayouts;
+	std::unordered_map<std::string, ShaderPtr> m_Shaders[NumShader];
+	std::unordered_map<std::string, RenderTargetPtr> m_RenderTargets;
+
+	// PSOs by handle, with the desc each was built from to resolve key collisions.
+	std::vector<PipelineStateObject> m_PSOs;
+	std::vector<PipelineStateDesc> m_Descs;
+
+	// Open addressing with linear probing; the size is a power of two, kept at
+	// most half full.
+	std::vector<Slot> m_Table;
+
+	Handle m_Current = InvalidHandle;
+	Bound m_Bound;
+	Stats m_Stats;
+};
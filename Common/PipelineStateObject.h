@@ -57,5 +57,5 @@ struct PipelineStateObject
 	ID3D11RasterizerState* pResterizer = nullptr;
 	RenderTarget* pRenderTarget = nullptr;
 	int nSamplerCount = 0;
-	ID3D11SamplerState* pSamplerStates[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+	ID3D11SamplerState* pSamplerStates[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT] = {};
 };
\ No newline at end of file
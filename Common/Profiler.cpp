@@ -0,0 +1,290 @@
+//***************************************************************************************
+// Profiler.cpp
+//***************************************************************************************
+
+#include "Profiler.h"
+
+#if PROFILER_ENABLED
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+// Single producer (the owning thread), single consumer (EndFrame) ring of zones.
+struct Profiler::ThreadBuffer
+{
+	static const UINT Capacity = 1 << 16;
+
+	ThreadBuffer(UINT threadId)
+	: Events(Capacity), Head(0), Tail(0), InUse(true), Dropped(0), ThreadId(threadId)
+	{
+	}
+
+	std::vector<Event> Events;
+
+	// Written by the owner and by EndFrame respectively; both only grow.
+	std::atomic<UINT> Head;
+	std::atomic<UINT> Tail;
+
+	// Cleared when the owning thread exits so another thread can take the buffer.
+	std::atomic<bool> InUse;
+
+	std::atomic<UINT> Dropped;
+	UINT ThreadId;
+};
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const Clock::time_point gEpoch = Clock::now();
+
+	struct ThreadSlot
+	{
+		ThreadSlot() : Buffer(0), Depth(0) {}
+
+		~ThreadSlot()
+		{
+			if( Buffer )
+				Buffer->InUse.store(false, std::memory_order_release);
+		}
+
+		Profiler::ThreadBuffer* Buffer;
+		UINT Depth;
+	};
+
+	thread_local ThreadSlot gThreadSlot;
+
+	void WriteJsonString(std::ostream& outs, const char* s)
+	{
+		outs << '"';
+		for(; *s; ++s)
+		{
+			if( *s == '"' || *s == '\\' )
+				outs << '\\' << *s;
+			else if( (unsigned char)*s >= 0x20 )
+				outs << *s;
+		}
+		outs << '"';
+	}
+}
+
+Profiler& Profiler::Get()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+UINT64 Profiler::NowNs()
+{
+	return (UINT64)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - gEpoch).count();
+}
+
+UINT& Profiler::ThreadDepth()
+{
+	return gThreadSlot.Depth;
+}
+
+Profiler::Profiler()
+: mEnabled(true), mFrameBeginNs(NowNs()), mLastFrameMs(0.0), mCaptureFramesLeft(0)
+{
+}
+
+Profiler::~Profiler()
+{
+}
+
+void Profiler::SetEnabled(bool enabled)
+{
+	mEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Profiler::IsEnabled()const
+{
+	return mEnabled.load(std::memory_order_relaxed);
+}
+
+Profiler::ThreadBuffer* Profiler::AcquireThreadBuffer()
+{
+	std::lock_guard<std::mutex> lock(mBufferMutex);
+
+	// Threads outside the Parallel::For pool come and go; reuse the buffers of finished ones.
+	for(size_t i = 0; i < mThreadBuffers.size(); ++i)
+	{
+		bool expected = false;
+		if( mThreadBuffers[i]->InUse.compare_exchange_strong(expected, true, std::memory_order_acquire) )
+			return mThreadBuffers[i].get();
+	}
+
+	mThreadBuffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer((UINT)mThreadBuffers.size())));
+	return mThreadBuffers.back().get();
+}
+
+void Profiler::Record(const char* name, UINT64 beginNs, UINT64 endNs, UINT depth)
+{
+	ThreadBuffer* buffer = gThreadSlot.Buffer;
+	if( !buffer )
+		buffer = gThreadSlot.Buffer = AcquireThreadBuffer();
+
+	UINT head = buffer->Head.load(std::memory_order_relaxed);
+	UINT tail = buffer->Tail.load(std::memory_order_acquire);
+	if( head - tail >= ThreadBuffer::Capacity )
+	{
+		buffer->Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	Event& e = buffer->Events[head & (ThreadBuffer::Capacity - 1)];
+	e.Name     = name;
+	e.BeginNs  = beginNs;
+	e.EndNs    = endNs;
+	e.Depth    = depth;
+	e.ThreadId = buffer->ThreadId;
+
+	buffer->Head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::Accumulate(const Event& e)
+{
+	double ms = (e.EndNs - e.BeginNs)*1.0e-6;
+
+	for(size_t i = 0; i < mFrameStats.size(); ++i)
+	{
+		ZoneStats& s = mFrameStats[i];
+		if( s.Depth == e.Depth && (s.Name == e.Name || strcmp(s.Name, e.Name) == 0) )
+		{
+			++s.Calls;
+			s.TotalMs += ms;
+			return;
+		}
+	}
+
+	ZoneStats s = { e.Name, e.Depth, 1, ms };
+	mFrameStats.push_back(s);
+}
+
+void Profiler::EndFrame()
+{
+	UINT64 endNs = NowNs();
+	mFrameStats.clear();
+
+	// Zones are recorded when they end, so inner zones come before outer ones;
+	// order the frame's zones by their start instead.
+	std::vector<Event> events;
+	{
+		std::lock_guard<std::mutex> lock(mBufferMutex);
+		for(size_t i = 0; i < mThreadBuffers.size(); ++i)
+		{
+			ThreadBuffer& b = *mThreadBuffers[i];
+
+			UINT tail = b.Tail.load(std::memory_order_relaxed);
+			UINT head = b.Head.load(std::memory_order_acquire);
+			for(; tail != head; ++tail)
+				events.push_back(b.Events[tail & (ThreadBuffer::Capacity - 1)]);
+
+			b.Tail.store(tail, std::memory_order_release);
+		}
+	}
+
+	std::sort(events.begin(), events.end(),
+		[](const Event& a, const Event& b) { return a.BeginNs < b.BeginNs; });
+
+	for(size_t i = 0; i < events.size(); ++i)
+		Accumulate(events[i]);
+
+	mLastFrameStats.swap(mFrameStats);
+	mLastFrameMs = (endNs - mFrameBeginNs)*1.0e-6;
+
+	if( mCaptureFramesLeft > 0 )
+	{
+		Event frame = { "Frame", mFrameBeginNs, endNs, 0, gThreadSlot.Buffer ? gThreadSlot.Buffer->ThreadId : 0 };
+		mCapture.push_back(frame);
+		mCapture.insert(mCapture.end(), events.begin(), events.end());
+
+		if( --mCaptureFramesLeft == 0 )
+		{
+			WriteChromeTrace(mCaptureFilename);
+			mCapture.clear();
+		}
+	}
+
+	mFrameBeginNs = endNs;
+}
+
+const std::vector<Profiler::ZoneStats>& Profiler::LastFrameStats()const
+{
+	return mLastFrameStats;
+}
+
+double Profiler::LastFrameMs()const
+{
+	return mLastFrameMs;
+}
+
+std::string Profiler::FormatFrameStats()const
+{
+	std::ostringstream outs;
+	outs.precision(3);
+	outs << std::fixed << "frame " << mLastFrameMs << " ms\n";
+
+	for(size_t i = 0; i < mLastFrameStats.size(); ++i)
+	{
+		const ZoneStats& s = mLastFrameStats[i];
+		outs << std::string(2*(s.Depth + 1), ' ') << s.Name << " " << s.TotalMs << " ms";
+		if( s.Calls > 1 )
+			outs << " (" << s.Calls << " calls)";
+		outs << "\n";
+	}
+
+	return outs.str();
+}
+
+void Profiler::CaptureFrames(UINT frameCount, const std::string& filename)
+{
+	mCaptureFramesLeft = frameCount;
+	mCaptureFilename = filename;
+	mCapture.clear();
+}
+
+bool Profiler::IsCapturing()const
+{
+	return mCaptureFramesLeft > 0;
+}
+
+UINT Profiler::DroppedZones()const
+{
+	std::lock_guard<std::mutex> lock(mBufferMutex);
+
+	UINT dropped = 0;
+	for(size_t i = 0; i < mThreadBuffers.size(); ++i)
+		dropped += mThreadBuffers[i]->Dropped.load(std::memory_order_relaxed);
+
+	return dropped;
+}
+
+bool Profiler::WriteChromeTrace(const std::string& filename)const
+{
+	std::ofstream fout(filename.c_str());
+	if( !fout )
+		return false;
+
+	// Complete ("X") events; timestamps and durations are in microseconds.
+	fout.precision(3);
+	fout << std::fixed << "{\"traceEvents\":[\n";
+	for(size_t i = 0; i < mCapture.size(); ++i)
+	{
+		const Event& e = mCapture[i];
+		fout << (i > 0 ? ",\n" : "") << "{\"name\":";
+		WriteJsonString(fout, e.Name);
+		fout << ",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":" << e.BeginNs*1.0e-3
+			<< ",\"dur\":" << (e.EndNs - e.BeginNs)*1.0e-3
+			<< ",\"pid\":1,\"tid\":" << e.ThreadId << "}";
+	}
+	fout << "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+	return (bool)fout;
+}
+
+#endif // PROFILER_ENABLED
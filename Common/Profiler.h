@@ -0,0 +1,173 @@
+//***************************************************************************************
+// Profiler.h
+//
+// Hierarchical CPU profiler.  PROFILE_ZONE("name") times the enclosing scope; zones
+// nest, and each thread records its zones into its own buffer without taking a
+// lock.  Once per frame D3DApp calls EndFrame, which drains every thread's buffer
+// into per zone totals for that frame and, while a capture is running, into a list
+// of events written out in the Chrome trace format (load in chrome://tracing).
+//
+// Zone names must be string literals (or otherwise outlive the profiler).
+//
+// Define PROFILER_ENABLED to 0 to compile all of it out; the macros then expand to
+// nothing.
+//***************************************************************************************
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#if PROFILER_ENABLED
+
+#include "MathHelper.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Profiler
+{
+public:
+	struct ZoneStats
+	{
+		const char* Name;
+
+		// Nesting level on the thread that ran the zone; 0 for outermost.
+		UINT Depth;
+
+		UINT Calls;
+		double TotalMs;
+	};
+
+	// Per thread storage; opaque outside Profiler.cpp.
+	struct ThreadBuffer;
+
+	static Profiler& Get();
+
+	// Nanoseconds since the profiler was created.
+	static UINT64 NowNs();
+
+	void SetEnabled(bool enabled);
+	bool IsEnabled()const;
+
+	///<summary>
+	/// Records a finished zone for the calling thread.  Used by ProfileZone.
+	///</summary>
+	void Record(const char* name, UINT64 beginNs, UINT64 endNs, UINT depth);
+
+	///<summary>
+	/// Closes the frame: collects the zones every thread recorded since the last
+	/// call.  Call once per frame from the main thread.
+	///</summary>
+	void EndFrame();
+
+	// Zones of the last closed frame, in the order they first started.
+	const std::vector<ZoneStats>& LastFrameStats()const;
+	double LastFrameMs()const;
+	std::string FormatFrameStats()const;
+
+	///<summary>
+	/// Keeps every zone of the next frameCount frames and writes them to filename
+	/// as a Chrome trace once the last one ends.
+	///</summary>
+	void CaptureFrames(UINT frameCount, const std::string& filename);
+	bool IsCapturing()const;
+
+	// Zones lost because a thread's buffer was full.
+	UINT DroppedZones()const;
+
+	// Current nesting level of the calling thread, for ProfileZone.
+	static UINT& ThreadDepth();
+
+private:
+	Profiler();
+	~Profiler();
+	Profiler(const Profiler& rhs);
+	Profiler& operator=(const Profiler& rhs);
+
+	struct Event
+	{
+		const char* Name;
+		UINT64 BeginNs;
+		UINT64 EndNs;
+		UINT Depth;
+		UINT ThreadId;
+	};
+
+	ThreadBuffer* AcquireThreadBuffer();
+	void Accumulate(const Event& e);
+	bool WriteChromeTrace(const std::string& filename)const;
+
+private:
+	std::atomic<bool> mEnabled;
+
+	// Guards mThreadBuffers; taken only when a thread records its first zone and
+	// once per frame by EndFrame.
+	mutable std::mutex mBufferMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> mThreadBuffers;
+
+	UINT64 mFrameBeginNs;
+	double mLastFrameMs;
+	std::vector<ZoneStats> mFrameStats;
+	std::vector<ZoneStats> mLastFrameStats;
+
+	UINT mCaptureFramesLeft;
+	std::string mCaptureFilename;
+	std::vector<Event> mCapture;
+};
+
+///<summary>
+/// Times its own lifetime as a zone.
+///</summary>
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* name)
+	: mName(Profiler::Get().IsEnabled() ? name : 0), mBeginNs(0)
+	{
+		if( mName )
+		{
+			mBeginNs = Profiler::NowNs();
+			++Profiler::ThreadDepth();
+		}
+	}
+
+	~ProfileZone()
+	{
+		if( mName )
+		{
+			UINT depth = --Profiler::ThreadDepth();
+			Profiler::Get().Record(mName, mBeginNs, Profiler::NowNs(), depth);
+		}
+	}
+
+private:
+	ProfileZone(const ProfileZone& rhs);
+	ProfileZone& operator=(const ProfileZone& rhs);
+
+	const char* mName;
+	UINT64 mBeginNs;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_END_FRAME() Profiler::Get().EndFrame()
+#define PROFILE_CAPTURE(frameCount, filename) Profiler::Get().CaptureFrames(frameCount, filename)
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_END_FRAME() ((void)0)
+#define PROFILE_CAPTURE(frameCount, filename) ((void)0)
+
+#endif // PROFILER_ENABLED
+
+#endif // PROFILER_H
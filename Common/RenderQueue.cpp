@@ -0,0 +1,637 @@
+//***************************************************************************************
+// RenderQueue.cpp
+//***************************************************************************************
+
+#include "RenderQueue.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+	const UINT RadixBits    = 11;
+	const UINT RadixBuckets = 1 << RadixBits;
+	const UINT RadixPasses  = (64 + RadixBits - 1)/RadixBits;
+
+	// Digit widths for sorting packed values, chosen per range for about one
+	// value per bucket.
+	const UINT MinDigitBits = 4;
+	const UINT MaxDigitBits = 16;
+
+	// Ranges smaller than this are only insertion sorted.
+	const UINT SmallBucket = 32;
+
+	// The first digit of a layer is capped lower: clearing and summing a larger
+	// histogram costs more than the deeper passes it saves.
+	const UINT TopDigitBits = 14;
+
+	// The last frame's order is only repaired when at most one entry in this many
+	// is out of place, and at most this many moves per entry are spent on it.
+	const UINT MaxDescentFraction = 32;
+	const UINT MaxMovesPerEntry   = 2;
+
+	UINT64 FieldMask(UINT bits)
+	{
+		return bits < 64 ? (UINT64(1) << bits) - 1 : ~UINT64(0);
+	}
+
+	// Where the varying bits of a layer's keys go in its packed sort values: the
+	// bits below the widest run of bits that is the same in every key, and the bits
+	// above it.  In a BackToFront layer that run is usually the pipeline field
+	// between depth and material.
+	struct KeyPacking
+	{
+		UINT LowShift;
+		UINT64 LowMask;
+		UINT HighShift;
+		UINT64 HighMask;
+		UINT HighOffset;
+		UINT Bits;
+	};
+
+	KeyPacking BuildKeyPacking(UINT64 varying)
+	{
+		KeyPacking packing = { 0, 0, 0, 0, 0, 0 };
+		if( varying == 0 )
+			return packing;
+
+		UINT lo = 0;
+		while( ((varying >> lo) & 1) == 0 )
+			++lo;
+
+		UINT hi = 63;
+		while( ((varying >> hi) & 1) == 0 )
+			--hi;
+
+		UINT gapFirst = hi + 1;
+		UINT gapEnd   = hi + 1;
+		UINT runFirst = lo + 1;
+		for(UINT bit = lo + 1; bit <= hi; ++bit)
+		{
+			if( ((varying >> bit) & 1) == 0 )
+				continue;
+
+			if( bit - runFirst > gapEnd - gapFirst )
+			{
+				gapFirst = runFirst;
+				gapEnd   = bit;
+			}
+			runFirst = bit + 1;
+		}
+
+		packing.LowShift   = lo;
+		packing.LowMask    = FieldMask(gapFirst - lo);
+		packing.HighShift  = gapEnd < 64 ? gapEnd : 0;
+		packing.HighMask   = FieldMask(hi + 1 - gapEnd);
+		packing.HighOffset = gapFirst - lo;
+		packing.Bits       = (gapFirst - lo) + (hi + 1 - gapEnd);
+
+		return packing;
+	}
+
+	// Sorts values whose bits from lowBit up to topBit, exclusive, are the key, by
+	// the key; the values are unique, so the order is complete.  One radix pass on
+	// the top digit leaves about one value per bucket; larger buckets take the next
+	// digit the same way, and one insertion sort over the range then orders the
+	// rest, moving values only within their bucket.  histogram is used from
+	// histogramBase on.
+	void RadixSortValues(UINT64* values, UINT64* scratch, UINT n, UINT topBit, UINT lowBit,
+		std::vector<UINT>& histogram, UINT histogramBase)
+	{
+		if( n >= SmallBucket && topBit > lowBit )
+		{
+			UINT digitBits = MinDigitBits;
+			while( digitBits < MaxDigitBits && (1u << digitBits) < n )
+				++digitBits;
+			digitBits = MathHelper::Min(digitBits, topBit - lowBit);
+
+			UINT shift = topBit - digitBits;
+			UINT bucketCount = 1 << digitBits;
+			UINT digitMask = bucketCount - 1;
+
+			if( histogram.size() < histogramBase + bucketCount )
+				histogram.resize(histogramBase + bucketCount);
+
+			UINT* next = &histogram[histogramBase];
+			memset(next, 0, bucketCount*sizeof(UINT));
+
+			for(UINT i = 0; i < n; ++i)
+				++next[(values[i] >> shift) & digitMask];
+
+			UINT offset = 0;
+			for(UINT b = 0; b < bucketCount; ++b)
+			{
+				UINT c = next[b];
+				next[b] = offset;
+				offset += c;
+			}
+
+			for(UINT i = 0; i < n; ++i)
+				scratch[next[(values[i] >> shift) & digitMask]++] = values[i];
+
+			memcpy(values, scratch, n*sizeof(UINT64));
+
+			// Each bucket's entry now holds where the bucket ends.  The deeper passes
+			// may move the histogram, so it is indexed afresh each time.
+			UINT first = 0;
+			for(UINT b = 0; b < bucketCount; ++b)
+			{
+				UINT end = histogram[histogramBase + b];
+				if( end - first >= SmallBucket )
+				{
+					RadixSortValues(values + first, scratch + first, end - first, shift, lowBit,
+						histogram, histogramBase + bucketCount);
+				}
+				first = end;
+			}
+		}
+
+		for(UINT i = 1; i < n; ++i)
+		{
+			UINT64 v = values[i];
+			UINT j = i;
+			for(; j > 0 && values[j - 1] > v; --j)
+				values[j] = values[j - 1];
+			values[j] = v;
+		}
+	}
+
+	const char* BindSlotName(UINT slot)
+	{
+		static const char* names[] = { "topology", "vertex buffer", "index buffer",
+			"object cb", "material cb", "srv" };
+		return names[slot];
+	}
+}
+
+RenderQueue::RenderQueue()
+: mIncremental(true), mWasIncremental(false), mHasOrder(false), mLastSortMs(0.0)
+{
+	Clear();
+}
+
+RenderQueue::~RenderQueue()
+{
+}
+
+UINT RenderQueue::QuantizeDepth(float depth, float nearZ, float farZ)
+{
+	float t = (depth - nearZ)/(farZ - nearZ);
+	t = MathHelper::Clamp(t, 0.0f, 1.0f);
+
+	return (UINT)(t*(float)FieldMask(DepthBits));
+}
+
+UINT64 RenderQueue::BuildKey(UINT layer, UINT pipeline, UINT material, UINT geometry,
+	float depth, float nearZ, float farZ, SortOrder order)
+{
+	UINT64 d = QuantizeDepth(depth, nearZ, farZ);
+
+	UINT64 key = layer & FieldMask(LayerBits);
+
+	if( order == BackToFront )
+	{
+		key = (key << DepthBits)    | (FieldMask(DepthBits) - d);
+		key = (key << PipelineBits) | (pipeline & FieldMask(PipelineBits));
+		key = (key << MaterialBits) | (material & FieldMask(MaterialBits));
+		key = (key << GeometryBits) | (geometry & FieldMask(GeometryBits));
+	}
+	else
+	{
+		key = (key << PipelineBits) | (pipeline & FieldMask(PipelineBits));
+		key = (key << MaterialBits) | (material & FieldMask(MaterialBits));
+		key = (key << GeometryBits) | (geometry & FieldMask(GeometryBits));
+		key = (key << DepthBits)    | d;
+	}
+
+	return key;
+}
+
+UINT RenderQueue::KeyLayer(UINT64 key)
+{
+	return (UINT)(key >> (64 - LayerBits));
+}
+
+void RenderQueue::Clear()
+{
+	mEntries.clear();
+
+	for(UINT i = 0; i <= MaxLayers; ++i)
+		mLayerFirst[i] = 0;
+
+	for(UINT i = 0; i < BindSlotCount; ++i)
+	{
+		mBindsIssued[i]  = 0;
+		mBindsAvoided[i] = 0;
+	}
+
+	InvalidateBindings();
+}
+
+void RenderQueue::Submit(UINT64 key, UINT item)
+{
+	Entry e = { key, item };
+	mEntries.push_back(e);
+}
+
+void RenderQueue::Sort()
+{
+	PROFILE_FUNCTION();
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	UINT n = (UINT)mEntries.size();
+	mScratch.resize(n);
+
+	// Draws change little from frame to frame, so a queue of the same size first
+	// tries the order of the last sort.
+	bool reuse = mIncremental && mHasOrder && mOrder.size() == n;
+	mWasIncremental = reuse && SortIncremental();
+	if( mWasIncremental )
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		mLastSortMs = elapsed.count();
+		return;
+	}
+
+	// The size of each layer, and the key bits in which its keys differ.  Layer
+	// and pipeline usually take only a few values and depth is in a different place
+	// for each order, so a layer's keys differ in far fewer bits than all keys do.
+	UINT64 firstKey[MaxLayers];
+	UINT64 varying[MaxLayers];
+	UINT count[MaxLayers];
+	for(UINT l = 0; l < MaxLayers; ++l)
+	{
+		varying[l] = 0;
+		count[l] = 0;
+	}
+
+	// Applications submit a layer at a time, so the keys are read in runs of one
+	// layer, keeping the running state out of memory.
+	for(UINT i = 0; i < n; )
+	{
+		UINT64 runKey = mEntries[i].Key;
+		UINT l = KeyLayer(runKey);
+
+		UINT64 runVarying = 0;
+		UINT end = i + 1;
+		for(; end < n && KeyLayer(mEntries[end].Key) == l; ++end)
+			runVarying |= mEntries[end].Key ^ runKey;
+
+		if( count[l] == 0 )
+			firstKey[l] = runKey;
+		varying[l] |= runVarying | (runKey ^ firstKey[l]);
+		count[l] += end - i;
+		i = end;
+	}
+
+	// Layers are the top bits, so each one is a contiguous run of the sorted keys.
+	mLayerFirst[0] = 0;
+	for(UINT l = 0; l < MaxLayers; ++l)
+		mLayerFirst[l + 1] = mLayerFirst[l] + count[l];
+
+	if( !SortPacked(varying) )
+		SortEntries();
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	mLastSortMs = elapsed.count();
+}
+
+bool RenderQueue::SortPacked(const UINT64 varying[MaxLayers])
+{
+	UINT n = (UINT)mEntries.size();
+
+	UINT indexBits = 0;
+	while( (UINT64(1) << indexBits) < n )
+		++indexBits;
+
+	// Each layer's top digit is sized for a few values per bucket, and its
+	// histogram gets its own stretch of mHistogram.
+	KeyPacking packing[MaxLayers];
+	UINT digitShift[MaxLayers];
+	UINT histogramFirst[MaxLayers + 1];
+	histogramFirst[0] = 0;
+	for(UINT l = 0; l < MaxLayers; ++l)
+	{
+		packing[l] = BuildKeyPacking(varying[l]);
+		if( packing[l].Bits + indexBits > 64 )
+			return false;
+
+		UINT layerCount = mLayerFirst[l + 1] - mLayerFirst[l];
+		UINT digitBits = 0;
+		if( layerCount > 1 && packing[l].Bits > 0 )
+		{
+			digitBits = MinDigitBits;
+			while( digitBits < TopDigitBits && (1u << digitBits) < layerCount )
+				++digitBits;
+			digitBits = MathHelper::Min(digitBits, packing[l].Bits);
+		}
+
+		digitShift[l] = indexBits + packing[l].Bits - digitBits;
+		histogramFirst[l + 1] = histogramFirst[l] + (layerCount > 0 ? 1u << digitBits : 0);
+	}
+
+	mPacked.resize(n);
+	mPackedScratch.resize(n);
+	mOrder.resize(n);
+	mHistogram.assign(histogramFirst[MaxLayers], 0);
+
+	// Each entry becomes the varying bits of its key above its index, placed in
+	// its layer's run, and is counted in its layer's histogram on the way.  The
+	// values are unique, so sorting them by the key bits alone keeps equal keys
+	// in submission order.
+	UINT next[MaxLayers];
+	for(UINT l = 0; l < MaxLayers; ++l)
+		next[l] = mLayerFirst[l];
+
+	UINT* histogram = mHistogram.data();
+	for(UINT i = 0; i < n; )
+	{
+		UINT l = KeyLayer(mEntries[i].Key);
+		KeyPacking p = packing[l];
+		UINT shift = digitShift[l];
+		UINT* counts = histogram + histogramFirst[l];
+		UINT64* dst = mPacked.data() + next[l];
+
+		UINT end = i;
+		for(; end < n && KeyLayer(mEntries[end].Key) == l; ++end)
+		{
+			UINT64 key = mEntries[end].Key;
+			UINT64 v = ((key >> p.LowShift) & p.LowMask) | (((key >> p.HighShift) & p.HighMask) << p.HighOffset);
+			v = (v << indexBits) | end;
+
+			*dst++ = v;
+			++counts[v >> shift];
+		}
+
+		next[l] += end - i;
+		i = end;
+	}
+
+	UINT64 indexMask = FieldMask(indexBits);
+
+	for(UINT l = 0; l < MaxLayers; ++l)
+	{
+		UINT first = mLayerFirst[l];
+		UINT layerCount = mLayerFirst[l + 1] - first;
+		if( layerCount == 0 )
+			continue;
+
+		// One scatter by the top digit, after which each bucket entry holds where
+		// the bucket ends.
+		UINT* counts = histogram + histogramFirst[l];
+		UINT bucketCount = histogramFirst[l + 1] - histogramFirst[l];
+		UINT offset = 0;
+		UINT maxBucket = 0;
+		for(UINT b = 0; b < bucketCount; ++b)
+		{
+			UINT c = counts[b];
+			counts[b] = offset;
+			offset += c;
+			maxBucket = MathHelper::Max(maxBucket, c);
+		}
+
+		const UINT64* src = mPacked.data() + first;
+		UINT64* sorted = mPackedScratch.data() + first;
+		UINT shift = digitShift[l];
+		for(UINT i = 0; i < layerCount; ++i)
+			sorted[counts[src[i] >> shift]++] = src[i];
+
+		// Buckets big enough to be worth it take more radix passes on the digits
+		// below; after that one insertion sort over the layer moves values only
+		// within their bucket.  Each bucket entry now holds where the bucket ends.
+		if( maxBucket >= SmallBucket )
+		{
+			UINT begin = 0;
+			for(UINT b = 0; b < bucketCount; ++b)
+			{
+				UINT end = histogram[histogramFirst[l] + b];
+				if( end - begin >= SmallBucket )
+				{
+					RadixSortValues(sorted + begin, mPacked.data() + first + begin, end - begin, shift, indexBits,
+						mHistogram, histogramFirst[MaxLayers]);
+					histogram = mHistogram.data();
+				}
+				begin = end;
+			}
+		}
+
+		for(UINT i = 1; i < layerCount; ++i)
+		{
+			UINT64 v = sorted[i];
+			UINT j = i;
+			for(; j > 0 && sorted[j - 1] > v; --j)
+				sorted[j] = sorted[j - 1];
+			sorted[j] = v;
+		}
+
+		UINT* order = mOrder.data() + first;
+		for(UINT i = 0; i < layerCount; ++i)
+		{
+			order[i] = (UINT)(sorted[i] & indexMask);
+			mScratch[first + i] = mEntries[order[i]];
+		}
+	}
+
+	mEntries.swap(mScratch);
+	mHasOrder = true;
+	return true;
+}
+
+bool RenderQueue::SortIncremental()
+{
+	UINT n = (UINT)mEntries.size();
+
+	// The entries are gathered in the old order, and each one that is out of
+	// place is moved back as in an insertion sort.  Equal keys must stay in
+	// submission order, so an entry is also out of place after an equal key
+	// submitted later.  The order is still a permutation when this gives up.
+	UINT* order = mOrder.data();
+	Entry* sorted = mScratch.data();
+	UINT maxMisplaced = n/MaxDescentFraction;
+	UINT64 budget = (UINT64)n*MaxMovesPerEntry;
+	UINT misplaced = 0;
+	UINT64 moves = 0;
+	for(UINT k = 0; k < n; ++k)
+	{
+		UINT index = order[k];
+		Entry e = mEntries[index];
+
+		UINT j = k;
+		while( j > 0 && (sorted[j - 1].Key > e.Key || (sorted[j - 1].Key == e.Key && order[j - 1] > index)) )
+		{
+			sorted[j] = sorted[j - 1];
+			order[j]  = order[j - 1];
+			--j;
+		}
+		sorted[j] = e;
+		order[j]  = index;
+
+		if( j < k )
+		{
+			++misplaced;
+			moves += k - j;
+			if( misplaced > maxMisplaced || moves > budget )
+				return false;
+		}
+	}
+
+	// Layers are the top bits, so each one starts at the first key of its value.
+	for(UINT l = 0; l < MaxLayers; ++l)
+	{
+		UINT64 layerKey = (UINT64)l << (64 - LayerBits);
+		mLayerFirst[l] = (UINT)(std::lower_bound(sorted, sorted + n, layerKey,
+			[](const Entry& e, UINT64 key) { return e.Key < key; }) - sorted);
+	}
+	mLayerFirst[MaxLayers] = n;
+
+	mEntries.swap(mScratch);
+	return true;
+}
+
+void RenderQueue::SortEntries()
+{
+	UINT n = (UINT)mEntries.size();
+
+	// The entries are moved without their submission index, so the next frame
+	// cannot start from this order.
+	mHasOrder = false;
+
+	// Digits in which no two keys differ do not reorder anything.
+	UINT64 varying = 0;
+	for(UINT i = 1; i < n; ++i)
+		varying |= mEntries[i].Key ^ mEntries[0].Key;
+
+	UINT passes[RadixPasses];
+	UINT passCount = 0;
+	for(UINT p = 0; p < RadixPasses; ++p)
+	{
+		if( (varying >> (p*RadixBits)) & (RadixBuckets - 1) )
+			passes[passCount++] = p;
+	}
+
+	// The histograms of all the passes in one read of the keys.
+	mHistogram.assign(passCount*RadixBuckets, 0);
+
+	for(UINT i = 0; i < n; ++i)
+	{
+		UINT64 key = mEntries[i].Key;
+		for(UINT j = 0; j < passCount; ++j)
+			++mHistogram[j*RadixBuckets + ((key >> (passes[j]*RadixBits)) & (RadixBuckets - 1))];
+	}
+
+	Entry* src = mEntries.data();
+	Entry* dst = mScratch.data();
+
+	for(UINT j = 0; j < passCount; ++j)
+	{
+		UINT* count = &mHistogram[j*RadixBuckets];
+		UINT shift = passes[j]*RadixBits;
+
+		UINT offset = 0;
+		for(UINT b = 0; b < RadixBuckets; ++b)
+		{
+			UINT c = count[b];
+			count[b] = offset;
+			offset += c;
+		}
+
+		for(UINT i = 0; i < n; ++i)
+			dst[count[(src[i].Key >> shift) & (RadixBuckets - 1)]++] = src[i];
+
+		std::swap(src, dst);
+	}
+
+	if( src != mEntries.data() )
+		memcpy(mEntries.data(), src, n*sizeof(Entry));
+}
+
+UINT RenderQueue::Size()const
+{
+	return (UINT)mEntries.size();
+}
+
+const RenderQueue::Entry& RenderQueue::operator[](UINT i)const
+{
+	return mEntries[i];
+}
+
+void RenderQueue::GetLayerRange(UINT layer, UINT& first, UINT& count)const
+{
+	layer = MathHelper::Min(layer, (UINT)MaxLayers - 1);
+
+	first = mLayerFirst[layer];
+	count = mLayerFirst[layer + 1] - first;
+}
+
+bool RenderQueue::NeedsBind(BindSlot slot, UINT64 id)
+{
+	if( mBoundValid[slot] && mBound[slot] == id )
+	{
+		++mBindsAvoided[slot];
+		return false;
+	}
+
+	mBound[slot] = id;
+	mBoundValid[slot] = true;
+	++mBindsIssued[slot];
+	return true;
+}
+
+void RenderQueue::InvalidateBindings()
+{
+	for(UINT i = 0; i < BindSlotCount; ++i)
+	{
+		mBound[i] = 0;
+		mBoundValid[i] = false;
+	}
+}
+
+UINT RenderQueue::BindsIssued(BindSlot slot)const
+{
+	return mBindsIssued[slot];
+}
+
+UINT RenderQueue::BindsAvoided(BindSlot slot)const
+{
+	return mBindsAvoided[slot];
+}
+
+UINT RenderQueue::TotalBindsAvoided()const
+{
+	UINT total = 0;
+	for(UINT i = 0; i < BindSlotCount; ++i)
+		total += mBindsAvoided[i];
+
+	return total;
+}
+
+void RenderQueue::SetIncremental(bool incremental)
+{
+	mIncremental = incremental;
+}
+
+bool RenderQueue::WasIncremental()const
+{
+	return mWasIncremental;
+}
+
+double RenderQueue::LastSortMs()const
+{
+	return mLastSortMs;
+}
+
+std::string RenderQueue::FormatStats()const
+{
+	std::ostringstream outs;
+	outs << mEntries.size() << " draws sorted in " << mLastSortMs*1000.0 << " us";
+
+	for(UINT i = 0; i < BindSlotCount; ++i)
+		outs << ", " << BindSlotName(i) << " " << mBindsIssued[i] << "/" << mBindsIssued[i] + mBindsAvoided[i];
+
+	outs << " (" << TotalBindsAvoided() << " binds avoided)";
+
+	return outs.str();
+}
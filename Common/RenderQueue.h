@@ -0,0 +1,169 @@
+//***************************************************************************************
+// RenderQueue.h
+//
+// Orders the draws of a frame by a 64 bit sort key so that draws sharing state end
+// up next to each other, then filters out the binds that would set state the
+// pipeline already has.
+//
+// A key packs, from most to least significant bit:
+//
+//   StateFirst:  layer | pipeline | material | geometry | depth (front to back)
+//   BackToFront: layer | depth (back to front) | pipeline | material | geometry
+//
+// The layer is always on top so layers keep the order the application draws them
+// in; transparent layers sort by depth first so blending stays correct.  The sort is
+// stable, so items with equal keys keep the order in which they were submitted.
+// Each layer is sorted on its own: the key bits that differ within the layer are
+// packed above the entry's index into one 64 bit value, and those values are sorted
+// by a radix pass on a top digit sized to the layer, followed by an insertion sort
+// of the few values each digit leaves together.  Queues whose keys do not fit that
+// way fall back to an LSD radix sort of the entries.
+//
+// Between frames the order barely changes.  When as many entries are submitted as
+// in the last sort, the order of the last sort is tried first: if the entries are
+// still sorted in it, it is kept, and if only a few are out of place they are
+// repaired by insertion sort, which gives up and falls back to the full sort once
+// it has moved too many entries.  This relies on the application submitting each
+// item at the same index every frame, as a scene walk does.
+//***************************************************************************************
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include "MathHelper.h"
+#include <string>
+#include <vector>
+
+class RenderQueue
+{
+public:
+	static const UINT LayerBits    = 6;
+	static const UINT PipelineBits = 10;
+	static const UINT MaterialBits = 12;
+	static const UINT GeometryBits = 12;
+	static const UINT DepthBits    = 24;
+	static const UINT MaxLayers    = 1 << LayerBits;
+
+	enum SortOrder
+	{
+		StateFirst,
+		BackToFront
+	};
+
+	enum BindSlot
+	{
+		Topology,
+		VertexBuffer,
+		IndexBuffer,
+		ObjectConstants,
+		MaterialConstants,
+		ShaderResource,
+		BindSlotCount
+	};
+
+	struct Entry
+	{
+		UINT64 Key;
+
+		// Index of the item in the application's list for its layer.
+		UINT Item;
+	};
+
+	RenderQueue();
+	~RenderQueue();
+
+	///<summary>
+	/// Builds a key.  Ids wider than their field are truncated; depth is the view
+	/// space z of the item, quantized linearly between nearZ and farZ.
+	///</summary>
+	static UINT64 BuildKey(UINT layer, UINT pipeline, UINT material, UINT geometry,
+		float depth, float nearZ, float farZ, SortOrder order);
+
+	static UINT KeyLayer(UINT64 key);
+
+	///<summary>
+	/// Empties the queue and forgets the bound state, for the start of a frame.
+	///</summary>
+	void Clear();
+
+	void Submit(UINT64 key, UINT item);
+
+	///<summary>
+	/// Sorts the submitted entries by key.
+	///</summary>
+	void Sort();
+
+	///<summary>
+	/// Turns the reuse of the last frame's order on or off; on by default.
+	///</summary>
+	void SetIncremental(bool incremental);
+
+	// Whether the last Sort kept or repaired the order of the sort before it.
+	bool WasIncremental()const;
+
+	UINT Size()const;
+	const Entry& operator[](UINT i)const;
+
+	///<summary>
+	/// The entries of a layer; valid after Sort.
+	///</summary>
+	void GetLayerRange(UINT layer, UINT& first, UINT& count)const;
+
+	///<summary>
+	/// Returns true if the state identified by id has to be bound to slot, i.e.
+	/// it differs from what was last bound there.  Every call counts as an issued
+	/// or an avoided bind.
+	///</summary>
+	bool NeedsBind(BindSlot slot, UINT64 id);
+
+	///<summary>
+	/// Forgets the bound state, e.g. after other code has changed it.
+	///</summary>
+	void InvalidateBindings();
+
+	// Statistics since the last Clear.
+	UINT BindsIssued(BindSlot slot)const;
+	UINT BindsAvoided(BindSlot slot)const;
+	UINT TotalBindsAvoided()const;
+	double LastSortMs()const;
+
+	std::string FormatStats()const;
+
+private:
+	static UINT QuantizeDepth(float depth, float nearZ, float farZ);
+
+	// Sorts packed key and index values per layer; returns false without sorting
+	// if a layer's varying key bits and the index do not fit in 64 bits.
+	bool SortPacked(const UINT64 varying[MaxLayers]);
+
+	// Sorts the entries themselves by every varying digit of the whole key.
+	void SortEntries();
+
+	// Reorders the entries by the last sort's order; returns false if too many
+	// of them are out of place in it.
+	bool SortIncremental();
+
+private:
+	std::vector<Entry> mEntries;
+	std::vector<Entry> mScratch;
+	std::vector<UINT64> mPacked;
+	std::vector<UINT64> mPackedScratch;
+	std::vector<UINT> mHistogram;
+
+	// Submission index of each sorted entry, for the next frame to start from.
+	std::vector<UINT> mOrder;
+	bool mIncremental;
+	bool mWasIncremental;
+	bool mHasOrder;
+
+	UINT mLayerFirst[MaxLayers + 1];
+
+	UINT64 mBound[BindSlotCount];
+	bool mBoundValid[BindSlotCount];
+	UINT mBindsIssued[BindSlotCount];
+	UINT mBindsAvoided[BindSlotCount];
+
+	double mLastSortMs;
+};
+
+#endif // RENDERQUEUE_H
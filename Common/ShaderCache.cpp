@@ -0,0 +1,475 @@
+//***************************************************************************************
+// ShaderCache.cpp
+//***************************************************************************************
+
+#include "ShaderCache.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	const UINT64 FnvOffsetBasis = 14695981039346656037ULL;
+	const UINT64 FnvPrime       = 1099511628211ULL;
+
+	const char FileMagic[4] = { 'S', 'H', 'C', '1' };
+
+	struct FileHeader
+	{
+		char Magic[4];
+		UINT Size;
+		UINT64 Key;
+		UINT64 Checksum;
+	};
+
+	void HashBytes(UINT64& h, const void* data, size_t size)
+	{
+		const unsigned char* p = (const unsigned char*)data;
+		for(size_t i = 0; i < size; ++i)
+		{
+			h ^= p[i];
+			h *= FnvPrime;
+		}
+	}
+
+	// Length first, so that ("ab", "c") and ("a", "bc") hash differently.
+	void HashString(UINT64& h, const std::string& s)
+	{
+		UINT64 size = s.size();
+		HashBytes(h, &size, sizeof(size));
+		HashBytes(h, s.data(), s.size());
+	}
+
+	bool ReadFile(const std::string& filename, std::string& contents)
+	{
+		std::ifstream fin(filename.c_str(), std::ios::binary);
+		if( !fin )
+			return false;
+
+		std::ostringstream outs;
+		outs << fin.rdbuf();
+		contents = outs.str();
+		return true;
+	}
+
+	std::string DirectoryOf(const std::string& filename)
+	{
+		size_t slash = filename.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : filename.substr(0, slash + 1);
+	}
+
+	///<summary>
+	/// Collects the names of the #include directives of an HLSL file, skipping
+	/// commented out ones.  Conditional compilation is not evaluated, so an include
+	/// inside #if 0 still counts; that only costs an extra file in the key.
+	///</summary>
+	void ScanIncludes(const std::string& text, std::vector<std::string>& names)
+	{
+		bool inBlockComment = false;
+		bool atLineStart = true;
+
+		for(size_t i = 0; i < text.size(); ++i)
+		{
+			char c = text[i];
+
+			if( inBlockComment )
+			{
+				if( c == '*' && i + 1 < text.size() && text[i+1] == '/' )
+				{
+					inBlockComment = false;
+					++i;
+				}
+				continue;
+			}
+
+			if( c == '\n' )
+			{
+				atLineStart = true;
+				continue;
+			}
+
+			if( c == ' ' || c == '\t' || c == '\r' )
+				continue;
+
+			if( c == '/' && i + 1 < text.size() && text[i+1] == '*' )
+			{
+				inBlockComment = true;
+				++i;
+				continue;
+			}
+
+			if( c == '/' && i + 1 < text.size() && text[i+1] == '/' )
+			{
+				i = text.find('\n', i);
+				if( i == std::string::npos )
+					return;
+				--i;
+				continue;
+			}
+
+			if( c == '#' && atLineStart )
+			{
+				size_t p = text.find_first_not_of(" \t", i + 1);
+				if( p != std::string::npos && text.compare(p, 7, "include") == 0 )
+				{
+					p = text.find_first_not_of(" \t", p + 7);
+					if( p != std::string::npos && (text[p] == '"' || text[p] == '<') )
+					{
+						char close = text[p] == '"' ? '"' : '>';
+						size_t end = text.find_first_of(std::string(1, close) + "\n", p + 1);
+						if( end != std::string::npos && text[end] == close )
+							names.push_back(text.substr(p + 1, end - p - 1));
+					}
+				}
+			}
+
+			atLineStart = false;
+		}
+	}
+
+	void HashFileClosure(UINT64& h, const std::string& filename, const std::string& rootDirectory,
+		std::vector<std::string>& visited)
+	{
+		for(size_t i = 0; i < visited.size(); ++i)
+		{
+			if( visited[i] == filename )
+				return;
+		}
+		visited.push_back(filename);
+
+		std::string text;
+		if( !ReadFile(filename, text) )
+		{
+			HashString(h, "<missing>" + filename);
+			return;
+		}
+
+		HashString(h, text);
+
+		std::vector<std::string> names;
+		ScanIncludes(text, names);
+
+		// Like the default include handler: next to the including file first, then
+		// next to the shader being compiled.
+		std::string directory = DirectoryOf(filename);
+		for(size_t i = 0; i < names.size(); ++i)
+		{
+			std::string path = directory + names[i];
+			if( !std::ifstream(path.c_str()) )
+			{
+				std::string rootPath = rootDirectory + names[i];
+				if( std::ifstream(rootPath.c_str()) )
+					path = rootPath;
+			}
+
+			HashString(h, names[i]);
+			HashFileClosure(h, path, rootDirectory, visited);
+		}
+	}
+
+	// Renames from to to, replacing to if it exists.  std::rename does that on
+	// POSIX but fails on Windows when the target exists, which would leave a
+	// corrupted cache file in place for good.
+	bool RenameReplacing(const std::string& from, const std::string& to)
+	{
+#ifdef _WIN32
+		return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+	}
+
+	void MakeDirectory(const std::string& directory)
+	{
+#ifdef _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+}
+
+ShaderCache::ShaderCache(const std::string& directory, CompileFn compile)
+: mTable(new std::atomic<Entry*>[TableSize]), mEntryCount(0),
+  mDirectory(directory), mCompile(compile),
+  mMemoryHits(0), mDiskHits(0), mCompiles(0), mFailures(0)
+{
+	for(UINT i = 0; i < TableSize; ++i)
+		mTable[i].store(0, std::memory_order_relaxed);
+}
+
+ShaderCache::~ShaderCache()
+{
+	ClearMemory();
+}
+
+void ShaderCache::ClearMemory()
+{
+	// Not safe against concurrent lookups; call when no Get is running.
+	for(UINT i = 0; i < TableSize; ++i)
+		delete mTable[i].exchange(0);
+
+	mEntryCount = 0;
+}
+
+UINT64 ShaderCache::ComputeKey(const Request& request, std::vector<std::string>* includes)
+{
+	UINT64 h = FnvOffsetBasis;
+
+	HashString(h, request.Filename);
+	HashString(h, request.EntryPoint);
+	HashString(h, request.Target);
+	HashBytes(h, &request.Flags, sizeof(request.Flags));
+
+	for(size_t i = 0; i < request.Defines.size(); ++i)
+	{
+		HashString(h, request.Defines[i].Name);
+		HashString(h, request.Defines[i].Definition);
+	}
+
+	std::vector<std::string> visited;
+	HashFileClosure(h, request.Filename, DirectoryOf(request.Filename), visited);
+
+	if( includes )
+		includes->assign(visited.begin() + 1, visited.end());
+
+	return h;
+}
+
+ShaderCache::BytecodePtr ShaderCache::FindInMemory(UINT64 key)const
+{
+	for(UINT probe = 0; probe < TableSize; ++probe)
+	{
+		const Entry* e = mTable[(key + probe) & (TableSize - 1)].load(std::memory_order_acquire);
+		if( !e )
+			return BytecodePtr();
+		if( e->Key == key )
+			return e->Code;
+	}
+
+	return BytecodePtr();
+}
+
+ShaderCache::BytecodePtr ShaderCache::Publish(UINT64 key, BytecodePtr code)
+{
+	// Keep a quarter of the table free so probe sequences stay short; past that the
+	// bytecode is still returned, just not kept.
+	if( mEntryCount.load(std::memory_order_relaxed) >= TableSize - TableSize/4 )
+		return code;
+
+	Entry* entry = new Entry;
+	entry->Key  = key;
+	entry->Code = code;
+
+	for(UINT probe = 0; probe < TableSize; ++probe)
+	{
+		std::atomic<Entry*>& slot = mTable[(key + probe) & (TableSize - 1)];
+
+		Entry* expected = 0;
+		if( slot.compare_exchange_strong(expected, entry, std::memory_order_acq_rel) )
+		{
+			++mEntryCount;
+			return code;
+		}
+
+		// Another thread compiled the same shader first; use its result.
+		if( expected->Key == key )
+		{
+			delete entry;
+			return expected->Code;
+		}
+	}
+
+	delete entry;
+	return code;
+}
+
+std::string ShaderCache::KeyToString(UINT64 key)
+{
+	char s[17];
+	snprintf(s, sizeof(s), "%016llx", (unsigned long long)key);
+	return s;
+}
+
+std::string ShaderCache::PathOf(UINT64 key)const
+{
+	return mDirectory + "/" + KeyToString(key) + ".cso";
+}
+
+ShaderCache::BytecodePtr ShaderCache::LoadFromDisk(UINT64 key)const
+{
+	if( mDirectory.empty() )
+		return BytecodePtr();
+
+	std::ifstream fin(PathOf(key).c_str(), std::ios::binary);
+	if( !fin )
+		return BytecodePtr();
+
+	FileHeader header;
+	if( !fin.read((char*)&header, sizeof(header)) ||
+		memcmp(header.Magic, FileMagic, sizeof(FileMagic)) != 0 || header.Key != key )
+		return BytecodePtr();
+
+	std::shared_ptr<Bytecode> code = std::make_shared<Bytecode>(header.Size);
+	if( header.Size > 0 && !fin.read(&(*code)[0], header.Size) )
+		return BytecodePtr();
+
+	// A torn or corrupted file is treated as a miss and overwritten.
+	UINT64 checksum = FnvOffsetBasis;
+	HashBytes(checksum, code->data(), code->size());
+	if( checksum != header.Checksum )
+		return BytecodePtr();
+
+	return code;
+}
+
+void ShaderCache::StoreToDisk(UINT64 key, const Bytecode& code)
+{
+	if( mDirectory.empty() )
+		return;
+
+	MakeDirectory(mDirectory);
+
+	FileHeader header;
+	memcpy(header.Magic, FileMagic, sizeof(FileMagic));
+	header.Size     = (UINT)code.size();
+	header.Key      = key;
+	header.Checksum = FnvOffsetBasis;
+	HashBytes(header.Checksum, code.data(), code.size());
+
+	// Write next to the final name and rename, so a reader in another process
+	// never sees a partial file.
+	static std::atomic<UINT> tempCounter(0);
+	std::string path = PathOf(key);
+	std::ostringstream tempPath;
+	tempPath << path << ".tmp" << tempCounter++;
+
+	{
+		std::ofstream fout(tempPath.str().c_str(), std::ios::binary);
+		fout.write((const char*)&header, sizeof(header));
+		if( !code.empty() )
+			fout.write(&code[0], code.size());
+		if( !fout )
+		{
+			fout.close();
+			std::remove(tempPath.str().c_str());
+			return;
+		}
+	}
+
+	if( !RenameReplacing(tempPath.str(), path) )
+		std::remove(tempPath.str().c_str());
+}
+
+ShaderCache::BytecodePtr ShaderCache::Get(const Request& request, std::string* errors)
+{
+	return GetWithKey(ComputeKey(request), request, errors);
+}
+
+ShaderCache::BytecodePtr ShaderCache::GetWithKey(UINT64 key, const Request& request, std::string* errors)
+{
+	BytecodePtr code = FindInMemory(key);
+	if( code )
+	{
+		++mMemoryHits;
+		return code;
+	}
+
+	code = LoadFromDisk(key);
+	if( code )
+	{
+		++mDiskHits;
+		return Publish(key, code);
+	}
+
+	PROFILE_ZONE("ShaderCache::Compile");
+
+	std::shared_ptr<Bytecode> compiled = std::make_shared<Bytecode>();
+	std::string compileErrors;
+	if( !mCompile || !mCompile(request, *compiled, compileErrors) )
+	{
+		++mFailures;
+		if( errors )
+			*errors = compileErrors;
+		return BytecodePtr();
+	}
+
+	++mCompiles;
+	if( errors )
+		*errors = compileErrors;
+
+	StoreToDisk(key, *compiled);
+	return Publish(key, compiled);
+}
+
+void ShaderCache::GetAll(const std::vector<Request>& requests, std::vector<BytecodePtr>& results,
+	std::vector<std::string>* errors, UINT threadCount)
+{
+	PROFILE_FUNCTION();
+
+	UINT count = (UINT)requests.size();
+	results.assign(count, BytecodePtr());
+	if( errors )
+		errors->assign(count, std::string());
+
+	std::vector<UINT64> keys(count);
+	Parallel::For(count, threadCount, [&](UINT i)
+	{
+		keys[i] = ComputeKey(requests[i]);
+	});
+
+	// Requests that share a key are compiled once, by the first of them.
+	std::vector<UINT> first(count);
+	std::vector<UINT> unique;
+	for(UINT i = 0; i < count; ++i)
+	{
+		first[i] = i;
+		for(size_t u = 0; u < unique.size(); ++u)
+		{
+			if( keys[unique[u]] == keys[i] )
+			{
+				first[i] = unique[u];
+				break;
+			}
+		}
+
+		if( first[i] == i )
+			unique.push_back(i);
+	}
+
+	Parallel::For((UINT)unique.size(), threadCount, [&](UINT u)
+	{
+		UINT i = unique[u];
+		results[i] = GetWithKey(keys[i], requests[i], errors ? &(*errors)[i] : 0);
+	});
+
+	for(UINT i = 0; i < count; ++i)
+	{
+		if( first[i] != i )
+		{
+			results[i] = results[first[i]];
+			if( errors )
+				(*errors)[i] = (*errors)[first[i]];
+		}
+	}
+}
+
+ShaderCache::Stats ShaderCache::GetStats()const
+{
+	Stats s;
+	s.MemoryHits = mMemoryHits;
+	s.DiskHits   = mDiskHits;
+	s.Compiles   = mCompiles;
+	s.Failures   = mFailures;
+	return s;
+}
@@ -0,0 +1,134 @@
+//***************************************************************************************
+// ShaderCache.h
+//
+// Content addressed cache of compiled shaders.  The key of a compile is a 64-bit hash
+// of the bytes of the source file and of every file it includes, the macro defines,
+// the entry point, the target and the compile flags, so editing any header that a
+// shader pulls in gives it a new key.  Compiled bytecode is kept in memory and in
+// one file per key under a cache directory, which makes a second run of a demo skip
+// the compiler entirely.
+//
+// The cache does not compile anything itself; it calls the CompileFn it was created
+// with, so the hashing, include scanning and storage run (and can be exercised with a
+// stub compiler) without Direct3D.
+//
+// Lookups of the in-memory table take no lock: entries are published once with a
+// compare-and-swap and never change afterwards.
+//***************************************************************************************
+
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include "XnaMathPortable.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ShaderCache
+{
+public:
+	struct Define
+	{
+		std::string Name;
+		std::string Definition;
+	};
+
+	struct Request
+	{
+		Request() : Flags(0) {}
+
+		std::string Filename;
+		std::vector<Define> Defines;
+		std::string EntryPoint;
+		std::string Target;
+		UINT Flags;
+	};
+
+	typedef std::vector<char> Bytecode;
+	typedef std::shared_ptr<const Bytecode> BytecodePtr;
+
+	///<summary>
+	/// Compiles request into bytecode.  Returns false and fills errors on failure.
+	/// Called from several threads at once by GetAll.
+	///</summary>
+	typedef std::function<bool(const Request& request, Bytecode& bytecode, std::string& errors)> CompileFn;
+
+	struct Stats
+	{
+		UINT MemoryHits;
+		UINT DiskHits;
+		UINT Compiles;
+		UINT Failures;
+	};
+
+	///<summary>
+	/// directory is created on first store; an empty directory keeps the cache in
+	/// memory only.
+	///</summary>
+	ShaderCache(const std::string& directory, CompileFn compile);
+	~ShaderCache();
+
+	///<summary>
+	/// Hashes everything the result of compiling request depends on.  Includes are
+	/// found by scanning for #include directives and resolved relative to the file
+	/// that includes them; names that resolve to no file only contribute their text.
+	/// The resolved include closure is returned in includes if it is not null.
+	///</summary>
+	static UINT64 ComputeKey(const Request& request, std::vector<std::string>* includes = 0);
+
+	///<summary>
+	/// Returns the bytecode for request from memory, from disk or by compiling it.
+	/// Returns null if compilation fails; the compiler output goes to errors.
+	///</summary>
+	BytecodePtr Get(const Request& request, std::string* errors = 0);
+
+	///<summary>
+	/// Get for every request, compiling the misses in parallel.  threadCount 0 uses
+	/// every hardware thread.
+	///</summary>
+	void GetAll(const std::vector<Request>& requests, std::vector<BytecodePtr>& results,
+		std::vector<std::string>* errors = 0, UINT threadCount = 0);
+
+	Stats GetStats()const;
+
+	// Drops the in-memory entries; the files on disk stay.
+	void ClearMemory();
+
+	static std::string KeyToString(UINT64 key);
+
+private:
+	ShaderCache(const ShaderCache& rhs);
+	ShaderCache& operator=(const ShaderCache& rhs);
+
+	struct Entry
+	{
+		UINT64 Key;
+		BytecodePtr Code;
+	};
+
+	BytecodePtr GetWithKey(UINT64 key, const Request& request, std::string* errors);
+	BytecodePtr FindInMemory(UINT64 key)const;
+	BytecodePtr Publish(UINT64 key, BytecodePtr code);
+
+	std::string PathOf(UINT64 key)const;
+	BytecodePtr LoadFromDisk(UINT64 key)const;
+	void StoreToDisk(UINT64 key, const Bytecode& code);
+
+private:
+	// Open addressing table; a slot goes from null to its final entry exactly once.
+	static const UINT TableSize = 4096;
+	std::unique_ptr<std::atomic<Entry*>[]> mTable;
+	std::atomic<UINT> mEntryCount;
+
+	std::string mDirectory;
+	CompileFn mCompile;
+
+	std::atomic<UINT> mMemoryHits;
+	std::atomic<UINT> mDiskHits;
+	std::atomic<UINT> mCompiles;
+	std::atomic<UINT> mFailures;
+};
+
+#endif // SHADERCACHE_H
@@ -1,7 +1,67 @@
 #include "ShaderFactoryDX11.h"
+#include "Profiler.h"
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+	UINT CompileFlags()
+	{
+		UINT flags = D3DCOMPILE_PACK_MATRIX_ROW_MAJOR;
+#ifdef _DEBUG
+		flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+		return flags;
+	}
+
+	bool CompileWithD3DX(const ShaderCache::Request& request, ShaderCache::Bytecode& bytecode, std::string& errors)
+	{
+		std::vector<D3D_SHADER_MACRO> macros;
+		for(size_t i = 0; i < request.Defines.size(); ++i)
+		{
+			D3D_SHADER_MACRO m = { request.Defines[i].Name.c_str(), request.Defines[i].Definition.c_str() };
+			macros.push_back(m);
+		}
+		D3D_SHADER_MACRO end = { nullptr, nullptr };
+		macros.push_back(end);
+
+		ComPtr<ID3DBlob> byteCode;
+		ComPtr<ID3DBlob> errorMessages;
+
+		HRESULT hr = D3DX11CompileFromFileA(request.Filename.c_str(),
+			&macros[0],
+			nullptr,
+			request.EntryPoint.c_str(),
+			request.Target.c_str(),
+			request.Flags,
+			0,
+			nullptr,
+			byteCode.GetAddressOf(),
+			errorMessages.GetAddressOf(),
+			nullptr);
+
+		if( errorMessages )
+			errors.assign((const char*)errorMessages->GetBufferPointer(), errorMessages->GetBufferSize());
+
+		if( FAILED(hr) )
+			return false;
+
+		const char* code = (const char*)byteCode->GetBufferPointer();
+		bytecode.assign(code, code + byteCode->GetBufferSize());
+		return true;
+	}
+
+	ComPtr<ID3DBlob> MakeBlob(const ShaderCache::Bytecode& bytecode)
+	{
+		ComPtr<ID3DBlob> pBlob;
+		HR(D3DCreateBlob(bytecode.size(), pBlob.GetAddressOf()));
+
+		memcpy(pBlob->GetBufferPointer(), bytecode.data(), bytecode.size());
+
+		return pBlob;
+	}
+}
+
 ComPtr<ID3DBlob> ShaderFactoryDX11::LoadShader(
 	std::wstring & filename,
 	std::wstring & function,
@@ -23,32 +83,74 @@ ComPtr<ID3DBlob> ShaderFactoryDX11::LoadShader(
 	return pBlob;
 }
 
+ShaderCache& ShaderFactoryDX11::Cache()
+{
+	static ShaderCache cache("ShaderCache", CompileWithD3DX);
+	return cache;
+}
+
+ShaderCache::Request ShaderFactoryDX11::MakeRequest(
+	const std::wstring & filename,
+	const D3D_SHADER_MACRO * defines,
+	const std::string & function,
+	const std::string & model)
+{
+	ShaderCache::Request request;
+
+	int size = WideCharToMultiByte(CP_ACP, 0, filename.c_str(), (int)filename.size(), nullptr, 0, nullptr, nullptr);
+	request.Filename.resize(size);
+	if( size > 0 )
+		WideCharToMultiByte(CP_ACP, 0, filename.c_str(), (int)filename.size(), &request.Filename[0], size, nullptr, nullptr);
+
+	for(const D3D_SHADER_MACRO* m = defines; m && m->Name; ++m)
+	{
+		ShaderCache::Define d = { m->Name, m->Definition ? m->Definition : "" };
+		request.Defines.push_back(d);
+	}
+
+	request.EntryPoint = function;
+	request.Target = model;
+	request.Flags = CompileFlags();
+
+	return request;
+}
+
 ComPtr<ID3DBlob> ShaderFactoryDX11::CompileShader(
 	const std::wstring & filename,
 	const D3D_SHADER_MACRO * defines,
 	const std::string & function,
 	const std::string & model)
 {
-    UINT flags = D3DCOMPILE_PACK_MATRIX_ROW_MAJOR;
-#ifdef _DEBUG
-    flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
+	PROFILE_FUNCTION();
+
+	std::string errors;
+	ShaderCache::BytecodePtr bytecode = Cache().Get(MakeRequest(filename, defines, function, model), &errors);
+
+	if( !errors.empty() )
+		OutputDebugStringA(errors.c_str());
+
+	if( !bytecode )
+	{
+		HR(E_FAIL);
+		return nullptr;
+	}
+
+	return MakeBlob(*bytecode);
+}
+
+void ShaderFactoryDX11::PrecompileShaders(const std::vector<ShaderDesc>& shaders)
+{
+	PROFILE_FUNCTION();
+
+	std::vector<ShaderCache::Request> requests;
+	for(size_t i = 0; i < shaders.size(); ++i)
+	{
+		const ShaderDesc& desc = shaders[i];
+		requests.push_back(MakeRequest(desc.Filename, desc.Defines, desc.Function, desc.Model));
+	}
 
-	ComPtr<ID3DBlob> byteCode;
-	ComPtr<ID3DBlob> errors;
-
-	HRESULT hr = S_OK;
-	HR(D3DX11CompileFromFile(filename.c_str(),
-		defines,
-		nullptr,
-		function.c_str(),
-		model.c_str(),
-		flags,
-		0,
-		nullptr,
-		byteCode.GetAddressOf(),
-		errors.GetAddressOf(),
-		&hr));
-
-	return byteCode;
+	// Failures are reported again, with their errors, by the CompileShader call
+	// for that shader.
+	std::vector<ShaderCache::BytecodePtr> results;
+	Cache().GetAll(requests, results);
 }
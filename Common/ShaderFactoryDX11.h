@@ -1,19 +1,49 @@
 #pragma once
 
 #include "d3dUtil.h"
+#include "ShaderCache.h"
 
 class ShaderFactoryDX11
 {
 public:
+	struct ShaderDesc
+	{
+		std::wstring Filename;
+		const D3D_SHADER_MACRO* Defines;
+		std::string Function;
+		std::string Model;
+	};
+
 	ShaderFactoryDX11() = delete;
 	~ShaderFactoryDX11() = delete;
 	static Microsoft::WRL::ComPtr<ID3DBlob> LoadShader(
 		std::wstring& filename,
 		std::wstring& function,
 		std::wstring& model);
+
+	///<summary>
+	/// Compiles through the shader cache: a shader whose source, includes, defines
+	/// and flags are unchanged since an earlier run is read back from ShaderCache/
+	/// instead of being recompiled.
+	///</summary>
 	static Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(
 		const std::wstring& filename,
 		const D3D_SHADER_MACRO* defines,
 		const std::string& entrypoint,
 		const std::string& target);
-};
\ No newline at end of file
+
+	///<summary>
+	/// Brings every shader of shaders into the cache, compiling the misses in
+	/// parallel, so that the CompileShader calls that follow return at once.
+	///</summary>
+	static void PrecompileShaders(const std::vector<ShaderDesc>& shaders);
+
+	static ShaderCache& Cache();
+
+private:
+	static ShaderCache::Request MakeRequest(
+		const std::wstring& filename,
+		const D3D_SHADER_MACRO* defines,
+		const std::string& entrypoint,
+		const std::string& target);
+};
@@ -0,0 +1,297 @@
+//***************************************************************************************
+// ShadowCascades.cpp
+//***************************************************************************************
+
+#include "ShadowCascades.h"
+#include "Profiler.h"
+#include <cmath>
+
+// MathHelper::Clamp takes its bounds by reference, which needs a definition.
+const UINT ShadowCascades::MaxCascades;
+
+ShadowCascades::ShadowCascades()
+: mCascadeCount(1), mShadowMapSize(2048), mLambda(0.5f), mStableFit(true), mCulledCasterCount(0)
+{
+	XMStoreFloat4x4(&mLightView, XMMatrixIdentity());
+
+	for(UINT i = 0; i < MaxCascades; ++i)
+	{
+		mCascades[i].SplitNear = 0.0f;
+		mCascades[i].SplitFar  = 0.0f;
+		mCascades[i].LightMin  = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		mCascades[i].LightMax  = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		XMStoreFloat4x4(&mCascades[i].Proj, XMMatrixIdentity());
+		XMStoreFloat4x4(&mCascades[i].ShadowTransform, XMMatrixIdentity());
+		mCascades[i].Active = false;
+	}
+}
+
+ShadowCascades::~ShadowCascades()
+{
+}
+
+void ShadowCascades::Init(UINT cascadeCount, UINT shadowMapSize, float lambda, bool stableFit)
+{
+	mCascadeCount  = MathHelper::Clamp(cascadeCount, 1u, MaxCascades);
+	mShadowMapSize = shadowMapSize;
+	mLambda        = MathHelper::Clamp(lambda, 0.0f, 1.0f);
+	mStableFit     = stableFit;
+}
+
+UINT ShadowCascades::CascadeCount()const
+{
+	return mCascadeCount;
+}
+
+const ShadowCascades::Cascade& ShadowCascades::GetCascade(UINT i)const
+{
+	return mCascades[i];
+}
+
+XMMATRIX ShadowCascades::LightView()const
+{
+	return XMLoadFloat4x4(&mLightView);
+}
+
+XMMATRIX ShadowCascades::LightProj(UINT i)const
+{
+	return XMLoadFloat4x4(&mCascades[i].Proj);
+}
+
+XMMATRIX ShadowCascades::ShadowTransform(UINT i)const
+{
+	return XMLoadFloat4x4(&mCascades[i].ShadowTransform);
+}
+
+UINT ShadowCascades::CulledCasterCount()const
+{
+	return mCulledCasterCount;
+}
+
+void ShadowCascades::ComputeSplitDistances(float nearZ, float farZ, UINT count, float lambda, float* splits)
+{
+	splits[0] = nearZ;
+	for(UINT i = 1; i < count; ++i)
+	{
+		float p = (float)i / (float)count;
+
+		float logSplit = nearZ * powf(farZ / nearZ, p);
+		float uniSplit = nearZ + (farZ - nearZ) * p;
+
+		splits[i] = MathHelper::Lerp(uniSplit, logSplit, lambda);
+	}
+	splits[count] = farZ;
+}
+
+void ShadowCascades::ComputeFrustumCorners(const Camera& cam, float zNear, float zFar, XMFLOAT3 corners[8])
+{
+	XMVECTOR P = cam.GetPositionXM();
+	XMVECTOR R = cam.GetRightXM();
+	XMVECTOR U = cam.GetUpXM();
+	XMVECTOR L = cam.GetLookXM();
+
+	float tanY = tanf(0.5f*cam.GetFovY());
+	float tanX = tanY*cam.GetAspect();
+
+	const float signX[4] = { -1.0f, +1.0f, +1.0f, -1.0f };
+	const float signY[4] = { +1.0f, +1.0f, -1.0f, -1.0f };
+
+	for(UINT plane = 0; plane < 2; ++plane)
+	{
+		float z = plane == 0 ? zNear : zFar;
+		XMVECTOR center = P + z*L;
+
+		for(UINT i = 0; i < 4; ++i)
+		{
+			XMVECTOR c = center + (signX[i]*z*tanX)*R + (signY[i]*z*tanY)*U;
+			XMStoreFloat3(&corners[plane*4 + i], c);
+		}
+	}
+}
+
+void ShadowCascades::TransformBox(const XNA::AxisAlignedBox& box, CXMMATRIX V, XMFLOAT3& boxMin, XMFLOAT3& boxMax)
+{
+	XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&box.Center), V);
+
+	// Row vector convention: p' = p*V, so the light space half extent along axis j
+	// is sum_i |V(i,j)| * extent_i.
+	XMVECTOR extents =
+		XMVectorAbs(V.r[0])*XMVectorReplicate(box.Extents.x) +
+		XMVectorAbs(V.r[1])*XMVectorReplicate(box.Extents.y) +
+		XMVectorAbs(V.r[2])*XMVectorReplicate(box.Extents.z);
+
+	XMStoreFloat3(&boxMin, center - extents);
+	XMStoreFloat3(&boxMax, center + extents);
+}
+
+void ShadowCascades::Update(const Camera& cam, const XMFLOAT3& lightDir,
+	const std::vector<XNA::AxisAlignedBox>& casterBounds)
+{
+	PROFILE_FUNCTION();
+
+	// The light view is anchored at the world origin and only depends on the light
+	// direction.  Each cascade then picks an off-center box in this space, so a
+	// moving camera only ever translates the boxes and the texel snapping below is
+	// enough to keep the shadow edges still.
+	XMVECTOR dir = XMVector3Normalize(XMLoadFloat3(&lightDir));
+	XMVECTOR up = fabsf(XMVectorGetY(dir)) > 0.99f
+		? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f)
+		: XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+	XMMATRIX V = XMMatrixLookToLH(XMVectorZero(), dir, up);
+	XMStoreFloat4x4(&mLightView, V);
+
+	mCasterMin.resize(casterBounds.size());
+	mCasterMax.resize(casterBounds.size());
+	for(size_t i = 0; i < casterBounds.size(); ++i)
+		TransformBox(casterBounds[i], V, mCasterMin[i], mCasterMax[i]);
+
+	float splits[MaxCascades + 1];
+	ComputeSplitDistances(cam.GetNearZ(), cam.GetFarZ(), mCascadeCount, mLambda, splits);
+
+	mCulledCasterCount = 0;
+	for(UINT i = 0; i < mCascadeCount; ++i)
+	{
+		mCascades[i].SplitNear = splits[i];
+		mCascades[i].SplitFar  = splits[i+1];
+		FitCascade(i, cam, V);
+	}
+}
+
+void ShadowCascades::FitCascade(UINT i, const Camera& cam, CXMMATRIX V)
+{
+	Cascade& cascade = mCascades[i];
+	cascade.Casters.clear();
+
+	XMFLOAT3 corners[8];
+	ComputeFrustumCorners(cam, cascade.SplitNear, cascade.SplitFar, corners);
+
+	XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+	XMVECTOR lightCorners[8];
+	for(UINT j = 0; j < 8; ++j)
+	{
+		lightCorners[j] = XMVector3TransformCoord(XMLoadFloat3(&corners[j]), V);
+		vMin = XMVectorMin(vMin, lightCorners[j]);
+		vMax = XMVectorMax(vMax, lightCorners[j]);
+	}
+
+	XMFLOAT3 frustumMin, frustumMax;
+	XMStoreFloat3(&frustumMin, vMin);
+	XMStoreFloat3(&frustumMax, vMax);
+
+	float minX, maxX, minY, maxY, unitsPerTexel;
+	if( mStableFit )
+	{
+		// Bounding sphere of the sub-frustum.  Its size does not change as the camera
+		// rotates, so the world size of a texel stays fixed from frame to frame.
+		XMVECTOR center = XMVectorZero();
+		for(UINT j = 0; j < 8; ++j)
+			center += lightCorners[j];
+		center = center*(1.0f/8.0f);
+
+		float radius = 0.0f;
+		for(UINT j = 0; j < 8; ++j)
+			radius = MathHelper::Max(radius, XMVectorGetX(XMVector3Length(lightCorners[j] - center)));
+
+		// Quantize the radius so float noise in the corners cannot change it.
+		radius = ceilf(radius*16.0f)/16.0f;
+
+		unitsPerTexel = 2.0f*radius/(float)mShadowMapSize;
+
+		minX = floorf((XMVectorGetX(center) - radius)/unitsPerTexel)*unitsPerTexel;
+		minY = floorf((XMVectorGetY(center) - radius)/unitsPerTexel)*unitsPerTexel;
+		maxX = minX + 2.0f*radius;
+		maxY = minY + 2.0f*radius;
+	}
+	else
+	{
+		minX = frustumMin.x;
+		maxX = frustumMax.x;
+		minY = frustumMin.y;
+		maxY = frustumMax.y;
+
+		// Clip against the union of the casters that lie in front of the receivers;
+		// resolution outside of it would never be sampled by a shadowed pixel.
+		float casterMinX = +MathHelper::Infinity, casterMaxX = -MathHelper::Infinity;
+		float casterMinY = +MathHelper::Infinity, casterMaxY = -MathHelper::Infinity;
+		for(size_t c = 0; c < mCasterMin.size(); ++c)
+		{
+			if( mCasterMin[c].z > frustumMax.z )
+				continue;
+
+			casterMinX = MathHelper::Min(casterMinX, mCasterMin[c].x);
+			casterMaxX = MathHelper::Max(casterMaxX, mCasterMax[c].x);
+			casterMinY = MathHelper::Min(casterMinY, mCasterMin[c].y);
+			casterMaxY = MathHelper::Max(casterMaxY, mCasterMax[c].y);
+		}
+
+		minX = MathHelper::Max(minX, casterMinX);
+		maxX = MathHelper::Min(maxX, casterMaxX);
+		minY = MathHelper::Max(minY, casterMinY);
+		maxY = MathHelper::Min(maxY, casterMaxY);
+
+		if( maxX <= minX || maxY <= minY )
+		{
+			cascade.Active = false;
+			mCulledCasterCount += (UINT)mCasterMin.size();
+			return;
+		}
+
+		// Grow to whole texels so that translating the box moves the shadow by whole
+		// texels only.
+		unitsPerTexel = MathHelper::Max(maxX - minX, maxY - minY)/(float)mShadowMapSize;
+		minX = floorf(minX/unitsPerTexel)*unitsPerTexel;
+		minY = floorf(minY/unitsPerTexel)*unitsPerTexel;
+		maxX = ceilf(maxX/unitsPerTexel)*unitsPerTexel;
+		maxY = ceilf(maxY/unitsPerTexel)*unitsPerTexel;
+	}
+
+	// Cull the casters against the cascade box extruded toward the light: anything
+	// overlapping the box in x/y and not entirely behind the receivers can cast
+	// into this cascade.
+	float nearZ = frustumMin.z;
+	float farZ  = -MathHelper::Infinity;
+	for(size_t c = 0; c < mCasterMin.size(); ++c)
+	{
+		const XMFLOAT3& bMin = mCasterMin[c];
+		const XMFLOAT3& bMax = mCasterMax[c];
+
+		bool overlaps =
+			bMin.x <= maxX && bMax.x >= minX &&
+			bMin.y <= maxY && bMax.y >= minY &&
+			bMin.z <= frustumMax.z;
+
+		if( !overlaps )
+		{
+			++mCulledCasterCount;
+			continue;
+		}
+
+		cascade.Casters.push_back((UINT)c);
+		nearZ = MathHelper::Min(nearZ, bMin.z);
+		farZ  = MathHelper::Max(farZ, bMax.z);
+	}
+
+	cascade.Active = !cascade.Casters.empty();
+
+	// Nothing past the farthest caster (or the end of the sub-frustum) needs depth.
+	farZ = cascade.Active ? MathHelper::Min(farZ, frustumMax.z) : frustumMax.z;
+	if( farZ <= nearZ )
+		farZ = nearZ + unitsPerTexel;
+
+	cascade.LightMin = XMFLOAT3(minX, minY, nearZ);
+	cascade.LightMax = XMFLOAT3(maxX, maxY, farZ);
+
+	XMMATRIX P = XMMatrixOrthographicOffCenterLH(minX, maxX, minY, maxY, nearZ, farZ);
+
+	// Transform NDC space [-1,+1]^2 to texture space [0,1]^2
+	XMMATRIX T(
+		0.5f, 0.0f, 0.0f, 0.0f,
+		0.0f, -0.5f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.5f, 0.5f, 0.0f, 1.0f);
+
+	XMStoreFloat4x4(&cascade.Proj, P);
+	XMStoreFloat4x4(&cascade.ShadowTransform, V*P*T);
+}
@@ -0,0 +1,114 @@
+//***************************************************************************************
+// ShadowCascades.h
+//
+// CPU side of cascaded shadow mapping for a directional light.  Splits the camera
+// frustum into depth ranges, fits an orthographic light frustum to each range and to
+// the shadow casters that can affect it, snaps the fit to shadow-map texels so the
+// shadows do not shimmer, and builds the caster list of every cascade.
+//
+// The class only does the calculations; it does not touch Direct3D, so it can be
+// driven from a headless test with a Camera and a list of caster bounds.
+//***************************************************************************************
+
+#ifndef SHADOWCASCADES_H
+#define SHADOWCASCADES_H
+
+#include "MathHelper.h"
+#include "Camera.h"
+#include "xnacollision.h"
+#include <vector>
+
+class ShadowCascades
+{
+public:
+	static const UINT MaxCascades = 4;
+
+	struct Cascade
+	{
+		// View space depth range of the camera covered by this cascade.
+		float SplitNear;
+		float SplitFar;
+
+		// Light space box the orthographic projection was built from.
+		XMFLOAT3 LightMin;
+		XMFLOAT3 LightMax;
+
+		XMFLOAT4X4 Proj;
+		XMFLOAT4X4 ShadowTransform; // View*Proj*NDC-to-texture
+
+		// Indices into the caster list passed to Update() that must be drawn
+		// into this cascade.
+		std::vector<UINT> Casters;
+
+		// False when no caster overlaps the cascade; it can be skipped.
+		bool Active;
+	};
+
+	ShadowCascades();
+	~ShadowCascades();
+
+	///<summary>
+	/// cascadeCount is clamped to [1, MaxCascades].  lambda blends between a uniform
+	/// (0) and a logarithmic (1) split distribution.  With stableFit each cascade is
+	/// fit to the bounding sphere of its sub-frustum, which keeps the projection size
+	/// constant under camera rotation; otherwise it is fit tightly to the sub-frustum
+	/// clipped against the caster bounds.
+	///</summary>
+	void Init(UINT cascadeCount, UINT shadowMapSize, float lambda, bool stableFit);
+
+	///<summary>
+	/// Rebuilds every cascade for the given camera and light.  casterBounds are
+	/// world space; receivers that must be shadowed should be in the list too, since
+	/// the depth range of each cascade is clamped to the casters it contains.
+	///</summary>
+	void Update(const Camera& cam, const XMFLOAT3& lightDir,
+		const std::vector<XNA::AxisAlignedBox>& casterBounds);
+
+	UINT CascadeCount()const;
+	const Cascade& GetCascade(UINT i)const;
+
+	XMMATRIX LightView()const;
+	XMMATRIX LightProj(UINT i)const;
+	XMMATRIX ShadowTransform(UINT i)const;
+
+	// Sum over all cascades of the casters that were culled from it.
+	UINT CulledCasterCount()const;
+
+	///<summary>
+	/// Practical split scheme: splits[i] = lerp(uniform_i, log_i, lambda) with
+	/// splits[0] = nearZ and splits[count] = farZ.  splits must hold count+1 floats.
+	///</summary>
+	static void ComputeSplitDistances(float nearZ, float farZ, UINT count, float lambda, float* splits);
+
+	///<summary>
+	/// World space corners of the part of the camera frustum between the view
+	/// space depths zNear and zFar.  Near corners first, in the order
+	/// (-x,+y) (+x,+y) (+x,-y) (-x,-y).
+	///</summary>
+	static void ComputeFrustumCorners(const Camera& cam, float zNear, float zFar, XMFLOAT3 corners[8]);
+
+	///<summary>
+	/// Light space axis-aligned bounds of a world space box under the affine
+	/// transform V (a view, or a view times an orthographic projection).
+	///</summary>
+	static void TransformBox(const XNA::AxisAlignedBox& box, CXMMATRIX V, XMFLOAT3& boxMin, XMFLOAT3& boxMax);
+
+private:
+	void FitCascade(UINT i, const Camera& cam, CXMMATRIX V);
+
+private:
+	UINT mCascadeCount;
+	UINT mShadowMapSize;
+	float mLambda;
+	bool mStableFit;
+
+	XMFLOAT4X4 mLightView;
+	Cascade mCascades[MaxCascades];
+	UINT mCulledCasterCount;
+
+	// Light space bounds of the casters for the current Update().
+	std::vector<XMFLOAT3> mCasterMin;
+	std::vector<XMFLOAT3> mCasterMax;
+};
+
+#endif // SHADOWCASCADES_H
@@ -0,0 +1,150 @@
+//***************************************************************************************
+// ShadowCasterCache.cpp
+//***************************************************************************************
+
+#include "ShadowCasterCache.h"
+#include "ShadowCascades.h"
+#include "Profiler.h"
+#include <cstring>
+
+ShadowCasterCache::ShadowCasterCache()
+: mStaticChanged(true), mStaticDepthDirty(true),
+  mCulledCasterCount(0), mSkippedRedrawCount(0), mStaticRebuildCount(0)
+{
+	XMStoreFloat4x4(&mCachedViewProj, XMMatrixIdentity());
+}
+
+ShadowCasterCache::~ShadowCasterCache()
+{
+}
+
+UINT ShadowCasterCache::AddCaster(const XNA::AxisAlignedBox& worldBounds, bool isStatic)
+{
+	Caster caster;
+	caster.Bounds  = worldBounds;
+	caster.Static  = isStatic;
+	caster.Visible = false;
+
+	mCasters.push_back(caster);
+
+	if( isStatic )
+		mStaticChanged = true;
+
+	return (UINT)mCasters.size() - 1;
+}
+
+void ShadowCasterCache::SetCasterBounds(UINT id, const XNA::AxisAlignedBox& worldBounds)
+{
+	Caster& caster = mCasters[id];
+
+	if( caster.Static &&
+		memcmp(&caster.Bounds, &worldBounds, sizeof(XNA::AxisAlignedBox)) != 0 )
+	{
+		mStaticChanged = true;
+	}
+
+	caster.Bounds = worldBounds;
+}
+
+void ShadowCasterCache::InvalidateStatic()
+{
+	mStaticChanged = true;
+}
+
+void ShadowCasterCache::Update(CXMMATRIX lightView, CXMMATRIX lightProj)
+{
+	PROFILE_FUNCTION();
+
+	XMMATRIX viewProj = XMMatrixMultiply(lightView, lightProj);
+
+	XMFLOAT4X4 vp;
+	XMStoreFloat4x4(&vp, viewProj);
+
+	// Any change to the light, even a tiny one, moves every static shadow texel, so
+	// compare bitwise.
+	bool lightChanged = memcmp(&vp, &mCachedViewProj, sizeof(XMFLOAT4X4)) != 0;
+
+	mVisibleStatic.clear();
+	mVisibleDynamic.clear();
+	mCulledCasterCount = 0;
+
+	for(size_t i = 0; i < mCasters.size(); ++i)
+	{
+		Caster& caster = mCasters[i];
+
+		// The light projection is orthographic, so the bounds in NDC space are
+		// found the same way as under a rigid transform.
+		XMFLOAT3 bMin, bMax;
+		ShadowCascades::TransformBox(caster.Bounds, viewProj, bMin, bMax);
+
+		// Extrude the frustum toward the light: a caster between the light and the
+		// near plane still shadows what is inside, so only the far plane culls in z.
+		caster.Visible =
+			bMin.x <= 1.0f && bMax.x >= -1.0f &&
+			bMin.y <= 1.0f && bMax.y >= -1.0f &&
+			bMin.z <= 1.0f;
+
+		if( !caster.Visible )
+		{
+			++mCulledCasterCount;
+			continue;
+		}
+
+		if( caster.Static )
+			mVisibleStatic.push_back((UINT)i);
+		else
+			mVisibleDynamic.push_back((UINT)i);
+	}
+
+	mStaticDepthDirty = mStaticChanged || lightChanged;
+	if( mStaticDepthDirty )
+	{
+		mCachedViewProj = vp;
+		mStaticChanged = false;
+		++mStaticRebuildCount;
+	}
+	else
+	{
+		mSkippedRedrawCount += (UINT)mVisibleStatic.size();
+	}
+}
+
+bool ShadowCasterCache::StaticDepthDirty()const
+{
+	return mStaticDepthDirty;
+}
+
+bool ShadowCasterCache::IsCasterVisible(UINT id)const
+{
+	return mCasters[id].Visible;
+}
+
+bool ShadowCasterCache::IsCasterStatic(UINT id)const
+{
+	return mCasters[id].Static;
+}
+
+const std::vector<UINT>& ShadowCasterCache::VisibleStaticCasters()const
+{
+	return mVisibleStatic;
+}
+
+const std::vector<UINT>& ShadowCasterCache::VisibleDynamicCasters()const
+{
+	return mVisibleDynamic;
+}
+
+UINT ShadowCasterCache::CulledCasterCount()const
+{
+	return mCulledCasterCount;
+}
+
+UINT ShadowCasterCache::SkippedRedrawCount()const
+{
+	return mSkippedRedrawCount;
+}
+
+UINT ShadowCasterCache::StaticRebuildCount()const
+{
+	return mStaticRebuildCount;
+}
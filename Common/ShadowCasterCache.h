@@ -0,0 +1,89 @@
+//***************************************************************************************
+// ShadowCasterCache.h
+//
+// Bookkeeping for the objects drawn into a shadow map.  Casters are registered once
+// with their world space bounds and flagged static or dynamic.  Every frame the cache
+// culls them against the light frustum extruded toward the light, and tells the
+// application whether the depth of the static casters has to be rendered again or
+// whether the copy from an earlier frame can be reused.  The static depth only has
+// to be rebuilt when the light matrices change or a static caster is moved.
+//
+// The class does not touch Direct3D; the application owns the cached depth texture.
+//***************************************************************************************
+
+#ifndef SHADOWCASTERCACHE_H
+#define SHADOWCASTERCACHE_H
+
+#include "MathHelper.h"
+#include "xnacollision.h"
+#include <vector>
+
+class ShadowCasterCache
+{
+public:
+	ShadowCasterCache();
+	~ShadowCasterCache();
+
+	///<summary>
+	/// Registers a caster and returns its id.  Adding a static caster invalidates
+	/// the cached static depth.
+	///</summary>
+	UINT AddCaster(const XNA::AxisAlignedBox& worldBounds, bool isStatic);
+
+	///<summary>
+	/// Updates the world space bounds of a caster.  Moving a static caster
+	/// invalidates the cached static depth; dynamic casters are free to move.
+	///</summary>
+	void SetCasterBounds(UINT id, const XNA::AxisAlignedBox& worldBounds);
+
+	// Forces the static depth to be rebuilt on the next Update().
+	void InvalidateStatic();
+
+	///<summary>
+	/// Call once per frame after the light matrices are known.  Culls every
+	/// caster and decides whether the static depth is still valid.
+	///</summary>
+	void Update(CXMMATRIX lightView, CXMMATRIX lightProj);
+
+	// True when the static casters must be drawn into the cached depth this frame.
+	bool StaticDepthDirty()const;
+
+	bool IsCasterVisible(UINT id)const;
+	bool IsCasterStatic(UINT id)const;
+
+	const std::vector<UINT>& VisibleStaticCasters()const;
+	const std::vector<UINT>& VisibleDynamicCasters()const;
+
+	// Casters culled by the last Update().
+	UINT CulledCasterCount()const;
+
+	// Static caster draws avoided by reusing the cached depth, summed over all frames.
+	UINT SkippedRedrawCount()const;
+
+	// Number of times the static depth had to be rebuilt.
+	UINT StaticRebuildCount()const;
+
+private:
+	struct Caster
+	{
+		XNA::AxisAlignedBox Bounds;
+		bool Static;
+		bool Visible;
+	};
+
+	std::vector<Caster> mCasters;
+	std::vector<UINT> mVisibleStatic;
+	std::vector<UINT> mVisibleDynamic;
+
+	// Light view*proj the cached static depth was built with.
+	XMFLOAT4X4 mCachedViewProj;
+
+	bool mStaticChanged;
+	bool mStaticDepthDirty;
+
+	UINT mCulledCasterCount;
+	UINT mSkippedRedrawCount;
+	UINT mStaticRebuildCount;
+};
+
+#endif // SHADOWCASTERCACHE_H
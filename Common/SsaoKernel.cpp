@@ -0,0 +1,189 @@
+//***************************************************************************************
+// SsaoKernel.cpp
+//***************************************************************************************
+
+#include "SsaoKernel.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	const float GoldenRatioConjugate = 0.61803398875f;
+
+	XMVECTOR RandomUnitVector(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+		float z   = 2.0f*dist(rng) - 1.0f;
+		float phi = 2.0f*MathHelper::Pi*dist(rng);
+		float r   = sqrtf(MathHelper::Max(0.0f, 1.0f - z*z));
+
+		return XMVectorSet(r*cosf(phi), r*sinf(phi), z, 0.0f);
+	}
+
+	// Distance between the lines spanned by two unit vectors; zero when they are
+	// parallel or opposite.
+	float LineDistance(FXMVECTOR a, FXMVECTOR b)
+	{
+		return 1.0f - fabsf(XMVectorGetX(XMVector3Dot(a, b)));
+	}
+}
+
+void SsaoKernel::BuildOffsets(Distribution dist, UINT count, UINT seed, float minLength, XMFLOAT4* offsets)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<XMFLOAT3> dirs(count);
+
+	switch(dist)
+	{
+	case Cube:
+	{
+		// Alternate the points on opposite sides of the cube so the vectors stay
+		// spread out when fewer than 14 are used.
+		static const float cube[14][3] =
+		{
+			{+1.0f, +1.0f, +1.0f}, {-1.0f, -1.0f, -1.0f},
+			{-1.0f, +1.0f, +1.0f}, {+1.0f, -1.0f, -1.0f},
+			{+1.0f, +1.0f, -1.0f}, {-1.0f, -1.0f, +1.0f},
+			{-1.0f, +1.0f, -1.0f}, {+1.0f, -1.0f, +1.0f},
+			{-1.0f,  0.0f,  0.0f}, {+1.0f,  0.0f,  0.0f},
+			{ 0.0f, -1.0f,  0.0f}, { 0.0f, +1.0f,  0.0f},
+			{ 0.0f,  0.0f, -1.0f}, { 0.0f,  0.0f, +1.0f}
+		};
+
+		for(UINT i = 0; i < count; ++i)
+		{
+			const float* c = cube[i % 14];
+			XMStoreFloat3(&dirs[i], XMVector3Normalize(XMVectorSet(c[0], c[1], c[2], 0.0f)));
+		}
+		break;
+	}
+
+	case Stratified:
+	{
+		// One jittered sample per equal area band of the hemisphere (z uniform in
+		// [0,1]); the azimuth advances by the golden angle so neighbouring bands do
+		// not line up.
+		float phase = unit(rng);
+		for(UINT i = 0; i < count; ++i)
+		{
+			float z   = ((float)i + unit(rng)) / (float)count;
+			float phi = 2.0f*MathHelper::Pi*(phase + i*GoldenRatioConjugate);
+			float r   = sqrtf(MathHelper::Max(0.0f, 1.0f - z*z));
+
+			dirs[i] = XMFLOAT3(r*cosf(phi), r*sinf(phi), z);
+		}
+		break;
+	}
+
+	case BlueNoise:
+	{
+		// The shader folds every offset into the hemisphere of the normal, so the
+		// points are spread over lines through the origin rather than over the
+		// sphere.
+		const UINT candidatesPerPoint = 32;
+		for(UINT i = 0; i < count; ++i)
+		{
+			XMVECTOR best = RandomUnitVector(rng);
+			float bestDist = -1.0f;
+
+			for(UINT c = 0; i > 0 && c < candidatesPerPoint; ++c)
+			{
+				XMVECTOR candidate = RandomUnitVector(rng);
+
+				float nearest = MathHelper::Infinity;
+				for(UINT j = 0; j < i; ++j)
+					nearest = MathHelper::Min(nearest, LineDistance(candidate, XMLoadFloat3(&dirs[j])));
+
+				if( nearest > bestDist )
+				{
+					bestDist = nearest;
+					best = candidate;
+				}
+			}
+
+			XMStoreFloat3(&dirs[i], best);
+		}
+		break;
+	}
+	}
+
+	// Stratify the lengths as well and hand them out in random order, so short and
+	// long offsets are not correlated with direction.
+	std::vector<UINT> order(count);
+	for(UINT i = 0; i < count; ++i)
+		order[i] = i;
+	std::shuffle(order.begin(), order.end(), rng);
+
+	for(UINT i = 0; i < count; ++i)
+	{
+		float t = ((float)order[i] + unit(rng)) / (float)count;
+		float s = minLength + (1.0f - minLength)*t;
+
+		offsets[i] = XMFLOAT4(s*dirs[i].x, s*dirs[i].y, s*dirs[i].z, 0.0f);
+	}
+}
+
+void SsaoKernel::BuildRotationVectors(RotationPattern pattern, UINT size, UINT seed, std::vector<XMFLOAT3>& texels)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	texels.resize(size*size);
+
+	if( pattern == WhiteNoise )
+	{
+		for(UINT i = 0; i < size*size; ++i)
+			texels[i] = XMFLOAT3(unit(rng), unit(rng), unit(rng));
+		return;
+	}
+
+	// 16 directions on a spherical Fibonacci lattice, laid out in Bayer order so
+	// adjacent pixels get directions far apart on the lattice.
+	static const UINT bayer[16] =
+	{
+		 0,  8,  2, 10,
+		12,  4, 14,  6,
+		 3, 11,  1,  9,
+		15,  7, 13,  5
+	};
+
+	XMFLOAT3 tile[16];
+	float phase = unit(rng);
+	for(UINT i = 0; i < 16; ++i)
+	{
+		float z   = 1.0f - (2.0f*i + 1.0f)/16.0f;
+		float phi = 2.0f*MathHelper::Pi*(phase + i*GoldenRatioConjugate);
+		float r   = sqrtf(MathHelper::Max(0.0f, 1.0f - z*z));
+
+		// Encode [-1,1] to [0,1]; the shader decodes with 2*c - 1.
+		tile[bayer[i]] = XMFLOAT3(0.5f*r*cosf(phi) + 0.5f, 0.5f*r*sinf(phi) + 0.5f, 0.5f*z + 0.5f);
+	}
+
+	for(UINT y = 0; y < size; ++y)
+	{
+		for(UINT x = 0; x < size; ++x)
+		{
+			texels[y*size + x] = tile[(y % 4)*4 + (x % 4)];
+		}
+	}
+}
+
+float SsaoKernel::MinSeparation(const XMFLOAT4* offsets, UINT count)
+{
+	float maxDot = 0.0f;
+	for(UINT i = 0; i < count; ++i)
+	{
+		XMVECTOR a = XMVector3Normalize(XMLoadFloat4(&offsets[i]));
+		for(UINT j = i + 1; j < count; ++j)
+		{
+			XMVECTOR b = XMVector3Normalize(XMLoadFloat4(&offsets[j]));
+			maxDot = MathHelper::Max(maxDot, fabsf(XMVectorGetX(XMVector3Dot(a, b))));
+		}
+	}
+
+	return acosf(MathHelper::Min(maxDot, 1.0f));
+}
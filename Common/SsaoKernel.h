@@ -0,0 +1,64 @@
+//***************************************************************************************
+// SsaoKernel.h
+//
+// Generates the offset vectors and the random rotation vectors used by the SSAO
+// pass.  The Ssao class builds 14 cube based offsets and a white noise rotation
+// map with MathHelper::RandF; the generators here reproduce that set and add
+// stratified and blue noise sets, all driven by an explicit seed so a set can be
+// regenerated offline and compared against others with SsaoReference.
+//***************************************************************************************
+
+#ifndef SSAOKERNEL_H
+#define SSAOKERNEL_H
+
+#include "MathHelper.h"
+#include <vector>
+
+class SsaoKernel
+{
+public:
+	enum Distribution
+	{
+		// The 8 cube corners and 6 face centers, as in Ssao::BuildOffsetVectors.
+		// At most 14 vectors.
+		Cube = 0,
+
+		// Equal area strata over the hemisphere, one jittered vector per stratum.
+		Stratified = 1,
+
+		// Best candidate (Mitchell) points, spread so that no two vectors point
+		// along nearly the same line.
+		BlueNoise = 2
+	};
+
+	enum RotationPattern
+	{
+		// Independent random vectors per texel, as in Ssao::BuildRandomVectorTexture.
+		WhiteNoise = 0,
+
+		// A 4x4 tile of stratified directions repeated over the map, so every 4x4
+		// block of pixels sees 16 well separated rotations of the kernel.
+		Interleaved4x4 = 1
+	};
+
+	///<summary>
+	/// Fills offsets[0..count) with vectors of random length in [minLength, 1].
+	/// The w component is zero, matching the layout of gOffsetVectors.
+	///</summary>
+	static void BuildOffsets(Distribution dist, UINT count, UINT seed, float minLength, XMFLOAT4* offsets);
+
+	///<summary>
+	/// Fills a size x size map of rotation vectors encoded to [0,1] the way they
+	/// are stored in the R8G8B8A8_UNORM random vector texture.
+	///</summary>
+	static void BuildRotationVectors(RotationPattern pattern, UINT size, UINT seed, std::vector<XMFLOAT3>& texels);
+
+	///<summary>
+	/// Smallest angle, in radians, between any two offsets once each is folded
+	/// into the hemisphere of the other (the shader flips offsets to the front of
+	/// the surface, so v and -v are the same sample).  Larger is better.
+	///</summary>
+	static float MinSeparation(const XMFLOAT4* offsets, UINT count);
+};
+
+#endif // SSAOKERNEL_H
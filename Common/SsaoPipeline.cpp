@@ -0,0 +1,482 @@
+//***************************************************************************************
+// SsaoPipeline.cpp
+//***************************************************************************************
+
+#include "SsaoPipeline.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+	// Marks a checkerboard pixel that still has to be filled from its neighbours.
+	const float Unresolved = -1.0f;
+
+	// Layout of SceneBinFile.h: a format version, the DumpHeader and, for each
+	// render target, a RenderTargetHeader followed by the texels.
+	struct SceneDumpHeader
+	{
+		UINT Width;
+		UINT Height;
+		float FovyRad;
+		float ZNear;
+		float ZFar;
+	};
+
+	struct SceneRenderTargetHeader
+	{
+		UINT DX10Format;
+		UINT FormatBytes;
+	};
+
+	// View space position of the pixel at (u,v) with view space depth z, the way
+	// Ssao.fx rebuilds it from the interpolated far plane corner.
+	XMVECTOR ViewPosition(const SsaoReference::NormalDepthMap& map, float u, float v, float z)
+	{
+		float aspect     = (float)map.Width / (float)map.Height;
+		float halfHeight = tanf(0.5f*map.FovY);
+		float halfWidth  = aspect*halfHeight;
+
+		return XMVectorSet((2.0f*u - 1.0f)*halfWidth*z, (1.0f - 2.0f*v)*halfHeight*z, z, 0.0f);
+	}
+
+	double ElapsedMs(std::chrono::high_resolution_clock::time_point start)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count();
+	}
+}
+
+SsaoPipeline::Desc::Desc()
+: Res(HalfRes), Sampling(AllSamples), HistoryWeight(0.0f), HistoryDepthTolerance(0.05f),
+  BlurCount(4), UpsampleDepthSigma(0.02f)
+{
+}
+
+SsaoPipeline::SsaoPipeline()
+: mFrameIndex(0), mLowWidth(0), mLowHeight(0), mHistoryValid(false)
+{
+}
+
+SsaoPipeline::~SsaoPipeline()
+{
+}
+
+void SsaoPipeline::SetDesc(const Desc& desc)
+{
+	if( desc.Res != mDesc.Res )
+		Reset();
+
+	mDesc = desc;
+	mDesc.HistoryWeight = MathHelper::Clamp(mDesc.HistoryWeight, 0.0f, 0.99f);
+}
+
+const SsaoPipeline::Desc& SsaoPipeline::GetDesc()const
+{
+	return mDesc;
+}
+
+SsaoReference& SsaoPipeline::Occlusion()
+{
+	return mOcclusion;
+}
+
+const SsaoReference& SsaoPipeline::Occlusion()const
+{
+	return mOcclusion;
+}
+
+void SsaoPipeline::Reset()
+{
+	mHistoryValid = false;
+	mFrameIndex = 0;
+}
+
+void SsaoPipeline::BuildLowResNormalDepth(const SsaoReference::NormalDepthMap& normalDepth, UINT threadCount)
+{
+	mLowNormalDepth.resize(mLowWidth*mLowHeight);
+	mLowDepth.resize(mLowWidth*mLowHeight);
+
+	Parallel::For(mLowHeight, threadCount, [&](UINT y)
+	{
+		for(UINT x = 0; x < mLowWidth; ++x)
+		{
+			float u = ((float)x + 0.5f) / (float)mLowWidth;
+			float v = ((float)y + 0.5f) / (float)mLowHeight;
+
+			XMVECTOR nd = SsaoReference::SampleNormalDepth(normalDepth, u, v);
+			XMStoreFloat4(&mLowNormalDepth[y*mLowWidth + x], nd);
+			mLowDepth[y*mLowWidth + x] = XMVectorGetW(nd);
+		}
+	});
+}
+
+bool SsaoPipeline::FetchHistory(const SsaoReference::NormalDepthMap& normalDepth, CXMMATRIX viewToPrevView,
+	CXMMATRIX viewToTex, UINT x, UINT y, float& history)const
+{
+	float u = ((float)x + 0.5f) / (float)mLowWidth;
+	float v = ((float)y + 0.5f) / (float)mLowHeight;
+
+	XMVECTOR p = ViewPosition(normalDepth, u, v, mLowDepth[y*mLowWidth + x]);
+	XMVECTOR prevP = XMVector3TransformCoord(p, viewToPrevView);
+
+	float prevZ = XMVectorGetZ(prevP);
+	if( prevZ <= 0.0f )
+		return false;
+
+	XMVECTOR projP = XMVector4Transform(XMVectorSetW(prevP, 1.0f), viewToTex);
+	projP = projP / XMVectorSplatW(projP);
+
+	float pu = XMVectorGetX(projP);
+	float pv = XMVectorGetY(projP);
+	if( pu < 0.0f || pu > 1.0f || pv < 0.0f || pv > 1.0f )
+		return false;
+
+	// Bilinear fetch of the history that skips taps from another surface.
+	float hx = pu*mLowWidth  - 0.5f;
+	float hy = pv*mLowHeight - 0.5f;
+	float x0 = floorf(hx);
+	float y0 = floorf(hy);
+	float fx = hx - x0;
+	float fy = hy - y0;
+
+	float tolerance = mDesc.HistoryDepthTolerance*prevZ;
+	float sum = 0.0f;
+	float totalWeight = 0.0f;
+
+	for(int j = 0; j < 2; ++j)
+	{
+		for(int i = 0; i < 2; ++i)
+		{
+			int tx = MathHelper::Clamp((int)x0 + i, 0, (int)mLowWidth - 1);
+			int ty = MathHelper::Clamp((int)y0 + j, 0, (int)mLowHeight - 1);
+
+			if( fabsf(mHistoryDepth[ty*mLowWidth + tx] - prevZ) > tolerance )
+				continue;
+
+			float weight = (i ? fx : 1.0f - fx)*(j ? fy : 1.0f - fy);
+			sum += weight*mHistory[ty*mLowWidth + tx];
+			totalWeight += weight;
+		}
+	}
+
+	if( totalWeight <= 1e-4f )
+		return false;
+
+	history = sum / totalWeight;
+	return true;
+}
+
+void SsaoPipeline::Execute(const SsaoReference::NormalDepthMap& normalDepth, CXMMATRIX viewToPrevView,
+	std::vector<float>& ambient, UINT threadCount)
+{
+	PROFILE_FUNCTION();
+
+	UINT lowWidth  = MathHelper::Max(normalDepth.Width / (UINT)mDesc.Res, 1u);
+	UINT lowHeight = MathHelper::Max(normalDepth.Height / (UINT)mDesc.Res, 1u);
+
+	if( normalDepth.Texels.empty() )
+	{
+		ambient.clear();
+		return;
+	}
+
+	if( lowWidth != mLowWidth || lowHeight != mLowHeight )
+	{
+		mLowWidth  = lowWidth;
+		mLowHeight = lowHeight;
+		Reset();
+	}
+
+	BuildLowResNormalDepth(normalDepth, threadCount);
+	mCurrent.resize(mLowWidth*mLowHeight);
+
+	XMMATRIX viewToTex = SsaoReference::BuildViewToTexSpace(normalDepth);
+
+	// Split the kernel into at most 4 groups for the interleaved mode.
+	UINT groupCount = MathHelper::Clamp(mOcclusion.SampleCount(), 1u, 4u);
+	bool useHistory = mHistoryValid && mDesc.HistoryWeight > 0.0f;
+
+	Parallel::For(mLowHeight, threadCount, [&](UINT y)
+	{
+		for(UINT x = 0; x < mLowWidth; ++x)
+		{
+			float u = ((float)x + 0.5f) / (float)mLowWidth;
+			float v = ((float)y + 0.5f) / (float)mLowHeight;
+
+			float history = 0.0f;
+			bool hasHistory = useHistory && FetchHistory(normalDepth, viewToPrevView, viewToTex, x, y, history);
+
+			float current = 0.0f;
+			switch(mDesc.Sampling)
+			{
+			case AllSamples:
+				current = mOcclusion.ComputeTexel(normalDepth, u, v, viewToTex);
+				break;
+
+			case Interleaved2x2:
+			{
+				UINT group = ((x & 1) + 2*(y & 1) + mFrameIndex) % groupCount;
+				current = mOcclusion.ComputeTexel(normalDepth, u, v, viewToTex, group, groupCount);
+				break;
+			}
+
+			case Checkerboard:
+				if( ((x + y + mFrameIndex) & 1) != 0 )
+				{
+					mCurrent[y*mLowWidth + x] = hasHistory ? history : Unresolved;
+					continue;
+				}
+				current = mOcclusion.ComputeTexel(normalDepth, u, v, viewToTex);
+				break;
+			}
+
+			if( hasHistory )
+				current = current + mDesc.HistoryWeight*(history - current);
+
+			mCurrent[y*mLowWidth + x] = current;
+		}
+	});
+
+	if( mDesc.Sampling == Checkerboard )
+	{
+		// Every neighbour of an unresolved pixel was evaluated this frame.
+		Parallel::For(mLowHeight, threadCount, [&](UINT y)
+		{
+			static const int dx[4] = { -1, +1,  0,  0 };
+			static const int dy[4] = {  0,  0, -1, +1 };
+
+			for(UINT x = 0; x < mLowWidth; ++x)
+			{
+				if( mCurrent[y*mLowWidth + x] != Unresolved )
+					continue;
+
+				float z = mLowDepth[y*mLowWidth + x];
+				float tolerance = mDesc.HistoryDepthTolerance*z;
+
+				float nearSum = 0.0f, allSum = 0.0f;
+				UINT nearCount = 0, allCount = 0;
+
+				for(int i = 0; i < 4; ++i)
+				{
+					int nx = (int)x + dx[i];
+					int ny = (int)y + dy[i];
+					if( nx < 0 || ny < 0 || nx >= (int)mLowWidth || ny >= (int)mLowHeight )
+						continue;
+
+					float a = mCurrent[ny*mLowWidth + nx];
+					allSum += a;
+					++allCount;
+
+					if( fabsf(mLowDepth[ny*mLowWidth + nx] - z) <= tolerance )
+					{
+						nearSum += a;
+						++nearCount;
+					}
+				}
+
+				if( nearCount > 0 )
+					mCurrent[y*mLowWidth + x] = nearSum / nearCount;
+				else
+					mCurrent[y*mLowWidth + x] = allCount > 0 ? allSum / allCount : 1.0f;
+			}
+		});
+	}
+
+	// The history keeps the unblurred result so the blur is not compounded
+	// frame after frame.
+	mHistory = mCurrent;
+	mHistoryDepth = mLowDepth;
+	mHistoryValid = true;
+	++mFrameIndex;
+
+	std::vector<float> blurred(mCurrent);
+	mOcclusion.BlurAmbientMap(normalDepth, mLowWidth, mLowHeight, blurred, mDesc.BlurCount, threadCount);
+
+	if( mDesc.Res == FullRes )
+		ambient.swap(blurred);
+	else
+		UpsampleBilateral(normalDepth, blurred, mLowDepth, mLowWidth, mLowHeight,
+			mDesc.UpsampleDepthSigma, ambient, threadCount);
+}
+
+void SsaoPipeline::UpsampleBilateral(const SsaoReference::NormalDepthMap& normalDepth,
+	const std::vector<float>& lowRes, const std::vector<float>& lowDepth,
+	UINT lowWidth, UINT lowHeight, float depthSigma,
+	std::vector<float>& ambient, UINT threadCount)
+{
+	UINT width  = normalDepth.Width;
+	UINT height = normalDepth.Height;
+
+	ambient.resize(width*height);
+	if( lowRes.empty() || lowWidth == 0 || lowHeight == 0 )
+		return;
+
+	Parallel::For(height, threadCount, [&](UINT y)
+	{
+		for(UINT x = 0; x < width; ++x)
+		{
+			float z = normalDepth.Texels[y*width + x].w;
+			float sigma = MathHelper::Max(depthSigma*z, 1e-4f);
+
+			float lx = ((float)x + 0.5f)*lowWidth/width   - 0.5f;
+			float ly = ((float)y + 0.5f)*lowHeight/height - 0.5f;
+			float x0 = floorf(lx);
+			float y0 = floorf(ly);
+			float fx = lx - x0;
+			float fy = ly - y0;
+
+			float sum = 0.0f;
+			float totalWeight = 0.0f;
+
+			float nearestValue = 1.0f;
+			float nearestDist  = MathHelper::Infinity;
+
+			for(int j = 0; j < 2; ++j)
+			{
+				for(int i = 0; i < 2; ++i)
+				{
+					int tx = MathHelper::Clamp((int)x0 + i, 0, (int)lowWidth - 1);
+					int ty = MathHelper::Clamp((int)y0 + j, 0, (int)lowHeight - 1);
+
+					float a  = lowRes[ty*lowWidth + tx];
+					float dz = fabsf(lowDepth[ty*lowWidth + tx] - z);
+
+					float weight = (i ? fx : 1.0f - fx)*(j ? fy : 1.0f - fy)*expf(-dz/sigma);
+					sum += weight*a;
+					totalWeight += weight;
+
+					if( dz < nearestDist )
+					{
+						nearestDist = dz;
+						nearestValue = a;
+					}
+				}
+			}
+
+			ambient[y*width + x] = totalWeight > 1e-4f ? sum / totalWeight : nearestValue;
+		}
+	});
+}
+
+bool SsaoPipeline::LoadSceneBinFile(const std::string& filename, SsaoReference::NormalDepthMap& normalDepth)
+{
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if( !fp )
+		return false;
+
+	UINT formatVersion = 0;
+	SceneDumpHeader header;
+	SceneRenderTargetHeader rtHeader;
+
+	// Only fp32 depths are written by the sample.
+	bool ok = fread(&formatVersion, sizeof(formatVersion), 1, fp) == 1 &&
+		fread(&header, sizeof(header), 1, fp) == 1 &&
+		fread(&rtHeader, sizeof(rtHeader), 1, fp) == 1 &&
+		rtHeader.FormatBytes == sizeof(float) && header.Width > 0 && header.Height > 0;
+
+	std::vector<float> depths;
+	if( ok )
+	{
+		depths.resize(header.Width*header.Height);
+		ok = fread(&depths[0], sizeof(float), depths.size(), fp) == depths.size();
+	}
+
+	fclose(fp);
+	if( !ok )
+		return false;
+
+	UINT width  = header.Width;
+	UINT height = header.Height;
+
+	normalDepth.Width  = width;
+	normalDepth.Height = height;
+	normalDepth.FovY   = header.FovyRad;
+	normalDepth.FarZ   = header.ZFar;
+	normalDepth.Texels.resize(width*height);
+
+	auto position = [&](int x, int y) -> XMVECTOR
+	{
+		float u = ((float)x + 0.5f) / (float)width;
+		float v = ((float)y + 0.5f) / (float)height;
+		return ViewPosition(normalDepth, u, v, depths[y*width + x]);
+	};
+
+	for(UINT y = 0; y < height; ++y)
+	{
+		for(UINT x = 0; x < width; ++x)
+		{
+			XMVECTOR p = position(x, y);
+
+			// Take the one sided difference with the smaller depth change so the
+			// normal is not bent across silhouettes.
+			XMVECTOR dx = XMVectorZero();
+			if( x + 1 < width )
+				dx = position(x + 1, y) - p;
+			if( x > 0 )
+			{
+				XMVECTOR left = p - position(x - 1, y);
+				if( x + 1 >= width || fabsf(XMVectorGetZ(left)) < fabsf(XMVectorGetZ(dx)) )
+					dx = left;
+			}
+
+			XMVECTOR dy = XMVectorZero();
+			if( y + 1 < height )
+				dy = position(x, y + 1) - p;
+			if( y > 0 )
+			{
+				XMVECTOR up = p - position(x, y - 1);
+				if( y + 1 >= height || fabsf(XMVectorGetZ(up)) < fabsf(XMVectorGetZ(dy)) )
+					dy = up;
+			}
+
+			// Screen y runs down, so dx x dy points back toward the camera.
+			XMVECTOR n = XMVector3Cross(dx, dy);
+			if( XMVectorGetX(XMVector3LengthSq(n)) > 1e-12f )
+				n = XMVector3Normalize(n);
+			else
+				n = XMVectorSet(0.0f, 0.0f, -1.0f, 0.0f);
+
+			XMStoreFloat4(&normalDepth.Texels[y*width + x], XMVectorSetW(n, depths[y*width + x]));
+		}
+	}
+
+	return true;
+}
+
+SsaoPipeline::Comparison SsaoPipeline::Compare(const SsaoReference::NormalDepthMap& normalDepth,
+	const SsaoReference& reference, const Desc& desc, UINT frameCount, UINT threadCount)
+{
+	Comparison result;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	std::vector<float> expected;
+	reference.ComputeSsao(normalDepth, normalDepth.Width, normalDepth.Height, expected, threadCount);
+	reference.BlurAmbientMap(normalDepth, normalDepth.Width, normalDepth.Height, expected, desc.BlurCount, threadCount);
+
+	result.ReferenceMs = ElapsedMs(start);
+
+	SsaoPipeline pipeline;
+	pipeline.mOcclusion = reference;
+	pipeline.SetDesc(desc);
+
+	std::vector<float> ambient;
+	result.PipelineMs = 0.0;
+	for(UINT i = 0; i < MathHelper::Max(frameCount, 1u); ++i)
+	{
+		start = std::chrono::high_resolution_clock::now();
+		pipeline.Execute(normalDepth, XMMatrixIdentity(), ambient, threadCount);
+		result.PipelineMs = ElapsedMs(start);
+	}
+
+	result.RootMeanSquareError = SsaoReference::RootMeanSquareError(ambient, expected);
+
+	result.MaxError = 0.0f;
+	for(size_t i = 0; i < ambient.size() && i < expected.size(); ++i)
+		result.MaxError = MathHelper::Max(result.MaxError, fabsf(ambient[i] - expected[i]));
+
+	return result;
+}
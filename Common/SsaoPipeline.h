@@ -0,0 +1,152 @@
+//***************************************************************************************
+// SsaoPipeline.h
+//
+// CPU reference for the reduced cost SSAO modes: the occlusion pass runs at half or
+// quarter resolution, optionally evaluating only part of the sample kernel (or
+// only half of the pixels) each frame, accumulates the result over frames with
+// the previous frame's ambient map reprojected into the current view, and is
+// brought back to full resolution with a depth aware bilateral upsample.
+//
+// Each mode can be compared against the full resolution, all samples result of
+// SsaoReference to measure the error it introduces.
+//***************************************************************************************
+
+#ifndef SSAOPIPELINE_H
+#define SSAOPIPELINE_H
+
+#include "SsaoReference.h"
+
+class SsaoPipeline
+{
+public:
+	enum Resolution
+	{
+		FullRes    = 1,
+		HalfRes    = 2,
+		QuarterRes = 4
+	};
+
+	enum SamplingMode
+	{
+		// Every pixel evaluates the whole kernel every frame.
+		AllSamples = 0,
+
+		// Each pixel of a 2x2 block evaluates a different quarter of the kernel
+		// and the assignment rotates every frame; the blur and the history fill in
+		// the rest.
+		Interleaved2x2 = 1,
+
+		// Half of the pixels, in a checkerboard that flips every frame, evaluate
+		// the kernel; the others take the reprojected history, or the average of
+		// their evaluated neighbours when there is no valid history.
+		Checkerboard = 2
+	};
+
+	struct Desc
+	{
+		Desc();
+
+		Resolution Res;
+		SamplingMode Sampling;
+
+		// Weight of the reprojected history in [0,1); 0 disables accumulation.
+		float HistoryWeight;
+
+		// History is rejected when its depth differs from the reprojected depth
+		// by more than this fraction of the depth.
+		float HistoryDepthTolerance;
+
+		// Blur passes applied to the low resolution map, as Ssao::BlurAmbientMap.
+		int BlurCount;
+
+		// Depth falloff of the upsample, as a fraction of the pixel depth.
+		float UpsampleDepthSigma;
+	};
+
+	struct Comparison
+	{
+		float RootMeanSquareError;
+		float MaxError;
+
+		// Time of the last frame of the pipeline and of the full resolution
+		// reference, in milliseconds.
+		double PipelineMs;
+		double ReferenceMs;
+	};
+
+	SsaoPipeline();
+	~SsaoPipeline();
+
+	void SetDesc(const Desc& desc);
+	const Desc& GetDesc()const;
+
+	// Settings, offsets and rotation vectors of the occlusion pass.
+	SsaoReference& Occlusion();
+	const SsaoReference& Occlusion()const;
+
+	///<summary>
+	/// Drops the history, e.g. after a camera cut or a resize.
+	///</summary>
+	void Reset();
+
+	///<summary>
+	/// Runs one frame and writes a full resolution ambient map.  viewToPrevView
+	/// maps the current view space to the view space of the previous call (the
+	/// identity for a static camera); the projection is assumed unchanged.
+	///</summary>
+	void Execute(const SsaoReference::NormalDepthMap& normalDepth, CXMMATRIX viewToPrevView,
+		std::vector<float>& ambient, UINT threadCount = 0);
+
+	///<summary>
+	/// Upsamples a lowWidth x lowHeight ambient map to the size of normalDepth.
+	/// Each full resolution pixel takes the four nearest low resolution texels,
+	/// weighting the bilinear weights by how close each texel's depth is to its
+	/// own; if all four lie across an edge it takes the closest in depth.
+	///</summary>
+	static void UpsampleBilateral(const SsaoReference::NormalDepthMap& normalDepth,
+		const std::vector<float>& lowRes, const std::vector<float>& lowDepth,
+		UINT lowWidth, UINT lowHeight, float depthSigma,
+		std::vector<float>& ambient, UINT threadCount = 0);
+
+	///<summary>
+	/// Loads a scene dump of the ScreenSpaceAO sample (SceneBinFile.h): a linear
+	/// depth buffer, from which the view space normals are rebuilt by central
+	/// differences.  The color buffer that follows is ignored.
+	///</summary>
+	static bool LoadSceneBinFile(const std::string& filename, SsaoReference::NormalDepthMap& normalDepth);
+
+	///<summary>
+	/// Runs frameCount frames of a static view through a pipeline with desc and
+	/// compares the last one against the full resolution, all samples map of
+	/// reference (both blurred blurCount times at their own resolution).
+	///</summary>
+	static Comparison Compare(const SsaoReference::NormalDepthMap& normalDepth,
+		const SsaoReference& reference, const Desc& desc, UINT frameCount, UINT threadCount = 0);
+
+private:
+	void BuildLowResNormalDepth(const SsaoReference::NormalDepthMap& normalDepth, UINT threadCount);
+
+	// Reprojected history at low resolution texel (x,y); false if off screen or
+	// every tap is rejected by the depth test.
+	bool FetchHistory(const SsaoReference::NormalDepthMap& normalDepth, CXMMATRIX viewToPrevView,
+		CXMMATRIX viewToTex, UINT x, UINT y, float& history)const;
+
+private:
+	Desc mDesc;
+	SsaoReference mOcclusion;
+
+	UINT mFrameIndex;
+	UINT mLowWidth;
+	UINT mLowHeight;
+
+	// Normal/depth resolved at the low resolution texel centers.
+	std::vector<XMFLOAT4> mLowNormalDepth;
+	std::vector<float> mLowDepth;
+
+	std::vector<float> mCurrent;
+	std::vector<float> mHistory;
+	std::vector<float> mHistoryDepth;
+	bool mHistoryValid;
+};
+
+#endif // SSAOPIPELINE_H
@@ -0,0 +1,413 @@
+//***************************************************************************************
+// SsaoReference.cpp
+//***************************************************************************************
+
+#include "SsaoReference.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const UINT NormalDepthMagic   = 0x444E5353; // 'SSND'
+	const UINT NormalDepthVersion = 1;
+
+	const UINT TileSize = 16;
+
+	// Bilinear filter with texel centers at (i+0.5)/size, like MIN_MAG_LINEAR.
+	template<typename Fetch>
+	XMVECTOR SampleBilinear(float u, float v, UINT width, UINT height, Fetch fetch)
+	{
+		float x = u*width  - 0.5f;
+		float y = v*height - 0.5f;
+
+		float x0 = floorf(x);
+		float y0 = floorf(y);
+		float fx = x - x0;
+		float fy = y - y0;
+
+		int ix = (int)x0;
+		int iy = (int)y0;
+
+		XMVECTOR c00 = fetch(ix,   iy);
+		XMVECTOR c10 = fetch(ix+1, iy);
+		XMVECTOR c01 = fetch(ix,   iy+1);
+		XMVECTOR c11 = fetch(ix+1, iy+1);
+
+		return XMVectorLerp(XMVectorLerp(c00, c10, fx), XMVectorLerp(c01, c11, fx), fy);
+	}
+
+	// samNormalDepth in Ssao.fx: BORDER addressing with a very far depth so
+	// samples off screen never occlude.
+	XMVECTOR SampleNormalDepthBorder(const SsaoReference::NormalDepthMap& map, float u, float v)
+	{
+		return SampleBilinear(u, v, map.Width, map.Height, [&](int x, int y) -> XMVECTOR
+		{
+			if( x < 0 || y < 0 || x >= (int)map.Width || y >= (int)map.Height )
+				return XMVectorSet(0.0f, 0.0f, 0.0f, 1e5f);
+			return XMLoadFloat4(&map.Texels[y*map.Width + x]);
+		});
+	}
+
+	// samNormalDepth in SsaoBlur.fx: CLAMP addressing.
+	XMVECTOR SampleNormalDepthClamp(const SsaoReference::NormalDepthMap& map, float u, float v)
+	{
+		return SampleBilinear(u, v, map.Width, map.Height, [&](int x, int y) -> XMVECTOR
+		{
+			x = MathHelper::Clamp(x, 0, (int)map.Width - 1);
+			y = MathHelper::Clamp(y, 0, (int)map.Height - 1);
+			return XMLoadFloat4(&map.Texels[y*map.Width + x]);
+		});
+	}
+
+	float Occlusion(const SsaoReference::Settings& s, float distZ)
+	{
+		float occlusion = 0.0f;
+		if( distZ > s.SurfaceEpsilon )
+		{
+			float fadeLength = s.OcclusionFadeEnd - s.OcclusionFadeStart;
+			occlusion = MathHelper::Clamp((s.OcclusionFadeEnd - distZ)/fadeLength, 0.0f, 1.0f);
+		}
+
+		return occlusion;
+	}
+}
+
+SsaoReference::NormalDepthMap::NormalDepthMap()
+: Width(0), Height(0), FovY(0.25f*MathHelper::Pi), FarZ(1000.0f)
+{
+}
+
+bool SsaoReference::NormalDepthMap::Load(const std::string& filename)
+{
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if( !fp )
+		return false;
+
+	UINT header[4];
+	float frustum[2];
+	bool ok = fread(header, sizeof(header), 1, fp) == 1 &&
+		fread(frustum, sizeof(frustum), 1, fp) == 1 &&
+		header[0] == NormalDepthMagic && header[1] == NormalDepthVersion;
+
+	if( ok )
+	{
+		Width  = header[2];
+		Height = header[3];
+		FovY   = frustum[0];
+		FarZ   = frustum[1];
+
+		Texels.resize(Width*Height);
+		ok = Texels.empty() || fread(&Texels[0], sizeof(XMFLOAT4), Texels.size(), fp) == Texels.size();
+	}
+
+	fclose(fp);
+	return ok;
+}
+
+bool SsaoReference::NormalDepthMap::Save(const std::string& filename)const
+{
+	FILE* fp = fopen(filename.c_str(), "wb");
+	if( !fp )
+		return false;
+
+	UINT header[4] = { NormalDepthMagic, NormalDepthVersion, Width, Height };
+	float frustum[2] = { FovY, FarZ };
+
+	bool ok = fwrite(header, sizeof(header), 1, fp) == 1 &&
+		fwrite(frustum, sizeof(frustum), 1, fp) == 1 &&
+		(Texels.empty() || fwrite(&Texels[0], sizeof(XMFLOAT4), Texels.size(), fp) == Texels.size());
+
+	fclose(fp);
+	return ok;
+}
+
+SsaoReference::Settings::Settings()
+: OcclusionRadius(0.5f), OcclusionFadeStart(0.2f), OcclusionFadeEnd(2.0f), SurfaceEpsilon(0.05f)
+{
+}
+
+SsaoReference::SsaoReference()
+: mSampleCount(0), mRandomVectorSize(0)
+{
+	// Default to the same kind of data the Ssao class builds.
+	mSampleCount = 14;
+	SsaoKernel::BuildOffsets(SsaoKernel::Cube, mSampleCount, 0, 0.25f, mOffsets);
+
+	mRandomVectorSize = 256;
+	SsaoKernel::BuildRotationVectors(SsaoKernel::WhiteNoise, mRandomVectorSize, 0, mRandomVectors);
+}
+
+SsaoReference::~SsaoReference()
+{
+}
+
+void SsaoReference::SetSettings(const Settings& settings)
+{
+	mSettings = settings;
+}
+
+void SsaoReference::SetOffsetVectors(const XMFLOAT4* offsets, UINT count)
+{
+	mSampleCount = MathHelper::Min(count, (UINT)MaxSampleCount);
+	memcpy(mOffsets, offsets, mSampleCount*sizeof(XMFLOAT4));
+}
+
+void SsaoReference::SetRandomVectors(const std::vector<XMFLOAT3>& texels, UINT size)
+{
+	mRandomVectors = texels;
+	mRandomVectorSize = size;
+}
+
+UINT SsaoReference::SampleCount()const
+{
+	return mSampleCount;
+}
+
+XMMATRIX SsaoReference::BuildViewToTexSpace(const NormalDepthMap& normalDepth)
+{
+	// Transform NDC space [-1,+1]^2 to texture space [0,1]^2
+	XMMATRIX T(
+		0.5f, 0.0f, 0.0f, 0.0f,
+		0.0f, -0.5f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.5f, 0.5f, 0.0f, 1.0f);
+
+	float aspect = (float)normalDepth.Width / (float)normalDepth.Height;
+	XMMATRIX P = XMMatrixPerspectiveFovLH(normalDepth.FovY, aspect, 1.0f, normalDepth.FarZ);
+
+	return XMMatrixMultiply(P, T);
+}
+
+XMVECTOR SsaoReference::SampleNormalDepth(const NormalDepthMap& normalDepth, float u, float v)
+{
+	return SampleNormalDepthClamp(normalDepth, u, v);
+}
+
+float SsaoReference::ComputeTexel(const NormalDepthMap& normalDepth, float u, float v, CXMMATRIX viewToTex,
+	UINT firstSample, UINT sampleStride)const
+{
+	// p -- the point we are computing the ambient occlusion for.
+	// n -- normal vector at p.
+	// q -- a random offset from p.
+	// r -- a potential occluder that might occlude p.
+
+	XMVECTOR nd = SampleNormalDepthBorder(normalDepth, u, v);
+	XMVECTOR n  = XMVectorSetW(nd, 0.0f);
+	float pz    = XMVectorGetW(nd);
+
+	// The vertex shader interpolates the far plane corners across the quad.
+	float aspect     = (float)normalDepth.Width / (float)normalDepth.Height;
+	float halfHeight = normalDepth.FarZ * tanf(0.5f*normalDepth.FovY);
+	float halfWidth  = aspect*halfHeight;
+
+	XMVECTOR toFarPlane = XMVectorSet(
+		(2.0f*u - 1.0f)*halfWidth, (1.0f - 2.0f*v)*halfHeight, normalDepth.FarZ, 0.0f);
+
+	XMVECTOR p = (pz/normalDepth.FarZ)*toFarPlane;
+
+	// samRandomVec: linear filter, WRAP addressing, tiled 4 times.
+	UINT size = mRandomVectorSize;
+	XMVECTOR randVec = SampleBilinear(4.0f*u, 4.0f*v, size, size, [&](int x, int y) -> XMVECTOR
+	{
+		x = ((x % (int)size) + (int)size) % (int)size;
+		y = ((y % (int)size) + (int)size) % (int)size;
+		return XMLoadFloat3(&mRandomVectors[y*size + x]);
+	});
+	randVec = 2.0f*randVec - XMVectorSplatOne();
+	randVec = XMVectorSetW(randVec, 0.0f);
+
+	float occlusionSum = 0.0f;
+	UINT samplesTaken = 0;
+
+	for(UINT i = firstSample; i < mSampleCount; i += sampleStride, ++samplesTaken)
+	{
+		// reflect(o, r) = o - 2*dot(o, r)*r
+		XMVECTOR o = XMVectorSetW(XMLoadFloat4(&mOffsets[i]), 0.0f);
+		XMVECTOR offset = o - 2.0f*XMVector3Dot(o, randVec)*randVec;
+
+		// Flip offset vector if it is behind the plane defined by (p, n).
+		float d = XMVectorGetX(XMVector3Dot(offset, n));
+		float flip = d > 0.0f ? 1.0f : (d < 0.0f ? -1.0f : 0.0f);
+
+		XMVECTOR q = p + (flip*mSettings.OcclusionRadius)*offset;
+
+		XMVECTOR projQ = XMVector4Transform(XMVectorSetW(q, 1.0f), viewToTex);
+		projQ = projQ / XMVectorSplatW(projQ);
+
+		float rz = XMVectorGetW(SampleNormalDepthBorder(normalDepth, XMVectorGetX(projQ), XMVectorGetY(projQ)));
+
+		XMVECTOR r = (rz/XMVectorGetZ(q))*q;
+
+		float distZ = XMVectorGetZ(p) - rz;
+		float dp = MathHelper::Max(XMVectorGetX(XMVector3Dot(n, XMVector3Normalize(r - p))), 0.0f);
+
+		occlusionSum += dp*Occlusion(mSettings, distZ);
+	}
+
+	if( samplesTaken > 0 )
+		occlusionSum /= (float)samplesTaken;
+
+	float access = 1.0f - occlusionSum;
+
+	return MathHelper::Clamp(powf(access, 4.0f), 0.0f, 1.0f);
+}
+
+void SsaoReference::ComputeSsao(const NormalDepthMap& normalDepth, UINT width, UINT height,
+	std::vector<float>& ambient, UINT threadCount)const
+{
+	PROFILE_FUNCTION();
+
+	ambient.resize(width*height);
+	if( width == 0 || height == 0 || normalDepth.Texels.empty() )
+		return;
+
+	XMMATRIX viewToTex = BuildViewToTexSpace(normalDepth);
+
+	UINT tilesX = (width  + TileSize - 1) / TileSize;
+	UINT tilesY = (height + TileSize - 1) / TileSize;
+
+	Parallel::For(tilesX*tilesY, threadCount, [&](UINT tile)
+	{
+		UINT x0 = (tile % tilesX)*TileSize;
+		UINT y0 = (tile / tilesX)*TileSize;
+		UINT x1 = MathHelper::Min(x0 + TileSize, width);
+		UINT y1 = MathHelper::Min(y0 + TileSize, height);
+
+		for(UINT y = y0; y < y1; ++y)
+		{
+			for(UINT x = x0; x < x1; ++x)
+			{
+				float u = ((float)x + 0.5f) / (float)width;
+				float v = ((float)y + 0.5f) / (float)height;
+
+				ambient[y*width + x] = ComputeTexel(normalDepth, u, v, viewToTex);
+			}
+		}
+	});
+}
+
+void SsaoReference::BlurAmbientMap(const NormalDepthMap& normalDepth, UINT width, UINT height,
+	std::vector<float>& ambient, int blurCount, UINT threadCount)const
+{
+	PROFILE_FUNCTION();
+
+	static const int BlurRadius = 5;
+	static const float Weights[2*BlurRadius + 1] =
+	{
+		0.05f, 0.05f, 0.1f, 0.1f, 0.1f, 0.2f, 0.1f, 0.1f, 0.1f, 0.05f, 0.05f
+	};
+
+	if( width == 0 || height == 0 || normalDepth.Texels.empty() )
+		return;
+
+	// The blur samples the full size normal/depth map at the texel centers of
+	// the (smaller) ambient map, so resolve those samples once.
+	std::vector<XMFLOAT4> nd(width*height);
+	Parallel::For(height, threadCount, [&](UINT y)
+	{
+		for(UINT x = 0; x < width; ++x)
+		{
+			float u = ((float)x + 0.5f) / (float)width;
+			float v = ((float)y + 0.5f) / (float)height;
+			XMStoreFloat4(&nd[y*width + x], SampleNormalDepthClamp(normalDepth, u, v));
+		}
+	});
+
+	std::vector<float> temp(width*height);
+
+	for(int pass = 0; pass < 2*blurCount; ++pass)
+	{
+		bool horzBlur = (pass % 2) == 0;
+		const std::vector<float>& input = horzBlur ? ambient : temp;
+		std::vector<float>& output      = horzBlur ? temp : ambient;
+
+		Parallel::For(height, threadCount, [&](UINT y)
+		{
+			for(UINT x = 0; x < width; ++x)
+			{
+				XMVECTOR centerNormalDepth = XMLoadFloat4(&nd[y*width + x]);
+
+				// The center value always contributes to the sum.
+				float color       = Weights[BlurRadius]*input[y*width + x];
+				float totalWeight = Weights[BlurRadius];
+
+				for(int i = -BlurRadius; i <= BlurRadius; ++i)
+				{
+					if( i == 0 )
+						continue;
+
+					// Samples land on texel centers, so CLAMP addressing reduces
+					// to clamping the texel index.
+					int sx = horzBlur ? MathHelper::Clamp((int)x + i, 0, (int)width - 1) : (int)x;
+					int sy = horzBlur ? (int)y : MathHelper::Clamp((int)y + i, 0, (int)height - 1);
+
+					XMVECTOR neighborNormalDepth = XMLoadFloat4(&nd[sy*width + sx]);
+
+					// Discard samples across a discontinuity in normal or depth.
+					if( XMVectorGetX(XMVector3Dot(neighborNormalDepth, centerNormalDepth)) >= 0.8f &&
+						fabsf(XMVectorGetW(neighborNormalDepth) - XMVectorGetW(centerNormalDepth)) <= 0.2f )
+					{
+						float weight = Weights[i + BlurRadius];
+						color += weight*input[sy*width + sx];
+						totalWeight += weight;
+					}
+				}
+
+				output[y*width + x] = color / totalWeight;
+			}
+		});
+	}
+}
+
+float SsaoReference::RootMeanSquareError(const std::vector<float>& a, const std::vector<float>& b)
+{
+	size_t n = MathHelper::Min(a.size(), b.size());
+	if( n == 0 )
+		return 0.0f;
+
+	double sum = 0.0;
+	for(size_t i = 0; i < n; ++i)
+	{
+		double d = (double)a[i] - (double)b[i];
+		sum += d*d;
+	}
+
+	return (float)sqrt(sum / (double)n);
+}
+
+UINT SsaoReference::FindCheapestSampleCount(const NormalDepthMap& normalDepth, UINT width, UINT height,
+	SsaoKernel::Distribution dist, UINT minCount, UINT maxCount, UINT referenceCount,
+	int blurCount, float maxError, UINT seed)const
+{
+	SsaoReference ref(*this);
+
+	std::vector<XMFLOAT4> offsets(MaxSampleCount);
+
+	referenceCount = MathHelper::Min(referenceCount, (UINT)MaxSampleCount);
+	SsaoKernel::BuildOffsets(SsaoKernel::BlueNoise, referenceCount, seed, 0.25f, &offsets[0]);
+	ref.SetOffsetVectors(&offsets[0], referenceCount);
+
+	std::vector<float> reference;
+	ref.ComputeSsao(normalDepth, width, height, reference);
+	ref.BlurAmbientMap(normalDepth, width, height, reference, blurCount);
+
+	maxCount = MathHelper::Min(maxCount, dist == SsaoKernel::Cube ? 14u : (UINT)MaxSampleCount);
+
+	std::vector<float> ambient;
+	for(UINT count = MathHelper::Max(minCount, 1u); count <= maxCount; ++count)
+	{
+		SsaoKernel::BuildOffsets(dist, count, seed, 0.25f, &offsets[0]);
+		ref.SetOffsetVectors(&offsets[0], count);
+
+		ref.ComputeSsao(normalDepth, width, height, ambient);
+		ref.BlurAmbientMap(normalDepth, width, height, ambient, blurCount);
+
+		if( RootMeanSquareError(ambient, reference) <= maxError )
+			return count;
+	}
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+//***************************************************************************************
+// SsaoReference.h
+//
+// Headless CPU implementation of the Ssao.fx occlusion pass and the SsaoBlur.fx
+// edge preserving blur.  It reads a dump of the view space normal/depth map and
+// produces the same ambient map the GPU does, so sample sets can be compared
+// offline and the shaders can be regression tested against a known image.
+//
+// The per pixel math uses XNA math vectors and the image is split into tiles that
+// are processed on a pool of threads.
+//***************************************************************************************
+
+#ifndef SSAOREFERENCE_H
+#define SSAOREFERENCE_H
+
+#include "MathHelper.h"
+#include "SsaoKernel.h"
+#include <string>
+#include <vector>
+
+class SsaoReference
+{
+public:
+	static const UINT MaxSampleCount = 64;
+
+	// View space normal in xyz and view space depth in w, as written by
+	// SsaoNormalDepth.fx.
+	struct NormalDepthMap
+	{
+		NormalDepthMap();
+
+		UINT Width;
+		UINT Height;
+		float FovY;
+		float FarZ;
+		std::vector<XMFLOAT4> Texels;
+
+		///<summary>
+		/// Binary dump: 'SSND', version, width, height, fovy, farZ followed by
+		/// width*height float4 texels in row order.
+		///</summary>
+		bool Load(const std::string& filename);
+		bool Save(const std::string& filename)const;
+	};
+
+	// Mirrors the cbPerFrame constants of Ssao.fx.
+	struct Settings
+	{
+		Settings();
+
+		float OcclusionRadius;
+		float OcclusionFadeStart;
+		float OcclusionFadeEnd;
+		float SurfaceEpsilon;
+	};
+
+	SsaoReference();
+	~SsaoReference();
+
+	void SetSettings(const Settings& settings);
+
+	///<summary>
+	/// Offsets to sample with; count is clamped to MaxSampleCount.
+	///</summary>
+	void SetOffsetVectors(const XMFLOAT4* offsets, UINT count);
+
+	///<summary>
+	/// Rotation vectors encoded to [0,1], size x size, sampled with wrap addressing
+	/// at 4x the ambient map texture coordinates.
+	///</summary>
+	void SetRandomVectors(const std::vector<XMFLOAT3>& texels, UINT size);
+
+	///<summary>
+	/// Runs the occlusion pass for an ambient map of width x height (half the
+	/// normal/depth size in the demos).  threadCount 0 uses every hardware thread.
+	///</summary>
+	void ComputeSsao(const NormalDepthMap& normalDepth, UINT width, UINT height,
+		std::vector<float>& ambient, UINT threadCount = 0)const;
+
+	///<summary>
+	/// Applies blurCount horizontal+vertical passes of the bilateral blur in place.
+	///</summary>
+	void BlurAmbientMap(const NormalDepthMap& normalDepth, UINT width, UINT height,
+		std::vector<float>& ambient, int blurCount, UINT threadCount = 0)const;
+
+	///<summary>
+	/// Occlusion of the pixel at texture coordinates (u,v), using the offsets
+	/// firstSample, firstSample + sampleStride, ...  A stride > 1 spreads the
+	/// kernel over neighbouring pixels or frames.
+	///</summary>
+	float ComputeTexel(const NormalDepthMap& normalDepth, float u, float v, CXMMATRIX viewToTex,
+		UINT firstSample = 0, UINT sampleStride = 1)const;
+
+	UINT SampleCount()const;
+
+	// Proj*Texture for the frustum the map was rendered with (gViewToTexSpace).
+	static XMMATRIX BuildViewToTexSpace(const NormalDepthMap& normalDepth);
+
+	// Bilinear, clamped sample of the normal/depth map.
+	static XMVECTOR SampleNormalDepth(const NormalDepthMap& normalDepth, float u, float v);
+
+	static float RootMeanSquareError(const std::vector<float>& a, const std::vector<float>& b);
+
+	///<summary>
+	/// Finds the smallest sample count in [minCount, maxCount] whose blurred ambient
+	/// map is within maxError (RMS) of a reference computed with referenceCount
+	/// blue noise samples.  Returns 0 if no count meets the target.
+	///</summary>
+	UINT FindCheapestSampleCount(const NormalDepthMap& normalDepth, UINT width, UINT height,
+		SsaoKernel::Distribution dist, UINT minCount, UINT maxCount, UINT referenceCount,
+		int blurCount, float maxError, UINT seed)const;
+
+private:
+	Settings mSettings;
+
+	XMFLOAT4 mOffsets[MaxSampleCount];
+	UINT mSampleCount;
+
+	std::vector<XMFLOAT3> mRandomVectors;
+	UINT mRandomVectorSize;
+};
+
+#endif // SSAOREFERENCE_H
@@ -0,0 +1,424 @@
+//***************************************************************************************
+// SubDPatchBuilder.cpp
+//***************************************************************************************
+
+#include "SubDPatchBuilder.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Faces classified by one task.
+	const UINT ChunkSize = 1024;
+
+	// Below this many faces (or vertices) the build stays on the calling thread.
+	const UINT ParallelFaceCount = 4*ChunkSize;
+
+	// Per chunk entries of mChunkCounts.
+	enum ChunkCount { RegularCount, ExtraordinaryCount, TriangleCount, UsedPoints, UsedValence, ChunkCountSize };
+
+	const UINT NoVertex = 0xffffffff;
+
+	inline const float* Read(const float* p, UINT stride, UINT i)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(p) + (size_t)stride*i);
+	}
+
+	// The bits of a coordinate, with -0 taken as 0 so both weld.
+	inline UINT FloatBits(float f)
+	{
+		f += 0.0f;
+		UINT bits;
+		memcpy(&bits, &f, sizeof(bits));
+		return bits;
+	}
+
+	inline UINT HashPosition(const UINT p[3])
+	{
+		UINT h = p[0]*0x8da6b343u ^ p[1]*0xd8163841u ^ p[2]*0xcb1ab31fu;
+		return h ^ (h >> 15);
+	}
+}
+
+SubDPatchBuilder::SubDPatchBuilder()
+: mThreadCount(0), mMaxPoints(32), mMaxValence(15), mIndices(0), mUsedPoints(0), mUsedValence(0)
+{
+}
+
+SubDPatchBuilder::~SubDPatchBuilder()
+{
+}
+
+void SubDPatchBuilder::SetThreadCount(UINT threadCount)
+{
+	mThreadCount = threadCount;
+}
+
+void SubDPatchBuilder::SetLimits(UINT maxPoints, UINT maxValence)
+{
+	mMaxPoints  = std::min(std::max(maxPoints, 16u), 255u);
+	mMaxValence = std::min(std::max(maxValence, 4u), 255u);
+}
+
+const SubDPatchBuilder::PatchList& SubDPatchBuilder::GetRegularPatches()const
+{
+	return mRegular;
+}
+
+const SubDPatchBuilder::PatchList& SubDPatchBuilder::GetExtraordinaryPatches()const
+{
+	return mExtraordinary;
+}
+
+const SubDPatchBuilder::TriangleList& SubDPatchBuilder::GetTriangles()const
+{
+	return mTriangles;
+}
+
+UINT SubDPatchBuilder::GetMaxPoints()const
+{
+	return mMaxPoints;
+}
+
+UINT SubDPatchBuilder::GetUsedPoints()const
+{
+	return mUsedPoints;
+}
+
+UINT SubDPatchBuilder::GetUsedValence()const
+{
+	return mUsedValence;
+}
+
+UINT SubDPatchBuilder::GetThreadCount(UINT workCount)const
+{
+	return workCount >= ParallelFaceCount ? mThreadCount : 1;
+}
+
+void SubDPatchBuilder::ComputePrefixes(const BYTE valence[4], BYTE prefix[4])
+{
+	UINT end = 4;
+	for(UINT i = 0; i < 4; ++i)
+	{
+		end += 2*valence[i] - 5;
+		prefix[i] = (BYTE)end;
+	}
+}
+
+void SubDPatchBuilder::Build(const Polygons& polygons)
+{
+	mIndices = polygons.Indices;
+
+	WeldVertices(polygons);
+	BuildHalfEdges(polygons);
+	ClassifyVertices();
+
+	const UINT faceCount = polygons.FaceCount;
+	const UINT chunks = (faceCount + ChunkSize - 1)/ChunkSize;
+	mChunkCounts.assign(ChunkCountSize*chunks, 0);
+
+	// Count what each chunk makes, then give each chunk its place in the lists.
+	Parallel::For(chunks, GetThreadCount(faceCount), [&](UINT chunk)
+	{
+		UINT* counts = &mChunkCounts[ChunkCountSize*chunk];
+		PatchData data;
+
+		UINT end = std::min((chunk + 1)*ChunkSize, faceCount);
+		for(UINT f = chunk*ChunkSize; f < end; ++f)
+		{
+			switch( ClassifyFace(f, 0, &data) )
+			{
+			case FaceRegular:
+				counts[RegularCount]++;
+				break;
+			case FaceExtraordinary:
+				counts[ExtraordinaryCount]++;
+				break;
+			case FacePolygon:
+				counts[TriangleCount] += mFaceStart[f + 1] - mFaceStart[f] - 2;
+				continue;
+			default:
+				continue;
+			}
+
+			counts[UsedPoints] = std::max<UINT>(counts[UsedPoints], data.Prefix[3]);
+			for(UINT i = 0; i < 4; ++i)
+				counts[UsedValence] = std::max<UINT>(counts[UsedValence], data.Valence[i]);
+		}
+	});
+
+	UINT regular = 0;
+	UINT extraordinary = 0;
+	UINT triangles = 0;
+	mUsedPoints  = 0;
+	mUsedValence = 0;
+	for(UINT chunk = 0; chunk < chunks; ++chunk)
+	{
+		UINT* counts = &mChunkCounts[ChunkCountSize*chunk];
+		UINT chunkRegular       = counts[RegularCount];
+		UINT chunkExtraordinary = counts[ExtraordinaryCount];
+		UINT chunkTriangles     = counts[TriangleCount];
+		counts[RegularCount]       = regular;
+		counts[ExtraordinaryCount] = extraordinary;
+		counts[TriangleCount]      = triangles;
+		regular       += chunkRegular;
+		extraordinary += chunkExtraordinary;
+		triangles     += chunkTriangles;
+		mUsedPoints  = std::max(mUsedPoints, counts[UsedPoints]);
+		mUsedValence = std::max(mUsedValence, counts[UsedValence]);
+	}
+
+	mRegular.Indices.resize((size_t)mMaxPoints*regular);
+	mRegular.Data.resize(regular);
+	mRegular.Faces.resize(regular);
+	mExtraordinary.Indices.resize((size_t)mMaxPoints*extraordinary);
+	mExtraordinary.Data.resize(extraordinary);
+	mExtraordinary.Faces.resize(extraordinary);
+	mTriangles.Indices.resize(3*(size_t)triangles);
+	mTriangles.Faces.resize(triangles);
+
+	Parallel::For(chunks, GetThreadCount(faceCount), [&](UINT chunk)
+	{
+		const UINT* counts = &mChunkCounts[ChunkCountSize*chunk];
+		UINT regularPatch       = counts[RegularCount];
+		UINT extraordinaryPatch = counts[ExtraordinaryCount];
+		UINT triangle           = counts[TriangleCount];
+
+		UINT end = std::min((chunk + 1)*ChunkSize, faceCount);
+		for(UINT f = chunk*ChunkSize; f < end; ++f)
+		{
+			UINT size = mFaceStart[f + 1] - mFaceStart[f];
+			UINT points[255];
+			PatchData data;
+			FaceKind kind = ClassifyFace(f, points, &data);
+			if( kind == FaceRegular || kind == FaceExtraordinary )
+			{
+				PatchList& list = kind == FaceRegular ? mRegular : mExtraordinary;
+				UINT& patch = kind == FaceRegular ? regularPatch : extraordinaryPatch;
+				std::copy(points, points + mMaxPoints, list.Indices.begin() + (size_t)mMaxPoints*patch);
+				list.Data[patch]    = data;
+				list.Faces[patch++] = f;
+			}
+			else if( kind == FacePolygon )
+			{
+				const UINT* corners = mIndices + mFaceStart[f];
+				for(UINT i = 1; i + 1 < size; ++i)
+				{
+					UINT* out = &mTriangles.Indices[3*(size_t)triangle];
+					out[0] = corners[0];
+					out[1] = corners[i];
+					out[2] = corners[i + 1];
+					mTriangles.Faces[triangle++] = f;
+				}
+			}
+		}
+	});
+}
+
+void SubDPatchBuilder::WeldVertices(const Polygons& polygons)
+{
+	const UINT vertexCount = polygons.VertexCount;
+	mWelded.resize(vertexCount);
+
+	// Open addressing over the position bits, filled in vertex order so the first
+	// vertex at a position is the one the others map to.
+	UINT tableSize = 1;
+	while( tableSize < 2*vertexCount )
+		tableSize *= 2;
+	std::vector<UINT> table(tableSize, NoVertex);
+	std::vector<UINT> bits(3*(size_t)vertexCount);
+
+	for(UINT i = 0; i < vertexCount; ++i)
+	{
+		const float* p = Read(polygons.Positions, polygons.Stride, i);
+		UINT* key = &bits[3*(size_t)i];
+		key[0] = FloatBits(p[0]);
+		key[1] = FloatBits(p[1]);
+		key[2] = FloatBits(p[2]);
+
+		UINT slot = HashPosition(key) & (tableSize - 1);
+		for(;;)
+		{
+			UINT other = table[slot];
+			if( other == NoVertex )
+			{
+				table[slot] = i;
+				mWelded[i] = i;
+				break;
+			}
+
+			const UINT* otherKey = &bits[3*(size_t)other];
+			if( otherKey[0] == key[0] && otherKey[1] == key[1] && otherKey[2] == key[2] )
+			{
+				mWelded[i] = other;
+				break;
+			}
+
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+}
+
+void SubDPatchBuilder::BuildHalfEdges(const Polygons& polygons)
+{
+	const UINT faceCount = polygons.FaceCount;
+	const UINT vertexCount = polygons.VertexCount;
+
+	mFaceStart.resize(faceCount + 1);
+	mFaceStart[0] = 0;
+	for(UINT f = 0; f < faceCount; ++f)
+		mFaceStart[f + 1] = mFaceStart[f] + (polygons.FaceSizes ? polygons.FaceSizes[f] : 4);
+
+	const UINT halfEdgeCount = mFaceStart[faceCount];
+	mHalfEdgeFace.resize(halfEdgeCount);
+	for(UINT f = 0; f < faceCount; ++f)
+		std::fill(mHalfEdgeFace.begin() + mFaceStart[f], mHalfEdgeFace.begin() + mFaceStart[f + 1], f);
+
+	// Bucket the half-edges by the welded vertex they leave, in half-edge order.
+	mOutgoingStart.assign(vertexCount + 1, 0);
+	for(UINT h = 0; h < halfEdgeCount; ++h)
+		mOutgoingStart[mWelded[mIndices[h]] + 1]++;
+	for(UINT v = 0; v < vertexCount; ++v)
+		mOutgoingStart[v + 1] += mOutgoingStart[v];
+
+	mOutgoing.resize(halfEdgeCount);
+	std::vector<UINT> fill(mOutgoingStart.begin(), mOutgoingStart.end() - 1);
+	for(UINT h = 0; h < halfEdgeCount; ++h)
+		mOutgoing[fill[mWelded[mIndices[h]]]++] = h;
+}
+
+UINT SubDPatchBuilder::GetCorner(UINT halfEdge, UINT step)const
+{
+	UINT f = mHalfEdgeFace[halfEdge];
+	UINT first = mFaceStart[f];
+	UINT size = mFaceStart[f + 1] - first;
+	return mIndices[first + (halfEdge - first + step) % size];
+}
+
+int SubDPatchBuilder::FindHalfEdge(UINT u, UINT v)const
+{
+	int found = -1;
+	for(UINT i = mOutgoingStart[u]; i < mOutgoingStart[u + 1]; ++i)
+	{
+		UINT h = mOutgoing[i];
+		if( mWelded[GetCorner(h, 1)] == v )
+		{
+			if( found >= 0 )
+				return -1;
+			found = (int)h;
+		}
+	}
+	return found;
+}
+
+void SubDPatchBuilder::ClassifyVertices()
+{
+	const UINT vertexCount = (UINT)mWelded.size();
+	mValence.assign(vertexCount, 0);
+
+	const UINT chunks = (vertexCount + ChunkSize - 1)/ChunkSize;
+	Parallel::For(chunks, GetThreadCount(vertexCount), [&](UINT chunk)
+	{
+		UINT end = std::min((chunk + 1)*ChunkSize, vertexCount);
+		for(UINT v = chunk*ChunkSize; v < end; ++v)
+		{
+			UINT first = mOutgoingStart[v];
+			UINT valence = mOutgoingStart[v + 1] - first;
+			if( valence < 3 || valence > mMaxValence )
+				continue;
+
+			// Every face around the vertex is a quad, and every edge leaving it is
+			// shared with exactly one face going the other way.
+			bool interior = true;
+			for(UINT i = first; i < first + valence && interior; ++i)
+			{
+				UINT h = mOutgoing[i];
+				UINT f = mHalfEdgeFace[h];
+				UINT w = mWelded[GetCorner(h, 1)];
+				interior = mFaceStart[f + 1] - mFaceStart[f] == 4 &&
+					w != v && FindHalfEdge(v, w) == (int)h && FindHalfEdge(w, v) >= 0;
+			}
+			if( !interior )
+				continue;
+
+			// The faces make a single fan: walking from face to face across the edge
+			// before the vertex comes back to the start after valence steps.
+			UINT start = mOutgoing[first];
+			int h = (int)start;
+			UINT steps = 0;
+			do
+			{
+				h = FindHalfEdge(v, mWelded[GetCorner((UINT)h, 3)]);
+				++steps;
+			}
+			while( h >= 0 && (UINT)h != start && steps <= valence );
+
+			if( h == (int)start && steps == valence )
+				mValence[v] = (BYTE)valence;
+		}
+	});
+}
+
+SubDPatchBuilder::FaceKind SubDPatchBuilder::ClassifyFace(UINT f, UINT* points, PatchData* data)const
+{
+	const UINT first = mFaceStart[f];
+	const UINT size = mFaceStart[f + 1] - first;
+	if( size < 3 )
+		return FaceDropped;
+	if( size != 4 )
+		return FacePolygon;
+
+	const UINT* corners = mIndices + first;
+	UINT welded[4];
+	UINT pointCount = 4;
+	bool regular = true;
+	for(UINT i = 0; i < 4; ++i)
+	{
+		welded[i] = mWelded[corners[i]];
+		UINT valence = mValence[welded[i]];
+		if( valence == 0 )
+			return FacePolygon;
+
+		data->Valence[i] = (BYTE)valence;
+		pointCount += 2*valence - 5;
+		regular = regular && valence == 4;
+	}
+	if( pointCount > mMaxPoints ||
+		welded[0] == welded[1] || welded[0] == welded[2] || welded[0] == welded[3] ||
+		welded[1] == welded[2] || welded[1] == welded[3] || welded[2] == welded[3] )
+		return FacePolygon;
+
+	ComputePrefixes(data->Valence, data->Prefix);
+
+	if( points )
+	{
+		// The quad itself, then for each corner the faces around it from the one across
+		// the edge from the previous corner: the first face gives its edge neighbour,
+		// the ones in between their opposite corner and edge neighbour.  The opposite
+		// corner of the last face is the next corner's first edge neighbour.
+		UINT n = 0;
+		for(UINT i = 0; i < 4; ++i)
+			points[n++] = corners[i];
+
+		for(UINT i = 0; i < 4; ++i)
+		{
+			UINT v = welded[i];
+			int h = FindHalfEdge(v, welded[(i + 3) & 3]);
+			UINT faces = data->Valence[i] - 2;
+			for(UINT j = 0; j < faces; ++j)
+			{
+				UINT edge = mWelded[GetCorner((UINT)h, 3)];
+				if( j > 0 )
+					points[n++] = mWelded[GetCorner((UINT)h, 2)];
+				points[n++] = edge;
+				h = FindHalfEdge(v, edge);
+			}
+		}
+
+		for(; n < mMaxPoints; ++n)
+			points[n] = 0;
+	}
+
+	return regular ? FaceRegular : FaceExtraordinary;
+}
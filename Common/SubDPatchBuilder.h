@@ -0,0 +1,161 @@
+//***************************************************************************************
+// SubDPatchBuilder.h
+//
+// Builds the Catmull-Clark patches the SubD11 hull shaders take from a plain polygon
+// mesh, in place of the offline exporter CSubDMesh used to need.  A patch is a quad of
+// the mesh plus the 1-ring of vertices around it, laid out as described at the top of
+// SubD11.hlsl: the quad's four corners, then the ring walked counter-clockwise starting
+// at the edge neighbour of corner 0, padded with zeros to a fixed point count.  Each
+// patch also gets the valence and prefix of its corners, which tell the shader where
+// each corner's part of the ring ends.
+//
+// Patches whose corners all have valence 4 are regular and go to their own list, so
+// they can be drawn with the cheaper hull shader.  Faces that cannot be patched, because
+// they are not quads, touch a boundary, a non-quad face or a non-manifold edge, or need
+// more points or a higher valence than the shader takes, are handed back as triangles.
+//
+// Vertices at the same position are treated as one, so seams in the texture
+// coordinates do not split the surface; the ring refers to the first vertex at each
+// position, and the corners keep the quad's own vertices.  The vertex and face passes
+// run over threads; the lists keep the input face order whatever the thread count.
+// Nothing here needs Direct3D.
+//***************************************************************************************
+
+#ifndef SUBDPATCHBUILDER_H
+#define SUBDPATCHBUILDER_H
+
+#include "XnaMathPortable.h"
+#include <vector>
+
+class SubDPatchBuilder
+{
+public:
+	// A polygon mesh.  The position of vertex i is Stride*i bytes past Positions.
+	// Face f has FaceSizes[f] corners, listed counter-clockwise in Indices after those
+	// of the faces before it; FaceSizes may be null when every face is a quad.
+	struct Polygons
+	{
+		const float* Positions;
+		UINT Stride;
+		UINT VertexCount;
+		const UINT* Indices;
+		const UINT* FaceSizes;
+		UINT FaceCount;
+	};
+
+	// Corner valences and ring prefixes of a patch, as LoadValenceAndPrefixData reads
+	// them: two R8G8B8A8_UINT elements.
+	struct PatchData
+	{
+		BYTE Valence[4];
+		BYTE Prefix[4];
+	};
+
+	struct PatchList
+	{
+		// GetMaxPoints() indices per patch.
+		std::vector<UINT> Indices;
+		std::vector<PatchData> Data;
+
+		// The face each patch was built from.
+		std::vector<UINT> Faces;
+
+		UINT Count()const { return (UINT)Faces.size(); }
+	};
+
+	// Faces left as polygons, fanned into triangles.
+	struct TriangleList
+	{
+		std::vector<UINT> Indices;
+
+		// The face each triangle came from.
+		std::vector<UINT> Faces;
+	};
+
+	SubDPatchBuilder();
+	~SubDPatchBuilder();
+
+	///<summary>
+	/// threadCount 0 uses every hardware thread for large meshes; 1 keeps the build
+	/// on the calling thread.
+	///</summary>
+	void SetThreadCount(UINT threadCount);
+
+	///<summary>
+	/// The shader limits: points per patch (MAX_POINTS, at most 255) and the highest
+	/// valence its tables hold (MAX_VALENCE - 1, as TanM is indexed by valence).
+	/// Faces beyond them are left as polygons.  The defaults are 32 and 15.
+	///</summary>
+	void SetLimits(UINT maxPoints, UINT maxValence);
+
+	void Build(const Polygons& polygons);
+
+	const PatchList& GetRegularPatches()const;
+	const PatchList& GetExtraordinaryPatches()const;
+	const TriangleList& GetTriangles()const;
+
+	UINT GetMaxPoints()const;
+
+	// The most points and the highest corner valence among the patches built.
+	UINT GetUsedPoints()const;
+	UINT GetUsedValence()const;
+
+	///<summary>
+	/// Prefix i is where the ring part of corner i ends: 4 plus 2*valence - 5 for
+	/// every corner up to i.
+	///</summary>
+	static void ComputePrefixes(const BYTE valence[4], BYTE prefix[4]);
+
+private:
+	SubDPatchBuilder(const SubDPatchBuilder& rhs);
+	SubDPatchBuilder& operator=(const SubDPatchBuilder& rhs);
+
+	void WeldVertices(const Polygons& polygons);
+	void BuildHalfEdges(const Polygons& polygons);
+	void ClassifyVertices();
+
+	// The half-edge leaving vertex u for vertex v, or -1 if there is none or more than one.
+	int FindHalfEdge(UINT u, UINT v)const;
+
+	UINT GetCorner(UINT halfEdge, UINT step)const;
+
+	// How face f is drawn; for patches, fills the ring, valences and prefixes.
+	enum FaceKind { FaceRegular, FaceExtraordinary, FacePolygon, FaceDropped };
+	FaceKind ClassifyFace(UINT f, UINT* points, PatchData* data)const;
+
+	UINT GetThreadCount(UINT workCount)const;
+
+private:
+	UINT mThreadCount;
+	UINT mMaxPoints;
+	UINT mMaxValence;
+
+	const UINT* mIndices;
+
+	// The first vertex at the position of each vertex.
+	std::vector<UINT> mWelded;
+
+	// Face f owns half-edges mFaceStart[f] to mFaceStart[f+1]-1; half-edge h leaves
+	// corner h - mFaceStart[f] for the next corner.
+	std::vector<UINT> mFaceStart;
+	std::vector<UINT> mHalfEdgeFace;
+
+	// The half-edges leaving each welded vertex, mOutgoing[mOutgoingStart[v]] onwards.
+	std::vector<UINT> mOutgoingStart;
+	std::vector<UINT> mOutgoing;
+
+	// Valence of each welded vertex that can be a patch corner, otherwise 0.
+	std::vector<BYTE> mValence;
+
+	// Per chunk of faces: regular patches, extraordinary patches and triangles, then
+	// where the chunk's output starts in each list.
+	std::vector<UINT> mChunkCounts;
+
+	PatchList mRegular;
+	PatchList mExtraordinary;
+	TriangleList mTriangles;
+	UINT mUsedPoints;
+	UINT mUsedValence;
+};
+
+#endif // SUBDPATCHBUILDER_H
@@ -1,11 +1,108 @@
 #include "TextureMgr.h"
+#include "Profiler.h"
 
-TextureMgr::TextureMgr() : md3dDevice(0)
+//
+// Recreates a texture around the mips the streamer says are resident, keeping
+// the mips the old texture already had on the GPU.
+//
+class TextureMgr::StreamSink : public TextureStreamer::UploadSink
+{
+public:
+	StreamSink(ID3D11Device* device, ID3D11DeviceContext* dc, std::vector<StreamedTexture>& textures)
+		: mDevice(device), mContext(dc), mTextures(textures)
+	{
+	}
+
+	virtual void SetResidentMips(TextureStreamer::Handle handle, const DDSInfo& info, UINT oldFirstMip, UINT newFirstMip,
+		const TextureStreamer::MipData* data, UINT dataCount)
+	{
+		StreamedTexture& streamed = mTextures[handle];
+		const DDSSubresource& top = info.Get(newFirstMip, 0);
+
+		D3D11_TEXTURE2D_DESC texDesc;
+		texDesc.Width              = top.Width;
+		texDesc.Height             = top.Height;
+		texDesc.MipLevels          = info.MipLevels - newFirstMip;
+		texDesc.ArraySize          = info.ArraySize;
+		texDesc.Format             = (DXGI_FORMAT)info.Format;
+		texDesc.SampleDesc.Count   = 1;
+		texDesc.SampleDesc.Quality = 0;
+		texDesc.Usage              = D3D11_USAGE_DEFAULT;
+		texDesc.BindFlags          = D3D11_BIND_SHADER_RESOURCE;
+		texDesc.CPUAccessFlags     = 0;
+		texDesc.MiscFlags          = info.IsCubeMap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		HR(mDevice->CreateTexture2D(&texDesc, 0, texture.GetAddressOf()));
+
+		// Mips both textures have are copied on the GPU.
+		if( streamed.Texture )
+		{
+			UINT oldLevels = info.MipLevels - oldFirstMip;
+			for(UINT slice = 0; slice < info.ArraySize; ++slice)
+			{
+				for(UINT mip = std::max(oldFirstMip, newFirstMip); mip < info.MipLevels; ++mip)
+				{
+					mContext->CopySubresourceRegion(
+						texture.Get(), D3D11CalcSubresource(mip - newFirstMip, slice, texDesc.MipLevels), 0, 0, 0,
+						streamed.Texture.Get(), D3D11CalcSubresource(mip - oldFirstMip, slice, oldLevels), 0);
+				}
+			}
+		}
+
+		for(UINT i = 0; i < dataCount; ++i)
+		{
+			mContext->UpdateSubresource(
+				texture.Get(), D3D11CalcSubresource(data[i].Mip - newFirstMip, data[i].Slice, texDesc.MipLevels),
+				0, data[i].Data, data[i].RowPitch, data[i].SlicePitch);
+		}
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+		viewDesc.Format = texDesc.Format;
+		if( info.IsCubeMap && info.ArraySize == 6 )
+		{
+			viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+			viewDesc.TextureCube.MostDetailedMip = 0;
+			viewDesc.TextureCube.MipLevels = texDesc.MipLevels;
+		}
+		else if( info.ArraySize > 1 )
+		{
+			viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+			viewDesc.Texture2DArray.MostDetailedMip = 0;
+			viewDesc.Texture2DArray.MipLevels = texDesc.MipLevels;
+			viewDesc.Texture2DArray.FirstArraySlice = 0;
+			viewDesc.Texture2DArray.ArraySize = info.ArraySize;
+		}
+		else
+		{
+			viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+			viewDesc.Texture2D.MostDetailedMip = 0;
+			viewDesc.Texture2D.MipLevels = texDesc.MipLevels;
+		}
+
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+		HR(mDevice->CreateShaderResourceView(texture.Get(), &viewDesc, srv.GetAddressOf()));
+
+		streamed.Texture  = texture;
+		streamed.SRV      = srv;
+		streamed.FirstMip = newFirstMip;
+	}
+
+private:
+	ID3D11Device* mDevice;
+	ID3D11DeviceContext* mContext;
+	std::vector<StreamedTexture>& mTextures;
+};
+
+TextureMgr::TextureMgr() : md3dDevice(0), mStreamingBudget(256ull << 20)
 {
 }
 
 TextureMgr::~TextureMgr()
 {
+	// Stop the workers before the views go.
+	mStreamer.reset();
+
 	for(auto it = mTextureSRV.begin(); it != mTextureSRV.end(); ++it)
     {
 		ReleaseCOM(it->second);
@@ -21,6 +118,8 @@ void TextureMgr::Init(ID3D11Device* device)
 
 ID3D11ShaderResourceView* TextureMgr::CreateTexture(std::wstring filename)
 {
+	PROFILE_FUNCTION();
+
 	ID3D11ShaderResourceView* srv = 0;
 
 	// Does it already exist?
@@ -37,4 +136,51 @@ ID3D11ShaderResourceView* TextureMgr::CreateTexture(std::wstring filename)
 
 	return srv;
 }
- 
+
+TextureStreamer::Handle TextureMgr::RequestTexture(const std::wstring& filename)
+{
+	if( !mStreamer )
+		mStreamer.reset(new TextureStreamer(0, mStreamingBudget));
+
+	char path[MAX_PATH];
+	WideCharToMultiByte(CP_ACP, 0, filename.c_str(), -1, path, MAX_PATH, 0, 0);
+
+	TextureStreamer::Handle handle = mStreamer->Request(path);
+	if( handle >= mStreamed.size() )
+		mStreamed.resize(handle + 1);
+	mStreamed[handle].Filename = filename;
+
+	return handle;
+}
+
+ID3D11ShaderResourceView* TextureMgr::GetTexture(TextureStreamer::Handle handle)
+{
+	StreamedTexture& streamed = mStreamed[handle];
+
+	if( !streamed.SRV && mStreamer->IsFailed(handle) )
+	{
+		// Not something the streamer reads as is; D3DX can still load it.
+		streamed.SRV = CreateTexture(streamed.Filename);
+	}
+
+	mStreamer->Touch(handle);
+	return streamed.SRV.Get();
+}
+
+void TextureMgr::Update(ID3D11DeviceContext* dc, UINT64 maxUploadBytes)
+{
+	PROFILE_FUNCTION();
+
+	if( !mStreamer )
+		return;
+
+	StreamSink sink(md3dDevice, dc, mStreamed);
+	mStreamer->Update(sink, maxUploadBytes);
+}
+
+void TextureMgr::SetStreamingBudget(UINT64 budgetBytes)
+{
+	mStreamingBudget = budgetBytes;
+	if( mStreamer )
+		mStreamer->SetBudget(budgetBytes);
+}
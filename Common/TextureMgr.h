@@ -2,11 +2,16 @@
 #define TEXTUREMGR_H
 
 #include "d3dUtil.h"
+#include "TextureStreamer.h"
 #include <map>
 
 ///<summary>
 /// Simple texture manager to avoid loading duplicate textures from file.  That can
 /// happen, for example, if multiple meshes reference the same texture filename. 
+///
+/// Textures can also be streamed: RequestTexture returns at once and the texture's
+/// mips arrive over the following frames, smallest first, as Update uploads what
+/// the TextureStreamer workers have read.
 ///</summary>
 class TextureMgr
 {
@@ -18,13 +23,50 @@ public:
 
 	ID3D11ShaderResourceView* CreateTexture(std::wstring filename);
 
+	///<summary>
+	/// Starts streaming filename in the background.  Files the streamer cannot
+	/// take are loaded with CreateTexture instead, on the next GetTexture.
+	///</summary>
+	TextureStreamer::Handle RequestTexture(const std::wstring& filename);
+
+	///<summary>
+	/// The view of the mips streamed so far, or null until the first one is in.
+	/// Marks the texture as used this frame.  Do not hold on to the view: it is
+	/// replaced as mips come and go.
+	///</summary>
+	ID3D11ShaderResourceView* GetTexture(TextureStreamer::Handle handle);
+
+	///<summary>
+	/// Uploads the mips read since the last call, up to maxUploadBytes, and trims
+	/// unused textures to the streaming budget.  Call once a frame.
+	///</summary>
+	void Update(ID3D11DeviceContext* dc, UINT64 maxUploadBytes = 8ull << 20);
+
+	void SetStreamingBudget(UINT64 budgetBytes);
+
 private:
 	TextureMgr(const TextureMgr& rhs);
 	TextureMgr& operator=(const TextureMgr& rhs);
+
+	class StreamSink;
+
+	struct StreamedTexture
+	{
+		StreamedTexture() : FirstMip(0) {}
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+		UINT FirstMip;
+		std::wstring Filename;
+	};
 	
 private:
 	ID3D11Device* md3dDevice;
 	std::map<std::wstring, ID3D11ShaderResourceView*> mTextureSRV;
+
+	std::unique_ptr<TextureStreamer> mStreamer;
+	std::vector<StreamedTexture> mStreamed;
+	UINT64 mStreamingBudget;
 };
 
 #endif // TEXTUREMGR_H
\ No newline at end of file
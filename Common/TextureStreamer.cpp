@@ -0,0 +1,663 @@
+//***************************************************************************************
+// TextureStreamer.cpp
+//***************************************************************************************
+
+#include "TextureStreamer.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace
+{
+	const size_t MinBlockSize = 4096;
+
+	// Largest mip size the eviction leaves alone.
+	const UINT TailSize = 64;
+
+	size_t SizeClass(size_t size)
+	{
+		size_t capacity = MinBlockSize;
+		while( capacity < size )
+			capacity *= 2;
+		return capacity;
+	}
+
+	// Extends a single mip file's info to the full chain.  The extra mips are built
+	// from mip 0 rather than read, so they get no file offset.
+	void ExpandMipChain(DDSInfo& info)
+	{
+		UINT mipLevels = 1;
+		for(UINT w = info.Width, h = info.Height; w > 1 || h > 1; w = w > 1 ? w/2 : 1, h = h > 1 ? h/2 : 1)
+			++mipLevels;
+
+		std::vector<DDSSubresource> subresources(mipLevels * info.ArraySize);
+		for(UINT slice = 0; slice < info.ArraySize; ++slice)
+		{
+			UINT w = info.Width;
+			UINT h = info.Height;
+			for(UINT mip = 0; mip < mipLevels; ++mip)
+			{
+				DDSSubresource& sub = subresources[mip + slice*mipLevels];
+				DDS::GetSurfaceInfo(info.Format, w, h, sub.RowPitch, sub.SlicePitch);
+				sub.Offset = mip == 0 ? info.Get(0, slice).Offset : 0;
+				sub.Width  = w;
+				sub.Height = h;
+
+				w = w > 1 ? w/2 : 1;
+				h = h > 1 ? h/2 : 1;
+			}
+		}
+
+		info.MipLevels = mipLevels;
+		info.Subresources.swap(subresources);
+	}
+}
+
+//
+// BlockPool
+//
+
+TextureStreamer::Block TextureStreamer::BlockPool::Acquire(size_t size)
+{
+	size_t capacity = SizeClass(size);
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto it = mFree.find(capacity);
+		if( it != mFree.end() && !it->second.empty() )
+		{
+			Block block = std::move(it->second.back());
+			it->second.pop_back();
+			mFreeBytes -= capacity;
+			++mReuses;
+			return block;
+		}
+	}
+
+	Block block;
+	block.Data.reset(new char[capacity]);
+	block.Capacity = capacity;
+	return block;
+}
+
+void TextureStreamer::BlockPool::Release(Block block)
+{
+	if( !block.Data )
+		return;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if( mFreeBytes + block.Capacity > MaxFreeBytes )
+		return;
+
+	mFreeBytes += block.Capacity;
+	mFree[block.Capacity].push_back(std::move(block));
+}
+
+UINT64 TextureStreamer::BlockPool::FreeBytes()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mFreeBytes;
+}
+
+UINT TextureStreamer::BlockPool::Reuses()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mReuses;
+}
+
+//
+// TextureStreamer
+//
+
+TextureStreamer::TextureStreamer(UINT threadCount, UINT64 budgetBytes)
+: mFrame(0),
+  mBudgetBytes(budgetBytes),
+  mResidentBytes(0),
+  mBytesUploaded(0),
+  mMipsUploaded(0),
+  mEvictions(0),
+  mFailures(0),
+  mBusyWorkers(0),
+  mStopping(false),
+  mBytesRead(0)
+{
+	if( threadCount == 0 )
+		threadCount = 2;
+
+	for(UINT i = 0; i < threadCount; ++i)
+		mWorkers.push_back(std::thread(&TextureStreamer::WorkerMain, this));
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mJobMutex);
+		mStopping = true;
+		mJobs.clear();
+	}
+	mJobCv.notify_all();
+
+	for(size_t i = 0; i < mWorkers.size(); ++i)
+		mWorkers[i].join();
+}
+
+TextureStreamer::Handle TextureStreamer::Request(const std::string& filename)
+{
+	auto it = mHandles.find(filename);
+	if( it != mHandles.end() )
+		return it->second;
+
+	Handle handle = (Handle)mTextures.size();
+	mHandles[filename] = handle;
+
+	Texture tex;
+	tex.Filename      = filename;
+	tex.HasInfo       = false;
+	tex.GenerateMips  = false;
+	tex.Failed        = false;
+	tex.JobInFlight   = false;
+	tex.ResidentMip   = 0;
+	tex.WantedMip     = 0;
+	tex.LastUsedFrame = mFrame;
+	mTextures.push_back(std::move(tex));
+
+	QueueJob(handle, 0);
+	return handle;
+}
+
+void TextureStreamer::QueueJob(Handle handle, UINT firstMip)
+{
+	Texture& tex = mTextures[handle];
+
+	Job job;
+	job.Texture      = handle;
+	job.Filename     = tex.Filename;
+	job.HasInfo      = tex.HasInfo;
+	job.GenerateMips = tex.GenerateMips;
+	job.Info         = tex.Info;
+	job.FirstMip     = firstMip;
+	job.EndMip       = tex.HasInfo ? tex.ResidentMip : 0;
+
+	tex.JobInFlight = true;
+
+	{
+		std::lock_guard<std::mutex> lock(mJobMutex);
+		mJobs.push_back(std::move(job));
+	}
+	mJobCv.notify_one();
+}
+
+void TextureStreamer::Touch(Handle handle)
+{
+	Texture& tex = mTextures[handle];
+	tex.LastUsedFrame = mFrame;
+
+	// Bring back mips the eviction dropped.
+	if( tex.HasInfo && !tex.Failed && !tex.JobInFlight && tex.WantedMip > 0 )
+	{
+		tex.WantedMip = 0;
+		QueueJob(handle, 0);
+	}
+}
+
+void TextureStreamer::WorkerMain()
+{
+	for(;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mJobMutex);
+			mJobCv.wait(lock, [this]() { return mStopping || !mJobs.empty(); });
+			if( mStopping )
+				return;
+
+			job = std::move(mJobs.front());
+			mJobs.pop_front();
+			++mBusyWorkers;
+		}
+
+		RunJob(job);
+
+		{
+			std::lock_guard<std::mutex> lock(mJobMutex);
+			--mBusyWorkers;
+			if( mJobs.empty() && mBusyWorkers == 0 )
+				mIdleCv.notify_all();
+		}
+	}
+}
+
+void TextureStreamer::Post(Message& message)
+{
+	std::lock_guard<std::mutex> lock(mMessageMutex);
+	mMessages.push_back(std::move(message));
+}
+
+void TextureStreamer::RunJob(Job& job)
+{
+	PROFILE_FUNCTION();
+
+	Message done;
+	done.Type = Message::Done;
+	done.Texture = job.Texture;
+	done.MipLevel = 0;
+	done.GenerateMips = false;
+
+	std::ifstream fin(job.Filename.c_str(), std::ios::binary);
+
+	Message failed;
+	failed.Type = Message::Failed;
+	failed.Texture = job.Texture;
+	failed.MipLevel = 0;
+	failed.GenerateMips = false;
+
+	if( !fin )
+	{
+		failed.Error = "cannot open " + job.Filename;
+		Post(failed);
+		Post(done);
+		return;
+	}
+
+	if( !job.HasInfo )
+	{
+		fin.seekg(0, std::ios::end);
+		UINT64 fileSize = (UINT64)fin.tellg();
+		fin.seekg(0, std::ios::beg);
+
+		char header[DDS::MaxHeaderSize] = { 0 };
+		fin.read(header, sizeof(header));
+		UINT headerSize = (UINT)fin.gcount();
+		fin.clear();
+
+		DDSInfo info;
+		std::string error;
+		bool parsed = DDS::ParseHeader(header, headerSize, fileSize, info, &error);
+
+		bool singleMip = parsed && info.MipLevels == 1 && (info.Width > 1 || info.Height > 1);
+		if( singleMip && !DDS::CanGenerateMips(info.Format) )
+		{
+			parsed = false;
+			error = "no mips to stream";
+		}
+
+		if( !parsed )
+		{
+			failed.Error = job.Filename + ": " + error;
+			Post(failed);
+			Post(done);
+			return;
+		}
+
+		job.GenerateMips = singleMip;
+		if( job.GenerateMips )
+			ExpandMipChain(info);
+
+		job.HasInfo = true;
+		job.Info = info;
+		job.EndMip = info.MipLevels;
+
+		Message headerMessage;
+		headerMessage.Type = Message::Header;
+		headerMessage.Texture = job.Texture;
+		headerMessage.MipLevel = 0;
+		headerMessage.Info = info;
+		headerMessage.GenerateMips = job.GenerateMips;
+		Post(headerMessage);
+	}
+
+	if( !ReadMips(job, fin) )
+	{
+		failed.Error = job.Filename + ": read error";
+		Post(failed);
+	}
+
+	Post(done);
+}
+
+bool TextureStreamer::ReadMips(Job& job, std::ifstream& fin)
+{
+	const DDSInfo& info = job.Info;
+	UINT64 bytesRead = 0;
+
+	if( job.GenerateMips )
+	{
+		// Mip 0 is the only one in the file; the rest are built from it, so the
+		// whole chain is made before anything is posted.
+		std::vector<Block> mips(info.MipLevels);
+		mips[0] = mPool.Acquire((size_t)info.MipSize(0));
+		for(UINT slice = 0; slice < info.ArraySize; ++slice)
+		{
+			const DDSSubresource& sub = info.Get(0, slice);
+			fin.seekg((std::streamoff)sub.Offset, std::ios::beg);
+			fin.read(mips[0].Data.get() + (size_t)slice*sub.SlicePitch, sub.SlicePitch);
+			if( !fin )
+			{
+				mPool.Release(std::move(mips[0]));
+				return false;
+			}
+			bytesRead += sub.SlicePitch;
+		}
+
+		for(UINT mip = 1; mip < job.EndMip; ++mip)
+		{
+			mips[mip] = mPool.Acquire((size_t)info.MipSize(mip));
+			for(UINT slice = 0; slice < info.ArraySize; ++slice)
+			{
+				const DDSSubresource& src = info.Get(mip - 1, slice);
+				const DDSSubresource& dst = info.Get(mip, slice);
+				DDS::GenerateMip(mips[mip - 1].Data.get() + (size_t)slice*src.SlicePitch,
+					src.Width, src.Height, src.RowPitch,
+					mips[mip].Data.get() + (size_t)slice*dst.SlicePitch, dst.RowPitch);
+			}
+		}
+
+		for(UINT mip = job.EndMip; mip-- > 0; )
+		{
+			if( mip < job.FirstMip )
+			{
+				mPool.Release(std::move(mips[mip]));
+				continue;
+			}
+
+			Message message;
+			message.Type = Message::Mip;
+			message.Texture = job.Texture;
+			message.MipLevel = mip;
+			message.Data = std::move(mips[mip]);
+			message.GenerateMips = true;
+			Post(message);
+		}
+	}
+	else
+	{
+		// Smallest mip first, so the texture can be shown while the rest load.
+		for(UINT mip = job.EndMip; mip-- > job.FirstMip; )
+		{
+			Block block = mPool.Acquire((size_t)info.MipSize(mip));
+			for(UINT slice = 0; slice < info.ArraySize; ++slice)
+			{
+				const DDSSubresource& sub = info.Get(mip, slice);
+				fin.seekg((std::streamoff)sub.Offset, std::ios::beg);
+				fin.read(block.Data.get() + (size_t)slice*sub.SlicePitch, sub.SlicePitch);
+				if( !fin )
+				{
+					mPool.Release(std::move(block));
+					return false;
+				}
+				bytesRead += sub.SlicePitch;
+			}
+
+			Message message;
+			message.Type = Message::Mip;
+			message.Texture = job.Texture;
+			message.MipLevel = mip;
+			message.Data = std::move(block);
+			message.GenerateMips = false;
+			Post(message);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mMessageMutex);
+	mBytesRead += bytesRead;
+	return true;
+}
+
+void TextureStreamer::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(mJobMutex);
+	mIdleCv.wait(lock, [this]() { return mJobs.empty() && mBusyWorkers == 0; });
+}
+
+UINT TextureStreamer::TailMip(const DDSInfo& info)const
+{
+	UINT tail = info.MipLevels - 1;
+	for(UINT mip = 0; mip < info.MipLevels; ++mip)
+	{
+		const DDSSubresource& sub = info.Get(mip, 0);
+		if( std::max(sub.Width, sub.Height) <= TailSize )
+		{
+			tail = mip;
+			break;
+		}
+	}
+
+	// A block compressed texture cannot start at a mip that is not whole blocks.
+	if( DDS::IsBlockCompressed(info.Format) )
+	{
+		while( tail > 0 && (info.Get(tail, 0).Width % 4 != 0 || info.Get(tail, 0).Height % 4 != 0) )
+			--tail;
+	}
+
+	return tail;
+}
+
+void TextureStreamer::Update(UploadSink& sink, UINT64 maxUploadBytes)
+{
+	PROFILE_FUNCTION();
+
+	++mFrame;
+
+	std::vector<Message> messages;
+	{
+		std::lock_guard<std::mutex> lock(mMessageMutex);
+		messages.swap(mMessages);
+	}
+
+	for(size_t i = 0; i < messages.size(); ++i)
+	{
+		Message& message = messages[i];
+		Texture& tex = mTextures[message.Texture];
+
+		switch( message.Type )
+		{
+		case Message::Header:
+			tex.Info = message.Info;
+			tex.HasInfo = true;
+			tex.GenerateMips = message.GenerateMips;
+			tex.ResidentMip = tex.Info.MipLevels;
+			break;
+
+		case Message::Mip:
+			if( !tex.Failed && message.MipLevel >= tex.WantedMip && message.MipLevel < tex.ResidentMip &&
+				tex.Pending.count(message.MipLevel) == 0 )
+			{
+				tex.Pending[message.MipLevel] = std::move(message.Data);
+			}
+			else
+			{
+				mPool.Release(std::move(message.Data));
+			}
+			break;
+
+		case Message::Failed:
+			tex.Failed = true;
+			tex.Error = message.Error;
+			++mFailures;
+			for(auto it = tex.Pending.begin(); it != tex.Pending.end(); ++it)
+				mPool.Release(std::move(it->second));
+			tex.Pending.clear();
+			break;
+
+		case Message::Done:
+			tex.JobInFlight = false;
+			break;
+		}
+	}
+
+	Upload(sink, maxUploadBytes);
+	Evict(sink);
+}
+
+void TextureStreamer::Upload(UploadSink& sink, UINT64 maxUploadBytes)
+{
+	// Textures with the next mip waiting, most recently used first.
+	std::vector<Handle> ready;
+	for(Handle h = 0; h < (Handle)mTextures.size(); ++h)
+	{
+		const Texture& tex = mTextures[h];
+		if( tex.HasInfo && !tex.Failed && tex.ResidentMip > 0 && tex.Pending.count(tex.ResidentMip - 1) )
+			ready.push_back(h);
+	}
+
+	std::stable_sort(ready.begin(), ready.end(), [this](Handle a, Handle b)
+	{
+		return mTextures[a].LastUsedFrame > mTextures[b].LastUsedFrame;
+	});
+
+	UINT64 uploaded = 0;
+	std::vector<MipData> data;
+
+	for(size_t i = 0; i < ready.size(); ++i)
+	{
+		Texture& tex = mTextures[ready[i]];
+		const DDSInfo& info = tex.Info;
+
+		// The whole tail goes in one piece, whatever the upload limit.
+		UINT tailMip = TailMip(info);
+		UINT oldFirstMip = tex.ResidentMip;
+		UINT newFirstMip = oldFirstMip;
+		UINT64 size = 0;
+		while( newFirstMip > 0 && tex.Pending.count(newFirstMip - 1) )
+		{
+			UINT64 mipSize = info.MipSize(newFirstMip - 1);
+			bool inTail = newFirstMip > tailMip;
+			if( !inTail && maxUploadBytes > 0 && uploaded + size > 0 && uploaded + size + mipSize > maxUploadBytes )
+				break;
+			size += mipSize;
+			--newFirstMip;
+		}
+
+		if( newFirstMip == oldFirstMip || newFirstMip > tailMip )
+			continue;
+
+		uploaded += size;
+
+		data.clear();
+		for(UINT mip = newFirstMip; mip < oldFirstMip; ++mip)
+		{
+			const char* block = tex.Pending[mip].Data.get();
+			for(UINT slice = 0; slice < info.ArraySize; ++slice)
+			{
+				const DDSSubresource& sub = info.Get(mip, slice);
+
+				MipData mipData;
+				mipData.Mip        = mip;
+				mipData.Slice      = slice;
+				mipData.Data       = block + (size_t)slice*sub.SlicePitch;
+				mipData.RowPitch   = sub.RowPitch;
+				mipData.SlicePitch = sub.SlicePitch;
+				data.push_back(mipData);
+			}
+		}
+
+		sink.SetResidentMips(ready[i], info, oldFirstMip, newFirstMip, &data[0], (UINT)data.size());
+
+		for(UINT mip = newFirstMip; mip < oldFirstMip; ++mip)
+		{
+			mResidentBytes += info.MipSize(mip);
+			mBytesUploaded += info.MipSize(mip);
+			++mMipsUploaded;
+
+			mPool.Release(std::move(tex.Pending[mip]));
+			tex.Pending.erase(mip);
+		}
+		tex.ResidentMip = newFirstMip;
+	}
+}
+
+void TextureStreamer::Evict(UploadSink& sink)
+{
+	while( mResidentBytes > mBudgetBytes )
+	{
+		// The least recently used texture that was not used last frame and has a
+		// mip above its tail.
+		Handle victim = InvalidHandle;
+		for(Handle h = 0; h < (Handle)mTextures.size(); ++h)
+		{
+			const Texture& tex = mTextures[h];
+			if( !tex.HasInfo || tex.Failed || tex.LastUsedFrame + 1 >= mFrame )
+				continue;
+			if( tex.ResidentMip >= TailMip(tex.Info) )
+				continue;
+			if( victim == InvalidHandle || tex.LastUsedFrame < mTextures[victim].LastUsedFrame )
+				victim = h;
+		}
+
+		if( victim == InvalidHandle )
+			break;
+
+		Texture& tex = mTextures[victim];
+		UINT oldFirstMip = tex.ResidentMip;
+		sink.SetResidentMips(victim, tex.Info, oldFirstMip, oldFirstMip + 1, 0, 0);
+
+		mResidentBytes -= tex.Info.MipSize(oldFirstMip);
+		++mEvictions;
+
+		tex.ResidentMip = oldFirstMip + 1;
+		tex.WantedMip = std::max(tex.WantedMip, tex.ResidentMip);
+
+		for(auto it = tex.Pending.begin(); it != tex.Pending.end(); )
+		{
+			if( it->first < tex.WantedMip )
+			{
+				mPool.Release(std::move(it->second));
+				it = tex.Pending.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+}
+
+void TextureStreamer::SetBudget(UINT64 budgetBytes)
+{
+	mBudgetBytes = budgetBytes;
+}
+
+UINT TextureStreamer::GetResidentMip(Handle handle)const
+{
+	return mTextures[handle].ResidentMip;
+}
+
+bool TextureStreamer::HasInfo(Handle handle)const
+{
+	return mTextures[handle].HasInfo;
+}
+
+const DDSInfo& TextureStreamer::GetInfo(Handle handle)const
+{
+	return mTextures[handle].Info;
+}
+
+bool TextureStreamer::IsFailed(Handle handle, std::string* error)const
+{
+	const Texture& tex = mTextures[handle];
+	if( tex.Failed && error )
+		*error = tex.Error;
+	return tex.Failed;
+}
+
+const std::string& TextureStreamer::GetFilename(Handle handle)const
+{
+	return mTextures[handle].Filename;
+}
+
+TextureStreamer::Stats TextureStreamer::GetStats()const
+{
+	Stats stats;
+	stats.ResidentBytes = mResidentBytes;
+	stats.BudgetBytes   = mBudgetBytes;
+	stats.BytesUploaded = mBytesUploaded;
+	stats.PoolBytes     = mPool.FreeBytes();
+	stats.PoolReuses    = mPool.Reuses();
+	stats.MipsUploaded  = mMipsUploaded;
+	stats.Evictions     = mEvictions;
+	stats.Failures      = mFailures;
+	{
+		std::lock_guard<std::mutex> lock(mMessageMutex);
+		stats.BytesRead = mBytesRead;
+	}
+	return stats;
+}
@@ -0,0 +1,228 @@
+//***************************************************************************************
+// TextureStreamer.h
+//
+// Loads DDS textures on worker threads and hands their mips to an UploadSink on the
+// main thread, smallest mip first, so a texture shows up blurry at once and sharpens
+// as its larger mips arrive.
+//
+// Mip data is read into blocks taken from a pool, so a steady stream of loads does
+// not go back to the heap for every mip.  The mips resident in the sink are kept
+// under a byte budget: when it is exceeded, the largest mips of the textures used
+// least recently are dropped, down to a small tail that always stays.  The tail
+// (mips of 64 texels and under) is uploaded in one go.  Touching a
+// texture whose mips were dropped streams them in again.
+//
+// Files with a single mip in an 8 bits per channel format get their chain built on
+// the CPU; other files the parser does not take are reported as failed, for the
+// caller to load some other way.
+//
+// Request, Touch, Update and the getters belong to the main thread; only the file
+// reads run on the workers.  Nothing here needs Direct3D, so the whole path can be
+// driven by a sink that just records what it is given.
+//***************************************************************************************
+
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include "DDSTexture.h"
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class TextureStreamer
+{
+public:
+	typedef UINT Handle;
+	static const Handle InvalidHandle = 0xffffffff;
+
+	struct MipData
+	{
+		UINT Mip;
+		UINT Slice;
+		const void* Data;
+		UINT RowPitch;
+		UINT SlicePitch;
+	};
+
+	class UploadSink
+	{
+	public:
+		virtual ~UploadSink() {}
+
+		///<summary>
+		/// Makes mips [newFirstMip, info.MipLevels) of the texture resident.  Mips
+		/// from oldFirstMip on are resident already and are to be kept; oldFirstMip
+		/// is info.MipLevels the first time.  When the texture grows, data holds every
+		/// slice of mips [newFirstMip, oldFirstMip); when it is trimmed (newFirstMip >
+		/// oldFirstMip) dataCount is 0.  data is only valid during the call.
+		///</summary>
+		virtual void SetResidentMips(Handle handle, const DDSInfo& info, UINT oldFirstMip, UINT newFirstMip,
+			const MipData* data, UINT dataCount) = 0;
+	};
+
+	struct Stats
+	{
+		UINT64 ResidentBytes;
+		UINT64 BudgetBytes;
+		UINT64 BytesRead;
+		UINT64 BytesUploaded;
+		UINT64 PoolBytes;		// held by free blocks
+		UINT PoolReuses;
+		UINT MipsUploaded;
+		UINT Evictions;
+		UINT Failures;
+	};
+
+	///<summary>
+	/// threadCount 0 picks two workers, which is enough to keep a disk busy.
+	///</summary>
+	explicit TextureStreamer(UINT threadCount = 0, UINT64 budgetBytes = 256ull << 20);
+	~TextureStreamer();
+
+	///<summary>
+	/// Starts streaming filename unless it already is; the same name always gives
+	/// the same handle.
+	///</summary>
+	Handle Request(const std::string& filename);
+
+	///<summary>
+	/// Marks the texture as used this frame, which protects it from eviction and
+	/// brings back any mips that were dropped.
+	///</summary>
+	void Touch(Handle handle);
+
+	///<summary>
+	/// Call once a frame.  Hands the mips loaded since the last call to sink, at most
+	/// maxUploadBytes of them (0 for no limit; at least one mip always goes), then
+	/// trims textures not used last frame until the resident bytes fit the budget.
+	///</summary>
+	void Update(UploadSink& sink, UINT64 maxUploadBytes = 0);
+
+	///<summary>
+	/// Blocks until every queued file read has finished.  The loaded mips still need
+	/// an Update to reach the sink.
+	///</summary>
+	void WaitIdle();
+
+	void SetBudget(UINT64 budgetBytes);
+
+	// info.MipLevels until the first mip is resident.
+	UINT GetResidentMip(Handle handle)const;
+	bool HasInfo(Handle handle)const;
+	const DDSInfo& GetInfo(Handle handle)const;
+	bool IsFailed(Handle handle, std::string* error = 0)const;
+	const std::string& GetFilename(Handle handle)const;
+
+	Stats GetStats()const;
+
+private:
+	TextureStreamer(const TextureStreamer& rhs);
+	TextureStreamer& operator=(const TextureStreamer& rhs);
+
+	struct Block
+	{
+		Block() : Capacity(0) {}
+		std::unique_ptr<char[]> Data;
+		size_t Capacity;
+	};
+
+	// Free blocks by power of two capacity.
+	class BlockPool
+	{
+	public:
+		BlockPool() : mFreeBytes(0), mReuses(0) {}
+		Block Acquire(size_t size);
+		void Release(Block block);
+		UINT64 FreeBytes()const;
+		UINT Reuses()const;
+
+	private:
+		static const UINT64 MaxFreeBytes = 64ull << 20;
+
+		mutable std::mutex mMutex;
+		std::map<size_t, std::vector<Block>> mFree;
+		UINT64 mFreeBytes;
+		UINT mReuses;
+	};
+
+	struct Job
+	{
+		Handle Texture;
+		std::string Filename;
+		bool HasInfo;
+		bool GenerateMips;
+		DDSInfo Info;
+		UINT FirstMip;
+		UINT EndMip;
+	};
+
+	struct Message
+	{
+		enum Kind { Header, Mip, Failed, Done };
+
+		Kind Type;
+		Handle Texture;
+		UINT MipLevel;
+		Block Data;
+		DDSInfo Info;
+		bool GenerateMips;
+		std::string Error;
+	};
+
+	struct Texture
+	{
+		std::string Filename;
+		DDSInfo Info;
+		bool HasInfo;
+		bool GenerateMips;
+		bool Failed;
+		bool JobInFlight;
+		std::string Error;
+		UINT ResidentMip;
+		UINT WantedMip;		// loads of mips above this are dropped
+		UINT64 LastUsedFrame;
+		std::map<UINT, Block> Pending;
+	};
+
+	void WorkerMain();
+	void RunJob(Job& job);
+	bool ReadMips(Job& job, std::ifstream& fin);
+	void Post(Message& message);
+	void QueueJob(Handle handle, UINT firstMip);
+
+	// The smallest mips, which are uploaded together and never evicted.
+	UINT TailMip(const DDSInfo& info)const;
+	void Upload(UploadSink& sink, UINT64 maxUploadBytes);
+	void Evict(UploadSink& sink);
+
+private:
+	std::vector<Texture> mTextures;
+	std::map<std::string, Handle> mHandles;
+	UINT64 mFrame;
+	UINT64 mBudgetBytes;
+	UINT64 mResidentBytes;
+	UINT64 mBytesUploaded;
+	UINT mMipsUploaded;
+	UINT mEvictions;
+	UINT mFailures;
+
+	BlockPool mPool;
+
+	std::mutex mJobMutex;
+	std::condition_variable mJobCv;
+	std::condition_variable mIdleCv;
+	std::deque<Job> mJobs;
+	UINT mBusyWorkers;
+	bool mStopping;
+	std::vector<std::thread> mWorkers;
+
+	mutable std::mutex mMessageMutex;
+	std::vector<Message> mMessages;
+	UINT64 mBytesRead;
+};
+
+#endif // TEXTURESTREAMER_H
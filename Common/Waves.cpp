@@ -3,6 +3,7 @@
 //***************************************************************************************
 
 #include "Waves.h"
+#include "Profiler.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
@@ -101,6 +102,8 @@ void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
 
 void Waves::Update(float dt)
 {
+	PROFILE_FUNCTION();
+
 	static float t = 0;
 
 	// Accumulate time.
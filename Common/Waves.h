@@ -9,8 +9,7 @@
 #ifndef WAVES_H
 #define WAVES_H
 
-#include <Windows.h>
-#include <xnamath.h>
+#include "XnaMathPortable.h"
 
 class Waves
 {
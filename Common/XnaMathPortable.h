@@ -0,0 +1,1718 @@
+//***************************************************************************************
+// XnaMathPortable.h
+//
+// Header-only replacement for the subset of xnamath.h used by the CPU side of the
+// samples (MathHelper, Camera, Waves, SkinnedData, Octree, xnacollision and the
+// geometry/animation helpers).  On Windows the real xnamath.h is included unless
+// XM_PORTABLE is defined, so existing projects are unaffected.  Everywhere else the
+// types and functions below are provided with the same names, layouts and results:
+//
+//   - SSE2 intrinsics when the compiler targets x86/x64 (_XM_SSE_INTRINSICS_),
+//     with AVX permutes and FMA multiply-add picked up when __AVX__/__FMA__ are set.
+//   - A plain C++ fallback otherwise, or when _XM_NO_INTRINSICS_ is defined.  On ARM
+//     the compiler auto-vectorizes the 4-wide loops to NEON.
+//
+// Only element-granular permute controls (XM_PERMUTE_0X ... XM_PERMUTE_1W) are
+// supported; the byte-level permutes of the Xbox 360 VMX128 path are not.
+//***************************************************************************************
+
+#pragma once
+
+#if defined(_WIN32) && !defined(XM_PORTABLE)
+
+#include <Windows.h>
+#include <xnamath.h>
+
+#else
+
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if !defined(_XM_NO_INTRINSICS_) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define _XM_SSE_INTRINSICS_
+#include <emmintrin.h>
+#if defined(__AVX__) || defined(__FMA__)
+#include <immintrin.h>
+#endif
+#elif !defined(_XM_NO_INTRINSICS_)
+#define _XM_NO_INTRINSICS_
+#endif
+
+//---------------------------------------------------------------------------------------
+// Windows scalar types used throughout the samples.
+//---------------------------------------------------------------------------------------
+
+#ifndef _WIN32
+typedef unsigned int   UINT;
+typedef int            INT;
+typedef float          FLOAT;
+typedef int            BOOL;
+typedef unsigned char  BYTE;
+typedef unsigned short USHORT;
+typedef uint32_t       DWORD;
+typedef int64_t        __int64;
+typedef uint64_t       UINT64;
+#ifndef VOID
+#define VOID void
+#endif
+#ifndef TRUE
+#define TRUE  1
+#define FALSE 0
+#endif
+#ifndef CONST
+#define CONST const
+#endif
+#endif
+
+#define XMFINLINE inline
+#define XMINLINE  inline
+#define XMGLOBALCONST static const
+#define _DECLSPEC_ALIGN_16_
+
+#if defined(_DEBUG) || defined(DEBUG)
+#define XMASSERT(Expression) assert(Expression)
+#else
+#define XMASSERT(Expression) ((void)0)
+#endif
+
+//---------------------------------------------------------------------------------------
+// Constant definitions
+//---------------------------------------------------------------------------------------
+
+#define XM_PI               3.141592654f
+#define XM_2PI              6.283185307f
+#define XM_1DIVPI           0.318309886f
+#define XM_1DIV2PI          0.159154943f
+#define XM_PIDIV2           1.570796327f
+#define XM_PIDIV4           0.785398163f
+
+#define XM_SELECT_0         0x00000000
+#define XM_SELECT_1         0xFFFFFFFF
+
+#define XM_PERMUTE_0X       0x00010203
+#define XM_PERMUTE_0Y       0x04050607
+#define XM_PERMUTE_0Z       0x08090A0B
+#define XM_PERMUTE_0W       0x0C0D0E0F
+#define XM_PERMUTE_1X       0x10111213
+#define XM_PERMUTE_1Y       0x14151617
+#define XM_PERMUTE_1Z       0x18191A1B
+#define XM_PERMUTE_1W       0x1C1D1E1F
+
+#define XM_CRMASK_CR6       0x000000F0
+#define XM_CRMASK_CR6TRUE   0x00000080
+#define XM_CRMASK_CR6FALSE  0x00000020
+#define XM_CRMASK_CR6BOUNDS XM_CRMASK_CR6FALSE
+
+#define XM_CACHE_LINE_SIZE  64
+
+XMFINLINE FLOAT XMConvertToRadians(FLOAT fDegrees) { return fDegrees * (XM_PI / 180.0f); }
+XMFINLINE FLOAT XMConvertToDegrees(FLOAT fRadians) { return fRadians * (180.0f / XM_PI); }
+
+#define XMComparisonAllTrue(CR)            (((CR) & XM_CRMASK_CR6TRUE) == XM_CRMASK_CR6TRUE)
+#define XMComparisonAnyTrue(CR)            (((CR) & XM_CRMASK_CR6FALSE) != XM_CRMASK_CR6FALSE)
+#define XMComparisonAllFalse(CR)           (((CR) & XM_CRMASK_CR6FALSE) == XM_CRMASK_CR6FALSE)
+#define XMComparisonAnyFalse(CR)           (((CR) & XM_CRMASK_CR6TRUE) != XM_CRMASK_CR6TRUE)
+#define XMComparisonMixed(CR)              (((CR) & XM_CRMASK_CR6) == 0)
+#define XMComparisonAllInBounds(CR)        (((CR) & XM_CRMASK_CR6BOUNDS) == XM_CRMASK_CR6BOUNDS)
+#define XMComparisonAnyOutOfBounds(CR)     (((CR) & XM_CRMASK_CR6BOUNDS) != XM_CRMASK_CR6BOUNDS)
+
+#define XMMin(a, b) (((a) < (b)) ? (a) : (b))
+#define XMMax(a, b) (((a) > (b)) ? (a) : (b))
+
+//---------------------------------------------------------------------------------------
+// Data types
+//---------------------------------------------------------------------------------------
+
+#if defined(_XM_NO_INTRINSICS_)
+struct __vector4
+{
+	union
+	{
+		float    vector4_f32[4];
+		uint32_t vector4_u32[4];
+	};
+};
+typedef __vector4 XMVECTOR;
+#else
+typedef __m128 XMVECTOR;
+#endif
+
+// Fix-up for (1st-3rd) XMVECTOR parameters that are pass-in-register on the
+// intrinsic paths and by-reference otherwise, exactly as in xnamath.
+typedef const XMVECTOR  FXMVECTOR;
+typedef const XMVECTOR& CXMVECTOR;
+
+// GCC and Clang implement the arithmetic operators natively for __m128.  MSVC and
+// the scalar __vector4 need the overloads that xnamath provides.
+#if defined(_XM_NO_INTRINSICS_) || defined(_MSC_VER)
+#define _XM_VECTOR_OPERATORS_
+#endif
+
+struct XMVECTORF32
+{
+	union
+	{
+		float f[4];
+		XMVECTOR v;
+	};
+
+	operator XMVECTOR() const { return v; }
+	operator const float*() const { return f; }
+};
+
+// Stored unsigned so that XM_SELECT_1 (0xFFFFFFFF) initializers, which xnacollision
+// uses throughout, are not narrowing conversions; only the bit pattern matters.
+struct XMVECTORI32
+{
+	union
+	{
+		uint32_t i[4];
+		XMVECTOR v;
+	};
+
+	operator XMVECTOR() const { return v; }
+};
+
+struct XMVECTORU32
+{
+	union
+	{
+		uint32_t u[4];
+		XMVECTOR v;
+	};
+
+	operator XMVECTOR() const { return v; }
+};
+
+struct XMMATRIX;
+typedef const XMMATRIX& CXMMATRIX;
+
+struct XMMATRIX
+{
+	union
+	{
+		XMVECTOR r[4];
+		struct
+		{
+			FLOAT _11, _12, _13, _14;
+			FLOAT _21, _22, _23, _24;
+			FLOAT _31, _32, _33, _34;
+			FLOAT _41, _42, _43, _44;
+		};
+		FLOAT m[4][4];
+	};
+
+	XMMATRIX() {}
+	XMMATRIX(FXMVECTOR R0, FXMVECTOR R1, FXMVECTOR R2, CXMVECTOR R3) { r[0] = R0; r[1] = R1; r[2] = R2; r[3] = R3; }
+	XMMATRIX(FLOAT m00, FLOAT m01, FLOAT m02, FLOAT m03,
+	         FLOAT m10, FLOAT m11, FLOAT m12, FLOAT m13,
+	         FLOAT m20, FLOAT m21, FLOAT m22, FLOAT m23,
+	         FLOAT m30, FLOAT m31, FLOAT m32, FLOAT m33)
+	{
+		_11 = m00; _12 = m01; _13 = m02; _14 = m03;
+		_21 = m10; _22 = m11; _23 = m12; _24 = m13;
+		_31 = m20; _32 = m21; _33 = m22; _34 = m23;
+		_41 = m30; _42 = m31; _43 = m32; _44 = m33;
+	}
+	explicit XMMATRIX(const FLOAT* pArray) { memcpy(m, pArray, sizeof(m)); }
+
+	FLOAT  operator() (UINT Row, UINT Column) const { return m[Row][Column]; }
+	FLOAT& operator() (UINT Row, UINT Column) { return m[Row][Column]; }
+
+	XMMATRIX& operator*= (CXMMATRIX M);
+	XMMATRIX  operator* (CXMMATRIX M) const;
+};
+
+struct XMFLOAT2
+{
+	FLOAT x;
+	FLOAT y;
+
+	XMFLOAT2() {}
+	XMFLOAT2(FLOAT _x, FLOAT _y) : x(_x), y(_y) {}
+	explicit XMFLOAT2(const FLOAT* pArray) : x(pArray[0]), y(pArray[1]) {}
+};
+
+struct XMFLOAT3
+{
+	FLOAT x;
+	FLOAT y;
+	FLOAT z;
+
+	XMFLOAT3() {}
+	XMFLOAT3(FLOAT _x, FLOAT _y, FLOAT _z) : x(_x), y(_y), z(_z) {}
+	explicit XMFLOAT3(const FLOAT* pArray) : x(pArray[0]), y(pArray[1]), z(pArray[2]) {}
+};
+
+struct XMFLOAT4
+{
+	FLOAT x;
+	FLOAT y;
+	FLOAT z;
+	FLOAT w;
+
+	XMFLOAT4() {}
+	XMFLOAT4(FLOAT _x, FLOAT _y, FLOAT _z, FLOAT _w) : x(_x), y(_y), z(_z), w(_w) {}
+	explicit XMFLOAT4(const FLOAT* pArray) : x(pArray[0]), y(pArray[1]), z(pArray[2]), w(pArray[3]) {}
+};
+
+struct XMFLOAT4X4
+{
+	union
+	{
+		struct
+		{
+			FLOAT _11, _12, _13, _14;
+			FLOAT _21, _22, _23, _24;
+			FLOAT _31, _32, _33, _34;
+			FLOAT _41, _42, _43, _44;
+		};
+		FLOAT m[4][4];
+	};
+
+	XMFLOAT4X4() {}
+	XMFLOAT4X4(FLOAT m00, FLOAT m01, FLOAT m02, FLOAT m03,
+	           FLOAT m10, FLOAT m11, FLOAT m12, FLOAT m13,
+	           FLOAT m20, FLOAT m21, FLOAT m22, FLOAT m23,
+	           FLOAT m30, FLOAT m31, FLOAT m32, FLOAT m33)
+	{
+		_11 = m00; _12 = m01; _13 = m02; _14 = m03;
+		_21 = m10; _22 = m11; _23 = m12; _24 = m13;
+		_31 = m20; _32 = m21; _33 = m22; _34 = m23;
+		_41 = m30; _42 = m31; _43 = m32; _44 = m33;
+	}
+	explicit XMFLOAT4X4(const FLOAT* pArray) { memcpy(m, pArray, sizeof(m)); }
+
+	FLOAT  operator() (UINT Row, UINT Column) const { return m[Row][Column]; }
+	FLOAT& operator() (UINT Row, UINT Column) { return m[Row][Column]; }
+};
+
+//---------------------------------------------------------------------------------------
+// Lane access.  Everything below is written against these few primitives plus the
+// SSE fast paths, so the scalar and intrinsic builds share one implementation.
+//---------------------------------------------------------------------------------------
+
+namespace XMPortable
+{
+	XMFINLINE FLOAT Lane(FXMVECTOR V, UINT i)
+	{
+#if defined(_XM_NO_INTRINSICS_)
+		return V.vector4_f32[i];
+#else
+		XMVECTORF32 t; t.v = V;
+		return t.f[i];
+#endif
+	}
+
+	XMFINLINE uint32_t LaneU(FXMVECTOR V, UINT i)
+	{
+		XMVECTORU32 t; t.v = V;
+		return t.u[i];
+	}
+
+	XMFINLINE XMVECTOR FromU(uint32_t x, uint32_t y, uint32_t z, uint32_t w)
+	{
+		XMVECTORU32 t = { { { x, y, z, w } } };
+		return t.v;
+	}
+
+	XMFINLINE uint32_t Mask(bool b) { return b ? 0xFFFFFFFFu : 0u; }
+
+	XMFINLINE UINT Record(uint32_t m0, uint32_t m1, uint32_t m2, uint32_t m3)
+	{
+		uint32_t all = m0 & m1 & m2 & m3;
+		uint32_t any = m0 | m1 | m2 | m3;
+		UINT CR = 0;
+		if (all == 0xFFFFFFFFu)
+			CR = XM_CRMASK_CR6TRUE;
+		else if (any == 0)
+			CR = XM_CRMASK_CR6FALSE;
+		return CR;
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Vector initialization and access
+//---------------------------------------------------------------------------------------
+
+XMFINLINE XMVECTOR XMVectorZero()
+{
+#if defined(_XM_NO_INTRINSICS_)
+	XMVECTOR V = { { { 0.0f, 0.0f, 0.0f, 0.0f } } };
+	return V;
+#else
+	return _mm_setzero_ps();
+#endif
+}
+
+XMFINLINE XMVECTOR XMVectorSet(FLOAT x, FLOAT y, FLOAT z, FLOAT w)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	XMVECTOR V = { { { x, y, z, w } } };
+	return V;
+#else
+	return _mm_set_ps(w, z, y, x);
+#endif
+}
+
+XMFINLINE XMVECTOR XMVectorSetInt(UINT x, UINT y, UINT z, UINT w)
+{
+	return XMPortable::FromU(x, y, z, w);
+}
+
+XMFINLINE XMVECTOR XMVectorReplicate(FLOAT Value)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	return XMVectorSet(Value, Value, Value, Value);
+#else
+	return _mm_set1_ps(Value);
+#endif
+}
+
+XMFINLINE XMVECTOR XMVectorReplicatePtr(const FLOAT* pValue)
+{
+	return XMVectorReplicate(*pValue);
+}
+
+XMFINLINE XMVECTOR XMVectorReplicateInt(UINT Value)
+{
+	return XMPortable::FromU(Value, Value, Value, Value);
+}
+
+XMFINLINE XMVECTOR XMVectorTrueInt()
+{
+	return XMVectorReplicateInt(0xFFFFFFFFu);
+}
+
+XMFINLINE XMVECTOR XMVectorFalseInt()
+{
+	return XMVectorZero();
+}
+
+XMFINLINE XMVECTOR XMVectorSplatOne()
+{
+	return XMVectorReplicate(1.0f);
+}
+
+XMFINLINE XMVECTOR XMVectorSplatInfinity()
+{
+	return XMVectorReplicateInt(0x7F800000u);
+}
+
+XMFINLINE XMVECTOR XMVectorSplatQNaN()
+{
+	return XMVectorReplicateInt(0x7FC00000u);
+}
+
+XMFINLINE XMVECTOR XMVectorSplatEpsilon()
+{
+	return XMVectorReplicateInt(0x34000000u);
+}
+
+XMFINLINE FLOAT XMVectorGetByIndex(FXMVECTOR V, UINT i)
+{
+	XMASSERT(i < 4);
+	return XMPortable::Lane(V, i);
+}
+
+XMFINLINE FLOAT XMVectorGetX(FXMVECTOR V)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	return V.vector4_f32[0];
+#else
+	return _mm_cvtss_f32(V);
+#endif
+}
+
+XMFINLINE FLOAT XMVectorGetY(FXMVECTOR V) { return XMPortable::Lane(V, 1); }
+XMFINLINE FLOAT XMVectorGetZ(FXMVECTOR V) { return XMPortable::Lane(V, 2); }
+XMFINLINE FLOAT XMVectorGetW(FXMVECTOR V) { return XMPortable::Lane(V, 3); }
+
+XMFINLINE UINT XMVectorGetIntX(FXMVECTOR V) { return XMPortable::LaneU(V, 0); }
+XMFINLINE UINT XMVectorGetIntY(FXMVECTOR V) { return XMPortable::LaneU(V, 1); }
+XMFINLINE UINT XMVectorGetIntZ(FXMVECTOR V) { return XMPortable::LaneU(V, 2); }
+XMFINLINE UINT XMVectorGetIntW(FXMVECTOR V) { return XMPortable::LaneU(V, 3); }
+
+XMFINLINE XMVECTOR XMVectorSetByIndex(FXMVECTOR V, FLOAT f, UINT i)
+{
+	XMASSERT(i < 4);
+	XMVECTORF32 t; t.v = V;
+	t.f[i] = f;
+	return t.v;
+}
+
+XMFINLINE XMVECTOR XMVectorSetX(FXMVECTOR V, FLOAT x) { return XMVectorSetByIndex(V, x, 0); }
+XMFINLINE XMVECTOR XMVectorSetY(FXMVECTOR V, FLOAT y) { return XMVectorSetByIndex(V, y, 1); }
+XMFINLINE XMVECTOR XMVectorSetZ(FXMVECTOR V, FLOAT z) { return XMVectorSetByIndex(V, z, 2); }
+XMFINLINE XMVECTOR XMVectorSetW(FXMVECTOR V, FLOAT w) { return XMVectorSetByIndex(V, w, 3); }
+
+XMFINLINE XMVECTOR XMVectorSetBinaryConstant(UINT C0, UINT C1, UINT C2, UINT C3)
+{
+	return XMPortable::FromU((0 - (C0 & 1)) & 0x3F800000u, (0 - (C1 & 1)) & 0x3F800000u,
+		(0 - (C2 & 1)) & 0x3F800000u, (0 - (C3 & 1)) & 0x3F800000u);
+}
+
+//---------------------------------------------------------------------------------------
+// Load and store
+//---------------------------------------------------------------------------------------
+
+XMFINLINE XMVECTOR XMLoadFloat(const FLOAT* pSource)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	return XMVectorSet(*pSource, 0.0f, 0.0f, 0.0f);
+#else
+	return _mm_load_ss(pSource);
+#endif
+}
+
+XMFINLINE XMVECTOR XMLoadFloat2(const XMFLOAT2* pSource)
+{
+	return XMVectorSet(pSource->x, pSource->y, 0.0f, 0.0f);
+}
+
+XMFINLINE XMVECTOR XMLoadFloat3(const XMFLOAT3* pSource)
+{
+	return XMVectorSet(pSource->x, pSource->y, pSource->z, 0.0f);
+}
+
+XMFINLINE XMVECTOR XMLoadFloat4(const XMFLOAT4* pSource)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	return XMVectorSet(pSource->x, pSource->y, pSource->z, pSource->w);
+#else
+	return _mm_loadu_ps(&pSource->x);
+#endif
+}
+
+XMFINLINE XMMATRIX XMLoadFloat4x4(const XMFLOAT4X4* pSource)
+{
+	XMMATRIX M;
+#if defined(_XM_NO_INTRINSICS_)
+	memcpy(M.m, pSource->m, sizeof(M.m));
+#else
+	M.r[0] = _mm_loadu_ps(&pSource->_11);
+	M.r[1] = _mm_loadu_ps(&pSource->_21);
+	M.r[2] = _mm_loadu_ps(&pSource->_31);
+	M.r[3] = _mm_loadu_ps(&pSource->_41);
+#endif
+	return M;
+}
+
+XMFINLINE VOID XMStoreFloat(FLOAT* pDestination, FXMVECTOR V)
+{
+	*pDestination = XMVectorGetX(V);
+}
+
+XMFINLINE VOID XMStoreFloat2(XMFLOAT2* pDestination, FXMVECTOR V)
+{
+	pDestination->x = XMVectorGetX(V);
+	pDestination->y = XMVectorGetY(V);
+}
+
+XMFINLINE VOID XMStoreFloat3(XMFLOAT3* pDestination, FXMVECTOR V)
+{
+	XMVECTORF32 t; t.v = V;
+	pDestination->x = t.f[0];
+	pDestination->y = t.f[1];
+	pDestination->z = t.f[2];
+}
+
+XMFINLINE VOID XMStoreFloat4(XMFLOAT4* pDestination, FXMVECTOR V)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	memcpy(&pDestination->x, V.vector4_f32, sizeof(XMFLOAT4));
+#else
+	_mm_storeu_ps(&pDestination->x, V);
+#endif
+}
+
+XMFINLINE VOID XMStoreFloat4x4(XMFLOAT4X4* pDestination, CXMMATRIX M)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	memcpy(pDestination->m, M.m, sizeof(M.m));
+#else
+	_mm_storeu_ps(&pDestination->_11, M.r[0]);
+	_mm_storeu_ps(&pDestination->_21, M.r[1]);
+	_mm_storeu_ps(&pDestination->_31, M.r[2]);
+	_mm_storeu_ps(&pDestination->_41, M.r[3]);
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+// Permute, select and swizzle
+//---------------------------------------------------------------------------------------
+
+XMFINLINE XMVECTOR XMVectorSplatX(FXMVECTOR V)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	return XMVectorReplicate(V.vector4_f32[0]);
+#else
+	return _mm_shuffle_ps(V, V, _MM_SHUFFLE(0, 0, 0, 0));
+#endif
+}
+
+XMFINLINE XMVECTOR XMVectorSplatY(FXMVECTOR V)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	return XMVectorReplicate(V.vector4_f32[1]);
+#else
+	return _mm_shuffle_ps(V, V, _MM_SHUFFLE(1, 1, 1, 1));
+#endif
+}
+
+XMFINLINE XMVECTOR XMVectorSplatZ(FXMVECTOR V)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	return XMVectorReplicate(V.vector4_f32[2]);
+#else
+	return _mm_shuffle_ps(V, V, _MM_SHUFFLE(2, 2, 2, 2));
+#endif
+}
+
+XMFINLINE XMVECTOR XMVectorSplatW(FXMVECTOR V)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	return XMVectorReplicate(V.vector4_f32[3]);
+#else
+	return _mm_shuffle_ps(V, V, _MM_SHUFFLE(3, 3, 3, 3));
+#endif
+}
+
+XMFINLINE XMVECTOR XMVectorPermuteControl(UINT ElementIndex0, UINT ElementIndex1, UINT ElementIndex2, UINT ElementIndex3)
+{
+	static const uint32_t ControlElement[8] =
+	{
+		XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_0Z, XM_PERMUTE_0W,
+		XM_PERMUTE_1X, XM_PERMUTE_1Y, XM_PERMUTE_1Z, XM_PERMUTE_1W,
+	};
+	XMASSERT(ElementIndex0 < 8 && ElementIndex1 < 8 && ElementIndex2 < 8 && ElementIndex3 < 8);
+	return XMPortable::FromU(ControlElement[ElementIndex0], ControlElement[ElementIndex1],
+		ControlElement[ElementIndex2], ControlElement[ElementIndex3]);
+}
+
+XMFINLINE XMVECTOR XMVectorPermute(FXMVECTOR V1, FXMVECTOR V2, FXMVECTOR Control)
+{
+	XMVECTORF32 src[2];
+	src[0].v = V1;
+	src[1].v = V2;
+	XMVECTORF32 result;
+	for (UINT i = 0; i < 4; ++i)
+	{
+		// XM_PERMUTE_0X..1W select whole elements: the low byte of each control
+		// word is 4*element+3, so the element index is (byte & 0x1F) >> 2.
+		uint32_t element = (XMPortable::LaneU(Control, i) & 0x1F) >> 2;
+		result.f[i] = src[element >> 2].f[element & 3];
+	}
+	return result.v;
+}
+
+XMFINLINE XMVECTOR XMVectorSwizzle(FXMVECTOR V, UINT E0, UINT E1, UINT E2, UINT E3)
+{
+	XMASSERT((E0 < 4) && (E1 < 4) && (E2 < 4) && (E3 < 4));
+	return XMVectorSet(XMPortable::Lane(V, E0), XMPortable::Lane(V, E1),
+		XMPortable::Lane(V, E2), XMPortable::Lane(V, E3));
+}
+
+XMFINLINE XMVECTOR XMVectorRotateLeft(FXMVECTOR V, UINT Elements)
+{
+	XMASSERT(Elements < 4);
+	return XMVectorSwizzle(V, Elements & 3, (Elements + 1) & 3, (Elements + 2) & 3, (Elements + 3) & 3);
+}
+
+XMFINLINE XMVECTOR XMVectorRotateRight(FXMVECTOR V, UINT Elements)
+{
+	XMASSERT(Elements < 4);
+	return XMVectorSwizzle(V, (4 - Elements) & 3, (5 - Elements) & 3, (6 - Elements) & 3, (7 - Elements) & 3);
+}
+
+XMFINLINE XMVECTOR XMVectorSelectControl(UINT VectorIndex0, UINT VectorIndex1, UINT VectorIndex2, UINT VectorIndex3)
+{
+	return XMPortable::FromU(0 - (VectorIndex0 & 1), 0 - (VectorIndex1 & 1), 0 - (VectorIndex2 & 1), 0 - (VectorIndex3 & 1));
+}
+
+XMFINLINE XMVECTOR XMVectorSelect(FXMVECTOR V1, FXMVECTOR V2, FXMVECTOR Control)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	XMVECTOR Result;
+	for (UINT i = 0; i < 4; ++i)
+		Result.vector4_u32[i] = (V1.vector4_u32[i] & ~Control.vector4_u32[i]) | (V2.vector4_u32[i] & Control.vector4_u32[i]);
+	return Result;
+#else
+	return _mm_or_ps(_mm_andnot_ps(Control, V1), _mm_and_ps(V2, Control));
+#endif
+}
+
+XMFINLINE XMVECTOR XMVectorInsert(FXMVECTOR VD, FXMVECTOR VS, UINT VSLeftRotateElements,
+	UINT Select0, UINT Select1, UINT Select2, UINT Select3)
+{
+	XMVECTOR Control = XMVectorSelectControl(Select0 & 1, Select1 & 1, Select2 & 1, Select3 & 1);
+	return XMVectorSelect(VD, XMVectorRotateLeft(VS, VSLeftRotateElements), Control);
+}
+
+//---------------------------------------------------------------------------------------
+// Bitwise and comparison
+//---------------------------------------------------------------------------------------
+
+#if defined(_XM_NO_INTRINSICS_)
+#define _XM_PORTABLE_BITWISE(name, expr)                                       \
+XMFINLINE XMVECTOR name(FXMVECTOR V1, FXMVECTOR V2)                            \
+{                                                                              \
+	XMVECTOR Result;                                                           \
+	for (UINT i = 0; i < 4; ++i)                                               \
+	{                                                                          \
+		uint32_t a = V1.vector4_u32[i], b = V2.vector4_u32[i];                 \
+		Result.vector4_u32[i] = (expr);                                        \
+	}                                                                          \
+	return Result;                                                             \
+}
+_XM_PORTABLE_BITWISE(XMVectorAndInt, a & b)
+_XM_PORTABLE_BITWISE(XMVectorAndCInt, a & ~b)
+_XM_PORTABLE_BITWISE(XMVectorOrInt, a | b)
+_XM_PORTABLE_BITWISE(XMVectorNorInt, ~(a | b))
+_XM_PORTABLE_BITWISE(XMVectorXorInt, a ^ b)
+_XM_PORTABLE_BITWISE(XMVectorEqualInt, XMPortable::Mask(a == b))
+_XM_PORTABLE_BITWISE(XMVectorNotEqualInt, XMPortable::Mask(a != b))
+#undef _XM_PORTABLE_BITWISE
+
+#define _XM_PORTABLE_COMPARE(name, op)                                         \
+XMFINLINE XMVECTOR name(FXMVECTOR V1, FXMVECTOR V2)                            \
+{                                                                              \
+	XMVECTOR Result;                                                           \
+	for (UINT i = 0; i < 4; ++i)                                               \
+		Result.vector4_u32[i] = XMPortable::Mask(V1.vector4_f32[i] op V2.vector4_f32[i]); \
+	return Result;                                                             \
+}
+_XM_PORTABLE_COMPARE(XMVectorEqual, ==)
+_XM_PORTABLE_COMPARE(XMVectorNotEqual, !=)
+_XM_PORTABLE_COMPARE(XMVectorGreater, >)
+_XM_PORTABLE_COMPARE(XMVectorGreaterOrEqual, >=)
+_XM_PORTABLE_COMPARE(XMVectorLess, <)
+_XM_PORTABLE_COMPARE(XMVectorLessOrEqual, <=)
+#undef _XM_PORTABLE_COMPARE
+
+XMFINLINE XMVECTOR XMVectorInBounds(FXMVECTOR V, FXMVECTOR Bounds)
+{
+	XMVECTOR Result;
+	for (UINT i = 0; i < 4; ++i)
+		Result.vector4_u32[i] = XMPortable::Mask(V.vector4_f32[i] <= Bounds.vector4_f32[i] && V.vector4_f32[i] >= -Bounds.vector4_f32[i]);
+	return Result;
+}
+
+XMFINLINE XMVECTOR XMVectorIsNaN(FXMVECTOR V)
+{
+	XMVECTOR Result;
+	for (UINT i = 0; i < 4; ++i)
+		Result.vector4_u32[i] = XMPortable::Mask(V.vector4_f32[i] != V.vector4_f32[i]);
+	return Result;
+}
+#else
+XMFINLINE XMVECTOR XMVectorAndInt(FXMVECTOR V1, FXMVECTOR V2) { return _mm_and_ps(V1, V2); }
+XMFINLINE XMVECTOR XMVectorAndCInt(FXMVECTOR V1, FXMVECTOR V2) { return _mm_andnot_ps(V2, V1); }
+XMFINLINE XMVECTOR XMVectorOrInt(FXMVECTOR V1, FXMVECTOR V2) { return _mm_or_ps(V1, V2); }
+XMFINLINE XMVECTOR XMVectorNorInt(FXMVECTOR V1, FXMVECTOR V2) { return _mm_xor_ps(_mm_or_ps(V1, V2), XMVectorTrueInt()); }
+XMFINLINE XMVECTOR XMVectorXorInt(FXMVECTOR V1, FXMVECTOR V2) { return _mm_xor_ps(V1, V2); }
+
+XMFINLINE XMVECTOR XMVectorEqualInt(FXMVECTOR V1, FXMVECTOR V2)
+{
+	return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_castps_si128(V1), _mm_castps_si128(V2)));
+}
+
+XMFINLINE XMVECTOR XMVectorNotEqualInt(FXMVECTOR V1, FXMVECTOR V2)
+{
+	return _mm_xor_ps(XMVectorEqualInt(V1, V2), XMVectorTrueInt());
+}
+
+XMFINLINE XMVECTOR XMVectorEqual(FXMVECTOR V1, FXMVECTOR V2) { return _mm_cmpeq_ps(V1, V2); }
+XMFINLINE XMVECTOR XMVectorNotEqual(FXMVECTOR V1, FXMVECTOR V2) { return _mm_cmpneq_ps(V1, V2); }
+XMFINLINE XMVECTOR XMVectorGreater(FXMVECTOR V1, FXMVECTOR V2) { return _mm_cmpgt_ps(V1, V2); }
+XMFINLINE XMVECTOR XMVectorGreaterOrEqual(FXMVECTOR V1, FXMVECTOR V2) { return _mm_cmpge_ps(V1, V2); }
+XMFINLINE XMVECTOR XMVectorLess(FXMVECTOR V1, FXMVECTOR V2) { return _mm_cmplt_ps(V1, V2); }
+XMFINLINE XMVECTOR XMVectorLessOrEqual(FXMVECTOR V1, FXMVECTOR V2) { return _mm_cmple_ps(V1, V2); }
+
+XMFINLINE XMVECTOR XMVectorInBounds(FXMVECTOR V, FXMVECTOR Bounds)
+{
+	XMVECTOR vTemp1 = _mm_cmple_ps(V, Bounds);
+	XMVECTOR vTemp2 = _mm_cmple_ps(_mm_sub_ps(_mm_setzero_ps(), Bounds), V);
+	return _mm_and_ps(vTemp1, vTemp2);
+}
+
+XMFINLINE XMVECTOR XMVectorIsNaN(FXMVECTOR V) { return _mm_cmpneq_ps(V, V); }
+#endif
+
+XMFINLINE XMVECTOR XMVectorGreaterR(UINT* pCR, FXMVECTOR V1, FXMVECTOR V2)
+{
+	XMASSERT(pCR);
+	XMVECTOR Result = XMVectorGreater(V1, V2);
+	*pCR = XMPortable::Record(XMPortable::LaneU(Result, 0), XMPortable::LaneU(Result, 1),
+		XMPortable::LaneU(Result, 2), XMPortable::LaneU(Result, 3));
+	return Result;
+}
+
+XMFINLINE XMVECTOR XMVectorEqualR(UINT* pCR, FXMVECTOR V1, FXMVECTOR V2)
+{
+	XMASSERT(pCR);
+	XMVECTOR Result = XMVectorEqual(V1, V2);
+	*pCR = XMPortable::Record(XMPortable::LaneU(Result, 0), XMPortable::LaneU(Result, 1),
+		XMPortable::LaneU(Result, 2), XMPortable::LaneU(Result, 3));
+	return Result;
+}
+
+namespace XMPortable
+{
+	// Returns a 4-bit mask of the lanes whose sign (all-ones compare) bit is set.
+	XMFINLINE int MoveMask(FXMVECTOR V)
+	{
+#if defined(_XM_NO_INTRINSICS_)
+		return (int)((V.vector4_u32[0] >> 31) | ((V.vector4_u32[1] >> 31) << 1) |
+			((V.vector4_u32[2] >> 31) << 2) | ((V.vector4_u32[3] >> 31) << 3));
+#else
+		return _mm_movemask_ps(V);
+#endif
+	}
+}
+
+// Whole-vector comparisons.  The 2/3-component forms only look at the low lanes.
+#define _XM_PORTABLE_ALL(name, cmp, lanes)                                     \
+XMFINLINE BOOL name(FXMVECTOR V1, FXMVECTOR V2)                                \
+{                                                                              \
+	return (XMPortable::MoveMask(cmp(V1, V2)) & (lanes)) == (lanes);           \
+}
+#define _XM_PORTABLE_ANY(name, cmp, lanes)                                     \
+XMFINLINE BOOL name(FXMVECTOR V1, FXMVECTOR V2)                                \
+{                                                                              \
+	return (XMPortable::MoveMask(cmp(V1, V2)) & (lanes)) != 0;                 \
+}
+
+_XM_PORTABLE_ALL(XMVector2Equal, XMVectorEqual, 0x3)
+_XM_PORTABLE_ALL(XMVector2Less, XMVectorLess, 0x3)
+_XM_PORTABLE_ALL(XMVector2Greater, XMVectorGreater, 0x3)
+
+_XM_PORTABLE_ALL(XMVector3Equal, XMVectorEqual, 0x7)
+_XM_PORTABLE_ALL(XMVector3EqualInt, XMVectorEqualInt, 0x7)
+_XM_PORTABLE_ANY(XMVector3NotEqual, XMVectorNotEqual, 0x7)
+_XM_PORTABLE_ANY(XMVector3NotEqualInt, XMVectorNotEqualInt, 0x7)
+_XM_PORTABLE_ALL(XMVector3Less, XMVectorLess, 0x7)
+_XM_PORTABLE_ALL(XMVector3LessOrEqual, XMVectorLessOrEqual, 0x7)
+_XM_PORTABLE_ALL(XMVector3Greater, XMVectorGreater, 0x7)
+_XM_PORTABLE_ALL(XMVector3GreaterOrEqual, XMVectorGreaterOrEqual, 0x7)
+_XM_PORTABLE_ALL(XMVector3InBounds, XMVectorInBounds, 0x7)
+
+_XM_PORTABLE_ALL(XMVector4Equal, XMVectorEqual, 0xF)
+_XM_PORTABLE_ALL(XMVector4EqualInt, XMVectorEqualInt, 0xF)
+_XM_PORTABLE_ANY(XMVector4NotEqual, XMVectorNotEqual, 0xF)
+_XM_PORTABLE_ANY(XMVector4NotEqualInt, XMVectorNotEqualInt, 0xF)
+_XM_PORTABLE_ALL(XMVector4Less, XMVectorLess, 0xF)
+_XM_PORTABLE_ALL(XMVector4LessOrEqual, XMVectorLessOrEqual, 0xF)
+_XM_PORTABLE_ALL(XMVector4Greater, XMVectorGreater, 0xF)
+_XM_PORTABLE_ALL(XMVector4GreaterOrEqual, XMVectorGreaterOrEqual, 0xF)
+_XM_PORTABLE_ALL(XMVector4InBounds, XMVectorInBounds, 0xF)
+
+#undef _XM_PORTABLE_ALL
+#undef _XM_PORTABLE_ANY
+
+XMFINLINE UINT XMVector4EqualIntR(FXMVECTOR V1, FXMVECTOR V2)
+{
+	int m = XMPortable::MoveMask(XMVectorEqualInt(V1, V2));
+	return m == 0xF ? XM_CRMASK_CR6TRUE : (m == 0 ? XM_CRMASK_CR6FALSE : 0);
+}
+
+XMFINLINE UINT XMVector3EqualR(FXMVECTOR V1, FXMVECTOR V2)
+{
+	int m = XMPortable::MoveMask(XMVectorEqual(V1, V2)) & 0x7;
+	return m == 0x7 ? XM_CRMASK_CR6TRUE : (m == 0 ? XM_CRMASK_CR6FALSE : 0);
+}
+
+XMFINLINE UINT XMVector3GreaterR(FXMVECTOR V1, FXMVECTOR V2)
+{
+	int m = XMPortable::MoveMask(XMVectorGreater(V1, V2)) & 0x7;
+	return m == 0x7 ? XM_CRMASK_CR6TRUE : (m == 0 ? XM_CRMASK_CR6FALSE : 0);
+}
+
+//---------------------------------------------------------------------------------------
+// Component-wise arithmetic
+//---------------------------------------------------------------------------------------
+
+#if defined(_XM_NO_INTRINSICS_)
+#define _XM_PORTABLE_BINARY(name, expr)                                        \
+XMFINLINE XMVECTOR name(FXMVECTOR V1, FXMVECTOR V2)                            \
+{                                                                              \
+	XMVECTOR Result;                                                           \
+	for (UINT i = 0; i < 4; ++i)                                               \
+	{                                                                          \
+		float a = V1.vector4_f32[i], b = V2.vector4_f32[i];                    \
+		Result.vector4_f32[i] = (expr);                                        \
+	}                                                                          \
+	return Result;                                                             \
+}
+_XM_PORTABLE_BINARY(XMVectorAdd, a + b)
+_XM_PORTABLE_BINARY(XMVectorSubtract, a - b)
+_XM_PORTABLE_BINARY(XMVectorMultiply, a * b)
+_XM_PORTABLE_BINARY(XMVectorDivide, a / b)
+_XM_PORTABLE_BINARY(XMVectorMin, a < b ? a : b)
+_XM_PORTABLE_BINARY(XMVectorMax, a > b ? a : b)
+#undef _XM_PORTABLE_BINARY
+
+#define _XM_PORTABLE_UNARY(name, expr)                                         \
+XMFINLINE XMVECTOR name(FXMVECTOR V)                                           \
+{                                                                              \
+	XMVECTOR Result;                                                           \
+	for (UINT i = 0; i < 4; ++i)                                               \
+	{                                                                          \
+		float a = V.vector4_f32[i];                                            \
+		Result.vector4_f32[i] = (expr);                                        \
+	}                                                                          \
+	return Result;                                                             \
+}
+_XM_PORTABLE_UNARY(XMVectorNegate, -a)
+_XM_PORTABLE_UNARY(XMVectorAbs, fabsf(a))
+_XM_PORTABLE_UNARY(XMVectorReciprocal, 1.0f / a)
+_XM_PORTABLE_UNARY(XMVectorReciprocalEst, 1.0f / a)
+_XM_PORTABLE_UNARY(XMVectorSqrt, sqrtf(a))
+_XM_PORTABLE_UNARY(XMVectorSqrtEst, sqrtf(a))
+_XM_PORTABLE_UNARY(XMVectorReciprocalSqrt, 1.0f / sqrtf(a))
+_XM_PORTABLE_UNARY(XMVectorReciprocalSqrtEst, 1.0f / sqrtf(a))
+_XM_PORTABLE_UNARY(XMVectorFloor, floorf(a))
+_XM_PORTABLE_UNARY(XMVectorCeiling, ceilf(a))
+_XM_PORTABLE_UNARY(XMVectorSaturate, a < 0.0f ? 0.0f : (a > 1.0f ? 1.0f : a))
+#undef _XM_PORTABLE_UNARY
+
+XMFINLINE XMVECTOR XMVectorScale(FXMVECTOR V, FLOAT ScaleFactor)
+{
+	return XMVectorMultiply(V, XMVectorReplicate(ScaleFactor));
+}
+
+XMFINLINE XMVECTOR XMVectorMultiplyAdd(FXMVECTOR V1, FXMVECTOR V2, FXMVECTOR V3)
+{
+	XMVECTOR Result;
+	for (UINT i = 0; i < 4; ++i)
+		Result.vector4_f32[i] = V1.vector4_f32[i] * V2.vector4_f32[i] + V3.vector4_f32[i];
+	return Result;
+}
+
+XMFINLINE XMVECTOR XMVectorNegativeMultiplySubtract(FXMVECTOR V1, FXMVECTOR V2, FXMVECTOR V3)
+{
+	XMVECTOR Result;
+	for (UINT i = 0; i < 4; ++i)
+		Result.vector4_f32[i] = V3.vector4_f32[i] - V1.vector4_f32[i] * V2.vector4_f32[i];
+	return Result;
+}
+#else
+XMFINLINE XMVECTOR XMVectorAdd(FXMVECTOR V1, FXMVECTOR V2) { return _mm_add_ps(V1, V2); }
+XMFINLINE XMVECTOR XMVectorSubtract(FXMVECTOR V1, FXMVECTOR V2) { return _mm_sub_ps(V1, V2); }
+XMFINLINE XMVECTOR XMVectorMultiply(FXMVECTOR V1, FXMVECTOR V2) { return _mm_mul_ps(V1, V2); }
+XMFINLINE XMVECTOR XMVectorDivide(FXMVECTOR V1, FXMVECTOR V2) { return _mm_div_ps(V1, V2); }
+XMFINLINE XMVECTOR XMVectorMin(FXMVECTOR V1, FXMVECTOR V2) { return _mm_min_ps(V1, V2); }
+XMFINLINE XMVECTOR XMVectorMax(FXMVECTOR V1, FXMVECTOR V2) { return _mm_max_ps(V1, V2); }
+
+XMFINLINE XMVECTOR XMVectorNegate(FXMVECTOR V) { return _mm_sub_ps(_mm_setzero_ps(), V); }
+XMFINLINE XMVECTOR XMVectorAbs(FXMVECTOR V) { return _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), V), V); }
+XMFINLINE XMVECTOR XMVectorReciprocal(FXMVECTOR V) { return _mm_div_ps(_mm_set1_ps(1.0f), V); }
+XMFINLINE XMVECTOR XMVectorReciprocalEst(FXMVECTOR V) { return _mm_rcp_ps(V); }
+XMFINLINE XMVECTOR XMVectorSqrt(FXMVECTOR V) { return _mm_sqrt_ps(V); }
+XMFINLINE XMVECTOR XMVectorSqrtEst(FXMVECTOR V) { return _mm_sqrt_ps(V); }
+XMFINLINE XMVECTOR XMVectorReciprocalSqrt(FXMVECTOR V) { return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(V)); }
+XMFINLINE XMVECTOR XMVectorReciprocalSqrtEst(FXMVECTOR V) { return _mm_rsqrt_ps(V); }
+
+XMFINLINE XMVECTOR XMVectorFloor(FXMVECTOR V)
+{
+	XMVECTORF32 t; t.v = V;
+	return XMVectorSet(floorf(t.f[0]), floorf(t.f[1]), floorf(t.f[2]), floorf(t.f[3]));
+}
+
+XMFINLINE XMVECTOR XMVectorCeiling(FXMVECTOR V)
+{
+	XMVECTORF32 t; t.v = V;
+	return XMVectorSet(ceilf(t.f[0]), ceilf(t.f[1]), ceilf(t.f[2]), ceilf(t.f[3]));
+}
+
+XMFINLINE XMVECTOR XMVectorSaturate(FXMVECTOR V)
+{
+	return _mm_min_ps(_mm_max_ps(V, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+XMFINLINE XMVECTOR XMVectorScale(FXMVECTOR V, FLOAT ScaleFactor)
+{
+	return _mm_mul_ps(V, _mm_set1_ps(ScaleFactor));
+}
+
+XMFINLINE XMVECTOR XMVectorMultiplyAdd(FXMVECTOR V1, FXMVECTOR V2, FXMVECTOR V3)
+{
+#if defined(__FMA__)
+	return _mm_fmadd_ps(V1, V2, V3);
+#else
+	return _mm_add_ps(_mm_mul_ps(V1, V2), V3);
+#endif
+}
+
+XMFINLINE XMVECTOR XMVectorNegativeMultiplySubtract(FXMVECTOR V1, FXMVECTOR V2, FXMVECTOR V3)
+{
+#if defined(__FMA__)
+	return _mm_fnmadd_ps(V1, V2, V3);
+#else
+	return _mm_sub_ps(V3, _mm_mul_ps(V1, V2));
+#endif
+}
+#endif
+
+XMFINLINE XMVECTOR XMVectorClamp(FXMVECTOR V, FXMVECTOR Min, FXMVECTOR Max)
+{
+	XMASSERT(XMVector4LessOrEqual(Min, Max));
+	return XMVectorMin(XMVectorMax(V, Min), Max);
+}
+
+XMFINLINE XMVECTOR XMVectorLerp(FXMVECTOR V0, FXMVECTOR V1, FLOAT t)
+{
+	// V0 + t * (V1 - V0)
+	return XMVectorMultiplyAdd(XMVectorSubtract(V1, V0), XMVectorReplicate(t), V0);
+}
+
+XMFINLINE XMVECTOR XMVectorLerpV(FXMVECTOR V0, FXMVECTOR V1, FXMVECTOR T)
+{
+	return XMVectorMultiplyAdd(XMVectorSubtract(V1, V0), T, V0);
+}
+
+namespace XMPortable
+{
+	template<typename Fn>
+	XMFINLINE XMVECTOR Map(FXMVECTOR V, Fn fn)
+	{
+		XMVECTORF32 t; t.v = V;
+		return XMVectorSet(fn(t.f[0]), fn(t.f[1]), fn(t.f[2]), fn(t.f[3]));
+	}
+
+	XMFINLINE float Exp2(float x) { return exp2f(x); }
+	XMFINLINE float Log2(float x) { return log2f(x); }
+	XMFINLINE float Sin(float x) { return sinf(x); }
+	XMFINLINE float Cos(float x) { return cosf(x); }
+	XMFINLINE float ACos(float x) { return acosf(x < -1.0f ? -1.0f : (x > 1.0f ? 1.0f : x)); }
+}
+
+// The transcendental functions go through libm lane by lane.  xnamath uses
+// polynomial approximations, so results agree to a few ULP rather than exactly.
+XMFINLINE XMVECTOR XMVectorSin(FXMVECTOR V) { return XMPortable::Map(V, XMPortable::Sin); }
+XMFINLINE XMVECTOR XMVectorCos(FXMVECTOR V) { return XMPortable::Map(V, XMPortable::Cos); }
+XMFINLINE XMVECTOR XMVectorACos(FXMVECTOR V) { return XMPortable::Map(V, XMPortable::ACos); }
+XMFINLINE XMVECTOR XMVectorExp(FXMVECTOR V) { return XMPortable::Map(V, XMPortable::Exp2); }
+XMFINLINE XMVECTOR XMVectorLog(FXMVECTOR V) { return XMPortable::Map(V, XMPortable::Log2); }
+
+XMFINLINE XMVECTOR XMVectorPow(FXMVECTOR V1, FXMVECTOR V2)
+{
+	XMVECTORF32 a; a.v = V1;
+	XMVECTORF32 b; b.v = V2;
+	return XMVectorSet(powf(a.f[0], b.f[0]), powf(a.f[1], b.f[1]), powf(a.f[2], b.f[2]), powf(a.f[3], b.f[3]));
+}
+
+XMFINLINE VOID XMVectorSinCos(XMVECTOR* pSin, XMVECTOR* pCos, FXMVECTOR V)
+{
+	*pSin = XMVectorSin(V);
+	*pCos = XMVectorCos(V);
+}
+
+XMFINLINE VOID XMScalarSinCos(FLOAT* pSin, FLOAT* pCos, FLOAT Value)
+{
+	*pSin = sinf(Value);
+	*pCos = cosf(Value);
+}
+
+XMFINLINE FLOAT XMScalarACos(FLOAT Value)
+{
+	return XMPortable::ACos(Value);
+}
+
+#if defined(_XM_VECTOR_OPERATORS_)
+XMFINLINE XMVECTOR operator+ (FXMVECTOR V) { return V; }
+XMFINLINE XMVECTOR operator- (FXMVECTOR V) { return XMVectorNegate(V); }
+
+XMFINLINE XMVECTOR& operator+= (XMVECTOR& V1, FXMVECTOR V2) { V1 = XMVectorAdd(V1, V2); return V1; }
+XMFINLINE XMVECTOR& operator-= (XMVECTOR& V1, FXMVECTOR V2) { V1 = XMVectorSubtract(V1, V2); return V1; }
+XMFINLINE XMVECTOR& operator*= (XMVECTOR& V1, FXMVECTOR V2) { V1 = XMVectorMultiply(V1, V2); return V1; }
+XMFINLINE XMVECTOR& operator/= (XMVECTOR& V1, FXMVECTOR V2) { V1 = XMVectorDivide(V1, V2); return V1; }
+XMFINLINE XMVECTOR& operator*= (XMVECTOR& V, FLOAT S) { V = XMVectorScale(V, S); return V; }
+XMFINLINE XMVECTOR& operator/= (XMVECTOR& V, FLOAT S) { V = XMVectorScale(V, 1.0f / S); return V; }
+
+XMFINLINE XMVECTOR operator+ (FXMVECTOR V1, FXMVECTOR V2) { return XMVectorAdd(V1, V2); }
+XMFINLINE XMVECTOR operator- (FXMVECTOR V1, FXMVECTOR V2) { return XMVectorSubtract(V1, V2); }
+XMFINLINE XMVECTOR operator* (FXMVECTOR V1, FXMVECTOR V2) { return XMVectorMultiply(V1, V2); }
+XMFINLINE XMVECTOR operator/ (FXMVECTOR V1, FXMVECTOR V2) { return XMVectorDivide(V1, V2); }
+XMFINLINE XMVECTOR operator* (FXMVECTOR V, FLOAT S) { return XMVectorScale(V, S); }
+XMFINLINE XMVECTOR operator* (FLOAT S, FXMVECTOR V) { return XMVectorScale(V, S); }
+XMFINLINE XMVECTOR operator/ (FXMVECTOR V, FLOAT S) { return XMVectorScale(V, 1.0f / S); }
+#else
+// The native __m128 operators do not see through the XMVECTORF32 conversion.
+XMFINLINE XMVECTOR& operator+= (XMVECTOR& V1, const XMVECTORF32& V2) { V1 = XMVectorAdd(V1, V2.v); return V1; }
+XMFINLINE XMVECTOR& operator-= (XMVECTOR& V1, const XMVECTORF32& V2) { V1 = XMVectorSubtract(V1, V2.v); return V1; }
+XMFINLINE XMVECTOR& operator*= (XMVECTOR& V1, const XMVECTORF32& V2) { V1 = XMVectorMultiply(V1, V2.v); return V1; }
+XMFINLINE XMVECTOR operator+ (FXMVECTOR V1, const XMVECTORF32& V2) { return XMVectorAdd(V1, V2.v); }
+XMFINLINE XMVECTOR operator- (FXMVECTOR V1, const XMVECTORF32& V2) { return XMVectorSubtract(V1, V2.v); }
+XMFINLINE XMVECTOR operator* (FXMVECTOR V1, const XMVECTORF32& V2) { return XMVectorMultiply(V1, V2.v); }
+XMFINLINE XMVECTOR operator+ (const XMVECTORF32& V1, FXMVECTOR V2) { return XMVectorAdd(V1.v, V2); }
+XMFINLINE XMVECTOR operator- (const XMVECTORF32& V1, FXMVECTOR V2) { return XMVectorSubtract(V1.v, V2); }
+XMFINLINE XMVECTOR operator* (const XMVECTORF32& V1, FXMVECTOR V2) { return XMVectorMultiply(V1.v, V2); }
+#endif
+
+//---------------------------------------------------------------------------------------
+// 3D and 4D vector functions
+//---------------------------------------------------------------------------------------
+
+XMFINLINE XMVECTOR XMVector3Dot(FXMVECTOR V1, FXMVECTOR V2)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	return XMVectorReplicate(V1.vector4_f32[0] * V2.vector4_f32[0] + V1.vector4_f32[1] * V2.vector4_f32[1] + V1.vector4_f32[2] * V2.vector4_f32[2]);
+#else
+	XMVECTOR vDot = _mm_mul_ps(V1, V2);
+	XMVECTOR vTemp = _mm_shuffle_ps(vDot, vDot, _MM_SHUFFLE(2, 1, 2, 1));
+	vDot = _mm_add_ss(vDot, vTemp);
+	vTemp = _mm_shuffle_ps(vTemp, vTemp, _MM_SHUFFLE(1, 1, 1, 1));
+	vDot = _mm_add_ss(vDot, vTemp);
+	return _mm_shuffle_ps(vDot, vDot, _MM_SHUFFLE(0, 0, 0, 0));
+#endif
+}
+
+XMFINLINE XMVECTOR XMVector4Dot(FXMVECTOR V1, FXMVECTOR V2)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	return XMVectorReplicate(V1.vector4_f32[0] * V2.vector4_f32[0] + V1.vector4_f32[1] * V2.vector4_f32[1] +
+		V1.vector4_f32[2] * V2.vector4_f32[2] + V1.vector4_f32[3] * V2.vector4_f32[3]);
+#else
+	XMVECTOR vTemp = _mm_mul_ps(V1, V2);
+	XMVECTOR vShuf = _mm_shuffle_ps(vTemp, vTemp, _MM_SHUFFLE(2, 3, 0, 1));
+	vTemp = _mm_add_ps(vTemp, vShuf);
+	vShuf = _mm_shuffle_ps(vTemp, vTemp, _MM_SHUFFLE(0, 1, 2, 3));
+	return _mm_add_ps(vTemp, vShuf);
+#endif
+}
+
+XMFINLINE XMVECTOR XMVector3Cross(FXMVECTOR V1, FXMVECTOR V2)
+{
+#if defined(_XM_NO_INTRINSICS_)
+	return XMVectorSet(
+		(V1.vector4_f32[1] * V2.vector4_f32[2]) - (V1.vector4_f32[2] * V2.vector4_f32[1]),
+		(V1.vector4_f32[2] * V2.vector4_f32[0]) - (V1.vector4_f32[0] * V2.vector4_f32[2]),
+		(V1.vector4_f32[0] * V2.vector4_f32[1]) - (V1.vector4_f32[1] * V2.vector4_f32[0]),
+		0.0f);
+#else
+	XMVECTOR vTemp1 = _mm_shuffle_ps(V1, V1, _MM_SHUFFLE(3, 0, 2, 1));
+	XMVECTOR vTemp2 = _mm_shuffle_ps(V2, V2, _MM_SHUFFLE(3, 1, 0, 2));
+	XMVECTOR vResult = _mm_mul_ps(vTemp1, vTemp2);
+	vTemp1 = _mm_shuffle_ps(vTemp1, vTemp1, _MM_SHUFFLE(3, 0, 2, 1));
+	vTemp2 = _mm_shuffle_ps(vTemp2, vTemp2, _MM_SHUFFLE(3, 1, 0, 2));
+	vResult = _mm_sub_ps(vResult, _mm_mul_ps(vTemp1, vTemp2));
+	// Clear w.
+	return _mm_and_ps(vResult, XMPortable::FromU(0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0));
+#endif
+}
+
+XMFINLINE XMVECTOR XMVector3LengthSq(FXMVECTOR V) { return XMVector3Dot(V, V); }
+XMFINLINE XMVECTOR XMVector3Length(FXMVECTOR V) { return XMVectorSqrt(XMVector3Dot(V, V)); }
+XMFINLINE XMVECTOR XMVector3LengthEst(FXMVECTOR V) { return XMVector3Length(V); }
+XMFINLINE XMVECTOR XMVector3ReciprocalLength(FXMVECTOR V) { return XMVectorReciprocalSqrt(XMVector3Dot(V, V)); }
+XMFINLINE XMVECTOR XMVector4LengthSq(FXMVECTOR V) { return XMVector4Dot(V, V); }
+XMFINLINE XMVECTOR XMVector4Length(FXMVECTOR V) { return XMVectorSqrt(XMVector4Dot(V, V)); }
+
+XMFINLINE XMVECTOR XMVector3Normalize(FXMVECTOR V)
+{
+	// Matches the xnamath reference path: a zero vector normalizes to zero.
+	FLOAT fLength = XMVectorGetX(XMVector3Length(V));
+	if (fLength > 0.0f)
+		fLength = 1.0f / fLength;
+	return XMVectorScale(V, fLength);
+}
+
+XMFINLINE XMVECTOR XMVector3NormalizeEst(FXMVECTOR V)
+{
+	return XMVector3Normalize(V);
+}
+
+XMFINLINE XMVECTOR XMVector4Normalize(FXMVECTOR V)
+{
+	FLOAT fLength = XMVectorGetX(XMVector4Length(V));
+	if (fLength > 0.0f)
+		fLength = 1.0f / fLength;
+	return XMVectorScale(V, fLength);
+}
+
+XMFINLINE XMVECTOR XMVector3AngleBetweenVectors(FXMVECTOR V1, FXMVECTOR V2)
+{
+	XMVECTOR L1 = XMVector3ReciprocalLength(V1);
+	XMVECTOR L2 = XMVector3ReciprocalLength(V2);
+	XMVECTOR Dot = XMVector3Dot(V1, V2);
+	XMVECTOR CosAngle = XMVectorMultiply(Dot, XMVectorMultiply(L1, L2));
+	CosAngle = XMVectorClamp(CosAngle, XMVectorReplicate(-1.0f), XMVectorSplatOne());
+	return XMVectorACos(CosAngle);
+}
+
+XMFINLINE VOID XMVector3ComponentsFromNormal(XMVECTOR* pParallel, XMVECTOR* pPerpendicular, FXMVECTOR V, FXMVECTOR Normal)
+{
+	XMVECTOR Scale = XMVector3Dot(V, Normal);
+	XMVECTOR Parallel = XMVectorMultiply(Normal, Scale);
+	*pParallel = Parallel;
+	*pPerpendicular = XMVectorSubtract(V, Parallel);
+}
+
+XMFINLINE XMVECTOR XMVector3Transform(FXMVECTOR V, CXMMATRIX M)
+{
+	XMVECTOR Result = XMVectorMultiplyAdd(XMVectorSplatZ(V), M.r[2], M.r[3]);
+	Result = XMVectorMultiplyAdd(XMVectorSplatY(V), M.r[1], Result);
+	return XMVectorMultiplyAdd(XMVectorSplatX(V), M.r[0], Result);
+}
+
+XMFINLINE XMVECTOR XMVector3TransformCoord(FXMVECTOR V, CXMMATRIX M)
+{
+	XMVECTOR Result = XMVector3Transform(V, M);
+	return XMVectorDivide(Result, XMVectorSplatW(Result));
+}
+
+XMFINLINE XMVECTOR XMVector3TransformNormal(FXMVECTOR V, CXMMATRIX M)
+{
+	XMVECTOR Result = XMVectorMultiply(XMVectorSplatZ(V), M.r[2]);
+	Result = XMVectorMultiplyAdd(XMVectorSplatY(V), M.r[1], Result);
+	return XMVectorMultiplyAdd(XMVectorSplatX(V), M.r[0], Result);
+}
+
+XMFINLINE XMVECTOR XMVector4Transform(FXMVECTOR V, CXMMATRIX M)
+{
+	XMVECTOR Result = XMVectorMultiply(XMVectorSplatW(V), M.r[3]);
+	Result = XMVectorMultiplyAdd(XMVectorSplatZ(V), M.r[2], Result);
+	Result = XMVectorMultiplyAdd(XMVectorSplatY(V), M.r[1], Result);
+	return XMVectorMultiplyAdd(XMVectorSplatX(V), M.r[0], Result);
+}
+
+//---------------------------------------------------------------------------------------
+// Quaternion and plane functions
+//---------------------------------------------------------------------------------------
+
+XMFINLINE XMVECTOR XMQuaternionIdentity()
+{
+	return XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+XMFINLINE XMVECTOR XMQuaternionDot(FXMVECTOR Q1, FXMVECTOR Q2)
+{
+	return XMVector4Dot(Q1, Q2);
+}
+
+// Returns the product Q2*Q1, i.e. the rotation Q1 followed by Q2.
+XMFINLINE XMVECTOR XMQuaternionMultiply(FXMVECTOR Q1, FXMVECTOR Q2)
+{
+	XMVECTORF32 a; a.v = Q1;
+	XMVECTORF32 b; b.v = Q2;
+	return XMVectorSet(
+		(b.f[3] * a.f[0]) + (b.f[0] * a.f[3]) + (b.f[1] * a.f[2]) - (b.f[2] * a.f[1]),
+		(b.f[3] * a.f[1]) - (b.f[0] * a.f[2]) + (b.f[1] * a.f[3]) + (b.f[2] * a.f[0]),
+		(b.f[3] * a.f[2]) + (b.f[0] * a.f[1]) - (b.f[1] * a.f[0]) + (b.f[2] * a.f[3]),
+		(b.f[3] * a.f[3]) - (b.f[0] * a.f[0]) - (b.f[1] * a.f[1]) - (b.f[2] * a.f[2]));
+}
+
+XMFINLINE XMVECTOR XMQuaternionConjugate(FXMVECTOR Q)
+{
+	return XMVectorMultiply(Q, XMVectorSet(-1.0f, -1.0f, -1.0f, 1.0f));
+}
+
+XMFINLINE XMVECTOR XMQuaternionNormalize(FXMVECTOR Q)
+{
+	return XMVector4Normalize(Q);
+}
+
+XMFINLINE XMVECTOR XMQuaternionRotationNormal(FXMVECTOR NormalAxis, FLOAT Angle)
+{
+	FLOAT SinV, CosV;
+	XMScalarSinCos(&SinV, &CosV, 0.5f * Angle);
+	XMVECTOR N = XMVectorSelect(XMVectorSplatOne(), NormalAxis, XMVectorSelectControl(1, 1, 1, 0));
+	return XMVectorMultiply(N, XMVectorSet(SinV, SinV, SinV, CosV));
+}
+
+XMFINLINE XMVECTOR XMQuaternionRotationAxis(FXMVECTOR Axis, FLOAT Angle)
+{
+	XMASSERT(!XMVector3Equal(Axis, XMVectorZero()));
+	return XMQuaternionRotationNormal(XMVector3Normalize(Axis), Angle);
+}
+
+XMFINLINE XMVECTOR XMQuaternionSlerp(FXMVECTOR Q0, FXMVECTOR Q1, FLOAT t)
+{
+	const FLOAT OneMinusEpsilon = 1.0f - 0.00001f;
+
+	FLOAT CosOmega = XMVectorGetX(XMQuaternionDot(Q0, Q1));
+	FLOAT Sign = 1.0f;
+	if (CosOmega < 0.0f)
+	{
+		CosOmega = -CosOmega;
+		Sign = -1.0f;
+	}
+
+	FLOAT S0, S1;
+	if (CosOmega < OneMinusEpsilon)
+	{
+		FLOAT SinOmega = sqrtf(1.0f - CosOmega * CosOmega);
+		FLOAT Omega = atan2f(SinOmega, CosOmega);
+		FLOAT InvSinOmega = 1.0f / SinOmega;
+		S0 = sinf((1.0f - t) * Omega) * InvSinOmega;
+		S1 = sinf(t * Omega) * InvSinOmega;
+	}
+	else
+	{
+		S0 = 1.0f - t;
+		S1 = t;
+	}
+
+	return XMVectorMultiplyAdd(Q1, XMVectorReplicate(S1 * Sign), XMVectorScale(Q0, S0));
+}
+
+XMFINLINE XMVECTOR XMQuaternionRotationMatrix(CXMMATRIX M)
+{
+	FLOAT r22 = M.m[2][2];
+	FLOAT x, y, z, w;
+	if (r22 <= 0.0f)
+	{
+		FLOAT dif10 = M.m[1][1] - M.m[0][0];
+		FLOAT omr22 = 1.0f - r22;
+		if (dif10 <= 0.0f)
+		{
+			FLOAT fourXSqr = omr22 - dif10;
+			FLOAT inv4x = 0.5f / sqrtf(fourXSqr);
+			x = fourXSqr * inv4x;
+			y = (M.m[0][1] + M.m[1][0]) * inv4x;
+			z = (M.m[0][2] + M.m[2][0]) * inv4x;
+			w = (M.m[1][2] - M.m[2][1]) * inv4x;
+		}
+		else
+		{
+			FLOAT fourYSqr = omr22 + dif10;
+			FLOAT inv4y = 0.5f / sqrtf(fourYSqr);
+			x = (M.m[0][1] + M.m[1][0]) * inv4y;
+			y = fourYSqr * inv4y;
+			z = (M.m[1][2] + M.m[2][1]) * inv4y;
+			w = (M.m[2][0] - M.m[0][2]) * inv4y;
+		}
+	}
+	else
+	{
+		FLOAT sum10 = M.m[1][1] + M.m[0][0];
+		FLOAT opr22 = 1.0f + r22;
+		if (sum10 <= 0.0f)
+		{
+			FLOAT fourZSqr = opr22 - sum10;
+			FLOAT inv4z = 0.5f / sqrtf(fourZSqr);
+			x = (M.m[0][2] + M.m[2][0]) * inv4z;
+			y = (M.m[1][2] + M.m[2][1]) * inv4z;
+			z = fourZSqr * inv4z;
+			w = (M.m[0][1] - M.m[1][0]) * inv4z;
+		}
+		else
+		{
+			FLOAT fourWSqr = opr22 + sum10;
+			FLOAT inv4w = 0.5f / sqrtf(fourWSqr);
+			x = (M.m[1][2] - M.m[2][1]) * inv4w;
+			y = (M.m[2][0] - M.m[0][2]) * inv4w;
+			z = (M.m[0][1] - M.m[1][0]) * inv4w;
+			w = fourWSqr * inv4w;
+		}
+	}
+	return XMVectorSet(x, y, z, w);
+}
+
+// Rotates V by the unit quaternion Q.
+XMFINLINE XMVECTOR XMVector3Rotate(FXMVECTOR V, FXMVECTOR Q)
+{
+	XMVECTOR A = XMVectorSelect(XMVectorZero(), V, XMVectorSelectControl(1, 1, 1, 0));
+	XMVECTOR Result = XMQuaternionMultiply(XMQuaternionConjugate(Q), A);
+	return XMQuaternionMultiply(Result, Q);
+}
+
+XMFINLINE XMVECTOR XMVector3InverseRotate(FXMVECTOR V, FXMVECTOR Q)
+{
+	XMVECTOR A = XMVectorSelect(XMVectorZero(), V, XMVectorSelectControl(1, 1, 1, 0));
+	XMVECTOR Result = XMQuaternionMultiply(Q, A);
+	return XMQuaternionMultiply(Result, XMQuaternionConjugate(Q));
+}
+
+XMFINLINE XMVECTOR XMPlaneDot(FXMVECTOR P, FXMVECTOR V)
+{
+	return XMVector4Dot(P, V);
+}
+
+XMFINLINE XMVECTOR XMPlaneDotCoord(FXMVECTOR P, FXMVECTOR V)
+{
+	XMVECTOR V3 = XMVectorSelect(XMVectorSplatOne(), V, XMVectorSelectControl(1, 1, 1, 0));
+	return XMVector4Dot(P, V3);
+}
+
+XMFINLINE XMVECTOR XMPlaneDotNormal(FXMVECTOR P, FXMVECTOR V)
+{
+	return XMVector3Dot(P, V);
+}
+
+XMFINLINE XMVECTOR XMPlaneNormalize(FXMVECTOR P)
+{
+	FLOAT fLength = XMVectorGetX(XMVector3Length(P));
+	if (fLength > 0.0f)
+		fLength = 1.0f / fLength;
+	return XMVectorScale(P, fLength);
+}
+
+XMFINLINE XMVECTOR XMPlaneFromPointNormal(FXMVECTOR Point, FXMVECTOR Normal)
+{
+	XMVECTOR W = XMVectorNegate(XMVector3Dot(Point, Normal));
+	return XMVectorSelect(W, Normal, XMVectorSelectControl(1, 1, 1, 0));
+}
+
+//---------------------------------------------------------------------------------------
+// Matrix functions
+//---------------------------------------------------------------------------------------
+
+XMFINLINE XMMATRIX XMMatrixIdentity()
+{
+	return XMMATRIX(
+		XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f),
+		XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f),
+		XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f),
+		XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+XMFINLINE XMMATRIX XMMatrixMultiply(CXMMATRIX M1, CXMMATRIX M2)
+{
+	XMMATRIX Result;
+	for (UINT i = 0; i < 4; ++i)
+	{
+		XMVECTOR Row = M1.r[i];
+		XMVECTOR R = XMVectorMultiply(XMVectorSplatW(Row), M2.r[3]);
+		R = XMVectorMultiplyAdd(XMVectorSplatZ(Row), M2.r[2], R);
+		R = XMVectorMultiplyAdd(XMVectorSplatY(Row), M2.r[1], R);
+		Result.r[i] = XMVectorMultiplyAdd(XMVectorSplatX(Row), M2.r[0], R);
+	}
+	return Result;
+}
+
+XMFINLINE XMMATRIX XMMatrixTranspose(CXMMATRIX M)
+{
+	XMMATRIX Result;
+#if defined(_XM_NO_INTRINSICS_)
+	for (UINT i = 0; i < 4; ++i)
+		for (UINT j = 0; j < 4; ++j)
+			Result.m[i][j] = M.m[j][i];
+#else
+	Result = M;
+	_MM_TRANSPOSE4_PS(Result.r[0], Result.r[1], Result.r[2], Result.r[3]);
+#endif
+	return Result;
+}
+
+XMFINLINE XMMATRIX XMMatrixMultiplyTranspose(CXMMATRIX M1, CXMMATRIX M2)
+{
+	return XMMatrixTranspose(XMMatrixMultiply(M1, M2));
+}
+
+namespace XMPortable
+{
+	// 2x2 sub-determinants of the bottom two rows, shared by the determinant and
+	// the inverse (Laplace expansion along the top two rows).
+	struct Cofactors
+	{
+		FLOAT a[16];
+		FLOAT det;
+	};
+
+	XMFINLINE Cofactors Cofactor(CXMMATRIX M)
+	{
+		const FLOAT (*m)[4] = M.m;
+		FLOAT s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+		FLOAT s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+		FLOAT s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+		FLOAT s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+		FLOAT s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+		FLOAT s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+		FLOAT c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+		FLOAT c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+		FLOAT c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+		FLOAT c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+		FLOAT c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+		FLOAT c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+
+		Cofactors r;
+		r.det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+
+		// Adjugate (transposed cofactor matrix), row-major.
+		r.a[0]  = ( m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3);
+		r.a[1]  = (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3);
+		r.a[2]  = ( m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3);
+		r.a[3]  = (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3);
+
+		r.a[4]  = (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1);
+		r.a[5]  = ( m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1);
+		r.a[6]  = (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1);
+		r.a[7]  = ( m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1);
+
+		r.a[8]  = ( m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0);
+		r.a[9]  = (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0);
+		r.a[10] = ( m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0);
+		r.a[11] = (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0);
+
+		r.a[12] = (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0);
+		r.a[13] = ( m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0);
+		r.a[14] = (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0);
+		r.a[15] = ( m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0);
+		return r;
+	}
+}
+
+XMFINLINE XMVECTOR XMMatrixDeterminant(CXMMATRIX M)
+{
+	return XMVectorReplicate(XMPortable::Cofactor(M).det);
+}
+
+XMFINLINE XMMATRIX XMMatrixInverse(XMVECTOR* pDeterminant, CXMMATRIX M)
+{
+	XMPortable::Cofactors c = XMPortable::Cofactor(M);
+	if (pDeterminant)
+		*pDeterminant = XMVectorReplicate(c.det);
+
+	XMVECTOR Reciprocal = XMVectorReplicate(1.0f / c.det);
+	XMMATRIX Result(c.a);
+	Result.r[0] = XMVectorMultiply(Result.r[0], Reciprocal);
+	Result.r[1] = XMVectorMultiply(Result.r[1], Reciprocal);
+	Result.r[2] = XMVectorMultiply(Result.r[2], Reciprocal);
+	Result.r[3] = XMVectorMultiply(Result.r[3], Reciprocal);
+	return Result;
+}
+
+XMFINLINE BOOL XMMatrixDecompose(XMVECTOR* pOutScale, XMVECTOR* pOutRotQuat, XMVECTOR* pOutTrans, CXMMATRIX M)
+{
+	// The scale is the length of each basis row; a mirrored basis gets a negative x
+	// scale so that what remains is a rotation.
+	FLOAT Scale[3] = {
+		XMVectorGetX(XMVector3Length(M.r[0])),
+		XMVectorGetX(XMVector3Length(M.r[1])),
+		XMVectorGetX(XMVector3Length(M.r[2])) };
+
+	if (XMVectorGetX(XMVector3Dot(XMVector3Cross(M.r[0], M.r[1]), M.r[2])) < 0.0f)
+		Scale[0] = -Scale[0];
+
+	*pOutScale = XMVectorSet(Scale[0], Scale[1], Scale[2], 0.0f);
+	*pOutTrans = M.r[3];
+
+	if (fabsf(Scale[0]) < 1.0e-6f || fabsf(Scale[1]) < 1.0e-6f || fabsf(Scale[2]) < 1.0e-6f)
+	{
+		*pOutRotQuat = XMQuaternionIdentity();
+		return FALSE;
+	}
+
+	XMMATRIX R(
+		XMVectorScale(M.r[0], 1.0f / Scale[0]),
+		XMVectorScale(M.r[1], 1.0f / Scale[1]),
+		XMVectorScale(M.r[2], 1.0f / Scale[2]),
+		XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+	*pOutRotQuat = XMQuaternionRotationMatrix(R);
+	return TRUE;
+}
+
+XMFINLINE XMMATRIX XMMatrixTranslation(FLOAT OffsetX, FLOAT OffsetY, FLOAT OffsetZ)
+{
+	XMMATRIX M = XMMatrixIdentity();
+	M.r[3] = XMVectorSet(OffsetX, OffsetY, OffsetZ, 1.0f);
+	return M;
+}
+
+XMFINLINE XMMATRIX XMMatrixTranslationFromVector(FXMVECTOR Offset)
+{
+	XMMATRIX M = XMMatrixIdentity();
+	M.r[3] = XMVectorSelect(M.r[3], Offset, XMVectorSelectControl(1, 1, 1, 0));
+	return M;
+}
+
+XMFINLINE XMMATRIX XMMatrixScaling(FLOAT ScaleX, FLOAT ScaleY, FLOAT ScaleZ)
+{
+	return XMMATRIX(
+		XMVectorSet(ScaleX, 0.0f, 0.0f, 0.0f),
+		XMVectorSet(0.0f, ScaleY, 0.0f, 0.0f),
+		XMVectorSet(0.0f, 0.0f, ScaleZ, 0.0f),
+		XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+XMFINLINE XMMATRIX XMMatrixScalingFromVector(FXMVECTOR Scale)
+{
+	return XMMatrixScaling(XMVectorGetX(Scale), XMVectorGetY(Scale), XMVectorGetZ(Scale));
+}
+
+XMFINLINE XMMATRIX XMMatrixRotationX(FLOAT Angle)
+{
+	FLOAT s, c;
+	XMScalarSinCos(&s, &c, Angle);
+	return XMMATRIX(
+		XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f),
+		XMVectorSet(0.0f, c, s, 0.0f),
+		XMVectorSet(0.0f, -s, c, 0.0f),
+		XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+XMFINLINE XMMATRIX XMMatrixRotationY(FLOAT Angle)
+{
+	FLOAT s, c;
+	XMScalarSinCos(&s, &c, Angle);
+	return XMMATRIX(
+		XMVectorSet(c, 0.0f, -s, 0.0f),
+		XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f),
+		XMVectorSet(s, 0.0f, c, 0.0f),
+		XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+XMFINLINE XMMATRIX XMMatrixRotationZ(FLOAT Angle)
+{
+	FLOAT s, c;
+	XMScalarSinCos(&s, &c, Angle);
+	return XMMATRIX(
+		XMVectorSet(c, s, 0.0f, 0.0f),
+		XMVectorSet(-s, c, 0.0f, 0.0f),
+		XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f),
+		XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+XMFINLINE XMMATRIX XMMatrixRotationNormal(FXMVECTOR NormalAxis, FLOAT Angle)
+{
+	FLOAT s, c;
+	XMScalarSinCos(&s, &c, Angle);
+	FLOAT t = 1.0f - c;
+	FLOAT x = XMVectorGetX(NormalAxis);
+	FLOAT y = XMVectorGetY(NormalAxis);
+	FLOAT z = XMVectorGetZ(NormalAxis);
+	return XMMATRIX(
+		XMVectorSet(t * x * x + c,     t * x * y + s * z, t * x * z - s * y, 0.0f),
+		XMVectorSet(t * x * y - s * z, t * y * y + c,     t * y * z + s * x, 0.0f),
+		XMVectorSet(t * x * z + s * y, t * y * z - s * x, t * z * z + c,     0.0f),
+		XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+XMFINLINE XMMATRIX XMMatrixRotationAxis(FXMVECTOR Axis, FLOAT Angle)
+{
+	XMASSERT(!XMVector3Equal(Axis, XMVectorZero()));
+	return XMMatrixRotationNormal(XMVector3Normalize(Axis), Angle);
+}
+
+XMFINLINE XMMATRIX XMMatrixRotationQuaternion(FXMVECTOR Quaternion)
+{
+	FLOAT x = XMVectorGetX(Quaternion);
+	FLOAT y = XMVectorGetY(Quaternion);
+	FLOAT z = XMVectorGetZ(Quaternion);
+	FLOAT w = XMVectorGetW(Quaternion);
+	FLOAT xx = x * x, yy = y * y, zz = z * z;
+	FLOAT xy = x * y, xz = x * z, yz = y * z;
+	FLOAT wx = w * x, wy = w * y, wz = w * z;
+	return XMMATRIX(
+		XMVectorSet(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f),
+		XMVectorSet(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f),
+		XMVectorSet(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f),
+		XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+XMFINLINE XMMATRIX XMMatrixAffineTransformation(FXMVECTOR Scaling, FXMVECTOR RotationOrigin,
+	FXMVECTOR RotationQuaternion, CXMVECTOR Translation)
+{
+	// M = MScaling * Inverse(MRotationOrigin) * MRotation * MRotationOrigin * MTranslation;
+	XMVECTOR Select1110 = XMVectorSelectControl(1, 1, 1, 0);
+	XMVECTOR VRotationOrigin = XMVectorSelect(XMVectorZero(), RotationOrigin, Select1110);
+	XMVECTOR VTranslation = XMVectorSelect(XMVectorZero(), Translation, Select1110);
+
+	XMMATRIX M = XMMatrixScalingFromVector(Scaling);
+	M.r[3] = XMVectorSubtract(M.r[3], VRotationOrigin);
+	M = XMMatrixMultiply(M, XMMatrixRotationQuaternion(RotationQuaternion));
+	M.r[3] = XMVectorAdd(M.r[3], VRotationOrigin);
+	M.r[3] = XMVectorAdd(M.r[3], VTranslation);
+	return M;
+}
+
+XMFINLINE XMMATRIX XMMatrixLookToLH(FXMVECTOR EyePosition, FXMVECTOR EyeDirection, FXMVECTOR UpDirection)
+{
+	XMVECTOR R2 = XMVector3Normalize(EyeDirection);
+	XMVECTOR R0 = XMVector3Normalize(XMVector3Cross(UpDirection, R2));
+	XMVECTOR R1 = XMVector3Cross(R2, R0);
+	XMVECTOR NegEyePosition = XMVectorNegate(EyePosition);
+
+	XMVECTOR Select1110 = XMVectorSelectControl(1, 1, 1, 0);
+	XMMATRIX M(
+		XMVectorSelect(XMVector3Dot(R0, NegEyePosition), R0, Select1110),
+		XMVectorSelect(XMVector3Dot(R1, NegEyePosition), R1, Select1110),
+		XMVectorSelect(XMVector3Dot(R2, NegEyePosition), R2, Select1110),
+		XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+	return XMMatrixTranspose(M);
+}
+
+XMFINLINE XMMATRIX XMMatrixLookAtLH(FXMVECTOR EyePosition, FXMVECTOR FocusPosition, FXMVECTOR UpDirection)
+{
+	return XMMatrixLookToLH(EyePosition, XMVectorSubtract(FocusPosition, EyePosition), UpDirection);
+}
+
+XMFINLINE XMMATRIX XMMatrixPerspectiveFovLH(FLOAT FovAngleY, FLOAT AspectHByW, FLOAT NearZ, FLOAT FarZ)
+{
+	FLOAT SinFov, CosFov;
+	XMScalarSinCos(&SinFov, &CosFov, 0.5f * FovAngleY);
+	FLOAT Height = CosFov / SinFov;
+	FLOAT Width = Height / AspectHByW;
+	FLOAT fRange = FarZ / (FarZ - NearZ);
+	return XMMATRIX(
+		XMVectorSet(Width, 0.0f, 0.0f, 0.0f),
+		XMVectorSet(0.0f, Height, 0.0f, 0.0f),
+		XMVectorSet(0.0f, 0.0f, fRange, 1.0f),
+		XMVectorSet(0.0f, 0.0f, -fRange * NearZ, 0.0f));
+}
+
+XMFINLINE XMMATRIX XMMatrixOrthographicLH(FLOAT ViewWidth, FLOAT ViewHeight, FLOAT NearZ, FLOAT FarZ)
+{
+	FLOAT fRange = 1.0f / (FarZ - NearZ);
+	return XMMATRIX(
+		XMVectorSet(2.0f / ViewWidth, 0.0f, 0.0f, 0.0f),
+		XMVectorSet(0.0f, 2.0f / ViewHeight, 0.0f, 0.0f),
+		XMVectorSet(0.0f, 0.0f, fRange, 0.0f),
+		XMVectorSet(0.0f, 0.0f, -fRange * NearZ, 1.0f));
+}
+
+XMFINLINE XMMATRIX XMMatrixOrthographicOffCenterLH(FLOAT ViewLeft, FLOAT ViewRight, FLOAT ViewBottom,
+	FLOAT ViewTop, FLOAT NearZ, FLOAT FarZ)
+{
+	FLOAT ReciprocalWidth = 1.0f / (ViewRight - ViewLeft);
+	FLOAT ReciprocalHeight = 1.0f / (ViewTop - ViewBottom);
+	FLOAT fRange = 1.0f / (FarZ - NearZ);
+	return XMMATRIX(
+		XMVectorSet(ReciprocalWidth + ReciprocalWidth, 0.0f, 0.0f, 0.0f),
+		XMVectorSet(0.0f, ReciprocalHeight + ReciprocalHeight, 0.0f, 0.0f),
+		XMVectorSet(0.0f, 0.0f, fRange, 0.0f),
+		XMVectorSet(-(ViewLeft + ViewRight) * ReciprocalWidth, -(ViewTop + ViewBottom) * ReciprocalHeight,
+			-fRange * NearZ, 1.0f));
+}
+
+XMFINLINE XMMATRIX XMMatrixReflect(FXMVECTOR ReflectionPlane)
+{
+	XMVECTOR P = XMPlaneNormalize(ReflectionPlane);
+	XMVECTOR S = XMVectorScale(P, -2.0f);
+	return XMMATRIX(
+		XMVectorMultiplyAdd(XMVectorSplatX(P), S, XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f)),
+		XMVectorMultiplyAdd(XMVectorSplatY(P), S, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)),
+		XMVectorMultiplyAdd(XMVectorSplatZ(P), S, XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f)),
+		XMVectorMultiplyAdd(XMVectorSplatW(P), S, XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+XMFINLINE XMMATRIX XMMatrixShadow(FXMVECTOR ShadowPlane, FXMVECTOR LightPosition)
+{
+	XMVECTOR P = XMPlaneNormalize(ShadowPlane);
+	FLOAT Dot = XMVectorGetX(XMPlaneDot(P, LightPosition));
+	P = XMVectorNegate(P);
+	return XMMATRIX(
+		XMVectorMultiplyAdd(XMVectorSplatX(P), LightPosition, XMVectorSet(Dot, 0.0f, 0.0f, 0.0f)),
+		XMVectorMultiplyAdd(XMVectorSplatY(P), LightPosition, XMVectorSet(0.0f, Dot, 0.0f, 0.0f)),
+		XMVectorMultiplyAdd(XMVectorSplatZ(P), LightPosition, XMVectorSet(0.0f, 0.0f, Dot, 0.0f)),
+		XMVectorMultiplyAdd(XMVectorSplatW(P), LightPosition, XMVectorSet(0.0f, 0.0f, 0.0f, Dot)));
+}
+
+XMFINLINE XMMATRIX& XMMATRIX::operator*= (CXMMATRIX M)
+{
+	*this = XMMatrixMultiply(*this, M);
+	return *this;
+}
+
+XMFINLINE XMMATRIX XMMATRIX::operator* (CXMMATRIX M) const
+{
+	return XMMatrixMultiply(*this, M);
+}
+
+#endif // _WIN32 && !XM_PORTABLE
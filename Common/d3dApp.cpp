@@ -3,6 +3,7 @@
 //***************************************************************************************
 
 #include "d3dApp.h"
+#include "Profiler.h"
 #include <WindowsX.h>
 #include <sstream>
 
@@ -107,8 +108,15 @@ int D3DApp::Run()
 			if( !mAppPaused )
 			{
 				CalculateFrameStats();
-				UpdateScene(mTimer.DeltaTime());	
-				DrawScene();
+				{
+					PROFILE_ZONE("UpdateScene");
+					UpdateScene(mTimer.DeltaTime());
+				}
+				{
+					PROFILE_ZONE("DrawScene");
+					DrawScene();
+				}
+				PROFILE_END_FRAME();
 			}
 			else
 			{
@@ -224,11 +232,18 @@ void D3DApp::UpdateScene(float dt)
 		// Reset for next average.
 		frameCnt = 0;
 		timeElapsed += 1.0f;
+
+		// The average hides hitches; show the tail of the recent frame times too.
+		GameTimer::FrameTimeStats stats = mTimer.GetFrameTimeStats();
+
 		std::wostringstream outs;
 		outs.precision(6);
 		outs << mMainWndCaption << L"    "
 			<< L"FPS: " << fps << L"    "
-			<< L"Frame Time: " << mspf << L" (ms)";
+			<< L"Frame Time: " << mspf << L" (ms)    "
+			<< L"p50/p95/p99/max: " << stats.P50Ms << L"/" << stats.P95Ms << L"/"
+			<< stats.P99Ms << L"/" << stats.MaxMs << L" (ms)    "
+			<< L"Stutters: " << stats.StutterCount;
 		SetWindowText(mhMainWnd, outs.str().c_str());
 	}
 }
@@ -356,6 +371,22 @@ LRESULT D3DApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	case WM_MOUSEMOVE:
 		OnMouseMove(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
+
+	// F11 writes the CPU zones of the next 60 frames to profile.json, which
+	// chrome://tracing can open.
+	case WM_KEYDOWN:
+		if( wParam == VK_F11 )
+		{
+			PROFILE_CAPTURE(60, "profile.json");
+			return 0;
+		}
+		// F9 writes the recent frame times to frametimes.csv.
+		if( wParam == VK_F9 )
+		{
+			mTimer.WriteFrameTimesCsv("frametimes.csv");
+			return 0;
+		}
+		break;
 	}
 
 	return DefWindowProc(hwnd, msg, wParam, lParam);
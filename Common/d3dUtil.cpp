@@ -3,8 +3,100 @@
 //***************************************************************************************
 
 #include "d3dUtil.h"
+#include "DDSTexture.h"
+#include "ParallelFor.h"
 #include <comdef.h>
 
+namespace
+{
+	//
+	// Builds the array straight from the DDS files when they can be copied as they
+	// are: the files are read in parallel and the texture is created with its data,
+	// with no staging textures in between.  Returns null when any file needs
+	// D3DX, or the elements differ in size, format or mip count.
+	//
+	ID3D11ShaderResourceView* CreateTexture2DArraySRVFromDDS(
+		ID3D11Device* device, const std::vector<std::wstring>& filenames)
+	{
+		UINT size = (UINT)filenames.size();
+
+		std::vector<std::vector<char>> files(size);
+		std::vector<DDSInfo> infos(size);
+		std::vector<char> parsed(size, 0);
+
+		Parallel::For(size, 0, [&](UINT i)
+		{
+			std::ifstream fin(filenames[i].c_str(), std::ios::binary | std::ios::ate);
+			if( !fin )
+				return;
+
+			files[i].resize((size_t)fin.tellg());
+			fin.seekg(0, std::ios::beg);
+			fin.read(files[i].data(), files[i].size());
+
+			parsed[i] = fin && DDS::ParseHeader(files[i].data(),
+				(UINT)std::min<size_t>(files[i].size(), DDS::MaxHeaderSize), files[i].size(), infos[i]);
+		});
+
+		for(UINT i = 0; i < size; ++i)
+		{
+			if( !parsed[i] || infos[i].ArraySize != 1 ||
+				infos[i].Width != infos[0].Width || infos[i].Height != infos[0].Height ||
+				infos[i].MipLevels != infos[0].MipLevels || infos[i].Format != infos[0].Format )
+			{
+				return 0;
+			}
+		}
+
+		const DDSInfo& element = infos[0];
+
+		std::vector<D3D11_SUBRESOURCE_DATA> initData(size * element.MipLevels);
+		for(UINT texElement = 0; texElement < size; ++texElement)
+		{
+			for(UINT mipLevel = 0; mipLevel < element.MipLevels; ++mipLevel)
+			{
+				const DDSSubresource& sub = infos[texElement].Get(mipLevel, 0);
+
+				D3D11_SUBRESOURCE_DATA& data = initData[D3D11CalcSubresource(mipLevel, texElement, element.MipLevels)];
+				data.pSysMem          = files[texElement].data() + sub.Offset;
+				data.SysMemPitch      = sub.RowPitch;
+				data.SysMemSlicePitch = sub.SlicePitch;
+			}
+		}
+
+		D3D11_TEXTURE2D_DESC texArrayDesc;
+		texArrayDesc.Width              = element.Width;
+		texArrayDesc.Height             = element.Height;
+		texArrayDesc.MipLevels          = element.MipLevels;
+		texArrayDesc.ArraySize          = size;
+		texArrayDesc.Format             = (DXGI_FORMAT)element.Format;
+		texArrayDesc.SampleDesc.Count   = 1;
+		texArrayDesc.SampleDesc.Quality = 0;
+		texArrayDesc.Usage              = D3D11_USAGE_IMMUTABLE;
+		texArrayDesc.BindFlags          = D3D11_BIND_SHADER_RESOURCE;
+		texArrayDesc.CPUAccessFlags     = 0;
+		texArrayDesc.MiscFlags          = 0;
+
+		ID3D11Texture2D* texArray = 0;
+		HR(device->CreateTexture2D(&texArrayDesc, &initData[0], &texArray));
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+		viewDesc.Format = texArrayDesc.Format;
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		viewDesc.Texture2DArray.MostDetailedMip = 0;
+		viewDesc.Texture2DArray.MipLevels = texArrayDesc.MipLevels;
+		viewDesc.Texture2DArray.FirstArraySlice = 0;
+		viewDesc.Texture2DArray.ArraySize = size;
+
+		ID3D11ShaderResourceView* texArraySRV = 0;
+		HR(device->CreateShaderResourceView(texArray, &viewDesc, &texArraySRV));
+
+		ReleaseCOM(texArray);
+
+		return texArraySRV;
+	}
+}
+
 ID3D11ShaderResourceView* d3dHelper::CreateTexture2DArraySRV(
 		ID3D11Device* device, ID3D11DeviceContext* context,
 		std::vector<std::wstring>& filenames,
@@ -12,6 +104,14 @@ ID3D11ShaderResourceView* d3dHelper::CreateTexture2DArraySRV(
 		UINT filter, 
 		UINT mipFilter)
 {
+	// D3DX is only needed to convert the files to another format.
+	if( format == DXGI_FORMAT_FROM_FILE )
+	{
+		ID3D11ShaderResourceView* srv = CreateTexture2DArraySRVFromDDS(device, filenames);
+		if( srv )
+			return srv;
+	}
+
 	//
 	// Load the texture elements individually from file.  These textures
 	// won't be used by the GPU (0 bind flags), they are just used to 
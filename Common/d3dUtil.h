@@ -112,8 +112,9 @@ class d3dHelper
 {
 public:
 	///<summary>
-	/// 
-	/// Does not work with compressed formats.
+	/// Loads the files as the elements of one texture array.  DDS files that need
+	/// no conversion are copied straight in; otherwise they go through D3DX and
+	/// staging textures, which does not work with compressed formats.
 	///</summary>
 	static ID3D11ShaderResourceView* CreateTexture2DArraySRV(
 		ID3D11Device* device, ID3D11DeviceContext* context,
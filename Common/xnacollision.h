@@ -12,7 +12,7 @@
 #ifndef _XNA_COLLISION_H_
 #define _XNA_COLLISION_H_
 
-#include <xnamath.h>
+#include "XnaMathPortable.h"
 
 namespace XNA
 {
@@ -50,6 +50,16 @@ static float g_fMaxScreenHeight = 1600.0f;
 // Textures
 Texture2D g_txDiffuse : register( t0 );
 
+#ifdef USE_CPU_PATCH_FACTORS
+// Per-patch tessellation factors from the CPU pre-pass ( x, y, z=Edges, w=Inside )
+Buffer<float4> g_PatchFactors : register( t1 );
+
+cbuffer cbPatchFactors : register( b1 )
+{
+    uint4       g_u4PatchFactorOffset;      // x=First factor of the draw
+}
+#endif
+
 // Samplers
 SamplerState g_SamplePoint  : register( s0 );
 SamplerState g_SampleLinear : register( s1 );
@@ -243,16 +253,25 @@ HS_RenderSceneInput VS_RenderSceneWithTessellation( VS_RenderSceneInput I )
 // This hull shader passes the tessellation factors through to the HW tessellator, 
 // and the 10 (geometry), 6 (normal) control points of the PN-triangular patch to the domain shader
 //--------------------------------------------------------------------------------------
-HS_ConstantOutput HS_ConstantFlat( const OutputPatch<HS_ControlPointOutput, 3> I )
+HS_ConstantOutput HS_ConstantFlat( const OutputPatch<HS_ControlPointOutput, 3> I, uint uPatchID : SV_PrimitiveID )
 {
     HS_ConstantOutput O = (HS_ConstantOutput)0;
 
+#ifdef USE_CPU_PATCH_FACTORS
+	// The pre-pass has computed the factors and left out the culled patches
+	float4 f4Factors = g_PatchFactors.Load( g_u4PatchFactorOffset.x + uPatchID );
+	O.fTessFactor[0] = f4Factors.x;
+	O.fTessFactor[1] = f4Factors.y;
+	O.fTessFactor[2] = f4Factors.z;
+	O.fInsideTessFactor = f4Factors.w;
+#else
 	O.fTessFactor[0] = I[1].fOppositeEdgeLOD;
 	O.fTessFactor[1] = I[2].fOppositeEdgeLOD;
 	O.fTessFactor[2] = I[0].fOppositeEdgeLOD;
 
     // Inside tess factor is just the average of the edge factors
     O.fInsideTessFactor = max( max( O.fTessFactor[0], O.fTessFactor[1]), O.fTessFactor[2] );
+#endif
 
 	if (I[0].fClipped && I[1].fClipped && I[2].fClipped) 
 	{ 
@@ -280,7 +299,7 @@ HS_ControlPointOutput HS_FlatTriangles(
     O.f3Normal = I[uCPID].f3Normal;
     O.f2TexCoord = I[uCPID].f2TexCoord;
 
-#ifdef USE_SCREEN_SPACE_ADAPTIVE_TESSELLATION
+#if defined( USE_SCREEN_SPACE_ADAPTIVE_TESSELLATION ) && !defined( USE_CPU_PATCH_FACTORS )
 	O.fOppositeEdgeLOD = ComputeEdgeLOD(g_f4x4Projection,
 		O.f3Position,
 		I[NextCPID].f3Position);
@@ -288,7 +307,7 @@ HS_ControlPointOutput HS_FlatTriangles(
 	O.fOppositeEdgeLOD = g_f4TessFactors.x;
 #endif
 
-#ifdef USE_VIEW_FRUSTUM_CULLING
+#if defined( USE_VIEW_FRUSTUM_CULLING ) && !defined( USE_CPU_PATCH_FACTORS )
 	O.fClipped = ComputeClipping( g_f4x4Projection, O.f3Position );
 #else
 	O.fClipped = 0.0f;
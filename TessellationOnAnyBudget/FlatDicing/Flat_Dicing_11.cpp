@@ -19,6 +19,8 @@
 #include <D3DX11.h>
 #include <D3DX11core.h>
 #include <D3DX11async.h>
+#include <vector>
+#include "../../Common/PatchCuller.h"
 
 // The different meshes
 typedef enum _MESH_TYPE
@@ -112,6 +114,25 @@ static float g_fResolutionScale = 1.0f;
 // View frustum culling epsilon
 static float g_fViewFrustumCullEpsilon = 0.5f;
 
+// CPU pre-pass: per-patch tessellation factors and culling ahead of the draw
+static PatchCuller g_PatchCuller;
+static std::vector<UINT> g_PatchIndices;                // Patches left to tessellate, all subsets of a mesh
+static std::vector<XMFLOAT4> g_PatchFactors;            // Their factors ( x, y, z=Edges, w=Inside )
+static std::vector<UINT> g_FlatIndices;                 // Patches at factor 1, drawn as plain triangles
+static ID3D11Buffer* g_pPatchIB = NULL;
+static ID3D11Buffer* g_pFlatIB = NULL;
+static ID3D11Buffer* g_pPatchFactorBuffer = NULL;
+static ID3D11ShaderResourceView* g_pPatchFactorSRV = NULL;
+static UINT g_uPrePassCapacity = 0;                     // Patches the pre-pass buffers hold
+static UINT g_uPrePassStats[3] = { 0, 0, 0 };           // Tessellated, flat and culled patches this frame
+
+// Constant buffer layout for the patch factors of one draw
+struct CB_PATCH_FACTORS
+{
+    UINT uPatchFactorOffset[4];         // x=First factor of the draw
+};
+static ID3D11Buffer*    g_pcbPatchFactors = NULL;
+
 // Cmd line params
 typedef struct _CmdLineParams
 {
@@ -163,6 +184,7 @@ static CmdLineParams g_CmdLineParams;
 #define IDC_STATIC_RENDER_SETTINGS              30
 #define IDC_STATIC_VIEW_FRUSTUM_CULL_EPSILON    31
 #define IDC_SLIDER_VIEW_FRUSTUM_CULL_EPSILON    32
+#define IDC_CHECKBOX_CPU_PREPASS                33
 
 
 //--------------------------------------------------------------------------------------
@@ -202,6 +224,8 @@ void RenderMesh( CDXUTSDKMesh* pDXUTMesh, UINT uMesh,
                  UINT uSpecularSlot = INVALID_SAMPLER_SLOT );
 bool FileExists( WCHAR* pFileName );
 HRESULT CreateHullShader();
+void RenderMeshWithPrePass( CDXUTSDKMesh* pDXUTMesh, UINT uMesh, const PatchCuller::Settings& Settings, UINT uDiffuseSlot );
+HRESULT ReservePrePassBuffers( UINT uPatchCount );
 void NormalizePlane( D3DXVECTOR4* pPlaneEquation );
 void ExtractPlanesFromFrustum( D3DXVECTOR4* pPlaneEquation, const D3DXMATRIX* pMatrix );
 
@@ -304,6 +328,9 @@ void InitApp()
     swprintf_s( szTemp, L"%.2f", g_fViewFrustumCullEpsilon );
     g_SampleUI.AddStatic( IDC_STATIC_VIEW_FRUSTUM_CULL_EPSILON, szTemp, 140, iY += 25, 108, 24 );
     g_SampleUI.AddSlider( IDC_SLIDER_VIEW_FRUSTUM_CULL_EPSILON, 0, iY, 120, 24, 0, 100, (unsigned int)( g_fViewFrustumCullEpsilon * 100.0f ), false );
+
+    // CPU pre-pass: factors and culling on the CPU, compacted patch list for the GPU
+    g_SampleUI.AddCheckBox( IDC_CHECKBOX_CPU_PREPASS, L"CPU Pre-pass", 0, iY += 30, 140, 24, false );
         
     // Adaptive Techniques
     g_SampleUI.AddStatic( IDC_STATIC_ADAPTIVE_TECHNIQUES, L"-Adaptive Techniques-", 5, iY += 50, 108, 24 );
@@ -388,6 +415,15 @@ void RenderText()
     g_pTxtHelper->DrawTextLine( DXUTGetFrameStats( DXUTIsVsyncEnabled() ) );
     g_pTxtHelper->DrawTextLine( DXUTGetDeviceStats() );
 
+    if( g_SampleUI.GetCheckBox( IDC_CHECKBOX_TESSELLATION )->GetChecked() &&
+        g_SampleUI.GetCheckBox( IDC_CHECKBOX_CPU_PREPASS )->GetChecked() )
+    {
+        WCHAR szStats[128];
+        swprintf_s( szStats, L"CPU pre-pass: %u tessellated, %u flat, %u culled", 
+            g_uPrePassStats[0], g_uPrePassStats[1], g_uPrePassStats[2] );
+        g_pTxtHelper->DrawTextLine( szStats );
+    }
+
     g_pTxtHelper->SetInsertionPos( 2, DXUTGetDXGIBackBufferSurfaceDesc()->Height - 35 );
     g_pTxtHelper->DrawTextLine( L"Toggle GUI    : G" );
     g_pTxtHelper->DrawTextLine( L"Frame Capture : C" );
@@ -503,10 +539,12 @@ void CALLBACK OnGUIEvent( UINT nEvent, int nControlID, CDXUTControl* pControl, v
             g_SampleUI.GetCheckBox( IDC_CHECKBOX_SCREEN_RESOLUTION_ADAPTIVE )->SetEnabled( bEnable );
             g_SampleUI.GetStatic( IDC_STATIC_SCREEN_RESOLUTION_SCALE )->SetEnabled( bEnable );
             g_SampleUI.GetSlider( IDC_SLIDER_SCREEN_RESOLUTION_SCALE )->SetEnabled( bEnable );
+            g_SampleUI.GetCheckBox( IDC_CHECKBOX_CPU_PREPASS )->SetEnabled( bEnable );
             break;
 
         case IDC_CHECKBOX_BACK_FACE_CULL:
         case IDC_CHECKBOX_VIEW_FRUSTUM_CULL:
+        case IDC_CHECKBOX_CPU_PREPASS:
         case IDC_CHECKBOX_SCREEN_RESOLUTION_ADAPTIVE:
         case IDC_CHECKBOX_ORIENTATION_ADAPTIVE:
             CreateHullShader();
@@ -705,6 +743,10 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
     V_RETURN( pd3dDevice->CreateBuffer( &Desc, NULL, &g_pcbPNTriangles ) );
     DXUT_SetDebugName( g_pcbPNTriangles, "CB_PNTRIANGLES" );
 
+    Desc.ByteWidth = sizeof( CB_PATCH_FACTORS );
+    V_RETURN( pd3dDevice->CreateBuffer( &Desc, NULL, &g_pcbPatchFactors ) );
+    DXUT_SetDebugName( g_pcbPatchFactors, "CB_PATCH_FACTORS" );
+
     // Setup the camera for each scene   
     D3DXVECTOR3 vecEye( 0.0f, 0.0f, 0.0f );
     D3DXVECTOR3 vecAt ( 0.0f, 0.0f, 0.0f );
@@ -1070,9 +1112,36 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
         PrimitiveTopology = D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST;
     }
     // Render the meshes    
-    for( int iMesh = 0; iMesh < (int)g_SceneMesh[g_eMeshType].GetNumMeshes(); iMesh++ )
+    if( bTessellation && g_SampleUI.GetCheckBox( IDC_CHECKBOX_CPU_PREPASS )->GetChecked() )
     {
-        RenderMesh( &g_SceneMesh[g_eMeshType], (UINT)iMesh, PrimitiveTopology, uDiffuseSlot );
+        // The pre-pass stands in for the hull shader's per-patch work, so it takes the
+        // same constants
+        PatchCuller::Settings Settings;
+        Settings.Type = PatchCuller::FlatPatches;
+        memcpy( &Settings.World, &mWorld, sizeof( Settings.World ) );
+        memcpy( &Settings.ViewProj, &mViewProjection, sizeof( Settings.ViewProj ) );
+        Settings.ScreenWidth = (float)DXUTGetDXGIBackBufferSurfaceDesc()->Width;
+        Settings.ScreenHeight = (float)DXUTGetDXGIBackBufferSurfaceDesc()->Height;
+        Settings.EdgeSize = (float)g_uEdgeSize;
+        Settings.TessFactor = (float)g_uTessFactor;
+        Settings.ScreenSpaceAdaptive = g_SampleUI.GetCheckBox( IDC_CHECKBOX_SCREEN_SPACE_ADAPTIVE )->GetChecked();
+        Settings.FrustumCull = g_SampleUI.GetCheckBox( IDC_CHECKBOX_VIEW_FRUSTUM_CULL )->GetChecked();
+        Settings.BackFaceCull = g_SampleUI.GetCheckBox( IDC_CHECKBOX_BACK_FACE_CULL )->GetChecked();
+        Settings.ViewVector = XMFLOAT3( v3ViewVector.x, v3ViewVector.y, v3ViewVector.z );
+        Settings.BackFaceEpsilon = g_fBackFaceCullEpsilon;
+
+        g_uPrePassStats[0] = g_uPrePassStats[1] = g_uPrePassStats[2] = 0;
+        for( int iMesh = 0; iMesh < (int)g_SceneMesh[g_eMeshType].GetNumMeshes(); iMesh++ )
+        {
+            RenderMeshWithPrePass( &g_SceneMesh[g_eMeshType], (UINT)iMesh, Settings, uDiffuseSlot );
+        }
+    }
+    else
+    {
+        for( int iMesh = 0; iMesh < (int)g_SceneMesh[g_eMeshType].GetNumMeshes(); iMesh++ )
+        {
+            RenderMesh( &g_SceneMesh[g_eMeshType], (UINT)iMesh, PrimitiveTopology, uDiffuseSlot );
+        }
     }
     
     // Render GUI
@@ -1128,6 +1197,13 @@ void CALLBACK OnD3D11DestroyDevice( void* pUserContext )
     SAFE_RELEASE( g_pTexturedScenePS );
         
     SAFE_RELEASE( g_pcbPNTriangles );
+    SAFE_RELEASE( g_pcbPatchFactors );
+
+    SAFE_RELEASE( g_pPatchIB );
+    SAFE_RELEASE( g_pFlatIB );
+    SAFE_RELEASE( g_pPatchFactorBuffer );
+    SAFE_RELEASE( g_pPatchFactorSRV );
+    g_uPrePassCapacity = 0;
 
     SAFE_RELEASE( g_pCaptureTexture );
 
@@ -1455,6 +1531,237 @@ void RenderMesh( CDXUTSDKMesh* pDXUTMesh, UINT uMesh, D3D11_PRIMITIVE_TOPOLOGY P
 }
 
 
+//--------------------------------------------------------------------------------------
+// Runs the CPU pre-pass over every subset of the specified mesh, then draws what is left:
+// the patches through the hull shader with their precomputed factors, and the patches
+// the tessellator would leave whole as plain triangles without tessellation
+//--------------------------------------------------------------------------------------
+void RenderMeshWithPrePass( CDXUTSDKMesh* pDXUTMesh, UINT uMesh, const PatchCuller::Settings& Settings, UINT uDiffuseSlot )
+{
+    #define MAX_D3D11_VERTEX_STREAMS D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT
+
+    // Where the patches and flat triangles of each subset start in the pre-pass buffers
+    struct SUBSET_RANGES
+    {
+        UINT uPatchStart;
+        UINT uPatchCount;
+        UINT uFlatStart;
+        UINT uFlatCount;
+    };
+    static std::vector<SUBSET_RANGES> Ranges;
+
+    assert( NULL != pDXUTMesh );
+
+    if( 0 < pDXUTMesh->GetOutstandingBufferResources() )
+    {
+        return;
+    }
+
+    SDKMESH_MESH* pMesh = pDXUTMesh->GetMesh( uMesh );
+
+    UINT Strides[MAX_D3D11_VERTEX_STREAMS];
+    UINT Offsets[MAX_D3D11_VERTEX_STREAMS];
+    ID3D11Buffer* pVB[MAX_D3D11_VERTEX_STREAMS];
+
+    if( pMesh->NumVertexBuffers > MAX_D3D11_VERTEX_STREAMS )
+    {
+        return;
+    }
+
+    for( UINT64 i = 0; i < pMesh->NumVertexBuffers; i++ )
+    {
+        pVB[i] = pDXUTMesh->GetVB11( uMesh, (UINT)i );
+        Strides[i] = pDXUTMesh->GetVertexStride( uMesh, (UINT)i );
+        Offsets[i] = 0;
+    }
+
+    // Positions and normals are the first two elements of the scene vertex layout
+    const BYTE* pVertices = pDXUTMesh->GetRawVerticesAt( pMesh->VertexBuffers[0] );
+    const BYTE* pIndices = pDXUTMesh->GetRawIndicesAt( pMesh->IndexBuffer );
+    UINT uVertexCount = (UINT)pDXUTMesh->GetNumVertices( uMesh, 0 );
+    bool b16BitIndices = ( IT_16BIT == pDXUTMesh->GetIndexType( uMesh ) );
+
+    // Cull all subsets into one list of patches and one of flat triangles
+    g_PatchIndices.clear();
+    g_PatchFactors.clear();
+    g_FlatIndices.clear();
+    Ranges.resize( pMesh->NumSubsets );
+
+    UINT uTriangles = 0;
+    for( UINT uSubset = 0; uSubset < pMesh->NumSubsets; uSubset++ )
+    {
+        SDKMESH_SUBSET* pSubset = pDXUTMesh->GetSubset( uMesh, uSubset );
+        UINT uVertexStart = (UINT)pSubset->VertexStart;
+        UINT uSubsetTriangles = (UINT)( pSubset->IndexCount / 3 );
+
+        PatchCuller::Vertices Vertices;
+        Vertices.Positions = (const float*)( pVertices + (size_t)uVertexStart * Strides[0] );
+        Vertices.Normals = Vertices.Positions + 3;
+        Vertices.Stride = Strides[0];
+        Vertices.Count = uVertexCount - uVertexStart;
+
+        if( b16BitIndices )
+        {
+            g_PatchCuller.Process( Vertices, (const USHORT*)pIndices + pSubset->IndexStart, uSubsetTriangles, Settings );
+        }
+        else
+        {
+            g_PatchCuller.Process( Vertices, (const UINT*)pIndices + pSubset->IndexStart, uSubsetTriangles, Settings );
+        }
+
+        UINT uPatchCount = g_PatchCuller.GetPatchCount();
+        UINT uFlatCount = g_PatchCuller.GetFlatCount();
+        Ranges[uSubset].uPatchStart = (UINT)g_PatchFactors.size();
+        Ranges[uSubset].uPatchCount = uPatchCount;
+        Ranges[uSubset].uFlatStart = (UINT)g_FlatIndices.size() / 3;
+        Ranges[uSubset].uFlatCount = uFlatCount;
+
+        g_PatchIndices.insert( g_PatchIndices.end(), g_PatchCuller.GetPatchIndices(), g_PatchCuller.GetPatchIndices() + 3 * uPatchCount );
+        g_PatchFactors.insert( g_PatchFactors.end(), g_PatchCuller.GetPatchFactors(), g_PatchCuller.GetPatchFactors() + uPatchCount );
+        g_FlatIndices.insert( g_FlatIndices.end(), g_PatchCuller.GetFlatIndices(), g_PatchCuller.GetFlatIndices() + 3 * uFlatCount );
+
+        g_uPrePassStats[0] += uPatchCount;
+        g_uPrePassStats[1] += uFlatCount;
+        g_uPrePassStats[2] += g_PatchCuller.GetCulledCount();
+        uTriangles += uSubsetTriangles;
+    }
+
+    if( FAILED( ReservePrePassBuffers( uTriangles ) ) )
+    {
+        return;
+    }
+
+    ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
+    D3D11_MAPPED_SUBRESOURCE MappedResource;
+    if( !g_PatchFactors.empty() )
+    {
+        pd3dImmediateContext->Map( g_pPatchIB, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource );
+        memcpy( MappedResource.pData, &g_PatchIndices[0], g_PatchIndices.size() * sizeof( UINT ) );
+        pd3dImmediateContext->Unmap( g_pPatchIB, 0 );
+
+        pd3dImmediateContext->Map( g_pPatchFactorBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource );
+        memcpy( MappedResource.pData, &g_PatchFactors[0], g_PatchFactors.size() * sizeof( XMFLOAT4 ) );
+        pd3dImmediateContext->Unmap( g_pPatchFactorBuffer, 0 );
+    }
+    if( !g_FlatIndices.empty() )
+    {
+        pd3dImmediateContext->Map( g_pFlatIB, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource );
+        memcpy( MappedResource.pData, &g_FlatIndices[0], g_FlatIndices.size() * sizeof( UINT ) );
+        pd3dImmediateContext->Unmap( g_pFlatIB, 0 );
+    }
+
+    pd3dImmediateContext->IASetVertexBuffers( 0, pMesh->NumVertexBuffers, pVB, Strides, Offsets );
+
+    // The patches, through the tessellation stages set up by the caller
+    pd3dImmediateContext->IASetIndexBuffer( g_pPatchIB, DXGI_FORMAT_R32_UINT, 0 );
+    pd3dImmediateContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST );
+    pd3dImmediateContext->HSSetShaderResources( 1, 1, &g_pPatchFactorSRV );
+    pd3dImmediateContext->HSSetConstantBuffers( 1, 1, &g_pcbPatchFactors );
+    for( UINT uSubset = 0; uSubset < pMesh->NumSubsets; uSubset++ )
+    {
+        if( 0 == Ranges[uSubset].uPatchCount )
+        {
+            continue;
+        }
+
+        SDKMESH_SUBSET* pSubset = pDXUTMesh->GetSubset( uMesh, uSubset );
+        SDKMESH_MATERIAL* pMat = pDXUTMesh->GetMaterial( pSubset->MaterialID );
+        if( uDiffuseSlot != INVALID_SAMPLER_SLOT && !IsErrorResource( pMat->pDiffuseRV11 ) )
+        {
+            pd3dImmediateContext->PSSetShaderResources( uDiffuseSlot, 1, &pMat->pDiffuseRV11 );
+        }
+
+        // SV_PrimitiveID restarts at 0 with every draw
+        pd3dImmediateContext->Map( g_pcbPatchFactors, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource );
+        CB_PATCH_FACTORS* pPatchFactorsCB = ( CB_PATCH_FACTORS* )MappedResource.pData;
+        pPatchFactorsCB->uPatchFactorOffset[0] = Ranges[uSubset].uPatchStart;
+        pd3dImmediateContext->Unmap( g_pcbPatchFactors, 0 );
+
+        pd3dImmediateContext->DrawIndexed( Ranges[uSubset].uPatchCount * 3, Ranges[uSubset].uPatchStart * 3, (INT)pSubset->VertexStart );
+    }
+
+    // The flat triangles, with the plain scene VS and no tessellation
+    pd3dImmediateContext->VSSetShader( g_pSceneVS, NULL, 0 );
+    pd3dImmediateContext->HSSetShader( NULL, NULL, 0 );
+    pd3dImmediateContext->DSSetShader( NULL, NULL, 0 );
+    pd3dImmediateContext->IASetIndexBuffer( g_pFlatIB, DXGI_FORMAT_R32_UINT, 0 );
+    pd3dImmediateContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+    for( UINT uSubset = 0; uSubset < pMesh->NumSubsets; uSubset++ )
+    {
+        if( 0 == Ranges[uSubset].uFlatCount )
+        {
+            continue;
+        }
+
+        SDKMESH_SUBSET* pSubset = pDXUTMesh->GetSubset( uMesh, uSubset );
+        SDKMESH_MATERIAL* pMat = pDXUTMesh->GetMaterial( pSubset->MaterialID );
+        if( uDiffuseSlot != INVALID_SAMPLER_SLOT && !IsErrorResource( pMat->pDiffuseRV11 ) )
+        {
+            pd3dImmediateContext->PSSetShaderResources( uDiffuseSlot, 1, &pMat->pDiffuseRV11 );
+        }
+
+        pd3dImmediateContext->DrawIndexed( Ranges[uSubset].uFlatCount * 3, Ranges[uSubset].uFlatStart * 3, (INT)pSubset->VertexStart );
+    }
+
+    // Back to the tessellation stages for the next mesh
+    pd3dImmediateContext->VSSetShader( g_pSceneWithTessellationVS, NULL, 0 );
+    pd3dImmediateContext->HSSetShader( g_pPNTrianglesHS, NULL, 0 );
+    pd3dImmediateContext->DSSetShader( g_pPNTrianglesDS, NULL, 0 );
+}
+
+
+//--------------------------------------------------------------------------------------
+// Grows the dynamic pre-pass buffers to hold at least the specified number of patches
+//--------------------------------------------------------------------------------------
+HRESULT ReservePrePassBuffers( UINT uPatchCount )
+{
+    HRESULT hr;
+
+    if( uPatchCount <= g_uPrePassCapacity )
+    {
+        return S_OK;
+    }
+
+    SAFE_RELEASE( g_pPatchIB );
+    SAFE_RELEASE( g_pFlatIB );
+    SAFE_RELEASE( g_pPatchFactorBuffer );
+    SAFE_RELEASE( g_pPatchFactorSRV );
+    g_uPrePassCapacity = 0;
+
+    ID3D11Device* pd3dDevice = DXUTGetD3D11Device();
+
+    D3D11_BUFFER_DESC Desc;
+    Desc.Usage = D3D11_USAGE_DYNAMIC;
+    Desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    Desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    Desc.MiscFlags = 0;
+    Desc.StructureByteStride = 0;
+    Desc.ByteWidth = uPatchCount * 3 * sizeof( UINT );
+    V_RETURN( pd3dDevice->CreateBuffer( &Desc, NULL, &g_pPatchIB ) );
+    DXUT_SetDebugName( g_pPatchIB, "Pre-pass patches" );
+    V_RETURN( pd3dDevice->CreateBuffer( &Desc, NULL, &g_pFlatIB ) );
+    DXUT_SetDebugName( g_pFlatIB, "Pre-pass flat triangles" );
+
+    Desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    Desc.ByteWidth = uPatchCount * sizeof( XMFLOAT4 );
+    V_RETURN( pd3dDevice->CreateBuffer( &Desc, NULL, &g_pPatchFactorBuffer ) );
+    DXUT_SetDebugName( g_pPatchFactorBuffer, "Pre-pass factors" );
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc;
+    ZeroMemory( &SRVDesc, sizeof( SRVDesc ) );
+    SRVDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    SRVDesc.Buffer.FirstElement = 0;
+    SRVDesc.Buffer.NumElements = uPatchCount;
+    V_RETURN( pd3dDevice->CreateShaderResourceView( g_pPatchFactorBuffer, &SRVDesc, &g_pPatchFactorSRV ) );
+    DXUT_SetDebugName( g_pPatchFactorSRV, "Pre-pass factors" );
+
+    g_uPrePassCapacity = uPatchCount;
+
+    return S_OK;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Helper function to check for file existance
 //--------------------------------------------------------------------------------------
@@ -1480,7 +1787,7 @@ HRESULT CreateHullShader()
     
     // Create the shaders
     ID3DBlob* pBlob = NULL;
-    D3D_SHADER_MACRO ShaderMacros[7];
+    D3D_SHADER_MACRO ShaderMacros[8];
     ZeroMemory( ShaderMacros, sizeof(ShaderMacros) );
     ShaderMacros[0].Name = NULL;
     ShaderMacros[0].Definition = "1";
@@ -1496,6 +1803,8 @@ HRESULT CreateHullShader()
     ShaderMacros[5].Definition = "1";
     ShaderMacros[6].Name = NULL;
     ShaderMacros[6].Definition = "1";
+    ShaderMacros[7].Name = NULL;
+    ShaderMacros[7].Definition = "1";
     
     int i = 0;
 
@@ -1549,6 +1858,14 @@ HRESULT CreateHullShader()
         switches |= 0x20;
     }
 
+    // CPU pre-pass: the factors come from the pre-pass, which has culled the patches already
+    if( g_SampleUI.GetCheckBox( IDC_CHECKBOX_CPU_PREPASS )->GetChecked() )
+    {
+        ShaderMacros[i].Name = "USE_CPU_PATCH_FACTORS";
+        i++;
+        switches |= 0x40;
+    }
+
     // Create the shader
     hr = CompileShaderFromFile( L"FlatDicing.hlsl", "HS_FlatTriangles", "hs_5_0", &pBlob, ShaderMacros ); 
     if ( FAILED(hr) )
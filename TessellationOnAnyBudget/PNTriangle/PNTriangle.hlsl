@@ -48,6 +48,16 @@ static float g_fMaxScreenHeight = 1600.0f;
 // Textures
 Texture2D g_txDiffuse : register( t0 );
 
+#ifdef USE_CPU_PATCH_FACTORS
+// Per-patch tessellation factors from the CPU pre-pass ( x, y, z=Edges, w=Inside )
+Buffer<float4> g_PatchFactors : register( t1 );
+
+cbuffer cbPatchFactors : register( b1 )
+{
+    uint4       g_u4PatchFactorOffset;      // x=First factor of the draw
+}
+#endif
+
 // Samplers
 SamplerState g_SamplePoint  : register( s0 );
 SamplerState g_SampleLinear : register( s1 );
@@ -243,7 +253,7 @@ HS_RenderSceneInput VS_RenderSceneWithTessellation( VS_RenderSceneInput I )
 // This hull shader passes the tessellation factors through to the HW tessellator, 
 // and the 10 (geometry), 6 (normal) control points of the PN-triangular patch to the domain shader
 //--------------------------------------------------------------------------------------
-HS_ConstantOutput HS_ConstantPN( const OutputPatch<HS_ControlPointOutput, 3> I )
+HS_ConstantOutput HS_ConstantPN( const OutputPatch<HS_ControlPointOutput, 3> I, uint uPatchID : SV_PrimitiveID )
 {
     HS_ConstantOutput O = (HS_ConstantOutput)0;
 
@@ -258,12 +268,21 @@ HS_ConstantOutput HS_ConstantPN( const OutputPatch<HS_ControlPointOutput, 3> I )
 		f3B102 = I[2].f3Position[1],
 		f3B201 = I[2].f3Position[2];
 
+#ifdef USE_CPU_PATCH_FACTORS
+	// The pre-pass has computed the factors and left out the culled patches
+	float4 f4Factors = g_PatchFactors.Load( g_u4PatchFactorOffset.x + uPatchID );
+	O.fTessFactor[0] = f4Factors.x;
+	O.fTessFactor[1] = f4Factors.y;
+	O.fTessFactor[2] = f4Factors.z;
+	O.fInsideTessFactor = f4Factors.w;
+#else
 	O.fTessFactor[0] = I[1].fOppositeEdgeLOD;
 	O.fTessFactor[1] = I[2].fOppositeEdgeLOD;
 	O.fTessFactor[2] = I[0].fOppositeEdgeLOD;
 
     // Inside tess factor is just the average of the edge factors
     O.fInsideTessFactor = max( max( O.fTessFactor[0], O.fTessFactor[1]), O.fTessFactor[2] );
+#endif
 
 	float3 f3E = (f3B210 + f3B120 + f3B021 + f3B012 + f3B102 + f3B201) / 6.0f;
 	float3 f3V = (f3B003 + f3B030 + f3B300) / 3.0f;
@@ -284,7 +303,7 @@ HS_ConstantOutput HS_ConstantPN( const OutputPatch<HS_ControlPointOutput, 3> I )
 #endif
 
 
-#ifdef USE_VIEW_FRUSTUM_CULLING
+#if defined( USE_VIEW_FRUSTUM_CULLING ) && !defined( USE_CPU_PATCH_FACTORS )
 	float fB111Clipped = IsClipped(ApplyProjection(g_f4x4ViewProjection, O.f3ViewB111));
 #else
 	float fB111Clipped = 0.f;
@@ -318,7 +337,7 @@ HS_ControlPointOutput HS_PNTriangles(
     O.f3Normal = I[uCPID].f3Normal;
     O.f2TexCoord = I[uCPID].f2TexCoord;
 
-#ifdef USE_SCREEN_SPACE_ADAPTIVE_TESSELLATION
+#if defined( USE_SCREEN_SPACE_ADAPTIVE_TESSELLATION ) && !defined( USE_CPU_PATCH_FACTORS )
 	O.fOppositeEdgeLOD = ComputeEdgeLOD(
 		g_f4x4ViewProjection, O.f3Position[0],
 		O.f3Position[1], O.f3Position[2],
@@ -328,7 +347,7 @@ HS_ControlPointOutput HS_PNTriangles(
 	O.fOppositeEdgeLOD = g_f4TessFactors.x;
 #endif
 
-#ifdef USE_VIEW_FRUSTUM_CULLING
+#if defined( USE_VIEW_FRUSTUM_CULLING ) && !defined( USE_CPU_PATCH_FACTORS )
 	O.fClipped = ComputeClipping( g_f4x4Projection, O.f3Position[0], O.f3Position[1], O.f3Position[2] );
 #else
 	O.fClipped = 0.0f;
@@ -12,6 +12,7 @@
 #include "DXUT.h"
 #include "SDKMesh.h"
 #include "SDKMisc.h"
+#include "nvtesscache.h"
 
 #include <memory>
 #include <vector>
@@ -95,16 +96,28 @@ private:
 	FStaticMeshNvRenderBuffer& operator=( const FStaticMeshNvRenderBuffer& );
 };
 
+/**
+ * Returns the buffer cached under the mesh's key or, failing that, builds it and adds it to
+ * cacheMisses. Cached buffers point into the mapped cache file.
+ */
 std::shared_ptr<nv::IndexBuffer> BuildTessellationBuffer(
 	nv::DestBufferMode destBufferMode,
 	SDKMESH_VERTEX_BUFFER_HEADER* vheader,
 	BYTE* vbuffer,
 	SDKMESH_INDEX_BUFFER_HEADER* iheader,
-	BYTE* ibuffer)
+	BYTE* ibuffer,
+	const nv::tess::CacheFile& cache,
+	nv::tess::CacheWriter& cacheMisses)
 {
 	FStaticMeshNvRenderBuffer StaticMeshRenderBuffer(vheader, vbuffer, iheader, ibuffer);
-	std::shared_ptr<nv::IndexBuffer> PnAENIndexBuffer(
-		nv::tess::buildTessellationBuffer(&StaticMeshRenderBuffer, destBufferMode, true));
+	const unsigned long long key = nv::tess::computeCacheKey(&StaticMeshRenderBuffer, destBufferMode, true);
+
+	std::shared_ptr<nv::IndexBuffer> PnAENIndexBuffer(cache.find(key));
+	if (!PnAENIndexBuffer)
+	{
+		PnAENIndexBuffer.reset(nv::tess::buildTessellationBuffer(&StaticMeshRenderBuffer, destBufferMode, true));
+		cacheMisses.add(key, PnAENIndexBuffer.get());
+	}
 	return PnAENIndexBuffer;
 }
 
@@ -427,6 +440,13 @@ HRESULT CDXUTSDKMesh::CreateFromFile( ID3D11Device* pDev11,
     if( INVALID_HANDLE_VALUE == m_hFile )
         return DXUTERR_MEDIANOTFOUND;
 
+    // Tessellation buffers are cached in a file next to the mesh
+    char strMeshPath[MAX_PATH];
+    WideCharToMultiByte( CP_ACP, 0, m_strPathW, -1, strMeshPath, MAX_PATH, NULL, FALSE );
+    m_strTessCachePath[0] = '\0';
+    if( strlen( strMeshPath ) + 5 < MAX_PATH )
+        sprintf_s( m_strTessCachePath, MAX_PATH, "%s.tess", strMeshPath );
+
     // Change the path to just the directory
     WCHAR* pLastBSlash = wcsrchr( m_strPathW, L'\\' );
     if( pLastBSlash )
@@ -485,6 +505,8 @@ HRESULT CDXUTSDKMesh::CreateFromMemory( ID3D11Device* pDev11,
     HRESULT hr = E_FAIL;
     D3DXVECTOR3 lower; 
     D3DXVECTOR3 upper; 
+    nv::tess::CacheFile TessCache;
+    nv::tess::CacheWriter TessCacheMisses;
     
     m_pDev9 = pDev9;
 	m_pDev11 = pDev11;
@@ -559,6 +581,11 @@ HRESULT CDXUTSDKMesh::CreateFromMemory( ID3D11Device* pDev11,
 
     // Create IBs
     m_ppIndices = new BYTE*[m_pMeshHeader->NumIndexBuffers];
+
+    // Tessellation buffers built on an earlier run come from the cache file; new ones are added to it
+    if( m_DestBufferMode != nv::DestBufferMode_MAX && m_strTessCachePath[0] )
+        TessCache.open( m_strTessCachePath );
+
     for( UINT i = 0; i < m_pMeshHeader->NumIndexBuffers; i++ )
     {
         BYTE* pIndices = NULL;
@@ -574,7 +601,9 @@ HRESULT CDXUTSDKMesh::CreateFromMemory( ID3D11Device* pDev11,
 				&m_pVertexBufferArray[i],
 				m_ppVertices[i],
 				&m_pIndexBufferArray[i],
-				pIndices);
+				pIndices,
+				TessCache,
+				TessCacheMisses);
 
 			int nByte = 4;
 			if (indexWrapper->getType() == nv::IBT_U16)
@@ -597,6 +626,13 @@ HRESULT CDXUTSDKMesh::CreateFromMemory( ID3D11Device* pDev11,
 		m_ppIndices[i] = pIndices;
     }
 
+    if( TessCacheMisses.getEntryCount() > 0 && m_strTessCachePath[0] )
+    {
+        TessCacheMisses.addMissing( TessCache );
+        TessCache.close();
+        TessCacheMisses.write( m_strTessCachePath );
+    }
+
     // Load Materials
     if( pDev11 )
         LoadMaterials( pDev11, m_pMaterialArray, m_pMeshHeader->NumMaterials, pLoaderCallbacks11 );
@@ -1109,6 +1145,7 @@ CDXUTSDKMesh::CDXUTSDKMesh() : m_NumOutstandingResources( 0 ),
                                m_pDev9( NULL ),
 							   m_pDev11( NULL )
 {
+    m_strTessCachePath[0] = '\0';
 }
 
 
@@ -1136,6 +1173,7 @@ HRESULT CDXUTSDKMesh::Create( IDirect3DDevice9* pDev9, LPCTSTR szFileName, bool
 HRESULT CDXUTSDKMesh::Create( ID3D11Device* pDev11, BYTE* pData, UINT DataBytes, bool bCreateAdjacencyIndices,
                               bool bCopyStatic, SDKMESH_CALLBACKS11* pLoaderCallbacks )
 {
+    m_strTessCachePath[0] = '\0';
     return CreateFromMemory( pDev11, NULL, pData, DataBytes, bCreateAdjacencyIndices, bCopyStatic,
                              pLoaderCallbacks,  NULL );
 }
@@ -1145,6 +1183,7 @@ HRESULT CDXUTSDKMesh::Create( ID3D11Device* pDev11, BYTE* pData, UINT DataBytes,
 HRESULT CDXUTSDKMesh::Create( IDirect3DDevice9* pDev9, BYTE* pData, UINT DataBytes, bool bCreateAdjacencyIndices,
                               bool bCopyStatic, SDKMESH_CALLBACKS9* pLoaderCallbacks )
 {
+    m_strTessCachePath[0] = '\0';
     return CreateFromMemory( NULL, pDev9, pData, DataBytes, bCreateAdjacencyIndices, bCopyStatic, NULL, 
                              pLoaderCallbacks );
 }
@@ -323,6 +323,9 @@ protected:
     WCHAR                           m_strPathW[MAX_PATH];
     char                            m_strPath[MAX_PATH];
 
+    //Cached tessellation index buffers for the mesh file; empty when created from memory
+    char                            m_strTessCachePath[MAX_PATH];
+
     //General mesh info
     SDKMESH_HEADER* m_pMeshHeader;
     SDKMESH_VERTEX_BUFFER_HEADER* m_pVertexBufferArray;
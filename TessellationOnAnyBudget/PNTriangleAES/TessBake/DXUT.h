@@ -0,0 +1,26 @@
+//***************************************************************************************
+// DXUT.h
+//
+// The nvtesslib sources include DXUT.h first, as the demo's precompiled header, and
+// take the min/max macros and, for the cache file, the Windows file functions from it.
+// TessBake does not link DXUT, so this header stands in for it.
+//***************************************************************************************
+
+#ifndef DXUT_H
+#define DXUT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#ifdef _WIN32
+
+#define NOMINMAX
+#include <Windows.h>
+
+#endif // _WIN32
+
+using std::min;
+using std::max;
+
+#endif // DXUT_H
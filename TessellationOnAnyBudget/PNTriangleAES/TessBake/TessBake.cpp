@@ -0,0 +1,364 @@
+//***************************************************************************************
+// TessBake.cpp
+//
+// Pre-bakes the tessellation cache of every .sdkmesh file under the given directories,
+// so the PNTriangleAES demo loads them without building adjacency.  Each mesh gets a
+// <name>.sdkmesh.tess file beside it holding the index buffers CDXUTSDKMesh would
+// build, for every DestBufferMode.  Buffers already in an up to date cache file are
+// kept rather than rebuilt unless -force is given.
+//
+// Files are baked on every hardware thread, largest first; nvtess splits the build of
+// a large mesh over threads of its own.  Nothing here needs Direct3D:
+//
+//   g++ -std=c++14 -O2 -pthread -I. -I../nvtesslib/src TessBake.cpp
+//       ../nvtesslib/src/nvtess.cpp ../nvtesslib/src/nvtesscache.cpp -o TessBake
+//
+// Usage: TessBake [-threads n] [-mode m] [-force] dir...
+//***************************************************************************************
+
+#include "DXUT.h"
+#include "nvtess.h"
+#include "nvtesscache.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	template<typename T>
+	T ReadAt(const std::vector<char>& bytes, size_t offset)
+	{
+		T value = T();
+		if( offset + sizeof(T) <= bytes.size() )
+			memcpy(&value, &bytes[offset], sizeof(T));
+		return value;
+	}
+
+	// Index buffer i of an sdkmesh file with vertex buffer i, read at the SDKMESH_* header
+	// offsets and fed to nvtess exactly like SDKmesh.cpp's FStaticMeshNvRenderBuffer does,
+	// so the cache keys match the ones the demo computes.
+	class SdkMeshRenderBuffer : public nv::RenderBuffer
+	{
+	public:
+		SdkMeshRenderBuffer(const std::vector<char>& file, unsigned int buffer)
+		: mVertices(0), mPosOffset(0), mTexOffset(-1), mStride(0)
+		{
+			const size_t vbHeader = (size_t)(ReadAt<unsigned long long>(file, 56) + 288*buffer);
+			const size_t ibHeader = (size_t)(ReadAt<unsigned long long>(file, 64) + 32*buffer);
+
+			// D3DVERTEXELEMENT9 list, ended by stream 255.
+			for(unsigned int i = 0; i < 32; ++i)
+			{
+				const size_t element = vbHeader + 24 + 8*i;
+				if( ReadAt<unsigned short>(file, element) == 255 )
+					break;
+
+				const unsigned char usage = ReadAt<unsigned char>(file, element + 6);
+				if( usage == 5 )
+					mTexOffset = ReadAt<unsigned short>(file, element + 2);
+				else if( usage == 0 )
+					mPosOffset = ReadAt<unsigned short>(file, element + 2);
+			}
+			mStride   = (unsigned int)ReadAt<unsigned long long>(file, vbHeader + 16);
+			mVertices = &file[0] + ReadAt<unsigned long long>(file, vbHeader + 280);
+
+			const unsigned int indexCount = (unsigned int)ReadAt<unsigned long long>(file, ibHeader);
+			const unsigned int indexType  = ReadAt<unsigned int>(file, ibHeader + 16);
+			const char* indices = &file[0] + ReadAt<unsigned long long>(file, ibHeader + 24);
+			mIb = new nv::IndexBuffer((void*)indices, indexType == 0 ? nv::IBT_U16 : nv::IBT_U32, indexCount, false);
+		}
+
+		virtual nv::Vertex getVertex(unsigned int index)const
+		{
+			const char* vertex = mVertices + (size_t)mStride*index;
+
+			nv::Vertex v;
+			memcpy(&v.pos, vertex + mPosOffset, sizeof(v.pos));
+			if( mTexOffset >= 0 )
+				memcpy(&v.uv, vertex + mTexOffset, sizeof(v.uv));
+			else
+				v.uv.x = v.uv.y = 0.0f;
+			return v;
+		}
+
+	private:
+		SdkMeshRenderBuffer(const SdkMeshRenderBuffer& rhs);
+		SdkMeshRenderBuffer& operator=(const SdkMeshRenderBuffer& rhs);
+
+		const char* mVertices;
+		int mPosOffset;
+		int mTexOffset;
+		unsigned int mStride;
+	};
+
+	// Every buffer the headers promise must lie inside the file.
+	bool ValidateSdkMesh(const std::vector<char>& file, unsigned int& bufferCount)
+	{
+		const unsigned int SdkMeshVersion = 101;
+		if( file.size() < 104 || ReadAt<unsigned int>(file, 0) != SdkMeshVersion )
+			return false;
+
+		const unsigned int vbCount = ReadAt<unsigned int>(file, 32);
+		const unsigned int ibCount = ReadAt<unsigned int>(file, 36);
+		const unsigned long long vbHeaders = ReadAt<unsigned long long>(file, 56);
+		const unsigned long long ibHeaders = ReadAt<unsigned long long>(file, 64);
+		if( vbHeaders + 288ull*vbCount > file.size() || ibHeaders + 32ull*ibCount > file.size() )
+			return false;
+
+		// CDXUTSDKMesh pairs index buffer i with vertex buffer i.
+		bufferCount = std::min(vbCount, ibCount);
+		for(unsigned int i = 0; i < bufferCount; ++i)
+		{
+			const size_t vb = (size_t)(vbHeaders + 288*i);
+			const size_t ib = (size_t)(ibHeaders + 32*i);
+			if( ReadAt<unsigned long long>(file, vb + 280) + ReadAt<unsigned long long>(file, vb + 8) > file.size() ||
+				ReadAt<unsigned long long>(file, ib + 24) + ReadAt<unsigned long long>(file, ib + 8) > file.size() )
+				return false;
+		}
+		return true;
+	}
+
+	bool EndsWithNoCase(const std::string& s, const std::string& suffix)
+	{
+		if( s.size() < suffix.size() )
+			return false;
+
+		for(size_t i = 0; i < suffix.size(); ++i)
+		{
+			if( tolower((unsigned char)s[s.size() - suffix.size() + i]) != tolower((unsigned char)suffix[i]) )
+				return false;
+		}
+		return true;
+	}
+
+	struct MeshFile
+	{
+		std::string Path;
+		unsigned long long Size;
+	};
+
+	void FindSdkMeshes(const std::string& dir, std::vector<MeshFile>& meshes)
+	{
+#ifdef _WIN32
+		WIN32_FIND_DATAA data;
+		HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &data);
+		if( find == INVALID_HANDLE_VALUE )
+			return;
+
+		do
+		{
+			const std::string name = data.cFileName;
+			const std::string path = dir + "\\" + name;
+			if( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+			{
+				if( name != "." && name != ".." )
+					FindSdkMeshes(path, meshes);
+			}
+			else if( EndsWithNoCase(name, ".sdkmesh") )
+			{
+				MeshFile mesh = { path, ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow };
+				meshes.push_back(mesh);
+			}
+		}
+		while( FindNextFileA(find, &data) );
+
+		FindClose(find);
+#else
+		DIR* d = opendir(dir.c_str());
+		if( !d )
+			return;
+
+		while( dirent* entry = readdir(d) )
+		{
+			const std::string name = entry->d_name;
+			const std::string path = dir + "/" + name;
+
+			struct stat info;
+			if( name == "." || name == ".." || stat(path.c_str(), &info) != 0 )
+				continue;
+
+			if( S_ISDIR(info.st_mode) )
+				FindSdkMeshes(path, meshes);
+			else if( EndsWithNoCase(name, ".sdkmesh") )
+			{
+				MeshFile mesh = { path, (unsigned long long)info.st_size };
+				meshes.push_back(mesh);
+			}
+		}
+
+		closedir(d);
+#endif
+	}
+
+	struct BakeResult
+	{
+		bool Valid;
+		bool Written;
+		unsigned int Built;
+		unsigned int Kept;
+	};
+
+	BakeResult Bake(const std::string& path, const std::vector<nv::DestBufferMode>& modes, bool force)
+	{
+		BakeResult result = { false, false, 0, 0 };
+
+		std::vector<char> file;
+		{
+			std::ifstream fin(path.c_str(), std::ios::binary);
+			file.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+		}
+
+		unsigned int bufferCount = 0;
+		if( !ValidateSdkMesh(file, bufferCount) )
+			return result;
+		result.Valid = true;
+
+		const std::string cachePath = path + ".tess";
+		nv::tess::CacheFile cache;
+		if( !force )
+			cache.open(cachePath.c_str());
+
+		// Only the current buffers go in, so entries for old contents of the mesh drop out.
+		nv::tess::CacheWriter writer;
+		for(unsigned int i = 0; i < bufferCount; ++i)
+		{
+			SdkMeshRenderBuffer renderBuffer(file, i);
+
+			for(size_t m = 0; m < modes.size(); ++m)
+			{
+				const unsigned long long key = nv::tess::computeCacheKey(&renderBuffer, modes[m], true);
+
+				nv::IndexBuffer* ib = cache.find(key);
+				if( ib )
+					++result.Kept;
+				else
+				{
+					ib = nv::tess::buildTessellationBuffer(&renderBuffer, modes[m], true);
+					++result.Built;
+				}
+
+				writer.add(key, ib);
+				delete ib;
+			}
+		}
+
+		// Rewrite unless every buffer was there and nothing stale was.
+		if( result.Built > 0 || cache.getEntryCount() != writer.getEntryCount() )
+		{
+			cache.close();
+			result.Written = writer.write(cachePath.c_str());
+		}
+		else
+			result.Written = true;
+
+		return result;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	std::vector<nv::DestBufferMode> modes;
+	bool force = false;
+	std::vector<std::string> dirs;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if( arg == "-threads" && hasValue )
+			threadCount = (unsigned int)atoi(argv[++i]);
+		else if( arg == "-mode" && hasValue )
+		{
+			int mode = atoi(argv[++i]);
+			if( mode < 0 || mode >= nv::DestBufferMode_MAX )
+			{
+				std::cerr << "mode must be 0 to " << nv::DestBufferMode_MAX - 1 << std::endl;
+				return 1;
+			}
+			modes.push_back((nv::DestBufferMode)mode);
+		}
+		else if( arg == "-force" )
+			force = true;
+		else if( !arg.empty() && arg[0] != '-' )
+			dirs.push_back(arg);
+		else
+		{
+			dirs.clear();
+			break;
+		}
+	}
+
+	if( dirs.empty() )
+	{
+		std::cerr << "usage: " << argv[0] << " [-threads n] [-mode m] [-force] dir..." << std::endl;
+		return 1;
+	}
+
+	if( modes.empty() )
+	{
+		for(int mode = 0; mode < nv::DestBufferMode_MAX; ++mode)
+			modes.push_back((nv::DestBufferMode)mode);
+	}
+
+	std::vector<MeshFile> meshes;
+	for(size_t i = 0; i < dirs.size(); ++i)
+		FindSdkMeshes(dirs[i], meshes);
+
+	// Largest first, so the long bakes do not end up last on one thread.
+	std::sort(meshes.begin(), meshes.end(), [](const MeshFile& a, const MeshFile& b) { return a.Size > b.Size; });
+
+	threadCount = std::max(1u, std::min(threadCount, (unsigned int)meshes.size()));
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::atomic<size_t> next(0);
+	std::atomic<unsigned int> failures(0);
+	std::mutex outputMutex;
+
+	auto worker = [&]()
+	{
+		for(size_t i = next++; i < meshes.size(); i = next++)
+		{
+			BakeResult result = Bake(meshes[i].Path, modes, force);
+
+			std::lock_guard<std::mutex> lock(outputMutex);
+			if( !result.Valid )
+				std::cout << "skipped " << meshes[i].Path << ": not a readable sdkmesh file" << std::endl;
+			else if( !result.Written )
+				std::cout << "failed  " << meshes[i].Path << ": could not write " << meshes[i].Path << ".tess" << std::endl;
+			else
+				std::cout << "baked   " << meshes[i].Path << ": " << result.Built << " built, " << result.Kept << " kept" << std::endl;
+
+			if( !result.Valid || !result.Written )
+				++failures;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for(unsigned int t = 1; t < threadCount; ++t)
+		threads.push_back(std::thread(worker));
+	worker();
+	for(size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << meshes.size() << " meshes, " << failures << " failed, " << seconds << " s" << std::endl;
+
+	return failures > 0 ? 1 : 0;
+}
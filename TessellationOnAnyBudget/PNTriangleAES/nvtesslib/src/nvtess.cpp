@@ -1,151 +1,37 @@
 #include "DXUT.h"
 // nvtess.cpp : Defines the exported functions for the DLL application.
 //
+// buildTessellationBuffer runs as a few passes over flat arrays, each split over worker
+// threads for large meshes:
+//
+//   1. Copy the indices and fetch every referenced vertex, by index and vertex ranges.
+//   2. Give each vertex the id of the lowest vertex at the same position (and, when the
+//      mode needs dominant corners, find each position's corner), by hash partition.
+//   3. Key each half edge by the position ids of its ends, by triangle range, then merge
+//      the ranges in order into one open-addressing table per hash partition.
+//   4. Write the patches, by triangle range.
+//
+// Each hash partition is owned by one thread, which walks the vertices or half edges in
+// order, so ties are settled exactly as a single pass over the triangles would settle
+// them and the output does not depend on the thread count.
+//
 
 #include "nvtess.h"
 #include <assert.h>
-
-#define USE_HASHMAP 1
-#define NO_STL 1
-
-#if USE_HASHMAP
-    #include <unordered_map>
-#else
-    #include <map>
-#endif
+#include <string.h>
+#include <thread>
+#include <vector>
 
 const unsigned int EdgesPerTriangle = 3;
 const unsigned int IndicesPerTriangle = 3;
 const unsigned int VerticesPerTriangle = 3;
 const unsigned int DuplicateIndexCount = 3;
 
-namespace nv {
-
-#if NO_STL
-	template <typename FromType, typename ToType>
-	class FHashMap
-	{
-		static const size_t INVALID_ENTRY = (size_t)-1;
-		struct FFromEntry
-		{
-			FromType From;
-			size_t NextEntry;
-		};
-
-		size_t* HashTable;
-		FFromEntry* FromEntries;
-		ToType* ToEntries;
-		size_t MaxEntries;
-		size_t MaxHashes;
-		size_t EntryCount;
-
-	public:
-
-		// These allow this class to stand in for the STL hash map where needed by this library.
-		struct FToRef
-		{
-			const ToType& second;
-
-			__forceinline explicit FToRef( const ToType* Ptr ) : second( *Ptr )
-			{
-			}
-
-			__forceinline const FToRef* operator->() const
-			{
-				return this;
-			}
-		};
-
-		struct iterator
-		{
-			const ToType* To;
-
-			__forceinline explicit iterator( const ToType* Ptr ) : To( Ptr )
-			{
-			}
-
-			__forceinline bool operator==( const iterator& Other ) const
-			{
-				return To == Other.To;
-			}
-
-			__forceinline bool operator!=( const iterator& Other ) const
-			{
-				return To != Other.To;
-			}
-
-			__forceinline const FToRef operator->() const
-			{
-				return FToRef( To );
-			}
-		};
-
-		typedef iterator const_iterator;
-
-		explicit FHashMap( const size_t InMaxEntries )
-		{
-			EntryCount = 0;
-			MaxEntries = InMaxEntries;
-			MaxHashes = (MaxEntries * 4) / 3;
-			HashTable = new size_t[MaxHashes];
-			FromEntries = new FFromEntry[MaxEntries];
-			ToEntries = new ToType[MaxEntries];
-
-			for ( size_t HashIndex = 0; HashIndex < MaxHashes; ++HashIndex )
-			{
-				HashTable[HashIndex] = INVALID_ENTRY;
-			}
-		}
-
-		~FHashMap()
-		{
-			delete [] HashTable;
-			delete [] FromEntries;
-			delete [] ToEntries;
-		}
-
-		void set( const FromType& From, const ToType& To )
-		{
-			const size_t Hash = hash_value( From ) % MaxHashes;
-			size_t EntryIndex = HashTable[Hash];
-			while ( EntryIndex != INVALID_ENTRY )
-			{
-				const FFromEntry& Entry = FromEntries[EntryIndex];
-				if ( Entry.From == From )
-				{
-					ToEntries[EntryIndex] = To;
-					return;
-				}
-				EntryIndex = Entry.NextEntry;
-			}
-			assert( EntryCount < MaxEntries );
-			FromEntries[EntryCount].NextEntry = HashTable[Hash];
-			FromEntries[EntryCount].From = From;
-			ToEntries[EntryCount] = To;
-			HashTable[Hash] = EntryCount;
-			EntryCount++;
-		}
-
-		__forceinline const iterator end() const
-		{
-			return iterator( 0 );
-		}
+// Meshes with fewer triangles are built on the calling thread.
+const unsigned int MinParallelTriangles = 16384;
+const unsigned int MaxThreads = 16;
 
-		const iterator find( const FromType& From ) const
-		{
-			const size_t Hash = hash_value( From ) % MaxHashes;
-			size_t EntryIndex = HashTable[Hash];
-			while ( EntryIndex != INVALID_ENTRY )
-			{
-				const FFromEntry& Entry = FromEntries[EntryIndex];
-				if ( Entry.From == From )
-					return iterator( &ToEntries[EntryIndex] );
-				EntryIndex = Entry.NextEntry;
-			}
-			return end();
-		}
-	};
-#endif // #if NO_STL
+namespace nv {
 
     // ----------------------------------------------------------------------------------------
     // ----------------------------------------------------------------------------------------
@@ -180,527 +66,527 @@ namespace nv {
         return 0;
     }
 
-    // ----------------------------------------------------------------------------------------
-    inline size_t hash_value(const Vector3& v3)
-    {
-        return 31337 * stdext::hash_value(v3.x) + 13 * stdext::hash_value(v3.y) + 3 * stdext::hash_value(v3.z);
-    }
+    namespace tess {
+        // ----------------------------------------------------------------------------------------
+        // Runs fn(t) for t in [0, threadCount), t = 0 on the calling thread.
+        template <typename Fn>
+        void runOnThreads(unsigned int threadCount, const Fn& fn)
+        {
+            std::vector<std::thread> threads;
+            for (unsigned int t = 1; t < threadCount; ++t) {
+                threads.push_back(std::thread([&fn, t]() { fn(t); }));
+            }
 
-    // ----------------------------------------------------------------------------------------
-    inline size_t hash_value(const Vertex& vert)
-    {
-        return hash_value(vert.pos);
-    }
+            fn(0);
+
+            for (size_t u = 0; u < threads.size(); ++u) {
+                threads[u].join();
+            }
+        }
 
-    namespace tess {
         // ----------------------------------------------------------------------------------------
-        class Edge;
+        unsigned int getThreadCount(unsigned int triCount)
+        {
+            if (triCount < MinParallelTriangles) {
+                return 1;
+            }
+
+            unsigned int threadCount = std::thread::hardware_concurrency();
+            if (threadCount == 0) {
+                threadCount = 1;
+            }
 
-        inline size_t hash_value(const Edge& edge);
+            return threadCount < MaxThreads ? threadCount : MaxThreads;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // Start of range t when [0, count) is split into rangeCount nearly equal ranges.
+        inline unsigned int rangeStart(unsigned int count, unsigned int rangeCount, unsigned int t)
+        {
+            return (unsigned int)((unsigned long long)count * t / rangeCount);
+        }
 
         // ----------------------------------------------------------------------------------------
         // ----------------------------------------------------------------------------------------
         // ----------------------------------------------------------------------------------------
-        class Edge 
+        inline unsigned long long mixHash(unsigned long long h)
         {
-            unsigned int mIndexFrom;
-            unsigned int mIndexTo;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            h ^= h >> 33;
+            return h;
+        }
 
-            nv::Vertex mVertexFrom;
-            nv::Vertex mVertexTo;
+        // ----------------------------------------------------------------------------------------
+        // Bits of a coordinate, with -0 hashed like +0 since they compare equal.
+        inline unsigned long long floatBits(float f)
+        {
+            if (f == 0.0f) {
+                return 0;
+            }
 
-            size_t mCachedHash;
+            unsigned int bits;
+            memcpy(&bits, &f, sizeof(bits));
+            return bits;
+        }
 
-        public:    
-            Edge() : mCachedHash(0) { }
+        // ----------------------------------------------------------------------------------------
+        // Positions are keyed exactly: vertices share a position only when it compares equal, as
+        // with the dictionaries this replaces.
+        inline unsigned long long hashPosition(const Vector3& pos)
+        {
+            return mixHash((floatBits(pos.x) << 32 | floatBits(pos.y)) + mixHash(floatBits(pos.z)));
+        }
 
-            Edge(unsigned int indexFrom, unsigned int indexTo, const nv::Vertex& vFrom, const nv::Vertex& vTo) :
-            mIndexFrom(indexFrom), mIndexTo(indexTo), mVertexFrom(vFrom), mVertexTo(vTo)
-            {
-                // Hash should only consider position, not index. We want values with different indices to compare true.
-                mCachedHash = 7 * hash_value(mVertexFrom) + 2 * hash_value(mVertexTo);
-            }
+        // ----------------------------------------------------------------------------------------
+        // Partitions come from the high bits of a hash, table slots from the low bits.
+        inline unsigned int partitionOf(unsigned long long hash, unsigned int partitionCount)
+        {
+            return (unsigned int)(((hash >> 32) * partitionCount) >> 32);
+        }
 
-            // ------------------------------------------------------------------------------------
-            nv::Vertex vertex(unsigned int i) const
-            {
-                switch(i) { 
-        case 0: return mVertexFrom; break;
-        case 1: return mVertexTo; break;
-        default: assert(0); break;
-                }
-                return nv::Vertex();
+        // ----------------------------------------------------------------------------------------
+        // Power of two with room for entryCount at half load.
+        inline unsigned int tableSizeFor(unsigned int entryCount)
+        {
+            unsigned int size = 16;
+            while (size < 2 * entryCount) {
+                size *= 2;
             }
+            return size;
+        }
 
-            // ------------------------------------------------------------------------------------
-            unsigned int index(unsigned int i) const
-            { 
-                switch(i) { 
-        case 0: return mIndexFrom; break;
-        case 1: return mIndexTo; break;
-        default: assert(0); break;
-                }
-                return 0;
+        // ----------------------------------------------------------------------------------------
+        // ----------------------------------------------------------------------------------------
+        // ----------------------------------------------------------------------------------------
+        // Open-addressing map from a half edge's (from, to) position ids to the last half edge in
+        // triangle order with those ends, stored as 3 * triangle + corner.
+        class EdgeTable
+        {
+            struct Slot
+            {
+                unsigned long long mKey;
+                unsigned int mHalfEdge;
             };
 
+            std::vector<Slot> mSlots;
+            unsigned int mMask;
+
+        public:
+            static const unsigned int NotFound = ~0u;
+
+            EdgeTable() : mMask(0) { }
+
             // ------------------------------------------------------------------------------------
-            Edge reverse() const
+            void init(unsigned int entryCount)
             {
-                return Edge(mIndexTo, mIndexFrom, mVertexTo, mVertexFrom);
+                Slot empty = { 0, NotFound };
+                mSlots.assign(tableSizeFor(entryCount), empty);
+                mMask = (unsigned int)mSlots.size() - 1;
             }
 
             // ------------------------------------------------------------------------------------
-            // When comparing edges, compare the vertices--not the indices.
-            __forceinline bool operator<(const Edge& rhs) const
+            void set(unsigned long long key, unsigned long long hash, unsigned int halfEdge)
             {
-                // Quick out, otherwise we have to compare vertices. 
-                if (mIndexFrom == rhs.mIndexFrom && mIndexTo == rhs.mIndexTo) { 
-                    return false;
+                unsigned int slot = (unsigned int)hash & mMask;
+                while (mSlots[slot].mHalfEdge != NotFound && mSlots[slot].mKey != key) {
+                    slot = (slot + 1) & mMask;
                 }
 
-                return mVertexFrom < rhs.mVertexFrom
-                    || mVertexTo < rhs.mVertexTo;
+                mSlots[slot].mKey = key;
+                mSlots[slot].mHalfEdge = halfEdge;
             }
 
-			__forceinline bool operator==( const Edge& Other ) const
-			{
-				return (mIndexFrom == Other.mIndexFrom && mIndexTo == Other.mIndexTo) ||
-					(mVertexFrom == Other.mVertexFrom && mVertexTo == Other.mVertexTo);
-			}
-
-            friend size_t hash_value(const Edge& edge);
+            // ------------------------------------------------------------------------------------
+            unsigned int find(unsigned long long key, unsigned long long hash) const
+            {
+                unsigned int slot = (unsigned int)hash & mMask;
+                while (mSlots[slot].mHalfEdge != NotFound) {
+                    if (mSlots[slot].mKey == key) {
+                        return mSlots[slot].mHalfEdge;
+                    }
+                    slot = (slot + 1) & mMask;
+                }
+                return NotFound;
+            }
         };
 
         // ----------------------------------------------------------------------------------------
         // ----------------------------------------------------------------------------------------
         // ----------------------------------------------------------------------------------------
-        struct Corner
-		{
-			unsigned int mIndex;
-			nv::Vector2 mUV;
-
-			Corner() : mIndex(0) {}
-
-			Corner(unsigned int index, nv::Vector2 uv) : 
-				mIndex(index), mUV(uv)
-			{}
-		};
+        class PatchBuilder
+        {
+            const RenderBuffer* mInputBuffer;
+            DestBufferMode mDestBufferMode;
+            bool mNeedsCorners;
+            unsigned int mTriCount;
+            unsigned int mVertexCount;
+            unsigned int mThreadCount;
 
-        // ----------------------------------------------------------------------------------------
-		#if NO_STL
-			typedef FHashMap<Edge,Edge> EdgeDict;
-			typedef FHashMap<nv::Vector3,Corner> PositionDict;
-        #elif USE_HASHMAP
-            typedef std::unordered_map<Edge, Edge> EdgeDict;
-			typedef std::unordered_map<nv::Vector3, Corner> PositionDict;
-        #else
-            typedef std::map<Edge, Edge> EdgeDict;
-            typedef std::map<nv::Vector3, Corner> PositionDict;
-        #endif
+            std::vector<unsigned int> mIndices;
 
-        typedef EdgeDict::iterator EdgeDictIt;
-        typedef PositionDict::iterator PositionDictIt;
+            // Per vertex index; only referenced vertices are filled in.
+            std::vector<unsigned char> mReferenced;
+            std::vector<nv::Vector3> mPositions;
+            std::vector<nv::Vector2> mUVs;
+            std::vector<unsigned long long> mPositionHashes;
+            std::vector<unsigned int> mFirstUses;
 
-		void add_if_leastUV(PositionDict& outPd, const nv::Vertex& v, unsigned int i)
-		{
-			PositionDictIt foundIt = outPd.find(v.pos);
-			if(foundIt == outPd.end())
-			{
-#if NO_STL
-				outPd.set( v.pos, Corner(i, v.uv) );
-#else // #if NO_STL
-				outPd[v.pos] = Corner(i, v.uv);
-#endif // #if NO_STL
-			}
-			else if(v.uv < foundIt->second.mUV)
-			{
-#if NO_STL
-				outPd.set( v.pos, Corner(i, v.uv) );
-#else // #if NO_STL
-				outPd[v.pos] = Corner(i, v.uv);
-#endif // #if NO_STL
-			}
-		}
+            // Lowest vertex index at the same position.
+            std::vector<unsigned int> mPositionIds;
 
-        // ----------------------------------------------------------------------------------------
-        inline size_t hash_value(const Edge& edge)
-        {    
-            return edge.mCachedHash;
-        }
+            // Per position id, the vertex with the least UV, the first one used on ties.
+            std::vector<unsigned int> mCorners;
 
-        // ----------------------------------------------------------------------------------------
-        // ----------------------------------------------------------------------------------------
-        // ----------------------------------------------------------------------------------------
-        class Triangle
-        {
-            Edge mEdge0;
-            Edge mEdge1;
-            Edge mEdge2;
+            // Per half edge, position ids of its ends: (from << 32) | to.
+            std::vector<unsigned long long> mEdgeKeys;
+            std::vector<EdgeTable> mEdgeTables;
 
         public:
-            inline const Edge& edge(unsigned int i) const { return ((Edge*)&mEdge0)[i]; }
-            inline unsigned int index(unsigned int i) const { return edge(i).index(0); }
+            PatchBuilder(const RenderBuffer* inputBuffer, DestBufferMode destBufferMode) :
+                mInputBuffer(inputBuffer),
+                mDestBufferMode(destBufferMode),
+                mNeedsCorners(destBufferMode != DBM_PnAenOnly),
+                mTriCount(inputBuffer->getIb()->getLength() / IndicesPerTriangle),
+                mVertexCount(0),
+                mThreadCount(getThreadCount(mTriCount))
+            { }
 
             // ------------------------------------------------------------------------------------
-            Triangle(unsigned int i0, unsigned int i1, unsigned int i2, const nv::Vertex& v0, const nv::Vertex& v1, const nv::Vertex& v2) :
-            mEdge0(i0, i1, v0, v1),
-                mEdge1(i1, i2, v1, v2),
-                mEdge2(i2, i0, v2, v0)
-            { }
+            void build()
+            {
+                gatherVertices();
+                buildPositionIds();
+                buildEdgeTables();
+            }
+
+            // ------------------------------------------------------------------------------------
+            void writePatches(std::vector<unsigned int>& outIb, bool completeBuffer) const;
+
+        private:
+            void gatherVertices();
+            void buildPositionIds();
+            void buildEdgeTables();
 
             // ------------------------------------------------------------------------------------
-            bool operator<(const Triangle& rhs) const
-            { 
-                return mEdge0 < rhs.mEdge0 
-                    || mEdge1 < rhs.mEdge1 
-                    || mEdge2 < rhs.mEdge2; 
+            unsigned int edgeFrom(unsigned int halfEdge) const
+            {
+                return mIndices[halfEdge];
             }
-        };
 
-        // ----------------------------------------------------------------------------------------
-        // ----------------------------------------------------------------------------------------
-        // ----------------------------------------------------------------------------------------
-		template <typename ElemType>
-		IndexBuffer* createIndexBuffer(const unsigned int* newIndices, unsigned int indexCount, IndexBufferType destBufferType)
-		{
-			ElemType* elemBuffer = new ElemType[indexCount];
+            // ------------------------------------------------------------------------------------
+            unsigned int edgeTo(unsigned int halfEdge) const
+            {
+                const unsigned int corner = halfEdge % EdgesPerTriangle;
+                return mIndices[halfEdge - corner + (corner + 1) % EdgesPerTriangle];
+            }
 
-			for (unsigned int u = 0; u < indexCount; ++u) {
-				elemBuffer[u] = (ElemType)newIndices[u];
-			}
+            // ------------------------------------------------------------------------------------
+            // Last half edge from position id 'from' to position id 'to', or NotFound.
+            unsigned int findEdge(unsigned int from, unsigned int to) const
+            {
+                const unsigned long long key = (unsigned long long)from << 32 | to;
+                const unsigned long long hash = mixHash(key);
+                return mEdgeTables[partitionOf(hash, (unsigned int)mEdgeTables.size())].find(key, hash);
+            }
 
-			return new IndexBuffer((void*)elemBuffer, destBufferType, indexCount, true);
-		}
+            void writeAdjacentEdges(unsigned int* out, const unsigned int* tri) const;
+            void writeDominantEdges(unsigned int* out, const unsigned int* tri) const;
+            void writeDominantCorners(unsigned int* out, const unsigned int* tri) const;
+        };
 
         // ----------------------------------------------------------------------------------------
-        IndexBuffer* newIndexBuffer(const std::vector<unsigned int>& newIndices, const RenderBuffer* inputBuffer)
+        void PatchBuilder::gatherVertices()
         {
-            IndexBufferType ibType = inputBuffer->getIb()->getType();
+            const IndexBuffer* inIb = mInputBuffer->getIb();
+            const unsigned int indexCount = mTriCount * IndicesPerTriangle;
+            mIndices.resize(indexCount);
+
+            std::vector<unsigned int> rangeMax(mThreadCount, 0);
+            runOnThreads(mThreadCount, [&](unsigned int t) {
+                const unsigned int end = rangeStart(indexCount, mThreadCount, t + 1);
+                unsigned int maxIndex = 0;
+                for (unsigned int u = rangeStart(indexCount, mThreadCount, t); u < end; ++u) {
+                    const unsigned int index = (*inIb)[u];
+                    mIndices[u] = index;
+                    maxIndex = index > maxIndex ? index : maxIndex;
+                }
+                rangeMax[t] = maxIndex;
+            });
 
-            switch (ibType) {
-        case IBT_U16: return createIndexBuffer<unsigned short>(&newIndices[0], (unsigned int)newIndices.size(), IBT_U16); break;
-        case IBT_U32: return createIndexBuffer<unsigned int>(&newIndices[0], (unsigned int)newIndices.size(), IBT_U32); break;
-        default: assert(0); break;
-            };
+            for (unsigned int t = 0; t < mThreadCount; ++t) {
+                if (indexCount > 0 && rangeMax[t] + 1 > mVertexCount) {
+                    mVertexCount = rangeMax[t] + 1;
+                }
+            }
 
-            return 0;
-        }
+            // Walked backwards so each vertex ends up with its first use.
+            mReferenced.assign(mVertexCount, 0);
+            if (mNeedsCorners) {
+                mFirstUses.resize(mVertexCount);
+            }
+            for (unsigned int u = indexCount; u-- > 0; ) {
+                mReferenced[mIndices[u]] = 1;
+                if (mNeedsCorners) {
+                    mFirstUses[mIndices[u]] = u;
+                }
+            }
 
-        // ----------------------------------------------------------------------------------------
-        // ----------------------------------------------------------------------------------------
-        // ----------------------------------------------------------------------------------------
-        void expandIb_DominantEdgeAndCorner(unsigned int* outIb, const Triangle& tri, unsigned int startOutIndex)
-        {
-            outIb[startOutIndex +  0] = tri.index(0);
-            outIb[startOutIndex +  1] = tri.index(1);
-            outIb[startOutIndex +  2] = tri.index(2);
-
-            outIb[startOutIndex +  3] = tri.index(0);
-            outIb[startOutIndex +  4] = tri.index(1);
-            outIb[startOutIndex +  5] = tri.index(1);
-            outIb[startOutIndex +  6] = tri.index(2);
-            outIb[startOutIndex +  7] = tri.index(2);
-            outIb[startOutIndex +  8] = tri.index(0);
-
-            outIb[startOutIndex +  9] = tri.index(0);
-            outIb[startOutIndex + 10] = tri.index(1);
-            outIb[startOutIndex + 11] = tri.index(2);
+            mPositions.resize(mVertexCount);
+            mUVs.resize(mVertexCount);
+            mPositionHashes.resize(mVertexCount);
+            runOnThreads(mThreadCount, [&](unsigned int t) {
+                const unsigned int end = rangeStart(mVertexCount, mThreadCount, t + 1);
+                for (unsigned int v = rangeStart(mVertexCount, mThreadCount, t); v < end; ++v) {
+                    if (mReferenced[v]) {
+                        const Vertex vertex = mInputBuffer->getVertex(v);
+                        mPositions[v] = vertex.pos;
+                        mUVs[v] = vertex.uv;
+                        mPositionHashes[v] = hashPosition(vertex.pos);
+                    }
+                }
+            });
         }
 
         // ----------------------------------------------------------------------------------------
-        void expandIb_PnAenOnly(unsigned int* outIb, const Triangle& tri, unsigned int startOutIndex)
+        void PatchBuilder::buildPositionIds()
         {
-            outIb[startOutIndex + 0] = tri.index(0);
-            outIb[startOutIndex + 1] = tri.index(1);
-            outIb[startOutIndex + 2] = tri.index(2);
-
-            outIb[startOutIndex + 3] = tri.index(0);
-            outIb[startOutIndex + 4] = tri.index(1);
-            outIb[startOutIndex + 5] = tri.index(1);
-            outIb[startOutIndex + 6] = tri.index(2);
-            outIb[startOutIndex + 7] = tri.index(2);
-            outIb[startOutIndex + 8] = tri.index(0);
-        }
+            mPositionIds.resize(mVertexCount);
+            if (mNeedsCorners) {
+                mCorners.resize(mVertexCount);
+            }
 
-        // ----------------------------------------------------------------------------------------
-        void expandIb_PnAenDominantCorner(unsigned int* outIb, const Triangle& tri, unsigned int startOutIndex)
-        {
-            outIb[startOutIndex +  0] = tri.index(0);
-            outIb[startOutIndex +  1] = tri.index(1);
-            outIb[startOutIndex +  2] = tri.index(2);
-
-            outIb[startOutIndex +  3] = tri.index(0);
-            outIb[startOutIndex +  4] = tri.index(1);
-            outIb[startOutIndex +  5] = tri.index(1);
-            outIb[startOutIndex +  6] = tri.index(2);
-            outIb[startOutIndex +  7] = tri.index(2);
-            outIb[startOutIndex +  8] = tri.index(0);
-
-            outIb[startOutIndex +  9] = tri.index(0);
-            outIb[startOutIndex + 10] = tri.index(1);
-            outIb[startOutIndex + 11] = tri.index(2);
-        }
+            runOnThreads(mThreadCount, [&](unsigned int t) {
+                const unsigned int partitionCount = mThreadCount;
 
-        // ----------------------------------------------------------------------------------------
-        void expandIb_PnAenDominantEdgeAndCorner(unsigned int* outIb, const Triangle& tri, unsigned int startOutIndex)
-        {
-            outIb[startOutIndex +  0] = tri.index(0);
-            outIb[startOutIndex +  1] = tri.index(1);
-            outIb[startOutIndex +  2] = tri.index(2);
-
-            outIb[startOutIndex +  3] = tri.index(0);
-            outIb[startOutIndex +  4] = tri.index(1);
-            outIb[startOutIndex +  5] = tri.index(1);
-            outIb[startOutIndex +  6] = tri.index(2);
-            outIb[startOutIndex +  7] = tri.index(2);
-            outIb[startOutIndex +  8] = tri.index(0);
-
-            outIb[startOutIndex +  9] = tri.index(0);
-            outIb[startOutIndex + 10] = tri.index(1);
-            outIb[startOutIndex + 11] = tri.index(1);
-            outIb[startOutIndex + 12] = tri.index(2);
-            outIb[startOutIndex + 13] = tri.index(2);
-            outIb[startOutIndex + 14] = tri.index(0);
-
-            outIb[startOutIndex + 15] = tri.index(0);
-            outIb[startOutIndex + 16] = tri.index(1);
-            outIb[startOutIndex + 17] = tri.index(2);
+                unsigned int count = 0;
+                for (unsigned int v = 0; v < mVertexCount; ++v) {
+                    if (mReferenced[v] && partitionOf(mPositionHashes[v], partitionCount) == t) {
+                        ++count;
+                    }
+                }
+
+                // Vertex indices; the first vertex seen at a position is the lowest one.
+                std::vector<unsigned int> slots(tableSizeFor(count), ~0u);
+                const unsigned int mask = (unsigned int)slots.size() - 1;
+
+                for (unsigned int v = 0; v < mVertexCount; ++v) {
+                    if (!mReferenced[v] || partitionOf(mPositionHashes[v], partitionCount) != t) {
+                        continue;
+                    }
+
+                    unsigned int slot = (unsigned int)mPositionHashes[v] & mask;
+                    while (slots[slot] != ~0u && !(mPositions[slots[slot]] == mPositions[v])) {
+                        slot = (slot + 1) & mask;
+                    }
+                    if (slots[slot] == ~0u) {
+                        slots[slot] = v;
+                    }
+
+                    const unsigned int id = slots[slot];
+                    mPositionIds[v] = id;
+
+                    if (!mNeedsCorners) {
+                        continue;
+                    }
+
+                    // Same choice as keeping the least UV over the corners in triangle order.
+                    if (id == v) {
+                        mCorners[id] = v;
+                    } else {
+                        const unsigned int best = mCorners[id];
+                        if (mUVs[v] < mUVs[best] || (!(mUVs[best] < mUVs[v]) && mFirstUses[v] < mFirstUses[best])) {
+                            mCorners[id] = v;
+                        }
+                    }
+                }
+            });
         }
 
         // ----------------------------------------------------------------------------------------
-        void expandIb(unsigned int* outIb, DestBufferMode destBufferMode, EdgeDict& outEd, PositionDict& outPd, const RenderBuffer* inputBuffer)
+        void PatchBuilder::buildEdgeTables()
         {
-            const IndexBuffer* inIb = inputBuffer->getIb();
-            const unsigned int triCount = inIb->getLength() / IndicesPerTriangle;
-            const unsigned int outputIndicesPerPatch = getIndicesPerPatch(destBufferMode);
-
-            bool requiresEdgeDict = true;
-            bool requiresPositionDict = destBufferMode != DBM_PnAenOnly;
-
-            for (unsigned int u = 0; u < triCount; ++u) {
-
-                const unsigned int startInIndex = u * IndicesPerTriangle;
-                const unsigned int startOutIndex = u * outputIndicesPerPatch;
-
-                const unsigned int i0 = (*inIb)[startInIndex + 0], 
-                    i1 = (*inIb)[startInIndex + 1], 
-                    i2 = (*inIb)[startInIndex + 2];
-
-                const Vertex v0 = inputBuffer->getVertex(i0),
-                    v1 = inputBuffer->getVertex(i1),
-                    v2 = inputBuffer->getVertex(i2);
-
-                Triangle tri(i0, i1, i2, v0, v1, v2);
-
-                switch (destBufferMode) {
-                    case DBM_DominantEdgeAndCorner:
-                        expandIb_DominantEdgeAndCorner(outIb, tri, startOutIndex);
-                        break;
-                    case DBM_PnAenOnly:
-                        expandIb_PnAenOnly(outIb, tri, startOutIndex);
-                        break;
-                    case DBM_PnAenDominantCorner:
-                        expandIb_PnAenDominantCorner(outIb, tri, startOutIndex);
-                        break;
-                    case DBM_PnAenDominantEdgeAndCorner:
-                        expandIb_PnAenDominantEdgeAndCorner(outIb, tri, startOutIndex);
-                        break;
-                    default:
-                        assert(0);
-                        break;
-                };
-
-
-                if (requiresEdgeDict) {
-                    Edge rev0 = tri.edge(0).reverse(),
-                         rev1 = tri.edge(1).reverse(),
-                         rev2 = tri.edge(2).reverse();
-#if NO_STL
-					outEd.set( rev0, rev0 );
-					outEd.set( rev1, rev1 );
-					outEd.set( rev2, rev2 );
-#else // #if NO_STL
-                    outEd[rev0] = rev0;
-                    outEd[rev1] = rev1;
-                    outEd[rev2] = rev2;
-#endif // #if NO_STL
+            const unsigned int halfEdgeCount = mTriCount * EdgesPerTriangle;
+            mEdgeKeys.resize(halfEdgeCount);
+
+            runOnThreads(mThreadCount, [&](unsigned int t) {
+                const unsigned int end = rangeStart(halfEdgeCount, mThreadCount, t + 1);
+                for (unsigned int u = rangeStart(halfEdgeCount, mThreadCount, t); u < end; ++u) {
+                    mEdgeKeys[u] = (unsigned long long)mPositionIds[edgeFrom(u)] << 32 | mPositionIds[edgeTo(u)];
+                }
+            });
+
+            // Each partition takes its keys from every triangle range in order, so the last half
+            // edge in triangle order wins, as it did when the dictionary was filled serially.
+            mEdgeTables.resize(mThreadCount);
+            runOnThreads(mThreadCount, [&](unsigned int t) {
+                const unsigned int partitionCount = mThreadCount;
+
+                unsigned int count = 0;
+                for (unsigned int u = 0; u < halfEdgeCount; ++u) {
+                    if (partitionOf(mixHash(mEdgeKeys[u]), partitionCount) == t) {
+                        ++count;
+                    }
                 }
 
-                if (requiresPositionDict) {
-                    add_if_leastUV(outPd, v0, i0);
-					add_if_leastUV(outPd, v1, i1);
-					add_if_leastUV(outPd, v2, i2);
+                EdgeTable& table = mEdgeTables[t];
+                table.init(count);
+
+                for (unsigned int u = 0; u < halfEdgeCount; ++u) {
+                    const unsigned long long hash = mixHash(mEdgeKeys[u]);
+                    if (partitionOf(hash, partitionCount) == t) {
+                        table.set(mEdgeKeys[u], hash, u);
+                    }
                 }
-            }
+            });
         }
-		// template <typename T> T min(const T& a, const T& b) { if (a <= b) return a; else return b; }
-		// template <typename T> T max(const T& a, const T& b) { if (a >= b) return a; else return b; }
 
         // ----------------------------------------------------------------------------------------
         // ----------------------------------------------------------------------------------------
         // ----------------------------------------------------------------------------------------
-        void replacePlaceholderIndices_DominantEdgeAndCorner(unsigned int* outIb, const Triangle& tri, unsigned int startOutIndex, const EdgeDict& edgeDict, const PositionDict& posDict)
+        // For each edge, the other side's edge, reversed, or the edge itself on a border.
+        void PatchBuilder::writeAdjacentEdges(unsigned int* out, const unsigned int* tri) const
+        {
+            for (unsigned int u = 0; u < EdgesPerTriangle; ++u) {
+                const unsigned int i0 = tri[u];
+                const unsigned int i1 = tri[(u + 1) % EdgesPerTriangle];
+
+                const unsigned int adjacent = findEdge(mPositionIds[i1], mPositionIds[i0]);
+                if (adjacent != EdgeTable::NotFound) {
+                    out[2 * u + 0] = edgeTo(adjacent);
+                    out[2 * u + 1] = edgeFrom(adjacent);
+                } else {
+                    out[2 * u + 0] = i0;
+                    out[2 * u + 1] = i1;
+                }
+            }
+        }
+
+        // ----------------------------------------------------------------------------------------
+        void PatchBuilder::writeDominantEdges(unsigned int* out, const unsigned int* tri) const
         {
-            // First, compute dominant edges. We define dominant edges to be the edge that has either the lower 
-            // minimum index or the lower maximum index. This designation is purely capricious, but it is stable.
+            // We define dominant edges to be the edge that has either the lower minimum index or 
+            // the lower maximum index. This designation is purely capricious, but it is stable.
             for (unsigned int u = 0; u < EdgesPerTriangle; ++u) {
-                EdgeDict::const_iterator fwdIt = edgeDict.find(tri.edge(u));
-                EdgeDict::const_iterator revIt = edgeDict.find(tri.edge(u).reverse());
-                EdgeDict::const_iterator cit = edgeDict.end();
+                const unsigned int i0 = tri[u];
+                const unsigned int i1 = tri[(u + 1) % EdgesPerTriangle];
 
-                if (fwdIt != edgeDict.end() && revIt != edgeDict.end()) {
-                    unsigned int eFmin = min(fwdIt->second.index(0), fwdIt->second.index(1));
-                    unsigned int eFmax = max(fwdIt->second.index(0), fwdIt->second.index(1));
-                    unsigned int eRmin = min(revIt->second.index(0), revIt->second.index(1));
-                    unsigned int eRmax = max(revIt->second.index(0), revIt->second.index(1));
+                const unsigned int fwd = findEdge(mPositionIds[i1], mPositionIds[i0]);
+                const unsigned int rev = findEdge(mPositionIds[i0], mPositionIds[i1]);
+                unsigned int chosen = EdgeTable::NotFound;
+
+                if (fwd != EdgeTable::NotFound && rev != EdgeTable::NotFound) {
+                    unsigned int eFmin = min(edgeTo(fwd), edgeFrom(fwd));
+                    unsigned int eFmax = max(edgeTo(fwd), edgeFrom(fwd));
+                    unsigned int eRmin = min(edgeTo(rev), edgeFrom(rev));
+                    unsigned int eRmax = max(edgeTo(rev), edgeFrom(rev));
 
                     if (eFmin < eRmin) {
-                        cit = fwdIt;
+                        chosen = fwd;
                     } else if (eRmin < eFmin) {
-                        cit = revIt;
+                        chosen = rev;
                     } else if (eFmax < eRmax) {
-                        cit = fwdIt;
-                    } else if (eRmax < eFmax) {
-                        // Could actually fold this and the final case together,
-                        // but this is logically easier to understand
-                        cit = revIt;
+                        chosen = fwd;
                     } else {
-                        // In this case, the indices are the same--so it doesn't matter what we choose.
-                        cit = revIt;
+                        // Either the reverse edge has the lower maximum or the indices are the
+                        // same, in which case it doesn't matter what we choose.
+                        chosen = rev;
                     }
-                } else if (fwdIt != edgeDict.end()) {
-                    cit = fwdIt;
-                } else if (revIt != edgeDict.end()) {
-                    cit = revIt;
-                }
-
-                if (cit != edgeDict.end()) {
-                    outIb[startOutIndex + 3 + 2 * u] = cit->second.index(0);
-                    outIb[startOutIndex + 4 + 2 * u] = cit->second.index(1);
+                } else if (fwd != EdgeTable::NotFound) {
+                    chosen = fwd;
+                } else if (rev != EdgeTable::NotFound) {
+                    chosen = rev;
                 }
-            }
 
-            // Dominant Positions are much easier.
-            for (unsigned u = 0; u < VerticesPerTriangle; ++u) {
-				PositionDict::const_iterator pit = posDict.find(tri.edge(u).vertex(0).pos);
-                if (pit != posDict.end()) {
-					outIb[startOutIndex + 9 + u] = pit->second.mIndex;
+                if (chosen != EdgeTable::NotFound) {
+                    out[2 * u + 0] = edgeTo(chosen);
+                    out[2 * u + 1] = edgeFrom(chosen);
+                } else {
+                    out[2 * u + 0] = i0;
+                    out[2 * u + 1] = i1;
                 }
             }
         }
 
         // ----------------------------------------------------------------------------------------
-        void replacePlaceholderIndices_PnAenOnly(unsigned int* outIb, const Triangle& tri, unsigned int startOutIndex, const EdgeDict& edgeDict, const PositionDict& posDict)
+        void PatchBuilder::writeDominantCorners(unsigned int* out, const unsigned int* tri) const
         {
-            EdgeDict::const_iterator cit = edgeDict.find(tri.edge(0));
-
-            if (cit != edgeDict.end()) {
-                outIb[startOutIndex + 3] = cit->second.index(0);
-                outIb[startOutIndex + 4] = cit->second.index(1);
-            }
-
-            cit = edgeDict.find(tri.edge(1));
-            if (cit != edgeDict.end()) {
-                outIb[startOutIndex + 5] = cit->second.index(0);
-                outIb[startOutIndex + 6] = cit->second.index(1);
-            }
-
-            cit = edgeDict.find(tri.edge(2));
-            if (cit != edgeDict.end()) {
-                outIb[startOutIndex + 7] = cit->second.index(0);
-                outIb[startOutIndex + 8] = cit->second.index(1);
+            for (unsigned int u = 0; u < VerticesPerTriangle; ++u) {
+                out[u] = mCorners[mPositionIds[tri[u]]];
             }
         }
 
         // ----------------------------------------------------------------------------------------
-        void replacePlaceholderIndices_PnAenDominantCorner(unsigned int* outIb, const Triangle& tri, unsigned int startOutIndex, const EdgeDict& edgeDict, const PositionDict& posDict)
+        // outIb must be sized already; patches that are cut short leave its tail alone.
+        void PatchBuilder::writePatches(std::vector<unsigned int>& outIb, bool completeBuffer) const
         {
-            replacePlaceholderIndices_PnAenOnly(outIb, tri, startOutIndex, edgeDict, posDict);
+            const unsigned int indicesPerPatch = getIndicesPerPatch(mDestBufferMode);
+            const unsigned int skipCount = completeBuffer ? 0 : DuplicateIndexCount;
+            const unsigned int outIndicesPerPatch = indicesPerPatch - skipCount;
+            const bool adjacentEdges = mDestBufferMode != DBM_DominantEdgeAndCorner;
+            const bool dominantEdges = mDestBufferMode == DBM_DominantEdgeAndCorner || mDestBufferMode == DBM_PnAenDominantEdgeAndCorner;
+            unsigned int* dest = outIb.empty() ? 0 : &outIb[0];
+
+            runOnThreads(mThreadCount, [&](unsigned int t) {
+                const unsigned int end = rangeStart(mTriCount, mThreadCount, t + 1);
+                for (unsigned int u = rangeStart(mTriCount, mThreadCount, t); u < end; ++u) {
+                    const unsigned int* tri = &mIndices[u * IndicesPerTriangle];
+
+                    unsigned int patch[18];
+                    patch[0] = tri[0];
+                    patch[1] = tri[1];
+                    patch[2] = tri[2];
+
+                    unsigned int next = IndicesPerTriangle;
+                    if (adjacentEdges) {
+                        writeAdjacentEdges(patch + next, tri);
+                        next += 2 * EdgesPerTriangle;
+                    }
+                    if (dominantEdges) {
+                        writeDominantEdges(patch + next, tri);
+                        next += 2 * EdgesPerTriangle;
+                    }
+                    if (mNeedsCorners) {
+                        writeDominantCorners(patch + next, tri);
+                        next += VerticesPerTriangle;
+                    }
+                    assert(next == indicesPerPatch);
 
-            // Deal with dominant positions.
-            for (unsigned u = 0; u < VerticesPerTriangle; ++u) {
-                PositionDict::const_iterator pit = posDict.find(tri.edge(u).vertex(0).pos);
-                if (pit != posDict.end()) {
-					outIb[startOutIndex + 9 + u] = pit->second.mIndex;
+                    memcpy(dest + u * outIndicesPerPatch, patch + skipCount, outIndicesPerPatch * sizeof(unsigned int));
                 }
-            }
+            });
         }
 
         // ----------------------------------------------------------------------------------------
-        void replacePlaceholderIndices_PnAenDominantEdgeAndCorner(unsigned int* outIb, const Triangle& tri, unsigned int startOutIndex, const EdgeDict& edgeDict, const PositionDict& posDict)
-        {
-            replacePlaceholderIndices_PnAenOnly(outIb, tri, startOutIndex, edgeDict, posDict);
-            replacePlaceholderIndices_DominantEdgeAndCorner(outIb, tri, startOutIndex + getIndicesPerPatch(DBM_PnAenOnly) - VerticesPerTriangle, edgeDict, posDict);
-        }
-
         // ----------------------------------------------------------------------------------------
-        // TODO: Remove the input buffer, replace with a cached copy of the "vertex" buffer
-        void replacePlaceholderIndices(unsigned int* outIb, 
-									   unsigned int indexCount,
-                                       DestBufferMode destBufferMode, 
-                                       const EdgeDict& edgeDict, 
-                                       const PositionDict& posDict, 
-                                       const RenderBuffer* inputBuffer)
-        {
-            const unsigned int outputIndicesPerPatch = getIndicesPerPatch(destBufferMode);
-            const unsigned int triCount = indexCount / outputIndicesPerPatch;
-
-            for (unsigned int u = 0; u < triCount; ++u) {
-                const unsigned int startOutIndex = u * outputIndicesPerPatch;
-
-                const unsigned int i0 = outIb[startOutIndex + 0], 
-                    i1 = outIb[startOutIndex + 1], 
-                    i2 = outIb[startOutIndex + 2];
-
-                const Vertex v0 = inputBuffer->getVertex(i0),
-                    v1 = inputBuffer->getVertex(i1),
-                    v2 = inputBuffer->getVertex(i2);
-
-                Triangle tri(i0, i1, i2, v0, v1, v2); 
-
-                switch (destBufferMode) {
-                    case DBM_DominantEdgeAndCorner:
-                        replacePlaceholderIndices_DominantEdgeAndCorner(outIb, tri, startOutIndex, edgeDict, posDict);
-                        break;
-                    case DBM_PnAenOnly:
-                        replacePlaceholderIndices_PnAenOnly(outIb, tri, startOutIndex, edgeDict, posDict);
-                        break;
-                    case DBM_PnAenDominantCorner:
-                        replacePlaceholderIndices_PnAenDominantCorner(outIb, tri, startOutIndex, edgeDict, posDict);
-                        break;
-                    case DBM_PnAenDominantEdgeAndCorner:
-                        replacePlaceholderIndices_PnAenDominantEdgeAndCorner(outIb, tri, startOutIndex, edgeDict, posDict);
-                        break;
-                    default:
-                        assert(0);
-                        break;
-                };
-            }
-        } 
-
         // ----------------------------------------------------------------------------------------
-        void stripUnusedIndices(std::vector<unsigned int>& outIb, DestBufferMode destBufferMode)
-        {
-            const unsigned int indicesPerPatch = getIndicesPerPatch(destBufferMode);
-            const unsigned int destIndicesPerPatch = indicesPerPatch - DuplicateIndexCount;
+		template <typename ElemType>
+		IndexBuffer* createIndexBuffer(const unsigned int* newIndices, unsigned int indexCount, IndexBufferType destBufferType)
+		{
+			ElemType* elemBuffer = new ElemType[indexCount];
 
-            const unsigned int numPatches = (unsigned int) outIb.size() / indicesPerPatch;
-            const unsigned int newIbSize = numPatches * destIndicesPerPatch;
+			for (unsigned int u = 0; u < indexCount; ++u) {
+				elemBuffer[u] = (ElemType)newIndices[u];
+			}
 
-            std::vector<unsigned int> newIb(newIbSize);
+			return new IndexBuffer((void*)elemBuffer, destBufferType, indexCount, true);
+		}
 
-            unsigned int sourceIndex = DuplicateIndexCount;
-			const unsigned int * __restrict srcIndices = &outIb[0];
-			unsigned int * __restrict destIndices = &newIb[0];
-            for (unsigned int destIndex = 0; destIndex < newIbSize; ++destIndex) {
-                destIndices[destIndex] = srcIndices[sourceIndex++];
-                if (sourceIndex % indicesPerPatch == 0) {
-                    sourceIndex += DuplicateIndexCount;
-                }
-            }
+        // ----------------------------------------------------------------------------------------
+        IndexBuffer* newIndexBuffer(const std::vector<unsigned int>& newIndices, const RenderBuffer* inputBuffer)
+        {
+            IndexBufferType ibType = inputBuffer->getIb()->getType();
+            const unsigned int* indices = newIndices.empty() ? 0 : &newIndices[0];
 
-            // Pointer swap.
-            outIb.swap(newIb);
+            switch (ibType) {
+        case IBT_U16: return createIndexBuffer<unsigned short>(indices, (unsigned int)newIndices.size(), IBT_U16); break;
+        case IBT_U32: return createIndexBuffer<unsigned int>(indices, (unsigned int)newIndices.size(), IBT_U32); break;
+        default: assert(0); break;
+            };
+
+            return 0;
         }
 
         // ----------------------------------------------------------------------------------------
@@ -708,25 +594,20 @@ namespace nv {
         // ----------------------------------------------------------------------------------------
         IndexBuffer* buildTessellationBuffer(const RenderBuffer* inputBuffer, DestBufferMode destBufferMode, bool completeBuffer)
         {
-#if NO_STL
-			EdgeDict edgeDict(inputBuffer->getIb()->getLength());
-			PositionDict posDict(inputBuffer->getIb()->getLength());
-#else // #if NO_STL
-            EdgeDict edgeDict;
-            PositionDict posDict;
-            #if USE_HASHMAP
-                edgeDict.rehash(inputBuffer->getIb()->getLength() * EdgesPerTriangle / IndicesPerTriangle * 2 + 1);
-                posDict.rehash(inputBuffer->getIb()->getLength() * VerticesPerTriangle / IndicesPerTriangle * 2 + 1);
-            #endif
-#endif // #if NO_STL
-
-            std::vector<unsigned int> newIb(getIndicesPerPatch(destBufferMode) * inputBuffer->getIb()->getLength() / IndicesPerTriangle);
-            expandIb(&newIb[0], destBufferMode, edgeDict, posDict, inputBuffer);
-
-            replacePlaceholderIndices(&newIb[0], (unsigned int)newIb.size(), destBufferMode, edgeDict, posDict, inputBuffer);
-            if (!completeBuffer) {
-                stripUnusedIndices(newIb, destBufferMode);
-            }
+            assert(destBufferMode >= 0 && destBufferMode < DestBufferMode_MAX);
+
+            const unsigned int indicesPerPatch = getIndicesPerPatch(destBufferMode);
+            const unsigned int triCount = inputBuffer->getIb()->getLength() / IndicesPerTriangle;
+
+            // A complete buffer keeps the size it always had, which for an index count that is
+            // not a multiple of three includes a tail of zeros.
+            std::vector<unsigned int> newIb(completeBuffer
+                ? indicesPerPatch * inputBuffer->getIb()->getLength() / IndicesPerTriangle
+                : triCount * (indicesPerPatch - DuplicateIndexCount));
+
+            PatchBuilder builder(inputBuffer, destBufferMode);
+            builder.build();
+            builder.writePatches(newIb, completeBuffer);
 
             return newIndexBuffer(newIb, inputBuffer);
         }
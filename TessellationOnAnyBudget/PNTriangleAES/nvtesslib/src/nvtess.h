@@ -100,7 +100,7 @@ namespace nv {
     public:
         inline virtual ~RenderBuffer() { delete mIb; }
 
-        /** Return the vertex information at the specified index. */
+        /** Return the vertex information at the specified index. May be called from several threads at once. */
         virtual nv::Vertex getVertex(unsigned int index) const = 0;
 
         const IndexBuffer* getIb() const { return mIb; }
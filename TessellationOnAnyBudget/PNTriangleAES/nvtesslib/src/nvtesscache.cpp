@@ -0,0 +1,422 @@
+#include "DXUT.h"
+// nvtesscache.cpp : Tessellation index buffers cached in files, so meshes that have been built once
+// load without the adjacency build.
+//
+// A cache file is a header, a table of entries sorted by key, then the index data of each entry,
+// stored as the IndexBuffer type it was built with and aligned to 16 bytes. Each entry carries a
+// checksum of its data, checked when the entry is read.
+//
+
+#include "nvtesscache.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Bump whenever buildTessellationBuffer changes its output, so old cache entries stop matching.
+const unsigned int BuilderVersion = 1;
+
+const unsigned int CacheMagic = 0x4354564e; // "NVTC"
+const unsigned int CacheVersion = 1;
+const unsigned int DataAlignment = 16;
+
+namespace nv {
+    namespace tess {
+        // ----------------------------------------------------------------------------------------
+        struct FileHeader
+        {
+            unsigned int mMagic;
+            unsigned int mVersion;
+            unsigned int mEntryCount;
+            unsigned int mReserved;
+        };
+
+        // ----------------------------------------------------------------------------------------
+        struct FileEntry
+        {
+            unsigned long long mKey;
+            unsigned long long mOffset;
+            unsigned long long mChecksum;
+            unsigned int mIndexCount;
+            unsigned int mIbType;
+        };
+
+        // ----------------------------------------------------------------------------------------
+        // ----------------------------------------------------------------------------------------
+        // ----------------------------------------------------------------------------------------
+        // FNV-1a over 32 bit words, with a final mix so nearby keys spread out.
+        class Hasher
+        {
+            unsigned long long mHash;
+
+        public:
+            Hasher() : mHash(0xcbf29ce484222325ULL) { }
+
+            // ------------------------------------------------------------------------------------
+            inline void add(unsigned int word)
+            {
+                mHash = (mHash ^ word) * 0x100000001b3ULL;
+            }
+
+            // ------------------------------------------------------------------------------------
+            inline void add(float f)
+            {
+                unsigned int bits;
+                memcpy(&bits, &f, sizeof(bits));
+                add(bits);
+            }
+
+            // ------------------------------------------------------------------------------------
+            void addBytes(const void* data, size_t size)
+            {
+                const unsigned char* bytes = (const unsigned char*)data;
+                size_t u = 0;
+                for (; u + sizeof(unsigned int) <= size; u += sizeof(unsigned int)) {
+                    unsigned int word;
+                    memcpy(&word, bytes + u, sizeof(word));
+                    add(word);
+                }
+                for (; u < size; ++u) {
+                    add((unsigned int)bytes[u]);
+                }
+            }
+
+            // ------------------------------------------------------------------------------------
+            unsigned long long get() const
+            {
+                unsigned long long h = mHash;
+                h ^= h >> 33;
+                h *= 0xff51afd7ed558ccdULL;
+                h ^= h >> 33;
+                return h;
+            }
+        };
+
+        // ----------------------------------------------------------------------------------------
+        inline size_t getIndexSize(IndexBufferType ibType)
+        {
+            return ibType == IBT_U16 ? sizeof(unsigned short) : sizeof(unsigned int);
+        }
+
+        // ----------------------------------------------------------------------------------------
+        unsigned long long computeCacheKey(const RenderBuffer* inputBuffer, DestBufferMode destBufferMode, bool completeBuffer)
+        {
+            const IndexBuffer* ib = inputBuffer->getIb();
+            const unsigned int indexCount = ib->getLength();
+
+            Hasher hasher;
+            hasher.add(BuilderVersion);
+            hasher.add((unsigned int)destBufferMode);
+            hasher.add(completeBuffer ? 1u : 0u);
+            hasher.add((unsigned int)ib->getType());
+            hasher.add(indexCount);
+
+            unsigned int vertexCount = 0;
+            for (unsigned int u = 0; u < indexCount; ++u) {
+                const unsigned int index = (*ib)[u];
+                hasher.add(index);
+                vertexCount = index + 1 > vertexCount ? index + 1 : vertexCount;
+            }
+
+            hasher.add(vertexCount);
+            for (unsigned int v = 0; v < vertexCount; ++v) {
+                const Vertex vertex = inputBuffer->getVertex(v);
+                hasher.add(vertex.pos.x);
+                hasher.add(vertex.pos.y);
+                hasher.add(vertex.pos.z);
+                hasher.add(vertex.uv.x);
+                hasher.add(vertex.uv.y);
+            }
+
+            return hasher.get();
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // ----------------------------------------------------------------------------------------
+        // ----------------------------------------------------------------------------------------
+        CacheFile::CacheFile() :
+            mFile(0),
+            mMapping(0),
+            mData(0),
+            mSize(0),
+            mEntryCount(0)
+        { }
+
+        // ----------------------------------------------------------------------------------------
+        CacheFile::~CacheFile()
+        {
+            close();
+        }
+
+        // ----------------------------------------------------------------------------------------
+        bool CacheFile::open(const char* path)
+        {
+            close();
+
+#ifdef _WIN32
+            HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            mFile = file;
+
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(FileHeader)) {
+                close();
+                return false;
+            }
+            mSize = (unsigned long long)size.QuadPart;
+
+            mMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (!mMapping) {
+                close();
+                return false;
+            }
+
+            mData = (const unsigned char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+            if (!mData) {
+                close();
+                return false;
+            }
+#else
+            const int fd = ::open(path, O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            mFile = (void*)(size_t)(fd + 1);
+
+            struct stat info;
+            if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(FileHeader)) {
+                close();
+                return false;
+            }
+            mSize = (unsigned long long)info.st_size;
+
+            void* data = mmap(0, (size_t)mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                close();
+                return false;
+            }
+            mData = (const unsigned char*)data;
+#endif
+
+            FileHeader header;
+            memcpy(&header, mData, sizeof(header));
+            if (header.mMagic != CacheMagic || header.mVersion != CacheVersion ||
+                sizeof(FileHeader) + (unsigned long long)header.mEntryCount * sizeof(FileEntry) > mSize) {
+                close();
+                return false;
+            }
+
+            // Every entry's data has to lie inside the file.
+            const FileEntry* entries = (const FileEntry*)(mData + sizeof(FileHeader));
+            for (unsigned int u = 0; u < header.mEntryCount; ++u) {
+                const FileEntry& entry = entries[u];
+                if (entry.mIbType >= IndexBufferType_MAX || entry.mOffset % DataAlignment != 0 || entry.mOffset > mSize ||
+                    (unsigned long long)entry.mIndexCount * getIndexSize((IndexBufferType)entry.mIbType) > mSize - entry.mOffset) {
+                    close();
+                    return false;
+                }
+            }
+
+            mEntryCount = header.mEntryCount;
+            return true;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        void CacheFile::close()
+        {
+#ifdef _WIN32
+            if (mData) {
+                UnmapViewOfFile(mData);
+            }
+            if (mMapping) {
+                CloseHandle(mMapping);
+            }
+            if (mFile) {
+                CloseHandle(mFile);
+            }
+#else
+            if (mData) {
+                munmap((void*)mData, (size_t)mSize);
+            }
+            if (mFile) {
+                ::close((int)(size_t)mFile - 1);
+            }
+#endif
+
+            mFile = 0;
+            mMapping = 0;
+            mData = 0;
+            mSize = 0;
+            mEntryCount = 0;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        unsigned long long CacheFile::getKey(unsigned int entry) const
+        {
+            assert(entry < mEntryCount);
+            return ((const FileEntry*)(mData + sizeof(FileHeader)))[entry].mKey;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        IndexBuffer* CacheFile::getEntry(unsigned int entry) const
+        {
+            assert(entry < mEntryCount);
+            const FileEntry& fileEntry = ((const FileEntry*)(mData + sizeof(FileHeader)))[entry];
+            const IndexBufferType ibType = (IndexBufferType)fileEntry.mIbType;
+            const unsigned char* indices = mData + fileEntry.mOffset;
+
+            Hasher hasher;
+            hasher.addBytes(indices, fileEntry.mIndexCount * getIndexSize(ibType));
+            if (hasher.get() != fileEntry.mChecksum) {
+                return 0;
+            }
+
+            return new IndexBuffer((void*)indices, ibType, fileEntry.mIndexCount, false);
+        }
+
+        // ----------------------------------------------------------------------------------------
+        IndexBuffer* CacheFile::find(unsigned long long key) const
+        {
+            // Entries are sorted by key.
+            unsigned int first = 0;
+            unsigned int last = mEntryCount;
+            while (first < last) {
+                const unsigned int middle = first + (last - first) / 2;
+                if (getKey(middle) < key) {
+                    first = middle + 1;
+                } else {
+                    last = middle;
+                }
+            }
+
+            if (first < mEntryCount && getKey(first) == key) {
+                return getEntry(first);
+            }
+            return 0;
+        }
+
+        // ----------------------------------------------------------------------------------------
+        // ----------------------------------------------------------------------------------------
+        // ----------------------------------------------------------------------------------------
+        void CacheWriter::add(unsigned long long key, const IndexBuffer* indexBuffer)
+        {
+            Entry* entry = 0;
+            for (size_t u = 0; u < mEntries.size(); ++u) {
+                if (mEntries[u].mKey == key) {
+                    entry = &mEntries[u];
+                }
+            }
+            if (!entry) {
+                mEntries.push_back(Entry());
+                entry = &mEntries.back();
+            }
+
+            entry->mKey = key;
+            entry->mIbType = indexBuffer->getType();
+            entry->mIndices.resize(indexBuffer->getLength());
+            for (unsigned int u = 0; u < indexBuffer->getLength(); ++u) {
+                entry->mIndices[u] = (*indexBuffer)[u];
+            }
+        }
+
+        // ----------------------------------------------------------------------------------------
+        void CacheWriter::addMissing(const CacheFile& file)
+        {
+            for (unsigned int u = 0; u < file.getEntryCount(); ++u) {
+                bool present = false;
+                for (size_t v = 0; v < mEntries.size(); ++v) {
+                    present = present || mEntries[v].mKey == file.getKey(u);
+                }
+
+                IndexBuffer* indexBuffer = present ? 0 : file.getEntry(u);
+                if (indexBuffer) {
+                    add(file.getKey(u), indexBuffer);
+                    delete indexBuffer;
+                }
+            }
+        }
+
+        // ----------------------------------------------------------------------------------------
+        bool CacheWriter::write(const char* path) const
+        {
+            std::vector<const Entry*> sorted(mEntries.size());
+            for (size_t u = 0; u < mEntries.size(); ++u) {
+                sorted[u] = &mEntries[u];
+            }
+            std::sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) { return a->mKey < b->mKey; });
+
+            FileHeader header;
+            header.mMagic = CacheMagic;
+            header.mVersion = CacheVersion;
+            header.mEntryCount = (unsigned int)sorted.size();
+            header.mReserved = 0;
+
+            // Lay out the data, then convert each buffer back to its index type.
+            std::vector<FileEntry> entries(sorted.size());
+            const size_t dataOffset = sizeof(FileHeader) + entries.size() * sizeof(FileEntry);
+            std::vector<unsigned char> data;
+
+            for (size_t u = 0; u < sorted.size(); ++u) {
+                const Entry& entry = *sorted[u];
+                const size_t indexSize = getIndexSize(entry.mIbType);
+                const size_t start = (dataOffset + data.size() + DataAlignment - 1) / DataAlignment * DataAlignment - dataOffset;
+                data.resize(start + entry.mIndices.size() * indexSize, 0);
+
+                for (size_t v = 0; v < entry.mIndices.size(); ++v) {
+                    if (entry.mIbType == IBT_U16) {
+                        const unsigned short index = (unsigned short)entry.mIndices[v];
+                        memcpy(&data[start + v * indexSize], &index, indexSize);
+                    } else {
+                        memcpy(&data[start + v * indexSize], &entry.mIndices[v], indexSize);
+                    }
+                }
+
+                Hasher hasher;
+                hasher.addBytes(data.empty() ? 0 : &data[start], entry.mIndices.size() * indexSize);
+
+                entries[u].mKey = entry.mKey;
+                entries[u].mOffset = dataOffset + start;
+                entries[u].mChecksum = hasher.get();
+                entries[u].mIndexCount = (unsigned int)entry.mIndices.size();
+                entries[u].mIbType = (unsigned int)entry.mIbType;
+            }
+
+            // Written beside the destination and renamed over it, so readers never see half a file.
+            const std::string tempPath = std::string(path) + ".tmp";
+            FILE* file = fopen(tempPath.c_str(), "wb");
+            if (!file) {
+                return false;
+            }
+
+            bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+            if (!entries.empty()) {
+                written = written && fwrite(&entries[0], sizeof(FileEntry), entries.size(), file) == entries.size();
+            }
+            if (!data.empty()) {
+                written = written && fwrite(&data[0], 1, data.size(), file) == data.size();
+            }
+            written = fclose(file) == 0 && written;
+
+#ifdef _WIN32
+            written = written && MoveFileExA(tempPath.c_str(), path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+            written = written && rename(tempPath.c_str(), path) == 0;
+#endif
+
+            if (!written) {
+                remove(tempPath.c_str());
+            }
+            return written;
+        }
+    };
+};
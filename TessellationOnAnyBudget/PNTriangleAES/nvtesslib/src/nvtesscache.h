@@ -0,0 +1,83 @@
+
+#ifndef NVTESSCACHE_H
+#define NVTESSCACHE_H
+
+#include "nvtess.h"
+#include <vector>
+
+namespace nv {
+    namespace tess {
+        /**
+        Returns a key for the buffer buildTessellationBuffer would return for these arguments. It covers
+        the indices, the position and uv of every vertex up to the highest index, the mode, whether the
+        buffer is complete, and the version of the builder, so a cached buffer found under the key is the
+        one the builder would make.
+        */
+        unsigned long long computeCacheKey(const RenderBuffer* inputBuffer, DestBufferMode destBufferMode, bool completeBuffer);
+
+        /**
+        A read-only, memory-mapped tessellation cache file: built index buffers stored by their
+        computeCacheKey keys, usually next to the mesh they come from.
+        */
+        class CacheFile
+        {
+            void* mFile;
+            void* mMapping;
+            const unsigned char* mData;
+            unsigned long long mSize;
+            unsigned int mEntryCount;
+
+            CacheFile(const CacheFile&);
+            CacheFile& operator=(const CacheFile&);
+
+        public:
+            CacheFile();
+            ~CacheFile();
+
+            /** Maps the file at path. Returns false, and holds no entries, if it is missing or not a valid cache file. */
+            bool open(const char* path);
+            void close();
+
+            unsigned int getEntryCount() const { return mEntryCount; }
+            unsigned long long getKey(unsigned int entry) const;
+
+            /**
+            Returns a buffer over the mapped indices of an entry, or 0 if its data fails its checksum. The
+            buffer does not own the indices and must not be used after close. Delete it when done.
+            */
+            IndexBuffer* getEntry(unsigned int entry) const;
+
+            /** Like getEntry, for the entry stored under key; 0 if there is none. */
+            IndexBuffer* find(unsigned long long key) const;
+        };
+
+        /**
+        Collects index buffers and writes them as a cache file. Adding a key that is already present
+        replaces its buffer.
+        */
+        class CacheWriter
+        {
+            struct Entry
+            {
+                unsigned long long mKey;
+                IndexBufferType mIbType;
+                std::vector<unsigned int> mIndices;
+            };
+
+            std::vector<Entry> mEntries;
+
+        public:
+            void add(unsigned long long key, const IndexBuffer* indexBuffer);
+
+            /** Adds every entry of file whose key is not present yet. */
+            void addMissing(const CacheFile& file);
+
+            unsigned int getEntryCount() const { return (unsigned int)mEntries.size(); }
+
+            /** Writes to a temporary file next to path, then renames it over path. */
+            bool write(const char* path) const;
+        };
+    };
+};
+
+#endif /* NVTESSCACHE_H */
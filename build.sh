@@ -0,0 +1 @@
+g++ -O3 -DNDEBUG -std=c++14 -I/root/repo/Common -I/root/repo/Benchmark/Benchmark prof.cpp ${1:-/root/repo/Common/RenderQueue.cpp} /root/repo/Common/Profiler.cpp /root/repo/Common/MathHelper.cpp -o prof -lpthread 2>&1 | grep -E "error" ; ./prof